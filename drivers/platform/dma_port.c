@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hdf_base.h"
+#include "hdf_log.h"
+#include "hpm_soc.h"
+#include "hpm_l1c_drv.h"
+#include "dma_port.h"
+#include <los_interrupt.h>
+
+#define HDF_LOG_TAG HPMICRO_DMA_HDF
+
+static uint8_t g_dmaPortInited = 0;
+
+static __attribute__((section(".interrupt.text"))) VOID HpmHdmaIsr(VOID *parm)
+{
+    (void)parm;
+    dma_mgr_isr_handler(HPM_HDMA, 0);
+}
+
+#if defined(DMA_SOC_MAX_COUNT) && (DMA_SOC_MAX_COUNT > 1)
+static __attribute__((section(".interrupt.text"))) VOID HpmXdmaIsr(VOID *parm)
+{
+    (void)parm;
+    dma_mgr_isr_handler(HPM_XDMA, 1);
+}
+#endif
+
+static int32_t HpmDmaPortInstall(void)
+{
+    HwiIrqParam irqParam;
+
+    dma_mgr_init();
+
+    irqParam.pDevId = NULL;
+    if (LOS_HwiCreate(HPM2LITEOS_IRQ(IRQn_HDMA), 1, 0, (HWI_PROC_FUNC)HpmHdmaIsr, &irqParam) != LOS_OK) {
+        HDF_LOGE("DmaPortInit: create HDMA irq failed\n");
+        return HDF_FAILURE;
+    }
+
+#if defined(DMA_SOC_MAX_COUNT) && (DMA_SOC_MAX_COUNT > 1)
+    if (LOS_HwiCreate(HPM2LITEOS_IRQ(IRQn_XDMA), 1, 0, (HWI_PROC_FUNC)HpmXdmaIsr, &irqParam) != LOS_OK) {
+        HDF_LOGE("DmaPortInit: create XDMA irq failed\n");
+        LOS_HwiDelete(HPM2LITEOS_IRQ(IRQn_HDMA), NULL);
+        return HDF_FAILURE;
+    }
+    LOS_HwiEnable(HPM2LITEOS_IRQ(IRQn_XDMA));
+#endif
+    LOS_HwiEnable(HPM2LITEOS_IRQ(IRQn_HDMA));
+
+    return HDF_SUCCESS;
+}
+
+int32_t HpmDmaPortInit(void)
+{
+    int32_t ret = HDF_SUCCESS;
+    uint32_t save = LOS_IntLock();
+
+    /* only marked done once the irqs are installed, a failed attempt is retried by the next caller */
+    if (!g_dmaPortInited) {
+        ret = HpmDmaPortInstall();
+        g_dmaPortInited = (ret == HDF_SUCCESS) ? 1 : 0;
+    }
+    LOS_IntRestore(save);
+
+    return ret;
+}
+
+void HpmDmaPortCacheWriteback(const void *addr, uint32_t size)
+{
+    if (l1c_dc_is_enabled() && (size > 0)) {
+        uint32_t start = HPM_L1C_CACHELINE_ALIGN_DOWN((uint32_t)addr);
+        uint32_t end = HPM_L1C_CACHELINE_ALIGN_UP((uint32_t)addr + size);
+        l1c_dc_writeback(start, end - start);
+    }
+}
+
+void HpmDmaPortCacheInvalidate(const void *addr, uint32_t size)
+{
+    if (l1c_dc_is_enabled() && (size > 0)) {
+        uint32_t start = HPM_L1C_CACHELINE_ALIGN_DOWN((uint32_t)addr);
+        uint32_t end = HPM_L1C_CACHELINE_ALIGN_UP((uint32_t)addr + size);
+        l1c_dc_invalidate(start, end - start);
+    }
+}
+
+uint32_t HpmDmaPortSysAddr(const void *addr)
+{
+    return core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)addr);
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HPM_DMA_PORT_H
+#define HPM_DMA_PORT_H
+
+#include <stdint.h>
+#include "hpm_dma_mgr.h"
+
+/*
+ * Shared DMA manager glue for the HDF platform drivers. The SDK dma_mgr
+ * dispatches its interrupt through the SDK vector table, which is not used
+ * under LiteOS-M, so the DMA IRQs are routed here through LOS_HwiCreate.
+ */
+int32_t HpmDmaPortInit(void);
+
+/* Cache maintenance for buffers shared with DMA, range is aligned to cache lines */
+void HpmDmaPortCacheWriteback(const void *addr, uint32_t size);
+void HpmDmaPortCacheInvalidate(const void *addr, uint32_t size);
+
+/* Bus address of a buffer as seen by DMA */
+uint32_t HpmDmaPortSysAddr(const void *addr);
+
+#endif
@@ -21,18 +21,43 @@
 #include "osal_mem.h"
 #include "gpio_if.h"
 #include "gpio_core.h"
+#include "gpio_ext.h"
 #include <hpm_gpio_drv.h>
+#include <hpm_mchtmr_drv.h>
+#include <hpm_clock_drv.h>
 #include <los_interrupt.h>
 
 #define HDF_LOG_TAG HPMICRO_GPIO_HDF
+#define HPM_GPIO_MAX_PORT 16
+#define HPM_GPIO_PIN_MAX 32
+/* the free running 16 bit ring indices tell at most 32768 queued entries from an empty ring */
+#define HPM_GPIO_EDGE_RING_MAX 32768
+
+/* Edge timestamps of one pin, filled by the isr and drained by HpmGpioReadEdges */
+struct HpmGpioEdgeRing {
+    uint32_t *ts;
+    volatile uint16_t wr;
+    volatile uint16_t rd;
+    uint32_t lastTs;
+    uint32_t dropped;
+    uint32_t bounced;
+};
 
 struct HPMGpioDevice {
     uint32_t base;
     const char *name;
     uint32_t port_num;
     uint32_t irq_num;
+    uint32_t debounce_us;
+    uint32_t edge_ring_size;
+    uint32_t debounceTicks;
+    uint32_t pinMask;
+    struct HpmGpioEdgeRing *pins; /* NULL unless debounce or edge ring is configured */
+    struct GpioCntlr *ctl;
 };
 
+static struct HPMGpioDevice *g_hpmGpioDevs[HPM_GPIO_MAX_PORT];
+
 
 static int32_t Write(struct GpioCntlr *ctl, uint16_t local, uint16_t val)
 {
@@ -155,28 +180,178 @@ static int32_t GpioHcsResurceInit(struct GpioCntlr *ctl)
     dri->GetString(device->property, "name", &hpmGpioDev->name, NULL);
     dri->GetUint32(device->property, "port_num", &hpmGpioDev->port_num, 0);
     dri->GetUint32(device->property, "irq_num", &hpmGpioDev->irq_num, 0);
+    dri->GetUint32(device->property, "debounce_us", &hpmGpioDev->debounce_us, 0);
+    dri->GetUint32(device->property, "edge_ring_size", &hpmGpioDev->edge_ring_size, 0);
     dri->GetUint16(device->property, "count", &ctl->count, 0);
     ctl->start = ctl->count * hpmGpioDev->port_num;
 
+    if (ctl->count > HPM_GPIO_PIN_MAX) {
+        HDF_LOGE("GPIO: count %u exceeds the port width", ctl->count);
+        return HDF_ERR_INVALID_PARAM;
+    }
+    if ((hpmGpioDev->edge_ring_size & (hpmGpioDev->edge_ring_size - 1)) ||
+        (hpmGpioDev->edge_ring_size > HPM_GPIO_EDGE_RING_MAX)) {
+        HDF_LOGE("GPIO: edge_ring_size %u is not a power of 2 up to %u", hpmGpioDev->edge_ring_size,
+                 HPM_GPIO_EDGE_RING_MAX);
+        return HDF_ERR_INVALID_PARAM;
+    }
+
     HDF_LOGI("GPIO: base: 0x%X", hpmGpioDev->base);
     HDF_LOGI("GPIO: name: %s", hpmGpioDev->name);
     HDF_LOGI("GPIO: port_num: %u", hpmGpioDev->port_num);
     HDF_LOGI("GPIO: irq_num: %u", hpmGpioDev->irq_num);
+    HDF_LOGI("GPIO: debounce_us: %u", hpmGpioDev->debounce_us);
+    HDF_LOGI("GPIO: edge_ring_size: %u", hpmGpioDev->edge_ring_size);
     HDF_LOGI("GPIO: count: %u", ctl->count);
     HDF_LOGI("GPIO: start: %u", ctl->start);
 
     return ret;
 }
 
+static int32_t GpioEdgeRingInit(struct HPMGpioDevice *hpmGpioDev, uint16_t count)
+{
+    uint32_t ringSize = hpmGpioDev->edge_ring_size;
+
+    hpmGpioDev->pinMask = (count >= HPM_GPIO_PIN_MAX) ? 0xFFFFFFFFUL : ((1UL << count) - 1);
+    if ((hpmGpioDev->debounce_us == 0) && (ringSize == 0)) {
+        return HDF_SUCCESS;
+    }
+
+    /* pin states and all timestamp rings in one block */
+    hpmGpioDev->pins = (struct HpmGpioEdgeRing *)OsalMemCalloc(
+        count * (sizeof(struct HpmGpioEdgeRing) + ringSize * sizeof(uint32_t)));
+    if (hpmGpioDev->pins == NULL) {
+        return HDF_ERR_MALLOC_FAIL;
+    }
+    hpmGpioDev->debounceTicks = hpmGpioDev->debounce_us * (clock_get_frequency(clock_mchtmr0) / 1000000);
+    uint32_t *ts = (uint32_t *)&hpmGpioDev->pins[count];
+    /* a window that has already passed, so the first edge is not taken for a bounce */
+    uint32_t lastTs = (uint32_t)mchtmr_get_count(HPM_MCHTMR) - hpmGpioDev->debounceTicks;
+    for (uint16_t local = 0; local < count; local++) {
+        hpmGpioDev->pins[local].ts = (ringSize != 0) ? &ts[local * ringSize] : NULL;
+        hpmGpioDev->pins[local].lastTs = lastTs;
+    }
+
+    return HDF_SUCCESS;
+}
+
+/* Returns true when the edge should be reported through GpioCntlrIrqCallback */
+static inline bool GpioEdgeRecord(struct HPMGpioDevice *hpmGpioDev, uint32_t local, uint32_t now)
+{
+    struct HpmGpioEdgeRing *pin = &hpmGpioDev->pins[local];
+    uint32_t ringSize = hpmGpioDev->edge_ring_size;
+
+    if ((hpmGpioDev->debounceTicks != 0) && ((now - pin->lastTs) < hpmGpioDev->debounceTicks)) {
+        pin->bounced++;
+        return false;
+    }
+    pin->lastTs = now;
+    if (ringSize == 0) {
+        return true;
+    }
+
+    uint16_t wr = pin->wr;
+    uint16_t used = (uint16_t)(wr - pin->rd);
+    if (used >= ringSize) {
+        pin->dropped++;
+        return false;
+    }
+    pin->ts[wr & (ringSize - 1)] = now;
+    pin->wr = wr + 1;
+
+    /* one callback per batch, the consumer drains everything queued behind it */
+    return used == 0;
+}
+
+static struct HPMGpioDevice *GpioDevFind(uint16_t gpio, uint16_t *local)
+{
+    for (uint32_t i = 0; i < HPM_GPIO_MAX_PORT; i++) {
+        struct HPMGpioDevice *hpmGpioDev = g_hpmGpioDevs[i];
+        if ((hpmGpioDev != NULL) && (gpio >= hpmGpioDev->ctl->start) &&
+            (gpio < hpmGpioDev->ctl->start + hpmGpioDev->ctl->count)) {
+            *local = gpio - hpmGpioDev->ctl->start;
+            return hpmGpioDev;
+        }
+    }
+    return NULL;
+}
+
+int32_t HpmGpioReadEdges(uint16_t gpio, uint32_t *ts, uint32_t max)
+{
+    uint16_t local;
+    struct HPMGpioDevice *hpmGpioDev = GpioDevFind(gpio, &local);
+
+    if ((hpmGpioDev == NULL) || (ts == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    if ((hpmGpioDev->pins == NULL) || (hpmGpioDev->edge_ring_size == 0)) {
+        return HDF_ERR_NOT_SUPPORT;
+    }
+
+    struct HpmGpioEdgeRing *pin = &hpmGpioDev->pins[local];
+    uint32_t mask = hpmGpioDev->edge_ring_size - 1;
+    uint16_t rd = pin->rd;
+    uint16_t wr = pin->wr;
+    uint32_t n = 0;
+
+    while ((rd != wr) && (n < max)) {
+        ts[n++] = pin->ts[rd & mask];
+        rd++;
+    }
+    pin->rd = rd;
+
+    return (int32_t)n;
+}
+
+int32_t HpmGpioGetEdgeStats(uint16_t gpio, struct HpmGpioEdgeStats *stats)
+{
+    uint16_t local;
+    struct HPMGpioDevice *hpmGpioDev = GpioDevFind(gpio, &local);
+
+    if ((hpmGpioDev == NULL) || (stats == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    if (hpmGpioDev->pins == NULL) {
+        return HDF_ERR_NOT_SUPPORT;
+    }
+
+    struct HpmGpioEdgeRing *pin = &hpmGpioDev->pins[local];
+    stats->pending = (uint16_t)(pin->wr - pin->rd);
+    stats->dropped = pin->dropped;
+    stats->bounced = pin->bounced;
+
+    return HDF_SUCCESS;
+}
+
 static __attribute__((section(".interrupt.text"))) VOID hpm_gpio_isr(VOID *parm)
 {
     struct GpioCntlr *ctl = (struct GpioCntlr *)parm;
     struct HPMGpioDevice *hpmGpioDev = (struct HPMGpioDevice *)ctl->priv;
     GPIO_Type *base = (GPIO_Type *)hpmGpioDev->base;
     uint32_t port_num = hpmGpioDev->port_num;
+    uint32_t pending = gpio_get_port_interrupt_flags(base, port_num) & hpmGpioDev->pinMask;
+    uint32_t local;
+
+    /*
+     * W1C with exactly the flags read above, a read-modify-write would also
+     * ack edges latched in between and lose them.
+     */
+    base->IF[port_num].VALUE = pending;
+
+    if (hpmGpioDev->pins == NULL) {
+        while (pending) {
+            local = __builtin_ctz(pending);
+            pending &= pending - 1;
+            GpioCntlrIrqCallback(ctl, local);
+        }
+        return;
+    }
 
-    for (uint32_t local = 0; local < ctl->count; local++) {
-        if (gpio_check_clear_interrupt_flag(base, port_num, local)) {
+    uint32_t now = (uint32_t)mchtmr_get_count(HPM_MCHTMR);
+    while (pending) {
+        local = __builtin_ctz(pending);
+        pending &= pending - 1;
+        if (GpioEdgeRecord(hpmGpioDev, local, now)) {
             GpioCntlrIrqCallback(ctl, local);
         }
     }
@@ -195,6 +370,7 @@ static int32_t GpioDriverInit(struct HdfDeviceObject *device)
     struct GpioCntlr *ctl = (struct GpioCntlr *)OsalMemCalloc(sizeof(struct GpioCntlr) + sizeof(struct HPMGpioDevice));
     ctl->priv = (char *)ctl + sizeof(struct GpioCntlr);
     hpmGpioDev = (struct HPMGpioDevice *)ctl->priv;
+    hpmGpioDev->ctl = ctl;
     ctl->ops = &gpioOps;
 
     PlatformDeviceSetHdfDev(&ctl->device, device);
@@ -205,22 +381,44 @@ static int32_t GpioDriverInit(struct HdfDeviceObject *device)
         goto ERROR;
     }
 
+    ret = GpioEdgeRingInit(hpmGpioDev, ctl->count);
+    if (ret) {
+        HDF_LOGE("Init: GpioEdgeRingInit Failed!!!\n");
+        goto ERROR;
+    }
+
     ret = GpioCntlrAdd(ctl);
     if (ret) {
         HDF_LOGE("Init: GpioCntlrAdd Fualed, name: %s!!!\n", hpmGpioDev->name);
         goto ERROR;
     }
 
+    if (hpmGpioDev->port_num < HPM_GPIO_MAX_PORT) {
+        g_hpmGpioDevs[hpmGpioDev->port_num] = hpmGpioDev;
+    }
+
     HwiIrqParam irqParam;
     irqParam.pDevId = ctl;
-    LOS_HwiCreate(HPM2LITEOS_IRQ(hpmGpioDev->irq_num), 1, 0, (HWI_PROC_FUNC)hpm_gpio_isr, &irqParam);
+    if (LOS_HwiCreate(HPM2LITEOS_IRQ(hpmGpioDev->irq_num), 1, 0, (HWI_PROC_FUNC)hpm_gpio_isr, &irqParam) != LOS_OK) {
+        HDF_LOGE("Init: irq create Failed, name: %s!!!\n", hpmGpioDev->name);
+        ret = HDF_FAILURE;
+        goto ERROR_REMOVE;
+    }
     LOS_HwiEnable(HPM2LITEOS_IRQ(hpmGpioDev->irq_num));
 
     HDF_LOGI("Init");
 
     return ret;
 
+ERROR_REMOVE:
+    if (hpmGpioDev->port_num < HPM_GPIO_MAX_PORT) {
+        g_hpmGpioDevs[hpmGpioDev->port_num] = NULL;
+    }
+    GpioCntlrRemove(ctl);
 ERROR:
+    if (hpmGpioDev->pins != NULL) {
+        OsalMemFree(hpmGpioDev->pins);
+    }
     OsalMemFree(ctl);
     return ret;
 }
@@ -233,6 +431,16 @@ static void GpioDriverRelease(struct HdfDeviceObject *device)
 
     struct GpioCntlr *ctl = GpioCntlrFromHdfDev(device);
     if (ctl) {
+        struct HPMGpioDevice *hpmGpioDev = (struct HPMGpioDevice *)ctl->priv;
+        LOS_HwiDisable(HPM2LITEOS_IRQ(hpmGpioDev->irq_num));
+        LOS_HwiDelete(HPM2LITEOS_IRQ(hpmGpioDev->irq_num), NULL);
+        if (hpmGpioDev->port_num < HPM_GPIO_MAX_PORT) {
+            g_hpmGpioDevs[hpmGpioDev->port_num] = NULL;
+        }
+        GpioCntlrRemove(ctl);
+        if (hpmGpioDev->pins != NULL) {
+            OsalMemFree(hpmGpioDev->pins);
+        }
         OsalMemFree(ctl);
     }
     HDF_LOGI("Release");
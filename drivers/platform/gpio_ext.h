@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HPM_GPIO_EXT_H
+#define HPM_GPIO_EXT_H
+
+#include <stdint.h>
+
+struct HpmGpioEdgeStats {
+    uint32_t pending;   /* timestamps queued in the ring */
+    uint32_t dropped;   /* edges lost to a full ring */
+    uint32_t bounced;   /* edges rejected inside the debounce window */
+};
+
+/*
+ * Drain up to <max> edge timestamps of <gpio> into <ts>, oldest first. The
+ * values are the low 32 bits of the mchtmr counter. Returns the count, or a
+ * negative HDF error when the port has no edge_ring_size configured.
+ */
+int32_t HpmGpioReadEdges(uint16_t gpio, uint32_t *ts, uint32_t max);
+
+int32_t HpmGpioGetEdgeStats(uint16_t gpio, struct HpmGpioEdgeStats *stats);
+
+#endif
@@ -19,6 +19,7 @@
 #include "hdf_device_desc.h"
 #include "osal_sem.h"
 #include "osal_mem.h"
+#include "osal_time.h"
 #include "hdf_log.h"
 #include "i2c_if.h"
 #include "i2c_core.h"
@@ -26,42 +27,309 @@
 #include <los_interrupt.h>
 
 #define HDF_LOG_TAG HPMICRO_I2C_HDF
+#define HPM_I2C_SEG_MAX I2C_SOC_TRANSFER_COUNT_MAX
+#define HPM_I2C_XFER_TIMEOUT_MS 1000
+#define HPM_I2C_IDLE_TIMEOUT_MS 2
+#define HPM_I2C_SPEED_FAST 400000
+#define HPM_I2C_SPEED_FAST_PLUS 1000000
+#define HPM_I2C_XFER_EVENTS (I2C_EVENT_TRANSACTION_COMPLETE | I2C_EVENT_FIFO_HALF | I2C_EVENT_LOSS_ARBITRATION)
+#define HPM_I2C_STATUS_W1C (I2C_STATUS_CMPL_MASK | I2C_STATUS_ADDRHIT_MASK | I2C_STATUS_ARBLOSE_MASK | \
+                            I2C_STATUS_BYTERECV_MASK | I2C_STATUS_BYTETRANS_MASK | \
+                            I2C_STATUS_START_MASK | I2C_STATUS_STOP_MASK)
+
+/* One message batch, stepped one controller transaction (segment) at a time */
+struct HpmI2cXfer {
+    struct I2cMsg *msgs;    /* NULL when idle */
+    int16_t count;
+    int16_t idx;
+    uint16_t off;
+    uint16_t seg;
+    uint16_t left;          /* bytes of the segment not yet moved through the fifo */
+    bool start;
+    bool stop;
+    bool useIrq;
+    int32_t status;
+};
 
 struct HPMI2cDevice {
     uint32_t id;
     uint32_t base;
     uint32_t clkFreq;
+    uint32_t irq;
+    uint32_t busSpeed;
+    struct HpmI2cXfer xfer;
+    struct OsalSem doneSem;
 };
 
-static int32_t hpmTransfer(struct I2cCntlr *cntlr, struct I2cMsg *msgs, int16_t count)
+static uint8_t HpmI2cBusMode(uint32_t busSpeed)
+{
+    if (busSpeed >= HPM_I2C_SPEED_FAST_PLUS) {
+        return i2c_mode_fast_plus;
+    }
+    if (busSpeed >= HPM_I2C_SPEED_FAST) {
+        return i2c_mode_fast;
+    }
+    return i2c_mode_normal;
+}
+
+static void HpmI2cHwInit(struct HPMI2cDevice *hpmI2cDev)
 {
-    struct HPMI2cDevice *hpmI2cDev = (struct HPMI2cDevice *)cntlr->priv;
     I2C_Type *base = (I2C_Type *)hpmI2cDev->base;
+    i2c_config_t i2cConfig;
 
-    for (int i = 0; i < count; i++) {
-        if (msgs[i].flags & I2C_FLAG_ADDR_10BIT) {
-            i2c_enable_10bit_address_mode(base, 1);
-        } else {
-            i2c_enable_10bit_address_mode(base, 0);
+    i2cConfig.i2c_mode = HpmI2cBusMode(hpmI2cDev->busSpeed);
+    i2cConfig.is_10bit_addressing = 0;
+    i2c_init_master(base, hpmI2cDev->clkFreq, &i2cConfig);
+}
+
+/* Program the next segment of the current message, START/ADDR only on its first segment */
+static void HpmI2cSegmentStart(struct HPMI2cDevice *hpmI2cDev)
+{
+    struct HpmI2cXfer *xfer = &hpmI2cDev->xfer;
+    struct I2cMsg *msg = &xfer->msgs[xfer->idx];
+    I2C_Type *base = (I2C_Type *)hpmI2cDev->base;
+    bool isRead = (msg->flags & I2C_FLAG_READ) != 0;
+    uint32_t ctrl;
+
+    xfer->seg = msg->len - xfer->off;
+    if (xfer->seg > HPM_I2C_SEG_MAX) {
+        xfer->seg = HPM_I2C_SEG_MAX;
+    }
+    xfer->left = xfer->seg;
+    xfer->start = (xfer->off == 0) && !(msg->flags & I2C_FLAG_NO_START);
+    xfer->stop = ((xfer->off + xfer->seg) >= msg->len) &&
+                 ((xfer->idx == xfer->count - 1) || (msg->flags & I2C_FLAG_STOP));
+
+    /* i2c_enable_10bit_address_mode() only ever sets the bit */
+    if (msg->flags & I2C_FLAG_ADDR_10BIT) {
+        base->SETUP |= I2C_SETUP_ADDRESSING_MASK;
+    } else {
+        base->SETUP &= ~I2C_SETUP_ADDRESSING_MASK;
+    }
+    base->STATUS = HPM_I2C_STATUS_W1C;
+    base->CMD = I2C_CMD_CLEAR_FIFO;
+    base->ADDR = I2C_ADDR_ADDR_SET(msg->addr);
+
+    ctrl = I2C_CTRL_DIR_SET(isRead ? I2C_DIR_MASTER_READ : I2C_DIR_MASTER_WRITE);
+    if (xfer->start) {
+        /* no STOP was issued before, so this becomes a repeated start */
+        ctrl |= I2C_CTRL_PHASE_START_MASK | I2C_CTRL_PHASE_ADDR_MASK;
+    }
+    if (xfer->stop) {
+        ctrl |= I2C_CTRL_PHASE_STOP_MASK;
+    }
+    if (xfer->seg != 0) {
+        ctrl |= I2C_CTRL_PHASE_DATA_MASK
+            | I2C_CTRL_DATACNT_HIGH_SET(I2C_DATACNT_MAP(xfer->seg) >> 8U)
+            | I2C_CTRL_DATACNT_SET(I2C_DATACNT_MAP(xfer->seg));
+    }
+    base->CTRL = ctrl;
+
+    if (!isRead) {
+        while ((xfer->left > 0) && !i2c_fifo_is_full(base)) {
+            base->DATA = msg->buf[xfer->off + xfer->seg - xfer->left];
+            xfer->left--;
+        }
+    }
+    base->INTEN = xfer->useIrq ? HPM_I2C_XFER_EVENTS : 0;
+    base->CMD = I2C_CMD_ISSUE_DATA_TRANSMISSION;
+}
+
+static void HpmI2cXferFinish(struct HPMI2cDevice *hpmI2cDev, int32_t status)
+{
+    struct HpmI2cXfer *xfer = &hpmI2cDev->xfer;
+    I2C_Type *base = (I2C_Type *)hpmI2cDev->base;
+
+    base->INTEN = 0;
+    if (!xfer->stop) {
+        /* the batch ended on a segment without STOP, release the bus */
+        base->STATUS = I2C_STATUS_CMPL_MASK;
+        base->CTRL = I2C_CTRL_PHASE_STOP_MASK;
+        base->CMD = I2C_CMD_ISSUE_DATA_TRANSMISSION;
+    }
+    xfer->status = status;
+    xfer->msgs = NULL;
+}
+
+/*
+ * Move fifo data and step through the batch, shared by the isr and the polled path.
+ * Returns true once the batch has finished, xfer->status holds the result.
+ */
+static bool HpmI2cXferService(struct HPMI2cDevice *hpmI2cDev)
+{
+    struct HpmI2cXfer *xfer = &hpmI2cDev->xfer;
+    I2C_Type *base = (I2C_Type *)hpmI2cDev->base;
+    uint32_t status = base->STATUS;
+    struct I2cMsg *msg = &xfer->msgs[xfer->idx];
+    bool isRead = (msg->flags & I2C_FLAG_READ) != 0;
+    uint8_t *data = &msg->buf[xfer->off + xfer->seg];
+    bool nack;
+
+    if (status & I2C_STATUS_ARBLOSE_MASK) {
+        base->STATUS = I2C_STATUS_ARBLOSE_MASK;
+        /* the bus belongs to the winner, no STOP from us */
+        xfer->stop = true;
+        HpmI2cXferFinish(hpmI2cDev, HDF_ERR_IO);
+        return true;
+    }
+
+    if (isRead) {
+        while ((xfer->left > 0) && !i2c_fifo_is_empty(base)) {
+            *(data - xfer->left) = base->DATA;
+            xfer->left--;
+        }
+    } else {
+        while ((xfer->left > 0) && !i2c_fifo_is_full(base)) {
+            base->DATA = *(data - xfer->left);
+            xfer->left--;
         }
+        if (xfer->left == 0) {
+            /* fifo half empty would keep firing until CMPL */
+            base->INTEN &= ~I2C_EVENT_FIFO_HALF;
+        }
+    }
+
+    if (!(status & I2C_STATUS_CMPL_MASK)) {
+        return false;
+    }
+    base->STATUS = I2C_STATUS_CMPL_MASK | I2C_STATUS_ADDRHIT_MASK;
+
+    if (xfer->start && !(status & I2C_STATUS_ADDRHIT_MASK)) {
+        HpmI2cXferFinish(hpmI2cDev, HDF_ERR_IO);
+        return true;
+    }
+    /* a data NACK ends the transaction, on the last byte only the ACK bit tells */
+    nack = !isRead && (!(status & I2C_STATUS_ACK_MASK) || (i2c_get_data_count(base) != 0));
+    if (nack && (msg->flags & I2C_FLAG_IGNORE_NO_ACK)) {
+        /* the rest of the message is dropped, the batch goes on */
+        xfer->off = msg->len - xfer->seg;
+        xfer->left = 0;
+    } else if (nack || (xfer->left != 0)) {
+        HpmI2cXferFinish(hpmI2cDev, HDF_ERR_IO);
+        return true;
+    }
+
+    xfer->off += xfer->seg;
+    if (xfer->off >= msg->len) {
+        xfer->idx++;
+        xfer->off = 0;
+    }
+    if (xfer->idx >= xfer->count) {
+        HpmI2cXferFinish(hpmI2cDev, HDF_SUCCESS);
+        return true;
+    }
+
+    HpmI2cSegmentStart(hpmI2cDev);
+    return false;
+}
 
-        /*
-         * TODO: Another flags: I2C_FLAG_NO_START, I2C_FLAG_STOP, I2C_FLAG_READ_NO_ACK
-         */
-        if (msgs[i].flags & I2C_FLAG_READ) {
-            if (i2c_master_read(base, msgs[i].addr, msgs[i].buf, msgs[i].len) != status_success) {
-                HDF_LOGI("i2c read: Failed!!!\n");
-                return HDF_FAILURE;
-            }
+static __attribute__((section(".interrupt.text"))) VOID HpmI2cIsr(VOID *parm)
+{
+    struct HPMI2cDevice *hpmI2cDev = (struct HPMI2cDevice *)parm;
+    I2C_Type *base = (I2C_Type *)hpmI2cDev->base;
+
+    if (hpmI2cDev->xfer.msgs == NULL) {
+        base->INTEN = 0;
+        base->STATUS = HPM_I2C_STATUS_W1C;
+        return;
+    }
+
+    if (HpmI2cXferService(hpmI2cDev)) {
+        OsalSemPost(&hpmI2cDev->doneSem);
+    }
+}
+
+static void HpmI2cXferAbort(struct HPMI2cDevice *hpmI2cDev)
+{
+    I2C_Type *base = (I2C_Type *)hpmI2cDev->base;
+
+    uint32_t save = LOS_IntLock();
+    base->INTEN = 0;
+    hpmI2cDev->xfer.msgs = NULL;
+    LOS_IntRestore(save);
+
+    base->CMD = I2C_CMD_RESET;
+    HpmI2cHwInit(hpmI2cDev);
+
+    /* drop a completion that raced with the timeout */
+    while (OsalSemWait(&hpmI2cDev->doneSem, 0) == HDF_SUCCESS) {
+    }
+}
+
+/* The STOP that releases the bus after a failed batch may still be on the wire */
+static void HpmI2cWaitIdle(struct HPMI2cDevice *hpmI2cDev)
+{
+    I2C_Type *base = (I2C_Type *)hpmI2cDev->base;
+    uint64_t deadline = OsalGetSysTimeMs() + HPM_I2C_IDLE_TIMEOUT_MS;
+
+    /* CMD reads back non-zero until the issued transaction is over */
+    while (base->CMD & I2C_CMD_CMD_MASK) {
+        if (OsalGetSysTimeMs() > deadline) {
+            HDF_LOGE("i2c%u: bus not released\n", hpmI2cDev->id);
+            HpmI2cXferAbort(hpmI2cDev);
+            return;
+        }
+    }
+}
+
+static int32_t HpmI2cTransferPolling(struct HPMI2cDevice *hpmI2cDev)
+{
+    uint64_t deadline = OsalGetSysTimeMs() + HPM_I2C_XFER_TIMEOUT_MS;
+
+    HpmI2cSegmentStart(hpmI2cDev);
+    while (!HpmI2cXferService(hpmI2cDev)) {
+        if (OsalGetSysTimeMs() > deadline) {
+            return HDF_ERR_TIMEOUT;
+        }
+    }
+    return hpmI2cDev->xfer.status;
+}
+
+static int32_t hpmTransfer(struct I2cCntlr *cntlr, struct I2cMsg *msgs, int16_t count)
+{
+    struct HPMI2cDevice *hpmI2cDev = (struct HPMI2cDevice *)cntlr->priv;
+    struct HpmI2cXfer *xfer = &hpmI2cDev->xfer;
+    int32_t ret;
+
+    if ((msgs == NULL) || (count <= 0)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+
+    /* the whole batch goes out as one bus transaction chained by repeated starts */
+    xfer->count = count;
+    xfer->idx = 0;
+    xfer->off = 0;
+    xfer->status = HDF_SUCCESS;
+    xfer->useIrq = (hpmI2cDev->irq != 0);
+    xfer->msgs = msgs;
+
+    if (!xfer->useIrq) {
+        ret = HpmI2cTransferPolling(hpmI2cDev);
+    } else {
+        uint32_t save = LOS_IntLock();
+        HpmI2cSegmentStart(hpmI2cDev);
+        LOS_IntRestore(save);
+
+        /* the calling task sleeps, the isr walks the message array */
+        if (OsalSemWait(&hpmI2cDev->doneSem, HPM_I2C_XFER_TIMEOUT_MS) != HDF_SUCCESS) {
+            ret = HDF_ERR_TIMEOUT;
         } else {
-            if (i2c_master_write(base, msgs[i].addr, msgs[i].buf, msgs[i].len) != status_success) {
-                HDF_LOGI("i2c write: Failed!!!\n");
-                return HDF_FAILURE;
-            }
+            ret = xfer->status;
         }
     }
 
-    return 0;
+    if (ret == HDF_ERR_TIMEOUT) {
+        HDF_LOGE("i2c%u transfer: timeout\n", hpmI2cDev->id);
+        HpmI2cXferAbort(hpmI2cDev);
+    } else {
+        HpmI2cWaitIdle(hpmI2cDev);
+    }
+    if (ret != HDF_SUCCESS) {
+        HDF_LOGI("i2c%u transfer: failed at msg %d\n", hpmI2cDev->id, xfer->idx);
+        return ret;
+    }
+
+    return count;
 }
 
 static struct I2cMethod hpmI2cMethod = {
@@ -103,9 +371,27 @@ static int32_t I2cDriverInit(struct HdfDeviceObject *device)
     dri->GetUint32(device->property, "id", &hpmI2cDev->id, 0);
     dri->GetUint32(device->property, "base", &hpmI2cDev->base, 0);
     dri->GetUint32(device->property, "clk_freq", &hpmI2cDev->clkFreq, 0);
+    dri->GetUint32(device->property, "irq_num", &hpmI2cDev->irq, 0);
+    dri->GetUint32(device->property, "bus_speed", &hpmI2cDev->busSpeed, 100000);
     HDF_LOGI("Init: hpmI2cDev->id: %u\n", hpmI2cDev->id);
     HDF_LOGI("Init: hpmI2cDev->base: 0x%X\n", hpmI2cDev->base);
     HDF_LOGI("Init: hpmI2cDev->clkFreq: %u\n", hpmI2cDev->clkFreq);
+    HDF_LOGI("Init: hpmI2cDev->irq: %u\n", hpmI2cDev->irq);
+    HDF_LOGI("Init: hpmI2cDev->busSpeed: %u\n", hpmI2cDev->busSpeed);
+
+    HpmI2cHwInit(hpmI2cDev);
+    OsalSemInit(&hpmI2cDev->doneSem, 0);
+
+    if (hpmI2cDev->irq != 0) {
+        HwiIrqParam irqParam;
+        irqParam.pDevId = hpmI2cDev;
+        if (LOS_HwiCreate(HPM2LITEOS_IRQ(hpmI2cDev->irq), 1, 0, (HWI_PROC_FUNC)HpmI2cIsr, &irqParam) != LOS_OK) {
+            ret = HDF_FAILURE;
+            HDF_LOGE("Init: i2c%u irq create Failed!!!\n", hpmI2cDev->id);
+            goto ERROR2;
+        }
+        LOS_HwiEnable(HPM2LITEOS_IRQ(hpmI2cDev->irq));
+    }
 
     cntlr->busId = hpmI2cDev->id;
     cntlr->ops = &hpmI2cMethod;
@@ -113,16 +399,17 @@ static int32_t I2cDriverInit(struct HdfDeviceObject *device)
     if (ret) {
         HDF_LOGE("Init: I2cCntlrAdd Failed!!!\n");
         ret = HDF_FAILURE;
-        goto ERROR1;
+        goto ERROR3;
     }
 
-    I2C_Type *base = (I2C_Type *)hpmI2cDev->base;
-    i2c_config_t i2cConfig;
-    i2cConfig.i2c_mode = i2c_mode_normal;
-    i2cConfig.is_10bit_addressing = 0;
-    i2c_init_master(base, hpmI2cDev->clkFreq, &i2cConfig);
-
     return ret;
+ERROR3:
+    if (hpmI2cDev->irq != 0) {
+        LOS_HwiDisable(HPM2LITEOS_IRQ(hpmI2cDev->irq));
+        LOS_HwiDelete(HPM2LITEOS_IRQ(hpmI2cDev->irq), NULL);
+    }
+ERROR2:
+    OsalSemDestroy(&hpmI2cDev->doneSem);
 ERROR1:
     OsalMemFree(cntlr);
     return ret;
@@ -140,7 +427,13 @@ static void I2cDriverRelease(struct HdfDeviceObject *device)
         return;
     }
 
+    struct HPMI2cDevice *hpmI2cDev = (struct HPMI2cDevice *)cntlr->priv;
     I2cCntlrRemove(cntlr);
+    if (hpmI2cDev->irq != 0) {
+        LOS_HwiDisable(HPM2LITEOS_IRQ(hpmI2cDev->irq));
+        LOS_HwiDelete(HPM2LITEOS_IRQ(hpmI2cDev->irq), NULL);
+    }
+    OsalSemDestroy(&hpmI2cDev->doneSem);
     OsalMemFree(cntlr);
 
     HDF_LOGI("Release");
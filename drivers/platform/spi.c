@@ -22,20 +22,71 @@
 #include "hdf_log.h"
 #include "spi_if.h"
 #include "spi_core.h"
+#include "securec.h"
 #include "hpm_common.h"
 #include "hpm_spi_drv.h"
+#include "hpm_l1c_drv.h"
+#include "dma_port.h"
+#include "spi_ext.h"
 #include <los_interrupt.h>
 
 #define HDF_LOG_TAG HPMICRO_SPI_HDF
+#define HPM_SPI_MAX_NUM 4
+#define HPM_SPI_DMA_SRC_NONE 0xFF
+#define HPM_SPI_DMA_MIN_LEN_DEFAULT 32
+#define HPM_SPI_XFER_TIMEOUT_MARGIN_MS 20
+#define HPM_SPI_XFER_TIMEOUT_SPEED_MIN_HZ 10000
+#define HPM_SPI_SEG_MAX SPI_SOC_TRANSFER_COUNT_MAX
+#define HPM_SPI_RX_BOUNCE_MAX 4096U
+#define HPM_SPI_RX_BOUNCE_SIZE ((HPM_SPI_SEG_MAX < HPM_SPI_RX_BOUNCE_MAX) ? HPM_SPI_SEG_MAX : HPM_SPI_RX_BOUNCE_MAX)
+#if defined(SPI_SOC_SUPPORT_DIRECTIO) && (SPI_SOC_SUPPORT_DIRECTIO == 1)
+#define HPM_SPI_CS_BY_DIRECTIO 1
+#else
+#define HPM_SPI_CS_BY_DIRECTIO 0
+#endif
 
+/*
+ * Queued transfer of a whole message array, advanced segment by segment. One
+ * segment is at most one spi transaction (SPI_SOC_TRANSFER_COUNT_MAX data
+ * units, HPM_SPI_RX_BOUNCE_SIZE through the rx bounce buffer), data is moved by
+ * dma. A segment is done once the spi end interrupt and, when it reads, the rx
+ * dma tc have both arrived.
+ */
+struct HpmSpiXfer {
+    struct SpiMsg *msgs;
+    uint32_t count;
+    uint32_t idx;
+    uint32_t off;
+    uint32_t seg;
+    uint8_t rxBounce;
+    uint8_t pending;
+    int32_t status;
+    HpmSpiDoneCb cb;
+    void *cbArg;
+};
 
 struct HPMSpiDevice {
     uint32_t id;
     uint32_t base;
+    uint32_t irq;
     uint32_t clkFreq;
+    uint32_t dmaRxSrc;
+    uint32_t dmaTxSrc;
+    uint32_t dmaMinLen;
+    uint32_t curSpeedHz;
+    uint32_t openCnt;
     struct SpiCfg cfg;
+    struct OsalSem busSem;
+    struct OsalSem doneSem;
+    dma_resource_t rxDma;
+    dma_resource_t txDma;
+    uint8_t *rxBounceBuf;
+    uint8_t isDmaReady;
+    struct HpmSpiXfer xfer;
 };
 
+static struct HPMSpiDevice *g_hpmSpiDevs[HPM_SPI_MAX_NUM];
+
 static void HpmSpiConfig(struct SpiCntlr *cntlr)
 {
     struct HPMSpiDevice *hpmSpiDev = (struct HPMSpiDevice *)cntlr->priv;
@@ -73,6 +124,313 @@ static void HpmSpiConfig(struct SpiCntlr *cntlr)
 
     spi_master_timing_init(base, &timing_config);
     spi_format_init(base, &format_config);
+    hpmSpiDev->curSpeedHz = cfg->maxSpeedHz;
+}
+
+/* Per message speed override, only called while the controller is idle */
+static void HpmSpiSetSpeed(struct HPMSpiDevice *hpmSpiDev, uint32_t speedHz)
+{
+    spi_timing_config_t timing_config = {0};
+
+    if ((speedHz == 0) || (speedHz == hpmSpiDev->curSpeedHz)) {
+        return;
+    }
+
+    spi_master_get_default_timing_config(&timing_config);
+    timing_config.master_config.clk_src_freq_in_hz = hpmSpiDev->clkFreq;
+    timing_config.master_config.sclk_freq_in_hz = speedHz;
+    spi_master_timing_init((SPI_Type *)hpmSpiDev->base, &timing_config);
+    hpmSpiDev->curSpeedHz = speedHz;
+}
+
+static void HpmSpiCsWrite(struct HPMSpiDevice *hpmSpiDev, bool high)
+{
+#if HPM_SPI_CS_BY_DIRECTIO
+    spi_directio_write((SPI_Type *)hpmSpiDev->base, cs_pin, high);
+#else
+    /* no direct io: cs is driven by the controller around every transaction */
+    (void)hpmSpiDev;
+    (void)high;
+#endif
+}
+
+/*
+ * Without direct io the controller releases cs after every transaction, so cs
+ * can neither be held across messages (keepCs) nor across the transactions of
+ * a message longer than HPM_SPI_SEG_MAX. Such arrays are refused rather than
+ * run with cs toggling under the device.
+ */
+static int32_t HpmSpiCheckCs(const struct SpiMsg *msg, uint32_t count)
+{
+#if !HPM_SPI_CS_BY_DIRECTIO
+    for (uint32_t i = 0; i < count; i++) {
+        if (msg[i].keepCs || (msg[i].len > HPM_SPI_SEG_MAX)) {
+            return HDF_ERR_NOT_SUPPORT;
+        }
+    }
+#else
+    (void)msg;
+    (void)count;
+#endif
+    return HDF_SUCCESS;
+}
+
+static inline bool HpmSpiIsCacheAligned(const void *buf, uint32_t len)
+{
+    return ((((uint32_t)buf | len) & (HPM_L1C_CACHELINE_SIZE - 1)) == 0) ? true : false;
+}
+
+static void HpmSpiDmaStart(const dma_resource_t *res, uint32_t src, uint32_t dst, uint32_t len, bool isTx,
+                           uint32_t dmamuxSrc)
+{
+    dma_mgr_chn_conf_t config;
+
+    dma_mgr_get_default_chn_config(&config);
+    config.en_dmamux = true;
+    config.dmamux_src = dmamuxSrc;
+    config.src_addr = src;
+    config.dst_addr = dst;
+    config.size_in_byte = len;
+    config.src_addr_ctrl = isTx ? DMA_MGR_ADDRESS_CONTROL_INCREMENT : DMA_MGR_ADDRESS_CONTROL_FIXED;
+    config.dst_addr_ctrl = isTx ? DMA_MGR_ADDRESS_CONTROL_FIXED : DMA_MGR_ADDRESS_CONTROL_INCREMENT;
+    config.src_mode = isTx ? DMA_MGR_HANDSHAKE_MODE_NORMAL : DMA_MGR_HANDSHAKE_MODE_HANDSHAKE;
+    config.dst_mode = isTx ? DMA_MGR_HANDSHAKE_MODE_HANDSHAKE : DMA_MGR_HANDSHAKE_MODE_NORMAL;
+    /* tx completion is taken from the spi end interrupt, rx from its tc once the fifo is drained */
+    config.interrupt_mask = isTx ? DMA_MGR_INTERRUPT_MASK_ALL :
+                                   (DMA_MGR_INTERRUPT_MASK_HALF_TC | DMA_MGR_INTERRUPT_MASK_ABORT);
+
+    dma_mgr_setup_channel(res, &config);
+    dma_mgr_enable_channel(res);
+}
+
+/* Program the next segment of the current message, controller must be idle */
+static int32_t HpmSpiSegmentStart(struct HPMSpiDevice *hpmSpiDev)
+{
+    struct HpmSpiXfer *xfer = &hpmSpiDev->xfer;
+    struct SpiMsg *msg = &xfer->msgs[xfer->idx];
+    SPI_Type *base = (SPI_Type *)hpmSpiDev->base;
+    spi_control_config_t config = {0};
+    uint32_t rLen;
+    uint32_t wLen;
+
+    xfer->seg = msg->len - xfer->off;
+    xfer->seg = (xfer->seg > HPM_SPI_SEG_MAX) ? HPM_SPI_SEG_MAX : xfer->seg;
+    xfer->rxBounce = 0;
+    if ((msg->rbuf != NULL) && !HpmSpiIsCacheAligned(&msg->rbuf[xfer->off], xfer->seg)) {
+        xfer->rxBounce = 1;
+        xfer->seg = (xfer->seg > HPM_SPI_RX_BOUNCE_SIZE) ? HPM_SPI_RX_BOUNCE_SIZE : xfer->seg;
+    }
+
+    spi_master_get_default_control_config(&config);
+    if (msg->wbuf && msg->rbuf) {
+        config.common_config.trans_mode = spi_trans_write_read_together;
+        rLen = xfer->seg;
+        wLen = xfer->seg;
+    } else if (msg->wbuf) {
+        config.common_config.trans_mode = spi_trans_write_only;
+        rLen = 0;
+        wLen = xfer->seg;
+    } else if (msg->rbuf) {
+        config.common_config.trans_mode = spi_trans_read_only;
+        rLen = xfer->seg;
+        wLen = 0;
+    } else {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    config.common_config.tx_dma_enable = (wLen != 0) ? true : false;
+    config.common_config.rx_dma_enable = (rLen != 0) ? true : false;
+    xfer->pending = (rLen != 0) ? 2 : 1;
+
+    if (xfer->off == 0) {
+        HpmSpiSetSpeed(hpmSpiDev, msg->speed);
+        HpmSpiCsWrite(hpmSpiDev, false);
+    }
+
+    spi_disable_dma(base, SPI_CTRL_TXDMAEN_MASK | SPI_CTRL_RXDMAEN_MASK);
+    if (spi_setup_dma_transfer(base, &config, NULL, NULL, wLen, rLen) != status_success) {
+        return HDF_FAILURE;
+    }
+
+    if (rLen != 0) {
+        uint8_t *rbuf = xfer->rxBounce ? hpmSpiDev->rxBounceBuf : &msg->rbuf[xfer->off];
+        HpmDmaPortCacheInvalidate(rbuf, rLen);
+        HpmSpiDmaStart(&hpmSpiDev->rxDma, (uint32_t)&base->DATA, HpmDmaPortSysAddr(rbuf), rLen, false,
+                       hpmSpiDev->dmaRxSrc);
+    }
+
+    if (wLen != 0) {
+        HpmDmaPortCacheWriteback(&msg->wbuf[xfer->off], wLen);
+        HpmSpiDmaStart(&hpmSpiDev->txDma, HpmDmaPortSysAddr(&msg->wbuf[xfer->off]), (uint32_t)&base->DATA, wLen,
+                       true, hpmSpiDev->dmaTxSrc);
+    }
+
+    return HDF_SUCCESS;
+}
+
+static void HpmSpiXferFinish(struct HPMSpiDevice *hpmSpiDev, int32_t status)
+{
+    struct HpmSpiXfer *xfer = &hpmSpiDev->xfer;
+    HpmSpiDoneCb cb = xfer->cb;
+    void *cbArg = xfer->cbArg;
+
+    HpmSpiCsWrite(hpmSpiDev, true);
+    spi_disable_dma((SPI_Type *)hpmSpiDev->base, SPI_CTRL_TXDMAEN_MASK | SPI_CTRL_RXDMAEN_MASK);
+    xfer->status = status;
+    xfer->msgs = NULL;
+
+    if (cb != NULL) {
+        /* async request owns the bus until here */
+        OsalSemPost(&hpmSpiDev->busSem);
+        cb(hpmSpiDev->id, status, cbArg);
+    } else {
+        OsalSemPost(&hpmSpiDev->doneSem);
+    }
+}
+
+/* One of the completion events of the current segment, the last one moves on to the next segment */
+static void HpmSpiSegmentEvent(struct HPMSpiDevice *hpmSpiDev)
+{
+    struct HpmSpiXfer *xfer = &hpmSpiDev->xfer;
+
+    if ((xfer->msgs == NULL) || (--xfer->pending != 0)) {
+        return;
+    }
+
+    struct SpiMsg *msg = &xfer->msgs[xfer->idx];
+    if ((msg->rbuf != NULL) && xfer->rxBounce) {
+        HpmDmaPortCacheInvalidate(hpmSpiDev->rxBounceBuf, xfer->seg);
+        (void)memcpy_s(&msg->rbuf[xfer->off], msg->len - xfer->off, hpmSpiDev->rxBounceBuf, xfer->seg);
+    }
+
+    xfer->off += xfer->seg;
+    if (xfer->off >= msg->len) {
+        if (!msg->keepCs) {
+            HpmSpiCsWrite(hpmSpiDev, true);
+        }
+        xfer->idx++;
+        xfer->off = 0;
+    }
+
+    if (xfer->idx >= xfer->count) {
+        HpmSpiXferFinish(hpmSpiDev, HDF_SUCCESS);
+        return;
+    }
+
+    if (HpmSpiSegmentStart(hpmSpiDev) != HDF_SUCCESS) {
+        HpmSpiXferFinish(hpmSpiDev, HDF_FAILURE);
+    }
+}
+
+static __attribute__((section(".interrupt.text"))) VOID HpmSpiIsr(VOID *parm)
+{
+    struct HPMSpiDevice *hpmSpiDev = (struct HPMSpiDevice *)parm;
+    SPI_Type *base = (SPI_Type *)hpmSpiDev->base;
+    uint32_t status = spi_get_interrupt_status(base);
+
+    spi_clear_interrupt_status(base, status);
+    if (status & spi_end_int) {
+        HpmSpiSegmentEvent(hpmSpiDev);
+    }
+}
+
+/* The end interrupt may beat rx dma moving the last fifo entries, the segment waits for this tc as well */
+static __attribute__((section(".interrupt.text"))) void HpmSpiRxDmaDone(DMA_Type *ptr, uint32_t channel,
+                                                                         void *cb_data_ptr)
+{
+    (void)ptr;
+    (void)channel;
+    HpmSpiSegmentEvent((struct HPMSpiDevice *)cb_data_ptr);
+}
+
+static __attribute__((section(".interrupt.text"))) void HpmSpiRxDmaError(DMA_Type *ptr, uint32_t channel,
+                                                                          void *cb_data_ptr)
+{
+    struct HPMSpiDevice *hpmSpiDev = (struct HPMSpiDevice *)cb_data_ptr;
+    (void)ptr;
+    (void)channel;
+
+    if (hpmSpiDev->xfer.msgs != NULL) {
+        dma_mgr_disable_channel(&hpmSpiDev->txDma);
+        HpmSpiXferFinish(hpmSpiDev, HDF_ERR_IO);
+    }
+}
+
+/* Caller holds busSem, completion is reported from the isr */
+static int32_t HpmSpiXferStart(struct HPMSpiDevice *hpmSpiDev, struct SpiMsg *msg, uint32_t count,
+                               HpmSpiDoneCb cb, void *cbArg)
+{
+    struct HpmSpiXfer *xfer = &hpmSpiDev->xfer;
+
+    xfer->msgs = msg;
+    xfer->count = count;
+    xfer->idx = 0;
+    xfer->off = 0;
+    xfer->status = HDF_SUCCESS;
+    xfer->cb = cb;
+    xfer->cbArg = cbArg;
+
+    uint32_t save = LOS_IntLock();
+    int32_t ret = HpmSpiSegmentStart(hpmSpiDev);
+    if (ret != HDF_SUCCESS) {
+        HpmSpiCsWrite(hpmSpiDev, true);
+        xfer->msgs = NULL;
+    }
+    LOS_IntRestore(save);
+
+    return ret;
+}
+
+static void HpmSpiXferAbort(struct HPMSpiDevice *hpmSpiDev)
+{
+    uint32_t save = LOS_IntLock();
+    dma_mgr_disable_channel(&hpmSpiDev->txDma);
+    dma_mgr_disable_channel(&hpmSpiDev->rxDma);
+    spi_disable_dma((SPI_Type *)hpmSpiDev->base, SPI_CTRL_TXDMAEN_MASK | SPI_CTRL_RXDMAEN_MASK);
+    HpmSpiCsWrite(hpmSpiDev, true);
+    hpmSpiDev->xfer.msgs = NULL;
+    LOS_IntRestore(save);
+
+    /* drop a completion that raced with the timeout */
+    while (OsalSemWait(&hpmSpiDev->doneSem, 0) == HDF_SUCCESS) {
+    }
+}
+
+/*
+ * Completion deadline of a queued transfer: the wire time at the clock each
+ * message runs at, doubled for the divider rounding and the gaps between
+ * segments, plus a margin for the isr and the waking task.
+ */
+static uint32_t HpmSpiXferTimeoutMs(const struct HPMSpiDevice *hpmSpiDev, const struct SpiMsg *msg, uint32_t count)
+{
+    uint32_t speedHz = hpmSpiDev->curSpeedHz;
+    uint64_t us = 0;
+    uint64_t ms;
+
+    for (uint32_t i = 0; i < count; i++) {
+        /* a message without a speed runs at the clock left by the one before */
+        speedHz = (msg[i].speed != 0) ? msg[i].speed : speedHz;
+        speedHz = (speedHz < HPM_SPI_XFER_TIMEOUT_SPEED_MIN_HZ) ? HPM_SPI_XFER_TIMEOUT_SPEED_MIN_HZ : speedHz;
+        us += ((uint64_t)msg[i].len * 8U * 1000000U + speedHz - 1U) / speedHz;
+    }
+
+    ms = (2U * us + 999U) / 1000U + HPM_SPI_XFER_TIMEOUT_MARGIN_MS;
+
+    return (ms >= HDF_WAIT_FOREVER) ? (HDF_WAIT_FOREVER - 1U) : (uint32_t)ms;
+}
+
+static bool HpmSpiUseDma(struct HPMSpiDevice *hpmSpiDev, struct SpiMsg *msg, uint32_t count)
+{
+    uint32_t total = 0;
+
+    if (!hpmSpiDev->isDmaReady) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        total += msg[i].len;
+    }
+
+    return (total >= hpmSpiDev->dmaMinLen) ? true : false;
 }
 
 
@@ -93,13 +451,13 @@ static int32_t HpmSpiSetCfg(struct SpiCntlr *cntlr, struct SpiCfg *cfg)
     return 0;
 }
 
-static int32_t HpmSpiTransfer(struct SpiCntlr *cntlr, struct SpiMsg *msg, uint32_t count)
+/* Polled path for short transfers or when no dma is available */
+static int32_t HpmSpiTransferPolling(struct HPMSpiDevice *hpmSpiDev, struct SpiMsg *msg, uint32_t count)
 {
     int ret;
-    struct HPMSpiDevice *hpmSpiDev = (struct HPMSpiDevice *)cntlr->priv;
     SPI_Type *base = (SPI_Type *)hpmSpiDev->base;
 
-    spi_control_config_t config;
+    spi_control_config_t config = {0};
     spi_master_get_default_control_config(&config);
     uint32_t rLen;
     uint32_t wLen;
@@ -107,38 +465,188 @@ static int32_t HpmSpiTransfer(struct SpiCntlr *cntlr, struct SpiMsg *msg, uint32
     for (int i = 0; i < count; i++) {
         if (msg[i].wbuf && msg[i].rbuf) {
             config.common_config.trans_mode = spi_trans_write_read_together;
-            rLen = msg[i].len;
-            wLen = msg[i].len;
-
         } else if (msg[i].wbuf && !msg[i].rbuf) {
             config.common_config.trans_mode = spi_trans_write_only;
-            rLen = 0;
-            wLen = msg[i].len;
         } else if (!msg[i].wbuf && msg[i].rbuf) {
             config.common_config.trans_mode = spi_trans_read_only;
-            rLen = msg[i].len;
-            wLen = 0;
         } else {
             return -1;
         }
-        
-        ret = spi_transfer(base, &config, NULL, NULL,
-                        msg[i].wbuf, wLen,  msg[i].rbuf, rLen);
-        if (ret != status_success) {
-            return -1;
+
+        HpmSpiSetSpeed(hpmSpiDev, msg[i].speed);
+        HpmSpiCsWrite(hpmSpiDev, false);
+        for (uint32_t off = 0; off < msg[i].len; off += HPM_SPI_SEG_MAX) {
+            uint32_t seg = msg[i].len - off;
+            seg = (seg > HPM_SPI_SEG_MAX) ? HPM_SPI_SEG_MAX : seg;
+            rLen = msg[i].rbuf ? seg : 0;
+            wLen = msg[i].wbuf ? seg : 0;
+
+            ret = spi_transfer(base, &config, NULL, NULL,
+                            msg[i].wbuf ? &msg[i].wbuf[off] : NULL, wLen,
+                            msg[i].rbuf ? &msg[i].rbuf[off] : NULL, rLen);
+            if (ret != status_success) {
+                HpmSpiCsWrite(hpmSpiDev, true);
+                return -1;
+            }
+        }
+        if (!msg[i].keepCs || (i == count - 1)) {
+            HpmSpiCsWrite(hpmSpiDev, true);
         }
     }
-    
+
     return 0;
 }
 
+static int32_t HpmSpiTransfer(struct SpiCntlr *cntlr, struct SpiMsg *msg, uint32_t count)
+{
+    struct HPMSpiDevice *hpmSpiDev = (struct HPMSpiDevice *)cntlr->priv;
+    int32_t ret;
+
+    if ((msg == NULL) || (count == 0)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+
+    ret = HpmSpiCheckCs(msg, count);
+    if (ret != HDF_SUCCESS) {
+        HDF_LOGE("Transfer: spi%u cannot hold cs without direct io\n", hpmSpiDev->id);
+        return ret;
+    }
+
+    OsalSemWait(&hpmSpiDev->busSem, HDF_WAIT_FOREVER);
+    if (!HpmSpiUseDma(hpmSpiDev, msg, count)) {
+        ret = HpmSpiTransferPolling(hpmSpiDev, msg, count);
+        OsalSemPost(&hpmSpiDev->busSem);
+        return ret;
+    }
+
+    uint32_t timeoutMs = HpmSpiXferTimeoutMs(hpmSpiDev, msg, count);
+    ret = HpmSpiXferStart(hpmSpiDev, msg, count, NULL, NULL);
+    if (ret == HDF_SUCCESS) {
+        /* the calling task sleeps, the isr walks the message array */
+        if (OsalSemWait(&hpmSpiDev->doneSem, timeoutMs) != HDF_SUCCESS) {
+            HDF_LOGE("Transfer: spi%u timeout\n", hpmSpiDev->id);
+            HpmSpiXferAbort(hpmSpiDev);
+            ret = HDF_ERR_TIMEOUT;
+        } else {
+            ret = hpmSpiDev->xfer.status;
+        }
+    }
+    OsalSemPost(&hpmSpiDev->busSem);
+
+    return (ret == HDF_SUCCESS) ? 0 : -1;
+}
+
+int32_t HpmSpiTransferAsync(uint32_t busNum, struct SpiMsg *msg, uint32_t count, HpmSpiDoneCb cb, void *arg)
+{
+    if ((busNum >= HPM_SPI_MAX_NUM) || (g_hpmSpiDevs[busNum] == NULL) || (msg == NULL) || (count == 0) ||
+        (cb == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+
+    struct HPMSpiDevice *hpmSpiDev = g_hpmSpiDevs[busNum];
+    if (!hpmSpiDev->isDmaReady || (HpmSpiCheckCs(msg, count) != HDF_SUCCESS)) {
+        return HDF_ERR_NOT_SUPPORT;
+    }
+
+    if (OsalSemWait(&hpmSpiDev->busSem, 0) != HDF_SUCCESS) {
+        return HDF_ERR_DEVICE_BUSY;
+    }
+
+    int32_t ret = HpmSpiXferStart(hpmSpiDev, msg, count, cb, arg);
+    if (ret != HDF_SUCCESS) {
+        OsalSemPost(&hpmSpiDev->busSem);
+    }
+
+    return ret;
+}
+
+static void HpmSpiDmaRelease(struct HPMSpiDevice *hpmSpiDev)
+{
+    if (!hpmSpiDev->isDmaReady) {
+        return;
+    }
+
+    spi_disable_interrupt((SPI_Type *)hpmSpiDev->base, spi_end_int);
+    LOS_HwiDisable(HPM2LITEOS_IRQ(hpmSpiDev->irq));
+    LOS_HwiDelete(HPM2LITEOS_IRQ(hpmSpiDev->irq), NULL);
+    dma_mgr_release_resource(&hpmSpiDev->rxDma);
+    dma_mgr_release_resource(&hpmSpiDev->txDma);
+    OsalMemFree(hpmSpiDev->rxBounceBuf);
+    hpmSpiDev->rxBounceBuf = NULL;
+    hpmSpiDev->isDmaReady = 0;
+}
+
+static int32_t HpmSpiDmaAcquire(struct HPMSpiDevice *hpmSpiDev)
+{
+    if ((hpmSpiDev->dmaRxSrc == HPM_SPI_DMA_SRC_NONE) || (hpmSpiDev->dmaTxSrc == HPM_SPI_DMA_SRC_NONE) ||
+        (HpmDmaPortInit() != HDF_SUCCESS)) {
+        return HDF_ERR_NOT_SUPPORT;
+    }
+
+    hpmSpiDev->rxBounceBuf = (uint8_t *)OsalMemAllocAlign(HPM_L1C_CACHELINE_SIZE, HPM_SPI_RX_BOUNCE_SIZE);
+    if (hpmSpiDev->rxBounceBuf == NULL) {
+        return HDF_ERR_MALLOC_FAIL;
+    }
+
+    if (dma_mgr_request_resource(&hpmSpiDev->rxDma) != status_success) {
+        goto ERROR1;
+    }
+
+    if (dma_mgr_request_resource(&hpmSpiDev->txDma) != status_success) {
+        goto ERROR2;
+    }
+    dma_mgr_install_chn_tc_callback(&hpmSpiDev->rxDma, HpmSpiRxDmaDone, hpmSpiDev);
+    dma_mgr_install_chn_error_callback(&hpmSpiDev->rxDma, HpmSpiRxDmaError, hpmSpiDev);
+
+    HwiIrqParam irqParam;
+    irqParam.pDevId = hpmSpiDev;
+    if (LOS_HwiCreate(HPM2LITEOS_IRQ(hpmSpiDev->irq), 1, 0, (HWI_PROC_FUNC)HpmSpiIsr, &irqParam) != LOS_OK) {
+        goto ERROR3;
+    }
+    LOS_HwiEnable(HPM2LITEOS_IRQ(hpmSpiDev->irq));
+    spi_enable_interrupt((SPI_Type *)hpmSpiDev->base, spi_end_int);
+
+#if HPM_SPI_CS_BY_DIRECTIO
+    spi_directio_write((SPI_Type *)hpmSpiDev->base, cs_pin, true);
+    spi_directio_enable_output((SPI_Type *)hpmSpiDev->base, cs_pin);
+    spi_enable_directio((SPI_Type *)hpmSpiDev->base);
+#endif
+
+    hpmSpiDev->isDmaReady = 1;
+    return HDF_SUCCESS;
+
+ERROR3:
+    dma_mgr_release_resource(&hpmSpiDev->txDma);
+ERROR2:
+    dma_mgr_release_resource(&hpmSpiDev->rxDma);
+ERROR1:
+    OsalMemFree(hpmSpiDev->rxBounceBuf);
+    hpmSpiDev->rxBounceBuf = NULL;
+    HDF_LOGE("Open: spi%u no dma resource, fall back to polling\n", hpmSpiDev->id);
+    return HDF_ERR_DEVICE_BUSY;
+}
+
 static int32_t HpmSpiOpen(struct SpiCntlr *cntlr)
 {
+    struct HPMSpiDevice *hpmSpiDev = (struct HPMSpiDevice *)cntlr->priv;
+
+    if (hpmSpiDev->openCnt++ == 0) {
+        (void)HpmSpiDmaAcquire(hpmSpiDev);
+    }
+
     return 0;
 }
 
 static int32_t HpmSpiClose(struct SpiCntlr *cntlr)
 {
+    struct HPMSpiDevice *hpmSpiDev = (struct HPMSpiDevice *)cntlr->priv;
+
+    if ((hpmSpiDev->openCnt != 0) && (--hpmSpiDev->openCnt == 0)) {
+        OsalSemWait(&hpmSpiDev->busSem, HDF_WAIT_FOREVER);
+        HpmSpiDmaRelease(hpmSpiDev);
+        OsalSemPost(&hpmSpiDev->busSem);
+    }
+
     return 0;
 }
 
@@ -185,6 +693,9 @@ static int32_t SpiDriverInit(struct HdfDeviceObject *device)
         goto ERROR1;
     }
 
+    OsalSemInit(&hpmSpiDev->busSem, 1);
+    OsalSemInit(&hpmSpiDev->doneSem, 0);
+
     struct DeviceResourceIface *dri = DeviceResourceGetIfaceInstance(HDF_CONFIG_SOURCE);
     if (dri == NULL) {
         ret = HDF_FAILURE;
@@ -195,6 +706,10 @@ static int32_t SpiDriverInit(struct HdfDeviceObject *device)
     dri->GetUint32(device->property, "id", &hpmSpiDev->id, 0);
     dri->GetUint32(device->property, "base", &hpmSpiDev->base, 0);
     dri->GetUint32(device->property, "clk_freq", &hpmSpiDev->clkFreq, 0);
+    dri->GetUint32(device->property, "irq_num", &hpmSpiDev->irq, 0);
+    dri->GetUint32(device->property, "dma_rx_src", &hpmSpiDev->dmaRxSrc, HPM_SPI_DMA_SRC_NONE);
+    dri->GetUint32(device->property, "dma_tx_src", &hpmSpiDev->dmaTxSrc, HPM_SPI_DMA_SRC_NONE);
+    dri->GetUint32(device->property, "dma_min_len", &hpmSpiDev->dmaMinLen, HPM_SPI_DMA_MIN_LEN_DEFAULT);
     HDF_LOGI("Init: hpmSpiDev->id: %u\n", hpmSpiDev->id);
     HDF_LOGI("Init: hpmSpiDev->base: 0x%X\n", hpmSpiDev->base);
     HDF_LOGI("Init: hpmSpiDev->clkFreq: %u\n", hpmSpiDev->clkFreq);
@@ -202,10 +717,15 @@ static int32_t SpiDriverInit(struct HdfDeviceObject *device)
     cntlr->busNum = hpmSpiDev->id;
     cntlr->priv = hpmSpiDev;
     cntlr->method = &spiCntlrMethod;
+    if (hpmSpiDev->id < HPM_SPI_MAX_NUM) {
+        g_hpmSpiDevs[hpmSpiDev->id] = hpmSpiDev;
+    }
 
     return ret;
 
 ERROR2:
+    OsalSemDestroy(&hpmSpiDev->doneSem);
+    OsalSemDestroy(&hpmSpiDev->busSem);
     OsalMemFree(hpmSpiDev);
 ERROR1:
     return ret;
@@ -226,6 +746,12 @@ static void SpiDriverRelease(struct HdfDeviceObject *device)
     struct HPMSpiDevice *hpmSpiDev = (struct HPMSpiDevice *)cntlr->priv;
 
     if (hpmSpiDev) {
+        HpmSpiDmaRelease(hpmSpiDev);
+        if (hpmSpiDev->id < HPM_SPI_MAX_NUM) {
+            g_hpmSpiDevs[hpmSpiDev->id] = NULL;
+        }
+        OsalSemDestroy(&hpmSpiDev->doneSem);
+        OsalSemDestroy(&hpmSpiDev->busSem);
         OsalMemFree(hpmSpiDev);
     }
     
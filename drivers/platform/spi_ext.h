@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HPM_SPI_EXT_H
+#define HPM_SPI_EXT_H
+
+#include <stdint.h>
+#include "spi_if.h"
+
+/* Called from interrupt context once the whole message array is done */
+typedef void (*HpmSpiDoneCb)(uint32_t busNum, int32_t status, void *arg);
+
+/*
+ * Queue a message array on spi <busNum> and return at once, the messages and
+ * their buffers must stay valid until <cb>. Needs the bus opened with dma
+ * available; returns HDF_ERR_DEVICE_BUSY while another transfer owns the bus.
+ * On SoCs without spi direct io, keepCs and messages longer than one spi
+ * transaction are refused with HDF_ERR_NOT_SUPPORT, as Transfer() does.
+ */
+int32_t HpmSpiTransferAsync(uint32_t busNum, struct SpiMsg *msg, uint32_t count, HpmSpiDoneCb cb, void *arg);
+
+#endif
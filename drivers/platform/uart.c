@@ -15,78 +15,383 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include "securec.h"
 #include "device_resource_if.h"
 #include "hdf_device_desc.h"
 #include "osal_sem.h"
+#include "osal_mutex.h"
 #include "osal_mem.h"
+#include "osal_time.h"
 #include "hdf_log.h"
 #include "uart_if.h"
 #include "uart_core.h"
 #include "hpm_uart_drv.h"
+#include "hpm_l1c_drv.h"
+#include "dma_port.h"
+#include "uart_ext.h"
 #include <los_interrupt.h>
 
 #define HDF_LOG_TAG HPMICRO_UART_HDF
-#define HPM_QUEUE_SIZE 64
+#define HPM_UART_MAX_NUM 16
+#define HPM_UART_RX_BUF_SIZE_DEFAULT 256
+#define HPM_UART_RX_BUF_SIZE_MIN 16
+#define HPM_UART_TX_BUF_SIZE_DEFAULT 512
+#define HPM_UART_TX_BUF_SIZE_MIN 16
+#define HPM_UART_TX_WAIT_MS 1000
+#define HPM_UART_DMA_SRC_NONE 0xFF
+#define HPM_UART_RX_DMA_BUF_SIZE_MIN 256
+#define HPM_UART_RX_DMA_BUF_SIZE_MAX 16384
+#define HPM_UART_RX_DMA_LAP_MS 20
+#define HPM_UART_CHAR_BITS_MIN 7
+#define HPM_UART_RX_DMA_POLL_MS 2
+#define HPM_UART_RX_WAIT_FOREVER 0xFFFFFFFF
 
+/*
+ * Single producer (rx isr, or rx dma harvest under int lock) / single consumer
+ * (Read) ring, wr and rd are free running and only written by their owner.
+ */
 struct UartQueue {
-    uint8_t buf[HPM_QUEUE_SIZE];
-    uint16_t wr;
-    uint16_t rd;
+    uint8_t *buf;
+    uint32_t mask;
+    volatile uint32_t wr;
+    volatile uint32_t rd;
+    volatile uint32_t rxBytes;
+    volatile uint32_t swOverflow;
+    volatile uint32_t hwOverrun;
+};
+
+/*
+ * Single producer (Write) / single consumer (tx isr or dma completion) ring,
+ * wr and rd are free running and only written by their owner.
+ */
+struct UartTxRing {
+    uint8_t *buf;
+    uint32_t mask;
+    volatile uint32_t wr;
+    volatile uint32_t rd;
 };
 
 struct HPMUartDevice {
     struct OsalSem rxSem;
+    struct OsalSem txSem;
+    struct OsalMutex txMutex;
     struct UartQueue rxQueue;
+    struct UartTxRing txRing;
+    dma_resource_t rxDma;
+    dma_resource_t txDma;
+    dma_mgr_linked_descriptor_t *rxDmaDesc;
+    uint8_t *rxDmaBuf;
+    uint32_t rxDmaBufSize;
+    uint32_t rxDmaRd;
+    uint32_t rxDmaLaps;
+    volatile uint32_t rxDmaWraps;
+    volatile uint32_t txDmaLen;
+    volatile uint32_t txDmaErrors;
     uint32_t id;
     uint32_t base;
     uint32_t irq;
     uint32_t clkFreq;
+    uint32_t rxBufSize;
+    uint32_t txBufSize;
+    uint32_t dmaRxSrc;
+    uint32_t dmaTxSrc;
     struct UartAttribute attribute;
     uint32_t baudRate;
     uint8_t isRxBlock;
     uint8_t isRxDmaEn;
     uint8_t isTxDmaEn;
+    uint8_t isRxDmaRun;
+    uint8_t isTxDmaRun;
+    volatile uint8_t txWait;
+    volatile uint8_t rxIdle;
+    uint32_t rxTimeoutMs;
+    uint32_t rxIdleMs;
 };
 
-static uint32_t queue_get_cnt(struct UartQueue *q) 
+static struct HPMUartDevice *g_hpmUartDevs[HPM_UART_MAX_NUM];
+
+static inline uint32_t queue_get_cnt(struct UartQueue *q)
 {
-    return (q->wr + HPM_QUEUE_SIZE - q->rd) % HPM_QUEUE_SIZE;
+    return q->wr - q->rd;
 }
 
-static int queue_push(struct UartQueue *q, uint8_t *data, uint16_t len) 
+/* Producer side, drops what does not fit instead of overwriting unread data */
+static uint32_t queue_push(struct UartQueue *q, const uint8_t *data, uint32_t len)
 {
-    uint32_t save = LOS_IntLock();
-    for (int i = 0; i < len; i++) {
-        q->buf[q->wr] = data[i];
-        q->wr++;
-        q->wr %= HPM_QUEUE_SIZE;
-
-        /* overflow */
-        if (q->wr == q->rd) {
-            q->rd++;
-            q->wr %= HPM_QUEUE_SIZE;
+    uint32_t wr = q->wr;
+    uint32_t space = q->mask + 1 - (wr - q->rd);
+
+    if (len > space) {
+        q->swOverflow += len - space;
+        len = space;
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        q->buf[(wr + i) & q->mask] = data[i];
+    }
+
+    __sync_synchronize();
+    q->wr = wr + len;
+    q->rxBytes += len;
+
+    return len;
+}
+
+/* Consumer side */
+static uint32_t queue_pop(struct UartQueue *q, uint8_t *data, uint32_t len)
+{
+    uint32_t rd = q->rd;
+    uint32_t max = q->wr - rd;
+
+    max = max > len ? len : max;
+
+    for (uint32_t i = 0; i < max; i++) {
+        data[i] = q->buf[(rd + i) & q->mask];
+    }
+
+    __sync_synchronize();
+    q->rd = rd + max;
+
+    return max;
+}
+
+/* Drain the whole rx fifo into the ring in one pass, returns bytes read */
+static uint32_t UartRxDrain(struct HPMUartDevice *hpmUartDev, UART_Type *base)
+{
+    struct UartQueue *q = &hpmUartDev->rxQueue;
+    uint32_t wr = q->wr;
+    uint32_t end = q->rd + q->mask + 1;
+    uint32_t cnt = 0;
+    uint8_t lsr;
+
+    while ((lsr = uart_get_status(base)) & uart_stat_data_ready) {
+        uint8_t c = uart_read_byte(base);
+
+        if (lsr & uart_stat_overrun_error) {
+            q->hwOverrun++;
         }
+
+        if (wr != end) {
+            q->buf[wr & q->mask] = c;
+            wr++;
+        } else {
+            q->swOverflow++;
+        }
+        cnt++;
+    }
+
+    __sync_synchronize();
+    q->rxBytes += wr - q->wr;
+    q->wr = wr;
+
+    return cnt;
+}
+
+int32_t HpmUartGetRxStats(uint32_t port, struct HpmUartRxStats *stats)
+{
+    if ((port >= HPM_UART_MAX_NUM) || (g_hpmUartDevs[port] == NULL) || (stats == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+
+    struct UartQueue *q = &g_hpmUartDevs[port]->rxQueue;
+    stats->rxBytes = q->rxBytes;
+    stats->swOverflow = q->swOverflow;
+    stats->hwOverrun = q->hwOverrun;
+
+    return HDF_SUCCESS;
+}
+
+int32_t HpmUartSetReadTimeout(uint32_t port, uint32_t timeoutMs, uint32_t idleMs)
+{
+    if ((port >= HPM_UART_MAX_NUM) || (g_hpmUartDevs[port] == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+
+    g_hpmUartDevs[port]->rxTimeoutMs = timeoutMs;
+    g_hpmUartDevs[port]->rxIdleMs = idleMs;
+
+    return HDF_SUCCESS;
+}
+
+int32_t HpmUartClearRxStats(uint32_t port)
+{
+    if ((port >= HPM_UART_MAX_NUM) || (g_hpmUartDevs[port] == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
     }
+
+    struct UartQueue *q = &g_hpmUartDevs[port]->rxQueue;
+    uint32_t save = LOS_IntLock();
+    q->rxBytes = 0;
+    q->swOverflow = 0;
+    q->hwOverrun = 0;
     LOS_IntRestore(save);
 
-    return 0;
+    return HDF_SUCCESS;
 }
 
-static uint16_t queue_pop(struct UartQueue *q, uint8_t *data, uint16_t len) 
+static inline uint32_t tx_ring_get_cnt(struct UartTxRing *r)
 {
+    return r->wr - r->rd;
+}
+
+static inline uint32_t tx_ring_get_free(struct UartTxRing *r)
+{
+    return r->mask + 1 - tx_ring_get_cnt(r);
+}
+
+static void UartTxWakeWriter(struct HPMUartDevice *hpmUartDev)
+{
+    if (hpmUartDev->txWait) {
+        hpmUartDev->txWait = 0;
+        OsalSemPost(&hpmUartDev->txSem);
+    }
+}
+
+/* Refill tx fifo from the ring, called in isr with THR empty */
+static void UartTxFill(struct HPMUartDevice *hpmUartDev, UART_Type *base)
+{
+    struct UartTxRing *r = &hpmUartDev->txRing;
+    uint32_t cnt = tx_ring_get_cnt(r);
+    uint32_t fifo = uart_get_fifo_size(base);
+    uint32_t rd = r->rd;
+
+    cnt = cnt > fifo ? fifo : cnt;
+    for (uint32_t i = 0; i < cnt; i++) {
+        uart_write_byte(base, r->buf[rd & r->mask]);
+        rd++;
+    }
+    r->rd = rd;
+
+    if (tx_ring_get_cnt(r) == 0) {
+        uart_disable_irq(base, uart_intr_tx_slot_avail);
+    }
+
+    UartTxWakeWriter(hpmUartDev);
+}
+
+/* Start dma for the contiguous part of the ring, caller holds the int lock */
+static void UartTxDmaKick(struct HPMUartDevice *hpmUartDev)
+{
+    struct UartTxRing *r = &hpmUartDev->txRing;
+    UART_Type *base = (UART_Type *)hpmUartDev->base;
+    uint32_t cnt = tx_ring_get_cnt(r);
+    uint32_t offset = r->rd & r->mask;
+    dma_mgr_chn_conf_t config;
+
+    if ((hpmUartDev->txDmaLen != 0) || (cnt == 0)) {
+        return;
+    }
+
+    if (cnt > r->mask + 1 - offset) {
+        cnt = r->mask + 1 - offset;
+    }
+
+    dma_mgr_get_default_chn_config(&config);
+    config.en_dmamux = true;
+    config.dmamux_src = hpmUartDev->dmaTxSrc;
+    config.src_addr = HpmDmaPortSysAddr(&r->buf[offset]);
+    config.dst_addr = (uint32_t)&base->THR;
+    config.src_addr_ctrl = DMA_MGR_ADDRESS_CONTROL_INCREMENT;
+    config.dst_addr_ctrl = DMA_MGR_ADDRESS_CONTROL_FIXED;
+    config.dst_mode = DMA_MGR_HANDSHAKE_MODE_HANDSHAKE;
+    config.size_in_byte = cnt;
+    config.interrupt_mask = DMA_MGR_INTERRUPT_MASK_ABORT | DMA_MGR_INTERRUPT_MASK_HALF_TC;
+
+    hpmUartDev->txDmaLen = cnt;
+    dma_mgr_setup_channel(&hpmUartDev->txDma, &config);
+    dma_mgr_enable_channel(&hpmUartDev->txDma);
+}
+
+static __attribute__((section(".interrupt.text"))) void UartTxDmaDone(DMA_Type *ptr, uint32_t channel,
+                                                                       void *cb_data_ptr)
+{
+    struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)cb_data_ptr;
+    (void)ptr;
+    (void)channel;
+
+    hpmUartDev->txRing.rd += hpmUartDev->txDmaLen;
+    hpmUartDev->txDmaLen = 0;
+    UartTxDmaKick(hpmUartDev);
+    UartTxWakeWriter(hpmUartDev);
+}
+
+/* The channel stopped on a bus error: keep what went out and restart from the first unsent byte */
+static __attribute__((section(".interrupt.text"))) void UartTxDmaError(DMA_Type *ptr, uint32_t channel,
+                                                                        void *cb_data_ptr)
+{
+    struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)cb_data_ptr;
+    uint32_t remaining = hpmUartDev->txDmaLen;
+    (void)ptr;
+    (void)channel;
+
+    (void)dma_mgr_get_chn_remaining_transize(&hpmUartDev->txDma, &remaining);
+    if (remaining > hpmUartDev->txDmaLen) {
+        remaining = hpmUartDev->txDmaLen;
+    }
+    hpmUartDev->txDmaErrors++;
+    hpmUartDev->txRing.rd += hpmUartDev->txDmaLen - remaining;
+    hpmUartDev->txDmaLen = 0;
+    UartTxDmaKick(hpmUartDev);
+    UartTxWakeWriter(hpmUartDev);
+}
+
+/*
+ * Move the bytes written by the circular rx dma since the last call into the rx queue. The write
+ * position alone cannot tell a full lap from no data, so the wraps reported by tc are compared with
+ * the laps the reader went through. Up to one buffer of unread data is intact, more means the dma
+ * went round over unread data.
+ */
+static void UartRxDmaHarvest(struct HPMUartDevice *hpmUartDev)
+{
+    uint32_t remaining = 0;
     uint32_t save = LOS_IntLock();
-    uint32_t max = queue_get_cnt(q);
 
-    max = max > len? len : max;
+    if (hpmUartDev->isRxDmaRun &&
+        (dma_mgr_get_chn_remaining_transize(&hpmUartDev->rxDma, &remaining) == status_success)) {
+        uint32_t size = hpmUartDev->rxDmaBufSize;
+        uint32_t pos = (size - remaining) & (size - 1);
+        uint32_t rd = hpmUartDev->rxDmaRd;
+        uint32_t wraps = hpmUartDev->rxDmaWraps - hpmUartDev->rxDmaLaps;
+        uint32_t unread;
+
+        if (wraps == 0) {
+            /* a tc still pending behind the int lock is counted by the position, and matched when it runs */
+            unread = (pos >= rd) ? (pos - rd) : (size + pos - rd);
+        } else {
+            unread = wraps * size + pos - rd;
+        }
 
-    for (int i = 0; i < max; i++) {
-        data[i] = q->buf[q->rd];
-        q->rd++;
-        q->rd %= HPM_QUEUE_SIZE;
+        if (unread > size) {
+            /* lapped: the buffer is being overwritten, drop everything written since */
+            hpmUartDev->rxQueue.swOverflow += unread;
+            hpmUartDev->rxDmaLaps = hpmUartDev->rxDmaWraps;
+            hpmUartDev->rxDmaRd = pos;
+        } else if (unread != 0) {
+            HpmDmaPortCacheInvalidate(hpmUartDev->rxDmaBuf, size);
+            if (rd + unread > size) {
+                queue_push(&hpmUartDev->rxQueue, &hpmUartDev->rxDmaBuf[rd], size - rd);
+                queue_push(&hpmUartDev->rxQueue, hpmUartDev->rxDmaBuf, rd + unread - size);
+            } else {
+                queue_push(&hpmUartDev->rxQueue, &hpmUartDev->rxDmaBuf[rd], unread);
+            }
+            hpmUartDev->rxDmaLaps += (rd + unread) / size;
+            hpmUartDev->rxDmaRd = pos;
+        }
     }
 
     LOS_IntRestore(save);
-    return max;
+}
+
+static __attribute__((section(".interrupt.text"))) void UartRxDmaWrap(DMA_Type *ptr, uint32_t channel,
+                                                                       void *cb_data_ptr)
+{
+    struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)cb_data_ptr;
+    (void)ptr;
+    (void)channel;
+
+    hpmUartDev->rxDmaWraps++;
+    UartRxDmaHarvest(hpmUartDev);
+    OsalSemPost(&hpmUartDev->rxSem);
 }
 
 static __attribute__((section(".interrupt.text"))) VOID HpmUartIsr(VOID *parm)
@@ -95,20 +400,175 @@ static __attribute__((section(".interrupt.text"))) VOID HpmUartIsr(VOID *parm)
     struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)host->priv;
     UART_Type *base = (UART_Type *)hpmUartDev->base;
 
-    if (uart_get_irq_id(base) & uart_intr_id_rx_data_avail) {
-        uint8_t c;
-        if (status_success == uart_receive_byte(base, &c)) {
-            queue_push(&hpmUartDev->rxQueue, &c, 1);
+    uint8_t id = uart_get_irq_id(base);
+
+    /* rx fifo trigger or rx timeout: take the whole burst, wake the reader once */
+    if ((id == uart_intr_id_rx_data_avail) || (id == uart_intr_id_rx_timeout) ||
+        (id == uart_intr_id_rx_line_stat)) {
+        /* rx timeout means the line went quiet with data in the fifo: end of a frame */
+        hpmUartDev->rxIdle = (id == uart_intr_id_rx_timeout) ? 1 : 0;
+        if (UartRxDrain(hpmUartDev, base) != 0) {
             OsalSemPost(&hpmUartDev->rxSem);
         }
     }
+
+    if ((uart_get_enabled_irq(base) & uart_intr_tx_slot_avail) &&
+        uart_check_status(base, uart_stat_tx_slot_avail)) {
+        UartTxFill(hpmUartDev, base);
+    }
+}
+
+static void UartRxDmaStop(struct HPMUartDevice *hpmUartDev)
+{
+    if (!hpmUartDev->isRxDmaRun) {
+        return;
+    }
+
+    dma_mgr_disable_channel(&hpmUartDev->rxDma);
+    UartRxDmaHarvest(hpmUartDev);
+    hpmUartDev->isRxDmaRun = 0;
+    dma_mgr_release_resource(&hpmUartDev->rxDma);
+    OsalMemFree(hpmUartDev->rxDmaDesc);
+    OsalMemFree(hpmUartDev->rxDmaBuf);
+    hpmUartDev->rxDmaDesc = NULL;
+    hpmUartDev->rxDmaBuf = NULL;
+}
+
+/* Power of 2 buffer holding HPM_UART_RX_DMA_LAP_MS of line time at the shortest character */
+static uint32_t UartRxDmaBufSize(const struct HPMUartDevice *hpmUartDev)
+{
+    uint32_t bytes = hpmUartDev->baudRate / HPM_UART_CHAR_BITS_MIN * HPM_UART_RX_DMA_LAP_MS / 1000;
+    uint32_t size = HPM_UART_RX_DMA_BUF_SIZE_MIN;
+
+    while ((size < bytes) && (size < HPM_UART_RX_DMA_BUF_SIZE_MAX)) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+/* Circular rx dma: one descriptor linked to itself, tc fires on every wrap */
+static int32_t UartRxDmaStart(struct HPMUartDevice *hpmUartDev)
+{
+    UART_Type *base = (UART_Type *)hpmUartDev->base;
+    dma_mgr_chn_conf_t config;
+
+    if (hpmUartDev->isRxDmaRun) {
+        return HDF_SUCCESS;
+    }
+
+    if (hpmUartDev->dmaRxSrc == HPM_UART_DMA_SRC_NONE) {
+        HDF_LOGE("RxDmaStart: uart%u has no rx dma source\n", hpmUartDev->id);
+        return HDF_ERR_NOT_SUPPORT;
+    }
+
+    hpmUartDev->rxDmaBufSize = UartRxDmaBufSize(hpmUartDev);
+    hpmUartDev->rxDmaBuf = (uint8_t *)OsalMemAllocAlign(HPM_L1C_CACHELINE_SIZE, hpmUartDev->rxDmaBufSize);
+    hpmUartDev->rxDmaDesc = (dma_mgr_linked_descriptor_t *)OsalMemAllocAlign(HPM_L1C_CACHELINE_SIZE,
+        HPM_L1C_CACHELINE_ALIGN_UP(sizeof(dma_mgr_linked_descriptor_t)));
+    if ((hpmUartDev->rxDmaBuf == NULL) || (hpmUartDev->rxDmaDesc == NULL) ||
+        (dma_mgr_request_resource(&hpmUartDev->rxDma) != status_success)) {
+        HDF_LOGE("RxDmaStart: uart%u no dma resource\n", hpmUartDev->id);
+        OsalMemFree(hpmUartDev->rxDmaBuf);
+        OsalMemFree(hpmUartDev->rxDmaDesc);
+        hpmUartDev->rxDmaBuf = NULL;
+        hpmUartDev->rxDmaDesc = NULL;
+        return HDF_ERR_DEVICE_BUSY;
+    }
+
+    dma_mgr_get_default_chn_config(&config);
+    config.en_dmamux = true;
+    config.dmamux_src = hpmUartDev->dmaRxSrc;
+    config.src_addr = (uint32_t)&base->RBR;
+    config.dst_addr = HpmDmaPortSysAddr(hpmUartDev->rxDmaBuf);
+    config.src_addr_ctrl = DMA_MGR_ADDRESS_CONTROL_FIXED;
+    config.dst_addr_ctrl = DMA_MGR_ADDRESS_CONTROL_INCREMENT;
+    config.src_mode = DMA_MGR_HANDSHAKE_MODE_HANDSHAKE;
+    config.size_in_byte = hpmUartDev->rxDmaBufSize;
+    config.interrupt_mask = DMA_MGR_INTERRUPT_MASK_ABORT | DMA_MGR_INTERRUPT_MASK_HALF_TC;
+    config.linked_ptr = HpmDmaPortSysAddr(hpmUartDev->rxDmaDesc);
+
+    dma_mgr_config_linked_descriptor(&hpmUartDev->rxDma, &config, hpmUartDev->rxDmaDesc);
+    HpmDmaPortCacheWriteback(hpmUartDev->rxDmaDesc, sizeof(dma_mgr_linked_descriptor_t));
+    HpmDmaPortCacheInvalidate(hpmUartDev->rxDmaBuf, hpmUartDev->rxDmaBufSize);
+
+    dma_mgr_install_chn_tc_callback(&hpmUartDev->rxDma, UartRxDmaWrap, hpmUartDev);
+    dma_mgr_setup_channel(&hpmUartDev->rxDma, &config);
+    hpmUartDev->rxDmaRd = 0;
+    hpmUartDev->rxDmaLaps = 0;
+    hpmUartDev->rxDmaWraps = 0;
+    hpmUartDev->isRxDmaRun = 1;
+    dma_mgr_enable_channel(&hpmUartDev->rxDma);
+
+    return HDF_SUCCESS;
+}
+
+static void UartTxDmaStop(struct HPMUartDevice *hpmUartDev)
+{
+    if (!hpmUartDev->isTxDmaRun) {
+        return;
+    }
+
+    dma_mgr_disable_channel(&hpmUartDev->txDma);
+    dma_mgr_release_resource(&hpmUartDev->txDma);
+    hpmUartDev->txDmaLen = 0;
+    hpmUartDev->isTxDmaRun = 0;
+}
+
+static int32_t UartTxDmaStart(struct HPMUartDevice *hpmUartDev)
+{
+    if (hpmUartDev->isTxDmaRun) {
+        return HDF_SUCCESS;
+    }
+
+    if (hpmUartDev->dmaTxSrc == HPM_UART_DMA_SRC_NONE) {
+        HDF_LOGE("TxDmaStart: uart%u has no tx dma source\n", hpmUartDev->id);
+        return HDF_ERR_NOT_SUPPORT;
+    }
+
+    if (dma_mgr_request_resource(&hpmUartDev->txDma) != status_success) {
+        HDF_LOGE("TxDmaStart: uart%u no dma resource\n", hpmUartDev->id);
+        return HDF_ERR_DEVICE_BUSY;
+    }
+
+    dma_mgr_install_chn_tc_callback(&hpmUartDev->txDma, UartTxDmaDone, hpmUartDev);
+    dma_mgr_install_chn_error_callback(&hpmUartDev->txDma, UartTxDmaError, hpmUartDev);
+    hpmUartDev->txDmaLen = 0;
+    hpmUartDev->isTxDmaRun = 1;
+
+    return HDF_SUCCESS;
+}
+
+/* Wait until everything queued by Write() left the ring */
+static void UartTxDrain(struct HPMUartDevice *hpmUartDev)
+{
+    OsalMutexLock(&hpmUartDev->txMutex);
+    while (tx_ring_get_cnt(&hpmUartDev->txRing) != 0) {
+        uint32_t save = LOS_IntLock();
+        if (tx_ring_get_cnt(&hpmUartDev->txRing) == 0) {
+            LOS_IntRestore(save);
+            break;
+        }
+        hpmUartDev->txWait = 1;
+        LOS_IntRestore(save);
+        if (OsalSemWait(&hpmUartDev->txSem, HPM_UART_TX_WAIT_MS) != HDF_SUCCESS) {
+            HDF_LOGE("TxDrain: uart%u tx timeout\n", hpmUartDev->id);
+            break;
+        }
+    }
+    uart_flush((UART_Type *)hpmUartDev->base);
+    OsalMutexUnlock(&hpmUartDev->txMutex);
 }
 
 static void UartConfig(struct UartHost *host)
 {
     struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)host->priv;
     UART_Type *base = (UART_Type *)hpmUartDev->base;
-    uart_disable_irq(base, uart_intr_rx_data_avail_or_timeout);
+
+    UartTxDrain(hpmUartDev);
+    UartRxDmaStop(hpmUartDev);
+    UartTxDmaStop(hpmUartDev);
+    uart_disable_irq(base, uart_intr_rx_data_avail_or_timeout | uart_intr_tx_slot_avail);
 
     uart_config_t config = {0};
    
@@ -146,7 +606,21 @@ static void UartConfig(struct UartHost *host)
         config.parity = parity_none;
     }
 
-    uart_init(base, &config);  
+    config.dma_enable = (hpmUartDev->isRxDmaEn || hpmUartDev->isTxDmaEn) ? true : false;
+    /* interrupt rx takes bursts, the rx timeout interrupt picks up the tail */
+    config.rx_fifo_level = hpmUartDev->isRxDmaEn ? uart_rx_fifo_trg_not_empty : uart_rx_fifo_trg_gt_half;
+
+    uart_init(base, &config);
+
+    if (hpmUartDev->isTxDmaEn && (UartTxDmaStart(hpmUartDev) != HDF_SUCCESS)) {
+        hpmUartDev->isTxDmaEn = 0;
+    }
+
+    if (hpmUartDev->isRxDmaEn && (UartRxDmaStart(hpmUartDev) == HDF_SUCCESS)) {
+        return;
+    }
+
+    hpmUartDev->isRxDmaEn = 0;
     uart_enable_irq(base, uart_intr_rx_data_avail_or_timeout);
 }
 
@@ -160,6 +634,8 @@ static int32_t Init(struct UartHost *host)
     hpmUartDev->isTxDmaEn = 0;
     hpmUartDev->rxQueue.rd = 0;
     hpmUartDev->rxQueue.wr = 0;
+    hpmUartDev->txRing.rd = 0;
+    hpmUartDev->txRing.wr = 0;
     hpmUartDev->attribute.dataBits = UART_ATTR_DATABIT_8;
     hpmUartDev->attribute.parity = UART_ATTR_PARITY_NONE;
     hpmUartDev->attribute.stopBits = UART_ATTR_STOPBIT_1;
@@ -175,32 +651,139 @@ static int32_t Deinit(struct UartHost *host)
 {
     struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)host->priv;
     UART_Type *base = (UART_Type *)hpmUartDev->base;
-    uart_disable_irq(base, uart_intr_rx_data_avail_or_timeout);
+
+    UartTxDrain(hpmUartDev);
+    uart_disable_irq(base, uart_intr_rx_data_avail_or_timeout | uart_intr_tx_slot_avail);
+    UartRxDmaStop(hpmUartDev);
+    UartTxDmaStop(hpmUartDev);
 
     return 0;
 }
 
+/* Time the reader may sleep before one of the Read completion rules has to be rechecked */
+static uint32_t UartRxWaitMs(struct HPMUartDevice *hpmUartDev, uint64_t now, uint64_t start, uint64_t lastRx,
+                             uint32_t got)
+{
+    uint32_t wait = HPM_UART_RX_WAIT_FOREVER;
+
+    if (hpmUartDev->rxTimeoutMs != HPM_UART_RX_WAIT_FOREVER) {
+        uint64_t elapsed = now - start;
+        if (elapsed >= hpmUartDev->rxTimeoutMs) {
+            return 0;
+        }
+        wait = hpmUartDev->rxTimeoutMs - (uint32_t)elapsed;
+    }
+
+    if ((hpmUartDev->rxIdleMs != 0) && (got != 0)) {
+        uint64_t gap = now - lastRx;
+        if (gap >= hpmUartDev->rxIdleMs) {
+            return 0;
+        }
+        wait = (wait > hpmUartDev->rxIdleMs - (uint32_t)gap) ? (hpmUartDev->rxIdleMs - (uint32_t)gap) : wait;
+    }
+
+    if (hpmUartDev->isRxDmaRun) {
+        /* dma only signals on buffer wrap, poll the write position for partial data */
+        wait = (wait > HPM_UART_RX_DMA_POLL_MS) ? HPM_UART_RX_DMA_POLL_MS : wait;
+    }
+
+    return wait;
+}
+
+/*
+ * Blocking read returns on <size> bytes, on the read deadline or on an idle
+ * gap after data, see HpmUartSetReadTimeout(); it hands out what is buffered.
+ */
 static int32_t Read(struct UartHost *host, uint8_t *data, uint32_t size)
 {
     struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)host->priv;
+    struct UartQueue *q = &hpmUartDev->rxQueue;
+    uint32_t got;
+
+    UartRxDmaHarvest(hpmUartDev);
+    got = queue_pop(q, data, size);
+    if (!hpmUartDev->isRxBlock || (got >= size)) {
+        return got;
+    }
+
+    uint64_t start = OsalGetSysTimeMs();
+    uint64_t now = start;
+    uint64_t lastRx = start;
 
-    if (hpmUartDev->isRxBlock) {
-        while (queue_get_cnt(&hpmUartDev->rxQueue) < size) {
-            OsalSemWait(&hpmUartDev->rxSem, 10000);
+    while (got < size) {
+        if ((got != 0) && (hpmUartDev->rxIdleMs != 0) && hpmUartDev->rxIdle && (queue_get_cnt(q) == 0)) {
+            break;
+        }
+
+        uint32_t wait = UartRxWaitMs(hpmUartDev, now, start, lastRx, got);
+        if (wait == 0) {
+            break;
+        }
+
+        OsalSemWait(&hpmUartDev->rxSem, wait);
+        UartRxDmaHarvest(hpmUartDev);
+        uint32_t n = queue_pop(q, &data[got], size - got);
+        now = OsalGetSysTimeMs();
+        if (n != 0) {
+            got += n;
+            lastRx = now;
         }
     }
-    
-    return queue_pop(&hpmUartDev->rxQueue, data, size);
+
+    return got;
 }
 
+/*
+ * Queue data into the tx ring and return, the ring is drained by the THR empty
+ * interrupt or by dma. Only blocks while the ring is full.
+ */
 static int32_t Write(struct UartHost *host, uint8_t *data, uint32_t size)
 {
     struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)host->priv;
     UART_Type *base = (UART_Type *)hpmUartDev->base;
+    struct UartTxRing *r = &hpmUartDev->txRing;
+    uint32_t sent = 0;
+
+    OsalMutexLock(&hpmUartDev->txMutex);
+    while (sent < size) {
+        uint32_t save;
+        uint32_t len = tx_ring_get_free(r);
+
+        if (len == 0) {
+            save = LOS_IntLock();
+            if (tx_ring_get_free(r) == 0) {
+                hpmUartDev->txWait = 1;
+                LOS_IntRestore(save);
+                if (OsalSemWait(&hpmUartDev->txSem, HPM_UART_TX_WAIT_MS) != HDF_SUCCESS) {
+                    HDF_LOGE("Write: uart%u tx timeout\n", hpmUartDev->id);
+                    break;
+                }
+            } else {
+                LOS_IntRestore(save);
+            }
+            continue;
+        }
 
-    uart_send_data(base, data, size);
+        uint32_t wr = r->wr;
+        uint32_t offset = wr & r->mask;
+        len = (len > size - sent) ? (size - sent) : len;
+        len = (len > r->mask + 1 - offset) ? (r->mask + 1 - offset) : len;
+        (void)memcpy_s(&r->buf[offset], r->mask + 1 - offset, &data[sent], len);
+        sent += len;
+
+        save = LOS_IntLock();
+        r->wr = wr + len;
+        if (hpmUartDev->isTxDmaRun) {
+            HpmDmaPortCacheWriteback(&r->buf[offset], len);
+            UartTxDmaKick(hpmUartDev);
+        } else {
+            uart_enable_irq(base, uart_intr_tx_slot_avail);
+        }
+        LOS_IntRestore(save);
+    }
+    OsalMutexUnlock(&hpmUartDev->txMutex);
 
-    return size;
+    return sent;
 }
 
 static int32_t GetBaud(struct UartHost *host, uint32_t *baudRate)
@@ -307,6 +890,8 @@ static int32_t UartDriverInit(struct HdfDeviceObject *device)
     }
 
     OsalSemInit(&hpmUartDev->rxSem, 0);
+    OsalSemInit(&hpmUartDev->txSem, 0);
+    OsalMutexInit(&hpmUartDev->txMutex);
 
     struct DeviceResourceIface *dri = DeviceResourceGetIfaceInstance(HDF_CONFIG_SOURCE);
     if (dri == NULL) {
@@ -319,13 +904,50 @@ static int32_t UartDriverInit(struct HdfDeviceObject *device)
     dri->GetUint32(device->property, "base", &hpmUartDev->base, 0);
     dri->GetUint32(device->property, "irq_num", &hpmUartDev->irq, 0);
     dri->GetUint32(device->property, "clk_freq", &hpmUartDev->clkFreq, 0);
+    dri->GetUint32(device->property, "rx_timeout_ms", &hpmUartDev->rxTimeoutMs, HPM_UART_RX_WAIT_FOREVER);
+    dri->GetUint32(device->property, "rx_idle_ms", &hpmUartDev->rxIdleMs, 0);
+    dri->GetUint32(device->property, "rx_buf_size", &hpmUartDev->rxBufSize, HPM_UART_RX_BUF_SIZE_DEFAULT);
+    dri->GetUint32(device->property, "tx_buf_size", &hpmUartDev->txBufSize, HPM_UART_TX_BUF_SIZE_DEFAULT);
+    dri->GetUint32(device->property, "dma_rx_src", &hpmUartDev->dmaRxSrc, HPM_UART_DMA_SRC_NONE);
+    dri->GetUint32(device->property, "dma_tx_src", &hpmUartDev->dmaTxSrc, HPM_UART_DMA_SRC_NONE);
     HDF_LOGI("Init: hpmUartDev->id: %u\n", hpmUartDev->id);
     HDF_LOGI("Init: hpmUartDev->base: 0x%X\n", hpmUartDev->base);
     HDF_LOGI("Init: hpmUartDev->irq: %u\n", hpmUartDev->irq);
     HDF_LOGI("Init: hpmUartDev->clkFreq: %u\n", hpmUartDev->clkFreq);
 
+    if ((hpmUartDev->rxBufSize < HPM_UART_RX_BUF_SIZE_MIN) ||
+        (hpmUartDev->rxBufSize & (hpmUartDev->rxBufSize - 1))) {
+        HDF_LOGE("Init: rx_buf_size %u is not a power of 2\n", hpmUartDev->rxBufSize);
+        hpmUartDev->rxBufSize = HPM_UART_RX_BUF_SIZE_DEFAULT;
+    }
+
+    if ((hpmUartDev->txBufSize < HPM_UART_TX_BUF_SIZE_MIN) ||
+        (hpmUartDev->txBufSize & (hpmUartDev->txBufSize - 1))) {
+        HDF_LOGE("Init: tx_buf_size %u is not a power of 2\n", hpmUartDev->txBufSize);
+        hpmUartDev->txBufSize = HPM_UART_TX_BUF_SIZE_DEFAULT;
+    }
+
+    hpmUartDev->rxQueue.buf = (uint8_t *)OsalMemAlloc(hpmUartDev->rxBufSize);
+    hpmUartDev->txRing.buf = (uint8_t *)OsalMemAllocAlign(HPM_L1C_CACHELINE_SIZE, hpmUartDev->txBufSize);
+    if ((hpmUartDev->rxQueue.buf == NULL) || (hpmUartDev->txRing.buf == NULL)) {
+        ret = HDF_ERR_MALLOC_FAIL;
+        HDF_LOGE("Init: rx/tx ring malloc Failed!!!\n");
+        goto ERROR2;
+    }
+    hpmUartDev->rxQueue.mask = hpmUartDev->rxBufSize - 1;
+    hpmUartDev->txRing.mask = hpmUartDev->txBufSize - 1;
+
+    if (((hpmUartDev->dmaRxSrc != HPM_UART_DMA_SRC_NONE) || (hpmUartDev->dmaTxSrc != HPM_UART_DMA_SRC_NONE)) &&
+        (HpmDmaPortInit() != HDF_SUCCESS)) {
+        hpmUartDev->dmaRxSrc = HPM_UART_DMA_SRC_NONE;
+        hpmUartDev->dmaTxSrc = HPM_UART_DMA_SRC_NONE;
+    }
+
     host->num = hpmUartDev->id;
     host->priv = hpmUartDev;
+    if (hpmUartDev->id < HPM_UART_MAX_NUM) {
+        g_hpmUartDevs[hpmUartDev->id] = hpmUartDev;
+    }
     host->method = &uartHostMethod;
 
     HwiIrqParam irqParam;
@@ -336,6 +958,10 @@ static int32_t UartDriverInit(struct HdfDeviceObject *device)
     return ret;
 
 ERROR2:
+    OsalMemFree(hpmUartDev->rxQueue.buf);
+    OsalMemFree(hpmUartDev->txRing.buf);
+    OsalMutexDestroy(&hpmUartDev->txMutex);
+    OsalSemDestroy(&hpmUartDev->txSem);
     OsalSemDestroy(&hpmUartDev->rxSem);
     OsalMemFree(hpmUartDev);
 ERROR1:
@@ -357,7 +983,14 @@ static void UartDriverRelease(struct HdfDeviceObject *device)
     struct HPMUartDevice *hpmUartDev = (struct HPMUartDevice *)host->priv;
 
     if (hpmUartDev) {
+        OsalMutexDestroy(&hpmUartDev->txMutex);
+        OsalSemDestroy(&hpmUartDev->txSem);
         OsalSemDestroy(&hpmUartDev->rxSem);
+        if (hpmUartDev->id < HPM_UART_MAX_NUM) {
+            g_hpmUartDevs[hpmUartDev->id] = NULL;
+        }
+        OsalMemFree(hpmUartDev->rxQueue.buf);
+        OsalMemFree(hpmUartDev->txRing.buf);
         OsalMemFree(hpmUartDev);
     }
     
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HPM_UART_EXT_H
+#define HPM_UART_EXT_H
+
+#include <stdint.h>
+
+struct HpmUartRxStats {
+    uint32_t rxBytes;    /* bytes queued into the rx ring */
+    uint32_t swOverflow; /* bytes dropped because the rx ring was full */
+    uint32_t hwOverrun;  /* rx fifo overruns reported by the uart line status */
+};
+
+/* Snapshot of the rx counters of uart <port>, the counters keep running */
+int32_t HpmUartGetRxStats(uint32_t port, struct HpmUartRxStats *stats);
+
+int32_t HpmUartClearRxStats(uint32_t port);
+
+/*
+ * Completion rules of a blocking Read on uart <port>, whichever comes first:
+ * the requested size is filled, <timeoutMs> elapsed since the call (0xFFFFFFFF
+ * waits forever), or data was received and the line then stayed idle for
+ * <idleMs> or raised the rx timeout interrupt (0 disables the idle return).
+ * Whatever is buffered at that point is returned.
+ */
+int32_t HpmUartSetReadTimeout(uint32_t port, uint32_t timeoutMs, uint32_t idleMs);
+
+#endif
@@ -13,21 +13,266 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <semaphore.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "hal_hota_board.h"
+#include "hota_flash.h"
+#include "mbedtls/sha256.h"
 #include "stdio.h"
+
+#define HOTA_BUF_NUM            2
+#define HOTA_POLL_US            500
+#define HOTA_WORKER_STACK_SIZE  4096
+
+/* One sector of image data on its way to flash */
+struct HotaBuf {
+    uint8_t *data;
+    uint32_t addr;
+    uint32_t len;
+};
+
+/*
+ * The caller fills one buffer while the worker erases and programs the
+ * other, so flash time overlaps with the next network read.
+ */
+struct HotaWriter {
+    struct HotaFlashOps flash;
+    struct HotaBootRecord record;
+    uint32_t recordAddr;        /* sector holding the current record */
+    uint32_t slot;              /* slot being written */
+    uint32_t slotAddr;
+    uint32_t next;              /* expected offset of the next write */
+    struct HotaBuf buf[HOTA_BUF_NUM];
+    uint32_t fill;              /* buffer owned by the caller */
+    bool filling;
+    uint32_t queue[HOTA_BUF_NUM];
+    uint32_t qHead;
+    uint32_t qTail;
+    sem_t freeSem;
+    sem_t fullSem;
+    volatile int32_t err;
+    uint32_t crc;
+    mbedtls_sha256_context sha;
+    bool workerStarted;
+};
+
 static BOOL HOTA_STATUS = 0;
+static struct HotaWriter g_hota;
+
+static uint32_t HotaCrc32Update(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320U) : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+static int32_t HotaFlashWait(void)
+{
+    while (g_hota.flash.busy()) {
+        usleep(HOTA_POLL_US);
+    }
+    return 0;
+}
+
+/* Erase the sector and program it page by page, sleeping while the flash works */
+static int32_t HotaFlashWriteSector(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    if ((g_hota.flash.erase(addr) != 0) || (HotaFlashWait() != 0)) {
+        return -1;
+    }
+    for (uint32_t off = 0; off < len; off += g_hota.flash.pageSize) {
+        uint32_t n = len - off;
+        if (n > g_hota.flash.pageSize) {
+            n = g_hota.flash.pageSize;
+        }
+        if ((g_hota.flash.program(addr + off, &data[off], n) != 0) || (HotaFlashWait() != 0)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void *HotaWorker(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        sem_wait(&g_hota.fullSem);
+        struct HotaBuf *b = &g_hota.buf[g_hota.queue[g_hota.qTail % HOTA_BUF_NUM]];
+        g_hota.qTail++;
+        if ((g_hota.err == 0) && (HotaFlashWriteSector(b->addr, b->data, b->len) != 0)) {
+            printf("hota: program 0x%x failed\n", (unsigned int)b->addr);
+            g_hota.err = -1;
+        }
+        sem_post(&g_hota.freeSem);
+    }
+    return NULL;
+}
+
+static int32_t HotaWorkerStart(void)
+{
+    pthread_t tid;
+    pthread_attr_t attr;
+
+    if (g_hota.workerStarted) {
+        return 0;
+    }
+    sem_init(&g_hota.freeSem, 0, HOTA_BUF_NUM);
+    sem_init(&g_hota.fullSem, 0, 0);
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, HOTA_WORKER_STACK_SIZE);
+    if (pthread_create(&tid, &attr, HotaWorker, NULL) != 0) {
+        pthread_attr_destroy(&attr);
+        return -1;
+    }
+    pthread_attr_destroy(&attr);
+    g_hota.workerStarted = true;
+    return 0;
+}
+
+static void HotaSubmit(void)
+{
+    g_hota.queue[g_hota.qHead % HOTA_BUF_NUM] = g_hota.fill;
+    g_hota.qHead++;
+    g_hota.fill = (g_hota.fill + 1) % HOTA_BUF_NUM;
+    g_hota.filling = false;
+    sem_post(&g_hota.fullSem);
+}
+
+/*
+ * Wait until the worker has nothing in flight. The partial buffer is only
+ * pushed out when the image is complete: a later write would have to start
+ * mid-sector, and its sector erase would wipe what was programmed.
+ */
+static int32_t HotaDrain(bool flushPartial)
+{
+    uint32_t owned;
+
+    if (flushPartial && g_hota.filling) {
+        HotaSubmit();
+    }
+    owned = g_hota.filling ? 1 : 0;
+    for (uint32_t i = owned; i < HOTA_BUF_NUM; i++) {
+        sem_wait(&g_hota.freeSem);
+    }
+    for (uint32_t i = owned; i < HOTA_BUF_NUM; i++) {
+        sem_post(&g_hota.freeSem);
+    }
+    return g_hota.err;
+}
+
+static bool HotaRecordValid(const struct HotaBootRecord *r)
+{
+    return (r->magic == HOTA_BOOT_RECORD_MAGIC) && (r->active < HOTA_SLOT_NUM) &&
+           (r->crc == HotaCrc32Update(0, (const uint8_t *)r, offsetof(struct HotaBootRecord, crc)));
+}
+
+static int32_t HotaRecordLoad(void)
+{
+    struct HotaBootRecord r[HOTA_SLOT_NUM];
+    int32_t best = -1;
+
+    for (uint32_t i = 0; i < HOTA_SLOT_NUM; i++) {
+        if (g_hota.flash.read(HOTA_BOOT_RECORD_ADDR + i * g_hota.flash.sectorSize,
+                              (uint8_t *)&r[i], sizeof(r[i])) != 0) {
+            return -1;
+        }
+        if (HotaRecordValid(&r[i]) && ((best < 0) || ((int32_t)(r[i].seq - r[best].seq) > 0))) {
+            best = i;
+        }
+    }
+
+    if (best < 0) {
+        /* blank flash: running from slot A */
+        (void)memset(&g_hota.record, 0, sizeof(g_hota.record));
+        g_hota.record.magic = HOTA_BOOT_RECORD_MAGIC;
+        g_hota.recordAddr = HOTA_BOOT_RECORD_ADDR + g_hota.flash.sectorSize;
+        return 0;
+    }
+    g_hota.record = r[best];
+    g_hota.recordAddr = HOTA_BOOT_RECORD_ADDR + best * g_hota.flash.sectorSize;
+    return 0;
+}
+
+/* Write the next record generation over the older copy, the current one stays intact */
+static int32_t HotaRecordStore(struct HotaBootRecord *r)
+{
+    uint32_t addr = (g_hota.recordAddr == HOTA_BOOT_RECORD_ADDR) ?
+                    (HOTA_BOOT_RECORD_ADDR + g_hota.flash.sectorSize) : HOTA_BOOT_RECORD_ADDR;
+
+    r->magic = HOTA_BOOT_RECORD_MAGIC;
+    r->seq = g_hota.record.seq + 1;
+    r->crc = HotaCrc32Update(0, (const uint8_t *)r, offsetof(struct HotaBootRecord, crc));
+    if (HotaFlashWriteSector(addr, (const uint8_t *)r, sizeof(*r)) != 0) {
+        return -1;
+    }
+    g_hota.record = *r;
+    g_hota.recordAddr = addr;
+    return 0;
+}
+
+static uint32_t HotaSlotAddr(uint32_t slot)
+{
+    return (slot == 0) ? HOTA_SLOT_A_ADDR : HOTA_SLOT_B_ADDR;
+}
+
+/* offset + len may wrap around 4 GiB, so it is not compared against the slot size */
+static bool HotaRangeValid(uint32_t offset, uint32_t len)
+{
+    return (offset <= HOTA_SLOT_SIZE) && (len <= HOTA_SLOT_SIZE - offset);
+}
+
+static void HotaSessionReset(void)
+{
+    g_hota.slot = (g_hota.record.active + 1) % HOTA_SLOT_NUM;
+    g_hota.slotAddr = HotaSlotAddr(g_hota.slot);
+    g_hota.next = 0;
+    g_hota.err = 0;
+    g_hota.crc = 0;
+    mbedtls_sha256_init(&g_hota.sha);
+    mbedtls_sha256_starts(&g_hota.sha, 0);
+}
+
 int HotaHalInit(void)
 {
     if (HOTA_STATUS == 1) {
         return OHOS_FAILURE;
-    } else {
-        HOTA_STATUS = 1;
-        return OHOS_SUCCESS;
     }
+
+    if (g_hota.buf[0].data == NULL) {
+        if (HotaFlashPortInit(&g_hota.flash) != 0) {
+            return OHOS_FAILURE;
+        }
+        for (uint32_t i = 0; i < HOTA_BUF_NUM; i++) {
+            g_hota.buf[i].data = (uint8_t *)malloc(g_hota.flash.sectorSize);
+            if (g_hota.buf[i].data == NULL) {
+                return OHOS_FAILURE;
+            }
+        }
+    }
+    if ((HotaWorkerStart() != 0) || (HotaRecordLoad() != 0)) {
+        return OHOS_FAILURE;
+    }
+
+    HotaSessionReset();
+    HOTA_STATUS = 1;
+    return OHOS_SUCCESS;
 }
 
 int HotaHalGetUpdateIndex(unsigned int *index)
 {
+    if ((HOTA_STATUS == 0) || (index == NULL)) {
+        return OHOS_FAILURE;
+    }
+    *index = g_hota.slot;
     return OHOS_SUCCESS;
 }
 
@@ -36,6 +281,8 @@ int HotaHalDeInit(void)
     if (HOTA_STATUS == 0) {
         return OHOS_FAILURE;
     } else {
+        (void)HotaDrain(true);
+        mbedtls_sha256_free(&g_hota.sha);
         HOTA_STATUS = 0;
         return OHOS_SUCCESS;
     }
@@ -44,12 +291,82 @@ int HotaHalDeInit(void)
 int HotaHalRead(int partition, unsigned int offset, unsigned int bufLen,
                 unsigned char *buffer)
 {
-    return -1;
+    (void)partition;
+    if ((HOTA_STATUS == 0) || (buffer == NULL) || !HotaRangeValid(offset, bufLen)) {
+        return OHOS_FAILURE;
+    }
+
+    /* bytes still in the caller's buffer are served from RAM, the rest from flash */
+    if (HotaDrain(false) != 0) {
+        return OHOS_FAILURE;
+    }
+    struct HotaBuf *b = &g_hota.buf[g_hota.fill];
+    uint32_t flashEnd = g_hota.filling ? b->addr - g_hota.slotAddr : g_hota.next;
+    uint32_t n = 0;
+    if (offset < flashEnd) {
+        n = ((offset + bufLen) > flashEnd) ? (flashEnd - offset) : bufLen;
+        if (g_hota.flash.read(g_hota.slotAddr + offset, buffer, n) != 0) {
+            return OHOS_FAILURE;
+        }
+    }
+    if ((n < bufLen) && g_hota.filling) {
+        uint32_t from = offset + n - flashEnd;
+        if (from + (bufLen - n) > b->len) {
+            return OHOS_FAILURE;
+        }
+        (void)memcpy(&buffer[n], &b->data[from], bufLen - n);
+    } else if (n < bufLen) {
+        return OHOS_FAILURE;
+    }
+    return OHOS_SUCCESS;
 }
 
 int HotaHalWrite(int partition, unsigned char *buffer, unsigned int offset,
                  unsigned int bufLen)
 {
+    (void)partition;
+    if ((HOTA_STATUS == 0) || (buffer == NULL) || !HotaRangeValid(offset, bufLen)) {
+        return OHOS_FAILURE;
+    }
+    if (offset != g_hota.next) {
+        /* the package is streamed in order, anything else is a new session */
+        if (offset != 0) {
+            printf("hota: write at 0x%x, expected 0x%x\n", offset, (unsigned int)g_hota.next);
+            return OHOS_FAILURE;
+        }
+        (void)HotaDrain(true);
+        mbedtls_sha256_free(&g_hota.sha);
+        HotaSessionReset();
+    }
+
+    g_hota.crc = HotaCrc32Update(g_hota.crc, buffer, bufLen);
+    mbedtls_sha256_update(&g_hota.sha, buffer, bufLen);
+
+    while (bufLen > 0) {
+        if (g_hota.err != 0) {
+            return OHOS_FAILURE;
+        }
+        struct HotaBuf *b = &g_hota.buf[g_hota.fill];
+        if (!g_hota.filling) {
+            /* blocks only while both sectors are still in flight */
+            sem_wait(&g_hota.freeSem);
+            b->addr = g_hota.slotAddr + g_hota.next;
+            b->len = 0;
+            g_hota.filling = true;
+        }
+        uint32_t n = g_hota.flash.sectorSize - b->len;
+        if (n > bufLen) {
+            n = bufLen;
+        }
+        (void)memcpy(&b->data[b->len], buffer, n);
+        b->len += n;
+        buffer += n;
+        bufLen -= n;
+        g_hota.next += n;
+        if (b->len == g_hota.flash.sectorSize) {
+            HotaSubmit();
+        }
+    }
     return OHOS_SUCCESS;
 }
 
@@ -58,14 +375,64 @@ int HotaHalRestart(void)
     return OHOS_SUCCESS;
 }
 
+/* Verify what landed in flash against the streamed crc before switching slots */
+static int32_t HotaVerifySlot(void)
+{
+    uint32_t crc = 0;
+    uint8_t *tmp = g_hota.buf[(g_hota.fill + 1) % HOTA_BUF_NUM].data;
+
+    for (uint32_t off = 0; off < g_hota.next; off += g_hota.flash.sectorSize) {
+        uint32_t n = g_hota.next - off;
+        if (n > g_hota.flash.sectorSize) {
+            n = g_hota.flash.sectorSize;
+        }
+        if (g_hota.flash.read(g_hota.slotAddr + off, tmp, n) != 0) {
+            return -1;
+        }
+        crc = HotaCrc32Update(crc, tmp, n);
+    }
+    return (crc == g_hota.crc) ? 0 : -1;
+}
+
 int HotaHalSetBootSettings(void)
 {
-    return OHOS_SUCCESS;
+    struct HotaBootRecord r;
+
+    if ((HOTA_STATUS == 0) || (g_hota.next == 0)) {
+        return OHOS_FAILURE;
+    }
+    if ((HotaDrain(true) != 0) || (HotaVerifySlot() != 0)) {
+        printf("hota: slot %u verify failed\n", (unsigned int)g_hota.slot);
+        return OHOS_FAILURE;
+    }
+
+    r = g_hota.record;
+    r.previous = r.active;
+    r.active = g_hota.slot;
+    r.trial = 1;
+    r.imgSize[g_hota.slot] = g_hota.next;
+    r.imgCrc[g_hota.slot] = g_hota.crc;
+    mbedtls_sha256_finish(&g_hota.sha, r.imgSha256[g_hota.slot]);
+    return (HotaRecordStore(&r) == 0) ? OHOS_SUCCESS : OHOS_FAILURE;
 }
 
 int HotaHalRollback(void)
 {
-    return OHOS_SUCCESS;
+    struct HotaBootRecord r;
+
+    if (HOTA_STATUS == 0) {
+        return OHOS_FAILURE;
+    }
+    (void)HotaDrain(true);
+    r = g_hota.record;
+    if (r.previous == r.active) {
+        /* nothing to go back to */
+        return OHOS_FAILURE;
+    }
+    r.active = g_hota.record.previous;
+    r.previous = g_hota.record.active;
+    r.trial = 0;
+    return (HotaRecordStore(&r) == 0) ? OHOS_SUCCESS : OHOS_FAILURE;
 }
 
 const ComponentTableInfo *HotaHalGetPartitionInfo()
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HOTA_FLASH_H
+#define HOTA_FLASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Flash layout of the A/B update slots, override from the board BUILD.gn.
+ * Slots and the boot record sectors must be sector aligned.
+ */
+#ifndef HOTA_SLOT_A_ADDR
+#define HOTA_SLOT_A_ADDR        0x000000
+#endif
+#ifndef HOTA_SLOT_B_ADDR
+#define HOTA_SLOT_B_ADDR        0x200000
+#endif
+#ifndef HOTA_SLOT_SIZE
+#define HOTA_SLOT_SIZE          0x200000
+#endif
+/* two sectors, the boot record is written to them in turn */
+#ifndef HOTA_BOOT_RECORD_ADDR
+#define HOTA_BOOT_RECORD_ADDR   0x400000
+#endif
+
+#define HOTA_BOOT_RECORD_MAGIC  0x544F4F42U /* "BOOT" */
+#define HOTA_SLOT_NUM           2
+#define HOTA_SHA256_LEN         32
+
+/*
+ * Boot control record shared with the bootloader. The valid copy with the
+ * highest seq wins; <trial> asks the bootloader to fall back to <previous>
+ * if the new image does not confirm itself.
+ */
+struct HotaBootRecord {
+    uint32_t magic;
+    uint32_t seq;
+    uint8_t active;
+    uint8_t previous;
+    uint8_t trial;
+    uint8_t reserved;
+    uint32_t imgSize[HOTA_SLOT_NUM];
+    uint32_t imgCrc[HOTA_SLOT_NUM];
+    uint8_t imgSha256[HOTA_SLOT_NUM][HOTA_SHA256_LEN];
+    uint32_t crc;   /* crc32 of all fields above */
+};
+
+/*
+ * Flash backend of the update writer. erase and program only start the
+ * operation, completion is polled with busy(); program never crosses a page.
+ */
+struct HotaFlashOps {
+    uint32_t sectorSize;
+    uint32_t pageSize;
+    int32_t (*read)(uint32_t addr, uint8_t *buf, uint32_t len);
+    int32_t (*erase)(uint32_t addr);
+    int32_t (*program)(uint32_t addr, const uint8_t *buf, uint32_t len);
+    bool (*busy)(void);
+};
+
+/* Link time seam: serial nor on target, a RAM model in host builds */
+int32_t HotaFlashPortInit(struct HotaFlashOps *ops);
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include "hpm_serial_nor.h"
+#include "hota_flash.h"
+
+static hpm_serial_nor_t *g_hotaNor;
+
+/*
+ * The board fills in the spi host parameters (instance, cs pin, dma) of the
+ * update flash and hands the device over here, it is probed on first use.
+ */
+__attribute__((weak)) hpm_serial_nor_t *HotaBoardSerialNor(void)
+{
+    return NULL;
+}
+
+static int32_t HotaNorRead(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    return (hpm_serial_nor_read(g_hotaNor, buf, len, addr) == status_success) ? 0 : -1;
+}
+
+static int32_t HotaNorErase(uint32_t addr)
+{
+    return (hpm_serial_nor_erase_sector_noblocking(g_hotaNor, addr) == status_success) ? 0 : -1;
+}
+
+static int32_t HotaNorProgram(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    hpm_stat_t stat = hpm_serial_nor_page_program_noblocking(g_hotaNor, (uint8_t *)buf, len, addr);
+    return (stat == status_success) ? 0 : -1;
+}
+
+static bool HotaNorBusy(void)
+{
+    return hpm_serial_nor_is_busy(g_hotaNor) == status_spi_nor_flash_is_busy;
+}
+
+int32_t HotaFlashPortInit(struct HotaFlashOps *ops)
+{
+    hpm_serial_nor_info_t info;
+
+    if (g_hotaNor == NULL) {
+        hpm_serial_nor_t *nor = HotaBoardSerialNor();
+        if (nor == NULL) {
+            printf("hota: no update flash provided by the board\n");
+            return -1;
+        }
+        if ((serial_nor_host_ops_use_spi(nor) != status_success) ||
+            (hpm_serial_nor_init(nor, &info) != status_success)) {
+            printf("hota: update flash probe failed\n");
+            return -1;
+        }
+        g_hotaNor = nor;
+    }
+
+    if (hpm_serial_nor_get_info(g_hotaNor, &info) != status_success) {
+        return -1;
+    }
+    ops->sectorSize = info.sector_size_kbytes * 1024U;
+    ops->pageSize = info.page_size;
+    ops->read = HotaNorRead;
+    ops->erase = HotaNorErase;
+    ops->program = HotaNorProgram;
+    ops->busy = HotaNorBusy;
+
+    return 0;
+}
@@ -14,6 +14,7 @@
  */
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -21,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include "securec.h"
 #include "utils_file.h"
 #include "hal_file.h"
 
@@ -31,26 +33,157 @@
 #define MAX_PATH_LEN     40
 #define MaxOpenFile      32
 #define ROOT_PATH        "/data"
+#define FILE_PATH_SIZE   (sizeof(ROOT_PATH) + MAX_PATH_LEN)
+
+/*
+ * Small writes are gathered in a block sized RAM buffer and handed to the
+ * file system in one write once the block fills up, or before any other
+ * operation on the fd. littlefs only commits data on close anyway, so this
+ * does not widen the power loss window. Buffers come from a shared pool and
+ * are only held while dirty; set HAL_FILE_CACHE_NUM to 0 to disable.
+ * HalFileStat flushes the buffers of the fds open on the same path first, so
+ * the size it reports includes everything written so far.
+ */
+#ifndef HAL_FILE_CACHE_NUM
+#define HAL_FILE_CACHE_NUM        2
+#endif
+#ifndef HAL_FILE_CACHE_BLOCK_SIZE
+#define HAL_FILE_CACHE_BLOCK_SIZE 4096
+#endif
 
 typedef struct _File_Context {
     int fs_fd;
     unsigned char fd;
+    unsigned char next_free;    /* 1-based index of the next free slot, 0 ends the list */
+    signed char cache;          /* index in the cache pool, -1 when not buffering */
+    unsigned short cache_len;
+    uint32_t path_hash;         /* of the full path, to find the fds of a file */
 } File_Context;
 
 static File_Context File[MaxOpenFile] = { 0 };
+static unsigned char g_freeHead;    /* 1-based, slots above g_fileHwm are free as well */
+static unsigned char g_fileHwm;
+static pthread_mutex_t g_fileLock = PTHREAD_MUTEX_INITIALIZER;
+
+#if HAL_FILE_CACHE_NUM > 0
+static unsigned char g_cacheBuf[HAL_FILE_CACHE_NUM][HAL_FILE_CACHE_BLOCK_SIZE];
+static uint32_t g_cacheFree = (1UL << HAL_FILE_CACHE_NUM) - 1;
+#endif
 
+/* O(1): reuse a released slot first, then hand out untouched ones */
 int Find_Free_Num(void)
 {
-    int i = MaxOpenFile;
-    for (; i > 0; i--) {
-        if (File[i - 1].fd == 0) {
-            break;
-        }
+    int i = 0;
+
+    pthread_mutex_lock(&g_fileLock);
+    if (g_freeHead != 0) {
+        i = g_freeHead;
+        g_freeHead = File[i - 1].next_free;
+    } else if (g_fileHwm < MaxOpenFile) {
+        i = ++g_fileHwm;
+    }
+    if (i != 0) {
+        File[i - 1].fd = 1;
+        File[i - 1].cache = -1;
+        File[i - 1].cache_len = 0;
     }
+    pthread_mutex_unlock(&g_fileLock);
 
     return i;
 }
 
+static void Release_Num(int fd)
+{
+    pthread_mutex_lock(&g_fileLock);
+    File[fd - 1].fd = 0;
+    File[fd - 1].fs_fd = -1;
+    File[fd - 1].next_free = g_freeHead;
+    g_freeHead = fd;
+    pthread_mutex_unlock(&g_fileLock);
+}
+
+static File_Context *Get_Context(int fd)
+{
+    if ((fd > MaxOpenFile) || (fd <= 0) || (File[fd - 1].fd == 0)) {
+        return NULL;
+    }
+    return &File[fd - 1];
+}
+
+static int Cache_Flush(File_Context *ctx)
+{
+#if HAL_FILE_CACHE_NUM > 0
+    int ret = 0;
+
+    if (ctx->cache < 0) {
+        return 0;
+    }
+    if (ctx->cache_len != 0) {
+        if (write(ctx->fs_fd, g_cacheBuf[ctx->cache], ctx->cache_len) != ctx->cache_len) {
+            ret = -1;
+        }
+    }
+
+    pthread_mutex_lock(&g_fileLock);
+    g_cacheFree |= 1UL << ctx->cache;
+    pthread_mutex_unlock(&g_fileLock);
+    ctx->cache = -1;
+    ctx->cache_len = 0;
+
+    return ret;
+#else
+    (void)ctx;
+    return 0;
+#endif
+}
+
+/* FNV-1a, a collision only costs an early flush */
+static uint32_t Path_Hash(const char *file_path)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*file_path != '\0') {
+        hash = (hash ^ (unsigned char)*file_path++) * 16777619U;
+    }
+    return hash;
+}
+
+/* Write out what the open fds of <file_path> still buffer */
+static int Cache_Flush_Path(const char *file_path)
+{
+    int ret = 0;
+#if HAL_FILE_CACHE_NUM > 0
+    uint32_t hash = Path_Hash(file_path);
+
+    for (int i = 0; i < g_fileHwm; i++) {
+        File_Context *ctx = &File[i];
+        if ((ctx->fd != 0) && (ctx->cache >= 0) && (ctx->path_hash == hash) && (Cache_Flush(ctx) != 0)) {
+            ret = -1;
+        }
+    }
+#else
+    (void)file_path;
+#endif
+    return ret;
+}
+
+static int Make_Path(char *file_path, const char *path)
+{
+    if (strlen(path) >= MAX_PATH_LEN) {
+        LOG_E("path name is too long!!!\n");
+        return -1;
+    }
+
+    strcpy_s(file_path, FILE_PATH_SIZE, ROOT_PATH);
+    if (strcat_s(file_path, FILE_PATH_SIZE, "/") != 0) {
+        return -1;
+    }
+    if (strcat_s(file_path, FILE_PATH_SIZE, path) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
 
 int ReadModeChange(int oflag)
 {
@@ -89,12 +222,10 @@ int ReadModeChange(int oflag)
 
 int HalFileOpen(const char *path, int oflag, int mode)
 {
-    char *file_path;
+    char file_path[FILE_PATH_SIZE];
     int fd;
-    uint16_t path_len;
 
-    if (strlen(path) >= MAX_PATH_LEN) {
-        LOG_E("path name is too long!!!\n");
+    if (Make_Path(file_path, path) != 0) {
         return -1;
     }
 
@@ -104,30 +235,15 @@ int HalFileOpen(const char *path, int oflag, int mode)
         return -1;
     }
 
-    path_len = strlen(path) + strlen(ROOT_PATH) + ROOT_LEN;
-    file_path = (char *)malloc(path_len);
-    if (file_path == NULL) {
-        LOG_E("malloc path name buffer failed!\n");
-        return -1;
-    }
-    strcpy_s(file_path, path_len, ROOT_PATH);
-    if (strcat_s(file_path, path_len, "/") != 0) {
-        return -1;
-    }
-    if (strcat_s(file_path, path_len, path) != 0) {
-        return -1;
-    }
-
     int fs_fd = open(file_path, ReadModeChange(oflag));
     if (fs_fd < 0) {
         LOG_E("open file '%s' failed, %s\r\n", file_path, strerror(errno));
-        free(file_path);
+        Release_Num(fd);
         return -1;
     }
 
-    File[fd - 1].fd = 1;
     File[fd - 1].fs_fd = fs_fd;
-    free(file_path);
+    File[fd - 1].path_hash = Path_Hash(file_path);
 
     return fd;
 }
@@ -135,113 +251,113 @@ int HalFileOpen(const char *path, int oflag, int mode)
 int HalFileClose(int fd)
 {
     int ret;
+    File_Context *ctx = Get_Context(fd);
 
-    if ((fd > MaxOpenFile) || (fd <= 0)) {
+    if (ctx == NULL) {
         return -1;
     }
 
-    ret = close(File[fd - 1].fs_fd);
-    if (ret != 0) {
-        return -1;
+    ret = Cache_Flush(ctx);
+    /* the file system drops the handle even when close fails, so does the slot */
+    if (close(ctx->fs_fd) != 0) {
+        ret = -1;
     }
-
-    File[fd - 1].fd = 0;
-    File[fd - 1].fs_fd = -1;
+    Release_Num(fd);
 
     return ret;
 }
 
 int HalFileRead(int fd, char *buf, unsigned int len)
 {
-    if ((fd > MaxOpenFile) || (fd <= 0)) {
+    File_Context *ctx = Get_Context(fd);
+
+    if ((ctx == NULL) || (Cache_Flush(ctx) != 0)) {
         return -1;
     }
 
-    return read(File[fd - 1].fs_fd, buf, len);
+    return read(ctx->fs_fd, buf, len);
 }
 
 int HalFileWrite(int fd, const char *buf, unsigned int len)
 {
-    if ((fd > MaxOpenFile) || (fd <= 0)) {
+    File_Context *ctx = Get_Context(fd);
+
+    if (ctx == NULL) {
         return -1;
     }
 
-    return write(File[fd - 1].fs_fd, buf, len);
+#if HAL_FILE_CACHE_NUM > 0
+    /* does not fit, write the block out and start over with an empty one */
+    if ((ctx->cache >= 0) && (len > HAL_FILE_CACHE_BLOCK_SIZE - ctx->cache_len)) {
+        if (Cache_Flush(ctx) != 0) {
+            return -1;
+        }
+    }
+    if ((ctx->cache < 0) && (len < HAL_FILE_CACHE_BLOCK_SIZE)) {
+        pthread_mutex_lock(&g_fileLock);
+        if (g_cacheFree != 0) {
+            ctx->cache = __builtin_ctz(g_cacheFree);
+            g_cacheFree &= ~(1UL << ctx->cache);
+        }
+        pthread_mutex_unlock(&g_fileLock);
+    }
+    if (ctx->cache >= 0) {
+        memcpy(&g_cacheBuf[ctx->cache][ctx->cache_len], buf, len);
+        ctx->cache_len += len;
+        if (ctx->cache_len == HAL_FILE_CACHE_BLOCK_SIZE) {
+            return (Cache_Flush(ctx) == 0) ? (int)len : -1;
+        }
+        return len;
+    }
+#endif
+
+    return write(ctx->fs_fd, buf, len);
 }
 
 int HalFileDelete(const char *path)
 {
-    char *file_path;
-    uint16_t path_len;
-
-    if (strlen(path) >= MAX_PATH_LEN) {
-        LOG_E("path name is too long!!!\n");
-        return -1;
-    }
-
-    path_len = strlen(path) + strlen(ROOT_PATH) + ROOT_LEN;
-    file_path = (char *)malloc(path_len);
-    if (file_path == NULL) {
-        LOG_E("malloc path name buffer failed!\n");
-        return -1;
-    }
+    char file_path[FILE_PATH_SIZE];
 
-    strcpy_s(file_path, path_len, ROOT_PATH);
-    if (strcat_s(file_path, path_len, "/") != 0) {
-        return -1;
-    }
-    if (strcat_s(file_path, path_len, path) != 0) {
+    if (Make_Path(file_path, path) != 0) {
         return -1;
     }
 
-    int ret = unlink(file_path);
-    free(file_path);
-
-    return ret;
+    return unlink(file_path);
 }
 
 int HalFileStat(const char *path, unsigned int *fileSize)
 {
-    char *file_path;
+    char file_path[FILE_PATH_SIZE];
     struct stat f_info;
-    uint16_t path_len;
 
-    if (strlen(path) >= MAX_PATH_LEN) {
-        LOG_E("path name is too long!!!\n");
+    if (Make_Path(file_path, path) != 0) {
         return -1;
     }
 
-    path_len = strlen(path) + strlen(ROOT_PATH) + ROOT_LEN;
-    file_path = (char *)malloc(path_len);
-    if (file_path == NULL) {
-        LOG_E("malloc path name buffer failed!\n");
-        return -1;
-    }
-    strcpy_s(file_path, path_len, ROOT_PATH);
-    if (strcat_s(file_path, path_len, "/") != 0) {
-        return -1;
-    }
-    if (strcat_s(file_path, path_len, path) != 0) {
+    if (Cache_Flush_Path(file_path) != 0) {
         return -1;
     }
 
     int ret = stat(file_path, &f_info);
+    if (ret != 0) {
+        return -1;
+    }
     *fileSize = f_info.st_size;
-    free(file_path);
 
-    return ((ret == 0) ? 0 : -1);
+    return 0;
 }
 
 int HalFileSeek(int fd, int offset, unsigned int whence)
 {
     int ret = 0;
     struct stat f_info;
+    File_Context *ctx = Get_Context(fd);
 
-    if ((fd > MaxOpenFile) || (fd <= 0)) {
+    if ((ctx == NULL) || (Cache_Flush(ctx) != 0)) {
         return -1;
     }
 
-    ret = fstat(File[fd - 1].fs_fd, &f_info);
+    ret = fstat(ctx->fs_fd, &f_info);
     if (ret != 0) {
         return -1;
     }
@@ -252,7 +368,7 @@ int HalFileSeek(int fd, int offset, unsigned int whence)
         }
     }
 
-    ret = lseek(File[fd - 1].fs_fd, offset, whence);
+    ret = lseek(ctx->fs_fd, offset, whence);
     if ((ret >  f_info.st_size) || (ret < 0)) {
         return -1;
     }
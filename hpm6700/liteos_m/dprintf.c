@@ -30,10 +30,48 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include "securec.h"
 #include "uart.h"
 #include "los_debug.h"
 #include "los_interrupt.h"
+#include "los_sem.h"
+#include "los_task.h"
+
+/*
+ * Log lines are copied into a lock-free multi-producer ring and written to the
+ * console by a low priority task, so a printf from a task or an isr only costs
+ * the formatting and a memcpy. Until that task runs (early boot) output stays
+ * synchronous. A record is a 32-bit header (length | flags) followed by the
+ * text padded to 4 bytes; a record that would cross the end of the ring is
+ * preceded by a pad record so every line stays contiguous.
+ *
+ * The log task never runs again in an exception handler or in code spinning
+ * with interrupts locked, so there a line is written straight to the uart,
+ * after whatever is still queued.
+ */
+#define LOG_LINE_MAX        1024
+#define LOG_RING_SIZE       4096
+#define LOG_RING_MASK       (LOG_RING_SIZE - 1)
+#define LOG_HDR_SIZE        sizeof(uint32_t)
+#define LOG_HDR_COMMIT      0x80000000U
+#define LOG_HDR_PAD         0x40000000U
+#define LOG_HDR_LEN_MASK    0x0000FFFFU
+#define LOG_ALIGN4(x)       (((x) + 3U) & ~3U)
+#define LOG_TASK_STACK_SIZE 2048
+#define LOG_TASK_PRIO       (OS_TASK_PRIORITY_LOWEST - 1)
+
+static uint8_t g_logRing[LOG_RING_SIZE] __attribute__((aligned(4)));
+static volatile uint32_t g_logHead;     /* next byte to reserve, free running */
+static volatile uint32_t g_logTail;     /* next byte to drain, free running */
+static volatile uint32_t g_logDropped;  /* lines lost to a full ring */
+static volatile uint32_t g_logKick;
+static volatile bool g_logAsync;
+static volatile bool g_logDraining;    /* the log task is inside LogDrain() */
+static volatile bool g_logExc;         /* an exception hook ran, stay synchronous */
+static UINT32 g_logSem;
 
 static void dputs(char const *s, int (*pFputc)(int n, void *file), void *file)
 {
@@ -46,17 +84,184 @@ static void dputs(char const *s, int (*pFputc)(int n, void *file), void *file)
     LOS_IntRestore(intSave);
 }
 
+static inline volatile uint32_t *LogHdr(uint32_t off)
+{
+    return (volatile uint32_t *)&g_logRing[off];
+}
+
+/* Claim room for one line, returns the ring offset of its header or -1 when full */
+static int32_t LogReserve(uint32_t len)
+{
+    uint32_t need = LOG_HDR_SIZE + LOG_ALIGN4(len);
+    uint32_t head = __atomic_load_n(&g_logHead, __ATOMIC_RELAXED);
+    uint32_t off;
+    uint32_t pad;
+
+    do {
+        off = head & LOG_RING_MASK;
+        pad = (off + need > LOG_RING_SIZE) ? (LOG_RING_SIZE - off) : 0;
+        if ((head + pad + need) - __atomic_load_n(&g_logTail, __ATOMIC_ACQUIRE) > LOG_RING_SIZE) {
+            return -1;
+        }
+    } while (!__atomic_compare_exchange_n(&g_logHead, &head, head + pad + need, true,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+    if (pad != 0) {
+        __atomic_store_n(LogHdr(off), LOG_HDR_COMMIT | LOG_HDR_PAD | pad, __ATOMIC_RELEASE);
+        off = 0;
+    }
+    return (int32_t)off;
+}
+
+static void LogWrite(const char *s, uint32_t len, const char *tail, uint32_t tailLen)
+{
+    int32_t off;
+
+    if (len + tailLen > LOG_HDR_LEN_MASK) {
+        len = LOG_HDR_LEN_MASK - tailLen;
+    }
+    off = LogReserve(len + tailLen);
+    if (off < 0) {
+        __atomic_fetch_add(&g_logDropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    (void)memcpy_s(&g_logRing[off + LOG_HDR_SIZE], LOG_RING_SIZE - off - LOG_HDR_SIZE, s, len);
+    if (tailLen != 0) {
+        (void)memcpy_s(&g_logRing[off + LOG_HDR_SIZE + len], LOG_RING_SIZE - off - LOG_HDR_SIZE - len,
+                       tail, tailLen);
+    }
+    __atomic_store_n(LogHdr(off), LOG_HDR_COMMIT | (len + tailLen), __ATOMIC_RELEASE);
+
+    /* one post per drain pass, later producers see the kick still pending */
+    if (!__atomic_exchange_n(&g_logKick, 1, __ATOMIC_ACQ_REL)) {
+        (void)LOS_SemPost(g_logSem);
+    }
+}
+
+/*
+ * Records are handed out in reservation order. The log task is the consumer,
+ * except when LogPuts() drains synchronously, which only happens while the
+ * task cannot run.
+ */
+static void LogDrain(void)
+{
+    uint32_t tail = g_logTail;
+    uint32_t dropped;
+
+    for (;;) {
+        uint32_t off = tail & LOG_RING_MASK;
+        uint32_t hdr = __atomic_load_n(LogHdr(off), __ATOMIC_ACQUIRE);
+        uint32_t len = hdr & LOG_HDR_LEN_MASK;
+        uint32_t step = len;
+
+        if (!(hdr & LOG_HDR_COMMIT)) {
+            break;
+        }
+        if (!(hdr & LOG_HDR_PAD)) {
+            for (uint32_t i = 0; i < len; i++) {
+                UartPutc(g_logRing[off + LOG_HDR_SIZE + i], 0);
+            }
+            step = LOG_HDR_SIZE + LOG_ALIGN4(len);
+        }
+
+        /* producers rely on reserved space reading as uncommitted */
+        (void)memset_s(&g_logRing[off], LOG_RING_SIZE - off, 0, step);
+        tail += step;
+        __atomic_store_n(&g_logTail, tail, __ATOMIC_RELEASE);
+    }
+
+    dropped = __atomic_exchange_n(&g_logDropped, 0, __ATOMIC_RELAXED);
+    if (dropped != 0) {
+        char note[48];
+        if (snprintf_s(note, sizeof(note), sizeof(note) - 1, "\n[log] %u lines dropped\n", dropped) > 0) {
+            for (char *p = note; *p; p++) {
+                UartPutc(*p, 0);
+            }
+        }
+    }
+}
+
+static VOID LogTaskEntry(VOID)
+{
+    g_logAsync = true;
+    for (;;) {
+        __atomic_store_n(&g_logKick, 0, __ATOMIC_RELEASE);
+        g_logDraining = true;
+        LogDrain();
+        g_logDraining = false;
+        (void)LOS_SemPend(g_logSem, LOS_WAIT_FOREVER);
+    }
+}
+
+/* Flush what the log task left behind before the exception report goes out */
+static VOID LogExcHook(EXC_TYPE excType)
+{
+    (void)excType;
+    g_logExc = true;
+    if (g_logAsync) {
+        LogDrain();
+    }
+}
+
+UINT32 DprintfTaskInit(VOID)
+{
+    UINT32 taskId;
+    UINT32 ret;
+    TSK_INIT_PARAM_S param = {0};
+
+    ret = LOS_SemCreate(0, &g_logSem);
+    if (ret != LOS_OK) {
+        return ret;
+    }
+
+    param.pfnTaskEntry = (TSK_ENTRY_FUNC)LogTaskEntry;
+    param.uwStackSize = LOG_TASK_STACK_SIZE;
+    param.pcName = "log";
+    param.usTaskPrio = LOG_TASK_PRIO;
+    ret = LOS_TaskCreate(&taskId, &param);
+    if (ret != LOS_OK) {
+        (void)LOS_SemDelete(g_logSem);
+        return ret;
+    }
+    (void)LOS_RegExcHook(EXC_INTERRUPT, LogExcHook);
+    (void)LOS_RegExcHook(EXC_PANIC, LogExcHook);
+    return LOS_OK;
+}
+
+/* An isr runs with interrupts locked too, but returns to the scheduler */
+static bool LogSync(void)
+{
+    return !g_logAsync || g_logExc || (OS_INT_INACTIVE && LOS_IntLocked());
+}
+
+static void LogPuts(const char *s, uint32_t len, const char *tail)
+{
+    if (LogSync()) {
+        /* a log task preempted in the middle of a record would print it twice */
+        if (g_logAsync && !g_logDraining) {
+            LogDrain();
+        }
+        dputs(s, UartPutc, 0);
+        if (tail != NULL) {
+            dputs(tail, UartPutc, 0);
+        }
+        return;
+    }
+    LogWrite(s, len, tail, (tail != NULL) ? strlen(tail) : 0);
+}
+
 int __wrap_printf(char const  *fmt, ...)
 {
-    char logBuf[1024];
+    char logBuf[LOG_LINE_MAX];
     va_list sap;
     va_start(sap, fmt);
-    int len = vsnprintf_s(logBuf, sizeof(logBuf), sizeof(logBuf) - 1, fmt, sap);   
+    int len = vsnprintf_s(logBuf, sizeof(logBuf), sizeof(logBuf) - 1, fmt, sap);
     va_end(sap);
     if (len > 0) {
-        dputs(logBuf, UartPutc, 0);
+        LogPuts(logBuf, len, NULL);
     } else {
-        dputs("printf error!\n", UartPutc, 0);
+        LogPuts("printf error!\n", sizeof("printf error!\n") - 1, NULL);
     }
     return len;
 }
@@ -76,9 +281,9 @@ int HiLogWriteInternal(const char *buffer, size_t bufLen)
     }
 
     if (buffer[bufLen - BUFF_TAIL_LEN] != '\n') {
-        printf("%s\n", buffer);
+        LogPuts(buffer, bufLen - 1, "\n");
     } else {
-        dputs(buffer, UartPutc, 0);
+        LogPuts(buffer, bufLen - 1, NULL);
     }
     return 0;
 }
@@ -28,10 +28,12 @@
 #include "riscv_hal.h"
 #include "hiview_output_log.h"
 #include "hpm_littlefs.h"
+#include "trace_log.h"
 
 int DeviceManagerStart(void);
 void OHOS_SystemInit(void);
 UINT32 LosShellInit(VOID);
+UINT32 DprintfTaskInit(VOID);
 
 void _init(void) {}
 void _fini(void) {}
@@ -49,6 +51,7 @@ LITE_OS_SEC_TEXT_INIT INT32 main(VOID)
 {
     UINT32 ret;
     board_init();
+    HpmTraceInit();
     UartInit();
     board_print_banner();
     board_print_clock_freq();
@@ -64,6 +67,11 @@ LITE_OS_SEC_TEXT_INIT INT32 main(VOID)
     HalPlicInit();
     Uart0RxIrqRegister();
 
+    ret = DprintfTaskInit();
+    if (ret != LOS_OK) {
+        printf("DprintfTaskInit failed, console output stays synchronous! ERROR: 0x%x\n", ret);
+    }
+
 #if defined(LOSCFG_SUPPORT_LITTLEFS)
     HpmLittlefsInit();
 #endif
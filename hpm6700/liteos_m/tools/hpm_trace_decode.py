@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 HPMicro.
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Expand a g_hpmTrace dump (see trace_log.h) into text using the firmware ELF.
+
+Dump the ring from a halted target, e.g. with OpenOCD:
+    dump_image trace.bin <address of g_hpmTrace> <sizeof(g_hpmTrace)>
+then run:
+    hpm_trace_decode.py OHOS_Image.elf trace.bin
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+TRACE_MAGIC = 0x48545243
+TRACE_TAG = 0xA5000000
+TRACE_TAG_MASK = 0xFF000000
+TRACE_HDR_WORDS = 3
+TRACE_ARGS_MAX = 6
+TRACE_FMT_SECTION = "hpm_trace_fmt"
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+FMT_SPEC = re.compile(r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+))?(hh|h|ll|l|j|z|t)?([diouxXcsp%])")
+
+
+class Elf32:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError("%s: not a little endian ELF32 file" % path)
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 0x2E)
+        raw = [struct.unpack_from("<IIIIIIIIII", self.data, shoff + i * shentsize) for i in range(shnum)]
+        strtab = raw[shstrndx]
+        self.sections = []
+        for sh in raw:
+            name_off, sh_type, flags, addr, offset, size = sh[:6]
+            start = strtab[4] + name_off
+            name = self.data[start:self.data.index(b"\0", start)].decode()
+            self.sections.append((name, sh_type, flags, addr, offset, size))
+
+    def section(self, name):
+        for sec in self.sections:
+            if sec[0] == name:
+                return sec
+        return None
+
+    def cstring(self, addr):
+        """Read a NUL terminated string at a load address, None if not in the image."""
+        for name, sh_type, flags, base, offset, size in self.sections:
+            if not (flags & SHF_ALLOC) or sh_type == SHT_NOBITS:
+                continue
+            if base <= addr < base + size:
+                start = offset + addr - base
+                end = self.data.find(b"\0", start, offset + size)
+                if end < 0:
+                    return None
+                return self.data[start:end].decode("utf-8", "replace")
+        return None
+
+
+def c_format(fmt, args, elf):
+    """printf with 32-bit integer arguments, %s is looked up in the image."""
+    it = iter(args)
+
+    def next_arg():
+        return next(it, 0)
+
+    def repl(m):
+        flags, width, prec, _, conv = m.groups()
+        if conv == "%":
+            return "%"
+        if width == "*":
+            width = str(struct.unpack("<i", struct.pack("<I", next_arg()))[0])
+        value = next_arg()
+        spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+        if conv in "di":
+            return (spec + "d") % struct.unpack("<i", struct.pack("<I", value))[0]
+        if conv == "u":
+            return (spec + "d") % value
+        if conv == "c":
+            return (spec + "c") % chr(value & 0xFF)
+        if conv == "p":
+            return (spec + "s") % ("0x%08x" % value)
+        if conv == "s":
+            text = elf.cstring(value)
+            return (spec + "s") % (text if text is not None else "<0x%08x>" % value)
+        return (spec + conv) % value
+
+    return FMT_SPEC.sub(repl, fmt)
+
+
+def ring_words(dump):
+    magic, words, ts_freq, head = struct.unpack_from("<IIII", dump, 0)
+    if magic != TRACE_MAGIC:
+        raise ValueError("dump does not start with the g_hpmTrace magic")
+    if len(dump) < 16 + words * 4:
+        raise ValueError("dump is shorter than the %u word ring" % words)
+    buf = struct.unpack_from("<%uI" % words, dump, 16)
+    # head is free running and wraps at 2^32, never written words read as 0 and
+    # are skipped by the tag check in decode()
+    start = head % words if words else 0
+    return list(buf[start:] + buf[:start]), ts_freq
+
+
+def decode(elf, dump):
+    """Yield (timestamp ticks, text, ts_freq) for every complete record, oldest first."""
+    fmt_sec = elf.section(TRACE_FMT_SECTION)
+    if fmt_sec is None:
+        raise ValueError("ELF has no %s section, HPM_TRACE was never used" % TRACE_FMT_SECTION)
+    fmt_lo, fmt_hi = fmt_sec[3], fmt_sec[3] + fmt_sec[5]
+    words, ts_freq = ring_words(dump)
+
+    i = 0
+    while i + TRACE_HDR_WORDS <= len(words):
+        hdr, fmt_addr, ts_lo = words[i:i + TRACE_HDR_WORDS]
+        nargs = (hdr >> 16) & 0xFF
+        end = i + TRACE_HDR_WORDS + nargs
+        # the oldest record may be cut by the wrap, resync on the next valid tag
+        if (hdr & TRACE_TAG_MASK) != TRACE_TAG or nargs > TRACE_ARGS_MAX or \
+                not fmt_lo <= fmt_addr < fmt_hi or end > len(words):
+            i += 1
+            continue
+        fmt = elf.cstring(fmt_addr)
+        ts = ((hdr & 0xFFFF) << 32) | ts_lo
+        yield ts, c_format(fmt, words[i + TRACE_HDR_WORDS:end], elf), ts_freq
+        i = end
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elf", help="firmware ELF with the %s section" % TRACE_FMT_SECTION)
+    parser.add_argument("dump", help="raw memory dump of g_hpmTrace")
+    args = parser.parse_args()
+
+    elf = Elf32(args.elf)
+    with open(args.dump, "rb") as f:
+        dump = f.read()
+
+    try:
+        for ts, text, ts_freq in decode(elf, dump):
+            stamp = "%.6f" % (ts / ts_freq) if ts_freq else "%u" % ts
+            sys.stdout.write("[%s] %s" % (stamp, text if text.endswith("\n") else text + "\n"))
+    except ValueError as e:
+        sys.stderr.write("hpm_trace_decode: %s\n" % e)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
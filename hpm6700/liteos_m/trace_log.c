@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_log.h"
+#include "hpm_clock_drv.h"
+
+struct HpmTraceBuf g_hpmTrace __attribute__((used)) = {
+    .magic = HPM_TRACE_MAGIC,
+    .words = HPM_TRACE_WORDS,
+};
+
+void HpmTraceInit(void)
+{
+    g_hpmTrace.tsFreq = clock_get_frequency(clock_mchtmr0);
+}
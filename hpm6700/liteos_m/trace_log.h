@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HPM_TRACE_LOG_H
+#define _HPM_TRACE_LOG_H
+
+#include <stdint.h>
+#include "hpm_soc.h"
+#include "hpm_mchtmr_drv.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/*
+ * Deferred formatting trace log.
+ *
+ * HPM_TRACE(fmt, ...) stores the address of <fmt>, a 64-bit mchtmr timestamp
+ * and up to HPM_TRACE_ARGS_MAX raw 32-bit arguments in a RAM ring; nothing is
+ * formatted on target. Format strings are collected in the hpm_trace_fmt
+ * section so tools/hpm_trace_decode.py can turn a dump of g_hpmTrace back
+ * into text with the ELF. Arguments must be integers or pointers, %s is only
+ * resolved for strings in the image. The ring overwrites its oldest records.
+ *
+ * Record layout in 32-bit words:
+ *   [0] HPM_TRACE_TAG | nargs << 16 | timestamp[47:32]
+ *   [1] format string address
+ *   [2] timestamp[31:0]
+ *   [3...] arguments
+ */
+#define HPM_TRACE_MAGIC     0x48545243U /* "HTRC" */
+#define HPM_TRACE_TAG       0xA5000000U
+#define HPM_TRACE_TAG_MASK  0xFF000000U
+#define HPM_TRACE_HDR_WORDS 3
+#define HPM_TRACE_ARGS_MAX  6
+#define HPM_TRACE_WORDS     1024 /* power of 2 */
+
+struct HpmTraceBuf {
+    uint32_t magic;
+    uint32_t words;
+    uint32_t tsFreq;        /* mchtmr ticks per second, 0 until HpmTraceInit */
+    volatile uint32_t head; /* next word to write, free running */
+    uint32_t buf[HPM_TRACE_WORDS];
+};
+
+extern struct HpmTraceBuf g_hpmTrace;
+
+void HpmTraceInit(void);
+
+static inline __attribute__((always_inline)) void HpmTraceWrite(const char *fmt, uint32_t nargs,
+                                                                 const uint32_t *args)
+{
+    const uint32_t mask = HPM_TRACE_WORDS - 1;
+    uint64_t ts = mchtmr_get_count(HPM_MCHTMR);
+    uint32_t pos = __atomic_fetch_add(&g_hpmTrace.head, HPM_TRACE_HDR_WORDS + nargs, __ATOMIC_RELAXED);
+
+    g_hpmTrace.buf[(pos + 1) & mask] = (uint32_t)(uintptr_t)fmt;
+    g_hpmTrace.buf[(pos + 2) & mask] = (uint32_t)ts;
+    for (uint32_t i = 0; i < nargs; i++) {
+        g_hpmTrace.buf[(pos + HPM_TRACE_HDR_WORDS + i) & mask] = args[i];
+    }
+    /* tag last, a decoder never sees a tagged record with a stale body */
+    __atomic_store_n(&g_hpmTrace.buf[pos & mask],
+                     HPM_TRACE_TAG | (nargs << 16) | ((uint32_t)(ts >> 32) & 0xFFFFU), __ATOMIC_RELEASE);
+}
+
+#define HPM_TRACE_ARG(x) ((uint32_t)(uintptr_t)(x))
+#define HPM_TRACE_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define HPM_TRACE_NARGS(...) HPM_TRACE_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define HPM_TRACE_MAP0()
+#define HPM_TRACE_MAP1(a) HPM_TRACE_ARG(a)
+#define HPM_TRACE_MAP2(a, ...) HPM_TRACE_ARG(a), HPM_TRACE_MAP1(__VA_ARGS__)
+#define HPM_TRACE_MAP3(a, ...) HPM_TRACE_ARG(a), HPM_TRACE_MAP2(__VA_ARGS__)
+#define HPM_TRACE_MAP4(a, ...) HPM_TRACE_ARG(a), HPM_TRACE_MAP3(__VA_ARGS__)
+#define HPM_TRACE_MAP5(a, ...) HPM_TRACE_ARG(a), HPM_TRACE_MAP4(__VA_ARGS__)
+#define HPM_TRACE_MAP6(a, ...) HPM_TRACE_ARG(a), HPM_TRACE_MAP5(__VA_ARGS__)
+#define HPM_TRACE_MAP_(n, ...) HPM_TRACE_MAP##n(__VA_ARGS__)
+#define HPM_TRACE_MAP(n, ...) HPM_TRACE_MAP_(n, ##__VA_ARGS__)
+
+#define HPM_TRACE(fmt, ...) do { \
+        static const char hpmTraceFmt[] __attribute__((section("hpm_trace_fmt"), used)) = fmt; \
+        const uint32_t hpmTraceArgs[HPM_TRACE_NARGS(__VA_ARGS__) + 1] = { \
+            HPM_TRACE_MAP(HPM_TRACE_NARGS(__VA_ARGS__), ##__VA_ARGS__) }; \
+        HpmTraceWrite(hpmTraceFmt, HPM_TRACE_NARGS(__VA_ARGS__), hpmTraceArgs); \
+    } while (0)
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif
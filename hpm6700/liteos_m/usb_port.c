@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2023 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usbd_core.h"
+#include "hpm_soc.h"
+#include "soc.h"
+#include "los_debug.h"
+#include "los_interrupt.h"
+
+/*
+ * The usb vector of the port is declared with SDK_DECLARE_EXT_ISR_M, which
+ * LiteOS-M does not dispatch, install the handler as a LiteOS-M hwi instead.
+ * usb_dc_init() enables the irq once the controller is set up.
+ */
+extern void USBD_IRQHandler(void);
+
+static __attribute__((section(".interrupt.text"))) VOID HpmUsbdIsr(VOID *parm)
+{
+    (void)parm;
+    USBD_IRQHandler();
+}
+
+void usb_dc_low_level_init(void)
+{
+    HwiIrqParam irqParam;
+
+    irqParam.pDevId = NULL;
+    if (LOS_HwiCreate(HPM2LITEOS_IRQ(CONFIG_HPM_USBD_IRQn), 1, 0, (HWI_PROC_FUNC)HpmUsbdIsr, &irqParam) != LOS_OK) {
+        PRINT_ERR("usb_dc_low_level_init: create usb irq failed\n");
+    }
+}
+
+void usb_dc_low_level_deinit(void)
+{
+    LOS_HwiDelete(HPM2LITEOS_IRQ(CONFIG_HPM_USBD_IRQn), NULL);
+}
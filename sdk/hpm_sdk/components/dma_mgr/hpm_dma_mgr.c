@@ -24,7 +24,6 @@ typedef struct _dma_instance_info {
  * @brief DMA Channel Context Structure
  */
 typedef struct _dma_channel_context {
-    bool is_allocated;                               /**< Whether DMA channel was allocated */
     void *tc_cb_data_ptr;                            /**< User data required by transfer complete callback */
     void *half_tc_cb_data_ptr;                       /**< User data required by half transfer complete callback */
     void *error_cb_data_ptr;                         /**< User data required by error callback */
@@ -42,8 +41,13 @@ typedef struct _dma_channel_context {
 typedef struct _dma_mgr_context {
     dma_chn_info_t dma_instance[DMA_SOC_MAX_COUNT];                                  /**< DMA instances */
     dma_chn_context_t channels[DMA_SOC_MAX_COUNT][DMA_SOC_CHANNEL_NUM];              /**< Array of DMA channels */
+    uint32_t chn_free_bitmap[DMA_SOC_MAX_COUNT];                                     /**< Bit n is set if channel n is free */
+    uint32_t desc_used_bitmap[(DMA_MGR_DESCRIPTOR_POOL_SIZE + 31U) / 32U];          /**< Bit n is set if descriptor n is allocated */
 } dma_mgr_context_t;
 
+#define DMA_MGR_CHANNEL_BITMAP_ALL (0xFFFFFFFFUL >> (32U - DMA_SOC_CHANNEL_NUM))
+#define DMA_MGR_DESC_IS_USED(index) ((HPM_DMA_MGR->desc_used_bitmap[(index) / 32U] & (1UL << ((index) % 32U))) != 0U)
+
 
 /*****************************************************************************************************************
  *
@@ -77,55 +81,113 @@ SDK_DECLARE_EXT_ISR_M(IRQn_XDMA, dma1_isr);
  *****************************************************************************************************************/
 static dma_mgr_context_t s_dma_mngr_ctx;
 #define HPM_DMA_MGR (&s_dma_mngr_ctx)
+ATTR_PLACE_AT_NONCACHEABLE_WITH_ALIGNMENT(8) static dma_mgr_linked_descriptor_t s_dma_mgr_desc_pool[DMA_MGR_DESCRIPTOR_POOL_SIZE];
 
 /*****************************************************************************************************************
  *
  *  Codes
  *
  *****************************************************************************************************************/
-static inline void handle_dma_isr(DMA_Type *ptr, uint32_t instance)
+static inline uint32_t dma_mgr_find_first_set(uint32_t bitmap)
+{
+    return (uint32_t) __builtin_ctz(bitmap);
+}
+
+static inline uint32_t dma_mgr_find_last_set(uint32_t bitmap)
+{
+    return 31U - (uint32_t) __builtin_clz(bitmap);
+}
+
+void dma_mgr_isr_handler(DMA_Type *ptr, uint32_t instance)
 {
     uint32_t int_disable_mask;
-    uint32_t chn_int_stat;
+    uint32_t tc_stat;
+    uint32_t half_tc_stat;
+    uint32_t error_stat;
+    uint32_t abort_stat;
+    uint32_t pending;
+    uint32_t channel;
+    uint32_t chn_bit;
     dma_chn_context_t *chn_ctx;
 
-    for (uint8_t channel = 0; channel < DMA_SOC_CHANNEL_NUM; channel++) {
+    /*
+     * Read the status of all channels at once, then only visit the channels that have a status bit set. Status bits
+     * whose interrupt is masked belong to a polled channel, they are neither cleared nor dispatched here.
+     */
+#ifdef HPMSOC_HAS_HPMSDK_DMAV2
+    tc_stat = ptr->INTTCSTS;
+    half_tc_stat = ptr->INTHALFSTS;
+    error_stat = ptr->INTERRSTS;
+    abort_stat = ptr->INTABORTSTS;
+#else
+    pending = ptr->INTSTATUS;
+    tc_stat = (pending >> DMA_STATUS_TC_SHIFT) & DMA_MGR_CHANNEL_BITMAP_ALL;
+    half_tc_stat = 0;
+    error_stat = (pending >> DMA_STATUS_ERROR_SHIFT) & DMA_MGR_CHANNEL_BITMAP_ALL;
+    abort_stat = (pending >> DMA_STATUS_ABORT_SHIFT) & DMA_MGR_CHANNEL_BITMAP_ALL;
+#endif
+    pending = tc_stat | half_tc_stat | error_stat | abort_stat;
+
+    while (pending != 0U) {
+        channel = dma_mgr_find_first_set(pending);
+        chn_bit = 1UL << channel;
+        pending &= ~chn_bit;
         int_disable_mask = dma_check_channel_interrupt_mask(ptr, channel);
-        chn_int_stat = dma_check_transfer_status(ptr, channel);
+        if ((int_disable_mask & DMA_MGR_INTERRUPT_MASK_TC) != 0) {
+            tc_stat &= ~chn_bit;
+        }
+        if ((int_disable_mask & DMA_MGR_INTERRUPT_MASK_HALF_TC) != 0) {
+            half_tc_stat &= ~chn_bit;
+        }
+        if ((int_disable_mask & DMA_MGR_INTERRUPT_MASK_ERROR) != 0) {
+            error_stat &= ~chn_bit;
+        }
+        if ((int_disable_mask & DMA_MGR_INTERRUPT_MASK_ABORT) != 0) {
+            abort_stat &= ~chn_bit;
+        }
+    }
+
+#ifdef HPMSOC_HAS_HPMSDK_DMAV2
+    ptr->INTTCSTS = tc_stat;
+    ptr->INTHALFSTS = half_tc_stat;
+    ptr->INTERRSTS = error_stat;
+    ptr->INTABORTSTS = abort_stat;
+#else
+    ptr->INTSTATUS = (tc_stat << DMA_STATUS_TC_SHIFT) | (error_stat << DMA_STATUS_ERROR_SHIFT)
+                   | (abort_stat << DMA_STATUS_ABORT_SHIFT);
+#endif
+    pending = tc_stat | half_tc_stat | error_stat | abort_stat;
+
+    while (pending != 0U) {
+        channel = dma_mgr_find_first_set(pending);
+        chn_bit = 1UL << channel;
+        pending &= ~chn_bit;
         chn_ctx = &HPM_DMA_MGR->channels[instance][channel];
 
-        if (((int_disable_mask & DMA_MGR_INTERRUPT_MASK_TC) == 0) && ((chn_int_stat & DMA_MGR_CHANNEL_STATUS_TC) != 0)) {
-            if (chn_ctx->tc_cb != NULL) {
-                chn_ctx->tc_cb(ptr, channel, chn_ctx->tc_cb_data_ptr);
-            }
+        if (((tc_stat & chn_bit) != 0) && (chn_ctx->tc_cb != NULL)) {
+            chn_ctx->tc_cb(ptr, channel, chn_ctx->tc_cb_data_ptr);
         }
-        if (((int_disable_mask & DMA_MGR_INTERRUPT_MASK_HALF_TC) == 0) && ((chn_int_stat & DMA_MGR_CHANNEL_STATUS_HALF_TC) != 0)) {
-            if (chn_ctx->half_tc_cb != NULL) {
-                chn_ctx->half_tc_cb(ptr, channel, chn_ctx->half_tc_cb_data_ptr);
-            }
+        if (((half_tc_stat & chn_bit) != 0) && (chn_ctx->half_tc_cb != NULL)) {
+            chn_ctx->half_tc_cb(ptr, channel, chn_ctx->half_tc_cb_data_ptr);
         }
-        if (((int_disable_mask & DMA_MGR_INTERRUPT_MASK_ERROR) == 0) && ((chn_int_stat & DMA_MGR_CHANNEL_STATUS_ERROR) != 0)) {
-            if (chn_ctx->error_cb != NULL) {
-                chn_ctx->error_cb(ptr, channel, chn_ctx->error_cb_data_ptr);
-            }
+        if (((error_stat & chn_bit) != 0) && (chn_ctx->error_cb != NULL)) {
+            chn_ctx->error_cb(ptr, channel, chn_ctx->error_cb_data_ptr);
         }
-        if (((int_disable_mask & DMA_MGR_INTERRUPT_MASK_ABORT) == 0) && ((chn_int_stat & DMA_MGR_CHANNEL_STATUS_ABORT) != 0)) {
-            if (chn_ctx->abort_cb != NULL) {
-                chn_ctx->abort_cb(ptr, channel, chn_ctx->abort_cb_data_ptr);
-            }
+        if (((abort_stat & chn_bit) != 0) && (chn_ctx->abort_cb != NULL)) {
+            chn_ctx->abort_cb(ptr, channel, chn_ctx->abort_cb_data_ptr);
         }
     }
 }
 
 void dma0_isr(void)
 {
-    handle_dma_isr(HPM_HDMA, 0);
+    dma_mgr_isr_handler(HPM_HDMA, 0);
 }
 
 #if defined(DMA_SOC_MAX_COUNT) && (DMA_SOC_MAX_COUNT > 1)
 void dma1_isr(void)
 {
-    handle_dma_isr(HPM_XDMA, 1);
+    dma_mgr_isr_handler(HPM_XDMA, 1);
 }
 #endif
 
@@ -148,33 +210,52 @@ void dma_mgr_init(void)
     HPM_DMA_MGR->dma_instance[1].base = HPM_XDMA;
     HPM_DMA_MGR->dma_instance[1].irq_num = IRQn_XDMA;
  #endif
+    for (uint32_t instance = 0; instance < DMA_SOC_MAX_COUNT; instance++) {
+        HPM_DMA_MGR->chn_free_bitmap[instance] = DMA_MGR_CHANNEL_BITMAP_ALL;
+    }
 }
 
 hpm_stat_t dma_mgr_request_resource(dma_resource_t *resource)
+{
+    return dma_mgr_request_resource_with_hint(resource, NULL);
+}
+
+hpm_stat_t dma_mgr_request_resource_with_hint(dma_resource_t *resource, const dma_mgr_resource_hint_t *hint)
 {
     hpm_stat_t status;
+    uint32_t preferred = DMA_MGR_INSTANCE_ANY;
+    bool instance_only = false;
+    bool high_priority = true;
+
+    if (hint != NULL) {
+        preferred = hint->instance;
+        instance_only = hint->instance_only;
+        high_priority = hint->high_priority;
+    }
 
-    if (resource == NULL) {
+    if ((resource == NULL) || ((preferred != DMA_MGR_INSTANCE_ANY) && (preferred >= DMA_SOC_MAX_COUNT))) {
         status = status_invalid_argument;
     } else {
-        uint32_t instance;
+        uint32_t instance = 0;
         uint32_t channel;
-        bool has_found = false;
+        uint32_t bitmap = 0;
         uint32_t level = dma_mgr_enter_critical();
-        for (instance = 0; instance < DMA_SOC_MAX_COUNT; instance++) {
-            for (channel = 0; channel < DMA_SOC_CHANNEL_NUM; channel++) {
-                if (!HPM_DMA_MGR->channels[instance][channel].is_allocated) {
-                    has_found = true;
+        if (preferred != DMA_MGR_INSTANCE_ANY) {
+            instance = preferred;
+            bitmap = HPM_DMA_MGR->chn_free_bitmap[instance];
+        }
+        if ((bitmap == 0U) && !instance_only) {
+            for (instance = 0; instance < DMA_SOC_MAX_COUNT; instance++) {
+                bitmap = HPM_DMA_MGR->chn_free_bitmap[instance];
+                if (bitmap != 0U) {
                     break;
                 }
             }
-            if (has_found) {
-                break;
-            }
         }
 
-        if (has_found) {
-            HPM_DMA_MGR->channels[instance][channel].is_allocated = true;
+        if (bitmap != 0U) {
+            channel = high_priority ? dma_mgr_find_first_set(bitmap) : dma_mgr_find_last_set(bitmap);
+            HPM_DMA_MGR->chn_free_bitmap[instance] &= ~(1UL << channel);
             resource->base = HPM_DMA_MGR->dma_instance[instance].base;
             resource->channel = channel;
             resource->irq_num = HPM_DMA_MGR->dma_instance[instance].irq_num;
@@ -206,7 +287,7 @@ static dma_chn_context_t *dma_mgr_search_chn_context(const dma_resource_t *resou
 
         channel = resource->channel;
         if (has_found) {
-            if (HPM_DMA_MGR->channels[instance][channel].is_allocated) {
+            if ((HPM_DMA_MGR->chn_free_bitmap[instance] & (1UL << channel)) == 0U) {
                 chn_ctx = &HPM_DMA_MGR->channels[instance][channel];
             }
         }
@@ -224,8 +305,9 @@ hpm_stat_t dma_mgr_release_resource(const dma_resource_t *resource)
     if (chn_ctx == NULL) {
         status = status_invalid_argument;
     } else {
+        uint32_t instance = (uint32_t) (chn_ctx - &HPM_DMA_MGR->channels[0][0]) / DMA_SOC_CHANNEL_NUM;
         uint32_t level = dma_mgr_enter_critical();
-        chn_ctx->is_allocated = false;
+        HPM_DMA_MGR->chn_free_bitmap[instance] |= 1UL << resource->channel;
         chn_ctx->tc_cb_data_ptr = NULL;
         chn_ctx->half_tc_cb_data_ptr = NULL;
         chn_ctx->error_cb_data_ptr = NULL;
@@ -356,6 +438,32 @@ void dma_mgr_get_default_chn_config(dma_mgr_chn_conf_t *config)
     config->burst_opt = DMA_MGR_SRC_BURST_OPT_STANDAND_SIZE;
 }
 
+static void dma_mgr_convert_chn_config(const dma_mgr_chn_conf_t *config, dma_channel_config_t *dma_config)
+{
+    dma_config->priority = config->priority;
+    dma_config->src_burst_size = config->src_burst_size;
+    dma_config->src_mode = config->src_mode;
+    dma_config->dst_mode = config->dst_mode;
+    dma_config->src_width = config->src_width;
+    dma_config->dst_width = config->dst_width;
+    dma_config->src_addr_ctrl = config->src_addr_ctrl;
+    dma_config->dst_addr_ctrl = config->dst_addr_ctrl;
+    dma_config->src_addr = config->src_addr;
+    dma_config->dst_addr = config->dst_addr;
+    dma_config->size_in_byte = config->size_in_byte;
+    dma_config->linked_ptr = config->linked_ptr;
+    dma_config->interrupt_mask = config->interrupt_mask;
+#ifdef DMA_MGR_HAS_INFINITE_LOOP
+    dma_config->en_infiniteloop = config->en_infiniteloop;
+#endif
+#ifdef DMA_MGR_HAS_HANDSHAKE_OPT
+    dma_config->handshake_opt = config->handshake_opt;
+#endif
+#ifdef DMA_MGR_HAS_BURST_OPT
+    dma_config->burst_opt = config->burst_opt;
+#endif
+}
+
 hpm_stat_t dma_mgr_setup_channel(const dma_resource_t *resource, dma_mgr_chn_conf_t *config)
 {
     hpm_stat_t status;
@@ -369,28 +477,7 @@ hpm_stat_t dma_mgr_setup_channel(const dma_resource_t *resource, dma_mgr_chn_con
     } else {
         dmamux_ch = DMA_SOC_CHN_TO_DMAMUX_CHN(resource->base, resource->channel);
         dmamux_config(HPM_DMAMUX, dmamux_ch, config->dmamux_src, config->en_dmamux);
-        dma_config.priority = config->priority;
-        dma_config.src_burst_size = config->src_burst_size;
-        dma_config.src_mode = config->src_mode;
-        dma_config.dst_mode = config->dst_mode;
-        dma_config.src_width = config->src_width;
-        dma_config.dst_width = config->dst_width;
-        dma_config.src_addr_ctrl = config->src_addr_ctrl;
-        dma_config.dst_addr_ctrl = config->dst_addr_ctrl;
-        dma_config.src_addr = config->src_addr;
-        dma_config.dst_addr = config->dst_addr;
-        dma_config.size_in_byte = config->size_in_byte;
-        dma_config.linked_ptr = config->linked_ptr;
-        dma_config.interrupt_mask = config->interrupt_mask;
-#ifdef DMA_MGR_HAS_INFINITE_LOOP
-        dma_config.en_infiniteloop = config->en_infiniteloop;
-#endif
-#ifdef DMA_MGR_HAS_HANDSHAKE_OPT
-        dma_config.handshake_opt = config->handshake_opt;
-#endif
-#ifdef DMA_MGR_HAS_BURST_OPT
-        dma_config.burst_opt = config->burst_opt;
-#endif
+        dma_mgr_convert_chn_config(config, &dma_config);
         status = dma_setup_channel(resource->base, resource->channel, &dma_config, false);
     }
     return status;
@@ -406,33 +493,244 @@ hpm_stat_t dma_mgr_config_linked_descriptor(const dma_resource_t *resource, dma_
     if (chn_ctx == NULL) {
         status = status_invalid_argument;
     } else {
-        dma_config.priority = config->priority;
-        dma_config.src_burst_size = config->src_burst_size;
-        dma_config.src_mode = config->src_mode;
-        dma_config.dst_mode = config->dst_mode;
-        dma_config.src_width = config->src_width;
-        dma_config.dst_width = config->dst_width;
-        dma_config.src_addr_ctrl = config->src_addr_ctrl;
-        dma_config.dst_addr_ctrl = config->dst_addr_ctrl;
-        dma_config.src_addr = config->src_addr;
-        dma_config.dst_addr = config->dst_addr;
-        dma_config.size_in_byte = config->size_in_byte;
-        dma_config.linked_ptr = config->linked_ptr;
-        dma_config.interrupt_mask = config->interrupt_mask;
-#ifdef DMA_MGR_HAS_INFINITE_LOOP
-        dma_config.en_infiniteloop = config->en_infiniteloop;
-#endif
-#ifdef DMA_MGR_HAS_HANDSHAKE_OPT
-        dma_config.handshake_opt = config->handshake_opt;
-#endif
-#ifdef DMA_MGR_HAS_BURST_OPT
-        dma_config.burst_opt = config->burst_opt;
-#endif
+        dma_mgr_convert_chn_config(config, &dma_config);
         status = dma_config_linked_descriptor(resource->base, (dma_linked_descriptor_t *)descriptor, resource->channel, &dma_config);
     }
     return status;
 }
 
+dma_mgr_linked_descriptor_t *dma_mgr_alloc_linked_descriptors(uint32_t count)
+{
+    dma_mgr_linked_descriptor_t *descriptor = NULL;
+    uint32_t run = 0;
+    uint32_t index;
+
+    if ((count == 0U) || (count > DMA_MGR_DESCRIPTOR_POOL_SIZE)) {
+        return NULL;
+    }
+
+    uint32_t level = dma_mgr_enter_critical();
+    for (index = 0; index < DMA_MGR_DESCRIPTOR_POOL_SIZE; index++) {
+        run = DMA_MGR_DESC_IS_USED(index) ? 0U : (run + 1U);
+        if (run == count) {
+            break;
+        }
+    }
+    if (run == count) {
+        index = index + 1U - count;
+        descriptor = &s_dma_mgr_desc_pool[index];
+        for (; count > 0U; count--, index++) {
+            HPM_DMA_MGR->desc_used_bitmap[index / 32U] |= 1UL << (index % 32U);
+        }
+    }
+    dma_mgr_exit_critical(level);
+
+    return descriptor;
+}
+
+hpm_stat_t dma_mgr_free_linked_descriptors(dma_mgr_linked_descriptor_t *descriptor, uint32_t count)
+{
+    uint32_t index;
+
+    if ((descriptor < &s_dma_mgr_desc_pool[0]) || (descriptor >= &s_dma_mgr_desc_pool[DMA_MGR_DESCRIPTOR_POOL_SIZE]) ||
+        (count == 0U) || (count > (uint32_t)(&s_dma_mgr_desc_pool[DMA_MGR_DESCRIPTOR_POOL_SIZE] - descriptor))) {
+        return status_invalid_argument;
+    }
+
+    index = (uint32_t)(descriptor - &s_dma_mgr_desc_pool[0]);
+    uint32_t level = dma_mgr_enter_critical();
+    for (; count > 0U; count--, index++) {
+        HPM_DMA_MGR->desc_used_bitmap[index / 32U] &= ~(1UL << (index % 32U));
+    }
+    dma_mgr_exit_critical(level);
+
+    return status_success;
+}
+
+hpm_stat_t dma_mgr_config_linked_list(const dma_resource_t *resource, dma_mgr_chn_conf_t *config,
+                                      const dma_mgr_sg_entry_t *list, uint32_t count,
+                                      dma_mgr_linked_descriptor_t *descriptor, bool circular)
+{
+    hpm_stat_t status = status_success;
+    uint16_t interrupt_mask;
+    uint32_t next;
+
+    if ((config == NULL) || (list == NULL) || (count == 0U) || (descriptor == NULL)) {
+        return status_invalid_argument;
+    }
+
+    interrupt_mask = config->interrupt_mask;
+    /* Walk backwards so that config is left with entry 0 */
+    for (uint32_t i = count; i > 0U; i--) {
+        next = i % count;
+        config->src_addr = list[i - 1U].src_addr;
+        config->dst_addr = list[i - 1U].dst_addr;
+        config->size_in_byte = list[i - 1U].size_in_byte;
+        if (circular || (i < count)) {
+            config->linked_ptr = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)&descriptor[next]);
+        } else {
+            config->linked_ptr = 0;
+        }
+        config->interrupt_mask = (circular || (i == count)) ? interrupt_mask : (interrupt_mask | DMA_MGR_INTERRUPT_MASK_TC);
+        if ((i > 1U) || circular) {
+            status = dma_mgr_config_linked_descriptor(resource, config, &descriptor[i - 1U]);
+            if (status != status_success) {
+                break;
+            }
+        }
+    }
+    return status;
+}
+
+static void dma_mgr_ring_tc_callback(DMA_Type *base, uint32_t channel, void *cb_data_ptr)
+{
+    dma_mgr_ring_t *ring = (dma_mgr_ring_t *)cb_data_ptr;
+    uint32_t index = ring->produced % ring->chunk_count;
+
+    (void) base;
+    (void) channel;
+    ring->produced = ring->produced + 1U;
+    if (ring->callback != NULL) {
+        ring->callback(ring, &ring->buf[index * ring->chunk_size], ring->user_data);
+    }
+}
+
+hpm_stat_t dma_mgr_ring_init(dma_mgr_ring_t *ring, const dma_resource_t *resource, const dma_mgr_ring_config_t *config)
+{
+    hpm_stat_t status = status_success;
+    dma_mgr_chn_conf_t *chn_config;
+    dma_mgr_linked_descriptor_t *descriptor;
+    uint32_t buf_addr;
+
+    if ((ring == NULL) || (config == NULL) || (config->buf == NULL) || (config->chunk_size == 0U) ||
+        (config->chunk_count == 0U) || (dma_mgr_search_chn_context(resource) == NULL)) {
+        return status_invalid_argument;
+    }
+
+    descriptor = dma_mgr_alloc_linked_descriptors(config->chunk_count);
+    if (descriptor == NULL) {
+        return status_dma_mgr_no_resource;
+    }
+
+    (void) memset(ring, 0, sizeof(*ring));
+    ring->resource = *resource;
+    ring->descriptors = descriptor;
+    ring->buf = config->buf;
+    ring->chunk_size = config->chunk_size;
+    ring->chunk_count = config->chunk_count;
+    ring->callback = config->callback;
+    ring->user_data = config->user_data;
+
+    /* Descriptor i moves chunk i and links to descriptor i + 1, the last one links back to descriptor 0.
+     * Walk backwards so that chn_config is left with chunk 0, which is loaded into the channel by start */
+    chn_config = &ring->chn_config;
+    *chn_config = config->chn_config;
+    chn_config->size_in_byte = config->chunk_size;
+    chn_config->interrupt_mask &= ~DMA_MGR_INTERRUPT_MASK_TC;
+    chn_config->en_infiniteloop = false;
+    buf_addr = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)config->buf);
+    for (uint32_t i = config->chunk_count; i > 0U; i--) {
+        if (config->buf_is_dst) {
+            chn_config->dst_addr = buf_addr + (i - 1U) * config->chunk_size;
+        } else {
+            chn_config->src_addr = buf_addr + (i - 1U) * config->chunk_size;
+        }
+        chn_config->linked_ptr = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)&descriptor[i % config->chunk_count]);
+        status = dma_mgr_config_linked_descriptor(resource, chn_config, &descriptor[i - 1U]);
+        if (status != status_success) {
+            break;
+        }
+    }
+    if (status != status_success) {
+        (void) dma_mgr_free_linked_descriptors(descriptor, config->chunk_count);
+        ring->descriptors = NULL;
+        return status;
+    }
+
+    return dma_mgr_install_chn_tc_callback(resource, dma_mgr_ring_tc_callback, ring);
+}
+
+hpm_stat_t dma_mgr_ring_deinit(dma_mgr_ring_t *ring)
+{
+    if ((ring == NULL) || (ring->descriptors == NULL)) {
+        return status_invalid_argument;
+    }
+    (void) dma_mgr_ring_stop(ring);
+    (void) dma_mgr_install_chn_tc_callback(&ring->resource, NULL, NULL);
+    (void) dma_mgr_free_linked_descriptors(ring->descriptors, ring->chunk_count);
+    ring->descriptors = NULL;
+    return status_success;
+}
+
+hpm_stat_t dma_mgr_ring_start(dma_mgr_ring_t *ring)
+{
+    hpm_stat_t status;
+
+    if ((ring == NULL) || (ring->descriptors == NULL)) {
+        return status_invalid_argument;
+    }
+    ring->produced = 0;
+    ring->consumed = 0;
+    status = dma_mgr_setup_channel(&ring->resource, &ring->chn_config);
+    if (status == status_success) {
+        status = dma_mgr_enable_channel(&ring->resource);
+    }
+    return status;
+}
+
+hpm_stat_t dma_mgr_ring_stop(dma_mgr_ring_t *ring)
+{
+    if (ring == NULL) {
+        return status_invalid_argument;
+    }
+    return dma_mgr_disable_channel(&ring->resource);
+}
+
+hpm_stat_t dma_mgr_ring_acquire(dma_mgr_ring_t *ring, uint8_t **chunk)
+{
+    uint32_t consumed;
+    uint32_t ready;
+
+    if ((ring == NULL) || (chunk == NULL)) {
+        return status_invalid_argument;
+    }
+    consumed = ring->consumed;
+    ready = ring->produced - consumed;
+    if (ready == 0U) {
+        return status_dma_mgr_ring_empty;
+    }
+    if (ready >= ring->chunk_count) {
+        /* The DMA is writing the oldest chunk, skip to the oldest one it will not touch before wrapping again */
+        ring->consumed = consumed + ready - ring->chunk_count + 1U;
+        ring->overrun_count++;
+        return status_dma_mgr_ring_overrun;
+    }
+    *chunk = &ring->buf[(consumed % ring->chunk_count) * ring->chunk_size];
+    return status_success;
+}
+
+hpm_stat_t dma_mgr_ring_release(dma_mgr_ring_t *ring)
+{
+    uint32_t consumed;
+    uint32_t ready;
+
+    if (ring == NULL) {
+        return status_invalid_argument;
+    }
+    consumed = ring->consumed;
+    ready = ring->produced - consumed;
+    if (ready == 0U) {
+        return status_dma_mgr_ring_empty;
+    }
+    if (ready >= ring->chunk_count) {
+        ring->consumed = consumed + ready - ring->chunk_count + 1U;
+        ring->overrun_count++;
+        return status_dma_mgr_ring_overrun;
+    }
+    ring->consumed = consumed + 1U;
+    return status_success;
+}
+
 hpm_stat_t dma_mgr_enable_channel(const dma_resource_t *resource)
 {
     hpm_stat_t status;
@@ -88,6 +88,15 @@
 #endif
 #define DMA_MGR_INTERRUPT_MASK_ALL            DMA_INTERRUPT_MASK_ALL
 
+#define DMA_MGR_INSTANCE_ANY                  (0xFFU)
+
+/**
+ * @brief Number of linked descriptors in the DMA Manager descriptor pool
+ */
+#ifndef DMA_MGR_DESCRIPTOR_POOL_SIZE
+#define DMA_MGR_DESCRIPTOR_POOL_SIZE          (32U)
+#endif
+
 #ifdef __cplusplus
 
 extern "C" {
@@ -98,6 +107,9 @@ extern "C" {
  */
 enum {
     status_dma_mgr_no_resource = MAKE_STATUS(status_group_dma_manager, 0), /**< No DMA resource available */
+    status_dma_mgr_ring_empty = MAKE_STATUS(status_group_dma_manager, 1),  /**< No chunk is ready in the DMA ring */
+    status_dma_mgr_ring_overrun = MAKE_STATUS(status_group_dma_manager, 2), /**< DMA wrapped onto chunks not yet released */
+    status_dma_mgr_memcpy_pending = MAKE_STATUS(status_group_dma_manager, 3), /**< DMA memcpy request not completed yet */
 };
 
 /**
@@ -139,15 +151,89 @@ typedef struct hpm_dma_mgr_chn_conf {
     uint8_t burst_opt;                /**< Burst size option. Attention: only DMAV2 support  */
 } dma_mgr_chn_conf_t;
 
+/**
+ * @brief DMA Resource allocation hint
+ */
+typedef struct _dma_mgr_resource_hint {
+    uint8_t instance;                 /**< Preferred DMA instance index, DMA_MGR_INSTANCE_ANY for no preference */
+    bool instance_only;               /**< Fail instead of falling back to the other DMA instances */
+    bool high_priority;               /**< Take the lowest free channel index, it is dispatched first by the ISR.
+                                           Otherwise take the highest one */
+} dma_mgr_resource_hint_t;
+
 typedef struct hpm_dma_mgr_linked_descriptor {
     uint32_t descriptor[8];
 } dma_mgr_linked_descriptor_t;
 
+/**
+ * @brief DMA scatter-gather list entry
+ */
+typedef struct _dma_mgr_sg_entry {
+    uint32_t src_addr;                /**< Source address */
+    uint32_t dst_addr;                /**< Destination address */
+    uint32_t size_in_byte;            /**< Size to be transferred in byte */
+} dma_mgr_sg_entry_t;
+
+typedef struct _dma_mgr_ring dma_mgr_ring_t;
+
+/**
+ * @brief DMA ring chunk ready callback, called from the DMA interrupt
+ *
+ * @param [in] ring DMA ring
+ * @param [in] chunk Chunk that was just completed by the DMA
+ * @param [in/out] user_data User data pointer
+ */
+typedef void (*dma_mgr_ring_cb_t)(dma_mgr_ring_t *ring, uint8_t *chunk, void *user_data);
+
+/**
+ * @brief DMA ring configuration
+ */
+typedef struct _dma_mgr_ring_config {
+    dma_mgr_chn_conf_t chn_config;    /**< Channel template, the address on the buffer side, size_in_byte and
+                                           linked_ptr are filled in by the ring */
+    bool buf_is_dst;                  /**< true for peripheral to memory streams, false for memory to peripheral */
+    uint8_t *buf;                     /**< Ring buffer, chunk_size * chunk_count bytes */
+    uint32_t chunk_size;              /**< Chunk size in byte, one linked descriptor per chunk */
+    uint32_t chunk_count;             /**< Number of chunks */
+    dma_mgr_ring_cb_t callback;       /**< Chunk ready callback, can be NULL */
+    void *user_data;                  /**< User data used in the callback */
+} dma_mgr_ring_config_t;
+
+/**
+ * @brief DMA ring context
+ *        The DMA is the producer, it advances produced on every chunk it completes. The application is the
+ *        consumer, it acquires and releases chunks in order. Both indices are free running
+ */
+struct _dma_mgr_ring {
+    dma_resource_t resource;                  /**< DMA resource driving the ring */
+    dma_mgr_chn_conf_t chn_config;            /**< Channel config of the first chunk */
+    dma_mgr_linked_descriptor_t *descriptors; /**< Descriptors taken from the descriptor pool */
+    uint8_t *buf;                             /**< Ring buffer */
+    uint32_t chunk_size;                      /**< Chunk size in byte */
+    uint32_t chunk_count;                     /**< Number of chunks */
+    volatile uint32_t produced;               /**< Chunks completed by the DMA, written by the DMA interrupt only */
+    volatile uint32_t consumed;               /**< Chunks released by the consumer, written by the consumer only */
+    uint32_t overrun_count;                   /**< Number of overruns seen by the consumer */
+    dma_mgr_ring_cb_t callback;               /**< Chunk ready callback */
+    void *user_data;                          /**< User data used in the callback */
+};
+
 /**
  * @brief Initialize DMA Manager Context
  */
 void dma_mgr_init(void);
 
+/**
+ * @brief DMA Manager interrupt handler
+ *        NOTE: The SDK vector table calls it automatically, ports that dispatch external interrupts
+ *              by themselves (e.g. an RTOS interrupt controller layer) should call it from their own
+ *              DMA interrupt handler
+ *
+ * @param [in] ptr DMA base address
+ * @param [in] instance DMA instance index
+ */
+void dma_mgr_isr_handler(DMA_Type *ptr, uint32_t instance);
+
 /**
  * @brief Request DMA resource from DMA Manager
  *
@@ -158,6 +244,17 @@ void dma_mgr_init(void);
  */
 hpm_stat_t dma_mgr_request_resource(dma_resource_t *resource);
 
+/**
+ * @brief Request DMA resource from DMA Manager with allocation hint
+ *
+ * @param [out] resource DMA resource
+ * @param [in] hint Allocation hint, NULL behaves like dma_mgr_request_resource
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if the parameter is invalid
+ * @retval status_dma_mgr_no_resource if all DMA channels allowed by the hint are occupied;
+ */
+hpm_stat_t dma_mgr_request_resource_with_hint(dma_resource_t *resource, const dma_mgr_resource_hint_t *hint);
+
 /**
  * @brief Release DMA resource
  *
@@ -268,6 +365,135 @@ hpm_stat_t dma_mgr_setup_channel(const dma_resource_t *resource, dma_mgr_chn_con
  */
 hpm_stat_t dma_mgr_config_linked_descriptor(const dma_resource_t *resource, dma_mgr_chn_conf_t *config, dma_mgr_linked_descriptor_t *descriptor);
 
+/**
+ * @brief Allocate contiguous linked descriptors from the DMA Manager descriptor pool
+ *        NOTE: The pool is placed in noncacheable memory and 8-byte aligned, descriptors need no cache maintenance
+ *
+ * @param [in] count Number of descriptors
+ *
+ * @return The first descriptor, NULL if the pool has no free run of count descriptors
+ */
+dma_mgr_linked_descriptor_t *dma_mgr_alloc_linked_descriptors(uint32_t count);
+
+/**
+ * @brief Return linked descriptors to the DMA Manager descriptor pool
+ *
+ * @param [in] descriptor The first descriptor returned by dma_mgr_alloc_linked_descriptors
+ * @param [in] count Number of descriptors, as passed to dma_mgr_alloc_linked_descriptors
+ *
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if any parameters are invalid
+ */
+hpm_stat_t dma_mgr_free_linked_descriptors(dma_mgr_linked_descriptor_t *descriptor, uint32_t count);
+
+/**
+ * @brief Setup a scatter-gather linked list
+ *        Entry 0 is written into config, which is then ready for dma_mgr_setup_channel, entry i (i > 0) is written
+ *        into descriptor[i]. descriptor[0] describes entry 0 and is only fetched when the list is circular
+ *
+ * @param [in] resource DMA resource
+ * @param [in/out] config DMA channel template, address, size, linked_ptr and interrupt_mask fields are overwritten
+ * @param [in] list Scatter-gather entries
+ * @param [in] count Number of entries
+ * @param [out] descriptor count linked descriptors, 8-byte aligned
+ * @param [in] circular true to link the last entry back to the first one and keep TC enabled on every entry,
+ *             false to end the list after the last entry and only keep TC enabled on it
+ *
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if any parameters are invalid
+ */
+hpm_stat_t dma_mgr_config_linked_list(const dma_resource_t *resource, dma_mgr_chn_conf_t *config,
+                                      const dma_mgr_sg_entry_t *list, uint32_t count,
+                                      dma_mgr_linked_descriptor_t *descriptor, bool circular);
+
+/**
+ * @brief Initialize a DMA ring
+ *        The ring takes chunk_count descriptors from the descriptor pool, links them in a circle and installs its
+ *        own transfer complete callback on the resource. Once started the DMA runs until it is stopped, the CPU is
+ *        only interrupted once per chunk
+ *        NOTE: The chunk ready callback must keep up with the chunk rate, each chunk has to complete after the
+ *              interrupt of the previous one was serviced, otherwise completions are merged
+ *
+ * @param [out] ring DMA ring
+ * @param [in] resource DMA resource, requested by the caller
+ * @param [in] config Ring configuration
+ *
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if any parameters are invalid
+ * @retval status_dma_mgr_no_resource if the descriptor pool is exhausted
+ */
+hpm_stat_t dma_mgr_ring_init(dma_mgr_ring_t *ring, const dma_resource_t *resource, const dma_mgr_ring_config_t *config);
+
+/**
+ * @brief Stop a DMA ring and return its descriptors to the pool
+ *
+ * @param [in] ring DMA ring
+ *
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if any parameters are invalid
+ */
+hpm_stat_t dma_mgr_ring_deinit(dma_mgr_ring_t *ring);
+
+/**
+ * @brief Start a DMA ring from the first chunk, all chunks are owned by the DMA
+ *
+ * @param [in] ring DMA ring
+ *
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if any parameters are invalid
+ */
+hpm_stat_t dma_mgr_ring_start(dma_mgr_ring_t *ring);
+
+/**
+ * @brief Stop a DMA ring
+ *
+ * @param [in] ring DMA ring
+ *
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if any parameters are invalid
+ */
+hpm_stat_t dma_mgr_ring_stop(dma_mgr_ring_t *ring);
+
+/**
+ * @brief Get the number of chunks completed by the DMA and not yet released
+ *
+ * @param [in] ring DMA ring
+ *
+ * @return Number of ready chunks, chunk_count or more means the ring has overrun
+ */
+static inline uint32_t dma_mgr_ring_get_ready_count(const dma_mgr_ring_t *ring)
+{
+    return ring->produced - ring->consumed;
+}
+
+/**
+ * @brief Get the oldest chunk completed by the DMA
+ *        The chunk stays valid until dma_mgr_ring_release is called, as long as the DMA does not wrap onto it
+ *
+ * @param [in] ring DMA ring
+ * @param [out] chunk Oldest ready chunk
+ *
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if any parameters are invalid
+ * @retval status_dma_mgr_ring_empty if no chunk is ready
+ * @retval status_dma_mgr_ring_overrun if the DMA is writing the oldest chunk, the lost chunks are dropped and
+ *         the next call returns the oldest intact chunk
+ */
+hpm_stat_t dma_mgr_ring_acquire(dma_mgr_ring_t *ring, uint8_t **chunk);
+
+/**
+ * @brief Hand the chunk returned by dma_mgr_ring_acquire back to the DMA
+ *
+ * @param [in] ring DMA ring
+ *
+ * @retval status_success if no error occurred
+ * @retval status_invalid_argument if any parameters are invalid
+ * @retval status_dma_mgr_ring_empty if no chunk is acquired
+ * @retval status_dma_mgr_ring_overrun if the DMA wrapped onto the chunk while it was being processed, the chunk
+ *         content is not reliable and the lost chunks are dropped
+ */
+hpm_stat_t dma_mgr_ring_release(dma_mgr_ring_t *ring);
+
 /**
  * @brief Enable DMA channel, start transfer
  *
@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2023 HPMicro
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include <string.h>
+#include "hpm_dma_mgr_memcpy.h"
+#include "hpm_soc.h"
+#include "hpm_csr_drv.h"
+
+/*****************************************************************************************************************
+ *
+ *  Definitions
+ *
+ *****************************************************************************************************************/
+
+#ifdef HPMSOC_HAS_HPMSDK_DMAV2
+#define DMA_MGR_MEMCPY_TRANSIZE_MAX DMAV2_CHCTRL_TRANSIZE_TRANSIZE_MASK
+#else
+#define DMA_MGR_MEMCPY_TRANSIZE_MAX DMA_CHCTRL_TRANSIZE_TRANSIZE_MASK
+#endif
+
+/* The memset pattern is a word, wider transfers would need a wider pattern */
+#define DMA_MGR_MEMSET_WIDTH_MAX DMA_MGR_TRANSFER_WIDTH_WORD
+
+/**
+ * @brief DMA memcpy channel, a reserved DMA channel and the request it is running
+ */
+typedef struct _dma_mgr_memcpy_chn {
+    dma_resource_t resource;
+    dma_mgr_memcpy_future_t *active;
+} dma_mgr_memcpy_chn_t;
+
+/**
+ * @brief DMA memcpy service context
+ */
+typedef struct _dma_mgr_memcpy_context {
+    dma_mgr_memcpy_chn_t channels[DMA_MGR_MEMCPY_CHANNEL_NUM];
+    dma_mgr_memcpy_future_t *head;                     /**< Requests waiting for a channel */
+    dma_mgr_memcpy_future_t *tail;
+    dma_mgr_memcpy_cache_ops_t cache_ops;
+    uint32_t threshold;
+    bool initialized;
+} dma_mgr_memcpy_context_t;
+
+/*****************************************************************************************************************
+ *
+ *  Variables
+ *
+ *****************************************************************************************************************/
+static dma_mgr_memcpy_context_t s_dma_mgr_memcpy_ctx;
+#define HPM_DMA_MGR_MEMCPY (&s_dma_mgr_memcpy_ctx)
+
+/*****************************************************************************************************************
+ *
+ *  Codes
+ *
+ *****************************************************************************************************************/
+static uint32_t dma_mgr_memcpy_enter_critical(void)
+{
+    return disable_global_irq(CSR_MSTATUS_MIE_MASK);
+}
+
+static void dma_mgr_memcpy_exit_critical(uint32_t level)
+{
+    restore_global_irq(level);
+}
+
+static void dma_mgr_memcpy_complete(dma_mgr_memcpy_future_t *future, hpm_stat_t status, bool by_dma)
+{
+    if (by_dma && (HPM_DMA_MGR_MEMCPY->cache_ops.invalidate != NULL)) {
+        HPM_DMA_MGR_MEMCPY->cache_ops.invalidate(future->dst, future->size);
+    }
+    future->status = status;
+    if (future->callback != NULL) {
+        future->callback(future, future->user_data);
+    }
+}
+
+/* Widest transfer width that addr and size are both aligned to */
+static uint8_t dma_mgr_memcpy_get_width(uint32_t addr, uint32_t size, uint8_t width_max)
+{
+    uint8_t width = width_max;
+
+    while ((width > DMA_MGR_TRANSFER_WIDTH_BYTE) && (((addr | size) & ((1UL << width) - 1U)) != 0U)) {
+        width--;
+    }
+    return width;
+}
+
+static hpm_stat_t dma_mgr_memcpy_start(dma_mgr_memcpy_chn_t *chn, dma_mgr_memcpy_future_t *future)
+{
+    dma_mgr_chn_conf_t config;
+    uint32_t dst = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)future->dst);
+    uint32_t src;
+    uint8_t width;
+    uint8_t burst;
+
+    dma_mgr_get_default_chn_config(&config);
+    if (future->src != NULL) {
+        src = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)future->src);
+        width = dma_mgr_memcpy_get_width(dst | src, future->size, DMA_SOC_TRANSFER_WIDTH_MAX(chn->resource.base));
+        /* A burst must not start from a source address that is not aligned to its length */
+        burst = DMA_MGR_MEMCPY_BURST_SIZE;
+        while ((burst > DMA_MGR_NUM_TRANSFER_PER_BURST_1T) && ((src & (((1UL << width) << burst) - 1U)) != 0U)) {
+            burst--;
+        }
+    } else {
+        src = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)&future->pattern);
+        width = dma_mgr_memcpy_get_width(dst, future->size, DMA_MGR_MEMSET_WIDTH_MAX);
+        burst = DMA_MGR_NUM_TRANSFER_PER_BURST_1T;
+        config.src_addr_ctrl = DMA_MGR_ADDRESS_CONTROL_FIXED;
+    }
+    if ((future->size >> width) > DMA_MGR_MEMCPY_TRANSIZE_MAX) {
+        return status_invalid_argument;
+    }
+
+    config.src_width = width;
+    config.dst_width = width;
+    config.src_burst_size = burst;
+    config.src_addr = src;
+    config.dst_addr = dst;
+    config.size_in_byte = future->size;
+    config.interrupt_mask = DMA_MGR_INTERRUPT_MASK_HALF_TC;
+    chn->active = future;
+    hpm_stat_t status = dma_mgr_setup_channel(&chn->resource, &config);
+    if (status == status_success) {
+        status = dma_mgr_enable_channel(&chn->resource);
+    }
+    return status;
+}
+
+/* Start queued requests on chn until one of them is running or the queue is empty */
+static void dma_mgr_memcpy_kick(dma_mgr_memcpy_chn_t *chn)
+{
+    dma_mgr_memcpy_future_t *future;
+    hpm_stat_t status;
+    uint32_t level;
+
+    do {
+        level = dma_mgr_memcpy_enter_critical();
+        future = HPM_DMA_MGR_MEMCPY->head;
+        if (future != NULL) {
+            HPM_DMA_MGR_MEMCPY->head = future->next;
+            if (HPM_DMA_MGR_MEMCPY->head == NULL) {
+                HPM_DMA_MGR_MEMCPY->tail = NULL;
+            }
+            chn->active = future;
+        } else {
+            chn->active = NULL;
+        }
+        dma_mgr_memcpy_exit_critical(level);
+        if (future == NULL) {
+            break;
+        }
+        status = dma_mgr_memcpy_start(chn, future);
+        if (status == status_success) {
+            break;
+        }
+        chn->active = NULL;
+        dma_mgr_memcpy_complete(future, status, true);
+    } while (true);
+}
+
+static void dma_mgr_memcpy_chn_done(dma_mgr_memcpy_chn_t *chn, hpm_stat_t status)
+{
+    dma_mgr_memcpy_future_t *future = chn->active;
+
+    if (future == NULL) {
+        return;
+    }
+    /* Give the channel to the next request first, the callback may submit again */
+    dma_mgr_memcpy_kick(chn);
+    dma_mgr_memcpy_complete(future, status, true);
+}
+
+static void dma_mgr_memcpy_tc_callback(DMA_Type *base, uint32_t channel, void *cb_data_ptr)
+{
+    (void) base;
+    (void) channel;
+    dma_mgr_memcpy_chn_done((dma_mgr_memcpy_chn_t *)cb_data_ptr, status_success);
+}
+
+static void dma_mgr_memcpy_error_callback(DMA_Type *base, uint32_t channel, void *cb_data_ptr)
+{
+    (void) base;
+    (void) channel;
+    dma_mgr_memcpy_chn_done((dma_mgr_memcpy_chn_t *)cb_data_ptr, status_fail);
+}
+
+hpm_stat_t dma_mgr_memcpy_init(const dma_mgr_memcpy_cache_ops_t *cache_ops)
+{
+    dma_mgr_memcpy_chn_t *chn;
+    dma_mgr_resource_hint_t hint = {
+        .instance = DMA_MGR_INSTANCE_ANY,
+        .instance_only = false,
+        .high_priority = false,
+    };
+
+    if (HPM_DMA_MGR_MEMCPY->initialized) {
+        return status_success;
+    }
+    (void) memset(HPM_DMA_MGR_MEMCPY, 0, sizeof(*HPM_DMA_MGR_MEMCPY));
+    if (cache_ops != NULL) {
+        HPM_DMA_MGR_MEMCPY->cache_ops = *cache_ops;
+    }
+    HPM_DMA_MGR_MEMCPY->threshold = DMA_MGR_MEMCPY_THRESHOLD_DEFAULT;
+
+    for (uint32_t i = 0; i < DMA_MGR_MEMCPY_CHANNEL_NUM; i++) {
+        chn = &HPM_DMA_MGR_MEMCPY->channels[i];
+        if (dma_mgr_request_resource_with_hint(&chn->resource, &hint) != status_success) {
+            while (i > 0U) {
+                i--;
+                (void) dma_mgr_release_resource(&HPM_DMA_MGR_MEMCPY->channels[i].resource);
+            }
+            return status_dma_mgr_no_resource;
+        }
+        (void) dma_mgr_install_chn_tc_callback(&chn->resource, dma_mgr_memcpy_tc_callback, chn);
+        (void) dma_mgr_install_chn_error_callback(&chn->resource, dma_mgr_memcpy_error_callback, chn);
+        (void) dma_mgr_install_chn_abort_callback(&chn->resource, dma_mgr_memcpy_error_callback, chn);
+    }
+    HPM_DMA_MGR_MEMCPY->initialized = true;
+    return status_success;
+}
+
+void dma_mgr_memcpy_set_threshold(uint32_t threshold)
+{
+    HPM_DMA_MGR_MEMCPY->threshold = threshold;
+}
+
+uint32_t dma_mgr_memcpy_get_threshold(void)
+{
+    return HPM_DMA_MGR_MEMCPY->threshold;
+}
+
+static hpm_stat_t dma_mgr_memcpy_submit(dma_mgr_memcpy_future_t *future)
+{
+    dma_mgr_memcpy_chn_t *chn = NULL;
+    hpm_stat_t status;
+    uint32_t level;
+
+    if (HPM_DMA_MGR_MEMCPY->cache_ops.writeback != NULL) {
+        if (future->src != NULL) {
+            HPM_DMA_MGR_MEMCPY->cache_ops.writeback(future->src, future->size);
+        } else {
+            HPM_DMA_MGR_MEMCPY->cache_ops.writeback(&future->pattern, sizeof(future->pattern));
+        }
+        /* Dirty lines of dst must not be evicted over the DMA result */
+        HPM_DMA_MGR_MEMCPY->cache_ops.writeback(future->dst, future->size);
+    }
+
+    future->next = NULL;
+    future->status = status_dma_mgr_memcpy_pending;
+    level = dma_mgr_memcpy_enter_critical();
+    for (uint32_t i = 0; i < DMA_MGR_MEMCPY_CHANNEL_NUM; i++) {
+        if (HPM_DMA_MGR_MEMCPY->channels[i].active == NULL) {
+            chn = &HPM_DMA_MGR_MEMCPY->channels[i];
+            chn->active = future;
+            break;
+        }
+    }
+    if (chn == NULL) {
+        if (HPM_DMA_MGR_MEMCPY->tail != NULL) {
+            HPM_DMA_MGR_MEMCPY->tail->next = future;
+        } else {
+            HPM_DMA_MGR_MEMCPY->head = future;
+        }
+        HPM_DMA_MGR_MEMCPY->tail = future;
+    }
+    dma_mgr_memcpy_exit_critical(level);
+
+    if (chn != NULL) {
+        status = dma_mgr_memcpy_start(chn, future);
+        if (status != status_success) {
+            dma_mgr_memcpy_kick(chn);
+            dma_mgr_memcpy_complete(future, status, true);
+        }
+    }
+    return status_success;
+}
+
+hpm_stat_t dma_mgr_memcpy_async(dma_mgr_memcpy_future_t *future, void *dst, const void *src, uint32_t size,
+                                dma_mgr_memcpy_cb_t callback, void *user_data)
+{
+    if ((future == NULL) || (dst == NULL) || (src == NULL)) {
+        return status_invalid_argument;
+    }
+
+    future->dst = (uint8_t *)dst;
+    future->src = (const uint8_t *)src;
+    future->size = size;
+    future->callback = callback;
+    future->user_data = user_data;
+    if ((size < HPM_DMA_MGR_MEMCPY->threshold) || !HPM_DMA_MGR_MEMCPY->initialized) {
+        (void) memcpy(dst, src, size);
+        dma_mgr_memcpy_complete(future, status_success, false);
+        return status_success;
+    }
+    return dma_mgr_memcpy_submit(future);
+}
+
+hpm_stat_t dma_mgr_memset_async(dma_mgr_memcpy_future_t *future, void *dst, uint8_t value, uint32_t size,
+                                dma_mgr_memcpy_cb_t callback, void *user_data)
+{
+    if ((future == NULL) || (dst == NULL)) {
+        return status_invalid_argument;
+    }
+
+    future->dst = (uint8_t *)dst;
+    future->src = NULL;
+    future->size = size;
+    future->pattern = value * 0x01010101UL;
+    future->callback = callback;
+    future->user_data = user_data;
+    if ((size < HPM_DMA_MGR_MEMCPY->threshold) || !HPM_DMA_MGR_MEMCPY->initialized) {
+        (void) memset(dst, value, size);
+        dma_mgr_memcpy_complete(future, status_success, false);
+        return status_success;
+    }
+    return dma_mgr_memcpy_submit(future);
+}
+
+hpm_stat_t dma_mgr_memcpy_wait(const dma_mgr_memcpy_future_t *future)
+{
+    while (!dma_mgr_memcpy_is_done(future)) {
+        DMA_MGR_MEMCPY_WAIT_HOOK();
+    }
+    return future->status;
+}
+
+uint32_t dma_mgr_memcpy_calibrate(void *dst, const void *src, uint32_t buf_size,
+                                  dma_mgr_memcpy_bench_t *bench, uint32_t bench_count)
+{
+    dma_mgr_memcpy_future_t future;
+    uint32_t threshold = HPM_DMA_MGR_MEMCPY->threshold;
+    uint32_t crossover = 0;
+    uint32_t index = 0;
+    uint64_t start;
+    uint32_t cpu_cycles;
+    uint32_t dma_cycles;
+
+    if ((dst == NULL) || (src == NULL) || !HPM_DMA_MGR_MEMCPY->initialized) {
+        return threshold;
+    }
+
+    HPM_DMA_MGR_MEMCPY->threshold = 0;
+    for (uint32_t size = 64U; (size <= buf_size) && (size != 0U); size <<= 1U) {
+        start = hpm_csr_get_core_cycle();
+        (void) memcpy(dst, src, size);
+        cpu_cycles = (uint32_t)(hpm_csr_get_core_cycle() - start);
+
+        start = hpm_csr_get_core_cycle();
+        (void) dma_mgr_memcpy_async(&future, dst, src, size, NULL, NULL);
+        (void) dma_mgr_memcpy_wait(&future);
+        dma_cycles = (uint32_t)(hpm_csr_get_core_cycle() - start);
+
+        if ((bench != NULL) && (index < bench_count)) {
+            bench[index].size = size;
+            bench[index].cpu_cycles = cpu_cycles;
+            bench[index].dma_cycles = dma_cycles;
+        }
+        index++;
+        if ((crossover == 0U) && (dma_cycles <= cpu_cycles)) {
+            crossover = size;
+        }
+    }
+
+    HPM_DMA_MGR_MEMCPY->threshold = (crossover != 0U) ? crossover : threshold;
+    return HPM_DMA_MGR_MEMCPY->threshold;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2023 HPMicro
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef HPM_DMA_MGR_MEMCPY_H
+#define HPM_DMA_MGR_MEMCPY_H
+
+#include "hpm_dma_mgr.h"
+
+/**
+ * @brief Number of DMA channels reserved for the memcpy service
+ */
+#ifndef DMA_MGR_MEMCPY_CHANNEL_NUM
+#define DMA_MGR_MEMCPY_CHANNEL_NUM        (2U)
+#endif
+
+/**
+ * @brief Copies shorter than this are done by the CPU, see dma_mgr_memcpy_set_threshold
+ */
+#ifndef DMA_MGR_MEMCPY_THRESHOLD_DEFAULT
+#define DMA_MGR_MEMCPY_THRESHOLD_DEFAULT  (1024U)
+#endif
+
+/**
+ * @brief Source burst size used for memory to memory transfers, lowered when the source is not aligned to it
+ */
+#ifndef DMA_MGR_MEMCPY_BURST_SIZE
+#define DMA_MGR_MEMCPY_BURST_SIZE         DMA_MGR_NUM_TRANSFER_PER_BURST_16T
+#endif
+
+/**
+ * @brief Run by dma_mgr_memcpy_wait between two polls, e.g. WFI() to sleep until the DMA interrupt
+ */
+#ifndef DMA_MGR_MEMCPY_WAIT_HOOK
+#define DMA_MGR_MEMCPY_WAIT_HOOK()
+#endif
+
+typedef struct _dma_mgr_memcpy_future dma_mgr_memcpy_future_t;
+
+/**
+ * @brief DMA memcpy completion callback, called from the DMA interrupt or from the submitting call
+ *        when the request was done by the CPU
+ *
+ * @param [in] future Completed request, it can be resubmitted from the callback
+ * @param [in/out] user_data User data pointer
+ */
+typedef void (*dma_mgr_memcpy_cb_t)(dma_mgr_memcpy_future_t *future, void *user_data);
+
+/**
+ * @brief Cache maintenance hooks, NULL hooks are skipped (noncacheable buffers or cache disabled)
+ *        NOTE: The range is passed as requested, the hooks align it to cache lines
+ */
+typedef struct _dma_mgr_memcpy_cache_ops {
+    void (*writeback)(const void *addr, uint32_t size);  /**< Write dirty lines back to memory */
+    void (*invalidate)(const void *addr, uint32_t size); /**< Drop lines so that the DMA result is read */
+} dma_mgr_memcpy_cache_ops_t;
+
+/**
+ * @brief DMA memcpy request, the storage is provided by the caller and must stay valid until completion
+ */
+struct _dma_mgr_memcpy_future {
+    dma_mgr_memcpy_future_t *next;    /**< Pending list link, owned by the service */
+    uint8_t *dst;                     /**< Destination */
+    const uint8_t *src;               /**< Source, NULL for memset */
+    uint32_t size;                    /**< Size in byte */
+    uint32_t pattern;                 /**< memset pattern, read by the DMA */
+    volatile hpm_stat_t status;       /**< status_dma_mgr_memcpy_pending until completion */
+    dma_mgr_memcpy_cb_t callback;     /**< Completion callback, can be NULL */
+    void *user_data;                  /**< User data used in the callback */
+};
+
+/**
+ * @brief Benchmark sample of dma_mgr_memcpy_calibrate
+ */
+typedef struct _dma_mgr_memcpy_bench {
+    uint32_t size;                    /**< Copy size in byte */
+    uint32_t cpu_cycles;              /**< Core cycles taken by memcpy */
+    uint32_t dma_cycles;              /**< Core cycles taken by dma_mgr_memcpy_async until completion */
+} dma_mgr_memcpy_bench_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the DMA memcpy service
+ *        Reserves DMA_MGR_MEMCPY_CHANNEL_NUM channels from the DMA Manager
+ *        NOTE: dma_mgr_init must have been called and the DMA interrupt must be enabled, either with
+ *              dma_mgr_enable_dma_irq_with_priority or by the port that dispatches the DMA interrupt
+ *
+ * @param [in] cache_ops Cache maintenance hooks, NULL if all buffers are noncacheable
+ *
+ * @retval status_success if no error occurred
+ * @retval status_dma_mgr_no_resource if the channels cannot be reserved
+ */
+hpm_stat_t dma_mgr_memcpy_init(const dma_mgr_memcpy_cache_ops_t *cache_ops);
+
+/**
+ * @brief Set the size from which requests are handed to the DMA
+ *
+ * @param [in] threshold Size in byte, 0 sends every request to the DMA
+ */
+void dma_mgr_memcpy_set_threshold(uint32_t threshold);
+
+/**
+ * @brief Get the size from which requests are handed to the DMA
+ *
+ * @return Size in byte
+ */
+uint32_t dma_mgr_memcpy_get_threshold(void);
+
+/**
+ * @brief Copy memory, by the CPU below the threshold or by a reserved DMA channel otherwise
+ *        Requests are queued when all reserved channels are busy. The buffers must not overlap and must not be
+ *        accessed until completion. The cache lines covering dst are written back before the transfer and
+ *        invalidated after it, unrelated data sharing these lines must not be written in the meantime
+ *
+ * @param [out] future Request storage
+ * @param [out] dst Destination
+ * @param [in] src Source
+ * @param [in] size Size in byte
+ * @param [in] callback Completion callback, can be NULL
+ * @param [in] user_data User data used in the callback
+ *
+ * @retval status_success if the request is completed or queued, future->status holds its result
+ * @retval status_invalid_argument if any parameters are invalid
+ */
+hpm_stat_t dma_mgr_memcpy_async(dma_mgr_memcpy_future_t *future, void *dst, const void *src, uint32_t size,
+                                dma_mgr_memcpy_cb_t callback, void *user_data);
+
+/**
+ * @brief Fill memory, by the CPU below the threshold or by a reserved DMA channel otherwise
+ *        Same rules as dma_mgr_memcpy_async
+ *
+ * @param [out] future Request storage
+ * @param [out] dst Destination
+ * @param [in] value Fill value
+ * @param [in] size Size in byte
+ * @param [in] callback Completion callback, can be NULL
+ * @param [in] user_data User data used in the callback
+ *
+ * @retval status_success if the request is completed or queued, future->status holds its result
+ * @retval status_invalid_argument if any parameters are invalid
+ */
+hpm_stat_t dma_mgr_memset_async(dma_mgr_memcpy_future_t *future, void *dst, uint8_t value, uint32_t size,
+                                dma_mgr_memcpy_cb_t callback, void *user_data);
+
+/**
+ * @brief Check whether a request is completed
+ *
+ * @param [in] future Request
+ *
+ * @return true if the request is completed
+ */
+static inline bool dma_mgr_memcpy_is_done(const dma_mgr_memcpy_future_t *future)
+{
+    return future->status != status_dma_mgr_memcpy_pending;
+}
+
+/**
+ * @brief Wait for a request to complete
+ *
+ * @param [in] future Request
+ *
+ * @return Result of the request
+ */
+hpm_stat_t dma_mgr_memcpy_wait(const dma_mgr_memcpy_future_t *future);
+
+/**
+ * @brief Measure CPU and DMA copy time from 64 bytes up to buf_size and set the threshold to the
+ *        first size where the DMA is not slower
+ *        NOTE: Run it while the system is idle, the buffers are overwritten
+ *
+ * @param [out] dst Scratch destination, buf_size bytes
+ * @param [in] src Scratch source, buf_size bytes
+ * @param [in] buf_size Size of both buffers in byte
+ * @param [out] bench Samples, one per power of two size, can be NULL
+ * @param [in] bench_count Number of entries in bench
+ *
+ * @return The new threshold, unchanged if the DMA never caught up
+ */
+uint32_t dma_mgr_memcpy_calibrate(void *dst, const void *src, uint32_t buf_size,
+                                  dma_mgr_memcpy_bench_t *bench, uint32_t bench_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HPM_DMA_MGR_MEMCPY_H */
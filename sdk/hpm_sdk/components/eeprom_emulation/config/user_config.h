@@ -17,6 +17,9 @@ extern "C" {
 #define E2P_CRITICAL_EXIT()    do { enable_global_irq(CSR_MSTATUS_MIE_MASK); } while(0)
 
 #define EEPROM_MAX_VAR_CNT     (100)
+#define EEPROM_GC_FREE_SECTORS (3)
+#define EEPROM_BATCH_MAX       (8)
+#define EEPROM_CACHE_CNT       (4)
 
 #ifdef __cplusplus
 }
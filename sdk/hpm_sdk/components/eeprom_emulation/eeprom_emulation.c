@@ -6,81 +6,307 @@
  */
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "eeprom_emulation.h"
 #include "hpm_crc32.h"
 
-#define E2P_OFFSET(TYPE, MEMBER) ((uint32_t)(&(((TYPE *)0)->MEMBER)))
-#define E2P_SWAP(a, b)\
-do {\
-    uint32_t tmp = (a);\
-    (a) = (b);\
-    (b) = tmp;\
-} while (0)
+#define E2P_OFFSET(TYPE, MEMBER) ((uint32_t)(uintptr_t)(&(((TYPE *)0)->MEMBER)))
 
-static e2p_block e2p_info_table[E2P_MAX_VAR_CNT];
+/*
+ * erased sectors e2p_write leaves behind when it rolls over: one for the
+ * records a compaction step moves and one so a step cut by power loss can
+ * be run again after reboot
+ */
+#define E2P_GC_RESERVE      (2)
+
+#if E2P_GC_FREE_SECTORS <= E2P_GC_RESERVE
+#error "E2P_GC_FREE_SECTORS must be above E2P_GC_RESERVE"
+#endif
+#define E2P_COPY_CHUNK      (64)
+#define E2P_BURST_SIZE      (256)
+
+/* free gap of one sector, records are read downwards from p_info */
+typedef struct {
+    uint32_t p_data;
+    uint32_t p_info;
+    uint32_t remain_size;
+} e2p_cursor_t;
+
+/* used by the instance which does not provide its own index storage */
+static uint32_t e2p_default_table[(E2P_TABLE_SIZE(E2P_MAX_VAR_CNT) + 3) / 4];
+static e2p_t *e2p_default_owner;
+
+static uint32_t e2p_sector_addr(e2p_t *e2p, uint32_t sector)
+{
+    return e2p->config.start_addr + sector * e2p->config.erase_size;
+}
 
-static void e2p_print_info(e2p_t *e2p)
+static uint32_t e2p_free_cnt(e2p_t *e2p)
 {
-    uint32_t info_count;
-    uint32_t valid_count = E2P_MAX_VAR_CNT;
+    return e2p->config.sector_cnt - e2p->used_cnt;
+}
 
-    info_count = (e2p->config.start_addr + e2p->config.sector_cnt * e2p->config.erase_size - e2p->p_info) / sizeof(e2p_block) - 2;
-    for (int i = 0; i < E2P_MAX_VAR_CNT; i++) {
-        if (e2p_info_table[i].block_id == E2P_EARSED_ID) {
-            valid_count = i;
-            break;
+static void e2p_read_hdr(e2p_t *e2p, uint32_t sector, e2p_sector_hdr *hdr)
+{
+    e2p->config.flash_read((uint8_t *)hdr, e2p_sector_addr(e2p, sector), sizeof(e2p_sector_hdr));
+}
+
+/* magic is programmed last, a header cut before it has no magic or blank fields */
+static bool e2p_hdr_is_complete(e2p_sector_hdr *hdr)
+{
+    return hdr->magic == E2P_MAGIC_ID && hdr->version != E2P_EARSED_ID && hdr->erase_cnt != E2P_EARSED_ID;
+}
+
+static bool e2p_hdr_is_ours(e2p_t *e2p, e2p_sector_hdr *hdr)
+{
+    return e2p_hdr_is_complete(hdr) && hdr->version == e2p->config.version;
+}
+
+/* a torn seq program fails the check, such a sector never took records */
+static bool e2p_hdr_is_used(e2p_t *e2p, e2p_sector_hdr *hdr)
+{
+    return e2p_hdr_is_ours(e2p, hdr) && hdr->seq != E2P_EARSED_ID && hdr->seq == ~hdr->seq_check;
+}
+
+static bool e2p_hdr_is_free(e2p_t *e2p, e2p_sector_hdr *hdr)
+{
+    return e2p_hdr_is_ours(e2p, hdr) && hdr->seq == E2P_EARSED_ID && hdr->seq_check == E2P_EARSED_ID;
+}
+
+/* seq wraps, 0 and E2P_EARSED_ID are never handed out */
+static uint32_t e2p_seq_next(uint32_t seq)
+{
+    do {
+        seq++;
+    } while (seq == 0 || seq == E2P_EARSED_ID);
+    return seq;
+}
+
+/* true when seq a was handed out before b, the ring spans far less than 2^31 seqs */
+static bool e2p_seq_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/* erase one sector and leave a free header carrying the new erase count */
+static void e2p_sector_recycle(e2p_t *e2p, uint32_t sector)
+{
+    e2p_sector_hdr hdr;
+    e2p_config_t *cfg = &e2p->config;
+    uint32_t addr = e2p_sector_addr(e2p, sector);
+
+    /* version and erase_cnt go before magic, a header cut there still has the count */
+    e2p_read_hdr(e2p, sector, &hdr);
+    if ((hdr.magic == E2P_MAGIC_ID || hdr.version == cfg->version) && hdr.erase_cnt != E2P_EARSED_ID)
+        hdr.erase_cnt++;
+    else
+        hdr.erase_cnt = 1;
+    hdr.magic = E2P_MAGIC_ID;
+    hdr.version = cfg->version;
+
+    cfg->flash_erase(addr, cfg->erase_size);
+    cfg->flash_write((uint8_t *)&hdr.version, addr + E2P_OFFSET(e2p_sector_hdr, version),
+                     sizeof(hdr.version) + sizeof(hdr.erase_cnt));
+    cfg->flash_write((uint8_t *)&hdr.magic, addr, sizeof(hdr.magic));
+    e2p_trace("sector[%u] erased, erase count=%u\n", sector, hdr.erase_cnt);
+}
+
+static void e2p_cursor_begin(e2p_t *e2p, uint32_t sector, e2p_cursor_t *cur)
+{
+    uint32_t addr = e2p_sector_addr(e2p, sector);
+
+    cur->p_data = addr + sizeof(e2p_sector_hdr);
+    cur->p_info = addr + e2p->config.erase_size - sizeof(e2p_block);
+    cur->remain_size = e2p->config.erase_size - sizeof(e2p_sector_hdr);
+}
+
+/* next record of a sector, false at the first erased or torn one */
+static bool e2p_record_fetch(e2p_t *e2p, e2p_cursor_t *cur, e2p_block *block)
+{
+    if (cur->remain_size < sizeof(e2p_block))
+        return false;
+
+    e2p->config.flash_read((uint8_t *)block, cur->p_info, sizeof(e2p_block));
+    if (block->block_id == E2P_EARSED_ID || block->data_addr != cur->p_data ||
+        (block->valid_state != e2p_valid && block->valid_state != e2p_invalid && block->valid_state != e2p_pending) ||
+        block->length > cur->remain_size - sizeof(e2p_block))
+        return false;
+
+    cur->p_data += block->length;
+    cur->p_info -= sizeof(e2p_block);
+    cur->remain_size -= block->length + sizeof(e2p_block);
+    return true;
+}
+
+static bool e2p_area_is_blank(e2p_t *e2p, uint32_t addr, uint32_t size)
+{
+    uint32_t buf[E2P_COPY_CHUNK / 4];
+    uint8_t *p = (uint8_t *)buf;
+
+    while (size) {
+        uint32_t len = size < sizeof(buf) ? size : sizeof(buf);
+
+        e2p->config.flash_read(p, addr, len);
+        for (uint32_t i = 0; i < len; i++) {
+            if (p[i] != E2P_EARSED_VAR)
+                return false;
+        }
+        addr += len;
+        size -= len;
+    }
+    return true;
+}
+
+/* start taking records in an erased sector */
+static void e2p_sector_open(e2p_t *e2p, uint32_t sector)
+{
+    e2p_sector_hdr hdr;
+    e2p_cursor_t cur;
+    uint32_t seq = e2p_seq_next(e2p->seq);
+
+    e2p_read_hdr(e2p, sector, &hdr);
+    if (!e2p_hdr_is_free(e2p, &hdr))
+        e2p_sector_recycle(e2p, sector);
+
+    /* seq and its check in one program */
+    hdr.seq = seq;
+    hdr.seq_check = ~seq;
+    e2p->config.flash_write((uint8_t *)&hdr.seq, e2p_sector_addr(e2p, sector) + E2P_OFFSET(e2p_sector_hdr, seq),
+                            sizeof(hdr.seq) + sizeof(hdr.seq_check));
+    e2p->seq = seq;
+
+    e2p_cursor_begin(e2p, sector, &cur);
+    e2p->p_data = cur.p_data;
+    e2p->p_info = cur.p_info;
+    e2p->remain_size = cur.remain_size;
+    e2p->active = sector;
+    if (e2p->used_cnt++ == 0)
+        e2p->oldest = sector;
+    e2p_trace("sector[%u] opened, seq=%u\n", sector, seq);
+}
+
+/* begin the ring at the least worn sector, every sector must be free */
+static void e2p_start_fresh(e2p_t *e2p)
+{
+    e2p_sector_hdr hdr;
+    uint32_t start = 0;
+    uint32_t min_cnt = E2P_EARSED_ID;
+
+    for (uint32_t i = 0; i < e2p->config.sector_cnt; i++) {
+        e2p_read_hdr(e2p, i, &hdr);
+        if (hdr.erase_cnt < min_cnt) {
+            min_cnt = hdr.erase_cnt;
+            start = i;
         }
     }
 
+    e2p->used_cnt = 0;
+    e2p->seq = 0;
+    e2p_sector_open(e2p, start);
+}
+
+static void e2p_print_info(e2p_t *e2p)
+{
+    uint32_t cnt, min_cnt = E2P_EARSED_ID, max_cnt = 0;
+
+    for (uint32_t i = 0; i < e2p->config.sector_cnt; i++) {
+        cnt = e2p_get_erase_count(e2p, i);
+        min_cnt = cnt < min_cnt ? cnt : min_cnt;
+        max_cnt = cnt > max_cnt ? cnt : max_cnt;
+    }
+
     e2p_info("------------ flash->eeprom init ok -----------\n");
     e2p_info("start address: 0x%08x", e2p->config.start_addr);
     e2p_info("sector count: %u", e2p->config.sector_cnt);
     e2p_info("flash earse granularity: %u", e2p->config.erase_size);
     e2p_info("version: 0x%x", e2p->config.version);
     e2p_info("end address: 0x%08x", e2p->config.start_addr + e2p->config.sector_cnt * e2p->config.erase_size);
+    e2p_info("active sector = %u, oldest sector = %u, used sector = %u\n", e2p->active, e2p->oldest, e2p->used_cnt);
     e2p_info("data write addr = 0x%08x, info write addr = 0x%08x, remain flash size = 0x%x\n", \
             e2p->p_data, e2p->p_info, e2p->remain_size);
-    e2p_info("valid count percent info count( %u / %u )\n", valid_count, info_count);
+    e2p_info("valid count = %u, live size percent capacity( %u / %u )\n", e2p->var_cnt, e2p->live_size, e2p->live_max);
+    e2p_info("erase count min = %u, max = %u\n", min_cnt, max_cnt);
     e2p_info("----------------------------------------------\n");
 }
 
-static hpm_stat_t e2p_table_update(e2p_block *block)
+static uint32_t e2p_hash(uint32_t block_id)
 {
-    uint32_t i = 0;
+    uint32_t h = block_id * 0x9E3779B1u;
 
-    if (block->valid_state == e2p_invalid)
-        return E2P_STATUS_OK;
+    return h ^ (h >> 16);
+}
 
-    for ( ; i < E2P_MAX_VAR_CNT; i++) {
-        if (e2p_info_table[i].block_id == E2P_EARSED_ID)
-            break;
-        if (e2p_info_table[i].block_id == block->block_id) {
-            e2p_trace("block_id[0x%08x] multiple write, flush api solve repeat\n", block->block_id);
-            break;
+/* slot holding block_id, or the empty slot where it would be inserted */
+static uint32_t e2p_table_probe(e2p_t *e2p, uint32_t block_id)
+{
+    uint32_t pos = e2p_hash(block_id) & e2p->slot_mask;
+
+    while (e2p->slot[pos] != 0 && e2p->table[e2p->slot[pos] - 1].block_id != block_id)
+        pos = (pos + 1) & e2p->slot_mask;
+
+    return pos;
+}
+
+static hpm_stat_t e2p_table_init(e2p_t *e2p)
+{
+    e2p_config_t *cfg = &e2p->config;
+    uint32_t max = cfg->max_var_cnt ? cfg->max_var_cnt : E2P_MAX_VAR_CNT;
+    uint32_t slots = 1;
+    void *mem = cfg->table;
+
+    if (mem == NULL) {
+        if (max > E2P_MAX_VAR_CNT || (e2p_default_owner != NULL && e2p_default_owner != e2p)) {
+            e2p_info("internal table is limited to one instance of %u variables, provide config.table\n", E2P_MAX_VAR_CNT);
+            return E2P_ERROR_INIT_ERR;
         }
+        e2p_default_owner = e2p;
+        mem = e2p_default_table;
     }
 
-    if (i == E2P_MAX_VAR_CNT)
-        return E2P_ERROR_MUL_VAR;
+    if (max == 0 || max >= UINT16_MAX)
+        return E2P_ERROR_INIT_ERR;
 
-    memcpy(&e2p_info_table[i], block, sizeof(e2p_block));
+    /* keep the load factor at or below one half so probe chains stay short */
+    while (slots < 2 * max)
+        slots <<= 1;
+
+    e2p->table = (e2p_block *)mem;
+    e2p->slot = (uint16_t *)(e2p->table + max);
+    e2p->slot_mask = slots - 1;
+    e2p->var_cnt = 0;
+    e2p->var_max = max;
+    memset(e2p->slot, 0, slots * sizeof(uint16_t));
     return E2P_STATUS_OK;
 }
 
-static void e2p_config_info(e2p_t *e2p)
+static hpm_stat_t e2p_table_update(e2p_t *e2p, e2p_block *block)
 {
-    e2p_block block;
-    e2p_config_t *cfg = &e2p->config;
-    uint32_t end_addr = cfg->start_addr + cfg->sector_cnt * cfg->erase_size;
+    uint32_t pos;
+    e2p_block *entry;
 
-    memset(&block, E2P_EARSED_VAR, sizeof(e2p_block));
-    block.block_id = cfg->version;
-    block.data_addr = E2P_MAGIC_ID;
-    cfg->flash_write((uint8_t *)&block, end_addr - sizeof(e2p_block), sizeof(e2p_block));
-    e2p_trace("e2p info has been config\n");
+    if (block->valid_state == e2p_invalid)
+        return E2P_STATUS_OK;
+
+    pos = e2p_table_probe(e2p, block->block_id);
+    if (e2p->slot[pos] != 0) {
+        e2p_trace("block_id[0x%08x] multiple write, compaction solve repeat\n", block->block_id);
+        entry = &e2p->table[e2p->slot[pos] - 1];
+        e2p->live_size -= entry->length + sizeof(e2p_block);
+        e2p->live_size += block->length + sizeof(e2p_block);
+        memcpy(entry, block, sizeof(e2p_block));
+        return E2P_STATUS_OK;
+    }
+
+    if (e2p->var_cnt == e2p->var_max)
+        return E2P_ERROR_MUL_VAR;
+
+    memcpy(&e2p->table[e2p->var_cnt], block, sizeof(e2p_block));
+    e2p->slot[pos] = ++e2p->var_cnt;
+    e2p->live_size += block->length + sizeof(e2p_block);
+    return E2P_STATUS_OK;
 }
 
 static uint32_t e2p_data_crc_calc(uint16_t length, uint8_t *data)
@@ -88,126 +314,191 @@ static uint32_t e2p_data_crc_calc(uint16_t length, uint8_t *data)
     return crc32(data, (uint32_t)length);
 }
 
-static hpm_stat_t e2p_retrieve_info(uint32_t block_id, e2p_block *block)
+static void e2p_cache_reset(e2p_t *e2p)
 {
-    int i = 0;
+#if E2P_CACHE_CNT > 0
+    for (uint32_t i = 0; i < E2P_CACHE_CNT; i++)
+        e2p->cache[i].block_id = E2P_EARSED_ID;
+    e2p->cache_next = 0;
+#else
+    (void)e2p;
+#endif
+}
 
-    if (block_id == E2P_EARSED_ID)
-        return E2P_ERROR_BAD_ID;
+/* remember a value just written or verified, a value too long for the cache drops the old copy */
+static void e2p_cache_put(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *data)
+{
+#if E2P_CACHE_CNT > 0
+    e2p_cache_entry *entry = NULL;
 
-    for ( ; i < E2P_MAX_VAR_CNT; i++) {
-        if (e2p_info_table[i].block_id == block_id) {
-            e2p_trace("find read block, pos at table[%u]\n", i);
-            memcpy(block, &e2p_info_table[i], sizeof(e2p_block));
+    for (uint32_t i = 0; i < E2P_CACHE_CNT; i++) {
+        if (e2p->cache[i].block_id == block_id) {
+            entry = &e2p->cache[i];
             break;
         }
     }
 
-    return (i == E2P_MAX_VAR_CNT ? E2P_ERROR_BAD_ID : E2P_STATUS_OK);
+    if (length > E2P_CACHE_DATA_SIZE) {
+        if (entry != NULL)
+            entry->block_id = E2P_EARSED_ID;
+        return;
+    }
+
+    if (entry == NULL) {
+        entry = &e2p->cache[e2p->cache_next];
+        e2p->cache_next = (e2p->cache_next + 1) % E2P_CACHE_CNT;
+    }
+    entry->block_id = block_id;
+    entry->length = length;
+    memcpy(entry->data, data, length);
+#else
+    (void)e2p;
+    (void)block_id;
+    (void)length;
+    (void)data;
+#endif
 }
 
+static bool e2p_cache_get(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *data)
+{
+#if E2P_CACHE_CNT > 0
+    for (uint32_t i = 0; i < E2P_CACHE_CNT; i++) {
+        if (e2p->cache[i].block_id == block_id) {
+            memcpy(data, e2p->cache[i].data, length < e2p->cache[i].length ? length : e2p->cache[i].length);
+            return true;
+        }
+    }
+#else
+    (void)e2p;
+    (void)block_id;
+    (void)length;
+    (void)data;
+#endif
+    return false;
+}
 
-static hpm_stat_t e2p_write_private(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *data)
+static hpm_stat_t e2p_retrieve_info(e2p_t *e2p, uint32_t block_id, e2p_block *block)
 {
-    int ret = 0;
-    e2p_block block;
+    uint32_t pos;
+
+    if (block_id == E2P_EARSED_ID)
+        return E2P_ERROR_BAD_ID;
+
+    pos = e2p_table_probe(e2p, block_id);
+    if (e2p->slot[pos] == 0)
+        return E2P_ERROR_BAD_ID;
+
+    e2p_trace("find read block, pos at table[%u]\n", e2p->slot[pos] - 1);
+    memcpy(block, &e2p->table[e2p->slot[pos] - 1], sizeof(e2p_block));
+    return E2P_STATUS_OK;
+}
+
+static hpm_stat_t e2p_copy_data(e2p_t *e2p, uint32_t src, uint32_t dst, uint32_t size)
+{
+    uint32_t buf[E2P_COPY_CHUNK / 4];
     e2p_config_t *cfg = &e2p->config;
 
-    if (e2p->remain_size < length + sizeof(e2p_block)) {
-        e2p_trace("no enough flash\n");
-        return E2P_ERROR_NO_MEM;
+    while (size) {
+        uint32_t len = size < sizeof(buf) ? size : sizeof(buf);
+
+        cfg->flash_read((uint8_t *)buf, src, len);
+        if (E2P_STATUS_OK != cfg->flash_write((uint8_t *)buf, dst, len))
+            return E2P_ERROR;
+        src += len;
+        dst += len;
+        size -= len;
     }
+    return E2P_STATUS_OK;
+}
 
-    block.block_id = block_id;
-    block.data_addr = e2p->p_data;
-    block.length = length;
-    block.valid_state = e2p_valid;
-    block.crc = e2p_data_crc_calc(length, data);
+/*
+ * append one record to the active sector, rolling over to the next erased one
+ * when it is full. data == NULL moves the data found at block->data_addr.
+ */
+static hpm_stat_t e2p_append(e2p_t *e2p, e2p_block *block, uint8_t *data)
+{
+    hpm_stat_t ret;
+    e2p_config_t *cfg = &e2p->config;
 
-    if (E2P_STATUS_OK != cfg->flash_write(data, e2p->p_data, length)) {
+    if (e2p->remain_size < block->length + sizeof(e2p_block)) {
+        if (e2p_free_cnt(e2p) == 0) {
+            e2p_trace("no erased sector left\n");
+            return E2P_ERROR_NO_MEM;
+        }
+        e2p_sector_open(e2p, (e2p->active + 1) % cfg->sector_cnt);
+    }
+
+    if (data != NULL)
+        ret = cfg->flash_write(data, e2p->p_data, block->length);
+    else
+        ret = e2p_copy_data(e2p, block->data_addr, e2p->p_data, block->length);
+    if (E2P_STATUS_OK != ret) {
         e2p_trace("flash write data error\n");
         return E2P_ERROR;
     }
-    e2p->p_data += length;
-    e2p->remain_size -= length;
 
-    if (E2P_STATUS_OK != cfg->flash_write((uint8_t *)&block, e2p->p_info, sizeof(e2p_block))) {
+    block->data_addr = e2p->p_data;
+    block->valid_state = e2p_valid;
+    e2p->p_data += block->length;
+    e2p->remain_size -= block->length;
+
+    if (E2P_STATUS_OK != cfg->flash_write((uint8_t *)block, e2p->p_info, sizeof(e2p_block))) {
         e2p_trace("flash write info error\n");
         return E2P_ERROR;
     }
     e2p->p_info -= sizeof(e2p_block);
     e2p->remain_size -= sizeof(e2p_block);
 
-    ret = e2p_table_update(&block);
+    ret = e2p_table_update(e2p, block);
     if (E2P_STATUS_OK != ret)
         return ret;
 
-    e2p_info("block_id[0x%08x] success write, data addr=0x%08x, remain size=0x%08x crc=0x%08x\n", block.block_id, block.data_addr, e2p->remain_size, block.crc);
+    e2p_info("block_id[0x%08x] success write, data addr=0x%08x, remain size=0x%08x crc=0x%08x\n", block->block_id, block->data_addr, e2p->remain_size, block->crc);
     return E2P_STATUS_OK;
 }
 
-static int e2p_info_table_sort(void)
+/*
+ * compact the oldest sector: records still referenced by the index are moved
+ * to the active sector, then the sector is erased and joins the free ones.
+ * a power loss before the erase leaves both copies, replay keeps the newer.
+ */
+static hpm_stat_t e2p_gc_step(e2p_t *e2p)
 {
-    int count = 0;
+    hpm_stat_t ret;
+    e2p_sector_hdr hdr;
+    e2p_cursor_t cur;
     e2p_block block;
+    uint32_t pos;
+    uint32_t victim = e2p->oldest;
 
-    do {
-        if (e2p_info_table[count].block_id == E2P_EARSED_ID) {
-            break;
-        }
-        count++;
-    } while (count < E2P_MAX_VAR_CNT);
-
-    if (count == 0)
-        return count;
-
-    for (int i = 0; i < count; i++) {
-        memcpy(&block, &e2p_info_table[i], sizeof(e2p_block));
-        for (int j = i + 1; j < count; j++) {
-            if (e2p_info_table[j].data_addr < block.data_addr) {
-                E2P_SWAP(e2p_info_table[j].block_id, block.block_id);
-                E2P_SWAP(e2p_info_table[j].data_addr, block.data_addr);
-                E2P_SWAP(e2p_info_table[j].length, block.length);
-                E2P_SWAP(e2p_info_table[j].valid_state, block.valid_state);
-                E2P_SWAP(e2p_info_table[j].crc, block.crc);
-            }
+    if (e2p->used_cnt < 2)
+        return E2P_STATUS_OK;
+
+    e2p_read_hdr(e2p, victim, &hdr);
+    if (e2p_hdr_is_used(e2p, &hdr)) {
+        e2p_cursor_begin(e2p, victim, &cur);
+        while (e2p_record_fetch(e2p, &cur, &block)) {
+            pos = e2p_table_probe(e2p, block.block_id);
+            if (e2p->slot[pos] == 0 || e2p->table[e2p->slot[pos] - 1].data_addr != block.data_addr)
+                continue;
+
+            memcpy(&block, &e2p->table[e2p->slot[pos] - 1], sizeof(e2p_block));
+            ret = e2p_append(e2p, &block, NULL);
+            if (E2P_STATUS_OK != ret)
+                return ret;
         }
-        memcpy(&e2p_info_table[i], &block, sizeof(e2p_block));
     }
 
-    return count;
-}
-
-static void e2p_earse_info_sector(e2p_t *e2p)
-{
-    uint32_t data_sec_num, info_sec_num;
-    uint32_t addr, size;
-    e2p_config_t *cfg = &e2p->config;
-
-    data_sec_num = (e2p->p_data - cfg->start_addr) / cfg->erase_size;
-    info_sec_num = (e2p->p_info - cfg->start_addr) / cfg->erase_size;
-    addr = e2p->p_info - (e2p->p_info % cfg->erase_size);
-    size = (cfg->sector_cnt - info_sec_num) * cfg->erase_size;
-
-    e2p_trace("data_sector=%u, info_sector=%u, addr=0x%08x, size=0x%08x", data_sec_num, info_sec_num, addr, size);
-
-    if (data_sec_num < info_sec_num) {
-        cfg->flash_erase(addr, size);
-    } else {
-        uint8_t data_buf[cfg->erase_size];
-        uint32_t remain_size = e2p->p_info % cfg->erase_size;
-        memset(data_buf, E2P_EARSED_VAR, sizeof(data_buf));
-
-        e2p_trace("data tail[0x%08x] and info tail[0x%08x] in same sector\n", e2p->p_data, e2p->p_info);
-        cfg->flash_read(data_buf, addr, remain_size);
-        cfg->flash_erase(addr, size);
-        cfg->flash_write(data_buf, addr, sizeof(data_buf));
-    }
+    e2p_sector_recycle(e2p, victim);
+    e2p->oldest = (victim + 1) % e2p->config.sector_cnt;
+    e2p->used_cnt--;
+    return E2P_STATUS_OK;
 }
 
 hpm_stat_t e2p_config(e2p_t *e2p)
 {
-    if (e2p->config.erase_size == 0 || e2p->config.sector_cnt == 0) {
+    if (e2p->config.erase_size <= sizeof(e2p_sector_hdr) + sizeof(e2p_block) ||
+        e2p->config.sector_cnt < E2P_GC_FREE_SECTORS + 2) {
         e2p_info("config error erase_size = %u, sector_cnt = %u\n", e2p->config.erase_size, e2p->config.sector_cnt);
         return E2P_ERROR_INIT_ERR;
     }
@@ -218,146 +509,295 @@ hpm_stat_t e2p_config(e2p_t *e2p)
         return E2P_ERROR_INIT_ERR;
     }
 
-    e2p_block block;
+    e2p_sector_hdr hdr;
+    e2p_cursor_t cur;
+    e2p_block pend[E2P_BATCH_MAX];
+    uint32_t pend_cnt = 0;
     e2p_config_t *cfg = &e2p->config;
+    uint32_t seq_min = 0, seq_max = 0;
+    uint32_t sector;
+    bool used = false;
+    bool mismatch = false;
 
-    e2p->p_data = cfg->start_addr;
-    e2p->p_info = cfg->start_addr + cfg->sector_cnt * cfg->erase_size - 2 * sizeof(e2p_block);
-    e2p->remain_size = e2p->p_info - e2p->p_data;
-    memset(e2p_info_table, E2P_EARSED_VAR, sizeof(e2p_info_table));
+    int ret = e2p_table_init(e2p);
+    if (E2P_STATUS_OK != ret)
+        return ret;
 
-    cfg->flash_read((uint8_t *)&block, e2p->p_info + sizeof(e2p_block), sizeof(e2p_block));
-    e2p_trace("read data, block_id=%x, addr=%x, length=%x, valid_state=%x, crc=%x\n", \
-              block.block_id, block.data_addr, block.length, block.valid_state, block.crc);
+    e2p_cache_reset(e2p);
+    e2p->live_size = 0;
+    e2p->live_max = (cfg->sector_cnt - E2P_GC_FREE_SECTORS - 1) * (cfg->erase_size - sizeof(e2p_sector_hdr));
+    e2p->used_cnt = 0;
+    e2p->seq = 0;
+
+    for (uint32_t i = 0; i < cfg->sector_cnt; i++) {
+        e2p_read_hdr(e2p, i, &hdr);
+        /* only a fully written header of another version asks for a format, torn ones are recycled */
+        if (e2p_hdr_is_complete(&hdr) && hdr.version != cfg->version)
+            mismatch = true;
+        if (!e2p_hdr_is_used(e2p, &hdr))
+            continue;
+        if (!used || e2p_seq_before(hdr.seq, seq_min)) {
+            seq_min = hdr.seq;
+            e2p->oldest = i;
+        }
+        if (!used || e2p_seq_before(seq_max, hdr.seq)) {
+            seq_max = hdr.seq;
+            e2p->active = i;
+        }
+        used = true;
+    }
 
-    if (block.block_id != cfg->version || block.data_addr != E2P_MAGIC_ID) {
+    if (mismatch) {
         e2p_info("check version failed, begin earse all sector, it will take some time\n");
-        cfg->flash_erase(e2p->p_data, cfg->sector_cnt * cfg->erase_size);
-        e2p_config_info(e2p);
+        e2p_format(e2p);
         e2p_print_info(e2p);
         return E2P_STATUS_OK;
     }
 
-    while (1) {
-        block.data_addr = e2p->p_info;
-        block.length = sizeof(e2p_block);
+    if (!used) {
+        e2p_trace("no used sector, start a new ring\n");
+        for (uint32_t i = 0; i < cfg->sector_cnt; i++) {
+            e2p_read_hdr(e2p, i, &hdr);
+            if (!e2p_hdr_is_free(e2p, &hdr))
+                e2p_sector_recycle(e2p, i);
+        }
+        e2p_start_fresh(e2p);
+        e2p_print_info(e2p);
+        return E2P_STATUS_OK;
+    }
 
-        cfg->flash_read((uint8_t *)&block, block.data_addr, block.length);
-        if (block.block_id == E2P_EARSED_ID)
-            break;
+    e2p->seq = seq_max;
+    e2p->used_cnt = (e2p->active + cfg->sector_cnt - e2p->oldest) % cfg->sector_cnt + 1;
 
-        int ret = e2p_table_update(&block);
-        if (E2P_STATUS_OK != ret)
-            return ret;
+    /* sectors outside the ring must be erased, a power loss may have cut an erase */
+    for (uint32_t i = e2p->used_cnt; i < cfg->sector_cnt; i++) {
+        sector = (e2p->oldest + i) % cfg->sector_cnt;
+        e2p_read_hdr(e2p, sector, &hdr);
+        if (!e2p_hdr_is_free(e2p, &hdr))
+            e2p_sector_recycle(e2p, sector);
+    }
 
-        e2p->p_data += block.length;
-        e2p->p_info -= sizeof(e2p_block);
-        e2p->remain_size -= (block.length + sizeof(e2p_block));
+    e2p_cursor_begin(e2p, e2p->active, &cur);
+
+    /*
+     * replay oldest to newest so the latest record of each block_id wins,
+     * pending records only count once the e2p_valid record closing their
+     * batch is seen, a batch cut by power loss is dropped
+     */
+    for (uint32_t i = 0; i < e2p->used_cnt; i++) {
+        sector = (e2p->oldest + i) % cfg->sector_cnt;
+        e2p_read_hdr(e2p, sector, &hdr);
+        if (!e2p_hdr_is_used(e2p, &hdr))
+            continue;
+
+        pend_cnt = 0;
+        e2p_cursor_begin(e2p, sector, &cur);
+        while (e2p_record_fetch(e2p, &cur, &pend[pend_cnt])) {
+            if (pend[pend_cnt].valid_state == e2p_pending) {
+                if (++pend_cnt == E2P_BATCH_MAX)
+                    break;
+                continue;
+            }
 
-        if (e2p->remain_size < 2 * sizeof(e2p_block)) {
-            e2p_trace("remain flash is not enough\n");
-            return E2P_ERROR_NO_MEM;
+            for (uint32_t j = 0; j <= pend_cnt; j++) {
+                ret = e2p_table_update(e2p, &pend[j]);
+                if (E2P_STATUS_OK != ret)
+                    return ret;
+            }
+            pend_cnt = 0;
         }
+        if (pend_cnt) {
+            e2p_trace("sector[%u] drop %u records of an incomplete batch\n", sector, pend_cnt);
+        }
+    }
+
+    /* cur is left on the active sector, a torn write or batch makes it unusable */
+    e2p->p_data = cur.p_data;
+    e2p->p_info = cur.p_info;
+    e2p->remain_size = cur.remain_size;
+    if (pend_cnt || !e2p_area_is_blank(e2p, cur.p_data, cur.remain_size)) {
+        e2p_trace("active sector tail is dirty, skip to next sector\n");
+        e2p->remain_size = 0;
     }
 
     e2p_print_info(e2p);
     return E2P_STATUS_OK;
 }
 
-hpm_stat_t e2p_flush(e2p_t *e2p, uint8_t flag)
+hpm_stat_t e2p_idle(e2p_t *e2p)
 {
-    if (e2p->config.erase_size < e2p->remain_size && flag == 0) {
+    if (e2p_free_cnt(e2p) >= E2P_GC_FREE_SECTORS) {
         e2p_trace("no need arrange flash\n");
         return E2P_STATUS_OK;
     }
-    e2p_config_t *cfg = &e2p->config;
-
-    e2p_earse_info_sector(e2p);
-
-    e2p->p_data = cfg->start_addr;
-    e2p->p_info = cfg->start_addr + cfg->sector_cnt * cfg->erase_size - 2 * sizeof(e2p_block);
-    e2p->remain_size = e2p->p_info - e2p->p_data;
 
-    int read_len = 0;
-    int count = 0;
-    uint32_t head, tail;
-    uint8_t read_buf[cfg->erase_size * 2];
-    int valid_num = e2p_info_table_sort();
+    return e2p_gc_step(e2p);
+}
 
-    tail = e2p->p_data;
-    for (int i = 0; i < valid_num;) {
-        head = tail;
+hpm_stat_t e2p_flush(e2p_t *e2p, uint8_t flag)
+{
+    hpm_stat_t ret;
 
-        while (1) {
-            if (e2p_info_table[i].block_id == E2P_EARSED_ID || i >= valid_num) {
-                e2p_trace("e2p blank[%u], need flush num[%u]\n", i, valid_num);
-                break;
-            }
-            cfg->flash_read(read_buf + read_len, e2p_info_table[i].data_addr, e2p_info_table[i].length);
-            read_len += e2p_info_table[i].length;
-            tail = e2p_info_table[i].data_addr + e2p_info_table[i].length;
-            i++;
-            if (read_len >= cfg->erase_size)
-                break;
-        }
+    if (flag == E2P_FLUSH_TRY)
+        return e2p_idle(e2p);
 
-        e2p_trace("---- transfer data to buffer: len=%u\n", read_len);
+    for (uint32_t n = e2p->used_cnt - 1; n > 0; n--) {
+        ret = e2p_gc_step(e2p);
+        if (E2P_STATUS_OK != ret)
+            return ret;
+    }
+    return E2P_STATUS_OK;
+}
 
-        do {
-            cfg->flash_erase(head, cfg->erase_size);
-            head += cfg->erase_size;
-        } while (head + cfg->erase_size <= tail);
+/* make the active sector or the next erased one able to take need bytes */
+static hpm_stat_t e2p_make_room(e2p_t *e2p, uint32_t need)
+{
+    hpm_stat_t ret;
 
-        tail = head;
-        uint8_t *pdata = read_buf;
-        while (count < i) {
-            if (e2p_info_table[count].block_id == E2P_EARSED_ID || e2p->p_data + e2p_info_table[i].length >= tail) {
-                e2p_trace("write back suspend, write stop at 0x%08x/0x0%x\n", e2p->p_data, read_len);
-                break;
-            }
+    /* only reached when e2p_idle did not keep up, bounded to one pass over the ring */
+    for (uint32_t steps = e2p->used_cnt; e2p->remain_size < need && e2p_free_cnt(e2p) <= E2P_GC_RESERVE && steps; steps--) {
+        ret = e2p_gc_step(e2p);
+        if (E2P_STATUS_OK != ret)
+            return ret;
+    }
+    if (e2p->remain_size < need && e2p_free_cnt(e2p) <= E2P_GC_RESERVE) {
+        e2p_trace("no enough flash write\n");
+        return E2P_ERROR_NO_MEM;
+    }
+    return E2P_STATUS_OK;
+}
 
-            e2p_write_private(e2p, e2p_info_table[count].block_id, e2p_info_table[count].length, pdata);
-            pdata += e2p_info_table[count].length;
-            count++;
-        }
+hpm_stat_t e2p_write(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *data)
+{
+    e2p_block block;
+    uint32_t need = length + sizeof(e2p_block);
+    uint32_t live = e2p->live_size + need;
+    hpm_stat_t ret;
 
-        e2p_trace("-----write data back: len=%u\n", pdata - read_buf);
+    if (block_id == E2P_EARSED_ID)
+        return E2P_ERROR_BAD_ID;
 
-        read_len -= (pdata - read_buf);
-        if (read_len)
-            memmove(read_buf, pdata, read_len);
+    if (length > E2P_MAX_LENGTH(&e2p->config)) {
+        e2p_trace("length %u exceeds sector payload\n", length);
+        return E2P_ERROR_NO_MEM;
     }
 
-    while (tail < e2p->p_info - cfg->erase_size) {
-        cfg->flash_erase(tail, cfg->erase_size);
-        tail += cfg->erase_size;
+    if (E2P_STATUS_OK == e2p_retrieve_info(e2p, block_id, &block)) {
+        live -= block.length + sizeof(e2p_block);
+    } else if (e2p->var_cnt == e2p->var_max) {
+        /* refuse a new variable before it reaches flash, or the next e2p_config could not index it */
+        e2p_trace("block_id[0x%08x] no free variable\n", block_id);
+        return E2P_ERROR_MUL_VAR;
     }
-
-    uint8_t *ptr = read_buf;
-    while (read_len) {
-        e2p_trace("remain write back[%u], block_id[%x], data_addr[%x], length[%u], valid_state[%u], crc[%x]\n", \
-            count, e2p_info_table[count].block_id, e2p_info_table[count].data_addr, e2p_info_table[count].length, e2p_info_table[count].valid_state, e2p_info_table[count].crc);
-        e2p_write_private(e2p, e2p_info_table[count].block_id, e2p_info_table[count].length, ptr);
-        read_len -= e2p_info_table[count].length;
-        ptr += e2p_info_table[count].length;
-        count++;
+    if (live > e2p->live_max) {
+        e2p_trace("no enough flash write\n");
+        return E2P_ERROR_NO_MEM;
     }
 
-    e2p_config_info(e2p);
-    return E2P_STATUS_OK;
+    ret = e2p_make_room(e2p, need);
+    if (E2P_STATUS_OK != ret)
+        return ret;
+
+    block.block_id = block_id;
+    block.length = length;
+    block.crc = e2p_data_crc_calc(length, data);
+    ret = e2p_append(e2p, &block, data);
+    if (E2P_STATUS_OK == ret)
+        e2p_cache_put(e2p, block_id, length, data);
+    return ret;
 }
 
-hpm_stat_t e2p_write(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *data)
+hpm_stat_t e2p_write_batch(e2p_t *e2p, const e2p_batch_item *items, uint32_t cnt)
 {
-    if (e2p->remain_size < length + sizeof(e2p_block)) {
-        e2p_flush(e2p, E2P_FLUSH_BEGIN);
-        if (e2p->remain_size < length + sizeof(e2p_block)) {
-            e2p_trace("no enough flash write\n");
-            return E2P_ERROR_NO_MEM;
+    e2p_block rec[E2P_BATCH_MAX];
+    uint32_t burst[E2P_BURST_SIZE / 4];
+    uint8_t *stage = (uint8_t *)burst;
+    e2p_config_t *cfg = &e2p->config;
+    uint32_t need = 0, live = e2p->live_size;
+    uint32_t addr, fill = 0;
+    hpm_stat_t ret;
+    e2p_block block;
+    bool dup;
+
+    if (cnt == 0 || cnt > E2P_BATCH_MAX)
+        return E2P_ERROR;
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (items[i].block_id == E2P_EARSED_ID)
+            return E2P_ERROR_BAD_ID;
+
+        need += items[i].length + sizeof(e2p_block);
+        live += items[i].length + sizeof(e2p_block);
+
+        dup = false;
+        for (uint32_t j = 0; j < i; j++)
+            dup |= items[j].block_id == items[i].block_id;
+        if (!dup && E2P_STATUS_OK == e2p_retrieve_info(e2p, items[i].block_id, &block))
+            live -= block.length + sizeof(e2p_block);
+    }
+
+    if (need > cfg->erase_size - sizeof(e2p_sector_hdr) || live > e2p->live_max) {
+        e2p_trace("batch of %u bytes does not fit\n", need);
+        return E2P_ERROR_NO_MEM;
+    }
+
+    ret = e2p_make_room(e2p, need);
+    if (E2P_STATUS_OK != ret)
+        return ret;
+    if (e2p->remain_size < need)
+        e2p_sector_open(e2p, (e2p->active + 1) % cfg->sector_cnt);
+
+    /* records grow down, rec[cnt - 1] is the lowest address and the commit record */
+    addr = e2p->p_data;
+    for (uint32_t i = 0; i < cnt; i++) {
+        rec[cnt - 1 - i].block_id = items[i].block_id;
+        rec[cnt - 1 - i].data_addr = addr;
+        rec[cnt - 1 - i].length = items[i].length;
+        rec[cnt - 1 - i].valid_state = (i == cnt - 1) ? e2p_valid : e2p_pending;
+        rec[cnt - 1 - i].crc = e2p_data_crc_calc(items[i].length, items[i].data);
+        addr += items[i].length;
+    }
+
+    /* all data in page sized bursts */
+    addr = e2p->p_data;
+    for (uint32_t i = 0; i < cnt; i++) {
+        for (uint32_t off = 0; off < items[i].length;) {
+            uint32_t len = items[i].length - off;
+
+            len = len < sizeof(burst) - fill ? len : sizeof(burst) - fill;
+            memcpy(stage + fill, items[i].data + off, len);
+            fill += len;
+            off += len;
+            if (fill == sizeof(burst)) {
+                if (E2P_STATUS_OK != cfg->flash_write(stage, addr, fill))
+                    return E2P_ERROR;
+                addr += fill;
+                fill = 0;
+            }
         }
     }
+    if (fill && E2P_STATUS_OK != cfg->flash_write(stage, addr, fill))
+        return E2P_ERROR;
+
+    /* pending records in one burst, then the commit record on its own */
+    if (cnt > 1 && E2P_STATUS_OK != cfg->flash_write((uint8_t *)&rec[1], e2p->p_info - (cnt - 2) * sizeof(e2p_block), (cnt - 1) * sizeof(e2p_block)))
+        return E2P_ERROR;
+    if (E2P_STATUS_OK != cfg->flash_write((uint8_t *)&rec[0], e2p->p_info - (cnt - 1) * sizeof(e2p_block), sizeof(e2p_block)))
+        return E2P_ERROR;
+
+    e2p->p_data += need - cnt * sizeof(e2p_block);
+    e2p->p_info -= cnt * sizeof(e2p_block);
+    e2p->remain_size -= need;
 
-    return e2p_write_private(e2p, block_id, length, data);
+    for (uint32_t i = 0; i < cnt; i++) {
+        ret = e2p_table_update(e2p, &rec[cnt - 1 - i]);
+        if (E2P_STATUS_OK != ret)
+            return ret;
+        e2p_cache_put(e2p, items[i].block_id, items[i].length, items[i].data);
+    }
+
+    e2p_info("batch of %u success write, remain size=0x%08x\n", cnt, e2p->remain_size);
+    return E2P_STATUS_OK;
 }
 
 hpm_stat_t e2p_read(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *data)
@@ -365,7 +805,10 @@ hpm_stat_t e2p_read(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *dat
     e2p_block block;
     int ret = 0;
 
-    ret = e2p_retrieve_info(block_id, &block);
+    if (e2p_cache_get(e2p, block_id, length, data))
+        return E2P_STATUS_OK;
+
+    ret = e2p_retrieve_info(e2p, block_id, &block);
     if (ret != E2P_STATUS_OK)
         return ret;
 
@@ -377,6 +820,7 @@ hpm_stat_t e2p_read(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *dat
         return E2P_ERROR;
     }
     
+    e2p_cache_put(e2p, block_id, block.length, tmp);
     length > block.length ? (length=block.length) : length;
     memmove(data, tmp, length);
     return E2P_STATUS_OK;
@@ -384,9 +828,14 @@ hpm_stat_t e2p_read(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *dat
 
 void e2p_format(e2p_t *e2p)
 {
-    e2p_config_t *cfg = &e2p->config;
+    e2p_table_init(e2p);
+    e2p_cache_reset(e2p);
+    e2p->live_size = 0;
+
+    for (uint32_t i = 0; i < e2p->config.sector_cnt; i++)
+        e2p_sector_recycle(e2p, i);
 
-    cfg->flash_erase(cfg->start_addr, cfg->sector_cnt * cfg->erase_size);
+    e2p_start_fresh(e2p);
 }
 
 uint32_t e2p_generate_id(const char *name)
@@ -395,6 +844,19 @@ uint32_t e2p_generate_id(const char *name)
 }
 
 
+uint32_t e2p_get_erase_count(e2p_t *e2p, uint32_t sector)
+{
+    e2p_sector_hdr hdr;
+
+    if (sector >= e2p->config.sector_cnt)
+        return 0;
+
+    e2p_read_hdr(e2p, sector, &hdr);
+    if (hdr.magic != E2P_MAGIC_ID || hdr.erase_cnt == E2P_EARSED_ID)
+        return 0;
+    return hdr.erase_cnt;
+}
+
 void e2p_show_info(e2p_t *e2p)
 {
     e2p_print_info(e2p);
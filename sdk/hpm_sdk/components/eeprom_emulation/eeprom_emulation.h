@@ -64,8 +64,39 @@ extern "C" {
 #define E2P_MAX_VAR_CNT     EEPROM_MAX_VAR_CNT
 #endif
 
+/* erased sectors e2p_idle keeps ahead of the write sector, at least 3 */
+#define E2P_GC_FREE_SECTORS (3)
+#ifdef EEPROM_GC_FREE_SECTORS
+#undef E2P_GC_FREE_SECTORS
+#define E2P_GC_FREE_SECTORS EEPROM_GC_FREE_SECTORS
+#endif
+
+/* variables one e2p_write_batch call can commit */
+#define E2P_BATCH_MAX (8)
+#ifdef EEPROM_BATCH_MAX
+#undef E2P_BATCH_MAX
+#define E2P_BATCH_MAX EEPROM_BATCH_MAX
+#endif
+
+/* read cache of recently written values, E2P_CACHE_CNT 0 - disabled */
+#define E2P_CACHE_CNT       (4)
+#define E2P_CACHE_DATA_SIZE (32)
+#ifdef EEPROM_CACHE_CNT
+#undef E2P_CACHE_CNT
+#define E2P_CACHE_CNT       EEPROM_CACHE_CNT
+#endif
+#ifdef EEPROM_CACHE_DATA_SIZE
+#undef E2P_CACHE_DATA_SIZE
+#define E2P_CACHE_DATA_SIZE EEPROM_CACHE_DATA_SIZE
+#endif
+
+/* variable index: cnt entries plus an open-addressing slot array of at most 4 * cnt */
+#define E2P_HASH_SLOT_MAX(cnt)      (4 * (cnt))
+#define E2P_TABLE_SIZE(cnt)         ((cnt) * sizeof(e2p_block) + E2P_HASH_SLOT_MAX(cnt) * sizeof(uint16_t))
+
 typedef enum {
     e2p_invalid = 0xCCCC,
+    e2p_pending = 0xAAAA,   /* batch member, committed by the e2p_valid record after it */
     e2p_valid = 0xEEEE,
     e2p_earsed = 0xFFFF,
 } e2p_valid_state;
@@ -84,10 +115,38 @@ typedef struct {
     uint32_t block_id;
     uint32_t data_addr;
     uint16_t length;
-    e2p_valid_state valid_state;
     uint32_t crc;
+    e2p_valid_state valid_state;    /* programmed last, a torn record is not taken */
 } e2p_block; 
 
+/*
+ * Every sector starts with this header, data grows up behind it and
+ * e2p_block records grow down from the sector end. Sectors are used as a
+ * ring: seq is programmed when a sector starts taking records, the sector
+ * with the oldest seq is the next one to be compacted. An erased sector
+ * carries version and erase_cnt, then magic, with seq and seq_check left
+ * at E2P_EARSED_ID.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t erase_cnt;
+    uint32_t seq;
+    uint32_t seq_check;     /* ~seq */
+} e2p_sector_hdr;
+
+typedef struct {
+    uint32_t block_id;
+    uint16_t length;
+    uint8_t *data;
+} e2p_batch_item;
+
+typedef struct {
+    uint32_t block_id;
+    uint16_t length;
+    uint8_t data[E2P_CACHE_DATA_SIZE];
+} e2p_cache_entry;
+
 typedef struct {
     uint32_t start_addr;
     uint32_t sector_cnt;
@@ -97,6 +156,9 @@ typedef struct {
     uint32_t (*flash_read)(uint8_t *buf, uint32_t addr, uint32_t size);
     uint32_t (*flash_write)(uint8_t *buf, uint32_t addr, uint32_t size);
     void (*flash_erase)(uint32_t start_addr, uint32_t size);
+
+    void *table;            /* index storage of E2P_TABLE_SIZE(max_var_cnt) bytes, NULL - use internal one */
+    uint32_t max_var_cnt;   /* 0 - E2P_MAX_VAR_CNT */
 } e2p_config_t;
 
 typedef struct {
@@ -105,7 +167,25 @@ typedef struct {
 
     uint32_t p_data;
     uint32_t p_info;
-    uint32_t remain_size;
+    uint32_t remain_size;   /* free bytes of the active sector */
+
+    uint32_t active;        /* sector taking new records */
+    uint32_t oldest;        /* next sector to be compacted */
+    uint32_t used_cnt;      /* sectors from oldest to active */
+    uint32_t seq;
+    uint32_t live_size;     /* data and record bytes still referenced */
+    uint32_t live_max;
+
+    e2p_block *table;
+    uint16_t *slot;
+    uint32_t slot_mask;
+    uint32_t var_cnt;
+    uint32_t var_max;
+
+#if E2P_CACHE_CNT > 0
+    e2p_cache_entry cache[E2P_CACHE_CNT];
+    uint32_t cache_next;
+#endif
 } e2p_t;
 
 #define E2P_MAGIC_ID (0x48504D43)       /*'H' 'P' 'M' 'C'*/
@@ -116,6 +196,8 @@ typedef struct {
 #define E2P_FLUSH_TRY       (0)
 #define E2P_FLUSH_BEGIN     (1)
 
+#define E2P_MAX_LENGTH(cfg) ((cfg)->erase_size - sizeof(e2p_sector_hdr) - sizeof(e2p_block))
+
 /**
  * @brief eeprom emulation config
  * 
@@ -125,14 +207,25 @@ typedef struct {
 hpm_stat_t e2p_config(e2p_t *e2p);
 
 /**
- * @brief eeprom emulation flush whole area, remove redundancy
+ * @brief eeprom emulation flush, remove redundancy
  * 
  * @param e2p instance context
- * @param flag E2P_FLUSH_TRY - conditional flush, E2P_FLUSH_BEGIN - force flush
+ * @param flag E2P_FLUSH_TRY - same as e2p_idle, E2P_FLUSH_BEGIN - compact every sector but the active one
  * @return hpm_stat_t 
  */
 hpm_stat_t e2p_flush(e2p_t *e2p, uint8_t flag);
 
+/**
+ * @brief eeprom emulation idle hook, compacts at most one sector per call
+ *
+ * keeps E2P_GC_FREE_SECTORS erased sectors ahead so e2p_write never has to erase,
+ * call it from an idle task or the main loop
+ *
+ * @param e2p instance context
+ * @return hpm_stat_t
+ */
+hpm_stat_t e2p_idle(e2p_t *e2p);
+
 /**
  * @brief eeprom emulation write
  * 
@@ -144,6 +237,20 @@ hpm_stat_t e2p_flush(e2p_t *e2p, uint8_t flag);
  */
 hpm_stat_t e2p_write(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *data);
 
+/**
+ * @brief eeprom emulation atomic write of several variables
+ *
+ * data is programmed in one burst followed by the records, the last record
+ * commits the batch. after a power loss either all or none of the items are
+ * seen by e2p_config. the whole batch must fit in one sector.
+ *
+ * @param e2p instance context
+ * @param items variables to write, a block_id given twice keeps the last one
+ * @param cnt item count, 1 ~ E2P_BATCH_MAX
+ * @return hpm_stat_t
+ */
+hpm_stat_t e2p_write_batch(e2p_t *e2p, const e2p_batch_item *items, uint32_t cnt);
+
 /**
  * @brief eeprom emulation read
  * 
@@ -164,12 +271,21 @@ hpm_stat_t e2p_read(e2p_t *e2p, uint32_t block_id, uint16_t length, uint8_t *dat
 uint32_t e2p_generate_id(const char *name);
 
 /**
- * @brief format whole area, 0xFF
+ * @brief format whole area, all variables are dropped and erase counters kept
  * 
  * @param e2p 
  */
 void e2p_format(e2p_t *e2p);
 
+/**
+ * @brief erase count of one sector
+ *
+ * @param e2p
+ * @param sector sector index from config.start_addr
+ * @return uint32_t
+ */
+uint32_t e2p_get_erase_count(e2p_t *e2p, uint32_t sector);
+
 /**
  * @brief show e2p instance info include config info and store info
  * 
@@ -188,6 +304,16 @@ void e2p_show_info(e2p_t *e2p);
         .config.flash_erase = flash_erase,
     };
 
+    several instances need their own index storage:
+
+    static uint32_t calib_table[E2P_TABLE_SIZE(500) / sizeof(uint32_t)];
+
+    e2p_t calib = {
+        ...
+        .config.table = calib_table,
+        .config.max_var_cnt = 500,
+    };
+
 
     int main(void)
     {
@@ -195,7 +321,10 @@ void e2p_show_info(e2p_t *e2p);
 
         
         ...
-        ...
+        while (1) {
+            ...
+            e2p_idle(&demo);
+        }
     }
 
 */
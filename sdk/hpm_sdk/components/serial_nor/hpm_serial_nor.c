@@ -311,6 +311,15 @@ static hpm_stat_t get_page_sector_block_size_from_sfdp(hpm_serial_nor_info_t *co
 
         config->block_size_kbytes = block_size / SIZE_1KB;
 
+        /* Get Suspend/Resume instructions, bit31 of the 12th word is set if suspend is not supported */
+        config->suspend_cmd = 0U;
+        config->resume_cmd = 0U;
+        if ((tbl->flash_param_tbl_size >= SFDP_BASIC_PROTOCOL_TABLE_SIZE_REVA) &&
+            !IS_HPM_BIT_SET(param_tbl->suspend_resume_info.suspend_resume_spec, 31)) {
+            config->suspend_cmd = (uint8_t) (param_tbl->suspend_resume_info.suspend_resume_inst >> 24);
+            config->resume_cmd = (uint8_t) (param_tbl->suspend_resume_info.suspend_resume_inst >> 16);
+        }
+
         if (flash_size > MAX_24BIT_ADDRESSING_SIZE) {
             if (tbl->has_4b_addressing_inst_table) {
                 config->sector_erase_cmd = flash_4b_tbl->erase_inst_info.erase_inst[sector_erase_type];
@@ -1098,7 +1107,29 @@ hpm_stat_t hpm_serial_nor_page_program_noblocking(hpm_serial_nor_t *flash, uint8
     return stat;
 }
 
-hpm_stat_t hpm_serial_nor_read(hpm_serial_nor_t *flash, uint8_t *buf, uint16_t data_len, uint32_t address)
+hpm_stat_t hpm_serial_nor_suspend(hpm_serial_nor_t *flash)
+{
+    if (flash == NULL) {
+        return status_invalid_argument;
+    }
+    if (flash->flash_info.suspend_cmd == 0U) {
+        return status_spi_nor_flash_suspend_not_supported;
+    }
+    return hpm_spi_nor_set_command(flash, flash->flash_info.suspend_cmd);
+}
+
+hpm_stat_t hpm_serial_nor_resume(hpm_serial_nor_t *flash)
+{
+    if (flash == NULL) {
+        return status_invalid_argument;
+    }
+    if (flash->flash_info.resume_cmd == 0U) {
+        return status_spi_nor_flash_suspend_not_supported;
+    }
+    return hpm_spi_nor_set_command(flash, flash->flash_info.resume_cmd);
+}
+
+hpm_stat_t hpm_serial_nor_read(hpm_serial_nor_t *flash, uint8_t *buf, uint32_t data_len, uint32_t address)
 {
     hpm_stat_t stat;
     hpm_serial_nor_transfer_seq_t command_seq = {0};
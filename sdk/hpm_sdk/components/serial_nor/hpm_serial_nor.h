@@ -20,6 +20,7 @@ enum {
     status_spi_nor_flash_para_err = MAKE_STATUS(status_group_spi_nor_flash, 3),
     status_spi_nor_flash_is_busy = MAKE_STATUS(status_group_spi_nor_flash, 4),
     status_spi_nor_flash_not_qe_bit_in_sfdp = MAKE_STATUS(status_group_spi_nor_flash, 5),
+    status_spi_nor_flash_suspend_not_supported = MAKE_STATUS(status_group_spi_nor_flash, 6),      /**< Erase suspend/resume is not supported */
 };
 
 #ifdef __cplusplus
@@ -126,15 +127,37 @@ hpm_stat_t hpm_serial_nor_page_program_noblocking(hpm_serial_nor_t *flash, uint8
                                                   uint32_t data_len,
                                                   uint32_t address);
 
+/**
+ * @brief suspend the erase or program operation in progress
+ *
+ * @note the flash accepts read commands once it is no longer busy, poll hpm_serial_nor_is_busy before reading.
+ *       reading the sector or block being erased returns undefined data.
+ *
+ * @param [in] host  the serial nor context
+ * @return hpm_stat_t: status_success if the suspend command was sent
+ */
+hpm_stat_t hpm_serial_nor_suspend(hpm_serial_nor_t *flash);
+
+/**
+ * @brief resume the erase or program operation suspended by hpm_serial_nor_suspend
+ * @param [in] host  the serial nor context
+ * @return hpm_stat_t: status_success if the resume command was sent
+ */
+hpm_stat_t hpm_serial_nor_resume(hpm_serial_nor_t *flash);
+
 /**
  * @brief read the data of specified serial nor flash address
+ *
+ * @note the host splits the read into transfer_max_size transfers. when the cs is driven by gpio the command
+ *       and address are only sent once and the remaining transfers continue the same read.
+ *
  * @param [in] host  the serial nor context
  * @param [in] buf  the data source pointer
  * @param [in] data_len the data length
  * @param [in] address  the serial nor flash reading address
  * @return hpm_stat_t: status_success if read success
  */
-hpm_stat_t hpm_serial_nor_read(hpm_serial_nor_t *flash, uint8_t *buf, uint16_t data_len,
+hpm_stat_t hpm_serial_nor_read(hpm_serial_nor_t *flash, uint8_t *buf, uint32_t data_len,
                             uint32_t address);
 
 /**
@@ -50,6 +50,8 @@ typedef struct {
     uint8_t sfdp_version;
     uint8_t sector_erase_cmd;
     uint8_t block_erase_cmd;
+    uint8_t suspend_cmd;    /* erase/program suspend instruction, 0 if not supported */
+    uint8_t resume_cmd;     /* erase/program resume instruction, 0 if not supported */
     uint32_t size_in_kbytes;
     uint16_t page_size;
     uint16_t sector_size_kbytes;
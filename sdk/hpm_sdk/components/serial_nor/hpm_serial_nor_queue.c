@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2023 HPMicro
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "hpm_serial_nor_queue.h"
+#include "hpm_soc.h"
+#include "hpm_csr_drv.h"
+#include "hpm_clock_drv.h"
+
+#define SERIAL_NOR_QUEUE_FREQ_1MHZ (1000000UL)
+
+static uint32_t serial_nor_queue_enter_critical(void)
+{
+    return disable_global_irq(CSR_MSTATUS_MIE_MASK);
+}
+
+static void serial_nor_queue_exit_critical(uint32_t level)
+{
+    restore_global_irq(level);
+}
+
+static void serial_nor_queue_complete(hpm_serial_nor_queue_t *queue, hpm_serial_nor_job_t *job, hpm_stat_t status)
+{
+    uint32_t level = serial_nor_queue_enter_critical();
+    if (job->urgent) {
+        queue->urgent_head = job->next;
+        if (queue->urgent_head == NULL) {
+            queue->urgent_tail = NULL;
+        }
+    } else {
+        queue->head = job->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+    }
+    serial_nor_queue_exit_critical(level);
+
+    job->next = NULL;
+    if (job->cb != NULL) {
+        job->cb(job, status);
+    }
+}
+
+static hpm_stat_t serial_nor_queue_read(hpm_serial_nor_t *flash, hpm_serial_nor_job_t *job)
+{
+    hpm_stat_t stat = hpm_serial_nor_read(flash, job->buf, job->len, job->addr);
+    if (stat == status_success) {
+        job->offset = job->len;
+    }
+    return stat;
+}
+
+static bool serial_nor_queue_urgent_ready(hpm_serial_nor_queue_t *queue)
+{
+    hpm_serial_nor_job_t *erase = queue->head;
+    hpm_serial_nor_job_t *read = queue->urgent_head;
+    uint32_t erase_start;
+
+    if (read == NULL) {
+        return false;
+    }
+    /* The sector being erased reads back undefined data while suspended, let the read wait for the erase */
+    erase_start = erase->addr + erase->offset;
+    return (read->addr >= erase_start + erase->op_len) || (erase_start >= read->addr + read->len);
+}
+
+static bool serial_nor_queue_can_suspend(hpm_serial_nor_queue_t *queue)
+{
+    uint32_t ticks_per_us;
+
+    if ((queue->head->type != serial_nor_job_erase) || (queue->flash->flash_info.suspend_cmd == 0U) ||
+        !serial_nor_queue_urgent_ready(queue)) {
+        return false;
+    }
+    ticks_per_us = (hpm_core_clock + SERIAL_NOR_QUEUE_FREQ_1MHZ - 1U) / SERIAL_NOR_QUEUE_FREQ_1MHZ;
+    return (hpm_csr_get_core_cycle() - queue->resume_tick) >= ((uint64_t) ticks_per_us * SERIAL_NOR_QUEUE_RESUME_TO_SUSPEND_US);
+}
+
+static hpm_stat_t serial_nor_queue_start(hpm_serial_nor_queue_t *queue, hpm_serial_nor_job_t *job)
+{
+    hpm_serial_nor_t *flash = queue->flash;
+    hpm_stat_t stat;
+    uint32_t addr = job->addr + job->offset;
+    uint32_t remaining_len = job->len - job->offset;
+    uint32_t page_size = flash->flash_info.page_size;
+    uint32_t block_size = flash->flash_info.block_size_kbytes * SIZE_1KB;
+
+    if (job->type == serial_nor_job_program) {
+        job->op_len = MIN(remaining_len, page_size - (addr % page_size));
+        stat = hpm_serial_nor_page_program_noblocking(flash, job->buf + job->offset, job->op_len, addr);
+    } else if ((block_size != 0U) && (addr % block_size == 0U) && (remaining_len >= block_size)) {
+        job->op_len = block_size;
+        stat = hpm_serial_nor_erase_block_noblocking(flash, addr);
+    } else {
+        job->op_len = flash->flash_info.sector_size_kbytes * SIZE_1KB;
+        stat = hpm_serial_nor_erase_sector_noblocking(flash, addr);
+    }
+    return stat;
+}
+
+hpm_stat_t hpm_serial_nor_queue_init(hpm_serial_nor_queue_t *queue, hpm_serial_nor_t *flash)
+{
+    if ((queue == NULL) || (flash == NULL)) {
+        return status_invalid_argument;
+    }
+    (void) memset(queue, 0, sizeof(*queue));
+    queue->flash = flash;
+    queue->state = serial_nor_queue_idle;
+    return status_success;
+}
+
+hpm_stat_t hpm_serial_nor_queue_submit(hpm_serial_nor_queue_t *queue, hpm_serial_nor_job_t *job)
+{
+    uint32_t sector_size;
+    uint32_t start;
+    uint32_t level;
+
+    if ((queue == NULL) || (job == NULL) || (job->len == 0U)) {
+        return status_invalid_argument;
+    }
+    if ((job->type != serial_nor_job_erase) && (job->buf == NULL)) {
+        return status_invalid_argument;
+    }
+    if ((job->addr >= queue->flash->flash_info.size_in_kbytes * SIZE_1KB) ||
+        (job->len > queue->flash->flash_info.size_in_kbytes * SIZE_1KB - job->addr)) {
+        return status_invalid_argument;
+    }
+
+    if (job->type == serial_nor_job_erase) {
+        sector_size = queue->flash->flash_info.sector_size_kbytes * SIZE_1KB;
+        start = HPM_ALIGN_DOWN(job->addr, sector_size);
+        job->len = HPM_ALIGN_UP(job->addr + job->len, sector_size) - start;
+        job->addr = start;
+    }
+    if (job->type != serial_nor_job_read) {
+        job->urgent = false;
+    }
+    job->next = NULL;
+    job->offset = 0U;
+    job->op_len = 0U;
+
+    level = serial_nor_queue_enter_critical();
+    if (job->urgent) {
+        if (queue->urgent_tail != NULL) {
+            queue->urgent_tail->next = job;
+        } else {
+            queue->urgent_head = job;
+        }
+        queue->urgent_tail = job;
+    } else {
+        if (queue->tail != NULL) {
+            queue->tail->next = job;
+        } else {
+            queue->head = job;
+        }
+        queue->tail = job;
+    }
+    serial_nor_queue_exit_critical(level);
+    return status_success;
+}
+
+hpm_stat_t hpm_serial_nor_queue_poll(hpm_serial_nor_queue_t *queue)
+{
+    hpm_serial_nor_t *flash;
+    hpm_serial_nor_job_t *job;
+    hpm_stat_t stat;
+
+    if (queue == NULL) {
+        return status_invalid_argument;
+    }
+    flash = queue->flash;
+
+    switch (queue->state) {
+    case serial_nor_queue_busy:
+        stat = hpm_serial_nor_is_busy(flash);
+        if (stat == status_spi_nor_flash_is_busy) {
+            if (serial_nor_queue_can_suspend(queue) && (hpm_serial_nor_suspend(flash) == status_success)) {
+                queue->state = serial_nor_queue_suspending;
+                queue->suspend_count++;
+            }
+            return status_spi_nor_flash_is_busy;
+        }
+        job = queue->head;
+        queue->state = serial_nor_queue_idle;
+        if (stat != status_success) {
+            serial_nor_queue_complete(queue, job, stat);
+            break;
+        }
+        job->offset += job->op_len;
+        job->op_len = 0U;
+        if (job->offset >= job->len) {
+            serial_nor_queue_complete(queue, job, status_success);
+        }
+        break;
+    case serial_nor_queue_suspending:
+        stat = hpm_serial_nor_is_busy(flash);
+        if (stat == status_spi_nor_flash_is_busy) {
+            return status_spi_nor_flash_is_busy;
+        }
+        queue->state = serial_nor_queue_suspended;
+        /* fall through */
+    case serial_nor_queue_suspended:
+        while (serial_nor_queue_urgent_ready(queue)) {
+            job = queue->urgent_head;
+            serial_nor_queue_complete(queue, job, serial_nor_queue_read(flash, job));
+        }
+        /* Keep the suspended state if resume fails, the next poll retries it */
+        if (hpm_serial_nor_resume(flash) == status_success) {
+            queue->resume_tick = hpm_csr_get_core_cycle();
+            queue->state = serial_nor_queue_busy;
+        }
+        return status_spi_nor_flash_is_busy;
+    default:
+        break;
+    }
+
+    /* The flash is idle here, urgent reads go first */
+    while (queue->urgent_head != NULL) {
+        job = queue->urgent_head;
+        serial_nor_queue_complete(queue, job, serial_nor_queue_read(flash, job));
+    }
+
+    job = queue->head;
+    if (job == NULL) {
+        return status_success;
+    }
+    if (job->type == serial_nor_job_read) {
+        serial_nor_queue_complete(queue, job, serial_nor_queue_read(flash, job));
+        return (hpm_serial_nor_queue_is_idle(queue)) ? status_success : status_spi_nor_flash_is_busy;
+    }
+
+    stat = serial_nor_queue_start(queue, job);
+    if (stat != status_success) {
+        serial_nor_queue_complete(queue, job, stat);
+    } else {
+        queue->state = serial_nor_queue_busy;
+    }
+    return status_spi_nor_flash_is_busy;
+}
+
+bool hpm_serial_nor_queue_is_idle(hpm_serial_nor_queue_t *queue)
+{
+    return (queue->state == serial_nor_queue_idle) && (queue->head == NULL) && (queue->urgent_head == NULL);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2023 HPMicro
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef _HPM_SERIAL_NOR_QUEUE_H
+#define _HPM_SERIAL_NOR_QUEUE_H
+
+#include "hpm_serial_nor.h"
+
+/**
+ * @brief minimum time the flash is left running after a resume before it may be suspended again
+ *
+ * @note flashes ignore or delay a suspend issued too soon after resume (tRS), and back to back
+ *       suspends would otherwise starve the erase.
+ */
+#ifndef SERIAL_NOR_QUEUE_RESUME_TO_SUSPEND_US
+#define SERIAL_NOR_QUEUE_RESUME_TO_SUSPEND_US (100U)
+#endif
+
+/**
+ * @brief job type of serial nor flash queue
+ */
+typedef enum {
+    serial_nor_job_read = 0,
+    serial_nor_job_program,
+    serial_nor_job_erase
+} hpm_serial_nor_job_type_t;
+
+typedef struct hpm_serial_nor_job hpm_serial_nor_job_t;
+
+/**
+ * @brief job completion callback, called from hpm_serial_nor_queue_poll context
+ *
+ * @note the job is no longer owned by the queue when the callback runs, it may be resubmitted.
+ */
+typedef void (*hpm_serial_nor_job_cb_t)(hpm_serial_nor_job_t *job, hpm_stat_t status);
+
+/**
+ * @brief serial nor flash queue job, the storage is provided by the caller
+ *
+ * @note erase jobs erase every sector touched by [addr, addr + len), like hpm_serial_nor_erase_blocking.
+ *       urgent is only meaningful for read jobs: an urgent read is served before queued jobs and may
+ *       suspend an erase in progress. it is not ordered against queued program/erase jobs.
+ */
+struct hpm_serial_nor_job {
+    hpm_serial_nor_job_t *next;
+    hpm_serial_nor_job_type_t type;
+    bool urgent;
+    uint32_t addr;
+    uint32_t len;
+    uint8_t *buf;
+    hpm_serial_nor_job_cb_t cb;
+    void *user_data;
+    /* progress, owned by the queue */
+    uint32_t offset;
+    uint32_t op_len;
+};
+
+/**
+ * @brief state of serial nor flash queue
+ */
+typedef enum {
+    serial_nor_queue_idle = 0,
+    serial_nor_queue_busy,              /* program or erase in progress */
+    serial_nor_queue_suspending,        /* suspend command sent, waiting for the flash to become ready */
+    serial_nor_queue_suspended
+} hpm_serial_nor_queue_state_t;
+
+/**
+ * @brief serial nor flash queue context
+ */
+typedef struct {
+    hpm_serial_nor_t *flash;
+    hpm_serial_nor_job_t *head;
+    hpm_serial_nor_job_t *tail;
+    hpm_serial_nor_job_t *urgent_head;
+    hpm_serial_nor_job_t *urgent_tail;
+    hpm_serial_nor_queue_state_t state;
+    uint64_t resume_tick;
+    uint32_t suspend_count;
+} hpm_serial_nor_queue_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief initialize the serial nor flash queue
+ * @param [in] queue  the queue context
+ * @param [in] flash  the serial nor context, hpm_serial_nor_init must have been called
+ * @return hpm_stat_t: status_success if initialization success
+ */
+hpm_stat_t hpm_serial_nor_queue_init(hpm_serial_nor_queue_t *queue, hpm_serial_nor_t *flash);
+
+/**
+ * @brief append a job to the serial nor flash queue
+ *
+ * @note this only links the job, the flash is driven by hpm_serial_nor_queue_poll.
+ *       the job and its buffer must stay valid until the callback is called.
+ *
+ * @param [in] queue  the queue context
+ * @param [in] job  the job to be submitted
+ * @return hpm_stat_t: status_success if the job was queued
+ */
+hpm_stat_t hpm_serial_nor_queue_submit(hpm_serial_nor_queue_t *queue, hpm_serial_nor_job_t *job);
+
+/**
+ * @brief advance the serial nor flash queue
+ *
+ * @note call it from a timer or DMA completion callback. each call reads the status register once and,
+ *       if the flash is ready, starts the next page program or erase without waiting for it.
+ *       read jobs are executed directly in this call.
+ *
+ * @param [in] queue  the queue context
+ * @return hpm_stat_t: status_success if the queue is empty and the flash is idle,
+ *                     status_spi_nor_flash_is_busy if jobs are pending
+ */
+hpm_stat_t hpm_serial_nor_queue_poll(hpm_serial_nor_queue_t *queue);
+
+/**
+ * @brief determine whether the serial nor flash queue is empty and idle
+ * @param [in] queue  the queue context
+ * @return bool: true if no job is pending
+ */
+bool hpm_serial_nor_queue_is_idle(hpm_serial_nor_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -302,6 +302,46 @@ static hpm_stat_t write(void *ops, hpm_serial_nor_transfer_seq_t *cmd_seq)
     return stat;
 }
 
+static hpm_stat_t hpm_spi_read_kick_via_dma(hpm_serial_nor_host_t *host, spi_control_config_t *control_config,
+                                            uint8_t cmd, uint32_t addr, uint32_t len)
+{
+    hpm_stat_t stat;
+    uint32_t timeout_count = 0;
+    SPI_Type *spi_ptr = (SPI_Type *)host->host_param.param.host_base;
+
+    stat = spi_setup_dma_transfer(spi_ptr, control_config, &cmd, &addr, 0, len);
+    if (stat != status_success) {
+        return stat;
+    }
+    /* the next kick resets the rx fifo, wait until the DMA has drained it */
+    while (spi_is_active(spi_ptr) || (spi_get_rx_fifo_valid_data_size(spi_ptr) != 0U)) {
+        timeout_count++;
+        if (timeout_count >= 0xFFFFFF) {
+            return status_timeout;
+        }
+    }
+    return stat;
+}
+
+static hpm_stat_t hpm_spi_read_wait_dma(hpm_serial_nor_host_t *host)
+{
+    uint32_t dma_status;
+    uint32_t timeout_count = 0;
+    DMA_Type *dma_ptr = (DMA_Type *)host->host_param.param.dma_control.dma_base;
+    uint8_t ch_num = host->host_param.param.dma_control.rx_dma_ch;
+
+    do {
+        dma_status = dma_check_transfer_status(dma_ptr, ch_num);
+        timeout_count++;
+    } while ((dma_status == DMA_CHANNEL_STATUS_ONGOING) && (timeout_count < 0xFFFFFF));
+
+    if ((dma_status & DMA_CHANNEL_STATUS_TC) == 0) {
+        dma_disable_channel(dma_ptr, ch_num);
+        return (dma_status == DMA_CHANNEL_STATUS_ONGOING) ? status_timeout : status_fail;
+    }
+    return status_success;
+}
+
 static hpm_stat_t read(void *ops, hpm_serial_nor_transfer_seq_t *cmd_seq)
 {
     hpm_stat_t stat = status_success;
@@ -309,16 +349,27 @@ static hpm_stat_t read(void *ops, hpm_serial_nor_transfer_seq_t *cmd_seq)
     uint32_t aligned_end;
     uint32_t aligned_size;
     spi_control_config_t control_config = {0};
+    spi_control_config_t data_config;
+    spi_control_config_t *config = &control_config;
     hpm_serial_nor_host_t *host = (hpm_serial_nor_host_t *)ops;
     uint32_t read_size = 0;
     uint32_t read_start = cmd_seq->addr_phase.addr;
     uint8_t *dst_8 = (uint8_t *) cmd_seq->data_phase.buf;
     uint32_t remaining_len = cmd_seq->data_phase.len;
+    uint32_t tail_len = 0;
+    uint32_t chunk_size;
+    bool use_dma;
+    bool stream;
 
     if ((host == NULL) || (host->host_param.param.host_base == NULL)) {
         return status_invalid_argument;
     }
-    if (!(host->host_param.flags & SERIAL_NOR_HOST_CS_CONTROL_AUTO)) {
+    /*
+     * When the cs is driven by gpio it stays asserted for the whole read and the flash keeps shifting out
+     * sequential data, so only the first transfer sends command/address/dummy, the rest are data only.
+     */
+    stream = !(host->host_param.flags & SERIAL_NOR_HOST_CS_CONTROL_AUTO);
+    if (stream) {
         if (host->host_param.param.set_cs == NULL) {
             return status_fail;
         }
@@ -327,7 +378,8 @@ static hpm_stat_t read(void *ops, hpm_serial_nor_transfer_seq_t *cmd_seq)
     spi_master_get_default_control_config(&control_config);
     hpm_config_cmd_addr_format(ops, cmd_seq, &control_config);
 
-    if ((host->host_param.flags & SERIAL_NOR_HOST_SUPPORT_DMA) && (cmd_seq->use_dma == 1)) {
+    use_dma = (host->host_param.flags & SERIAL_NOR_HOST_SUPPORT_DMA) && (cmd_seq->use_dma == 1);
+    if (use_dma) {
         if (host->host_param.param.dma_control.dma_base == NULL) {
             return status_fail;
         }
@@ -337,33 +389,82 @@ static hpm_stat_t read(void *ops, hpm_serial_nor_transfer_seq_t *cmd_seq)
         control_config.common_config.tx_dma_enable = false;
         control_config.common_config.rx_dma_enable = true;
     }
-    while (remaining_len > 0U) {
-        if (!(host->host_param.flags & SERIAL_NOR_HOST_CS_CONTROL_AUTO)) {
-            host->host_param.param.set_cs(host->host_param.param.pin_or_cs_index, false);
+
+    data_config = control_config;
+    data_config.master_config.cmd_enable = false;
+    data_config.master_config.addr_enable = false;
+    data_config.common_config.dummy_cnt = 0;
+    data_config.common_config.trans_mode = spi_trans_read_only;
+
+    chunk_size = host->host_param.param.transfer_max_size;
+    if (use_dma) {
+        /*
+         * The DMA moves merged words, a partial last word would be written past the buffer end.
+         * Chunks stay word aligned and the last 1..3 bytes are read by the CPU.
+         */
+        chunk_size &= ~3UL;
+        tail_len = remaining_len & 3U;
+        remaining_len -= tail_len;
+    }
+    if (stream) {
+        host->host_param.param.set_cs(host->host_param.param.pin_or_cs_index, false);
+        if (use_dma && (remaining_len > 0U)) {
+            /* one DMA transfer drains the whole read */
+            spi_enable_data_merge((SPI_Type *)host->host_param.param.host_base);
+            stat = spi_nor_rx_trigger_dma((DMA_Type *)host->host_param.param.dma_control.dma_base,
+                                    host->host_param.param.dma_control.rx_dma_ch,
+                                    (SPI_Type *)host->host_param.param.host_base,
+                                    core_local_mem_to_sys_address(BOARD_RUNNING_CORE, (uint32_t)dst_8),
+                                    DMA_TRANSFER_WIDTH_WORD, remaining_len, DMA_NUM_TRANSFER_PER_BURST_1T);
         }
-        read_size = MIN(remaining_len, host->host_param.param.transfer_max_size);
-        if ((host->host_param.flags & SERIAL_NOR_HOST_SUPPORT_DMA) && (cmd_seq->use_dma == 1)) {
+    }
+    if (chunk_size == 0U) {
+        stat = status_invalid_argument;
+    }
+
+    while ((remaining_len > 0U) && (stat == status_success)) {
+        read_size = MIN(remaining_len, chunk_size);
+        if (use_dma && stream) {
+            stat = hpm_spi_read_kick_via_dma(host, config, cmd_seq->cmd_phase.cmd, read_start, read_size);
+        } else if (use_dma) {
             spi_enable_data_merge((SPI_Type *)host->host_param.param.host_base);
-            stat = hpm_spi_transfer_via_dma(host, &control_config, cmd_seq->cmd_phase.cmd, read_start, dst_8, read_size, true);
+            stat = hpm_spi_transfer_via_dma(host, config, cmd_seq->cmd_phase.cmd, read_start, dst_8, read_size, true);
         } else {
-            stat = spi_transfer((SPI_Type *)host->host_param.param.host_base, &control_config, &cmd_seq->cmd_phase.cmd,
+            stat = spi_transfer((SPI_Type *)host->host_param.param.host_base, config, &cmd_seq->cmd_phase.cmd,
                                     &read_start, NULL, 0, dst_8, read_size);
         }
         HPM_BREAK_IF(stat != status_success);
-        if (l1c_dc_is_enabled()) {
-            /* cache invalidate for receive buff */
-            aligned_start = HPM_L1C_CACHELINE_ALIGN_DOWN((uint32_t)dst_8);
-            aligned_end = HPM_L1C_CACHELINE_ALIGN_UP(read_size);
-            aligned_size = aligned_end - aligned_start;
-            l1c_dc_invalidate(aligned_start, aligned_size);
-        }
         read_start += read_size;
         remaining_len -= read_size;
         dst_8 += read_size;
-        if (!(host->host_param.flags & SERIAL_NOR_HOST_CS_CONTROL_AUTO)) {
-            host->host_param.param.set_cs(host->host_param.param.pin_or_cs_index, true);
+        if (stream) {
+            config = &data_config;
+        }
+    }
+    use_dma = use_dma && (dst_8 != (uint8_t *)cmd_seq->data_phase.buf);
+    if (use_dma && stream) {
+        if (stat == status_success) {
+            stat = hpm_spi_read_wait_dma(host);
+        } else {
+            dma_disable_channel((DMA_Type *)host->host_param.param.dma_control.dma_base,
+                                host->host_param.param.dma_control.rx_dma_ch);
         }
     }
+    if (use_dma && l1c_dc_is_enabled()) {
+        /* cache invalidate for receive buff, before the CPU stores the tail */
+        aligned_start = HPM_L1C_CACHELINE_ALIGN_DOWN((uint32_t)cmd_seq->data_phase.buf);
+        aligned_end = HPM_L1C_CACHELINE_ALIGN_UP((uint32_t)dst_8);
+        aligned_size = aligned_end - aligned_start;
+        l1c_dc_invalidate(aligned_start, aligned_size);
+    }
     spi_disable_data_merge((SPI_Type *)host->host_param.param.host_base);
+    if ((tail_len > 0U) && (stat == status_success)) {
+        config->common_config.rx_dma_enable = false;
+        stat = spi_transfer((SPI_Type *)host->host_param.param.host_base, config, &cmd_seq->cmd_phase.cmd,
+                                &read_start, NULL, 0, dst_8, tail_len);
+    }
+    if (stream) {
+        host->host_param.param.set_cs(host->host_param.param.pin_or_cs_index, true);
+    }
     return stat;
 }
@@ -44,10 +44,16 @@
 /* Enable test mode */
 // #define CONFIG_USBDEV_TEST_MODE
 
+/* bytes per storage access, a multiple of the sector size, set it to the optimal transfer size of the storage */
 #ifndef CONFIG_USBDEV_MSC_BLOCK_SIZE
 #define CONFIG_USBDEV_MSC_BLOCK_SIZE 512
 #endif
 
+/* buffers of CONFIG_USBDEV_MSC_BLOCK_SIZE, 2 or more overlap the storage access with the bulk transfer */
+#ifndef CONFIG_USBDEV_MSC_BUFFER_NUM
+#define CONFIG_USBDEV_MSC_BUFFER_NUM 2
+#endif
+
 #ifndef CONFIG_USBDEV_MSC_MANUFACTURER_STRING
 #define CONFIG_USBDEV_MSC_MANUFACTURER_STRING ""
 #endif
@@ -86,8 +92,31 @@
 #define CONFIG_USBDEV_RNDIS_VENDOR_DESC "CherryUSB"
 #endif
 
+/* packet messages the host may put in one bulk out transfer, and the device in one bulk in transfer */
+#ifndef CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER
+#define CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER 4
+#endif
+
+/* transfer buffers, received ones are lent to lwip while another one is free */
+#ifndef CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM
+#define CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM 4
+#endif
+
+#ifndef CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM
+#define CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM 2
+#endif
+
 #define CONFIG_USBDEV_RNDIS_USING_LWIP
 
+/* frame buffers of the cdc ecm data interface */
+#ifndef CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM
+#define CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM 4
+#endif
+
+#ifndef CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM
+#define CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM 4
+#endif
+
 /* ================ USB HOST Stack Configuration ================== */
 
 #define CONFIG_USBHOST_MAX_RHPORTS          1
@@ -147,5 +176,6 @@
 // #define CONFIG_USB_EHCI_HCOR_RESERVED_DISABLE
 // #define CONFIG_USB_EHCI_CONFIGFLAG
 // #define CONFIG_USB_EHCI_PORT_POWER
+// #define CONFIG_USB_EHCI_ISO
 
 #endif
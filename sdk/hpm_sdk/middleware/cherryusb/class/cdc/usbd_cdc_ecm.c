@@ -5,6 +5,9 @@
  */
 #include "usbd_core.h"
 #include "usbd_cdc_ecm.h"
+#ifdef CONFIG_USBDEV_CDC_ECM_USING_LWIP
+#include <lwip/sys.h>
+#endif
 
 #define CDC_ECM_OUT_EP_IDX 0
 #define CDC_ECM_IN_EP_IDX   1
@@ -19,13 +22,44 @@ static struct usbd_endpoint cdc_ecm_ep_data[3];
 #define CDC_ECM_MAX_PACKET_SIZE 64
 #endif
 
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_rx_buffer[CONFIG_CDC_ECM_ETH_MAX_SEGSZE];
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_tx_buffer[CONFIG_CDC_ECM_ETH_MAX_SEGSZE];
+#ifndef CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM
+#define CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM 4
+#endif
+
+#ifndef CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM
+#define CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM 4
+#endif
+
+#if CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM > 31
+#error "rx buffers are tracked in a 32 bit map"
+#endif
+
+/* One ethernet frame per transfer, reads of whole packets */
+#define CDC_ECM_XFER_BUFFER_SIZE ((CONFIG_CDC_ECM_ETH_MAX_SEGSZE + CDC_ECM_MAX_PACKET_SIZE - 1) & ~(CDC_ECM_MAX_PACKET_SIZE - 1))
+
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_rx_buffer[CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM][CDC_ECM_XFER_BUFFER_SIZE];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_tx_buffer[CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM][CDC_ECM_XFER_BUFFER_SIZE];
 USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_notify_buf[16];
 
-volatile uint8_t *g_cdc_ecm_rx_data_buffer = NULL;
-volatile uint32_t g_cdc_ecm_rx_data_length = 0;
-volatile uint32_t g_cdc_ecm_tx_data_length = 0;
+/*
+ * Data path buffers, the same scheme as rndis without aggregation. The usb interrupt fills rx buffers
+ * and queues them in arrival order, the network side lends them to lwip. tx buffers wait for the bus
+ * in order. The network side changes the fields shared with the interrupt with interrupts blocked.
+ */
+static struct usbd_cdc_ecm_xfer {
+    volatile uint32_t rx_free;  /* bitmap of the rx buffers nobody uses */
+    volatile int8_t rx_reading; /* rx buffer the out endpoint fills, -1 when none was free */
+    volatile uint8_t rx_in;     /* next fifo slot for the interrupt */
+    volatile uint8_t rx_out;    /* next fifo slot for the network side */
+    volatile uint8_t rx_count;  /* filled buffers in the fifo */
+    uint8_t rx_fifo[CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM];
+    uint32_t rx_len[CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM];
+
+    volatile uint32_t tx_len[CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM]; /* committed bytes, 0 while free */
+    volatile uint8_t tx_read;   /* tx buffer on the bus, or the next one to go */
+    volatile uint8_t tx_write;  /* next tx buffer to fill */
+    volatile bool tx_busy;      /* the in endpoint is sending */
+} g_cdc_ecm_xfer;
 
 static volatile uint8_t g_current_net_status = 0;
 static volatile uint8_t g_cmd_intf = 0;
@@ -109,17 +143,65 @@ static int cdc_ecm_class_interface_request_handler(struct usb_setup_packet *setu
     return 0;
 }
 
+/* Gives the out endpoint a free rx buffer, from the interrupt or with interrupts blocked */
+static void cdc_ecm_rx_start(void)
+{
+    uint8_t index;
+
+    if (g_cdc_ecm_xfer.rx_free == 0) {
+        /* restarted when lwip returns a buffer */
+        g_cdc_ecm_xfer.rx_reading = -1;
+        return;
+    }
+
+    for (index = 0; (g_cdc_ecm_xfer.rx_free & (1UL << index)) == 0; index++) {
+    }
+    g_cdc_ecm_xfer.rx_free &= ~(1UL << index);
+    g_cdc_ecm_xfer.rx_reading = index;
+    usbd_ep_start_read(cdc_ecm_ep_data[CDC_ECM_OUT_EP_IDX].ep_addr, g_cdc_ecm_rx_buffer[index], CDC_ECM_XFER_BUFFER_SIZE);
+}
+
+static void cdc_ecm_tx_start(void)
+{
+    uint8_t index = g_cdc_ecm_xfer.tx_read;
+
+    g_cdc_ecm_xfer.tx_busy = true;
+    USB_LOG_DBG("txlen:%d\r\n", g_cdc_ecm_xfer.tx_len[index]);
+    usbd_ep_start_write(cdc_ecm_ep_data[CDC_ECM_IN_EP_IDX].ep_addr, g_cdc_ecm_tx_buffer[index], g_cdc_ecm_xfer.tx_len[index]);
+}
+
+static void cdc_ecm_xfer_reset(void)
+{
+    uint8_t index;
+
+    /* the bus reset cancelled the transfers, buffers lent to lwip come back on their own */
+    while (g_cdc_ecm_xfer.rx_count) {
+        g_cdc_ecm_xfer.rx_free |= (1UL << g_cdc_ecm_xfer.rx_fifo[g_cdc_ecm_xfer.rx_out]);
+        g_cdc_ecm_xfer.rx_out = (g_cdc_ecm_xfer.rx_out + 1 == CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM) ? 0 : (g_cdc_ecm_xfer.rx_out + 1);
+        g_cdc_ecm_xfer.rx_count--;
+    }
+    g_cdc_ecm_xfer.rx_in = g_cdc_ecm_xfer.rx_out;
+    if (g_cdc_ecm_xfer.rx_reading >= 0) {
+        g_cdc_ecm_xfer.rx_free |= (1UL << g_cdc_ecm_xfer.rx_reading);
+        g_cdc_ecm_xfer.rx_reading = -1;
+    }
+
+    for (index = 0; index < CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM; index++) {
+        g_cdc_ecm_xfer.tx_len[index] = 0;
+    }
+    g_cdc_ecm_xfer.tx_read = g_cdc_ecm_xfer.tx_write;
+    g_cdc_ecm_xfer.tx_busy = false;
+}
+
 void cdc_ecm_notify_handler(uint8_t event, void *arg)
 {
     switch (event) {
         case USBD_EVENT_RESET:
             g_current_net_status = 0;
-            g_cdc_ecm_rx_data_length = 0;
-            g_cdc_ecm_tx_data_length = 0;
-            g_cdc_ecm_rx_data_buffer = NULL;
             break;
         case USBD_EVENT_CONFIGURED:
-            usbd_ep_start_read(cdc_ecm_ep_data[CDC_ECM_OUT_EP_IDX].ep_addr, &g_cdc_ecm_rx_buffer[g_cdc_ecm_rx_data_length], CDC_ECM_MAX_PACKET_SIZE);
+            cdc_ecm_xfer_reset();
+            cdc_ecm_rx_start();
             break;
 
         default:
@@ -129,23 +211,41 @@ void cdc_ecm_notify_handler(uint8_t event, void *arg)
 
 void cdc_ecm_bulk_out(uint8_t ep, uint32_t nbytes)
 {
-    g_cdc_ecm_rx_data_length += nbytes;
+    uint8_t index = g_cdc_ecm_xfer.rx_reading;
 
-    if (nbytes < CDC_ECM_MAX_PACKET_SIZE) {
-        g_cdc_ecm_rx_data_buffer = g_cdc_ecm_rx_buffer;
-        usbd_cdc_ecm_data_recv_done();
-    } else {
-        usbd_ep_start_read(ep, &g_cdc_ecm_rx_buffer[g_cdc_ecm_rx_data_length], CDC_ECM_MAX_PACKET_SIZE);
+    if (nbytes == 0) {
+        usbd_ep_start_read(ep, g_cdc_ecm_rx_buffer[index], CDC_ECM_XFER_BUFFER_SIZE);
+        return;
     }
+
+    g_cdc_ecm_xfer.rx_len[index] = nbytes;
+    g_cdc_ecm_xfer.rx_fifo[g_cdc_ecm_xfer.rx_in] = index;
+    g_cdc_ecm_xfer.rx_in = (g_cdc_ecm_xfer.rx_in + 1 == CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM) ? 0 : (g_cdc_ecm_xfer.rx_in + 1);
+    g_cdc_ecm_xfer.rx_count++;
+
+    /* keep receiving while the frames are handed to the network */
+    cdc_ecm_rx_start();
+    usbd_cdc_ecm_data_recv_done();
 }
 
 void cdc_ecm_bulk_in(uint8_t ep, uint32_t nbytes)
 {
+    uint8_t index = g_cdc_ecm_xfer.tx_read;
+
     if ((nbytes % CDC_ECM_MAX_PACKET_SIZE) == 0 && nbytes) {
         /* send zlp */
         usbd_ep_start_write(ep, NULL, 0);
+        return;
+    }
+
+    g_cdc_ecm_xfer.tx_len[index] = 0;
+    index = (index + 1 == CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM) ? 0 : (index + 1);
+    g_cdc_ecm_xfer.tx_read = index;
+
+    if (g_cdc_ecm_xfer.tx_len[index]) {
+        cdc_ecm_tx_start();
     } else {
-        g_cdc_ecm_tx_data_length = 0;
+        g_cdc_ecm_xfer.tx_busy = false;
     }
 }
 
@@ -158,51 +258,105 @@ void cdc_ecm_int_in(uint8_t ep, uint32_t nbytes)
 }
 
 #ifdef CONFIG_USBDEV_CDC_ECM_USING_LWIP
+#if LWIP_SUPPORT_CUSTOM_PBUF
+struct usbd_cdc_ecm_rx_pbuf {
+    struct pbuf_custom custom;
+    uint8_t index;
+};
+
+static struct usbd_cdc_ecm_rx_pbuf g_cdc_ecm_rx_pbuf[CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM];
+#endif
+
+/* Called with interrupts blocked */
+static void cdc_ecm_rx_release(uint8_t index)
+{
+    g_cdc_ecm_xfer.rx_free |= (1UL << index);
+    if (g_cdc_ecm_xfer.rx_reading < 0) {
+        cdc_ecm_rx_start();
+    }
+}
+
+#if LWIP_SUPPORT_CUSTOM_PBUF
+static void cdc_ecm_rx_pbuf_free(struct pbuf *p)
+{
+    struct usbd_cdc_ecm_rx_pbuf *rx_pbuf = (struct usbd_cdc_ecm_rx_pbuf *)p;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    cdc_ecm_rx_release(rx_pbuf->index);
+    SYS_ARCH_UNPROTECT(lev);
+}
+#endif
+
 struct pbuf *usbd_cdc_ecm_eth_rx(void)
 {
     struct pbuf *p;
+    uint8_t index;
+    bool lend;
+    SYS_ARCH_DECL_PROTECT(lev);
 
-    if (g_cdc_ecm_rx_data_buffer == NULL) {
+    SYS_ARCH_PROTECT(lev);
+    if (g_cdc_ecm_xfer.rx_count == 0) {
+        SYS_ARCH_UNPROTECT(lev);
         return NULL;
     }
-    p = pbuf_alloc(PBUF_RAW, g_cdc_ecm_rx_data_length, PBUF_POOL);
-    if (p == NULL) {
-        return NULL;
+    index = g_cdc_ecm_xfer.rx_fifo[g_cdc_ecm_xfer.rx_out];
+    g_cdc_ecm_xfer.rx_out = (g_cdc_ecm_xfer.rx_out + 1 == CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM) ? 0 : (g_cdc_ecm_xfer.rx_out + 1);
+    g_cdc_ecm_xfer.rx_count--;
+    /* lend the buffer only while another one is left for the out endpoint, copy otherwise */
+    lend = (g_cdc_ecm_xfer.rx_free != 0);
+    SYS_ARCH_UNPROTECT(lev);
+
+    USB_LOG_DBG("rxlen:%d\r\n", g_cdc_ecm_xfer.rx_len[index]);
+
+#if LWIP_SUPPORT_CUSTOM_PBUF
+    if (lend) {
+        struct usbd_cdc_ecm_rx_pbuf *rx_pbuf = &g_cdc_ecm_rx_pbuf[index];
+
+        rx_pbuf->index = index;
+        rx_pbuf->custom.custom_free_function = cdc_ecm_rx_pbuf_free;
+        return pbuf_alloced_custom(PBUF_RAW, g_cdc_ecm_xfer.rx_len[index], PBUF_REF, &rx_pbuf->custom,
+                                   g_cdc_ecm_rx_buffer[index], g_cdc_ecm_xfer.rx_len[index]);
+    }
+#else
+    (void)lend;
+#endif
+
+    p = pbuf_alloc(PBUF_RAW, g_cdc_ecm_xfer.rx_len[index], PBUF_POOL);
+    if (p != NULL) {
+        pbuf_take(p, g_cdc_ecm_rx_buffer[index], g_cdc_ecm_xfer.rx_len[index]);
     }
-    memcpy(p->payload, (uint8_t *)g_cdc_ecm_rx_buffer, g_cdc_ecm_rx_data_length);
-    p->len = g_cdc_ecm_rx_data_length;
 
-    USB_LOG_DBG("rxlen:%d\r\n", g_cdc_ecm_rx_data_length);
-    g_cdc_ecm_rx_data_length = 0;
-    g_cdc_ecm_rx_data_buffer = NULL;
-    usbd_ep_start_read(cdc_ecm_ep_data[CDC_ECM_OUT_EP_IDX].ep_addr, g_cdc_ecm_rx_buffer, CDC_ECM_MAX_PACKET_SIZE);
+    SYS_ARCH_PROTECT(lev);
+    cdc_ecm_rx_release(index);
+    SYS_ARCH_UNPROTECT(lev);
 
     return p;
 }
 
 int usbd_cdc_ecm_eth_tx(struct pbuf *p)
 {
-    struct pbuf *q;
-    uint8_t *buffer;
+    uint8_t index = g_cdc_ecm_xfer.tx_write;
+    uint32_t len;
+    SYS_ARCH_DECL_PROTECT(lev);
 
-    if (g_cdc_ecm_tx_data_length > 0) {
+    /* only the interrupt frees a buffer, a free one stays free */
+    if (g_cdc_ecm_xfer.tx_len[index]) {
         return -EBUSY;
     }
 
-    if (p->tot_len > sizeof(g_cdc_ecm_tx_buffer)) {
-        p->tot_len = sizeof(g_cdc_ecm_tx_buffer);
-    }
+    len = MIN(p->tot_len, CONFIG_CDC_ECM_ETH_MAX_SEGSZE);
+    pbuf_copy_partial(p, g_cdc_ecm_tx_buffer[index], len, 0);
 
-    buffer = g_cdc_ecm_tx_buffer;
-    for (q = p; q != NULL; q = q->next) {
-        memcpy(buffer, q->payload, q->len);
-        buffer += q->len;
+    SYS_ARCH_PROTECT(lev);
+    g_cdc_ecm_xfer.tx_len[index] = len;
+    g_cdc_ecm_xfer.tx_write = (index + 1 == CONFIG_USBDEV_CDC_ECM_TX_BUFFER_NUM) ? 0 : (index + 1);
+    if (!g_cdc_ecm_xfer.tx_busy) {
+        cdc_ecm_tx_start();
     }
+    SYS_ARCH_UNPROTECT(lev);
 
-    g_cdc_ecm_tx_data_length = p->tot_len;
-
-    USB_LOG_DBG("txlen:%d\r\n", g_cdc_ecm_tx_data_length);
-    return usbd_ep_start_write(cdc_ecm_ep_data[CDC_ECM_IN_EP_IDX].ep_addr, g_cdc_ecm_tx_buffer, g_cdc_ecm_tx_data_length);
+    return 0;
 }
 #endif
 
@@ -213,6 +367,9 @@ struct usbd_interface *usbd_cdc_ecm_init_intf(struct usbd_interface *intf, const
     intf->vendor_handler = NULL;
     intf->notify_handler = cdc_ecm_notify_handler;
 
+    g_cdc_ecm_xfer.rx_free = (1UL << CONFIG_USBDEV_CDC_ECM_RX_BUFFER_NUM) - 1;
+    g_cdc_ecm_xfer.rx_reading = -1;
+
     cdc_ecm_ep_data[CDC_ECM_OUT_EP_IDX].ep_addr = out_ep;
     cdc_ecm_ep_data[CDC_ECM_OUT_EP_IDX].ep_cb = cdc_ecm_bulk_out;
     cdc_ecm_ep_data[CDC_ECM_IN_EP_IDX].ep_addr = in_ep;
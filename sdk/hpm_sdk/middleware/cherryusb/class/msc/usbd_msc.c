@@ -13,6 +13,10 @@
 #define MSD_OUT_EP_IDX 0
 #define MSD_IN_EP_IDX  1
 
+#ifndef CONFIG_USBDEV_MSC_BUFFER_NUM
+#define CONFIG_USBDEV_MSC_BUFFER_NUM 2
+#endif
+
 /* Describe EndPoints configuration */
 static struct usbd_endpoint mass_ep_data[2];
 
@@ -38,24 +42,81 @@ USB_NOCACHE_RAM_SECTION struct usbd_msc_priv {
     uint8_t ASC;  /* Additional Sense Code */
     uint8_t ASQ;  /* Additional Sense Qualifier */
     uint8_t max_lun;
-    uint32_t start_sector;
-    uint32_t nsectors;
+    uint32_t start_sector; /* next sector of the storage access */
+    uint32_t nsectors;     /* sectors left to read from / write to the storage */
+    uint32_t usb_nsectors; /* sectors left to receive from the host */
     uint16_t scsi_blk_size;
     uint32_t scsi_blk_nbr;
 
-    USB_MEM_ALIGNX uint8_t block_buffer[CONFIG_USBDEV_MSC_BLOCK_SIZE];
+    /* buffer ring shared by the storage access and the bulk transfer, from buf_head to buf_tail */
+    uint8_t buf_head;
+    uint8_t buf_tail;
+    uint8_t buf_count;
+    bool ep_busy;
+    bool xfer_failed;
+    uint32_t buf_len[CONFIG_USBDEV_MSC_BUFFER_NUM];
+    USB_MEM_ALIGNX uint8_t block_buffer[CONFIG_USBDEV_MSC_BUFFER_NUM][CONFIG_USBDEV_MSC_BLOCK_SIZE];
 
 #if defined(CONFIG_USBDEV_MSC_THREAD)
     usb_osal_mq_t usbd_msc_mq;
     usb_osal_thread_t usbd_msc_thread;
-    uint32_t nbytes;
 #endif
 } g_usbd_msc;
 
+/* The ring is only shared with a thread, without it everything runs in the usb interrupt */
+static inline size_t usbd_msc_lock(void)
+{
+#if defined(CONFIG_USBDEV_MSC_THREAD)
+    return usb_osal_enter_critical_section();
+#else
+    return 0;
+#endif
+}
+
+static inline void usbd_msc_unlock(size_t flags)
+{
+#if defined(CONFIG_USBDEV_MSC_THREAD)
+    usb_osal_leave_critical_section(flags);
+#else
+    (void)flags;
+#endif
+}
+
+static inline uint32_t usbd_msc_buf_nsectors(uint32_t nsectors)
+{
+    return MIN(nsectors, CONFIG_USBDEV_MSC_BLOCK_SIZE / g_usbd_msc.scsi_blk_size);
+}
+
+/*
+ * Without the thread the storage is read in the usb interrupt, which also delays the completion of
+ * the buffer on the bus, so only one buffer is read ahead. Deeper rings absorb storage latency jitter
+ * when the thread does the storage access.
+ */
+#if defined(CONFIG_USBDEV_MSC_THREAD)
+#define MSC_READ_AHEAD_NUM CONFIG_USBDEV_MSC_BUFFER_NUM
+#else
+#define MSC_READ_AHEAD_NUM MIN(CONFIG_USBDEV_MSC_BUFFER_NUM, 2)
+#endif
+
+static inline uint8_t usbd_msc_buf_next(uint8_t idx)
+{
+    return (idx + 1 == CONFIG_USBDEV_MSC_BUFFER_NUM) ? 0 : (idx + 1);
+}
+
+static void usbd_msc_buf_reset(void)
+{
+    g_usbd_msc.buf_head = 0;
+    g_usbd_msc.buf_tail = 0;
+    g_usbd_msc.buf_count = 0;
+    g_usbd_msc.ep_busy = false;
+    g_usbd_msc.xfer_failed = false;
+}
+
 static void usbd_msc_reset(void)
 {
     g_usbd_msc.stage = MSC_READ_CBW;
     g_usbd_msc.readonly = false;
+    usbd_msc_buf_reset();
 }
 
 static int msc_storage_class_interface_request_handler(struct usb_setup_packet *setup, uint8_t **data, uint32_t *len)
@@ -136,8 +197,9 @@ static void usbd_msc_send_info(uint8_t *buffer, uint8_t size)
     g_usbd_msc.csw.bStatus = CSW_STATUS_CMD_PASSED;
 }
 
-static bool SCSI_processWrite(uint32_t nbytes);
+static bool SCSI_processWrite(void);
 static bool SCSI_processRead(void);
+static void usbd_msc_start_data_out(void);
 
 /**
 * @brief  SCSI_SetSenseData
@@ -490,6 +552,7 @@ static bool SCSI_read10(uint8_t **data, uint32_t *len)
         return false;
     }
     g_usbd_msc.stage = MSC_DATA_IN;
+    usbd_msc_buf_reset();
 #ifdef CONFIG_USBDEV_MSC_THREAD
     usb_osal_mq_send(g_usbd_msc.usbd_msc_mq, MSC_DATA_IN);
     return true;
@@ -522,6 +585,7 @@ static bool SCSI_read12(uint8_t **data, uint32_t *len)
         return false;
     }
     g_usbd_msc.stage = MSC_DATA_IN;
+    usbd_msc_buf_reset();
 #ifdef CONFIG_USBDEV_MSC_THREAD
     usb_osal_mq_send(g_usbd_msc.usbd_msc_mq, MSC_DATA_IN);
     return true;
@@ -554,8 +618,9 @@ static bool SCSI_write10(uint8_t **data, uint32_t *len)
         return false;
     }
     g_usbd_msc.stage = MSC_DATA_OUT;
-    data_len = MIN(data_len, CONFIG_USBDEV_MSC_BLOCK_SIZE);
-    usbd_ep_start_read(mass_ep_data[MSD_OUT_EP_IDX].ep_addr, g_usbd_msc.block_buffer, data_len);
+    g_usbd_msc.usb_nsectors = g_usbd_msc.nsectors;
+    usbd_msc_buf_reset();
+    usbd_msc_start_data_out();
     return true;
 }
 
@@ -583,8 +648,9 @@ static bool SCSI_write12(uint8_t **data, uint32_t *len)
         return false;
     }
     g_usbd_msc.stage = MSC_DATA_OUT;
-    data_len = MIN(data_len, CONFIG_USBDEV_MSC_BLOCK_SIZE);
-    usbd_ep_start_read(mass_ep_data[MSD_OUT_EP_IDX].ep_addr, g_usbd_msc.block_buffer, data_len);
+    g_usbd_msc.usb_nsectors = g_usbd_msc.nsectors;
+    usbd_msc_buf_reset();
+    usbd_msc_start_data_out();
     return true;
 }
 /* do not use verify to reduce code size */
@@ -634,51 +700,131 @@ static bool SCSI_verify10(uint8_t **data, uint32_t *len)
 }
 #endif
 
-static bool SCSI_processRead(void)
+/* Send the oldest filled buffer if the IN endpoint is idle, called with the ring locked */
+static void usbd_msc_start_data_in(void)
 {
-    uint32_t transfer_len;
-
-    USB_LOG_DBG("read lba:%d\r\n", g_usbd_msc.start_sector);
+    if (!g_usbd_msc.ep_busy && (g_usbd_msc.buf_count > 0)) {
+        g_usbd_msc.ep_busy = true;
+        usbd_ep_start_write(mass_ep_data[MSD_IN_EP_IDX].ep_addr, g_usbd_msc.block_buffer[g_usbd_msc.buf_head],
+                            g_usbd_msc.buf_len[g_usbd_msc.buf_head]);
+    }
+}
 
-    transfer_len = MIN(g_usbd_msc.nsectors * g_usbd_msc.scsi_blk_size, CONFIG_USBDEV_MSC_BLOCK_SIZE);
+/* Receive into the next free buffer if the OUT endpoint is idle, called with the ring locked */
+static void usbd_msc_start_data_out(void)
+{
+    uint32_t transfer_len;
 
-    if (usbd_msc_sector_read(g_usbd_msc.start_sector, g_usbd_msc.block_buffer, transfer_len) != 0) {
-        SCSI_SetSenseData(SCSI_KCQHE_UREINRESERVEDAREA);
-        return false;
+    if (!g_usbd_msc.ep_busy && !g_usbd_msc.xfer_failed && (g_usbd_msc.usb_nsectors > 0) &&
+        (g_usbd_msc.buf_count < CONFIG_USBDEV_MSC_BUFFER_NUM)) {
+        transfer_len = usbd_msc_buf_nsectors(g_usbd_msc.usb_nsectors) * g_usbd_msc.scsi_blk_size;
+        g_usbd_msc.ep_busy = true;
+        usbd_ep_start_read(mass_ep_data[MSD_OUT_EP_IDX].ep_addr, g_usbd_msc.block_buffer[g_usbd_msc.buf_tail], transfer_len);
     }
+}
 
-    usbd_ep_start_write(mass_ep_data[MSD_IN_EP_IDX].ep_addr, g_usbd_msc.block_buffer, transfer_len);
+/*
+ * Fill every free buffer from the storage, each filled buffer is handed to the IN endpoint at once
+ * so that the storage reads the next sectors while the previous ones are on the bus.
+ * Returns false only when the command has to fail right now, a failure with buffers still
+ * in flight is reported by mass_storage_bulk_in once they are sent.
+ */
+static bool SCSI_processRead(void)
+{
+    uint32_t nsectors;
+    uint32_t transfer_len;
+    uint8_t *buf;
+    size_t flags;
+    bool idle;
 
-    g_usbd_msc.start_sector += (transfer_len / g_usbd_msc.scsi_blk_size);
-    g_usbd_msc.nsectors -= (transfer_len / g_usbd_msc.scsi_blk_size);
-    g_usbd_msc.csw.dDataResidue -= transfer_len;
+    while (1) {
+        flags = usbd_msc_lock();
+        /* the thread may see an event left from a previous command */
+        if ((g_usbd_msc.stage != MSC_DATA_IN) || (g_usbd_msc.nsectors == 0) ||
+            (g_usbd_msc.buf_count >= MSC_READ_AHEAD_NUM)) {
+            usbd_msc_unlock(flags);
+            break;
+        }
+        usbd_msc_unlock(flags);
+
+        USB_LOG_DBG("read lba:%d\r\n", g_usbd_msc.start_sector);
+
+        /* buf_tail only moves here, the buffer is not owned by the endpoint */
+        buf = g_usbd_msc.block_buffer[g_usbd_msc.buf_tail];
+        nsectors = usbd_msc_buf_nsectors(g_usbd_msc.nsectors);
+        transfer_len = nsectors * g_usbd_msc.scsi_blk_size;
+
+        if (usbd_msc_sector_read(g_usbd_msc.start_sector, buf, transfer_len) != 0) {
+            SCSI_SetSenseData(SCSI_KCQHE_UREINRESERVEDAREA);
+            flags = usbd_msc_lock();
+            g_usbd_msc.xfer_failed = true;
+            idle = (g_usbd_msc.buf_count == 0);
+            usbd_msc_unlock(flags);
+            return !idle;
+        }
 
-    if (g_usbd_msc.nsectors == 0) {
-        g_usbd_msc.stage = MSC_SEND_CSW;
+        flags = usbd_msc_lock();
+        g_usbd_msc.start_sector += nsectors;
+        g_usbd_msc.nsectors -= nsectors;
+        g_usbd_msc.buf_len[g_usbd_msc.buf_tail] = transfer_len;
+        g_usbd_msc.buf_tail = usbd_msc_buf_next(g_usbd_msc.buf_tail);
+        g_usbd_msc.buf_count++;
+        usbd_msc_start_data_in();
+        usbd_msc_unlock(flags);
     }
 
     return true;
 }
 
-static bool SCSI_processWrite(uint32_t nbytes)
+/*
+ * Write every received buffer to the storage, the OUT endpoint keeps receiving into
+ * the buffers released here. Same return convention as SCSI_processRead.
+ */
+static bool SCSI_processWrite(void)
 {
-    uint32_t data_len = 0;
-    USB_LOG_DBG("write lba:%d\r\n", g_usbd_msc.start_sector);
-
-    if (usbd_msc_sector_write(g_usbd_msc.start_sector, g_usbd_msc.block_buffer, nbytes) != 0) {
-        SCSI_SetSenseData(SCSI_KCQHE_WRITEFAULT);
-        return false;
-    }
+    uint32_t nsectors;
+    uint32_t transfer_len;
+    uint8_t *buf;
+    size_t flags;
+    bool done;
+    bool busy;
 
-    g_usbd_msc.start_sector += (nbytes / g_usbd_msc.scsi_blk_size);
-    g_usbd_msc.nsectors -= (nbytes / g_usbd_msc.scsi_blk_size);
-    g_usbd_msc.csw.dDataResidue -= nbytes;
+    while (1) {
+        flags = usbd_msc_lock();
+        if ((g_usbd_msc.stage != MSC_DATA_OUT) || (g_usbd_msc.buf_count == 0) || g_usbd_msc.xfer_failed) {
+            usbd_msc_unlock(flags);
+            break;
+        }
+        buf = g_usbd_msc.block_buffer[g_usbd_msc.buf_head];
+        transfer_len = g_usbd_msc.buf_len[g_usbd_msc.buf_head];
+        usbd_msc_unlock(flags);
+
+        USB_LOG_DBG("write lba:%d\r\n", g_usbd_msc.start_sector);
+
+        nsectors = transfer_len / g_usbd_msc.scsi_blk_size;
+        if ((nsectors == 0) || (usbd_msc_sector_write(g_usbd_msc.start_sector, buf, transfer_len) != 0)) {
+            SCSI_SetSenseData(SCSI_KCQHE_WRITEFAULT);
+            flags = usbd_msc_lock();
+            g_usbd_msc.xfer_failed = true;
+            busy = g_usbd_msc.ep_busy;
+            usbd_msc_unlock(flags);
+            return busy;
+        }
 
-    if (g_usbd_msc.nsectors == 0) {
-        usbd_msc_send_csw(CSW_STATUS_CMD_PASSED);
-    } else {
-        data_len = MIN(g_usbd_msc.nsectors * g_usbd_msc.scsi_blk_size, CONFIG_USBDEV_MSC_BLOCK_SIZE);
-        usbd_ep_start_read(mass_ep_data[MSD_OUT_EP_IDX].ep_addr, g_usbd_msc.block_buffer, data_len);
+        flags = usbd_msc_lock();
+        g_usbd_msc.start_sector += nsectors;
+        g_usbd_msc.nsectors -= MIN(nsectors, g_usbd_msc.nsectors);
+        g_usbd_msc.csw.dDataResidue -= transfer_len;
+        g_usbd_msc.buf_head = usbd_msc_buf_next(g_usbd_msc.buf_head);
+        g_usbd_msc.buf_count--;
+        usbd_msc_start_data_out();
+        done = (g_usbd_msc.nsectors == 0);
+        usbd_msc_unlock(flags);
+
+        if (done) {
+            usbd_msc_send_csw(CSW_STATUS_CMD_PASSED);
+            break;
+        }
     }
 
     return true;
@@ -686,7 +832,7 @@ static bool SCSI_processWrite(uint32_t nbytes)
 
 static bool SCSI_CBWDecode(uint32_t nbytes)
 {
-    uint8_t *buf2send = g_usbd_msc.block_buffer;
+    uint8_t *buf2send = g_usbd_msc.block_buffer[0];
     uint32_t len2send = 0;
     bool ret = false;
 
@@ -769,6 +915,72 @@ static bool SCSI_CBWDecode(uint32_t nbytes)
     return ret;
 }
 
+static void usbd_msc_data_out_done(uint32_t nbytes)
+{
+    uint32_t nsectors = nbytes / g_usbd_msc.scsi_blk_size;
+    size_t flags;
+    bool failed;
+
+    flags = usbd_msc_lock();
+    g_usbd_msc.ep_busy = false;
+    failed = g_usbd_msc.xfer_failed;
+    if (!failed) {
+        g_usbd_msc.usb_nsectors -= MIN(nsectors, g_usbd_msc.usb_nsectors);
+        g_usbd_msc.buf_len[g_usbd_msc.buf_tail] = nbytes;
+        g_usbd_msc.buf_tail = usbd_msc_buf_next(g_usbd_msc.buf_tail);
+        g_usbd_msc.buf_count++;
+        /* receive the next buffer while this one is written to the storage */
+        usbd_msc_start_data_out();
+    }
+    usbd_msc_unlock(flags);
+
+    if (failed) {
+        /* the storage failed while this buffer was on the bus */
+        usbd_msc_send_csw(CSW_STATUS_CMD_FAILED);
+        return;
+    }
+#ifdef CONFIG_USBDEV_MSC_THREAD
+    usb_osal_mq_send(g_usbd_msc.usbd_msc_mq, MSC_DATA_OUT);
+#else
+    if (SCSI_processWrite() == false) {
+        usbd_msc_send_csw(CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
+    }
+#endif
+}
+
+static void usbd_msc_data_in_done(uint32_t nbytes)
+{
+    size_t flags;
+    bool done;
+    bool fill;
+
+    flags = usbd_msc_lock();
+    g_usbd_msc.ep_busy = false;
+    g_usbd_msc.csw.dDataResidue -= g_usbd_msc.buf_len[g_usbd_msc.buf_head];
+    g_usbd_msc.buf_head = usbd_msc_buf_next(g_usbd_msc.buf_head);
+    g_usbd_msc.buf_count--;
+    /* send the next buffer before refilling this one */
+    usbd_msc_start_data_in();
+    done = (g_usbd_msc.buf_count == 0) && ((g_usbd_msc.nsectors == 0) || g_usbd_msc.xfer_failed);
+    fill = (g_usbd_msc.nsectors > 0) && !g_usbd_msc.xfer_failed;
+    usbd_msc_unlock(flags);
+
+    if (done) {
+        usbd_msc_send_csw(g_usbd_msc.xfer_failed ? CSW_STATUS_CMD_FAILED : CSW_STATUS_CMD_PASSED);
+        return;
+    }
+    if (!fill) {
+        return;
+    }
+#ifdef CONFIG_USBDEV_MSC_THREAD
+    usb_osal_mq_send(g_usbd_msc.usbd_msc_mq, MSC_DATA_IN);
+#else
+    if (SCSI_processRead() == false) {
+        usbd_msc_send_csw(CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
+    }
+#endif
+}
+
 void mass_storage_bulk_out(uint8_t ep, uint32_t nbytes)
 {
     switch (g_usbd_msc.stage) {
@@ -783,14 +995,7 @@ void mass_storage_bulk_out(uint8_t ep, uint32_t nbytes)
             switch (g_usbd_msc.cbw.CB[0]) {
                 case SCSI_CMD_WRITE10:
                 case SCSI_CMD_WRITE12:
-#ifdef CONFIG_USBDEV_MSC_THREAD
-                    g_usbd_msc.nbytes = nbytes;
-                    usb_osal_mq_send(g_usbd_msc.usbd_msc_mq, MSC_DATA_OUT);
-#else
-                    if (SCSI_processWrite(nbytes) == false) {
-                        usbd_msc_send_csw(CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
-                    }
-#endif
+                    usbd_msc_data_out_done(nbytes);
                     break;
                 default:
                     break;
@@ -808,14 +1013,7 @@ void mass_storage_bulk_in(uint8_t ep, uint32_t nbytes)
             switch (g_usbd_msc.cbw.CB[0]) {
                 case SCSI_CMD_READ10:
                 case SCSI_CMD_READ12:
-#ifdef CONFIG_USBDEV_MSC_THREAD
-                    usb_osal_mq_send(g_usbd_msc.usbd_msc_mq, MSC_DATA_IN);
-#else
-                    if (SCSI_processRead() == false) {
-                        usbd_msc_send_csw(CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
-                        return;
-                    }
-#endif
+                    usbd_msc_data_in_done(nbytes);
                     break;
                 default:
                     break;
@@ -850,11 +1048,12 @@ static void usbdev_msc_thread(void *argument)
             continue;
         }
         USB_LOG_DBG("%d\r\n", event);
-        if (event == MSC_DATA_OUT) {
-            if (SCSI_processWrite(g_usbd_msc.nbytes) == false) {
+        /* an event can be left from the previous command or dropped on a full queue, the stage tells what is pending */
+        if (g_usbd_msc.stage == MSC_DATA_OUT) {
+            if (SCSI_processWrite() == false) {
                 usbd_msc_send_csw(CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
             }
-        } else if (event == MSC_DATA_IN) {
+        } else if (g_usbd_msc.stage == MSC_DATA_IN) {
             if (SCSI_processRead() == false) {
                 usbd_msc_send_csw(CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
             }
@@ -889,7 +1088,7 @@ struct usbd_interface *usbd_msc_init_intf(struct usbd_interface *intf, const uin
     }
 
 #ifdef CONFIG_USBDEV_MSC_THREAD
-    g_usbd_msc.usbd_msc_mq = usb_osal_mq_create(1);
+    g_usbd_msc.usbd_msc_mq = usb_osal_mq_create(CONFIG_USBDEV_MSC_BUFFER_NUM);
     if (g_usbd_msc.usbd_msc_mq == NULL) {
         return NULL;
     }
@@ -6,6 +6,10 @@
 #include "usbd_core.h"
 #include "usbd_rndis.h"
 #include "rndis_protocol.h"
+#ifdef CONFIG_USBDEV_RNDIS_USING_LWIP
+#include <lwip/pbuf.h>
+#include <lwip/sys.h>
+#endif
 
 #define RNDIS_OUT_EP_IDX 0
 #define RNDIS_IN_EP_IDX  1
@@ -45,15 +49,63 @@ struct usbd_rndis_priv {
 #define CONFIG_USBDEV_RNDIS_RESP_BUFFER_SIZE 156
 #endif
 
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_rx_buffer[CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE + 44];
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_tx_buffer[CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE + 44];
+#ifndef CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER
+#define CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER 4
+#endif
+
+#ifndef CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM
+#define CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM 4
+#endif
+
+#ifndef CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM
+#define CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM 2
+#endif
+
+#if CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM > 31
+#error "rx buffers are tracked in a 32 bit map"
+#endif
+
+/* One REMOTE_NDIS_PACKET_MSG, the messages of a transfer start on 4 byte boundaries */
+#define RNDIS_PACKET_MSG_SIZE(len) ((sizeof(rndis_data_packet_t) + (len) + 3) & ~3)
+#define RNDIS_XFER_BUFFER_SIZE                                                                                          \
+    ((CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER * RNDIS_PACKET_MSG_SIZE(CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE) + \
+      RNDIS_MAX_PACKET_SIZE - 1) &                                                                                      \
+     ~(RNDIS_MAX_PACKET_SIZE - 1))
+
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_rx_buffer[CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM][RNDIS_XFER_BUFFER_SIZE];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_tx_buffer[CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM][RNDIS_XFER_BUFFER_SIZE];
 
 USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t rndis_encapsulated_resp_buffer[CONFIG_USBDEV_RNDIS_RESP_BUFFER_SIZE];
 USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t NOTIFY_RESPONSE_AVAILABLE[8];
 
-volatile uint8_t *g_rndis_rx_data_buffer;
-volatile uint32_t g_rndis_rx_data_length;
-volatile uint32_t g_rndis_tx_data_length;
+/*
+ * Data path buffers. The usb interrupt fills rx buffers and queues them in arrival order, the network
+ * side parses them and lends them to lwip. tx buffers collect packets while an earlier one is on the bus.
+ * The network side changes the fields shared with the interrupt with interrupts blocked.
+ */
+static struct usbd_rndis_xfer {
+    volatile uint32_t rx_free;   /* bitmap of the rx buffers nobody uses */
+    volatile int8_t rx_reading;  /* rx buffer the out endpoint fills, -1 when none was free */
+    volatile uint8_t rx_in;      /* next fifo slot for the interrupt */
+    volatile uint8_t rx_out;     /* next fifo slot for the network side */
+    volatile uint8_t rx_count;   /* filled buffers in the fifo */
+    uint8_t rx_fifo[CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM];
+    uint32_t rx_len[CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM];
+    uint8_t rx_ref[CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM]; /* parser and lent pbufs */
+    int8_t rx_parse;             /* rx buffer being parsed, -1 for none */
+    uint8_t rx_packets;          /* packets taken from rx_parse */
+    bool rx_lend;                /* rx_parse is lent to lwip rather than copied */
+    uint32_t rx_offset;          /* next message in rx_parse */
+
+    volatile uint32_t tx_len[CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM]; /* committed bytes, 0 while free or filling */
+    volatile uint8_t tx_read;    /* tx buffer on the bus, or the next one to go */
+    volatile uint8_t tx_write;   /* tx buffer collecting packets */
+    volatile uint32_t tx_fill;   /* bytes in tx_write */
+    volatile uint8_t tx_packets; /* packets in tx_write */
+    volatile bool tx_busy;       /* the in endpoint is sending */
+    volatile bool tx_writing;    /* a packet is being copied into tx_write */
+    uint32_t tx_max_size;        /* largest transfer the host accepts */
+} g_rndis_xfer;
 
 /* RNDIS options list */
 const uint32_t oid_supported_list[] = {
@@ -169,14 +221,20 @@ static int rndis_init_cmd_handler(uint8_t *data, uint32_t len)
     resp->Status = RNDIS_STATUS_SUCCESS;
     resp->DeviceFlags = RNDIS_DF_CONNECTIONLESS;
     resp->Medium = RNDIS_MEDIUM_802_3;
-    resp->MaxPacketsPerTransfer = 1;
-    resp->MaxTransferSize = CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE + sizeof(rndis_data_packet_t);
-    resp->PacketAlignmentFactor = 0;
+    resp->MaxPacketsPerTransfer = CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER;
+    resp->MaxTransferSize = RNDIS_XFER_BUFFER_SIZE;
+    resp->PacketAlignmentFactor = 2; /* 4 bytes */
     resp->AfListOffset = 0;
     resp->AfListSize = 0;
 
     g_usbd_rndis.init_state = rndis_initialized;
 
+    /* device to host aggregation is limited by the host */
+    g_rndis_xfer.tx_max_size = MIN(cmd->MaxTransferSize, RNDIS_XFER_BUFFER_SIZE);
+    if (g_rndis_xfer.tx_max_size < RNDIS_PACKET_MSG_SIZE(CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE)) {
+        g_rndis_xfer.tx_max_size = RNDIS_PACKET_MSG_SIZE(CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE);
+    }
+
     rndis_notify_rsp();
     return 0;
 }
@@ -353,6 +411,7 @@ static int rndis_set_cmd_handler(uint8_t *data, uint32_t len)
             USB_LOG_WRN("RNDIS cfg param: NameOfs=%d, NameLen=%d, ValueOfs=%d, ValueLen=%d\r\n",
                         param->ParameterNameOffset, param->ParameterNameLength,
                         param->ParameterValueOffset, param->ParameterValueLength);
+            (void)param;
             break;
         case OID_GEN_CURRENT_PACKET_FILTER:
             if (cmd->InformationBufferLength < sizeof(g_usbd_rndis.net_filter)) {
@@ -426,6 +485,72 @@ static int rndis_keepalive_cmd_handler(uint8_t *data, uint32_t len)
     return 0;
 }
 
+/* Gives the out endpoint a free rx buffer, from the interrupt or with interrupts blocked */
+static void rndis_rx_start(void)
+{
+    uint8_t index;
+
+    if (g_rndis_xfer.rx_free == 0) {
+        /* restarted when lwip returns a buffer */
+        g_rndis_xfer.rx_reading = -1;
+        return;
+    }
+
+    for (index = 0; (g_rndis_xfer.rx_free & (1UL << index)) == 0; index++) {
+    }
+    g_rndis_xfer.rx_free &= ~(1UL << index);
+    g_rndis_xfer.rx_reading = index;
+    usbd_ep_start_read(rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr, g_rndis_rx_buffer[index], RNDIS_XFER_BUFFER_SIZE);
+}
+
+/* Transfers committed to the in endpoint go out in order, from the interrupt or with interrupts blocked */
+static void rndis_tx_commit(void)
+{
+    uint8_t index = g_rndis_xfer.tx_write;
+
+    g_usbd_rndis.eth_state.txok += g_rndis_xfer.tx_packets;
+    g_rndis_xfer.tx_len[index] = g_rndis_xfer.tx_fill;
+    g_rndis_xfer.tx_write = (index + 1 == CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM) ? 0 : (index + 1);
+    g_rndis_xfer.tx_fill = 0;
+    g_rndis_xfer.tx_packets = 0;
+}
+
+static void rndis_tx_start(void)
+{
+    uint8_t index = g_rndis_xfer.tx_read;
+
+    g_rndis_xfer.tx_busy = true;
+    USB_LOG_DBG("txlen:%d\r\n", g_rndis_xfer.tx_len[index]);
+    usbd_ep_start_write(rndis_ep_data[RNDIS_IN_EP_IDX].ep_addr, g_rndis_tx_buffer[index], g_rndis_xfer.tx_len[index]);
+}
+
+static void rndis_xfer_reset(void)
+{
+    uint8_t index;
+
+    /* the bus reset cancelled the transfers, buffers lent to lwip come back on their own */
+    while (g_rndis_xfer.rx_count) {
+        g_rndis_xfer.rx_free |= (1UL << g_rndis_xfer.rx_fifo[g_rndis_xfer.rx_out]);
+        g_rndis_xfer.rx_out = (g_rndis_xfer.rx_out + 1 == CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM) ? 0 : (g_rndis_xfer.rx_out + 1);
+        g_rndis_xfer.rx_count--;
+    }
+    g_rndis_xfer.rx_in = g_rndis_xfer.rx_out;
+    if (g_rndis_xfer.rx_reading >= 0) {
+        g_rndis_xfer.rx_free |= (1UL << g_rndis_xfer.rx_reading);
+        g_rndis_xfer.rx_reading = -1;
+    }
+
+    for (index = 0; index < CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM; index++) {
+        g_rndis_xfer.tx_len[index] = 0;
+    }
+    g_rndis_xfer.tx_read = g_rndis_xfer.tx_write;
+    g_rndis_xfer.tx_busy = false;
+    if (!g_rndis_xfer.tx_writing) {
+        g_rndis_xfer.tx_fill = 0;
+        g_rndis_xfer.tx_packets = 0;
+    }
+}
+
 static void rndis_notify_handler(uint8_t event, void *arg)
 {
     switch (event) {
@@ -433,10 +558,9 @@ static void rndis_notify_handler(uint8_t event, void *arg)
             g_usbd_rndis.link_status = NDIS_MEDIA_STATE_DISCONNECTED;
             break;
         case USBD_EVENT_CONFIGURED:
-            g_rndis_rx_data_length = 0;
-            g_rndis_tx_data_length = 0;
+            rndis_xfer_reset();
             g_usbd_rndis.link_status = NDIS_MEDIA_STATE_CONNECTED;
-            usbd_ep_start_read(rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr, g_rndis_rx_buffer, sizeof(g_rndis_rx_buffer));
+            rndis_rx_start();
             break;
 
         default:
@@ -446,29 +570,47 @@ static void rndis_notify_handler(uint8_t event, void *arg)
 
 void rndis_bulk_out(uint8_t ep, uint32_t nbytes)
 {
-    rndis_data_packet_t *hdr;
+    uint8_t index = g_rndis_xfer.rx_reading;
 
-    hdr = (rndis_data_packet_t *)g_rndis_rx_buffer;
-    g_rndis_rx_data_buffer = g_rndis_rx_buffer;
-    if ((hdr->MessageType != NDIS_PACKET_TYPE_DIRECTED) || (nbytes != hdr->MessageLength)) {
-        usbd_ep_start_read(rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr, g_rndis_rx_buffer, sizeof(g_rndis_rx_buffer));
+    /* too short for a packet, e.g. the single byte some hosts send instead of a zlp */
+    if (nbytes < sizeof(rndis_data_packet_t)) {
+        usbd_ep_start_read(ep, g_rndis_rx_buffer[index], RNDIS_XFER_BUFFER_SIZE);
         return;
     }
 
-    /* Point to the payload and update the message length */
-    g_rndis_rx_data_buffer += hdr->DataOffset + sizeof(rndis_generic_msg_t);
-    g_rndis_rx_data_length = hdr->DataLength;
+    g_rndis_xfer.rx_len[index] = nbytes;
+    g_rndis_xfer.rx_fifo[g_rndis_xfer.rx_in] = index;
+    g_rndis_xfer.rx_in = (g_rndis_xfer.rx_in + 1 == CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM) ? 0 : (g_rndis_xfer.rx_in + 1);
+    g_rndis_xfer.rx_count++;
 
+    /* keep receiving while the packets are handed to the network */
+    rndis_rx_start();
     usbd_rndis_data_recv_done();
 }
 
 void rndis_bulk_in(uint8_t ep, uint32_t nbytes)
 {
+    uint8_t index = g_rndis_xfer.tx_read;
+
     if ((nbytes % RNDIS_MAX_PACKET_SIZE) == 0 && nbytes) {
         /* send zlp */
         usbd_ep_start_write(ep, NULL, 0);
+        return;
+    }
+
+    g_rndis_xfer.tx_len[index] = 0;
+    index = (index + 1 == CONFIG_USBDEV_RNDIS_TX_BUFFER_NUM) ? 0 : (index + 1);
+    g_rndis_xfer.tx_read = index;
+
+    /* packets collected meanwhile go out together, unless one is still being copied in */
+    if ((g_rndis_xfer.tx_len[index] == 0) && g_rndis_xfer.tx_fill && !g_rndis_xfer.tx_writing) {
+        rndis_tx_commit();
+    }
+
+    if (g_rndis_xfer.tx_len[index]) {
+        rndis_tx_start();
     } else {
-        g_rndis_tx_data_length = 0;
+        g_rndis_xfer.tx_busy = false;
     }
 }
 
@@ -478,67 +620,179 @@ void rndis_int_in(uint8_t ep, uint32_t nbytes)
 }
 
 #ifdef CONFIG_USBDEV_RNDIS_USING_LWIP
-#include <lwip/pbuf.h>
+#if LWIP_SUPPORT_CUSTOM_PBUF
+struct usbd_rndis_rx_pbuf {
+    struct pbuf_custom custom;
+    uint8_t index;
+};
 
-struct pbuf *usbd_rndis_eth_rx(void)
+static struct usbd_rndis_rx_pbuf g_rndis_rx_pbuf[CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM][CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER];
+#endif
+
+/* Called with interrupts blocked */
+static void rndis_rx_unref(uint8_t index)
+{
+    if (--g_rndis_xfer.rx_ref[index] == 0) {
+        g_rndis_xfer.rx_free |= (1UL << index);
+        if (g_rndis_xfer.rx_reading < 0) {
+            rndis_rx_start();
+        }
+    }
+}
+
+#if LWIP_SUPPORT_CUSTOM_PBUF
+static void rndis_rx_pbuf_free(struct pbuf *p)
+{
+    struct usbd_rndis_rx_pbuf *rx_pbuf = (struct usbd_rndis_rx_pbuf *)p;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    rndis_rx_unref(rx_pbuf->index);
+    SYS_ARCH_UNPROTECT(lev);
+}
+#endif
+
+static struct pbuf *rndis_rx_pbuf(uint8_t *payload, uint32_t len)
 {
     struct pbuf *p;
 
-    if (g_rndis_rx_data_length == 0) {
-        return NULL;
-    }
-    p = pbuf_alloc(PBUF_RAW, g_rndis_rx_data_length, PBUF_POOL);
-    if (p == NULL) {
-        return NULL;
+#if LWIP_SUPPORT_CUSTOM_PBUF
+    if (g_rndis_xfer.rx_lend && (g_rndis_xfer.rx_packets < CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER)) {
+        struct usbd_rndis_rx_pbuf *rx_pbuf = &g_rndis_rx_pbuf[g_rndis_xfer.rx_parse][g_rndis_xfer.rx_packets++];
+        SYS_ARCH_DECL_PROTECT(lev);
+
+        rx_pbuf->index = g_rndis_xfer.rx_parse;
+        rx_pbuf->custom.custom_free_function = rndis_rx_pbuf_free;
+        SYS_ARCH_PROTECT(lev);
+        g_rndis_xfer.rx_ref[rx_pbuf->index]++;
+        SYS_ARCH_UNPROTECT(lev);
+        return pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rx_pbuf->custom, payload, len);
     }
-    memcpy(p->payload, (uint8_t *)g_rndis_rx_data_buffer, g_rndis_rx_data_length);
-    p->len = g_rndis_rx_data_length;
-
-    USB_LOG_DBG("rxlen:%d\r\n", g_rndis_rx_data_length);
-    g_rndis_rx_data_length = 0;
-    usbd_ep_start_read(rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr, g_rndis_rx_buffer, sizeof(g_rndis_rx_buffer));
+#endif
 
+    p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+    if (p != NULL) {
+        pbuf_take(p, payload, len);
+    }
     return p;
 }
 
-int usbd_rndis_eth_tx(struct pbuf *p)
+struct pbuf *usbd_rndis_eth_rx(void)
 {
-    struct pbuf *q;
+    rndis_data_packet_t hdr;
+    struct pbuf *p;
     uint8_t *buffer;
+    uint32_t remain;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    while (1) {
+        if (g_rndis_xfer.rx_parse < 0) {
+            SYS_ARCH_PROTECT(lev);
+            if (g_rndis_xfer.rx_count == 0) {
+                SYS_ARCH_UNPROTECT(lev);
+                return NULL;
+            }
+            g_rndis_xfer.rx_parse = g_rndis_xfer.rx_fifo[g_rndis_xfer.rx_out];
+            g_rndis_xfer.rx_out = (g_rndis_xfer.rx_out + 1 == CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM) ? 0 : (g_rndis_xfer.rx_out + 1);
+            g_rndis_xfer.rx_count--;
+            g_rndis_xfer.rx_ref[g_rndis_xfer.rx_parse] = 1;
+            /* lend the buffer only while another one is left for the out endpoint, copy otherwise */
+            g_rndis_xfer.rx_lend = (g_rndis_xfer.rx_free != 0);
+            SYS_ARCH_UNPROTECT(lev);
+            g_rndis_xfer.rx_offset = 0;
+            g_rndis_xfer.rx_packets = 0;
+        }
+
+        buffer = g_rndis_rx_buffer[g_rndis_xfer.rx_parse] + g_rndis_xfer.rx_offset;
+        remain = g_rndis_xfer.rx_len[g_rndis_xfer.rx_parse] - g_rndis_xfer.rx_offset;
+        p = NULL;
+
+        if (remain >= sizeof(rndis_data_packet_t)) {
+            memcpy(&hdr, buffer, sizeof(rndis_data_packet_t));
+            if ((hdr.MessageType != REMOTE_NDIS_PACKET_MSG) || (hdr.MessageLength < sizeof(rndis_data_packet_t)) ||
+                (hdr.MessageLength > remain) || (hdr.DataLength > hdr.MessageLength) ||
+                /* bounded first, so the offset cannot wrap the sum below */
+                (hdr.DataOffset > hdr.MessageLength) ||
+                (hdr.DataOffset + sizeof(rndis_generic_msg_t) > hdr.MessageLength - hdr.DataLength)) {
+                g_usbd_rndis.eth_state.rxbad++;
+                remain = 0;
+            } else {
+                /* Point to the payload */
+                USB_LOG_DBG("rxlen:%d\r\n", hdr.DataLength);
+                p = rndis_rx_pbuf(buffer + hdr.DataOffset + sizeof(rndis_generic_msg_t), hdr.DataLength);
+                g_rndis_xfer.rx_offset += hdr.MessageLength;
+                remain -= hdr.MessageLength;
+                g_usbd_rndis.eth_state.rxok++;
+            }
+        }
+
+        /* the rest of the transfer is padding */
+        if (remain < sizeof(rndis_data_packet_t)) {
+            SYS_ARCH_PROTECT(lev);
+            rndis_rx_unref(g_rndis_xfer.rx_parse);
+            SYS_ARCH_UNPROTECT(lev);
+            g_rndis_xfer.rx_parse = -1;
+        }
+
+        if (p != NULL) {
+            return p;
+        }
+    }
+}
+
+int usbd_rndis_eth_tx(struct pbuf *p)
+{
     rndis_data_packet_t *hdr;
+    uint8_t *buffer;
+    uint32_t len;
+    uint32_t size;
+    SYS_ARCH_DECL_PROTECT(lev);
 
     if (g_usbd_rndis.link_status == NDIS_MEDIA_STATE_DISCONNECTED) {
         return 0;
     }
 
-    if (g_rndis_tx_data_length > 0) {
-        return -EBUSY;
-    }
+    len = MIN(p->tot_len, CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE);
+    size = RNDIS_PACKET_MSG_SIZE(len);
 
-    if (p->tot_len > sizeof(g_rndis_tx_buffer)) {
-        p->tot_len = sizeof(g_rndis_tx_buffer);
+    SYS_ARCH_PROTECT(lev);
+    if ((g_rndis_xfer.tx_fill + size > g_rndis_xfer.tx_max_size) ||
+        (g_rndis_xfer.tx_packets == CONFIG_USBDEV_RNDIS_MAX_PACKETS_PER_TRANSFER)) {
+        /* full, it goes out after the transfers ahead of it */
+        rndis_tx_commit();
     }
-
-    buffer = (uint8_t *)(g_rndis_tx_buffer + sizeof(rndis_data_packet_t));
-    for (q = p; q != NULL; q = q->next) {
-        memcpy(buffer, q->payload, q->len);
-        buffer += q->len;
+    if (g_rndis_xfer.tx_len[g_rndis_xfer.tx_write]) {
+        /* every buffer is waiting for the bus */
+        SYS_ARCH_UNPROTECT(lev);
+        return -EBUSY;
     }
+    buffer = g_rndis_tx_buffer[g_rndis_xfer.tx_write] + g_rndis_xfer.tx_fill;
+    g_rndis_xfer.tx_writing = true;
+    SYS_ARCH_UNPROTECT(lev);
 
-    hdr = (rndis_data_packet_t *)g_rndis_tx_buffer;
-
+    hdr = (rndis_data_packet_t *)buffer;
     memset(hdr, 0, sizeof(rndis_data_packet_t));
     hdr->MessageType = REMOTE_NDIS_PACKET_MSG;
-    hdr->MessageLength = sizeof(rndis_data_packet_t) + p->tot_len;
+    hdr->MessageLength = size;
     hdr->DataOffset = sizeof(rndis_data_packet_t) - sizeof(rndis_generic_msg_t);
-    hdr->DataLength = p->tot_len;
-
-    g_rndis_tx_data_length = sizeof(rndis_data_packet_t) + p->tot_len;
+    hdr->DataLength = len;
+    pbuf_copy_partial(p, buffer + sizeof(rndis_data_packet_t), len, 0);
+
+    SYS_ARCH_PROTECT(lev);
+    g_rndis_xfer.tx_fill += size;
+    g_rndis_xfer.tx_packets++;
+    g_rndis_xfer.tx_writing = false;
+    /* an idle endpoint sends at once, a busy one picks the packet up when it is done */
+    if (!g_rndis_xfer.tx_busy) {
+        rndis_tx_commit();
+        rndis_tx_start();
+    }
+    SYS_ARCH_UNPROTECT(lev);
 
-    USB_LOG_DBG("txlen:%d\r\n", g_rndis_tx_data_length);
-    return usbd_ep_start_write(rndis_ep_data[RNDIS_IN_EP_IDX].ep_addr, g_rndis_tx_buffer, g_rndis_tx_data_length);
+    return 0;
 }
 #endif
+
 struct usbd_interface *usbd_rndis_init_intf(struct usbd_interface *intf,
                                             const uint8_t out_ep,
                                             const uint8_t in_ep,
@@ -550,6 +804,11 @@ struct usbd_interface *usbd_rndis_init_intf(struct usbd_interface *intf,
     g_usbd_rndis.link_status = NDIS_MEDIA_STATE_DISCONNECTED;
     g_usbd_rndis.speed = RNDIS_LINK_SPEED;
 
+    g_rndis_xfer.rx_free = (1UL << CONFIG_USBDEV_RNDIS_RX_BUFFER_NUM) - 1;
+    g_rndis_xfer.rx_reading = -1;
+    g_rndis_xfer.rx_parse = -1;
+    g_rndis_xfer.tx_max_size = RNDIS_PACKET_MSG_SIZE(CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE);
+
     rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr = out_ep;
     rndis_ep_data[RNDIS_OUT_EP_IDX].ep_cb = rndis_bulk_out;
     rndis_ep_data[RNDIS_IN_EP_IDX].ep_addr = in_ep;
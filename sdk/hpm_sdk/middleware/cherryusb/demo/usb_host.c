@@ -493,11 +493,15 @@ void usbh_class_test(void)
     usb_osal_thread_create("usbh_msc", 2048, CONFIG_USBHOST_PSC_PRIO + 1, usbh_msc_thread, NULL);
 #endif
 #if TEST_USBH_AUDIO
-#error "if you want to use iso, please contact with me"
+#ifndef CONFIG_USB_EHCI_ISO
+#error "isochronous transfers need CONFIG_USB_EHCI_ISO"
+#endif
     usb_osal_thread_create("usbh_audio", 2048, CONFIG_USBHOST_PSC_PRIO + 1, usbh_audio_thread, NULL);
 #endif
 #if TEST_USBH_VIDEO
-#error "if you want to use iso, please contact with me"
+#ifndef CONFIG_USB_EHCI_ISO
+#error "isochronous transfers need CONFIG_USB_EHCI_ISO"
+#endif
     usb_osal_thread_create("usbh_video", 2048, CONFIG_USBHOST_PSC_PRIO + 1, usbh_video_thread, NULL);
 #endif
 #if TEST_USBH_CDC_ECM
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2023 HPMicro
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "usb_osal.h"
+#include "usb_errno.h"
+#include "los_config.h"
+#include "los_interrupt.h"
+#include "los_memory.h"
+#include "los_mux.h"
+#include "los_queue.h"
+#include "los_sem.h"
+#include "los_task.h"
+#include "los_tick.h"
+
+/*
+ * CherryUSB priorities already follow the LiteOS-M order (smaller value is higher priority),
+ * the offset moves all usb threads relative to the application tasks.
+ */
+#ifndef CONFIG_USB_OSAL_LITEOS_M_PRIO_OFFSET
+#define CONFIG_USB_OSAL_LITEOS_M_PRIO_OFFSET 0
+#endif
+
+#ifndef CONFIG_USB_OSAL_LITEOS_M_MIN_STACKSIZE
+#define CONFIG_USB_OSAL_LITEOS_M_MIN_STACKSIZE LOSCFG_BASE_CORE_TSK_MIN_STACK_SIZE
+#endif
+
+/* LiteOS-M handles are indexes starting from 0, keep NULL for failures */
+#define USB_OSAL_HANDLE(id) ((void *)((uintptr_t)(id) + 1))
+#define USB_OSAL_ID(handle) ((UINT32)((uintptr_t)(handle) - 1))
+
+struct usb_osal_thread_arg {
+    usb_thread_entry_t entry;
+    void *args;
+};
+
+static int usb_osal_errno(UINT32 ret)
+{
+    switch (ret) {
+        case LOS_OK:
+            return 0;
+        case LOS_ERRNO_SEM_TIMEOUT:
+        case LOS_ERRNO_SEM_UNAVAILABLE:
+        case LOS_ERRNO_SEM_OVERFLOW:
+        case LOS_ERRNO_QUEUE_TIMEOUT:
+        case LOS_ERRNO_QUEUE_ISEMPTY:
+        case LOS_ERRNO_QUEUE_ISFULL:
+            return -ETIMEDOUT;
+        default:
+            return -EINVAL;
+    }
+}
+
+static UINT32 usb_osal_ms2tick(uint32_t timeout)
+{
+    return (timeout == USB_OSAL_WAITING_FOREVER) ? LOS_WAIT_FOREVER : LOS_MS2Tick(timeout);
+}
+
+/* The argument block is released before the entry runs, so a thread may delete itself at any point */
+static VOID *usb_osal_thread_entry(UINTPTR arg)
+{
+    struct usb_osal_thread_arg thread_arg = *(struct usb_osal_thread_arg *)arg;
+
+    (void)LOS_MemFree(OS_SYS_MEM_ADDR, (VOID *)arg);
+    thread_arg.entry(thread_arg.args);
+    return NULL;
+}
+
+usb_osal_thread_t usb_osal_thread_create(const char *name, uint32_t stack_size, uint32_t prio, usb_thread_entry_t entry, void *args)
+{
+    TSK_INIT_PARAM_S param = { 0 };
+    struct usb_osal_thread_arg *thread_arg;
+    UINT32 task_id;
+
+    thread_arg = (struct usb_osal_thread_arg *)LOS_MemAlloc(OS_SYS_MEM_ADDR, sizeof(struct usb_osal_thread_arg));
+    if (thread_arg == NULL) {
+        return NULL;
+    }
+    thread_arg->entry = entry;
+    thread_arg->args = args;
+
+    prio += CONFIG_USB_OSAL_LITEOS_M_PRIO_OFFSET;
+    /* the lowest priority belongs to the idle task */
+    if (prio >= OS_TASK_PRIORITY_LOWEST) {
+        prio = OS_TASK_PRIORITY_LOWEST - 1;
+    }
+    if (stack_size < CONFIG_USB_OSAL_LITEOS_M_MIN_STACKSIZE) {
+        stack_size = CONFIG_USB_OSAL_LITEOS_M_MIN_STACKSIZE;
+    }
+
+    param.pfnTaskEntry = (TSK_ENTRY_FUNC)usb_osal_thread_entry;
+    param.uwArg = (UINTPTR)thread_arg;
+    param.uwStackSize = stack_size;
+    param.pcName = (CHAR *)name;
+    param.usTaskPrio = (UINT16)prio;
+    if (LOS_TaskCreate(&task_id, &param) != LOS_OK) {
+        (void)LOS_MemFree(OS_SYS_MEM_ADDR, thread_arg);
+        return NULL;
+    }
+    return (usb_osal_thread_t)USB_OSAL_HANDLE(task_id);
+}
+
+void usb_osal_thread_delete(usb_osal_thread_t thread)
+{
+    if (thread == NULL) {
+        (void)LOS_TaskDelete(LOS_CurTaskIDGet());
+    } else {
+        (void)LOS_TaskDelete(USB_OSAL_ID(thread));
+    }
+}
+
+usb_osal_sem_t usb_osal_sem_create(uint32_t initial_count)
+{
+    UINT32 sem_id;
+
+    /* binary like the FreeRTOS port */
+    if (LOS_BinarySemCreate((UINT16)((initial_count > 0) ? 1 : 0), &sem_id) != LOS_OK) {
+        return NULL;
+    }
+    return (usb_osal_sem_t)USB_OSAL_HANDLE(sem_id);
+}
+
+void usb_osal_sem_delete(usb_osal_sem_t sem)
+{
+    (void)LOS_SemDelete(USB_OSAL_ID(sem));
+}
+
+int usb_osal_sem_take(usb_osal_sem_t sem, uint32_t timeout)
+{
+    return usb_osal_errno(LOS_SemPend(USB_OSAL_ID(sem), usb_osal_ms2tick(timeout)));
+}
+
+int usb_osal_sem_give(usb_osal_sem_t sem)
+{
+    return usb_osal_errno(LOS_SemPost(USB_OSAL_ID(sem)));
+}
+
+usb_osal_mutex_t usb_osal_mutex_create(void)
+{
+    UINT32 mux_id;
+
+    if (LOS_MuxCreate(&mux_id) != LOS_OK) {
+        return NULL;
+    }
+    return (usb_osal_mutex_t)USB_OSAL_HANDLE(mux_id);
+}
+
+void usb_osal_mutex_delete(usb_osal_mutex_t mutex)
+{
+    (void)LOS_MuxDelete(USB_OSAL_ID(mutex));
+}
+
+int usb_osal_mutex_take(usb_osal_mutex_t mutex)
+{
+    return usb_osal_errno(LOS_MuxPend(USB_OSAL_ID(mutex), LOS_WAIT_FOREVER));
+}
+
+int usb_osal_mutex_give(usb_osal_mutex_t mutex)
+{
+    return usb_osal_errno(LOS_MuxPost(USB_OSAL_ID(mutex)));
+}
+
+usb_osal_mq_t usb_osal_mq_create(uint32_t max_msgs)
+{
+    UINT32 queue_id;
+
+    if (LOS_QueueCreate("usb_mq", (UINT16)max_msgs, &queue_id, 0, sizeof(uintptr_t)) != LOS_OK) {
+        return NULL;
+    }
+    return (usb_osal_mq_t)USB_OSAL_HANDLE(queue_id);
+}
+
+/* Called from the usb interrupt, never blocks */
+int usb_osal_mq_send(usb_osal_mq_t mq, uintptr_t addr)
+{
+    return usb_osal_errno(LOS_QueueWriteCopy(USB_OSAL_ID(mq), &addr, sizeof(uintptr_t), LOS_NO_WAIT));
+}
+
+int usb_osal_mq_recv(usb_osal_mq_t mq, uintptr_t *addr, uint32_t timeout)
+{
+    UINT32 size = sizeof(uintptr_t);
+
+    return usb_osal_errno(LOS_QueueReadCopy(USB_OSAL_ID(mq), addr, &size, usb_osal_ms2tick(timeout)));
+}
+
+size_t usb_osal_enter_critical_section(void)
+{
+    return LOS_IntLock();
+}
+
+void usb_osal_leave_critical_section(size_t flag)
+{
+    LOS_IntRestore((UINT32)flag);
+}
+
+void usb_osal_msleep(uint32_t delay)
+{
+    (void)LOS_TaskDelay(LOS_MS2Tick(delay));
+}
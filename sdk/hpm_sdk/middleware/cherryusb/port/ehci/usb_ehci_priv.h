@@ -29,7 +29,9 @@
 
 #define CONFIG_USB_EHCI_QH_NUM  CONFIG_USBHOST_PIPE_NUM
 #define CONFIG_USB_EHCI_QTD_NUM (CONFIG_USBHOST_PIPE_NUM * 3)
-#define CONFIG_USB_EHCI_ITD_NUM 20
+#ifndef CONFIG_USB_EHCI_ITD_NUM
+#define CONFIG_USB_EHCI_ITD_NUM 20 /* iTDs and siTDs, one per scheduled frame */
+#endif
 
 extern uint8_t usbh_get_port_speed(const uint8_t port);
 
@@ -50,43 +52,63 @@ struct ehci_pipe {
     usb_osal_sem_t waitsem;
     struct usbh_hubport *hport;
     struct usbh_urb *urb;
-    uint8_t mf_unmask;
-    uint8_t mf_valid;
-    uint8_t iso_packet_idx;
-    uint8_t remain_itd_num;
+    uint8_t mf_unmask;           /* micro-frames used in a frame, high speed */
+    uint8_t mf_valid;            /* number of bits set in mf_unmask */
+    uint16_t iso_frame_interval; /* frames between two descriptors */
+    uint16_t iso_next_frame;     /* frame following the last scheduled one */
+    uint16_t iso_bandwidth;      /* bytes reserved in each used (micro-)frame */
+    usb_slist_t iso_list;        /* scheduled descriptors, oldest first */
+    usb_slist_t *iso_tail;
 };
 
 struct ehci_qh_hw {
     struct ehci_qh hw;
     uint32_t first_qtd;
+    uint32_t last_qtd;
     struct usbh_urb *urb;
-    uint8_t remove_in_iaad;
+    usb_slist_t list; /* free list or async advance list */
 } __attribute__((aligned(32)));
 
 struct ehci_qtd_hw {
     struct ehci_qtd hw;
     struct usbh_urb *urb;
     uint32_t total_len;
+    usb_slist_t list; /* free list */
 } __attribute__((aligned(32)));
 
+/* One frame of an isochronous urb, iTD for high speed and siTD for split transactions */
 struct ehci_itd_hw {
-    struct ehci_itd hw;
+    union {
+        struct ehci_itd itd;
+        struct ehci_sitd sitd;
+    } hw; /* the next link pointer is the first word of both */
     struct usbh_urb *urb;
     struct ehci_pipe *pipe;
-    uint16_t start_frame;
-    usb_slist_t list;
+    uint16_t start_frame;  /* frame number, (frindex >> 3) */
+    uint16_t first_packet; /* index of the first urb packet */
+    uint8_t last;          /* last descriptor of the urb */
+    usb_slist_t list;      /* free list or pipe list */
 } __attribute__((aligned(32)));
 
 struct ehci_hcd {
-    bool ehci_qh_used[CONFIG_USB_EHCI_QH_NUM];
-    bool ehci_qtd_used[CONFIG_USB_EHCI_QTD_NUM];
-    bool ehci_itd_used[CONFIG_USB_EHCI_ITD_NUM];
+    usb_slist_t qh_free;
+    usb_slist_t qtd_free;
+    uint32_t qtd_free_num;
+    usb_slist_t qh_iaad_pending; /* unlinked, waiting for the doorbell */
+    usb_slist_t qh_iaad_ringing; /* unlinked before the doorbell in flight */
+    usb_slist_t itd_free;
+    usb_slist_t itd_retired;     /* unlinked in the current frame, not reusable yet */
+    uint16_t iso_hs_load[8];     /* high speed bytes per micro-frame */
+    uint16_t iso_fs_load;        /* full speed bytes per frame */
     struct ehci_pipe pipe_pool[CONFIG_USB_EHCI_QH_NUM];
 };
 
 extern struct ehci_hcd g_ehci_hcd;
 extern uint32_t g_framelist[];
 
+void ehci_iso_init(void);
+int ehci_iso_pipe_alloc(struct ehci_pipe *pipe);
+void ehci_iso_pipe_free(struct ehci_pipe *pipe);
 int ehci_iso_pipe_init(struct ehci_pipe *pipe, struct usbh_urb *urb);
 void ehci_remove_itd_urb(struct usbh_urb *urb);
 void ehci_scan_isochronous_list(void);
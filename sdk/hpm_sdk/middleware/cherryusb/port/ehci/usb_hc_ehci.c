@@ -24,80 +24,139 @@ USB_NOCACHE_RAM_SECTION struct ehci_qh_hw g_periodic_qh_head[EHCI_PERIOIDIC_QH_N
 /* The frame list */
 USB_NOCACHE_RAM_SECTION uint32_t g_framelist[CONFIG_USB_EHCI_FRAME_LIST_SIZE] __attribute__((aligned(4096)));
 
+/* Put every qh and qtd back on the free lists, whatever they were used for */
+static void ehci_pool_init(void)
+{
+    usb_slist_init(&g_ehci_hcd.qh_free);
+    usb_slist_init(&g_ehci_hcd.qtd_free);
+    usb_slist_init(&g_ehci_hcd.qh_iaad_pending);
+    usb_slist_init(&g_ehci_hcd.qh_iaad_ringing);
+
+    for (int i = CONFIG_USB_EHCI_QH_NUM - 1; i >= 0; i--) {
+        ehci_qh_pool[i].urb = NULL;
+        usb_slist_add_head(&g_ehci_hcd.qh_free, &ehci_qh_pool[i].list);
+    }
+    for (int i = CONFIG_USB_EHCI_QTD_NUM - 1; i >= 0; i--) {
+        ehci_qtd_pool[i].urb = NULL;
+        usb_slist_add_head(&g_ehci_hcd.qtd_free, &ehci_qtd_pool[i].list);
+    }
+    g_ehci_hcd.qtd_free_num = CONFIG_USB_EHCI_QTD_NUM;
+}
+
 static struct ehci_qh_hw *ehci_qh_alloc(void)
 {
     struct ehci_qh_hw *qh;
     size_t flags;
 
-    for (uint32_t i = 0; i < CONFIG_USB_EHCI_QH_NUM; i++) {
-        if (!g_ehci_hcd.ehci_qh_used[i]) {
-            flags = usb_osal_enter_critical_section();
-            g_ehci_hcd.ehci_qh_used[i] = true;
-            usb_osal_leave_critical_section(flags);
-
-            qh = &ehci_qh_pool[i];
-            memset(qh, 0, sizeof(struct ehci_qh_hw));
-            qh->hw.hlp = QTD_LIST_END;
-            qh->hw.overlay.next_qtd = QTD_LIST_END;
-            qh->hw.overlay.alt_next_qtd = QTD_LIST_END;
-            return qh;
-        }
+    flags = usb_osal_enter_critical_section();
+    qh = usb_slist_first_entry_or_null(&g_ehci_hcd.qh_free, struct ehci_qh_hw, list);
+    if (qh) {
+        g_ehci_hcd.qh_free.next = qh->list.next;
     }
-    return NULL;
+    usb_osal_leave_critical_section(flags);
+
+    if (qh == NULL) {
+        return NULL;
+    }
+
+    memset(qh, 0, sizeof(struct ehci_qh_hw));
+    qh->hw.hlp = QTD_LIST_END;
+    qh->hw.overlay.next_qtd = QTD_LIST_END;
+    qh->hw.overlay.alt_next_qtd = QTD_LIST_END;
+    return qh;
 }
 
 static void ehci_qh_free(struct ehci_qh_hw *qh)
 {
     size_t flags;
 
-    for (uint32_t i = 0; i < CONFIG_USB_EHCI_QH_NUM; i++) {
-        if (&ehci_qh_pool[i] == qh) {
-            flags = usb_osal_enter_critical_section();
-            g_ehci_hcd.ehci_qh_used[i] = false;
-            usb_osal_leave_critical_section(flags);
+    qh->urb = NULL;
 
-            qh->urb = NULL;
-            return;
-        }
-    }
+    flags = usb_osal_enter_critical_section();
+    usb_slist_add_head(&g_ehci_hcd.qh_free, &qh->list);
+    usb_osal_leave_critical_section(flags);
 }
 
-static struct ehci_qtd_hw *ehci_qtd_alloc(void)
+/*
+ * Take qtd_num qtds off the free list in one critical section, as a list linked through qtd->list.
+ * Nothing is taken when the pool holds fewer.
+ */
+static int ehci_qtd_alloc_list(usb_slist_t *list, uint32_t qtd_num)
 {
     struct ehci_qtd_hw *qtd;
+    usb_slist_t *tail;
+    usb_slist_t *node;
+    usb_slist_t *next;
     size_t flags;
 
-    for (uint32_t i = 0; i < CONFIG_USB_EHCI_QTD_NUM; i++) {
-        if (!g_ehci_hcd.ehci_qtd_used[i]) {
-            flags = usb_osal_enter_critical_section();
-            g_ehci_hcd.ehci_qtd_used[i] = true;
-            usb_osal_leave_critical_section(flags);
-
-            qtd = &ehci_qtd_pool[i];
-            memset(qtd, 0, sizeof(struct ehci_qtd_hw));
-            qtd->hw.next_qtd = QTD_LIST_END;
-            qtd->hw.alt_next_qtd = QTD_LIST_END;
-            qtd->hw.token = QTD_TOKEN_STATUS_HALTED;
-            return qtd;
-        }
+    usb_slist_init(list);
+
+    flags = usb_osal_enter_critical_section();
+    if ((qtd_num == 0) || (g_ehci_hcd.qtd_free_num < qtd_num)) {
+        usb_osal_leave_critical_section(flags);
+        return -ENOMEM;
     }
-    return NULL;
+    list->next = g_ehci_hcd.qtd_free.next;
+    tail = list->next;
+    for (uint32_t i = 1; i < qtd_num; i++) {
+        tail = tail->next;
+    }
+    g_ehci_hcd.qtd_free.next = tail->next;
+    g_ehci_hcd.qtd_free_num -= qtd_num;
+    usb_osal_leave_critical_section(flags);
+
+    tail->next = NULL;
+    for (node = list->next; node != NULL; node = next) {
+        next = node->next;
+        qtd = usb_slist_entry(node, struct ehci_qtd_hw, list);
+        memset(qtd, 0, sizeof(struct ehci_qtd_hw));
+        qtd->hw.next_qtd = QTD_LIST_END;
+        qtd->hw.alt_next_qtd = QTD_LIST_END;
+        qtd->hw.token = QTD_TOKEN_STATUS_HALTED;
+        qtd->list.next = next;
+    }
+    return 0;
 }
 
-static void ehci_qtd_free(struct ehci_qtd_hw *qtd)
+/*
+ * Retire the whole qtd chain of a qh with one pool update. The transferred length is added to urb
+ * when it is not NULL.
+ */
+static void ehci_qh_release_qtds(struct ehci_qh_hw *qh, struct usbh_urb *urb)
 {
+    struct ehci_qtd_hw *first_qtd;
+    struct ehci_qtd_hw *last_qtd = NULL;
+    struct ehci_qtd_hw *qtd;
+    uint32_t qtd_num = 0;
     size_t flags;
 
-    for (uint32_t i = 0; i < CONFIG_USB_EHCI_QTD_NUM; i++) {
-        if (&ehci_qtd_pool[i] == qtd) {
-            flags = usb_osal_enter_critical_section();
-            g_ehci_hcd.ehci_qtd_used[i] = false;
-            usb_osal_leave_critical_section(flags);
+    first_qtd = EHCI_ADDR2QTD(qh->first_qtd);
+    qtd = first_qtd;
 
-            qtd->urb = NULL;
-            return;
+    while (qtd) {
+        if (urb) {
+            urb->actual_length += (qtd->total_len - ((qtd->hw.token & QTD_TOKEN_NBYTES_MASK) >> QTD_TOKEN_NBYTES_SHIFT));
         }
+        qtd->urb = NULL;
+        last_qtd = qtd;
+        qtd_num++;
+
+        qtd = EHCI_ADDR2QTD(qtd->hw.next_qtd);
+        last_qtd->list.next = qtd ? &qtd->list : NULL;
+    }
+
+    qh->first_qtd = QTD_LIST_END;
+    qh->last_qtd = QTD_LIST_END;
+
+    if (last_qtd == NULL) {
+        return;
     }
+
+    flags = usb_osal_enter_critical_section();
+    last_qtd->list.next = g_ehci_hcd.qtd_free.next;
+    g_ehci_hcd.qtd_free.next = &first_qtd->list;
+    g_ehci_hcd.qtd_free_num += qtd_num;
+    usb_osal_leave_critical_section(flags);
 }
 
 static struct ehci_pipe *ehci_pipe_alloc(void)
@@ -318,6 +377,7 @@ static struct ehci_qh_hw *ehci_control_pipe_init(struct ehci_pipe *pipe, struct
     struct ehci_qtd_hw *qtd_setup = NULL;
     struct ehci_qtd_hw *qtd_data = NULL;
     struct ehci_qtd_hw *qtd_status = NULL;
+    usb_slist_t qtd_list;
     uint32_t token;
     size_t flags;
 
@@ -326,23 +386,19 @@ static struct ehci_qh_hw *ehci_control_pipe_init(struct ehci_pipe *pipe, struct
         return NULL;
     }
 
-    qtd_setup = ehci_qtd_alloc();
-    if (buflen > 0) {
-        qtd_data = ehci_qtd_alloc();
-    }
-
-    qtd_status = ehci_qtd_alloc();
-    if (qtd_status == NULL) {
+    if (ehci_qtd_alloc_list(&qtd_list, (buflen > 0) ? 3 : 2) < 0) {
         ehci_qh_free(qh);
-        if (qtd_setup) {
-            ehci_qtd_free(qtd_setup);
-        }
-        if (qtd_data) {
-            ehci_qtd_free(qtd_data);
-        }
         return NULL;
     }
 
+    qtd_setup = usb_slist_first_entry(&qtd_list, struct ehci_qtd_hw, list);
+    if (buflen > 0) {
+        qtd_data = usb_slist_first_entry(&qtd_setup->list, struct ehci_qtd_hw, list);
+        qtd_status = usb_slist_first_entry(&qtd_data->list, struct ehci_qtd_hw, list);
+    } else {
+        qtd_status = usb_slist_first_entry(&qtd_setup->list, struct ehci_qtd_hw, list);
+    }
+
     ehci_qh_fill(qh,
                  pipe->dev_addr,
                  pipe->ep_addr,
@@ -404,8 +460,9 @@ static struct ehci_qh_hw *ehci_control_pipe_init(struct ehci_pipe *pipe, struct
     qh->hw.curr_qtd = EHCI_PTR2ADDR(qtd_setup);
     qh->hw.overlay.next_qtd = EHCI_PTR2ADDR(qtd_setup);
 
-    /* record qh first qtd */
+    /* record qh first and last qtd */
     qh->first_qtd = EHCI_PTR2ADDR(qtd_setup);
+    qh->last_qtd = EHCI_PTR2ADDR(qtd_status);
 
     flags = usb_osal_enter_critical_section();
 
@@ -425,6 +482,8 @@ static struct ehci_qh_hw *ehci_bulk_pipe_init(struct ehci_pipe *pipe, uint8_t *b
     struct ehci_qtd_hw *qtd = NULL;
     struct ehci_qtd_hw *first_qtd = NULL;
     struct ehci_qtd_hw *prev_qtd = NULL;
+    usb_slist_t qtd_list;
+    usb_slist_t *node;
     uint32_t qtd_num = 0;
     uint32_t xfer_len = 0;
     uint32_t token;
@@ -435,13 +494,10 @@ static struct ehci_qh_hw *ehci_bulk_pipe_init(struct ehci_pipe *pipe, uint8_t *b
         return NULL;
     }
 
-    for (uint32_t i = 0; i < CONFIG_USB_EHCI_QTD_NUM; i++) {
-        if (!g_ehci_hcd.ehci_qtd_used[i]) {
-            qtd_num++;
-        }
-    }
+    /* a zero length transfer still takes one qtd */
+    qtd_num = (buflen > 0) ? ((buflen + 0x3fff) / 0x4000) : 1;
 
-    if (qtd_num < ((buflen + 0x3fff) / 0x4000)) {
+    if (ehci_qtd_alloc_list(&qtd_list, qtd_num) < 0) {
         ehci_qh_free(qh);
         return NULL;
     }
@@ -457,8 +513,9 @@ static struct ehci_qh_hw *ehci_bulk_pipe_init(struct ehci_pipe *pipe, uint8_t *b
                  pipe->hport->parent->hub_addr,
                  pipe->hport->port);
 
-    while (buflen >= 0) {
-        qtd = ehci_qtd_alloc();
+    usb_slist_for_each(node, &qtd_list)
+    {
+        qtd = usb_slist_entry(node, struct ehci_qtd_hw, list);
 
         if (buflen > 0x4000) {
             xfer_len = 0x4000;
@@ -493,10 +550,6 @@ static struct ehci_qh_hw *ehci_bulk_pipe_init(struct ehci_pipe *pipe, uint8_t *b
             first_qtd = qtd;
         }
         prev_qtd = qtd;
-
-        if (buflen == 0) {
-            break;
-        }
     }
 
     /* update qh first qtd */
@@ -510,8 +563,9 @@ static struct ehci_qh_hw *ehci_bulk_pipe_init(struct ehci_pipe *pipe, uint8_t *b
         qh->hw.overlay.token = 0;
     }
 
-    /* record qh first qtd */
+    /* record qh first and last qtd */
     qh->first_qtd = EHCI_PTR2ADDR(first_qtd);
+    qh->last_qtd = EHCI_PTR2ADDR(prev_qtd);
 
     flags = usb_osal_enter_critical_section();
 
@@ -531,6 +585,8 @@ static struct ehci_qh_hw *ehci_intr_pipe_init(struct ehci_pipe *pipe, uint8_t *b
     struct ehci_qtd_hw *qtd = NULL;
     struct ehci_qtd_hw *first_qtd = NULL;
     struct ehci_qtd_hw *prev_qtd = NULL;
+    usb_slist_t qtd_list;
+    usb_slist_t *node;
     uint32_t qtd_num = 0;
     uint32_t xfer_len = 0;
     uint32_t token;
@@ -541,13 +597,10 @@ static struct ehci_qh_hw *ehci_intr_pipe_init(struct ehci_pipe *pipe, uint8_t *b
         return NULL;
     }
 
-    for (uint32_t i = 0; i < CONFIG_USB_EHCI_QTD_NUM; i++) {
-        if (!g_ehci_hcd.ehci_qtd_used[i]) {
-            qtd_num++;
-        }
-    }
+    /* a zero length transfer still takes one qtd */
+    qtd_num = (buflen > 0) ? ((buflen + 0x3fff) / 0x4000) : 1;
 
-    if (qtd_num < ((buflen + 0x3fff) / 0x4000)) {
+    if (ehci_qtd_alloc_list(&qtd_list, qtd_num) < 0) {
         ehci_qh_free(qh);
         return NULL;
     }
@@ -563,8 +616,9 @@ static struct ehci_qh_hw *ehci_intr_pipe_init(struct ehci_pipe *pipe, uint8_t *b
                  pipe->hport->parent->hub_addr,
                  pipe->hport->port);
 
-    while (buflen >= 0) {
-        qtd = ehci_qtd_alloc();
+    usb_slist_for_each(node, &qtd_list)
+    {
+        qtd = usb_slist_entry(node, struct ehci_qtd_hw, list);
 
         if (buflen > 0x4000) {
             xfer_len = 0x4000;
@@ -599,10 +653,6 @@ static struct ehci_qh_hw *ehci_intr_pipe_init(struct ehci_pipe *pipe, uint8_t *b
             first_qtd = qtd;
         }
         prev_qtd = qtd;
-
-        if (buflen == 0) {
-            break;
-        }
     }
 
     /* update qh first qtd */
@@ -616,8 +666,9 @@ static struct ehci_qh_hw *ehci_intr_pipe_init(struct ehci_pipe *pipe, uint8_t *b
         qh->hw.overlay.token = 0;
     }
 
-    /* record qh first qtd */
+    /* record qh first and last qtd */
     qh->first_qtd = EHCI_PTR2ADDR(first_qtd);
+    qh->last_qtd = EHCI_PTR2ADDR(prev_qtd);
 
     flags = usb_osal_enter_critical_section();
 
@@ -658,18 +709,19 @@ void ehci_pipe_waitup(struct ehci_pipe *pipe)
 
 static void ehci_qh_scan_qtds(struct ehci_qh_hw *qhead, struct ehci_qh_hw *qh)
 {
-    struct ehci_qtd_hw *qtd;
-
     ehci_qh_remove(qhead, qh);
 
-    qtd = EHCI_ADDR2QTD(qh->first_qtd);
+    ehci_qh_release_qtds(qh, qh->urb);
+}
 
-    while (qtd) {
-        qtd->urb->actual_length += (qtd->total_len - ((qtd->hw.token & QTD_TOKEN_NBYTES_MASK) >> QTD_TOKEN_NBYTES_SHIFT));
+/* Ring the async advance doorbell for the unlinked qhs, unless one is already in flight */
+static void ehci_qh_ring_iaad(void)
+{
+    if (usb_slist_isempty(&g_ehci_hcd.qh_iaad_ringing) && !usb_slist_isempty(&g_ehci_hcd.qh_iaad_pending)) {
+        g_ehci_hcd.qh_iaad_ringing.next = g_ehci_hcd.qh_iaad_pending.next;
+        usb_slist_init(&g_ehci_hcd.qh_iaad_pending);
 
-        ehci_qtd_free(qtd);
-        qh->first_qtd = qtd->hw.next_qtd;
-        qtd = EHCI_ADDR2QTD(qh->first_qtd);
+        EHCI_HCOR->usbcmd |= EHCI_USBCMD_IAAD;
     }
 }
 
@@ -677,7 +729,6 @@ static void ehci_check_qh(struct ehci_qh_hw *qhead, struct ehci_qh_hw *qh)
 {
     struct usbh_urb *urb;
     struct ehci_pipe *pipe;
-    struct ehci_qtd_hw *qtd;
     uint32_t token;
 
     token = qh->hw.overlay.token;
@@ -691,14 +742,10 @@ static void ehci_check_qh(struct ehci_qh_hw *qhead, struct ehci_qh_hw *qh)
     pipe = urb->pipe;
 
     if ((token & QTD_TOKEN_STATUS_ERRORS) == 0) {
-		qtd = EHCI_ADDR2QTD(qh->first_qtd);
-
-		while (qtd) {
-			if (qtd->hw.token & QTD_TOKEN_STATUS_ACTIVE) {
-				return;
-			}
-			qtd = EHCI_ADDR2QTD(qtd->hw.next_qtd);
-		}
+        /* qtds are executed in order, the urb is done once its last qtd is */
+        if (EHCI_ADDR2QTD(qh->last_qtd)->hw.token & QTD_TOKEN_STATUS_ACTIVE) {
+            return;
+        }
 
         if (token & QTD_TOKEN_TOGGLE) {
             pipe->toggle = true;
@@ -721,29 +768,19 @@ static void ehci_check_qh(struct ehci_qh_hw *qhead, struct ehci_qh_hw *qh)
     ehci_qh_scan_qtds(qhead, qh);
 
     if (pipe->ep_type == USB_ENDPOINT_TYPE_INTERRUPT) {
-        qh->remove_in_iaad = 0;
         ehci_qh_free(qh);
         ehci_pipe_waitup(pipe);
     } else {
-        qh->remove_in_iaad = 1;
-
-        EHCI_HCOR->usbcmd |= EHCI_USBCMD_IAAD;
+        /* the controller may still cache the qh, it is released on the async advance interrupt */
+        usb_slist_add_head(&g_ehci_hcd.qh_iaad_pending, &qh->list);
     }
 }
 
 static void ehci_kill_qh(struct ehci_qh_hw *qhead, struct ehci_qh_hw *qh)
 {
-    struct ehci_qtd_hw *qtd;
-
     ehci_qh_remove(qhead, qh);
 
-    qtd = EHCI_ADDR2QTD(qh->first_qtd);
-
-    while (qtd) {
-        ehci_qtd_free(qtd);
-        qh->first_qtd = qtd->hw.next_qtd;
-        qtd = EHCI_ADDR2QTD(qh->first_qtd);
-    }
+    ehci_qh_release_qtds(qh, NULL);
 
     ehci_qh_free(qh);
 }
@@ -795,6 +832,10 @@ int usb_hc_init(void)
     uint32_t regval;
 
     memset(&g_ehci_hcd, 0, sizeof(struct ehci_hcd));
+    ehci_pool_init();
+#ifdef CONFIG_USB_EHCI_ISO
+    ehci_iso_init();
+#endif
 
     if (sizeof(struct ehci_qh_hw) % 32) {
         USB_LOG_ERR("struct ehci_qh_hw is not align 32\r\n");
@@ -1103,26 +1144,21 @@ int usbh_pipe_alloc(usbh_pipe_t *pipe, const struct usbh_endpoint_cfg *ep_cfg)
     ppipe->dev_addr = ep_cfg->hport->dev_addr;
     ppipe->hport = ep_cfg->hport;
 
+    /* restore variable */
+    ppipe->inuse = true;
+    ppipe->waitsem = waitsem;
+
 #ifdef CONFIG_USB_EHCI_ISO
-    if ((ppipe->speed == USB_SPEED_HIGH) && (ppipe->ep_type == USB_ENDPOINT_TYPE_ISOCHRONOUS)) {
-        if (ep_cfg->ep_interval == 0x01) { /* transfer interval 1 mf */
-            ppipe->mf_unmask = 0xff;
-            ppipe->mf_valid = 8;
-        } else if (ep_cfg->ep_interval == 0x02) { /* transfer interval 2 mf */
-            ppipe->mf_unmask = 0x55;
-            ppipe->mf_valid = 4;
-        } else if (ep_cfg->ep_interval == 0x03) { /* transfer interval 4 mf */
-            ppipe->mf_unmask = 0x44;
-            ppipe->mf_valid = 2;
-        } else if (ep_cfg->ep_interval == 0x04) { /* transfer interval 8 mf */
-            ppipe->mf_unmask = 0x01;
-            ppipe->mf_valid = 1;
+    if (ppipe->ep_type == USB_ENDPOINT_TYPE_ISOCHRONOUS) {
+        /* reserve periodic bandwidth and pick the micro-frames */
+        int ret = ehci_iso_pipe_alloc(ppipe);
+
+        if (ret < 0) {
+            ehci_pipe_free(ppipe);
+            return ret;
         }
     }
 #endif
-    /* restore variable */
-    ppipe->inuse = true;
-    ppipe->waitsem = waitsem;
 
     *pipe = (usbh_pipe_t)ppipe;
 
@@ -1146,6 +1182,13 @@ int usbh_pipe_free(usbh_pipe_t pipe)
         usbh_kill_urb(urb);
     }
 
+#ifdef CONFIG_USB_EHCI_ISO
+    if (ppipe->ep_type == USB_ENDPOINT_TYPE_ISOCHRONOUS) {
+        /* older urbs of the ring and the bandwidth */
+        ehci_iso_pipe_free(ppipe);
+    }
+#endif
+
     ehci_pipe_free(ppipe);
     return 0;
 }
@@ -1188,30 +1231,37 @@ int usbh_submit_urb(struct usbh_urb *urb)
         case USB_ENDPOINT_TYPE_CONTROL:
             qh = ehci_control_pipe_init(pipe, urb->setup, urb->transfer_buffer, urb->transfer_buffer_length);
             if (qh == NULL) {
-                return -ENOMEM;
+                ret = -ENOMEM;
             }
             break;
         case USB_ENDPOINT_TYPE_BULK:
             qh = ehci_bulk_pipe_init(pipe, urb->transfer_buffer, urb->transfer_buffer_length);
             if (qh == NULL) {
-                return -ENOMEM;
+                ret = -ENOMEM;
             }
             break;
         case USB_ENDPOINT_TYPE_INTERRUPT:
             qh = ehci_intr_pipe_init(pipe, urb->transfer_buffer, urb->transfer_buffer_length);
             if (qh == NULL) {
-                return -ENOMEM;
+                ret = -ENOMEM;
             }
             break;
         case USB_ENDPOINT_TYPE_ISOCHRONOUS:
 #ifdef CONFIG_USB_EHCI_ISO
-            ehci_iso_pipe_init(pipe, urb);
+            ret = ehci_iso_pipe_init(pipe, urb);
 #endif
             break;
         default:
             break;
     }
 
+    if (ret < 0) {
+        /* nothing was queued, the pipe takes the next urb */
+        pipe->urb = NULL;
+        pipe->waiter = false;
+        return ret;
+    }
+
     if (urb->timeout > 0) {
         /* wait until timeout or sem give */
         ret = usb_osal_sem_take(pipe->waitsem, urb->timeout);
@@ -1301,6 +1351,9 @@ static void ehci_scan_async_list(void)
         }
         qh = EHCI_ADDR2QH(qh->hw.hlp);
     }
+
+    /* one doorbell for all the qhs completed in this scan */
+    ehci_qh_ring_iaad();
 }
 
 static void ehci_scan_periodic_list(void)
@@ -1329,15 +1382,25 @@ void USBH_IRQHandler(void)
     usbsts = EHCI_HCOR->usbsts & EHCI_HCOR->usbintr;
     EHCI_HCOR->usbsts = usbsts;
 
-    if (usbsts & EHCI_USBSTS_INT) {
-        ehci_scan_async_list();
-        ehci_scan_periodic_list();
-#ifdef CONFIG_USB_EHCI_ISO
-        ehci_scan_isochronous_list();
-#endif
+    /* before the scan, the qhs it unlinks must wait for a new doorbell */
+    if (usbsts & EHCI_USBSTS_IAA) {
+        usb_slist_t *node = usb_slist_head(&g_ehci_hcd.qh_iaad_ringing);
+
+        usb_slist_init(&g_ehci_hcd.qh_iaad_ringing);
+        while (node) {
+            struct ehci_qh_hw *qh = usb_slist_entry(node, struct ehci_qh_hw, list);
+            struct ehci_pipe *pipe = qh->urb->pipe;
+
+            node = usb_slist_next(node);
+            ehci_qh_free(qh);
+
+            ehci_pipe_waitup(pipe);
+        }
+        ehci_qh_ring_iaad();
     }
 
-    if (usbsts & EHCI_USBSTS_ERR) {
+    /* one pass retires everything completed or failed since the last interrupt */
+    if (usbsts & (EHCI_USBSTS_INT | EHCI_USBSTS_ERR)) {
         ehci_scan_async_list();
         ehci_scan_periodic_list();
 #ifdef CONFIG_USB_EHCI_ISO
@@ -1352,15 +1415,8 @@ void USBH_IRQHandler(void)
             if (portsc & EHCI_PORTSC_CSC) {
                 if ((portsc & EHCI_PORTSC_CCS) == EHCI_PORTSC_CCS) {
                 } else {
-                    for (uint8_t index = 0; index < CONFIG_USB_EHCI_QH_NUM; index++) {
-                        g_ehci_hcd.ehci_qh_used[index] = false;
-                    }
-                    for (uint8_t index = 0; index < CONFIG_USB_EHCI_QTD_NUM; index++) {
-                        g_ehci_hcd.ehci_qtd_used[index] = false;
-                    }
-                    for (uint8_t index = 0; index < CONFIG_USB_EHCI_ITD_NUM; index++) {
-                        g_ehci_hcd.ehci_itd_used[index] = false;
-                    }
+                    /* isochronous descriptors stay linked until the class frees its pipes */
+                    ehci_pool_init();
                 }
 
                 usbh_roothub_thread_wakeup(port + 1);
@@ -1368,24 +1424,6 @@ void USBH_IRQHandler(void)
         }
     }
 
-    if (usbsts & EHCI_USBSTS_IAA) {
-        for (uint8_t index = 0; index < CONFIG_USB_EHCI_QH_NUM; index++) {
-            struct ehci_qh_hw *qh = &ehci_qh_pool[index];
-            if (g_ehci_hcd.ehci_qh_used[index] && qh->remove_in_iaad) {
-                struct usbh_urb *urb;
-                struct ehci_pipe *pipe;
-
-                urb = qh->urb;
-                pipe = urb->pipe;
-
-                qh->remove_in_iaad = 0;
-                ehci_qh_free(qh);
-
-                ehci_pipe_waitup(pipe);
-            }
-        }
-    }
-
     if (usbsts & EHCI_USBSTS_FATAL) {
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
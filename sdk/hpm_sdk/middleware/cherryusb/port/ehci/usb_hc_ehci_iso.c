@@ -0,0 +1,626 @@
+/*
+ * Copyright (c) 2023 HPMicro
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "usb_ehci_priv.h"
+
+#ifdef CONFIG_USB_EHCI_ISO
+
+/* Frames between now and the first descriptor of a stream, covers the isochronous scheduling threshold */
+#ifndef CONFIG_USB_EHCI_ISO_START_DELAY
+#define CONFIG_USB_EHCI_ISO_START_DELAY 2
+#endif
+
+#define EHCI_ISO_FRAME_MASK   0x7ff /* frindex >> 3 */
+#define EHCI_ISO_HS_BUDGET    6000  /* 80% of a micro-frame for periodic transfers */
+#define EHCI_ISO_FS_BUDGET    1157  /* full speed periodic payload behind a TT */
+#define EHCI_ISO_SPLIT_SIZE   188   /* full speed bytes per micro-frame */
+#define EHCI_ISO_LINK_TYP_QH  0x2
+#define EHCI_ISO_LINK_TYP_MSK 0x6
+
+USB_NOCACHE_RAM_SECTION struct ehci_itd_hw ehci_itd_pool[CONFIG_USB_EHCI_ITD_NUM];
+
+static inline uint16_t ehci_iso_frame_now(void)
+{
+    return ((EHCI_HCOR->frindex & EHCI_FRINDEX_MASK) >> 3) & EHCI_ISO_FRAME_MASK;
+}
+
+/* frame is after now and within the frame list */
+static inline bool ehci_iso_frame_ahead(uint16_t frame, uint16_t now)
+{
+    uint16_t distance = (frame - now) & EHCI_ISO_FRAME_MASK;
+
+    return (distance > 0) && (distance < CONFIG_USB_EHCI_FRAME_LIST_SIZE);
+}
+
+static inline bool ehci_iso_frame_passed(uint16_t frame, uint16_t now)
+{
+    uint16_t distance = (now - frame) & EHCI_ISO_FRAME_MASK;
+
+    return (distance > 0) && (distance <= (EHCI_ISO_FRAME_MASK >> 1));
+}
+
+void ehci_iso_init(void)
+{
+    usb_slist_init(&g_ehci_hcd.itd_free);
+    usb_slist_init(&g_ehci_hcd.itd_retired);
+
+    for (int i = CONFIG_USB_EHCI_ITD_NUM - 1; i >= 0; i--) {
+        usb_slist_add_head(&g_ehci_hcd.itd_free, &ehci_itd_pool[i].list);
+    }
+    memset(g_ehci_hcd.iso_hs_load, 0, sizeof(g_ehci_hcd.iso_hs_load));
+    g_ehci_hcd.iso_fs_load = 0;
+}
+
+/* Descriptors unlinked during their own frame may still be read by the controller until it ends */
+static void ehci_itd_reclaim(uint16_t now)
+{
+    usb_slist_t *prev = &g_ehci_hcd.itd_retired;
+    usb_slist_t *node;
+
+    while ((node = usb_slist_next(prev)) != NULL) {
+        struct ehci_itd_hw *itd = usb_slist_entry(node, struct ehci_itd_hw, list);
+
+        if (itd->start_frame != now) {
+            prev->next = node->next;
+            usb_slist_add_head(&g_ehci_hcd.itd_free, node);
+        } else {
+            prev = node;
+        }
+    }
+}
+
+static void ehci_itd_free(struct ehci_itd_hw *itd, uint16_t now)
+{
+    itd->urb = NULL;
+    if (itd->start_frame == now) {
+        usb_slist_add_head(&g_ehci_hcd.itd_retired, &itd->list);
+    } else {
+        usb_slist_add_head(&g_ehci_hcd.itd_free, &itd->list);
+    }
+}
+
+/* Take itd_num descriptors at once, linked in list */
+static int ehci_itd_alloc_list(usb_slist_t *list, uint32_t itd_num)
+{
+    usb_slist_t *tail = list;
+    usb_slist_t *node;
+    size_t flags;
+
+    usb_slist_init(list);
+
+    flags = usb_osal_enter_critical_section();
+    ehci_itd_reclaim(ehci_iso_frame_now());
+    for (uint32_t i = 0; i < itd_num; i++) {
+        node = usb_slist_head(&g_ehci_hcd.itd_free);
+        if (node == NULL) {
+            /* give back the partial list */
+            tail->next = g_ehci_hcd.itd_free.next;
+            g_ehci_hcd.itd_free.next = list->next;
+            usb_osal_leave_critical_section(flags);
+            usb_slist_init(list);
+            return -ENOMEM;
+        }
+        g_ehci_hcd.itd_free.next = node->next;
+        node->next = NULL;
+        tail->next = node;
+        tail = node;
+    }
+    usb_osal_leave_critical_section(flags);
+    return 0;
+}
+
+static void ehci_itd_free_list(usb_slist_t *list)
+{
+    usb_slist_t *tail = usb_slist_tail(list);
+    size_t flags;
+
+    if (tail == list) {
+        return;
+    }
+
+    flags = usb_osal_enter_critical_section();
+    tail->next = g_ehci_hcd.itd_free.next;
+    g_ehci_hcd.itd_free.next = list->next;
+    usb_osal_leave_critical_section(flags);
+    usb_slist_init(list);
+}
+
+/*
+ * Fill an iTD with the packets of one frame, one transaction per micro-frame in mf_unmask. A transaction
+ * carries up to mult packets. Returns the number of packets used or -EINVAL when they do not fit in the
+ * seven buffer pages.
+ */
+static int ehci_itd_fill(struct ehci_itd_hw *itd, struct ehci_pipe *pipe, struct usbh_urb *urb, uint32_t packet_idx)
+{
+    struct ehci_itd *hw = &itd->hw.itd;
+    uint32_t page[7] = { 0 };
+    uint32_t page_num = 0;
+    uint32_t packet_num = 0;
+    uint32_t max_len = pipe->ep_mps * (pipe->mult + 1);
+    uint32_t addr;
+    uint32_t len;
+    uint32_t pg;
+
+    memset(hw, 0, sizeof(struct ehci_itd));
+
+    for (uint8_t uframe = 0; uframe < 8; uframe++) {
+        if (((pipe->mf_unmask & (1 << uframe)) == 0) || (packet_idx >= urb->num_of_iso_packets)) {
+            continue;
+        }
+
+        addr = (uint32_t)urb->iso_packet[packet_idx].transfer_buffer;
+        len = urb->iso_packet[packet_idx].transfer_buffer_length;
+        if (len > max_len) {
+            return -EINVAL;
+        }
+
+        if ((page_num == 0) || (page[page_num - 1] != (addr & ~0xfff))) {
+            if (page_num == 7) {
+                return -EINVAL;
+            }
+            page[page_num++] = addr & ~0xfff;
+        }
+        pg = page_num - 1;
+
+        /* a transaction crossing a page continues in the next page pointer */
+        if ((len > 0) && (((addr + len - 1) & ~0xfff) != page[pg])) {
+            if (page_num == 7) {
+                return -EINVAL;
+            }
+            page[page_num++] = page[pg] + 0x1000;
+        }
+
+        hw->tscl[uframe] = ITD_TSCL_STATUS_ACTIVE |
+                           (len << ITD_TSCL_LENGTH_SHIFT) |
+                           (pg << ITD_TSCL_PG_SHIFT) |
+                           (addr & ITD_TSCL_XOFFS_MASK);
+        packet_idx++;
+        packet_num++;
+    }
+
+    hw->nlp = QH_HLP_END;
+    hw->bpl[0] = page[0] |
+                 ((uint32_t)(pipe->ep_addr & 0xf) << ITD_BUFPTR0_ENDPT_SHIFT) |
+                 ((uint32_t)pipe->dev_addr << ITD_BUFPTR0_DEVADDR_SHIFT);
+    hw->bpl[1] = page[1] |
+                 ((pipe->ep_addr & 0x80) ? ITD_BUFPTR1_DIRIN : ITD_BUFPTR1_DIROUT) |
+                 ((uint32_t)pipe->ep_mps << ITD_BUFPTR1_MAXPKT_SHIFT);
+    hw->bpl[2] = page[2] | ((uint32_t)(pipe->mult + 1) << ITD_BUFPTR2_MULTI_SHIFT);
+    for (uint8_t i = 3; i < 7; i++) {
+        hw->bpl[i] = page[i];
+    }
+    return packet_num;
+}
+
+/* Fill a siTD with one packet, the TT splits it in 188 byte micro-frames */
+static int ehci_sitd_fill(struct ehci_itd_hw *itd, struct ehci_pipe *pipe, struct usbh_iso_frame_packet *packet)
+{
+    struct ehci_sitd *hw = &itd->hw.sitd;
+    uint32_t addr = (uint32_t)packet->transfer_buffer;
+    uint32_t len = packet->transfer_buffer_length;
+    uint32_t split_num;
+
+    if (len > pipe->ep_mps) {
+        return -EINVAL;
+    }
+
+    split_num = (len + EHCI_ISO_SPLIT_SIZE - 1) / EHCI_ISO_SPLIT_SIZE;
+    if (split_num == 0) {
+        split_num = 1;
+    }
+
+    memset(hw, 0, sizeof(struct ehci_sitd));
+    hw->nlp = QH_HLP_END;
+    hw->epchar = ((uint32_t)pipe->dev_addr << SITD_EPCHAR_DEVADDR_SHIFT) |
+                 ((uint32_t)(pipe->ep_addr & 0xf) << SITD_EPCHAR_ENDPT_SHIFT) |
+                 ((uint32_t)pipe->hport->parent->hub_addr << SITD_EPCHAR_HUBADDR_SHIFT) |
+                 ((uint32_t)pipe->hport->port << SITD_EPCHAR_PORT_SHIFT);
+    hw->bpl[0] = addr;
+    hw->bpl[1] = (addr & ~0xfff) + 0x1000;
+
+    if (pipe->ep_addr & 0x80) {
+        /* start split in micro-frame 0, complete splits from micro-frame 2 while data can arrive */
+        hw->epchar |= SITD_EPCHAR_DIRIN;
+        hw->mfsc = (0x01 << SITD_MFSC_SMASK_SHIFT) |
+                   ((((1 << (split_num + 1)) - 1) << 2) & 0xff) << SITD_MFSC_CMASK_SHIFT;
+    } else {
+        /* one start split per 188 bytes */
+        hw->mfsc = ((1 << split_num) - 1) << SITD_MFSC_SMASK_SHIFT;
+        hw->bpl[1] |= (split_num << SITD_BUFPTR1_TCOUNT_SHIFT) |
+                      ((split_num == 1) ? SITD_BUFPTR1_TP_ALL : SITD_BUFPTR1_TP_BEGIN);
+    }
+
+    hw->tsc = SITD_TSC_STATUS_ACTIVE | (len << SITD_TSC_NBYTES_SHIFT);
+    hw->blp = SITD_BLP_END;
+    return 1;
+}
+
+static inline uint32_t ehci_iso_link(struct ehci_pipe *pipe, struct ehci_itd_hw *itd)
+{
+    return (pipe->speed == USB_SPEED_HIGH) ? ITD_NLP_ITD(itd) : ITD_NLP_SITD(itd);
+}
+
+/* Isochronous descriptors go in front of the interrupt qh tree of their frame */
+static void ehci_iso_link_frame(struct ehci_pipe *pipe, struct ehci_itd_hw *itd)
+{
+    uint32_t index = itd->start_frame & (CONFIG_USB_EHCI_FRAME_LIST_SIZE - 1);
+
+    itd->hw.itd.nlp = g_framelist[index];
+    g_framelist[index] = ehci_iso_link(pipe, itd);
+}
+
+static void ehci_iso_unlink_frame(struct ehci_itd_hw *itd)
+{
+    volatile uint32_t *link = &g_framelist[itd->start_frame & (CONFIG_USB_EHCI_FRAME_LIST_SIZE - 1)];
+
+    while (*link && ((*link & QH_HLP_END) == 0) && ((*link & EHCI_ISO_LINK_TYP_MSK) != EHCI_ISO_LINK_TYP_QH)) {
+        struct ehci_itd_hw *cur = EHCI_ADDR2ITD(*link);
+
+        if (cur == itd) {
+            *link = itd->hw.itd.nlp;
+            return;
+        }
+        link = &cur->hw.itd.nlp;
+    }
+}
+
+static bool ehci_iso_itd_active(struct ehci_pipe *pipe, struct ehci_itd_hw *itd)
+{
+    if (pipe->speed == USB_SPEED_HIGH) {
+        for (uint8_t uframe = 0; uframe < 8; uframe++) {
+            if (itd->hw.itd.tscl[uframe] & ITD_TSCL_STATUS_ACTIVE) {
+                return true;
+            }
+        }
+        return false;
+    } else {
+        return (itd->hw.sitd.tsc & SITD_TSC_STATUS_ACTIVE) ? true : false;
+    }
+}
+
+static int ehci_iso_packet_status(uint32_t status_active, uint32_t status_babble, uint32_t status_errors, uint32_t status)
+{
+    if (status & status_active) {
+        /* the frame went by before the descriptor was reached */
+        return -EXDEV;
+    } else if (status & status_babble) {
+        return -EPERM;
+    } else if (status & status_errors) {
+        return -EIO;
+    }
+    return 0;
+}
+
+/* Copy the transaction results of a retired descriptor to the urb packets */
+static void ehci_iso_itd_result(struct ehci_pipe *pipe, struct ehci_itd_hw *itd)
+{
+    struct usbh_urb *urb = itd->urb;
+    struct usbh_iso_frame_packet *packet;
+    uint32_t packet_idx = itd->first_packet;
+    uint32_t token;
+
+    if (pipe->speed == USB_SPEED_HIGH) {
+        for (uint8_t uframe = 0; uframe < 8; uframe++) {
+            if (((pipe->mf_unmask & (1 << uframe)) == 0) || (packet_idx >= urb->num_of_iso_packets)) {
+                continue;
+            }
+            packet = &urb->iso_packet[packet_idx++];
+            token = itd->hw.itd.tscl[uframe];
+            packet->errorcode = ehci_iso_packet_status(ITD_TSCL_STATUS_ACTIVE, ITD_TSCL_STATUS_BABBLE,
+                                                       ITD_TSCL_STATUS_XACTERR | ITD_TSCL_STATUS_DBERROR, token);
+            if (packet->errorcode < 0) {
+                packet->actual_length = 0;
+            } else if (pipe->ep_addr & 0x80) {
+                /* the controller writes back the received length */
+                packet->actual_length = (token & ITD_TSCL_LENGTH_MASK) >> ITD_TSCL_LENGTH_SHIFT;
+            } else {
+                packet->actual_length = packet->transfer_buffer_length;
+            }
+            urb->actual_length += packet->actual_length;
+        }
+    } else {
+        packet = &urb->iso_packet[packet_idx];
+        token = itd->hw.sitd.tsc;
+        packet->errorcode = ehci_iso_packet_status(SITD_TSC_STATUS_ACTIVE | SITD_TSC_STATUS_MMF, SITD_TSC_STATUS_BABBLE,
+                                                   SITD_TSC_STATUS_ERR | SITD_TSC_STATUS_DBERROR | SITD_TSC_STATUS_XACTERR, token);
+        if (packet->errorcode < 0) {
+            packet->actual_length = 0;
+        } else {
+            packet->actual_length = packet->transfer_buffer_length - ((token & SITD_TSC_NBYTES_MASK) >> SITD_TSC_NBYTES_SHIFT);
+        }
+        urb->actual_length += packet->actual_length;
+    }
+}
+
+static void ehci_iso_urb_complete(struct ehci_pipe *pipe, struct usbh_urb *urb)
+{
+    /* packet errors are reported per packet, like other hosts do */
+    urb->errorcode = 0;
+
+    if (pipe->urb == urb) {
+        pipe->urb = NULL;
+        if (pipe->waiter) {
+            pipe->waiter = false;
+            usb_osal_sem_give(pipe->waitsem);
+        }
+    }
+
+    if (urb->complete) {
+        urb->complete(urb->arg, urb->actual_length);
+    }
+}
+
+/* Unlink and release the descriptors of urb, or all of them when urb is NULL */
+static void ehci_iso_pipe_remove(struct ehci_pipe *pipe, struct usbh_urb *urb)
+{
+    usb_slist_t *prev = &pipe->iso_list;
+    usb_slist_t *node;
+    uint16_t now = ehci_iso_frame_now();
+
+    while ((node = usb_slist_next(prev)) != NULL) {
+        struct ehci_itd_hw *itd = usb_slist_entry(node, struct ehci_itd_hw, list);
+
+        if ((urb == NULL) || (itd->urb == urb)) {
+            prev->next = node->next;
+            ehci_iso_unlink_frame(itd);
+            ehci_itd_free(itd, now);
+        } else {
+            prev = node;
+        }
+    }
+    pipe->iso_tail = usb_slist_tail(&pipe->iso_list);
+}
+
+int ehci_iso_pipe_alloc(struct ehci_pipe *pipe)
+{
+    uint32_t interval = (pipe->ep_interval < 1) ? 1 : ((pipe->ep_interval > 16) ? 16 : pipe->ep_interval);
+    uint32_t load;
+    uint32_t best_load = 0xffffffff;
+    uint8_t best_mask = 0;
+    size_t flags;
+
+    usb_slist_init(&pipe->iso_list);
+    pipe->iso_tail = &pipe->iso_list;
+    pipe->iso_next_frame = 0;
+
+    flags = usb_osal_enter_critical_section();
+    if (pipe->speed == USB_SPEED_HIGH) {
+        /* 2^(bInterval-1) micro-frames, take the phase that keeps the busiest micro-frame lowest */
+        uint32_t period = 1 << (interval - 1);
+        uint32_t phase_num = (period < 8) ? period : 8;
+
+        load = pipe->ep_mps * (pipe->mult + 1);
+        for (uint32_t phase = 0; phase < phase_num; phase++) {
+            uint8_t mask = 0;
+            uint32_t peak = 0;
+
+            for (uint32_t uframe = phase; uframe < 8; uframe += ((period < 8) ? period : 8)) {
+                mask |= (1 << uframe);
+                if ((g_ehci_hcd.iso_hs_load[uframe] + load) > peak) {
+                    peak = g_ehci_hcd.iso_hs_load[uframe] + load;
+                }
+            }
+            if (peak < best_load) {
+                best_load = peak;
+                best_mask = mask;
+            }
+        }
+        if (best_load > EHCI_ISO_HS_BUDGET) {
+            usb_osal_leave_critical_section(flags);
+            return -ENOSPC;
+        }
+
+        pipe->mf_unmask = best_mask;
+        pipe->mf_valid = 0;
+        for (uint8_t uframe = 0; uframe < 8; uframe++) {
+            if (best_mask & (1 << uframe)) {
+                g_ehci_hcd.iso_hs_load[uframe] += load;
+                pipe->mf_valid++;
+            }
+        }
+        pipe->iso_frame_interval = (period > 8) ? (period / 8) : 1;
+    } else {
+        /* 2^(bInterval-1) frames, the budget is shared by all TTs */
+        load = pipe->ep_mps;
+        if ((g_ehci_hcd.iso_fs_load + load) > EHCI_ISO_FS_BUDGET) {
+            usb_osal_leave_critical_section(flags);
+            return -ENOSPC;
+        }
+        g_ehci_hcd.iso_fs_load += load;
+        pipe->mf_unmask = 0x01;
+        pipe->mf_valid = 1;
+        pipe->iso_frame_interval = 1 << (interval - 1);
+    }
+    if (pipe->iso_frame_interval > (CONFIG_USB_EHCI_FRAME_LIST_SIZE / 2)) {
+        pipe->iso_frame_interval = CONFIG_USB_EHCI_FRAME_LIST_SIZE / 2;
+    }
+    pipe->iso_bandwidth = load;
+    usb_osal_leave_critical_section(flags);
+    return 0;
+}
+
+void ehci_iso_pipe_free(struct ehci_pipe *pipe)
+{
+    size_t flags;
+
+    flags = usb_osal_enter_critical_section();
+    ehci_iso_pipe_remove(pipe, NULL);
+
+    if (pipe->speed == USB_SPEED_HIGH) {
+        for (uint8_t uframe = 0; uframe < 8; uframe++) {
+            if (pipe->mf_unmask & (1 << uframe)) {
+                g_ehci_hcd.iso_hs_load[uframe] -= pipe->iso_bandwidth;
+            }
+        }
+    } else {
+        g_ehci_hcd.iso_fs_load -= pipe->iso_bandwidth;
+    }
+    pipe->iso_bandwidth = 0;
+    pipe->mf_unmask = 0;
+    usb_osal_leave_critical_section(flags);
+}
+
+/*
+ * Schedule the packets of urb in consecutive (micro-)frames. An urb submitted while the previous one is
+ * still queued continues right after it, a ring of urbs therefore streams without gaps and completes
+ * with one interrupt per urb.
+ */
+int ehci_iso_pipe_init(struct ehci_pipe *pipe, struct usbh_urb *urb)
+{
+    usb_slist_t list;
+    usb_slist_t *node;
+    struct ehci_itd_hw *itd = NULL;
+    uint32_t packet_idx = 0;
+    uint32_t itd_num;
+    uint16_t now;
+    uint16_t frame;
+    size_t flags;
+    int ret;
+
+    if ((urb->num_of_iso_packets == 0) || (pipe->mf_valid == 0)) {
+        return -EINVAL;
+    }
+
+    itd_num = (urb->num_of_iso_packets + pipe->mf_valid - 1) / pipe->mf_valid;
+    if ((itd_num * pipe->iso_frame_interval) >= (CONFIG_USB_EHCI_FRAME_LIST_SIZE - CONFIG_USB_EHCI_ISO_START_DELAY)) {
+        return -EINVAL;
+    }
+
+    ret = ehci_itd_alloc_list(&list, itd_num);
+    if (ret < 0) {
+        return ret;
+    }
+
+    usb_slist_for_each(node, &list)
+    {
+        itd = usb_slist_entry(node, struct ehci_itd_hw, list);
+        if (pipe->speed == USB_SPEED_HIGH) {
+            ret = ehci_itd_fill(itd, pipe, urb, packet_idx);
+        } else {
+            ret = ehci_sitd_fill(itd, pipe, &urb->iso_packet[packet_idx]);
+        }
+        if (ret < 0) {
+            ehci_itd_free_list(&list);
+            return ret;
+        }
+        itd->urb = urb;
+        itd->pipe = pipe;
+        itd->first_packet = packet_idx;
+        itd->last = 0;
+        packet_idx += ret;
+    }
+
+    /* one interrupt per urb, on its last transaction */
+    itd->last = 1;
+    if (pipe->speed == USB_SPEED_HIGH) {
+        for (int uframe = 7; uframe >= 0; uframe--) {
+            if (itd->hw.itd.tscl[uframe] & ITD_TSCL_STATUS_ACTIVE) {
+                itd->hw.itd.tscl[uframe] |= ITD_TSCL_IOC;
+                break;
+            }
+        }
+    } else {
+        itd->hw.sitd.tsc |= SITD_TSC_IOC;
+    }
+
+    flags = usb_osal_enter_critical_section();
+
+    now = ehci_iso_frame_now();
+    frame = pipe->iso_next_frame;
+    /* a new stream, or one that ran dry, restarts after the scheduling threshold */
+    if (usb_slist_isempty(&pipe->iso_list) || !ehci_iso_frame_ahead(frame, now)) {
+        frame = (now + CONFIG_USB_EHCI_ISO_START_DELAY) & EHCI_ISO_FRAME_MASK;
+    }
+    if (!ehci_iso_frame_ahead((frame + (itd_num - 1) * pipe->iso_frame_interval) & EHCI_ISO_FRAME_MASK, now)) {
+        /* the urbs already queued leave no room in the frame list */
+        usb_osal_leave_critical_section(flags);
+        ehci_itd_free_list(&list);
+        return -EBUSY;
+    }
+    urb->start_frame = frame;
+
+    usb_slist_for_each(node, &list)
+    {
+        itd = usb_slist_entry(node, struct ehci_itd_hw, list);
+        itd->start_frame = frame;
+        ehci_iso_link_frame(pipe, itd);
+        frame = (frame + pipe->iso_frame_interval) & EHCI_ISO_FRAME_MASK;
+    }
+    pipe->iso_next_frame = frame;
+
+    pipe->iso_tail->next = list.next;
+    pipe->iso_tail = &itd->list;
+
+    EHCI_HCOR->usbcmd |= EHCI_USBCMD_PSEN;
+
+    usb_osal_leave_critical_section(flags);
+    return 0;
+}
+
+void ehci_remove_itd_urb(struct usbh_urb *urb)
+{
+    struct ehci_pipe *pipe = urb->pipe;
+    size_t flags;
+
+    flags = usb_osal_enter_critical_section();
+    ehci_iso_pipe_remove(pipe, urb);
+    usb_osal_leave_critical_section(flags);
+}
+
+static void ehci_iso_pipe_scan(struct ehci_pipe *pipe, uint16_t now)
+{
+    usb_slist_t *node;
+    struct ehci_itd_hw *first;
+    struct ehci_itd_hw *last;
+    struct usbh_urb *urb;
+
+    while (!usb_slist_isempty(&pipe->iso_list)) {
+        first = usb_slist_first_entry(&pipe->iso_list, struct ehci_itd_hw, list);
+        urb = first->urb;
+
+        last = first;
+        while (!last->last) {
+            last = usb_slist_entry(usb_slist_next(&last->list), struct ehci_itd_hw, list);
+        }
+
+        /* frames are run in order, the urb is done when its last frame is */
+        if (ehci_iso_itd_active(pipe, last) && !ehci_iso_frame_passed(last->start_frame, now)) {
+            return;
+        }
+
+        do {
+            node = usb_slist_head(&pipe->iso_list);
+            first = usb_slist_entry(node, struct ehci_itd_hw, list);
+            pipe->iso_list.next = node->next;
+
+            ehci_iso_itd_result(pipe, first);
+            ehci_iso_unlink_frame(first);
+            ehci_itd_free(first, now);
+        } while (first != last);
+
+        if (usb_slist_isempty(&pipe->iso_list)) {
+            pipe->iso_tail = &pipe->iso_list;
+        }
+
+        ehci_iso_urb_complete(pipe, urb);
+    }
+}
+
+void ehci_scan_isochronous_list(void)
+{
+    struct ehci_pipe *pipe;
+    uint16_t now = ehci_iso_frame_now();
+
+    ehci_itd_reclaim(now);
+
+    for (uint8_t index = 0; index < CONFIG_USB_EHCI_QH_NUM; index++) {
+        pipe = &g_ehci_hcd.pipe_pool[index];
+        if (pipe->inuse && (pipe->ep_type == USB_ENDPOINT_TYPE_ISOCHRONOUS)) {
+            ehci_iso_pipe_scan(pipe, now);
+        }
+    }
+}
+
+#endif
@@ -24,7 +24,13 @@ float hpm_mcl_control_cos(float x)
 
 float hpm_mcl_control_arctan(float y, float x)
 {
-    return atan2(y, x);
+    return atan2f(y, x);
+}
+
+void hpm_mcl_control_sincos(float x, float *sin_x, float *cos_x)
+{
+    *sin_x = sinf(x);
+    *cos_x = cosf(x);
 }
 
 hpm_mcl_stat_t hpm_mcl_control_clarke(float ia, float ib, float ic,
@@ -240,15 +246,27 @@ hpm_mcl_stat_t hpm_mcl_control_init(mcl_control_t *control, mcl_control_cfg_t *c
      * @brief function initialisation
      *
      */
+#if MCL_CFG_MATH_BACKEND == MCL_MATH_BACKEND_LUT
+    hpm_mcl_math_init();
+    control->method.arctan_x = &hpm_mcl_math_atan2;
+    control->method.cos_x = &hpm_mcl_math_cos;
+    control->method.sin_x = &hpm_mcl_math_sin;
+    control->method.sincos_x = &hpm_mcl_math_sincos;
+#else
+#if defined(MCL_CFG_EN_MATH_Q31) && MCL_CFG_EN_MATH_Q31
+    hpm_mcl_math_init();
+#endif
     control->method.arctan_x = &hpm_mcl_control_arctan;
-    control->method.clarke = &hpm_mcl_control_clarke;
     control->method.cos_x = &hpm_mcl_control_cos;
+    control->method.sin_x = &hpm_mcl_control_sin;
+    control->method.sincos_x = &hpm_mcl_control_sincos;
+#endif
+    control->method.clarke = &hpm_mcl_control_clarke;
     control->method.currentd_pid = &hpm_mcl_control_pi;
     control->method.currentq_pid = &hpm_mcl_control_pi;
     control->method.invpark = &hpm_mcl_control_inv_park;
     control->method.park = &hpm_mcl_control_park;
     control->method.position_pid = &hpm_mcl_control_pi;
-    control->method.sin_x = &hpm_mcl_control_sin;
     control->method.speed_pid = &hpm_mcl_control_pi;
     control->method.svpwm = &hpm_mcl_control_svpwm;
     control->method.step_svpwm = &hpm_mcl_control_step_svpwm;
@@ -260,6 +278,11 @@ hpm_mcl_stat_t hpm_mcl_control_init(mcl_control_t *control, mcl_control_cfg_t *c
     MCL_FUNCTION_INIT_IF_NO_EMPTY(control->method.park, control->cfg->callback.method.park);
     MCL_FUNCTION_INIT_IF_NO_EMPTY(control->method.position_pid, control->cfg->callback.method.position_pid);
     MCL_FUNCTION_INIT_IF_NO_EMPTY(control->method.sin_x, control->cfg->callback.method.sin_x);
+    /* A user sin/cos without the fused version must not be bypassed by the default sincos */
+    if ((control->cfg->callback.method.sin_x != NULL) || (control->cfg->callback.method.cos_x != NULL)) {
+        control->method.sincos_x = NULL;
+    }
+    MCL_FUNCTION_INIT_IF_NO_EMPTY(control->method.sincos_x, control->cfg->callback.method.sincos_x);
     MCL_FUNCTION_INIT_IF_NO_EMPTY(control->method.speed_pid, control->cfg->callback.method.speed_pid);
     MCL_FUNCTION_INIT_IF_NO_EMPTY(control->method.svpwm, control->cfg->callback.method.svpwm);
     MCL_FUNCTION_INIT_IF_NO_EMPTY(control->method.svpwm, control->cfg->callback.method.step_svpwm);
@@ -82,6 +82,7 @@ typedef struct {
     hpm_mcl_type_t (*sin_x)(hpm_mcl_type_t x);
     hpm_mcl_type_t (*cos_x)(hpm_mcl_type_t x);
     hpm_mcl_type_t (*arctan_x)(hpm_mcl_type_t y, hpm_mcl_type_t x);
+    void (*sincos_x)(hpm_mcl_type_t x, hpm_mcl_type_t *sin_x, hpm_mcl_type_t *cos_x);  /**< NULL: sin_x and cos_x are used */
     hpm_mcl_stat_t (*park)(hpm_mcl_type_t alpha, hpm_mcl_type_t beta,
                 hpm_mcl_type_t sin_x, hpm_mcl_type_t cos_x,
                 hpm_mcl_type_t *d, hpm_mcl_type_t *q);
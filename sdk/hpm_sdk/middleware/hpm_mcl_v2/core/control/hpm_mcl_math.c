@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2023 HPMicro
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "hpm_mcl_common.h"
+#include "hpm_mcl_math.h"
+#include "math.h"
+
+#define MCL_MATH_SIN_LUT_MASK       (MCL_MATH_SIN_LUT_SIZE - 1U)
+#define MCL_MATH_SIN_LUT_SCALE      ((float)MCL_MATH_SIN_LUT_SIZE / MCL_2PI)
+#define MCL_MATH_SIN_LUT_QUARTER    (MCL_MATH_SIN_LUT_SIZE / 4U)
+
+/**
+ * @brief atan(a) for a in [0, 1], Abramowitz and Stegun 4.4.49
+ *
+ */
+#define MCL_MATH_ATAN_C1    (0.9998660f)
+#define MCL_MATH_ATAN_C3    (-0.3302995f)
+#define MCL_MATH_ATAN_C5    (0.1801410f)
+#define MCL_MATH_ATAN_C7    (-0.0851330f)
+#define MCL_MATH_ATAN_C9    (0.0208351f)
+
+/**
+ * @brief One extra point so that interpolation never wraps the index
+ *
+ */
+static float mcl_math_sin_lut[MCL_MATH_SIN_LUT_SIZE + 1];
+
+#if defined(MCL_CFG_EN_MATH_Q31) && MCL_CFG_EN_MATH_Q31
+static int32_t mcl_math_sin_lut_q31[MCL_MATH_SIN_LUT_SIZE + 1];
+
+/**
+ * @brief Q31 atan coefficients, scaled by 1/(2pi) so that the result is in turns
+ *
+ */
+#define MCL_MATH_ATAN_Q31(c)    ((int32_t)((double)(c) / (2.0 * 3.14159265358979323846) * 2147483648.0))
+
+#define MCL_MATH_SQRT3_DIV3_Q31 (1239850262)    /**< sqrt(3)/3 */
+#endif
+
+void hpm_mcl_math_init(void)
+{
+    for (uint32_t i = 0; i <= MCL_MATH_SIN_LUT_SIZE; i++) {
+        double val = sin((double)i * (2.0 * 3.14159265358979323846) / MCL_MATH_SIN_LUT_SIZE);
+        mcl_math_sin_lut[i] = (float)val;
+#if defined(MCL_CFG_EN_MATH_Q31) && MCL_CFG_EN_MATH_Q31
+        mcl_math_sin_lut_q31[i] = (int32_t)MCL_Q31_SAT((int64_t)lround(val * 2147483648.0));
+#endif
+    }
+}
+
+static inline float hpm_mcl_math_lut_lerp(uint32_t index, float frac)
+{
+    float val = mcl_math_sin_lut[index];
+
+    return val + frac * (mcl_math_sin_lut[index + 1] - val);
+}
+
+static inline uint32_t hpm_mcl_math_lut_index(float x, float *frac)
+{
+    float pos = x * MCL_MATH_SIN_LUT_SCALE;
+    int32_t index = (int32_t)pos;
+
+    /* Truncation rounds towards zero, negative angles need floor */
+    if ((float)index > pos) {
+        index--;
+    }
+    *frac = pos - (float)index;
+    return (uint32_t)index & MCL_MATH_SIN_LUT_MASK;
+}
+
+float hpm_mcl_math_sin(float x)
+{
+    float frac;
+    uint32_t index = hpm_mcl_math_lut_index(x, &frac);
+
+    return hpm_mcl_math_lut_lerp(index, frac);
+}
+
+float hpm_mcl_math_cos(float x)
+{
+    float frac;
+    uint32_t index = hpm_mcl_math_lut_index(x, &frac);
+
+    return hpm_mcl_math_lut_lerp((index + MCL_MATH_SIN_LUT_QUARTER) & MCL_MATH_SIN_LUT_MASK, frac);
+}
+
+void hpm_mcl_math_sincos(float x, float *sin_x, float *cos_x)
+{
+    float frac;
+    uint32_t index = hpm_mcl_math_lut_index(x, &frac);
+
+    *sin_x = hpm_mcl_math_lut_lerp(index, frac);
+    *cos_x = hpm_mcl_math_lut_lerp((index + MCL_MATH_SIN_LUT_QUARTER) & MCL_MATH_SIN_LUT_MASK, frac);
+}
+
+float hpm_mcl_math_atan2(float y, float x)
+{
+    float abs_x = fabsf(x);
+    float abs_y = fabsf(y);
+    float ratio, ratio2, val;
+
+    if ((abs_x == 0) && (abs_y == 0)) {
+        return 0;
+    }
+    /* Reduce to the first octant, atan of a ratio in [0, 1] */
+    if (abs_y > abs_x) {
+        ratio = abs_x / abs_y;
+    } else {
+        ratio = abs_y / abs_x;
+    }
+    ratio2 = ratio * ratio;
+    val = ((((MCL_MATH_ATAN_C9 * ratio2 + MCL_MATH_ATAN_C7) * ratio2 + MCL_MATH_ATAN_C5) * ratio2
+            + MCL_MATH_ATAN_C3) * ratio2 + MCL_MATH_ATAN_C1) * ratio;
+    if (abs_y > abs_x) {
+        val = (0.5f * MCL_PI) - val;
+    }
+    if (x < 0) {
+        val = MCL_PI - val;
+    }
+    if (y < 0) {
+        val = -val;
+    }
+    return val;
+}
+
+#if defined(MCL_CFG_EN_MATH_Q31) && MCL_CFG_EN_MATH_Q31
+static inline int32_t hpm_mcl_math_lut_lerp_q31(uint32_t index, int32_t frac)
+{
+    int32_t val = mcl_math_sin_lut_q31[index];
+
+    return val + MCL_Q31_MUL(mcl_math_sin_lut_q31[index + 1] - val, frac);
+}
+
+void hpm_mcl_math_sincos_q31(mcl_q31_angle_t angle, int32_t *sin_x, int32_t *cos_x)
+{
+    uint32_t index = angle >> (32U - MCL_CFG_MATH_SIN_LUT_BITS);
+    int32_t frac = (int32_t)((angle << MCL_CFG_MATH_SIN_LUT_BITS) >> 1);
+
+    *sin_x = hpm_mcl_math_lut_lerp_q31(index, frac);
+    *cos_x = hpm_mcl_math_lut_lerp_q31((index + MCL_MATH_SIN_LUT_QUARTER) & MCL_MATH_SIN_LUT_MASK, frac);
+}
+
+mcl_q31_angle_t hpm_mcl_math_atan2_q31(int32_t y, int32_t x)
+{
+    int64_t abs_x = (x < 0) ? -(int64_t)x : x;
+    int64_t abs_y = (y < 0) ? -(int64_t)y : y;
+    int32_t ratio, ratio2, val;
+    mcl_q31_angle_t angle;
+
+    if ((abs_x == 0) && (abs_y == 0)) {
+        return 0;
+    }
+    if (abs_y > abs_x) {
+        ratio = (int32_t)MCL_Q31_SAT((abs_x << 31) / abs_y);
+    } else {
+        ratio = (int32_t)MCL_Q31_SAT((abs_y << 31) / abs_x);
+    }
+    ratio2 = MCL_Q31_MUL(ratio, ratio);
+    val = MCL_Q31_MUL(MCL_MATH_ATAN_Q31(MCL_MATH_ATAN_C9), ratio2) + MCL_MATH_ATAN_Q31(MCL_MATH_ATAN_C7);
+    val = MCL_Q31_MUL(val, ratio2) + MCL_MATH_ATAN_Q31(MCL_MATH_ATAN_C5);
+    val = MCL_Q31_MUL(val, ratio2) + MCL_MATH_ATAN_Q31(MCL_MATH_ATAN_C3);
+    val = MCL_Q31_MUL(val, ratio2) + MCL_MATH_ATAN_Q31(MCL_MATH_ATAN_C1);
+    /* val is in Q31 turns, the angle is Q32 turns */
+    angle = (mcl_q31_angle_t)MCL_Q31_MUL(val, ratio) << 1;
+    if (abs_y > abs_x) {
+        angle = 0x40000000UL - angle;
+    }
+    if (x < 0) {
+        angle = 0x80000000UL - angle;
+    }
+    if (y < 0) {
+        angle = 0U - angle;
+    }
+    return angle;
+}
+
+void hpm_mcl_math_clarke_q31(int32_t ia, int32_t ib, int32_t *alpha, int32_t *beta)
+{
+    int64_t val = (int64_t)ia * MCL_MATH_SQRT3_DIV3_Q31 + (int64_t)ib * (2 * (int64_t)MCL_MATH_SQRT3_DIV3_Q31);
+
+    *alpha = ia;
+    *beta = MCL_Q31_SAT(val >> 31);
+}
+
+void hpm_mcl_math_park_q31(int32_t alpha, int32_t beta, int32_t sin_x, int32_t cos_x, int32_t *d, int32_t *q)
+{
+    int64_t val_d = (int64_t)cos_x * alpha + (int64_t)sin_x * beta;
+    int64_t val_q = (int64_t)cos_x * beta - (int64_t)sin_x * alpha;
+
+    *d = MCL_Q31_SAT(val_d >> 31);
+    *q = MCL_Q31_SAT(val_q >> 31);
+}
+
+void hpm_mcl_math_inv_park_q31(int32_t d, int32_t q, int32_t sin_x, int32_t cos_x, int32_t *alpha, int32_t *beta)
+{
+    int64_t val_alpha = (int64_t)cos_x * d - (int64_t)sin_x * q;
+    int64_t val_beta = (int64_t)sin_x * d + (int64_t)cos_x * q;
+
+    *alpha = MCL_Q31_SAT(val_alpha >> 31);
+    *beta = MCL_Q31_SAT(val_beta >> 31);
+}
+#endif
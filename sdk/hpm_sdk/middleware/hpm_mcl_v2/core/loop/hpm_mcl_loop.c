@@ -6,6 +6,16 @@
  */
 #include "hpm_mcl_loop.h"
 
+static inline void hpm_mcl_loop_sincos(mcl_control_t *control, float theta, float *sinx, float *cosx)
+{
+    if (control->method.sincos_x != NULL) {
+        control->method.sincos_x(theta, sinx, cosx);
+    } else {
+        *sinx = control->method.sin_x(theta);
+        *cosx = control->method.cos_x(theta);
+    }
+}
+
 hpm_mcl_stat_t hpm_mcl_loop_init(mcl_loop_t *loop, mcl_loop_cfg_t *cfg, mcl_cfg_t *mcl_cfg,
                                 mcl_encoder_t *encoder, mcl_analog_t *analog,
                                 mcl_control_t *control, mcl_drivers_t *drivers, mcl_path_plan_t *path)
@@ -151,14 +161,12 @@ hpm_mcl_stat_t hpm_mcl_bldc_loop(mcl_loop_t *loop)
             MCL_VALUE_SET_IF_TRUE(loop->ref_id.enable, ref_d, loop->ref_id.value);
             MCL_FUNCTION_SET_IF_ELSE_TRUE(loop->ref_iq.enable, ref_q, loop->ref_iq.value, loop->exec_ref.iq);
             loop->control->method.clarke(ia, ib, ic, &alpha, &beta);
-            sinx = loop->control->method.sin_x(theta);
-            cosx = loop->control->method.cos_x(theta);
+            hpm_mcl_loop_sincos(loop->control, theta, &sinx, &cosx);
             loop->control->method.park(alpha, beta, sinx, cosx, &sens_d, &sens_q);
             loop->control->method.currentd_pid(ref_d, sens_d, &loop->control->cfg->currentd_pid_cfg, &ud);
             loop->control->method.currentq_pid(ref_q, sens_q, &loop->control->cfg->currentq_pid_cfg, &uq);
     #if defined(MCL_CFG_EN_THETA_FORECAST) && MCL_CFG_EN_THETA_FORECAST
-            sinx_ = loop->control->method.sin_x(theta_forecast);
-            cosx_ = loop->control->method.cos_x(theta_forecast);
+            hpm_mcl_loop_sincos(loop->control, theta_forecast, &sinx_, &cosx_);
             loop->control->method.invpark(ud, uq, sinx_, cosx_, &alpha, &beta);
     #else
             loop->control->method.invpark(ud, uq, sinx, cosx, &alpha, &beta);
@@ -209,13 +217,11 @@ hpm_mcl_stat_t hpm_mcl_step_loop(mcl_loop_t *loop)
         MCL_VALUE_SET_IF_TRUE(loop->ref_id.enable, ref_d, loop->ref_id.value);
         alpha = ia;
         beta = ib;
-        sinx = loop->control->method.sin_x(theta);
-        cosx = loop->control->method.cos_x(theta);
+        hpm_mcl_loop_sincos(loop->control, theta, &sinx, &cosx);
         loop->control->method.park(alpha, beta, sinx, cosx, &sens_d, &sens_q);
         loop->control->method.currentd_pid(ref_d, sens_d, &loop->control->cfg->currentd_pid_cfg, &ud);
         loop->control->method.currentq_pid(0, sens_q, &loop->control->cfg->currentq_pid_cfg, &uq);
-        sinx_ = loop->control->method.sin_x(theta_);
-        cosx_ = loop->control->method.cos_x(theta_);
+        hpm_mcl_loop_sincos(loop->control, theta_, &sinx_, &cosx_);
         loop->control->method.invpark(ud, uq, sinx_, cosx_, &alpha, &beta);
         loop->control->method.step_svpwm(alpha, beta, *loop->const_vbus, &duty);
         hpm_mcl_drivers_update_step_duty(loop->drivers, duty.a0, duty.a1, duty.b0, duty.b1);
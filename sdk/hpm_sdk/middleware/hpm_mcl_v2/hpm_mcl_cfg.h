@@ -11,4 +11,34 @@
 #define MCL_CFG_EN_THETA_FORECAST   (1)
 #endif
 
+/**
+ * @brief Trigonometric backend of the control module
+ *
+ * MCL_MATH_BACKEND_LIBM: sinf/cosf/atan2f
+ * MCL_MATH_BACKEND_LUT: table with linear interpolation for sin/cos, polynomial for atan2
+ */
+#define MCL_MATH_BACKEND_LIBM       (0)
+#define MCL_MATH_BACKEND_LUT        (1)
+
+#ifndef MCL_CFG_MATH_BACKEND
+#define MCL_CFG_MATH_BACKEND        MCL_MATH_BACKEND_LIBM
+#endif
+
+/**
+ * @brief The sine table holds 2^MCL_CFG_MATH_SIN_LUT_BITS points per turn
+ *        interpolation error is about 2e-5 with 9 bits and drops by 4 per extra bit
+ *
+ */
+#ifndef MCL_CFG_MATH_SIN_LUT_BITS
+#define MCL_CFG_MATH_SIN_LUT_BITS   (9)
+#endif
+
+/**
+ * @brief Q31 fixed-point trigonometric and transform functions
+ *
+ */
+#ifndef MCL_CFG_EN_MATH_Q31
+#define MCL_CFG_EN_MATH_Q31         (0)
+#endif
+
 #endif
@@ -6,6 +6,7 @@
  */
 #ifndef HPM_MCL_MATH_H
 #define HPM_MCL_MATH_H
+#include <stdint.h>
 #include "hpm_mcl_cfg.h"
 
 /**
@@ -18,4 +19,104 @@ typedef float hpm_mcl_type_t;
 typedef int32_t hpm_mcl_type_t;
 #endif
 
+#define MCL_MATH_SIN_LUT_SIZE   (1UL << MCL_CFG_MATH_SIN_LUT_BITS)
+
+/**
+ * @brief Q31 angle, a full turn is 2^32 so the angle wraps with the integer
+ *
+ */
+typedef uint32_t mcl_q31_angle_t;
+
+#define MCL_Q31_ONE             (0x7FFFFFFF)
+#define MCL_Q31_MUL(a, b)       ((int32_t)(((int64_t)(a) * (b)) >> 31))
+#define MCL_Q31_SAT(x)          ((int32_t)(((x) > MCL_Q31_ONE) ? MCL_Q31_ONE : (((x) < -MCL_Q31_ONE) ? -MCL_Q31_ONE : (x))))
+#define MCL_FLOAT_TO_Q31(x)     ((int32_t)MCL_Q31_SAT((int64_t)((x) * 2147483648.0f)))
+#define MCL_Q31_TO_FLOAT(x)     ((float)(x) * (1.0f / 2147483648.0f))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Build the sine tables, called by hpm_mcl_control_init
+ *
+ */
+void hpm_mcl_math_init(void);
+
+/**
+ * @brief Sine by table lookup with linear interpolation
+ *
+ * @param x angle in radians, any value
+ * @return float
+ */
+float hpm_mcl_math_sin(float x);
+
+/**
+ * @brief Cosine by table lookup with linear interpolation
+ *
+ * @param x angle in radians, any value
+ * @return float
+ */
+float hpm_mcl_math_cos(float x);
+
+/**
+ * @brief Sine and cosine of the same angle from one index computation
+ *
+ * @param x angle in radians, any value
+ * @param sin_x sine
+ * @param cos_x cosine
+ */
+void hpm_mcl_math_sincos(float x, float *sin_x, float *cos_x);
+
+/**
+ * @brief Four quadrant arctangent by a polynomial, max error about 1e-5 rad
+ *
+ * @param y y
+ * @param x x
+ * @return float angle in (-pi, pi]
+ */
+float hpm_mcl_math_atan2(float y, float x);
+
+#if defined(MCL_CFG_EN_MATH_Q31) && MCL_CFG_EN_MATH_Q31
+/**
+ * @brief Q31 sine and cosine
+ *
+ * @param angle @ref mcl_q31_angle_t
+ * @param sin_x Q31 sine
+ * @param cos_x Q31 cosine
+ */
+void hpm_mcl_math_sincos_q31(mcl_q31_angle_t angle, int32_t *sin_x, int32_t *cos_x);
+
+/**
+ * @brief Q31 four quadrant arctangent
+ *
+ * @param y Q31 y
+ * @param x Q31 x
+ * @return mcl_q31_angle_t
+ */
+mcl_q31_angle_t hpm_mcl_math_atan2_q31(int32_t y, int32_t x);
+
+/**
+ * @brief Q31 clarke transformation, saturated
+ *
+ */
+void hpm_mcl_math_clarke_q31(int32_t ia, int32_t ib, int32_t *alpha, int32_t *beta);
+
+/**
+ * @brief Q31 park transformation, saturated
+ *
+ */
+void hpm_mcl_math_park_q31(int32_t alpha, int32_t beta, int32_t sin_x, int32_t cos_x, int32_t *d, int32_t *q);
+
+/**
+ * @brief Q31 inverse park transformation, saturated
+ *
+ */
+void hpm_mcl_math_inv_park_q31(int32_t d, int32_t q, int32_t sin_x, int32_t cos_x, int32_t *alpha, int32_t *beta);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -13,8 +13,15 @@
 extern "C" {
 #endif /* __cplusplus  */
 
+/* crc32 (ieee 802.3) of one buffer */
 uint32_t crc32(const uint8_t *buf, uint32_t len);
 
+/*
+ * continue a crc32 over a stream, start with crc = 0 and pass the previous
+ * result back in: crc32_update(crc32(a, n), b, m) == crc32 of a followed by b
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t *buf, uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus  */
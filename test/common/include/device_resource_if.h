@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the HDF device resource (HCS) interface, backed by HpmTestProp tables */
+
+#ifndef DEVICE_RESOURCE_IF_H
+#define DEVICE_RESOURCE_IF_H
+
+#include "hdf_base.h"
+
+struct HpmTestProp;
+
+struct DeviceResourceNode {
+    const char *name;
+    const struct HpmTestProp *props;
+};
+
+typedef enum {
+    HDF_CONFIG_SOURCE = 0,
+    INVALID_CONFIG_SOURCE,
+} DeviceResourceType;
+
+struct DeviceResourceIface {
+    bool (*GetBool)(const struct DeviceResourceNode *node, const char *attrName);
+    int32_t (*GetUint8)(const struct DeviceResourceNode *node, const char *attrName, uint8_t *value, uint8_t def);
+    int32_t (*GetUint16)(const struct DeviceResourceNode *node, const char *attrName, uint16_t *value,
+                         uint16_t def);
+    int32_t (*GetUint32)(const struct DeviceResourceNode *node, const char *attrName, uint32_t *value,
+                         uint32_t def);
+    int32_t (*GetString)(const struct DeviceResourceNode *node, const char *attrName, const char **value,
+                         const char *def);
+};
+
+struct DeviceResourceIface *DeviceResourceGetIfaceInstance(DeviceResourceType type);
+
+#endif
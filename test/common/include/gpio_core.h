@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/* Host stand-in for the HDF gpio core, see gpio_core.c */
+
+#ifndef GPIO_CORE_H
+#define GPIO_CORE_H
+
+#include "hdf_device_desc.h"
+#include "gpio_if.h"
+
+struct PlatformDevice {
+    struct HdfDeviceObject *hdfDev;
+};
+
+struct GpioCntlr;
+
+struct GpioMethod {
+    int32_t (*request)(struct GpioCntlr *cntlr, uint16_t local);
+    int32_t (*release)(struct GpioCntlr *cntlr, uint16_t local);
+    int32_t (*write)(struct GpioCntlr *cntlr, uint16_t local, uint16_t val);
+    int32_t (*read)(struct GpioCntlr *cntlr, uint16_t local, uint16_t *val);
+    int32_t (*setDir)(struct GpioCntlr *cntlr, uint16_t local, uint16_t dir);
+    int32_t (*getDir)(struct GpioCntlr *cntlr, uint16_t local, uint16_t *dir);
+    int32_t (*toIrq)(struct GpioCntlr *cntlr, uint16_t local, uint16_t *irq);
+    int32_t (*setIrq)(struct GpioCntlr *cntlr, uint16_t local, uint16_t mode);
+    int32_t (*unsetIrq)(struct GpioCntlr *cntlr, uint16_t local);
+    int32_t (*enableIrq)(struct GpioCntlr *cntlr, uint16_t local);
+    int32_t (*disableIrq)(struct GpioCntlr *cntlr, uint16_t local);
+};
+
+struct GpioCntlr {
+    struct PlatformDevice device;
+    struct GpioMethod *ops;
+    uint16_t start;
+    uint16_t count;
+    void *priv;
+};
+
+static inline void PlatformDeviceSetHdfDev(struct PlatformDevice *device, struct HdfDeviceObject *hdfDev)
+{
+    device->hdfDev = hdfDev;
+    hdfDev->priv = device;
+}
+
+int32_t GpioCntlrAdd(struct GpioCntlr *cntlr);
+void GpioCntlrRemove(struct GpioCntlr *cntlr);
+struct GpioCntlr *GpioCntlrFromHdfDev(const struct HdfDeviceObject *device);
+/* Called by the drivers from their isr, runs the GpioSetIrq handler of the pin */
+int32_t GpioCntlrIrqCallback(struct GpioCntlr *cntlr, uint16_t local);
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/* Host stand-in for the HDF gpio interface */
+
+#ifndef GPIO_IF_H
+#define GPIO_IF_H
+
+#include <stdint.h>
+
+enum GpioValue {
+    GPIO_VAL_LOW = 0,
+    GPIO_VAL_HIGH = 1,
+    GPIO_VAL_ERR,
+};
+
+enum GpioDirType {
+    GPIO_DIR_IN = 0,
+    GPIO_DIR_OUT = 1,
+    GPIO_DIR_ERR,
+};
+
+#define GPIO_IRQ_TRIGGER_RISING 0x1
+#define GPIO_IRQ_TRIGGER_FALLING 0x2
+#define GPIO_IRQ_TRIGGER_HIGH 0x4
+#define GPIO_IRQ_TRIGGER_LOW 0x8
+#define GPIO_IRQ_USING_THREAD (0x1 << 8)
+
+typedef int32_t (*GpioIrqFunc)(uint16_t gpio, void *data);
+
+int32_t GpioRead(uint16_t gpio, uint16_t *val);
+int32_t GpioWrite(uint16_t gpio, uint16_t val);
+int32_t GpioSetDir(uint16_t gpio, uint16_t dir);
+int32_t GpioSetIrq(uint16_t gpio, uint16_t mode, GpioIrqFunc func, void *arg);
+int32_t GpioUnsetIrq(uint16_t gpio, void *arg);
+int32_t GpioEnableIrq(uint16_t gpio);
+int32_t GpioDisableIrq(uint16_t gpio);
+
+#endif
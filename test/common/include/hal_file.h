@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the file HAL interface in commonlibrary/utils_lite */
+
+#ifndef HAL_FILE_H
+#define HAL_FILE_H
+
+int HalFileOpen(const char *path, int oflag, int mode);
+int HalFileClose(int fd);
+int HalFileRead(int fd, char *buf, unsigned int len);
+int HalFileWrite(int fd, const char *buf, unsigned int len);
+int HalFileDelete(const char *path);
+int HalFileStat(const char *path, unsigned int *fileSize);
+int HalFileSeek(int fd, int offset, unsigned int whence);
+
+#endif
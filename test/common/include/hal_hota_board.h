@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the update HAL interface in base/update/ota_lite */
+
+#ifndef HAL_HOTA_BOARD_H
+#define HAL_HOTA_BOARD_H
+
+#include "los_compiler.h"
+
+#define OHOS_SUCCESS 0
+#define OHOS_FAILURE (-1)
+
+#define ABILITY_PKG_SEARCH 0x00000001
+#define ABILITY_PKG_DLOAD  0x00000002
+
+typedef struct {
+    const char *componentName;
+    const char *imgPath;
+    unsigned int startAddr;
+    unsigned int imgSize;
+} ComponentTableInfo;
+
+typedef struct {
+    int otaStatus;
+} UpdateMetaData;
+
+int HotaHalInit(void);
+int HotaHalGetUpdateIndex(unsigned int *index);
+int HotaHalDeInit(void);
+int HotaHalRead(int partition, unsigned int offset, unsigned int bufLen, unsigned char *buffer);
+int HotaHalWrite(int partition, unsigned char *buffer, unsigned int offset, unsigned int bufLen);
+int HotaHalRestart(void);
+int HotaHalSetBootSettings(void);
+int HotaHalRollback(void);
+const ComponentTableInfo *HotaHalGetPartitionInfo(void);
+unsigned char *HotaHalGetPubKey(unsigned int *length);
+int HotaHalGetUpdateAbility(void);
+int HotaHalGetOtaPkgPath(char *path, int len);
+int HotaHalIsDeviceCanReboot(void);
+int HotaHalGetMetaData(UpdateMetaData *metaData);
+int HotaHalSetMetaData(UpdateMetaData *metaData);
+int HotaHalRebootAndCleanUserData(void);
+int HotaHalRebootAndCleanCache(void);
+int HotaHalIsDevelopMode(void);
+int HotaHalCheckVersionValid(const char *currentVersion, const char *pkgVersion, unsigned int pkgVersionLength);
+
+#endif
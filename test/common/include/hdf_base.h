@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the HDF base definitions used by the drivers */
+
+#ifndef HDF_BASE_H
+#define HDF_BASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    HDF_SUCCESS = 0,
+    HDF_FAILURE = -1,
+    HDF_ERR_NOT_SUPPORT = -2,
+    HDF_ERR_INVALID_PARAM = -3,
+    HDF_ERR_INVALID_OBJECT = -4,
+    HDF_ERR_MALLOC_FAIL = -6,
+    HDF_ERR_TIMEOUT = -7,
+    HDF_ERR_THREAD_CREATE_FAIL = -10,
+    HDF_ERR_QUEUE_FULL = -15,
+    HDF_ERR_DEVICE_BUSY = -16,
+    HDF_ERR_IO = -17,
+    HDF_ERR_BAD_FD = -18,
+    HDF_ERR_NOPERM = -19,
+} HDF_STATUS;
+
+#define HDF_WAIT_FOREVER 0xFFFFFFFF
+
+#endif
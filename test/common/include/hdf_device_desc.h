@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the HDF driver entry and device object */
+
+#ifndef HDF_DEVICE_DESC_H
+#define HDF_DEVICE_DESC_H
+
+#include "hdf_base.h"
+#include "device_resource_if.h"
+
+struct HdfObject {
+    int32_t objectId;
+};
+
+struct HdfDeviceIoClient;
+struct HdfSBuf;
+
+struct IDeviceIoService {
+    struct HdfObject object;
+    int32_t (*Open)(struct HdfDeviceIoClient *client);
+    int32_t (*Dispatch)(struct HdfDeviceIoClient *client, int cmdId, struct HdfSBuf *data, struct HdfSBuf *reply);
+    void (*Release)(struct HdfDeviceIoClient *client);
+};
+
+struct HdfDeviceObject {
+    struct IDeviceIoService *service;
+    const struct DeviceResourceNode *property;
+    void *priv;
+};
+
+struct HdfDriverEntry {
+    int32_t moduleVersion;
+    const char *moduleName;
+    int32_t (*Bind)(struct HdfDeviceObject *deviceObject);
+    int32_t (*Init)(struct HdfDeviceObject *deviceObject);
+    void (*Release)(struct HdfDeviceObject *deviceObject);
+};
+
+/* The tests call the entries directly */
+#define HDF_INIT(module) extern struct HdfDriverEntry module
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the HDF log macros, see HpmTestLog() */
+
+#ifndef HDF_LOG_H
+#define HDF_LOG_H
+
+#include "hpm_test.h"
+
+#define HDF_LOG_TAG_STR(tag) #tag
+#define HDF_LOG_TAG_XSTR(tag) HDF_LOG_TAG_STR(tag)
+
+#define HDF_LOGE(fmt, ...) HpmTestLog('E', HDF_LOG_TAG_XSTR(HDF_LOG_TAG), fmt, ##__VA_ARGS__)
+#define HDF_LOGW(fmt, ...) HpmTestLog('W', HDF_LOG_TAG_XSTR(HDF_LOG_TAG), fmt, ##__VA_ARGS__)
+#define HDF_LOGI(fmt, ...) HpmTestLog('I', HDF_LOG_TAG_XSTR(HDF_LOG_TAG), fmt, ##__VA_ARGS__)
+#define HDF_LOGD(fmt, ...) HpmTestLog('D', HDF_LOG_TAG_XSTR(HDF_LOG_TAG), fmt, ##__VA_ARGS__)
+#define HDF_LOGV(fmt, ...) HpmTestLog('V', HDF_LOG_TAG_XSTR(HDF_LOG_TAG), fmt, ##__VA_ARGS__)
+
+#endif
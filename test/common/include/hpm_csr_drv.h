@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host shadow of the SDK hpm_csr_drv.h: the core cycle counter is read from
+ * the machine timer model, see mchtmr_model.c.
+ */
+
+#ifndef HPM_TEST_CSR_DRV_H
+#define HPM_TEST_CSR_DRV_H
+
+#define hpm_csr_get_core_cycle hpm_test_csr_get_core_cycle
+#include_next "hpm_csr_drv.h"
+#undef hpm_csr_get_core_cycle
+
+uint64_t hpm_csr_get_core_cycle(void);
+
+#endif
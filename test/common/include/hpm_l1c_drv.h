@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host shadow of the SoC hpm_l1c_drv.h: the inline csr accessors are replaced by
+ * a cache model, see l1c.c. Maintenance operations are counted and checked for
+ * cache line alignment, the host memory itself is always coherent.
+ */
+
+#ifndef HPM_TEST_L1C_DRV_H
+#define HPM_TEST_L1C_DRV_H
+
+#define l1c_dc_is_enabled hpm_test_soc_l1c_dc_is_enabled
+#define l1c_ic_is_enabled hpm_test_soc_l1c_ic_is_enabled
+#include_next "hpm_l1c_drv.h"
+#undef l1c_dc_is_enabled
+#undef l1c_ic_is_enabled
+
+bool l1c_dc_is_enabled(void);
+bool l1c_ic_is_enabled(void);
+
+struct HpmTestCacheStats {
+    uint32_t writeback;
+    uint32_t invalidate;
+    uint32_t flush;
+    uint32_t misaligned;
+};
+
+void HpmTestCacheEnable(bool enable);
+void HpmTestCacheStats(struct HpmTestCacheStats *stats);
+
+#endif
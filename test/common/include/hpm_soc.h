@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host shadow of the SoC hpm_soc.h, which pulls in hpm_interrupt.h: the csr
+ * based global interrupt control maps onto the LOS interrupt lock
+ * (interrupt.c), and the vector table glue is dropped, the tests
+ * route interrupts through LOS_HwiCreate. WFI() from hpm_common.h runs
+ * the models up to the next event.
+ */
+
+#ifndef HPM_TEST_SOC_H
+#define HPM_TEST_SOC_H
+
+#include <stdint.h>
+
+
+#define enable_global_irq hpm_test_soc_enable_global_irq
+#define disable_global_irq hpm_test_soc_disable_global_irq
+#define restore_global_irq hpm_test_soc_restore_global_irq
+#define enable_irq_from_intc hpm_test_soc_enable_irq_from_intc
+#define disable_irq_from_intc hpm_test_soc_disable_irq_from_intc
+#define enable_mchtmr_irq hpm_test_soc_enable_mchtmr_irq
+#define disable_mchtmr_irq hpm_test_soc_disable_mchtmr_irq
+#define intc_m_enable_swi hpm_test_soc_intc_m_enable_swi
+#define intc_m_disable_swi hpm_test_soc_intc_m_disable_swi
+#include_next "hpm_soc.h"
+#undef enable_global_irq
+#undef disable_global_irq
+#undef restore_global_irq
+#undef enable_irq_from_intc
+#undef disable_irq_from_intc
+#undef enable_mchtmr_irq
+#undef disable_mchtmr_irq
+#undef intc_m_enable_swi
+#undef intc_m_disable_swi
+
+/* wfi sleeps in virtual time until the next model event, then takes the pending interrupts */
+#undef WFI
+#define WFI() HpmTestWfi()
+
+#undef SDK_DECLARE_EXT_ISR_M
+#undef SDK_DECLARE_MCHTMR_ISR
+#undef SDK_DECLARE_SWI_ISR
+#define SDK_DECLARE_EXT_ISR_M(irq_num, isr) void hpm_test_isr_decl_##isr(void)
+#define SDK_DECLARE_MCHTMR_ISR(isr) void hpm_test_isr_decl_##isr(void)
+#define SDK_DECLARE_SWI_ISR(isr) void hpm_test_isr_decl_##isr(void)
+
+void enable_global_irq(uint32_t mask);
+uint32_t disable_global_irq(uint32_t mask);
+void restore_global_irq(uint32_t mask);
+void enable_irq_from_intc(void);
+void disable_irq_from_intc(void);
+void enable_mchtmr_irq(void);
+void disable_mchtmr_irq(void);
+void intc_m_enable_swi(void);
+void intc_m_disable_swi(void);
+void HpmTestWfi(void);
+
+#endif
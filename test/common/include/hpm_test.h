@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HPM_TEST_H
+#define HPM_TEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Checks: a failed check is reported and counted, the test keeps going.
+ * main() returns HpmTestResult().
+ */
+#define HPM_TEST_CHECK(cond) HpmTestCheck((cond), #cond, __FILE__, __LINE__)
+#define HPM_TEST_CHECK_EQ(a, b) HpmTestCheckEq((long long)(a), (long long)(b), #a, #b, __FILE__, __LINE__)
+
+bool HpmTestCheck(bool ok, const char *expr, const char *file, int line);
+bool HpmTestCheckEq(long long a, long long b, const char *exprA, const char *exprB, const char *file, int line);
+int HpmTestResult(void);
+
+/* Quick runs for ctest, full runs when HPM_TEST_FULL is set in the environment */
+bool HpmTestFull(void);
+
+/* Host monotonic clock, for measuring the cpu cost of the code under test */
+uint64_t HpmTestHostNs(void);
+
+/* Deterministic pseudo random numbers */
+uint32_t HpmTestRand(uint32_t *state);
+
+/*
+ * Virtual time. While it is on, the peripheral models are the only clock:
+ * OSAL/LOS waits and sleeps run the models until the wait is over instead of
+ * blocking, register accesses cost HpmTestMmioCostNs() each, and the code
+ * between them runs in zero time. Single threaded only.
+ */
+struct HpmTestModel {
+    const char *name;
+    /* time of the next event of the model, UINT64_MAX when it has nothing to do */
+    uint64_t (*next)(void *ctx);
+    /* handle the events due at HpmTestNowNs() */
+    void (*run)(void *ctx);
+    void *ctx;
+    struct HpmTestModel *link;
+};
+
+void HpmTestVirtualTime(bool enable);
+bool HpmTestIsVirtualTime(void);
+uint64_t HpmTestNowNs(void);
+void HpmTestModelAdd(struct HpmTestModel *model);
+void HpmTestModelRemove(struct HpmTestModel *model);
+/* Run the models and deliver their interrupts until <untilNs> */
+void HpmTestRunUntil(uint64_t untilNs);
+/* Same, but return early (true) once done(arg) holds */
+bool HpmTestRunUntilDone(uint64_t untilNs, bool (*done)(void *arg), void *arg);
+/* Charge cpu time to the virtual clock, e.g. for work done in a benchmark loop */
+void HpmTestCpuNs(uint64_t ns);
+/* wfi: run the next model event and deliver the interrupts it raised, WFI() maps to it */
+void HpmTestWfi(void);
+
+/*
+ * Peripheral registers. The SoC register windows are mapped at their target
+ * addresses, so the unmodified SDK drivers run against them. A modelled window
+ * is kept inaccessible: every cpu access traps into the model, reads are filled
+ * in by read() right before the access and writes are handed to write() right
+ * after it. Unmodelled registers behave as plain memory.
+ */
+struct HpmTestMmioOps {
+    /* value a read at <offset> returns, without side effects */
+    uint32_t (*read)(void *ctx, uint32_t offset);
+    /* side effects of a cpu or dma read at <offset>, may be NULL */
+    void (*readDone)(void *ctx, uint32_t offset);
+    void (*write)(void *ctx, uint32_t offset, uint32_t value);
+    /* a dma write of <width> bytes, may be NULL to take it as a cpu write() */
+    void (*busWrite)(void *ctx, uint32_t offset, uint32_t value, uint32_t width);
+};
+
+void HpmTestMmioMap(uint32_t base, uint32_t size, const struct HpmTestMmioOps *ops, void *ctx);
+void HpmTestMmioUnmap(uint32_t base);
+/* Virtual time one cpu register access takes, 0 disables the charge */
+void HpmTestMmioCostNs(uint32_t ns);
+/* Cpu register accesses so far */
+uint64_t HpmTestMmioAccesses(void);
+/* Bus master (dma) accesses, to memory or through the models */
+uint32_t HpmTestBusRead(uint32_t addr, uint32_t width);
+void HpmTestBusWrite(uint32_t addr, uint32_t value, uint32_t width);
+
+/*
+ * Interrupts. LOS_IntLock and the simulated isrs exclude each other through one
+ * recursive lock, as on a single core. A model asserts an interrupt through its
+ * pending() callback; the handler installed with LOS_HwiCreate runs when the
+ * interrupt is enabled and unlocked, at the next wait, LOS_IntRestore or
+ * HpmTestIrqDeliver(), and again for as long as pending() holds.
+ */
+void HpmTestIrqSource(uint32_t losIrq, bool (*pending)(void *ctx), void *ctx);
+void HpmTestIrqDeliver(void);
+bool HpmTestInIrq(void);
+/* Run the handler of <losIrq> now, as if it was pending */
+bool HpmTestIrqRaise(uint32_t losIrq);
+bool HpmTestIrqInstalled(uint32_t losIrq);
+uint32_t HpmTestIrqCount(uint32_t losIrq);
+/* Make the next <count> LOS_HwiCreate calls fail */
+void HpmTestHwiCreateFail(uint32_t count);
+/* Time interrupts were locked, longest single section and total */
+void HpmTestIntLockStats(uint64_t *maxNs, uint64_t *totalNs, uint32_t *count);
+void HpmTestIntLockStatsReset(void);
+
+/* Device tree properties handed to the HDF drivers */
+struct HpmTestProp {
+    const char *name;
+    uint32_t value;
+    const char *str;
+};
+
+struct HdfDeviceObject;
+struct HdfDeviceObject *HpmTestDeviceCreate(const struct HpmTestProp *props);
+void HpmTestDeviceDestroy(struct HdfDeviceObject *device);
+
+/* OSAL and LOS_MemAlloc heap accounting */
+uint32_t HpmTestMemInUse(void);
+
+/*
+ * LiteOS-M tasks. A task created with LOS_TaskCreate() has its own thread but
+ * only runs when the test hands it the cpu: HpmTestTaskRun() runs each ready
+ * task until it blocks in a LOS wait, as a lower priority task would get
+ * the cpu once the test task sleeps. The test itself must not hold the
+ * interrupt lock across it. HpmTestTaskRunUntilDone() also runs the clock,
+ * so timed waits expire and interrupts wake the tasks; the LOS waits of the
+ * test itself go through it.
+ */
+void HpmTestTaskRun(void);
+bool HpmTestTaskRunUntilDone(uint64_t untilNs, bool (*done)(void *arg), void *arg);
+/* Tasks created and not yet deleted */
+uint32_t HpmTestTaskCount(void);
+
+/* Console output written with UartPutc() since the last reset */
+const char *HpmTestConsole(void);
+void HpmTestConsoleReset(void);
+/* Console characters written while interrupts were locked */
+uint32_t HpmTestConsoleLocked(void);
+
+/* Driver log output is printed when HPM_TEST_LOG is set in the environment */
+void HpmTestLog(char level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * CRC peripheral model: 8 channels with the crc32 preset or a custom poly,
+ * init, xorout and reflection. The cpu feeds DATA a byte at a time, as
+ * crc_calc_block_bytes does, dma writes feed as many bytes as they are wide,
+ * least significant first.
+ */
+
+#ifndef HPM_TEST_CRC_H
+#define HPM_TEST_CRC_H
+
+#include "hpm_test.h"
+
+#define HPM_TEST_CRC_CHANNELS 8U
+
+struct HpmTestCrcChannel {
+    uint32_t preset;
+    uint32_t poly;
+    uint32_t init;
+    uint32_t xorout;
+    uint32_t misc;
+    uint32_t state;
+    /* bytes fed by the cpu and by dma since the last clear */
+    uint32_t cpuBytes;
+    uint32_t dmaBytes;
+};
+
+struct HpmTestCrc {
+    uint32_t base;
+    struct HpmTestCrcChannel chn[HPM_TEST_CRC_CHANNELS];
+};
+
+void HpmTestCrcModelInit(struct HpmTestCrc *crc, uint32_t base);
+void HpmTestCrcModelDeinit(struct HpmTestCrc *crc);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * DMA (HDMA, XDMA) and DMAMUX model. Channels run their descriptor chains over
+ * the bus in virtual time, one burst per event. A handshake side waits for the
+ * request line of the DMAMUX source routed to the channel.
+ *
+ * Terminal count: the status bit is set at the end of every descriptor whose
+ * TC interrupt is unmasked, and at the end of the chain whatever the mask, so
+ * polled channels see their completion. The interrupt line is the OR of the
+ * status bits whose interrupt is unmasked in the channel control.
+ */
+
+#ifndef HPM_TEST_DMA_H
+#define HPM_TEST_DMA_H
+
+#include "hpm_test.h"
+
+void HpmTestDmaModelInit(void);
+void HpmTestDmaModelDeinit(void);
+
+/* Request line of DMAMUX source <src>, asserted while request(ctx) holds */
+void HpmTestDmaRequest(uint8_t src, bool (*request)(void *ctx), void *ctx);
+
+/* Bus timing: fixed cost per burst plus a cost per byte moved */
+void HpmTestDmaTiming(uint32_t nsPerBurst, uint32_t psPerByte);
+
+/* Bytes moved and terminal counts of instance <instance> (0 HDMA, 1 XDMA) so far */
+void HpmTestDmaStats(uint32_t instance, uint64_t *bytes, uint32_t *tc);
+
+/* The handshake channel of <src> stops with a bus error once <bytes> more have moved, one shot */
+void HpmTestDmaFailAfter(uint8_t src, uint32_t bytes);
+/* Bursts that ended in a bus error */
+uint32_t HpmTestDmaErrors(uint32_t instance);
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * File system model for the HAL file layer. Paths under the mount point are
+ * redirected into a scratch directory on the host, and the POSIX calls made on
+ * them are counted. A test links hpm_test_fs, which wraps those calls of the
+ * code under test so they land here. Writes and closes can be made to fail.
+ */
+
+#ifndef HPM_TEST_FS_H
+#define HPM_TEST_FS_H
+
+#include "hpm_test.h"
+
+struct HpmTestFsStats {
+    uint32_t opens;
+    uint32_t closes;
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t seeks;
+    uint64_t writeBytes;
+};
+
+/* Mount a fresh scratch directory at <mount>, e.g. "/data" */
+void HpmTestFsInit(const char *mount);
+/* Remove the scratch directory and everything in it */
+void HpmTestFsDeinit(void);
+void HpmTestFsStats(struct HpmTestFsStats *stats);
+void HpmTestFsStatsReset(void);
+/* Let <okCount> more writes through, then fail the next one with EIO */
+void HpmTestFsFailWrite(uint32_t okCount);
+/* Fail the next close with EIO, the descriptor is closed all the same */
+void HpmTestFsFailClose(void);
+/* Files open under the mount point */
+uint32_t HpmTestFsOpenFiles(void);
+
+#endif
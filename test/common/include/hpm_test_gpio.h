@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * GPIO controller model: input levels driven by the test, edge and level
+ * interrupt flags latched per the TP/PL registers, W1C flag clearing and one
+ * interrupt line per port.
+ */
+
+#ifndef HPM_TEST_GPIO_H
+#define HPM_TEST_GPIO_H
+
+#include "hpm_test.h"
+
+#define HPM_TEST_GPIO_PORTS 16U
+
+struct HpmTestGpioPort {
+    uint32_t di;
+    uint32_t dout;
+    uint32_t oe;
+    uint32_t flags;
+    uint32_t ie;
+    uint32_t pl;
+    uint32_t tp;
+    uint32_t as;
+    uint32_t losIrq;
+};
+
+struct HpmTestGpio {
+    uint32_t base;
+    struct HpmTestGpioPort port[HPM_TEST_GPIO_PORTS];
+    /* called after every cpu read of an interrupt flag register, may be NULL */
+    void (*flagRead)(void *ctx, uint32_t port);
+    void *flagReadCtx;
+    /* statistics */
+    uint64_t edges;
+};
+
+void HpmTestGpioInit(struct HpmTestGpio *gpio, uint32_t base);
+void HpmTestGpioDeinit(struct HpmTestGpio *gpio);
+/* Route the interrupt of <port> to <plicIrq> */
+void HpmTestGpioPortIrq(struct HpmTestGpio *gpio, uint32_t port, uint32_t plicIrq);
+/* Drive the input level of a pin, latching the flag of an enabled edge */
+void HpmTestGpioSetInput(struct HpmTestGpio *gpio, uint32_t port, uint32_t pin, bool high);
+
+/*
+ * Machine timer: MTIME counts virtual time at <hz>. clock_get_frequency()
+ * reports <hz> for every clock.
+ */
+void HpmTestMchtmrInit(uint32_t hz);
+void HpmTestMchtmrDeinit(void);
+uint64_t HpmTestMchtmrTicks(void);
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * I2C master model: 4 byte fifo, START/ADDR/DATA/STOP phases timed from the
+ * SETUP register, DATACNT counting down per byte, the W1C status bits and the
+ * interrupt line. The devices on the bus are callbacks: they ack the address,
+ * ack each byte written and supply each byte read.
+ */
+
+#ifndef HPM_TEST_I2C_H
+#define HPM_TEST_I2C_H
+
+#include "hpm_test.h"
+
+#define HPM_TEST_I2C_FIFO 4U
+
+struct HpmTestI2cBus {
+    /* address phase, returns the ack */
+    bool (*address)(void *ctx, uint16_t addr, bool tenBit, bool read);
+    /* data byte from the master, returns the ack */
+    bool (*write)(void *ctx, uint8_t data);
+    /* data byte to the master */
+    uint8_t (*read)(void *ctx);
+    /* STOP condition, may be NULL */
+    void (*stop)(void *ctx);
+    void *ctx;
+};
+
+enum HpmTestI2cPhase {
+    HPM_TEST_I2C_IDLE = 0,
+    HPM_TEST_I2C_START,
+    HPM_TEST_I2C_ADDR,
+    HPM_TEST_I2C_DATA,
+    HPM_TEST_I2C_STOP,
+};
+
+struct HpmTestI2c {
+    uint32_t base;
+    uint32_t losIrq;
+    uint32_t clkHz;
+    struct HpmTestI2cBus bus;
+    /* fault injection: another master wins the bus at this byte of the bus, 0 never */
+    uint32_t arbLoseAtByte;
+    /* fault injection: a device holds scl low, the transaction never ends */
+    bool stalled;
+    /* registers */
+    uint32_t inten;
+    uint32_t status;
+    uint32_t addr;
+    uint32_t ctrl;
+    uint32_t setup;
+    uint32_t tpm;
+    /* fifo */
+    uint8_t fifo[HPM_TEST_I2C_FIFO];
+    uint32_t fifoHead;
+    uint32_t fifoCount;
+    /* transaction */
+    enum HpmTestI2cPhase phase;
+    bool eventBusy;
+    uint64_t eventNs;
+    uint32_t phases;
+    bool read;
+    uint32_t dataLeft;
+    uint8_t byteOut;
+    bool busHeld;
+    /* statistics */
+    uint32_t transactions;
+    uint32_t starts;
+    uint32_t repeatedStarts;
+    uint32_t stops;
+    uint32_t addrPhases;
+    uint32_t resets;
+    uint64_t bytes;
+    uint64_t bitNs;
+    struct HpmTestModel model;
+};
+
+void HpmTestI2cInit(struct HpmTestI2c *i2c, uint32_t base, uint32_t plicIrq, uint32_t clkHz);
+void HpmTestI2cDeinit(struct HpmTestI2c *i2c);
+
+/* scl the current SETUP register gives */
+uint32_t HpmTestI2cSclHz(const struct HpmTestI2c *i2c);
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * NOR flash array model: erase sets a sector to 0xFF, program can only clear
+ * bits and never crosses a page, erase and program keep the chip busy for
+ * their typical time. Power can be cut after a given number of erase and
+ * program operations: that operation is torn half way and every later one
+ * fails until HpmTestNorPowerOn().
+ */
+
+#ifndef HPM_TEST_NOR_H
+#define HPM_TEST_NOR_H
+
+#include "hpm_test.h"
+
+struct HpmTestNor {
+    uint8_t *mem;
+    uint32_t size;
+    uint32_t sectorSize;
+    uint32_t pageSize;
+    uint64_t eraseNs;
+    uint64_t pageNs;
+    uint64_t busyUntilNs;
+    /* erase and program operations until the power cut, 0 when not armed */
+    uint32_t cutAfter;
+    /* bytes the torn program gets through, UINT32_MAX for half of it */
+    uint32_t cutKeep;
+    bool powerOff;
+    /* statistics */
+    uint32_t reads;
+    uint32_t erases;
+    uint32_t programs;
+    uint64_t busyNs;
+    uint32_t *sectorErases;
+};
+
+/*
+ * Times run on the virtual clock when it is on, on the host clock otherwise,
+ * so the model can back code that polls busy() from its own thread.
+ */
+void HpmTestNorInit(struct HpmTestNor *nor, uint32_t size, uint32_t sectorSize, uint32_t pageSize,
+                    uint64_t eraseNs, uint64_t pageNs);
+void HpmTestNorDeinit(struct HpmTestNor *nor);
+/* 0 on success, -1 on a bad address, a busy chip or no power */
+int32_t HpmTestNorRead(struct HpmTestNor *nor, uint32_t addr, uint8_t *buf, uint32_t len);
+int32_t HpmTestNorErase(struct HpmTestNor *nor, uint32_t addr);
+int32_t HpmTestNorProgram(struct HpmTestNor *nor, uint32_t addr, const uint8_t *buf, uint32_t len);
+bool HpmTestNorBusy(struct HpmTestNor *nor);
+/* Wait out the current operation, on the virtual clock or by sleeping */
+void HpmTestNorWait(struct HpmTestNor *nor);
+/* Tear the <ops>-th erase or program from now, 1 is the next one */
+void HpmTestNorCutAfter(struct HpmTestNor *nor, uint32_t ops);
+/* Same, a torn program gets <keep> bytes through, all of them when it is shorter */
+void HpmTestNorCutAfterKeep(struct HpmTestNor *nor, uint32_t ops, uint32_t keep);
+void HpmTestNorPowerOn(struct HpmTestNor *nor);
+void HpmTestNorStatsReset(struct HpmTestNor *nor);
+
+#endif
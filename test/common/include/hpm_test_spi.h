@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * SPI master model: 4 entry fifos, one data unit per sclk * data length, the
+ * end interrupt and the dma request lines. The device on the bus is a callback
+ * that sees every unit shifted out and returns the unit shifted in.
+ *
+ * Command, address and dummy phases go to the device as byte units ahead of
+ * the data, dummy units with <mosiValid> false. Dual and quad phases take a
+ * half and a quarter of the clocks. With data merge each DATA access carries
+ * four byte units, a short last word is pushed when the data phase ends.
+ */
+
+#ifndef HPM_TEST_SPI_H
+#define HPM_TEST_SPI_H
+
+#include "hpm_test.h"
+
+#define HPM_TEST_SPI_FIFO 4U
+
+struct HpmTestSpi {
+    uint32_t base;
+    uint32_t losIrq;
+    uint32_t clkHz;
+    uint8_t dmaRx;
+    uint8_t dmaTx;
+    /* device on the bus, <mosiValid> is false for units the master only reads */
+    uint32_t (*exchange)(void *ctx, uint32_t mosi, bool mosiValid);
+    void *exchangeCtx;
+    /* the chip select of the controller changed, may be NULL when the device has its own cs */
+    void (*cs)(void *ctx, bool low);
+    /* fault injection: the rx request drops once the transaction ended */
+    bool rxDmaStuck;
+    /* fault injection: sclk stops, the transaction never ends */
+    bool stalled;
+    /* registers */
+    uint32_t transfmt;
+    uint32_t directio;
+    uint32_t transctrl;
+    uint32_t ctrl;
+    uint32_t intren;
+    uint32_t intrst;
+    uint32_t timing;
+    uint32_t addr;
+    /* fifos */
+    uint32_t txFifo[HPM_TEST_SPI_FIFO];
+    uint32_t txHead;
+    uint32_t txCount;
+    uint32_t rxFifo[HPM_TEST_SPI_FIFO];
+    uint32_t rxHead;
+    uint32_t rxCount;
+    /* data merge: byte units taken from the tx head word, shifted into rxWord */
+    uint32_t txSub;
+    uint32_t rxSub;
+    uint32_t rxWord;
+    /* transaction */
+    bool active;
+    bool unitBusy;
+    uint64_t unitDoneNs;
+    uint32_t unitMosi;
+    bool unitMosiValid;
+    bool unitRead;
+    uint32_t wrLeft;
+    uint32_t rdLeft;
+    /* command, address and dummy units still to go, with their clocks */
+    uint8_t preUnit[12];
+    uint8_t preClocks[12];
+    bool preValid[12];
+    uint32_t preHead;
+    uint32_t preCount;
+    /* statistics */
+    uint32_t transactions;
+    uint32_t csAsserts;
+    uint64_t units;
+    uint64_t busyNs;
+    uint64_t activeSinceNs;
+    struct HpmTestModel model;
+};
+
+void HpmTestSpiInit(struct HpmTestSpi *spi, uint32_t base, uint32_t plicIrq, uint32_t clkHz, uint8_t dmaRx,
+                    uint8_t dmaTx);
+void HpmTestSpiDeinit(struct HpmTestSpi *spi);
+
+/* sclk the current TIMING register gives */
+uint32_t HpmTestSpiSclkHz(const struct HpmTestSpi *spi);
+
+#endif
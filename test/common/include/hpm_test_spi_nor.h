@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * SPI NOR flash on the bus of the SPI model: a 24 bit address part with a
+ * JESD216B SFDP table, 1-1-1, 1-1-4 and 1-4-4 reads, 1-1-4 page program,
+ * 4K/32K/64K/chip erase and erase/program suspend. Program and erase start
+ * when cs goes high and keep the chip busy for their time on the virtual
+ * clock. An erased sector only reads 0xFF once the erase is done.
+ *
+ * Commands the part would ignore are counted as protocol errors: anything
+ * but status read or suspend while busy, program or erase without write
+ * enable, data units with cs high, and reads of the range a suspended erase
+ * or program is working on.
+ */
+
+#ifndef HPM_TEST_SPI_NOR_H
+#define HPM_TEST_SPI_NOR_H
+
+#include "hpm_test_spi.h"
+
+#define HPM_TEST_SPI_NOR_PAGE 256U
+
+enum HpmTestSpiNorState {
+    HPM_TEST_SPI_NOR_IDLE,
+    HPM_TEST_SPI_NOR_PROGRAM,
+    HPM_TEST_SPI_NOR_ERASE,
+    HPM_TEST_SPI_NOR_SUSPENDING,
+    HPM_TEST_SPI_NOR_SUSPENDED,
+};
+
+struct HpmTestSpiNor {
+    uint8_t *mem;
+    uint32_t size;
+    uint64_t pageNs;
+    uint64_t sectorNs;
+    uint64_t blockNs;
+    uint64_t suspendNs;
+    /* bus */
+    bool selected;
+    uint32_t units;
+    uint8_t op;
+    uint32_t addr;
+    uint32_t addrUnits;
+    uint32_t dummyUnits;
+    bool ignore;
+    uint8_t page[HPM_TEST_SPI_NOR_PAGE];
+    uint32_t pageLen;
+    /* array */
+    enum HpmTestSpiNorState state;
+    enum HpmTestSpiNorState suspendedState;
+    bool wel;
+    uint64_t doneNs;
+    uint64_t remainNs;
+    uint32_t opAddr;
+    uint32_t opLen;
+    /* statistics */
+    uint32_t protocolErrors;
+    uint32_t badReads;
+    uint32_t commands;
+    uint32_t programs;
+    uint32_t erases;
+    uint32_t suspends;
+    uint64_t readBytes;
+    struct HpmTestModel model;
+};
+
+void HpmTestSpiNorInit(struct HpmTestSpiNor *nor, uint32_t size, uint64_t pageNs, uint64_t sectorNs,
+                       uint64_t blockNs, uint64_t suspendNs);
+void HpmTestSpiNorDeinit(struct HpmTestSpiNor *nor);
+/* Put the part on the bus of <spi>, on the controller cs when <hwCs>, else cs is HpmTestSpiNorSelect() */
+void HpmTestSpiNorAttach(struct HpmTestSpiNor *nor, struct HpmTestSpi *spi, bool hwCs);
+void HpmTestSpiNorSelect(struct HpmTestSpiNor *nor, bool low);
+bool HpmTestSpiNorBusy(const struct HpmTestSpiNor *nor);
+void HpmTestSpiNorStatsReset(struct HpmTestSpiNor *nor);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * 16550 style UART model with 16 byte fifos and a timed line. The far end is
+ * scripted: bytes queued with HpmTestUartRxSend arrive back to back at the
+ * configured baud rate, transmitted bytes are captured with their time.
+ */
+
+#ifndef HPM_TEST_UART_H
+#define HPM_TEST_UART_H
+
+#include "hpm_test.h"
+
+#define HPM_TEST_UART_FIFO 16U
+
+struct HpmTestUartLineByte {
+    uint64_t ns;
+    uint8_t data;
+};
+
+struct HpmTestUart {
+    uint32_t base;
+    uint32_t losIrq;
+    uint32_t clkHz;
+    uint8_t dmaRx;
+    uint8_t dmaTx;
+    /* registers */
+    uint32_t ier;
+    uint32_t lcr;
+    uint32_t fcr;
+    uint32_t oscr;
+    uint32_t dll;
+    uint32_t dlm;
+    uint32_t mcr;
+    uint32_t gpr;
+    /* receiver */
+    uint8_t rxFifo[HPM_TEST_UART_FIFO];
+    uint32_t rxHead;
+    uint32_t rxCount;
+    bool overrun;
+    bool rxTimeout;
+    uint64_t rxActivityNs;
+    struct HpmTestUartLineByte *rxLine;
+    uint32_t rxLineSize;
+    uint32_t rxLineHead;
+    uint32_t rxLineCount;
+    uint64_t rxLastNs;
+    uint64_t rxLost;
+    /* transmitter */
+    uint8_t txFifo[HPM_TEST_UART_FIFO];
+    uint32_t txHead;
+    uint32_t txCount;
+    bool txShifting;
+    uint64_t txDoneNs;
+    uint8_t txShift;
+    uint8_t *txCapture;
+    uint32_t txCaptureSize;
+    uint32_t txCaptured;
+    uint64_t txLastNs;
+    struct HpmTestModel model;
+};
+
+/* <rxLineSize> bytes of far end data can be queued at a time */
+void HpmTestUartInit(struct HpmTestUart *uart, uint32_t base, uint32_t plicIrq, uint32_t clkHz, uint8_t dmaRx,
+                     uint8_t dmaTx, uint32_t rxLineSize);
+void HpmTestUartDeinit(struct HpmTestUart *uart);
+
+/* Time one character takes on the line with the current settings */
+uint64_t HpmTestUartCharNs(const struct HpmTestUart *uart);
+
+/* Queue far end bytes, the first one starts at <startNs> or when the line is free */
+uint32_t HpmTestUartRxSend(struct HpmTestUart *uart, const uint8_t *data, uint32_t len, uint64_t startNs);
+
+/* Time the last queued far end byte is complete on the line */
+uint64_t HpmTestUartRxEndNs(const struct HpmTestUart *uart);
+
+/* Capture transmitted bytes into <buf>, bytes beyond <size> are counted only */
+void HpmTestUartTxCapture(struct HpmTestUart *uart, uint8_t *buf, uint32_t size);
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/* Host stand-in for the HDF i2c core, see i2c_core.c */
+
+#ifndef I2C_CORE_H
+#define I2C_CORE_H
+
+#include "hdf_device_desc.h"
+#include "i2c_if.h"
+
+struct I2cMethod;
+
+struct I2cCntlr {
+    int16_t busId;
+    void *priv;
+    const struct I2cMethod *ops;
+};
+
+struct I2cMethod {
+    int32_t (*transfer)(struct I2cCntlr *cntlr, struct I2cMsg *msgs, int16_t count);
+};
+
+int32_t I2cCntlrAdd(struct I2cCntlr *cntlr);
+void I2cCntlrRemove(struct I2cCntlr *cntlr);
+/* Controller added for <number>, NULL when there is none */
+struct I2cCntlr *I2cCntlrGet(int16_t number);
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/* Host stand-in for the HDF i2c interface definitions */
+
+#ifndef I2C_IF_H
+#define I2C_IF_H
+
+#include <stdint.h>
+
+enum I2cFlag {
+    I2C_FLAG_READ = 0x1,
+    I2C_FLAG_ADDR_10BIT = 0x10,
+    I2C_FLAG_READ_NO_ACK = 0x1000,
+    I2C_FLAG_IGNORE_NO_ACK = 0x2000,
+    I2C_FLAG_NO_START = 0x4000,
+    I2C_FLAG_STOP = 0x8000,
+};
+
+struct I2cMsg {
+    uint16_t addr;
+    uint8_t *buf;
+    uint16_t len;
+    uint16_t flags;
+};
+
+#endif
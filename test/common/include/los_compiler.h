@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the LiteOS-M base types */
+
+#ifndef _LOS_COMPILER_H
+#define _LOS_COMPILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef unsigned char UINT8;
+typedef unsigned short UINT16;
+typedef unsigned int UINT32;
+typedef unsigned long long UINT64;
+typedef signed char INT8;
+typedef signed short INT16;
+typedef signed int INT32;
+typedef signed long long INT64;
+typedef char CHAR;
+typedef unsigned int BOOL;
+typedef uintptr_t UINTPTR;
+typedef size_t SIZE_T;
+#define VOID void
+
+#ifndef TRUE
+#define TRUE 1U
+#endif
+#ifndef FALSE
+#define FALSE 0U
+#endif
+
+#define LOS_OK 0U
+#define LOS_NOK 1U
+#define LOS_WAIT_FOREVER 0xFFFFFFFF
+#define LOS_NO_WAIT 0
+
+#define STATIC static
+#define INLINE inline
+#define LITE_OS_SEC_TEXT
+#define LITE_OS_SEC_TEXT_INIT
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the LiteOS-M kernel configuration */
+
+#ifndef _LOS_CONFIG_H
+#define _LOS_CONFIG_H
+
+#include "los_compiler.h"
+
+#define LOSCFG_BASE_CORE_TICK_PER_SECOND 1000UL
+#define LOSCFG_BASE_CORE_TSK_MIN_STACK_SIZE 0x500U
+#define OS_SYS_MEM_ADDR ((VOID *)0)
+
+#endif
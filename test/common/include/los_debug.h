@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the LiteOS-M debug api: exception hooks, see los_task.c */
+
+#ifndef LOS_DEBUG_H
+#define LOS_DEBUG_H
+
+#include "los_compiler.h"
+
+typedef enum {
+    EXC_REBOOT,
+    EXC_ASSERT,
+    EXC_PANIC,
+    EXC_STACKOVERFLOW,
+    EXC_INTERRUPT,
+    EXC_TYPE_END
+} EXC_TYPE;
+
+typedef VOID (*ExcHookFn)(EXC_TYPE excType);
+
+UINT32 LOS_RegExcHook(EXC_TYPE excType, ExcHookFn excHookFn);
+UINT32 LOS_UnRegExcHook(EXC_TYPE excType, ExcHookFn excHookFn);
+VOID OsDoExcHook(EXC_TYPE excType);
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the LiteOS-M interrupt api, see los.c and HpmTestIrqRaise() */
+
+#ifndef _LOS_INTERRUPT_H
+#define _LOS_INTERRUPT_H
+
+#include "los_compiler.h"
+#include "soc.h"
+
+typedef UINT32 HWI_HANDLE_T;
+typedef UINT16 HWI_PRIOR_T;
+typedef UINT16 HWI_MODE_T;
+typedef VOID (*HWI_PROC_FUNC)(VOID *parm);
+
+typedef struct tagIrqParam {
+    int swIrq;
+    VOID *pDevId;
+    const CHAR *pName;
+} HwiIrqParam;
+
+#define OS_HWI_MAX_NUM (RISCV_SYS_MAX_IRQ + RISCV_PLIC_VECTOR_CNT)
+
+#define OS_INT_ACTIVE (HpmTestInIrq())
+#define OS_INT_INACTIVE (!(OS_INT_ACTIVE))
+
+UINT32 LOS_IntLock(VOID);
+UINT32 LOS_IntUnLock(VOID);
+VOID LOS_IntRestore(UINT32 intSave);
+UINT32 LOS_IntLocked(VOID);
+UINT32 LOS_HwiCreate(HWI_HANDLE_T hwiNum, HWI_PRIOR_T hwiPrio, HWI_MODE_T hwiMode, HWI_PROC_FUNC hwiHandler,
+                     HwiIrqParam *irqParam);
+UINT32 LOS_HwiDelete(HWI_HANDLE_T hwiNum, HwiIrqParam *irqParam);
+UINT32 LOS_HwiEnable(HWI_HANDLE_T hwiNum);
+UINT32 LOS_HwiDisable(HWI_HANDLE_T hwiNum);
+
+#include "hpm_test.h"
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the LiteOS-M memory api on the OSAL heap, see osal.c */
+
+#ifndef _LOS_MEMORY_H
+#define _LOS_MEMORY_H
+
+#include "los_config.h"
+
+VOID *LOS_MemAlloc(VOID *pool, UINT32 size);
+UINT32 LOS_MemFree(VOID *pool, VOID *ptr);
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the LiteOS-M mutex api, see los_task.c */
+
+#ifndef _LOS_MUX_H
+#define _LOS_MUX_H
+
+#include "los_compiler.h"
+
+#define LOS_ERRNO_MUX_TIMEOUT 0x0200190A
+#define LOS_ERRNO_MUX_UNAVAILABLE 0x02001909
+
+UINT32 LOS_MuxCreate(UINT32 *muxHandle);
+UINT32 LOS_MuxDelete(UINT32 muxHandle);
+UINT32 LOS_MuxPend(UINT32 muxHandle, UINT32 timeout);
+UINT32 LOS_MuxPost(UINT32 muxHandle);
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the LiteOS-M queue api, messages are copied, see los_task.c */
+
+#ifndef _LOS_QUEUE_H
+#define _LOS_QUEUE_H
+
+#include "los_compiler.h"
+
+#define LOS_ERRNO_QUEUE_TIMEOUT 0x02000614
+#define LOS_ERRNO_QUEUE_ISFULL 0x02000615
+#define LOS_ERRNO_QUEUE_ISEMPTY 0x0200061D
+
+UINT32 LOS_QueueCreate(const CHAR *queueName, UINT16 len, UINT32 *queueID, UINT32 flags, UINT16 maxMsgSize);
+UINT32 LOS_QueueDelete(UINT32 queueID);
+UINT32 LOS_QueueWriteCopy(UINT32 queueID, VOID *bufferAddr, UINT32 bufferSize, UINT32 timeout);
+UINT32 LOS_QueueReadCopy(UINT32 queueID, VOID *bufferAddr, UINT32 *bufferSize, UINT32 timeout);
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the LiteOS-M semaphore api, see los_task.c */
+
+#ifndef LOS_SEM_H
+#define LOS_SEM_H
+
+#include "los_compiler.h"
+
+#define LOS_ERRNO_SEM_TIMEOUT 0x02000708
+#define LOS_ERRNO_SEM_UNAVAILABLE 0x02000707
+#define LOS_ERRNO_SEM_OVERFLOW 0x02000709
+
+UINT32 LOS_SemCreate(UINT16 count, UINT32 *semHandle);
+UINT32 LOS_BinarySemCreate(UINT16 count, UINT32 *semHandle);
+UINT32 LOS_SemDelete(UINT32 semHandle);
+UINT32 LOS_SemPend(UINT32 semHandle, UINT32 timeout);
+UINT32 LOS_SemPost(UINT32 semHandle);
+
+#endif
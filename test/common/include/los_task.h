@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the LiteOS-M task api, see los_task.c */
+
+#ifndef LOS_TASK_H
+#define LOS_TASK_H
+
+#include "los_compiler.h"
+
+#define OS_TASK_PRIORITY_HIGHEST 0
+#define OS_TASK_PRIORITY_LOWEST 31
+#define LOS_ERRNO_TSK_ID_INVALID 0x02000207
+
+typedef VOID *(*TSK_ENTRY_FUNC)(UINTPTR arg);
+
+typedef struct {
+    TSK_ENTRY_FUNC pfnTaskEntry;
+    UINT16 usTaskPrio;
+    UINTPTR uwArg;
+    UINT32 uwStackSize;
+    CHAR *pcName;
+    UINT32 uwResved;
+} TSK_INIT_PARAM_S;
+
+UINT32 LOS_TaskCreate(UINT32 *taskID, TSK_INIT_PARAM_S *taskInitParam);
+UINT32 LOS_TaskDelete(UINT32 taskID);
+UINT32 LOS_CurTaskIDGet(VOID);
+UINT32 LOS_TaskDelay(UINT32 tick);
+
+#include "hpm_test.h"
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the LiteOS-M tick api, a tick is a millisecond of HpmTestNowNs(), see los_task.c */
+
+#ifndef _LOS_TICK_H
+#define _LOS_TICK_H
+
+#include "los_config.h"
+
+UINT32 LOS_MS2Tick(UINT32 millisec);
+UINT64 LOS_TickCountGet(VOID);
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the OSAL heap, see osal.c */
+
+#ifndef OSAL_MEM_H
+#define OSAL_MEM_H
+
+#include "hdf_base.h"
+
+void *OsalMemAlloc(size_t size);
+void *OsalMemCalloc(size_t size);
+void *OsalMemAllocAlign(size_t alignment, size_t size);
+void OsalMemFree(void *mem);
+
+#endif
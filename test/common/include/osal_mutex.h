@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the OSAL mutex, see osal.c */
+
+#ifndef OSAL_MUTEX_H
+#define OSAL_MUTEX_H
+
+#include "hdf_base.h"
+
+struct OsalMutex {
+    void *realMutex;
+};
+
+int32_t OsalMutexInit(struct OsalMutex *mutex);
+int32_t OsalMutexDestroy(struct OsalMutex *mutex);
+int32_t OsalMutexLock(struct OsalMutex *mutex);
+int32_t OsalMutexTimedLock(struct OsalMutex *mutex, uint32_t ms);
+int32_t OsalMutexUnlock(struct OsalMutex *mutex);
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the OSAL semaphore, see osal.c */
+
+#ifndef OSAL_SEM_H
+#define OSAL_SEM_H
+
+#include "hdf_base.h"
+
+#define OSAL_WAIT_FOREVER 0xFFFFFFFF
+
+struct OsalSem {
+    void *realSem;
+};
+
+int32_t OsalSemInit(struct OsalSem *sem, uint32_t value);
+int32_t OsalSemWait(struct OsalSem *sem, uint32_t ms);
+int32_t OsalSemPost(struct OsalSem *sem);
+int32_t OsalSemDestroy(struct OsalSem *sem);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the OSAL time functions, they follow the virtual time of the models */
+
+#ifndef OSAL_TIME_H
+#define OSAL_TIME_H
+
+#include "hdf_base.h"
+
+typedef struct {
+    uint64_t sec;
+    uint64_t usec;
+} OsalTimespec;
+
+uint64_t OsalGetSysTimeMs(void);
+int32_t OsalGetTime(OsalTimespec *time);
+void OsalSleep(uint32_t sec);
+void OsalMSleep(uint32_t ms);
+void OsalUSleep(uint32_t us);
+void OsalUDelay(uint32_t us);
+void OsalMDelay(uint32_t ms);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the bounds checked libc subset used by the drivers */
+
+#ifndef SECUREC_H
+#define SECUREC_H
+
+#include <stddef.h>
+#include <stdarg.h>
+
+#define EOK 0
+#define ERANGE_AND_RESET 162
+
+typedef int errno_t;
+
+errno_t memcpy_s(void *dest, size_t destMax, const void *src, size_t count);
+errno_t memmove_s(void *dest, size_t destMax, const void *src, size_t count);
+errno_t memset_s(void *dest, size_t destMax, int c, size_t count);
+errno_t strcpy_s(char *strDest, size_t destMax, const char *strSrc);
+errno_t strncpy_s(char *strDest, size_t destMax, const char *strSrc, size_t count);
+errno_t strcat_s(char *strDest, size_t destMax, const char *strSrc);
+int sprintf_s(char *strDest, size_t destMax, const char *format, ...);
+int snprintf_s(char *strDest, size_t destMax, size_t count, const char *format, ...);
+int vsnprintf_s(char *strDest, size_t destMax, size_t count, const char *format, va_list argList);
+
+#endif
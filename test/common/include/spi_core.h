@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the HDF spi core, see spi_core.c */
+
+#ifndef SPI_CORE_H
+#define SPI_CORE_H
+
+#include "hdf_device_desc.h"
+#include "spi_if.h"
+
+struct SpiCntlrMethod;
+
+struct SpiCntlr {
+    struct IDeviceIoService service;
+    struct HdfDeviceObject *device;
+    uint32_t busNum;
+    void *priv;
+    struct SpiCntlrMethod *method;
+};
+
+struct SpiCntlrMethod {
+    int32_t (*GetCfg)(struct SpiCntlr *cntlr, struct SpiCfg *cfg);
+    int32_t (*SetCfg)(struct SpiCntlr *cntlr, struct SpiCfg *cfg);
+    int32_t (*Transfer)(struct SpiCntlr *cntlr, struct SpiMsg *msg, uint32_t count);
+    int32_t (*Open)(struct SpiCntlr *cntlr);
+    int32_t (*Close)(struct SpiCntlr *cntlr);
+};
+
+struct SpiCntlr *SpiCntlrCreate(struct HdfDeviceObject *device);
+void SpiCntlrDestroy(struct SpiCntlr *cntlr);
+
+static inline struct SpiCntlr *SpiCntlrFromDevice(struct HdfDeviceObject *device)
+{
+    return (device == NULL) ? NULL : (struct SpiCntlr *)device->service;
+}
+
+#endif
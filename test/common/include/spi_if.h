@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Host stand-in for the HDF spi interface definitions */
+
+#ifndef SPI_IF_H
+#define SPI_IF_H
+
+#include <stdint.h>
+
+#define SPI_CLK_PHASE (1 << 0)
+#define SPI_CLK_POLARITY (1 << 1)
+#define SPI_MODE_3WIRE (1 << 2)
+#define SPI_MODE_LOOP (1 << 3)
+#define SPI_MODE_LSBFE (1 << 4)
+#define SPI_MODE_NOCS (1 << 5)
+#define SPI_MODE_CS_HIGH (1 << 6)
+#define SPI_MODE_READY (1 << 7)
+
+enum SpiTransferMode {
+    SPI_INTERRUPT_TRANSFER = 0,
+    SPI_POLLING_TRANSFER,
+    SPI_DMA_TRANSFER,
+};
+
+struct SpiMsg {
+    uint8_t *wbuf;
+    uint8_t *rbuf;
+    uint32_t len;
+    uint32_t speed;
+    uint16_t delayUs;
+    uint8_t keepCs;
+};
+
+struct SpiCfg {
+    uint32_t maxSpeedHz;
+    uint16_t mode;
+    uint8_t transferMode;
+    uint8_t bitsPerWord;
+};
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the HDF uart core, see uart_core.c */
+
+#ifndef UART_CORE_H
+#define UART_CORE_H
+
+#include "hdf_device_desc.h"
+#include "uart_if.h"
+
+struct UartHostMethod;
+
+struct UartHost {
+    struct IDeviceIoService service;
+    struct HdfDeviceObject *device;
+    uint32_t num;
+    void *priv;
+    struct UartHostMethod *method;
+};
+
+struct UartHostMethod {
+    int32_t (*Init)(struct UartHost *host);
+    int32_t (*Deinit)(struct UartHost *host);
+    int32_t (*Read)(struct UartHost *host, uint8_t *data, uint32_t size);
+    int32_t (*Write)(struct UartHost *host, uint8_t *data, uint32_t size);
+    int32_t (*GetBaud)(struct UartHost *host, uint32_t *baudRate);
+    int32_t (*SetBaud)(struct UartHost *host, uint32_t baudRate);
+    int32_t (*GetAttribute)(struct UartHost *host, struct UartAttribute *attribute);
+    int32_t (*SetAttribute)(struct UartHost *host, struct UartAttribute *attribute);
+    int32_t (*SetTransMode)(struct UartHost *host, enum UartTransMode mode);
+    int32_t (*pollEvent)(struct UartHost *host, void *filep, void *table);
+};
+
+struct UartHost *UartHostCreate(struct HdfDeviceObject *device);
+void UartHostDestroy(struct UartHost *host);
+
+static inline struct UartHost *UartHostFromDevice(struct HdfDeviceObject *device)
+{
+    return (device == NULL) ? NULL : (struct UartHost *)device->service;
+}
+
+#endif
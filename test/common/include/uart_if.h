@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the HDF uart interface types */
+
+#ifndef UART_IF_H
+#define UART_IF_H
+
+#include "hdf_base.h"
+
+#define UART_ATTR_DATABIT_8 0
+#define UART_ATTR_DATABIT_7 1
+#define UART_ATTR_DATABIT_6 2
+#define UART_ATTR_DATABIT_5 3
+
+#define UART_ATTR_PARITY_NONE 0
+#define UART_ATTR_PARITY_ODD 1
+#define UART_ATTR_PARITY_EVEN 2
+#define UART_ATTR_PARITY_MARK 3
+#define UART_ATTR_PARITY_SPACE 4
+
+#define UART_ATTR_STOPBIT_1 0
+#define UART_ATTR_STOPBIT_1P5 1
+#define UART_ATTR_STOPBIT_2 2
+
+#define UART_ATTR_RTS_DIS 0
+#define UART_ATTR_RTS_EN 1
+#define UART_ATTR_CTS_DIS 0
+#define UART_ATTR_CTS_EN 1
+
+struct UartAttribute {
+    unsigned int dataBits : 4;
+    unsigned int parity : 4;
+    unsigned int stopBits : 4;
+    unsigned int rts : 1;
+    unsigned int cts : 1;
+    unsigned int fifoRxEn : 1;
+    unsigned int fifoTxEn : 1;
+    unsigned int reserved : 16;
+};
+
+enum UartTransMode {
+    UART_MODE_RD_BLOCK = 0,
+    UART_MODE_RD_NONBLOCK,
+    UART_MODE_DMA_RX_EN,
+    UART_MODE_DMA_RX_DIS,
+    UART_MODE_DMA_TX_EN,
+    UART_MODE_DMA_TX_DIS,
+};
+
+#endif
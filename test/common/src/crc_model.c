@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include "hpm_common.h"
+#include "hpm_crc_regs.h"
+#include "hpm_test_crc.h"
+
+#define CRC_MODEL_STRIDE 0x40U
+#define CRC_MODEL_SIZE (HPM_TEST_CRC_CHANNELS * CRC_MODEL_STRIDE)
+#define CRC_MODEL_REG_PRE_SET 0x0U
+#define CRC_MODEL_REG_CLR 0x4U
+#define CRC_MODEL_REG_POLY 0x8U
+#define CRC_MODEL_REG_INIT_DATA 0xCU
+#define CRC_MODEL_REG_XOROUT 0x10U
+#define CRC_MODEL_REG_MISC 0x14U
+#define CRC_MODEL_REG_DATA 0x18U
+#define CRC_MODEL_REG_RESULT 0x1CU
+#define CRC_MODEL_PRESET_CRC32 1U
+
+static uint32_t CrcModelWidth(const struct HpmTestCrcChannel *c)
+{
+    uint32_t width = CRC_CHN_MISC_SETTING_POLY_WIDTH_GET(c->misc);
+
+    return ((width == 0) || (width > 32)) ? 32 : width;
+}
+
+static uint32_t CrcModelReflect(uint32_t v, uint32_t bits)
+{
+    uint32_t r = 0;
+
+    for (uint32_t i = 0; i < bits; i++) {
+        r = (r << 1) | ((v >> i) & 1U);
+    }
+    return r;
+}
+
+static uint32_t CrcModelMask(uint32_t width)
+{
+    return (width == 32) ? 0xFFFFFFFFU : ((1U << width) - 1U);
+}
+
+/* Registers the preset stands for, so the result uses one set of fields */
+static void CrcModelClear(struct HpmTestCrcChannel *c)
+{
+    if (c->preset == CRC_MODEL_PRESET_CRC32) {
+        c->poly = 0x04C11DB7U;
+        c->init = 0xFFFFFFFFU;
+        c->xorout = 0xFFFFFFFFU;
+        c->misc = (c->misc & CRC_CHN_MISC_SETTING_BYTE_REV_MASK) | CRC_CHN_MISC_SETTING_REV_IN_MASK |
+                  CRC_CHN_MISC_SETTING_REV_OUT_MASK | CRC_CHN_MISC_SETTING_POLY_WIDTH_SET(32);
+    }
+    c->state = c->init & CrcModelMask(CrcModelWidth(c));
+    c->cpuBytes = 0;
+    c->dmaBytes = 0;
+}
+
+/* Plain msb first shift register, the input byte reflected when REV_IN is set */
+static void CrcModelByte(struct HpmTestCrcChannel *c, uint8_t byte)
+{
+    uint32_t width = CrcModelWidth(c);
+    uint32_t in = (c->misc & CRC_CHN_MISC_SETTING_REV_IN_MASK) ? CrcModelReflect(byte, 8) : byte;
+
+    for (int i = 7; i >= 0; i--) {
+        uint32_t top = ((c->state >> (width - 1)) ^ (in >> i)) & 1U;
+        c->state = (c->state << 1) & CrcModelMask(width);
+        if (top != 0) {
+            c->state ^= c->poly & CrcModelMask(width);
+        }
+    }
+}
+
+static void CrcModelFeed(struct HpmTestCrcChannel *c, uint32_t value, uint32_t bytes)
+{
+    for (uint32_t i = 0; i < bytes; i++) {
+        uint32_t shift = (c->misc & CRC_CHN_MISC_SETTING_BYTE_REV_MASK) ? (bytes - 1 - i) * 8U : i * 8U;
+        CrcModelByte(c, (uint8_t)(value >> shift));
+    }
+}
+
+static uint32_t CrcModelResult(const struct HpmTestCrcChannel *c)
+{
+    uint32_t width = CrcModelWidth(c);
+    uint32_t r = (c->misc & CRC_CHN_MISC_SETTING_REV_OUT_MASK) ? CrcModelReflect(c->state, width) : c->state;
+
+    return (r ^ c->xorout) & CrcModelMask(width);
+}
+
+static uint32_t CrcModelRead(void *ctx, uint32_t offset)
+{
+    struct HpmTestCrc *crc = ctx;
+    struct HpmTestCrcChannel *c = &crc->chn[offset / CRC_MODEL_STRIDE];
+
+    switch (offset % CRC_MODEL_STRIDE) {
+    case CRC_MODEL_REG_PRE_SET:
+        return c->preset;
+    case CRC_MODEL_REG_POLY:
+        return c->poly;
+    case CRC_MODEL_REG_INIT_DATA:
+        return c->init;
+    case CRC_MODEL_REG_XOROUT:
+        return c->xorout;
+    case CRC_MODEL_REG_MISC:
+        return c->misc;
+    case CRC_MODEL_REG_RESULT:
+        return CrcModelResult(c);
+    default:
+        return 0;
+    }
+}
+
+static void CrcModelAccess(struct HpmTestCrc *crc, uint32_t offset, uint32_t value, uint32_t width)
+{
+    struct HpmTestCrcChannel *c = &crc->chn[offset / CRC_MODEL_STRIDE];
+
+    switch (offset % CRC_MODEL_STRIDE) {
+    case CRC_MODEL_REG_PRE_SET:
+        c->preset = CRC_CHN_PRE_SET_PRE_SET_GET(value);
+        CrcModelClear(c);
+        break;
+    case CRC_MODEL_REG_CLR:
+        if (value & CRC_CHN_CLR_CLR_MASK) {
+            CrcModelClear(c);
+        }
+        break;
+    case CRC_MODEL_REG_POLY:
+        c->poly = value;
+        break;
+    case CRC_MODEL_REG_INIT_DATA:
+        c->init = value;
+        c->state = value & CrcModelMask(CrcModelWidth(c));
+        break;
+    case CRC_MODEL_REG_XOROUT:
+        c->xorout = value;
+        break;
+    case CRC_MODEL_REG_MISC:
+        c->misc = value;
+        break;
+    case CRC_MODEL_REG_DATA:
+        if (width == 0) {
+            CrcModelFeed(c, value, 1);
+            c->cpuBytes++;
+        } else {
+            CrcModelFeed(c, value, width);
+            c->dmaBytes += width;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void CrcModelWrite(void *ctx, uint32_t offset, uint32_t value)
+{
+    CrcModelAccess(ctx, offset, value, 0);
+}
+
+static void CrcModelBusWrite(void *ctx, uint32_t offset, uint32_t value, uint32_t width)
+{
+    CrcModelAccess(ctx, offset, value, width);
+}
+
+static const struct HpmTestMmioOps g_crcOps = {
+    .read = CrcModelRead,
+    .write = CrcModelWrite,
+    .busWrite = CrcModelBusWrite,
+};
+
+void HpmTestCrcModelInit(struct HpmTestCrc *crc, uint32_t base)
+{
+    (void)memset(crc, 0, sizeof(*crc));
+    crc->base = base;
+    HpmTestMmioMap(base, CRC_MODEL_SIZE, &g_crcOps, crc);
+}
+
+void HpmTestCrcModelDeinit(struct HpmTestCrc *crc)
+{
+    HpmTestMmioUnmap(crc->base);
+}
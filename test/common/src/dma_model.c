@@ -0,0 +1,412 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "hpm_soc.h"
+#include "hpm_dma_drv.h"
+#include "soc.h"
+#include "los_interrupt.h"
+#include "hpm_test_dma.h"
+
+#define DMA_MODEL_REG_DMACTRL 0x20U
+#define DMA_MODEL_REG_CHABORT 0x24U
+#define DMA_MODEL_REG_INTSTATUS 0x30U
+#define DMA_MODEL_REG_CHEN 0x34U
+#define DMA_MODEL_REG_CHCTRL 0x40U
+#define DMA_MODEL_CHCTRL_STRIDE 0x20U
+#define DMA_MODEL_SIZE 0x140U
+#define DMA_MODEL_SRC_NUM 128U
+#define DMA_MODEL_BURST_MAX (1024U * 8U)
+
+struct DmaModelChn {
+    uint32_t ctrl;
+    uint32_t transize;
+    uint32_t src;
+    uint32_t dst;
+    uint32_t llp;
+    uint64_t readyNs;
+};
+
+struct DmaModel {
+    DMA_Type *base;
+    uint32_t losIrq;
+    uint32_t muxFirst;
+    uint32_t intstatus;
+    uint64_t bytes;
+    uint32_t tc;
+    uint32_t errors;
+    struct DmaModelChn chn[DMA_SOC_CHANNEL_NUM];
+    struct HpmTestModel model;
+};
+
+struct DmaModelReq {
+    bool (*request)(void *ctx);
+    void *ctx;
+    bool fail;
+    uint32_t failAfter;
+};
+
+static struct DmaModel g_dma[DMA_SOC_MAX_COUNT];
+static struct DmaModelReq g_req[DMA_MODEL_SRC_NUM];
+static uint32_t g_nsPerBurst = 20;
+static uint32_t g_psPerByte = 2500;
+
+static bool DmaModelEnabled(const struct DmaModelChn *c)
+{
+    return (c->ctrl & DMA_CHCTRL_CTRL_ENABLE_MASK) != 0;
+}
+
+static uint32_t DmaModelWidth(uint32_t field)
+{
+    return 1U << field;
+}
+
+static uint32_t DmaModelMuxSource(const struct DmaModel *d, uint32_t ch, bool *enabled)
+{
+    uint32_t cfg = HPM_DMAMUX->MUXCFG[d->muxFirst + ch];
+
+    *enabled = (cfg & DMAMUX_MUXCFG_ENABLE_MASK) != 0;
+    return DMAMUX_MUXCFG_SOURCE_GET(cfg);
+}
+
+static bool DmaModelHandshake(const struct DmaModelChn *c)
+{
+    return (c->ctrl & (DMA_CHCTRL_CTRL_SRCMODE_MASK | DMA_CHCTRL_CTRL_DSTMODE_MASK)) != 0;
+}
+
+/* A handshake channel may only move a burst while its peripheral requests one */
+static bool DmaModelRequested(const struct DmaModel *d, uint32_t ch)
+{
+    bool enabled;
+    uint32_t src = DmaModelMuxSource(d, ch, &enabled);
+
+    if (!DmaModelHandshake(&d->chn[ch])) {
+        return true;
+    }
+    return enabled && (src < DMA_MODEL_SRC_NUM) && (g_req[src].request != NULL) && g_req[src].request(g_req[src].ctx);
+}
+
+/* An armed source lets <failAfter> bytes through, the burst after that ends in a bus error */
+static bool DmaModelBusError(const struct DmaModel *d, uint32_t ch, uint32_t bytes)
+{
+    bool enabled;
+    uint32_t src = DmaModelMuxSource(d, ch, &enabled);
+
+    if (!DmaModelHandshake(&d->chn[ch]) || (src >= DMA_MODEL_SRC_NUM) || !g_req[src].fail) {
+        return false;
+    }
+    if (g_req[src].failAfter < bytes) {
+        g_req[src].fail = false;
+        return true;
+    }
+    g_req[src].failAfter -= bytes;
+    return false;
+}
+
+static uint32_t DmaModelBurstBytes(const struct DmaModelChn *c)
+{
+    uint32_t units = 1U << DMA_CHCTRL_CTRL_SRCBURSTSIZE_GET(c->ctrl);
+    uint32_t width = DmaModelWidth(DMA_CHCTRL_CTRL_SRCWIDTH_GET(c->ctrl));
+
+    units = (units > c->transize) ? c->transize : units;
+    return units * width;
+}
+
+static uint64_t DmaModelCostNs(uint32_t bytes)
+{
+    return g_nsPerBurst + ((uint64_t)bytes * g_psPerByte + 999U) / 1000U;
+}
+
+static uint32_t DmaModelStep(uint32_t addr, uint32_t ctl, uint32_t width)
+{
+    if (ctl == DMA_ADDRESS_CONTROL_INCREMENT) {
+        return addr + width;
+    } else if (ctl == DMA_ADDRESS_CONTROL_DECREMENT) {
+        return addr - width;
+    }
+    return addr;
+}
+
+static void DmaModelSetStatus(struct DmaModel *d, uint32_t ch, uint32_t shift)
+{
+    d->intstatus |= 1UL << (shift + ch);
+}
+
+static void DmaModelLoadDescriptor(struct DmaModelChn *c)
+{
+    const dma_linked_descriptor_t *desc = (const dma_linked_descriptor_t *)(uintptr_t)c->llp;
+
+    c->ctrl = desc->ctrl | DMA_CHCTRL_CTRL_ENABLE_MASK;
+    c->transize = desc->trans_size;
+    c->src = desc->src_addr;
+    c->dst = desc->dst_addr;
+    c->llp = desc->linked_ptr;
+}
+
+/* Move one burst of channel <ch>, then handle the end of its descriptor */
+static void DmaModelBurst(struct DmaModel *d, uint32_t ch)
+{
+    static uint8_t buf[DMA_MODEL_BURST_MAX];
+    struct DmaModelChn *c = &d->chn[ch];
+    uint32_t srcWidth = DmaModelWidth(DMA_CHCTRL_CTRL_SRCWIDTH_GET(c->ctrl));
+    uint32_t dstWidth = DmaModelWidth(DMA_CHCTRL_CTRL_DSTWIDTH_GET(c->ctrl));
+    uint32_t srcCtl = DMA_CHCTRL_CTRL_SRCADDRCTRL_GET(c->ctrl);
+    uint32_t dstCtl = DMA_CHCTRL_CTRL_DSTADDRCTRL_GET(c->ctrl);
+    uint32_t bytes = DmaModelBurstBytes(c);
+
+    if ((c->src % srcWidth) || (c->dst % dstWidth) || (bytes % dstWidth) || (srcWidth > 4) || (dstWidth > 4) ||
+        DmaModelBusError(d, ch, bytes)) {
+        c->ctrl &= ~DMA_CHCTRL_CTRL_ENABLE_MASK;
+        DmaModelSetStatus(d, ch, DMA_STATUS_ERROR_SHIFT);
+        d->errors++;
+        return;
+    }
+
+    for (uint32_t i = 0; i < bytes; i += srcWidth) {
+        uint32_t v = HpmTestBusRead(c->src, srcWidth);
+        memcpy(&buf[i], &v, srcWidth);
+        c->src = DmaModelStep(c->src, srcCtl, srcWidth);
+    }
+    for (uint32_t i = 0; i < bytes; i += dstWidth) {
+        uint32_t v = 0;
+        memcpy(&v, &buf[i], dstWidth);
+        HpmTestBusWrite(c->dst, v, dstWidth);
+        c->dst = DmaModelStep(c->dst, dstCtl, dstWidth);
+    }
+
+    c->transize -= bytes / srcWidth;
+    d->bytes += bytes;
+    c->readyNs = HpmTestNowNs() + DmaModelCostNs(bytes);
+
+    if (c->transize != 0) {
+        return;
+    }
+
+    if (((c->ctrl & DMA_CHCTRL_CTRL_INTTCMASK_MASK) == 0) || (c->llp == 0)) {
+        DmaModelSetStatus(d, ch, DMA_STATUS_TC_SHIFT);
+        d->tc++;
+    }
+    if (c->llp != 0) {
+        DmaModelLoadDescriptor(c);
+    } else {
+        c->ctrl &= ~DMA_CHCTRL_CTRL_ENABLE_MASK;
+    }
+}
+
+static uint64_t DmaModelNext(void *ctx)
+{
+    struct DmaModel *d = (struct DmaModel *)ctx;
+    uint64_t next = UINT64_MAX;
+    uint64_t now = HpmTestNowNs();
+
+    for (uint32_t ch = 0; ch < DMA_SOC_CHANNEL_NUM; ch++) {
+        struct DmaModelChn *c = &d->chn[ch];
+        if (DmaModelEnabled(c) && DmaModelRequested(d, ch)) {
+            uint64_t t = (c->readyNs > now) ? c->readyNs : now;
+            next = (t < next) ? t : next;
+        }
+    }
+    return next;
+}
+
+static void DmaModelRun(void *ctx)
+{
+    struct DmaModel *d = (struct DmaModel *)ctx;
+    uint64_t now = HpmTestNowNs();
+
+    for (uint32_t ch = 0; ch < DMA_SOC_CHANNEL_NUM; ch++) {
+        struct DmaModelChn *c = &d->chn[ch];
+        if (DmaModelEnabled(c) && (c->readyNs <= now) && DmaModelRequested(d, ch)) {
+            DmaModelBurst(d, ch);
+        }
+    }
+}
+
+static bool DmaModelIrqPending(void *ctx)
+{
+    const struct DmaModel *d = (const struct DmaModel *)ctx;
+    uint32_t unmasked = 0;
+
+    for (uint32_t ch = 0; ch < DMA_SOC_CHANNEL_NUM; ch++) {
+        uint32_t ctrl = d->chn[ch].ctrl;
+        if ((ctrl & DMA_CHCTRL_CTRL_INTTCMASK_MASK) == 0) {
+            unmasked |= 1UL << (DMA_STATUS_TC_SHIFT + ch);
+        }
+        if ((ctrl & DMA_CHCTRL_CTRL_INTABTMASK_MASK) == 0) {
+            unmasked |= 1UL << (DMA_STATUS_ABORT_SHIFT + ch);
+        }
+        if ((ctrl & DMA_CHCTRL_CTRL_INTERRMASK_MASK) == 0) {
+            unmasked |= 1UL << (DMA_STATUS_ERROR_SHIFT + ch);
+        }
+    }
+    return (d->intstatus & unmasked) != 0;
+}
+
+static uint32_t DmaModelRead(void *ctx, uint32_t offset)
+{
+    const struct DmaModel *d = (const struct DmaModel *)ctx;
+    uint32_t value = 0;
+
+    if (offset == DMA_MODEL_REG_INTSTATUS) {
+        value = d->intstatus;
+    } else if (offset == DMA_MODEL_REG_CHEN) {
+        for (uint32_t ch = 0; ch < DMA_SOC_CHANNEL_NUM; ch++) {
+            value |= DmaModelEnabled(&d->chn[ch]) ? (1UL << ch) : 0;
+        }
+    } else if ((offset >= DMA_MODEL_REG_CHCTRL) && (offset < DMA_MODEL_SIZE)) {
+        const struct DmaModelChn *c = &d->chn[(offset - DMA_MODEL_REG_CHCTRL) / DMA_MODEL_CHCTRL_STRIDE];
+        switch ((offset - DMA_MODEL_REG_CHCTRL) % DMA_MODEL_CHCTRL_STRIDE) {
+        case 0x0:
+            value = c->ctrl;
+            break;
+        case 0x4:
+            value = c->transize;
+            break;
+        case 0x8:
+            value = c->src;
+            break;
+        case 0x10:
+            value = c->dst;
+            break;
+        case 0x18:
+            value = c->llp;
+            break;
+        default:
+            break;
+        }
+    }
+    return value;
+}
+
+static void DmaModelWrite(void *ctx, uint32_t offset, uint32_t value)
+{
+    struct DmaModel *d = (struct DmaModel *)ctx;
+
+    if ((offset == DMA_MODEL_REG_DMACTRL) && (value & DMA_DMACTRL_RESET_MASK)) {
+        memset(d->chn, 0, sizeof(d->chn));
+        d->intstatus = 0;
+    } else if (offset == DMA_MODEL_REG_CHABORT) {
+        for (uint32_t ch = 0; ch < DMA_SOC_CHANNEL_NUM; ch++) {
+            if ((value & (1UL << ch)) && DmaModelEnabled(&d->chn[ch])) {
+                d->chn[ch].ctrl &= ~DMA_CHCTRL_CTRL_ENABLE_MASK;
+                DmaModelSetStatus(d, ch, DMA_STATUS_ABORT_SHIFT);
+            }
+        }
+    } else if (offset == DMA_MODEL_REG_INTSTATUS) {
+        d->intstatus &= ~value;
+    } else if ((offset >= DMA_MODEL_REG_CHCTRL) && (offset < DMA_MODEL_SIZE)) {
+        struct DmaModelChn *c = &d->chn[(offset - DMA_MODEL_REG_CHCTRL) / DMA_MODEL_CHCTRL_STRIDE];
+        switch ((offset - DMA_MODEL_REG_CHCTRL) % DMA_MODEL_CHCTRL_STRIDE) {
+        case 0x0:
+            if (!DmaModelEnabled(c) && (value & DMA_CHCTRL_CTRL_ENABLE_MASK)) {
+                c->readyNs = HpmTestNowNs() + g_nsPerBurst;
+            }
+            c->ctrl = value;
+            break;
+        case 0x4:
+            c->transize = value;
+            break;
+        case 0x8:
+            c->src = value;
+            break;
+        case 0x10:
+            c->dst = value;
+            break;
+        case 0x18:
+            c->llp = value;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static const struct HpmTestMmioOps g_dmaOps = {
+    .read = DmaModelRead,
+    .readDone = NULL,
+    .write = DmaModelWrite,
+};
+
+void HpmTestDmaModelInit(void)
+{
+    static const struct {
+        DMA_Type *base;
+        uint32_t irq;
+        uint32_t muxFirst;
+        const char *name;
+    } inst[DMA_SOC_MAX_COUNT] = {
+        { HPM_HDMA, IRQn_HDMA, DMAMUX_MUXCFG_HDMA_MUX0, "hdma" },
+        { HPM_XDMA, IRQn_XDMA, DMAMUX_MUXCFG_XDMA_MUX0, "xdma" },
+    };
+
+    memset(g_dma, 0, sizeof(g_dma));
+    memset(g_req, 0, sizeof(g_req));
+    memset((void *)HPM_DMAMUX, 0, sizeof(*HPM_DMAMUX));
+    for (uint32_t i = 0; i < DMA_SOC_MAX_COUNT; i++) {
+        struct DmaModel *d = &g_dma[i];
+        d->base = inst[i].base;
+        d->losIrq = HPM2LITEOS_IRQ(inst[i].irq);
+        d->muxFirst = inst[i].muxFirst;
+        d->model.name = inst[i].name;
+        d->model.next = DmaModelNext;
+        d->model.run = DmaModelRun;
+        d->model.ctx = d;
+        HpmTestModelAdd(&d->model);
+        HpmTestMmioMap((uint32_t)(uintptr_t)d->base, DMA_MODEL_SIZE, &g_dmaOps, d);
+        HpmTestIrqSource(d->losIrq, DmaModelIrqPending, d);
+    }
+}
+
+void HpmTestDmaModelDeinit(void)
+{
+    for (uint32_t i = 0; i < DMA_SOC_MAX_COUNT; i++) {
+        HpmTestModelRemove(&g_dma[i].model);
+        HpmTestMmioUnmap((uint32_t)(uintptr_t)g_dma[i].base);
+        HpmTestIrqSource(g_dma[i].losIrq, NULL, NULL);
+    }
+}
+
+void HpmTestDmaRequest(uint8_t src, bool (*request)(void *ctx), void *ctx)
+{
+    if (src < DMA_MODEL_SRC_NUM) {
+        g_req[src].request = request;
+        g_req[src].ctx = ctx;
+    }
+}
+
+void HpmTestDmaTiming(uint32_t nsPerBurst, uint32_t psPerByte)
+{
+    g_nsPerBurst = nsPerBurst;
+    g_psPerByte = psPerByte;
+}
+
+void HpmTestDmaStats(uint32_t instance, uint64_t *bytes, uint32_t *tc)
+{
+    *bytes = g_dma[instance].bytes;
+    *tc = g_dma[instance].tc;
+}
+
+void HpmTestDmaFailAfter(uint8_t src, uint32_t bytes)
+{
+    if (src < DMA_MODEL_SRC_NUM) {
+        g_req[src].fail = true;
+        g_req[src].failAfter = bytes;
+    }
+}
+
+uint32_t HpmTestDmaErrors(uint32_t instance)
+{
+    return g_dma[instance].errors;
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "hpm_test_fs.h"
+
+#define FS_PATH_MAX 256
+#define FS_FD_MAX 1024
+#define FS_FAIL_NONE 0xFFFFFFFFU
+
+int __real_open(const char *path, int flags, ...);
+int __real_close(int fd);
+ssize_t __real_read(int fd, void *buf, size_t count);
+ssize_t __real_write(int fd, const void *buf, size_t count);
+off_t __real_lseek(int fd, off_t offset, int whence);
+int __real_unlink(const char *path);
+int __real_stat(const char *path, struct stat *st);
+int __real_fstat(int fd, struct stat *st);
+
+static char g_fsMount[FS_PATH_MAX];
+static char g_fsRoot[FS_PATH_MAX];
+static bool g_fsOurs[FS_FD_MAX];
+static struct HpmTestFsStats g_fsStats;
+static uint32_t g_fsWriteOk = FS_FAIL_NONE;
+static bool g_fsFailClose;
+
+/* Host path for <path>, or <path> itself when it is not under the mount point */
+static const char *FsMap(const char *path, char *out)
+{
+    size_t len = strlen(g_fsMount);
+
+    if ((len == 0) || (strncmp(path, g_fsMount, len) != 0) || ((path[len] != '/') && (path[len] != '\0'))) {
+        return path;
+    }
+    (void)snprintf(out, FS_PATH_MAX, "%s%s", g_fsRoot, path + len);
+    return out;
+}
+
+static bool FsOurs(int fd)
+{
+    return (fd >= 0) && (fd < FS_FD_MAX) && g_fsOurs[fd];
+}
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    char buf[FS_PATH_MAX];
+    const char *host = FsMap(path, buf);
+    mode_t mode = 0;
+    int fd;
+
+    if (flags & O_CREAT) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    /* the HAL passes no mode, files are created read/write as littlefs does */
+    fd = __real_open(host, flags, (host == buf) ? 0644 : mode);
+    if ((host == buf) && (fd >= 0) && (fd < FS_FD_MAX)) {
+        g_fsOurs[fd] = true;
+        g_fsStats.opens++;
+    }
+    return fd;
+}
+
+int __wrap_close(int fd)
+{
+    if (FsOurs(fd)) {
+        g_fsOurs[fd] = false;
+        g_fsStats.closes++;
+        if (g_fsFailClose) {
+            g_fsFailClose = false;
+            (void)__real_close(fd);
+            errno = EIO;
+            return -1;
+        }
+    }
+    return __real_close(fd);
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t count)
+{
+    if (FsOurs(fd)) {
+        g_fsStats.reads++;
+    }
+    return __real_read(fd, buf, count);
+}
+
+ssize_t __wrap_write(int fd, const void *buf, size_t count)
+{
+    if (FsOurs(fd)) {
+        g_fsStats.writes++;
+        if (g_fsWriteOk != FS_FAIL_NONE) {
+            if (g_fsWriteOk == 0) {
+                g_fsWriteOk = FS_FAIL_NONE;
+                errno = EIO;
+                return -1;
+            }
+            g_fsWriteOk--;
+        }
+        g_fsStats.writeBytes += count;
+    }
+    return __real_write(fd, buf, count);
+}
+
+off_t __wrap_lseek(int fd, off_t offset, int whence)
+{
+    if (FsOurs(fd)) {
+        g_fsStats.seeks++;
+    }
+    return __real_lseek(fd, offset, whence);
+}
+
+int __wrap_unlink(const char *path)
+{
+    char buf[FS_PATH_MAX];
+
+    return __real_unlink(FsMap(path, buf));
+}
+
+int __wrap_stat(const char *path, struct stat *st)
+{
+    char buf[FS_PATH_MAX];
+
+    return __real_stat(FsMap(path, buf), st);
+}
+
+int __wrap_fstat(int fd, struct stat *st)
+{
+    return __real_fstat(fd, st);
+}
+
+void HpmTestFsInit(const char *mount)
+{
+    const char *tmp = getenv("TMPDIR");
+
+    (void)snprintf(g_fsRoot, sizeof(g_fsRoot), "%s/hpm_test_fs.XXXXXX", (tmp != NULL) ? tmp : "/tmp");
+    if (mkdtemp(g_fsRoot) == NULL) {
+        perror("mkdtemp");
+        abort();
+    }
+    (void)snprintf(g_fsMount, sizeof(g_fsMount), "%s", mount);
+    HpmTestFsStatsReset();
+}
+
+void HpmTestFsDeinit(void)
+{
+    DIR *dir = opendir(g_fsRoot);
+    struct dirent *ent;
+    char path[FS_PATH_MAX * 2];
+
+    while ((dir != NULL) && ((ent = readdir(dir)) != NULL)) {
+        if ((strcmp(ent->d_name, ".") != 0) && (strcmp(ent->d_name, "..") != 0)) {
+            (void)snprintf(path, sizeof(path), "%s/%s", g_fsRoot, ent->d_name);
+            (void)__real_unlink(path);
+        }
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+    (void)rmdir(g_fsRoot);
+    g_fsMount[0] = '\0';
+}
+
+void HpmTestFsStats(struct HpmTestFsStats *stats)
+{
+    *stats = g_fsStats;
+}
+
+void HpmTestFsStatsReset(void)
+{
+    (void)memset(&g_fsStats, 0, sizeof(g_fsStats));
+}
+
+void HpmTestFsFailWrite(uint32_t okCount)
+{
+    g_fsWriteOk = okCount;
+}
+
+void HpmTestFsFailClose(void)
+{
+    g_fsFailClose = true;
+}
+
+uint32_t HpmTestFsOpenFiles(void)
+{
+    uint32_t n = 0;
+
+    for (uint32_t fd = 0; fd < FS_FD_MAX; fd++) {
+        n += g_fsOurs[fd] ? 1 : 0;
+    }
+    return n;
+}
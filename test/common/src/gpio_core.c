@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "hdf_base.h"
+#include "gpio_core.h"
+
+#define GPIO_CNTLR_MAX 16
+#define GPIO_PIN_MAX (GPIO_CNTLR_MAX * 32)
+
+struct GpioIrqRecord {
+    GpioIrqFunc func;
+    void *arg;
+};
+
+static struct GpioCntlr *g_gpioCntlrs[GPIO_CNTLR_MAX];
+static struct GpioIrqRecord g_gpioIrqs[GPIO_PIN_MAX];
+
+static struct GpioCntlr *GpioCntlrFind(uint16_t gpio, uint16_t *local)
+{
+    for (uint32_t i = 0; i < GPIO_CNTLR_MAX; i++) {
+        struct GpioCntlr *c = g_gpioCntlrs[i];
+        if ((c != NULL) && (gpio >= c->start) && (gpio < c->start + c->count)) {
+            *local = gpio - c->start;
+            return c;
+        }
+    }
+    return NULL;
+}
+
+int32_t GpioCntlrAdd(struct GpioCntlr *cntlr)
+{
+    uint32_t free = GPIO_CNTLR_MAX;
+
+    if ((cntlr == NULL) || (cntlr->ops == NULL) || (cntlr->start + cntlr->count > GPIO_PIN_MAX)) {
+        return HDF_ERR_INVALID_OBJECT;
+    }
+    for (uint32_t i = 0; i < GPIO_CNTLR_MAX; i++) {
+        struct GpioCntlr *c = g_gpioCntlrs[i];
+        if (c == NULL) {
+            free = (free == GPIO_CNTLR_MAX) ? i : free;
+        } else if ((cntlr->start < c->start + c->count) && (c->start < cntlr->start + cntlr->count)) {
+            /* the pin range is taken */
+            return HDF_FAILURE;
+        }
+    }
+    if (free == GPIO_CNTLR_MAX) {
+        return HDF_FAILURE;
+    }
+    g_gpioCntlrs[free] = cntlr;
+    return HDF_SUCCESS;
+}
+
+void GpioCntlrRemove(struct GpioCntlr *cntlr)
+{
+    for (uint32_t i = 0; i < GPIO_CNTLR_MAX; i++) {
+        if (g_gpioCntlrs[i] == cntlr) {
+            g_gpioCntlrs[i] = NULL;
+        }
+    }
+}
+
+struct GpioCntlr *GpioCntlrFromHdfDev(const struct HdfDeviceObject *device)
+{
+    struct PlatformDevice *pdev = (device == NULL) ? NULL : (struct PlatformDevice *)device->priv;
+
+    /* the platform device is the first member of the controller */
+    return (struct GpioCntlr *)pdev;
+}
+
+int32_t GpioCntlrIrqCallback(struct GpioCntlr *cntlr, uint16_t local)
+{
+    uint16_t gpio = cntlr->start + local;
+
+    if ((gpio >= GPIO_PIN_MAX) || (g_gpioIrqs[gpio].func == NULL)) {
+        return HDF_ERR_NOT_SUPPORT;
+    }
+    return g_gpioIrqs[gpio].func(gpio, g_gpioIrqs[gpio].arg);
+}
+
+int32_t GpioRead(uint16_t gpio, uint16_t *val)
+{
+    uint16_t local;
+    struct GpioCntlr *c = GpioCntlrFind(gpio, &local);
+
+    return (c == NULL) ? HDF_ERR_INVALID_PARAM : c->ops->read(c, local, val);
+}
+
+int32_t GpioWrite(uint16_t gpio, uint16_t val)
+{
+    uint16_t local;
+    struct GpioCntlr *c = GpioCntlrFind(gpio, &local);
+
+    return (c == NULL) ? HDF_ERR_INVALID_PARAM : c->ops->write(c, local, val);
+}
+
+int32_t GpioSetDir(uint16_t gpio, uint16_t dir)
+{
+    uint16_t local;
+    struct GpioCntlr *c = GpioCntlrFind(gpio, &local);
+
+    return (c == NULL) ? HDF_ERR_INVALID_PARAM : c->ops->setDir(c, local, dir);
+}
+
+int32_t GpioSetIrq(uint16_t gpio, uint16_t mode, GpioIrqFunc func, void *arg)
+{
+    uint16_t local;
+    struct GpioCntlr *c = GpioCntlrFind(gpio, &local);
+
+    if ((c == NULL) || (func == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    g_gpioIrqs[gpio].func = func;
+    g_gpioIrqs[gpio].arg = arg;
+    return c->ops->setIrq(c, local, mode);
+}
+
+int32_t GpioUnsetIrq(uint16_t gpio, void *arg)
+{
+    uint16_t local;
+    struct GpioCntlr *c = GpioCntlrFind(gpio, &local);
+
+    (void)arg;
+    if (c == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    g_gpioIrqs[gpio].func = NULL;
+    return c->ops->unsetIrq(c, local);
+}
+
+int32_t GpioEnableIrq(uint16_t gpio)
+{
+    uint16_t local;
+    struct GpioCntlr *c = GpioCntlrFind(gpio, &local);
+
+    return (c == NULL) ? HDF_ERR_INVALID_PARAM : c->ops->enableIrq(c, local);
+}
+
+int32_t GpioDisableIrq(uint16_t gpio)
+{
+    uint16_t local;
+    struct GpioCntlr *c = GpioCntlrFind(gpio, &local);
+
+    return (c == NULL) ? HDF_ERR_INVALID_PARAM : c->ops->disableIrq(c, local);
+}
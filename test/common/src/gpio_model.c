@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <string.h>
+#include "hpm_soc.h"
+#include "soc.h"
+#include "hpm_test_gpio.h"
+
+#define GPIO_REG_DI 0x0U
+#define GPIO_REG_DO 0x1U
+#define GPIO_REG_OE 0x2U
+#define GPIO_REG_IF 0x3U
+#define GPIO_REG_IE 0x4U
+#define GPIO_REG_PL 0x5U
+#define GPIO_REG_TP 0x6U
+#define GPIO_REG_AS 0x7U
+#define GPIO_REG_SIZE 0x800U
+#define GPIO_OP_VALUE 0x0U
+#define GPIO_OP_SET 0x4U
+#define GPIO_OP_CLEAR 0x8U
+#define GPIO_OP_TOGGLE 0xCU
+
+static uint32_t *GpioModelReg(struct HpmTestGpioPort *p, uint32_t group)
+{
+    switch (group) {
+    case GPIO_REG_DO:
+        return &p->dout;
+    case GPIO_REG_OE:
+        return &p->oe;
+    case GPIO_REG_IE:
+        return &p->ie;
+    case GPIO_REG_PL:
+        return &p->pl;
+    case GPIO_REG_TP:
+        return &p->tp;
+    case GPIO_REG_AS:
+        return &p->as;
+    default:
+        return NULL;
+    }
+}
+
+/* Pad levels: outputs drive their pads */
+static uint32_t GpioModelPads(const struct HpmTestGpioPort *p)
+{
+    return (p->di & ~p->oe) | (p->dout & p->oe);
+}
+
+/* Level interrupts latch again for as long as the level holds (PL set: active low) */
+static void GpioModelLatchLevels(struct HpmTestGpioPort *p)
+{
+    uint32_t active = GpioModelPads(p) ^ p->pl;
+
+    p->flags |= active & ~p->tp;
+}
+
+static void GpioModelPadsChanged(struct HpmTestGpio *g, struct HpmTestGpioPort *p, uint32_t before)
+{
+    uint32_t after = GpioModelPads(p);
+    uint32_t rising = ~before & after;
+    uint32_t falling = before & ~after;
+    /* TP set: edge, PL clear: rising */
+    uint32_t edges = p->tp & ((rising & ~p->pl) | (falling & p->pl));
+
+    g->edges += (uint64_t)__builtin_popcount(edges);
+    p->flags |= edges;
+    GpioModelLatchLevels(p);
+}
+
+static bool GpioModelIrqPending(void *ctx)
+{
+    const struct HpmTestGpioPort *p = (const struct HpmTestGpioPort *)ctx;
+
+    return (p->flags & p->ie) != 0;
+}
+
+static uint32_t GpioModelRead(void *ctx, uint32_t offset)
+{
+    struct HpmTestGpio *g = (struct HpmTestGpio *)ctx;
+    uint32_t group = offset >> 8;
+    struct HpmTestGpioPort *p = &g->port[(offset >> 4) & 0xFU];
+    uint32_t *reg;
+
+    if ((offset & 0xFU) != GPIO_OP_VALUE) {
+        reg = GpioModelReg(p, group);
+        return (reg != NULL) ? *reg : 0;
+    }
+    if (group == GPIO_REG_DI) {
+        return GpioModelPads(p);
+    }
+    if (group == GPIO_REG_IF) {
+        return p->flags;
+    }
+    reg = GpioModelReg(p, group);
+    return (reg != NULL) ? *reg : 0;
+}
+
+static void GpioModelReadDone(void *ctx, uint32_t offset)
+{
+    struct HpmTestGpio *g = (struct HpmTestGpio *)ctx;
+
+    if (((offset >> 8) == GPIO_REG_IF) && ((offset & 0xFU) == GPIO_OP_VALUE) && (g->flagRead != NULL)) {
+        g->flagRead(g->flagReadCtx, (offset >> 4) & 0xFU);
+    }
+}
+
+static void GpioModelWrite(void *ctx, uint32_t offset, uint32_t value)
+{
+    struct HpmTestGpio *g = (struct HpmTestGpio *)ctx;
+    uint32_t group = offset >> 8;
+    struct HpmTestGpioPort *p = &g->port[(offset >> 4) & 0xFU];
+    uint32_t before = GpioModelPads(p);
+    uint32_t *reg;
+
+    if (group == GPIO_REG_IF) {
+        /* W1C */
+        p->flags &= ~value;
+        GpioModelLatchLevels(p);
+        return;
+    }
+    reg = GpioModelReg(p, group);
+    if (reg == NULL) {
+        return;
+    }
+    switch (offset & 0xFU) {
+    case GPIO_OP_VALUE:
+        *reg = value;
+        break;
+    case GPIO_OP_SET:
+        *reg |= value;
+        break;
+    case GPIO_OP_CLEAR:
+        *reg &= ~value;
+        break;
+    default:
+        *reg ^= value;
+        break;
+    }
+    if ((group == GPIO_REG_DO) || (group == GPIO_REG_OE)) {
+        GpioModelPadsChanged(g, p, before);
+    } else if ((group == GPIO_REG_PL) || (group == GPIO_REG_TP)) {
+        GpioModelLatchLevels(p);
+    }
+}
+
+static const struct HpmTestMmioOps g_gpioOps = {
+    .read = GpioModelRead,
+    .readDone = GpioModelReadDone,
+    .write = GpioModelWrite,
+};
+
+void HpmTestGpioInit(struct HpmTestGpio *g, uint32_t base)
+{
+    memset(g, 0, sizeof(*g));
+    g->base = base;
+    HpmTestMmioMap(base, GPIO_REG_SIZE, &g_gpioOps, g);
+}
+
+void HpmTestGpioDeinit(struct HpmTestGpio *g)
+{
+    for (uint32_t i = 0; i < HPM_TEST_GPIO_PORTS; i++) {
+        if (g->port[i].losIrq != 0) {
+            HpmTestIrqSource(g->port[i].losIrq, NULL, NULL);
+        }
+    }
+    HpmTestMmioUnmap(g->base);
+}
+
+void HpmTestGpioPortIrq(struct HpmTestGpio *g, uint32_t port, uint32_t plicIrq)
+{
+    g->port[port].losIrq = HPM2LITEOS_IRQ(plicIrq);
+    HpmTestIrqSource(g->port[port].losIrq, GpioModelIrqPending, &g->port[port]);
+}
+
+void HpmTestGpioSetInput(struct HpmTestGpio *g, uint32_t port, uint32_t pin, bool high)
+{
+    struct HpmTestGpioPort *p = &g->port[port];
+    uint32_t before = GpioModelPads(p);
+
+    if (high) {
+        p->di |= 1UL << pin;
+    } else {
+        p->di &= ~(1UL << pin);
+    }
+    GpioModelPadsChanged(g, p, before);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "device_resource_if.h"
+#include "hdf_device_desc.h"
+#include "hpm_test.h"
+
+static const struct HpmTestProp *HdfPropFind(const struct DeviceResourceNode *node, const char *attrName)
+{
+    if ((node == NULL) || (attrName == NULL)) {
+        return NULL;
+    }
+    for (const struct HpmTestProp *p = node->props; (p != NULL) && (p->name != NULL); p++) {
+        if (strcmp(p->name, attrName) == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static bool HdfGetBool(const struct DeviceResourceNode *node, const char *attrName)
+{
+    const struct HpmTestProp *p = HdfPropFind(node, attrName);
+
+    return (p != NULL) && (p->value != 0);
+}
+
+static int32_t HdfGetUint32(const struct DeviceResourceNode *node, const char *attrName, uint32_t *value,
+                            uint32_t def)
+{
+    const struct HpmTestProp *p = HdfPropFind(node, attrName);
+
+    if (value == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    *value = (p != NULL) ? p->value : def;
+    return (p != NULL) ? HDF_SUCCESS : HDF_FAILURE;
+}
+
+static int32_t HdfGetUint16(const struct DeviceResourceNode *node, const char *attrName, uint16_t *value,
+                            uint16_t def)
+{
+    uint32_t v;
+    int32_t ret = HdfGetUint32(node, attrName, &v, def);
+
+    *value = (uint16_t)v;
+    return ret;
+}
+
+static int32_t HdfGetUint8(const struct DeviceResourceNode *node, const char *attrName, uint8_t *value, uint8_t def)
+{
+    uint32_t v;
+    int32_t ret = HdfGetUint32(node, attrName, &v, def);
+
+    *value = (uint8_t)v;
+    return ret;
+}
+
+static int32_t HdfGetString(const struct DeviceResourceNode *node, const char *attrName, const char **value,
+                            const char *def)
+{
+    const struct HpmTestProp *p = HdfPropFind(node, attrName);
+
+    if (value == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    *value = (p != NULL) ? p->str : def;
+    return (p != NULL) ? HDF_SUCCESS : HDF_FAILURE;
+}
+
+static struct DeviceResourceIface g_hdfIface = {
+    .GetBool = HdfGetBool,
+    .GetUint8 = HdfGetUint8,
+    .GetUint16 = HdfGetUint16,
+    .GetUint32 = HdfGetUint32,
+    .GetString = HdfGetString,
+};
+
+struct DeviceResourceIface *DeviceResourceGetIfaceInstance(DeviceResourceType type)
+{
+    return (type == HDF_CONFIG_SOURCE) ? &g_hdfIface : NULL;
+}
+
+struct HdfDeviceObject *HpmTestDeviceCreate(const struct HpmTestProp *props)
+{
+    struct HdfDeviceObject *device = calloc(1, sizeof(*device));
+    struct DeviceResourceNode *node = calloc(1, sizeof(*node));
+
+    if ((device == NULL) || (node == NULL)) {
+        free(device);
+        free(node);
+        return NULL;
+    }
+    node->name = "test";
+    node->props = props;
+    device->property = node;
+    return device;
+}
+
+void HpmTestDeviceDestroy(struct HdfDeviceObject *device)
+{
+    if (device != NULL) {
+        free((void *)device->property);
+        free(device);
+    }
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <malloc.h>
+#include "hpm_test_priv.h"
+
+/* Events at one instant beyond this are a model that never settles */
+#define HPM_TEST_EVENTS_PER_INSTANT_MAX 1000000
+
+static uint32_t g_checks;
+static uint32_t g_failures;
+static bool g_virtual;
+static uint64_t g_nowNs;
+static struct HpmTestModel *g_models;
+
+/*
+ * The code under test keeps pointers in 32 bit registers and descriptors. With
+ * a non-PIE image, one arena and no mmap'ed chunks the heap stays in the low
+ * 4 GiB next to the image.
+ */
+__attribute__((constructor)) static void HpmTestLowHeap(void)
+{
+    mallopt(M_MMAP_THRESHOLD, 32 * 1024 * 1024);
+    mallopt(M_ARENA_MAX, 1);
+    HpmTestMmioInit();
+}
+
+bool HpmTestCheck(bool ok, const char *expr, const char *file, int line)
+{
+    g_checks++;
+    if (!ok) {
+        g_failures++;
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    }
+    return ok;
+}
+
+bool HpmTestCheckEq(long long a, long long b, const char *exprA, const char *exprB, const char *file, int line)
+{
+    g_checks++;
+    if (a != b) {
+        g_failures++;
+        fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", file, line, exprA, exprB, a, b);
+    }
+    return a == b;
+}
+
+int HpmTestResult(void)
+{
+    printf("%u checks, %u failed\n", g_checks, g_failures);
+    return (g_failures == 0) ? 0 : 1;
+}
+
+bool HpmTestFull(void)
+{
+    return getenv("HPM_TEST_FULL") != NULL;
+}
+
+uint64_t HpmTestHostNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint32_t HpmTestRand(uint32_t *state)
+{
+    /* xorshift32 */
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void HpmTestVirtualTime(bool enable)
+{
+    g_virtual = enable;
+    g_nowNs = 0;
+}
+
+bool HpmTestIsVirtualTime(void)
+{
+    return g_virtual;
+}
+
+uint64_t HpmTestNowNs(void)
+{
+    return g_virtual ? g_nowNs : HpmTestHostNs();
+}
+
+void HpmTestModelAdd(struct HpmTestModel *model)
+{
+    model->link = g_models;
+    g_models = model;
+}
+
+void HpmTestModelRemove(struct HpmTestModel *model)
+{
+    struct HpmTestModel **pp = &g_models;
+
+    while (*pp != NULL) {
+        if (*pp == model) {
+            *pp = model->link;
+            return;
+        }
+        pp = &(*pp)->link;
+    }
+}
+
+/* Run the earliest model event due by <untilNs>, false when there is none */
+static bool HpmTestModelStep(uint64_t untilNs)
+{
+    static uint64_t lastNs;
+    static uint32_t events;
+    struct HpmTestModel *due = NULL;
+    uint64_t t = UINT64_MAX;
+
+    for (struct HpmTestModel *m = g_models; m != NULL; m = m->link) {
+        uint64_t next = m->next(m->ctx);
+        if (next < t) {
+            t = next;
+            due = m;
+        }
+    }
+
+    if ((due == NULL) || (t > untilNs)) {
+        return false;
+    }
+
+    if (t > g_nowNs) {
+        g_nowNs = t;
+    }
+    if (g_nowNs != lastNs) {
+        lastNs = g_nowNs;
+        events = 0;
+    } else if (++events > HPM_TEST_EVENTS_PER_INSTANT_MAX) {
+        fprintf(stderr, "model %s does not settle at %llu ns\n", due->name, (unsigned long long)g_nowNs);
+        abort();
+    }
+    due->run(due->ctx);
+
+    return true;
+}
+
+void HpmTestAdvance(uint64_t ns)
+{
+    uint64_t until = g_nowNs + ns;
+
+    while (HpmTestModelStep(until)) {
+    }
+    g_nowNs = until;
+}
+
+void HpmTestCpuNs(uint64_t ns)
+{
+    if (g_virtual) {
+        HpmTestAdvance(ns);
+    }
+}
+
+bool HpmTestRunUntilDone(uint64_t untilNs, bool (*done)(void *arg), void *arg)
+{
+    for (;;) {
+        HpmTestIrqDeliver();
+        if ((done != NULL) && done(arg)) {
+            return true;
+        }
+        if (g_nowNs >= untilNs) {
+            return false;
+        }
+        if (!HpmTestModelStep(untilNs)) {
+            g_nowNs = untilNs;
+        }
+    }
+}
+
+void HpmTestRunUntil(uint64_t untilNs)
+{
+    (void)HpmTestRunUntilDone(untilNs, NULL, NULL);
+}
+
+void HpmTestWfi(void)
+{
+    HpmTestIrqDeliver();
+    if (HpmTestModelStep(UINT64_MAX)) {
+        HpmTestIrqDeliver();
+    }
+}
+
+void HpmTestLog(char level, const char *tag, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (getenv("HPM_TEST_LOG") == NULL) {
+        return;
+    }
+    fprintf(stderr, "[%c/%s] ", level, tag);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Hooks shared by the pieces of the test library, not for the tests */
+
+#ifndef HPM_TEST_PRIV_H
+#define HPM_TEST_PRIV_H
+
+#include "hpm_test.h"
+
+/* Map the register windows, called once before main() */
+void HpmTestMmioInit(void);
+
+/* Advance the virtual clock by <ns>, running model events but not interrupts */
+void HpmTestAdvance(uint64_t ns);
+
+#endif
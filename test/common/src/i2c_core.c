@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "hdf_base.h"
+#include "i2c_core.h"
+
+#define I2C_BUS_MAX 8
+
+static struct I2cCntlr *g_i2cCntlrs[I2C_BUS_MAX];
+
+int32_t I2cCntlrAdd(struct I2cCntlr *cntlr)
+{
+    if ((cntlr == NULL) || (cntlr->ops == NULL) || (cntlr->busId < 0) || (cntlr->busId >= I2C_BUS_MAX)) {
+        return HDF_ERR_INVALID_OBJECT;
+    }
+    if (g_i2cCntlrs[cntlr->busId] != NULL) {
+        return HDF_FAILURE;
+    }
+    g_i2cCntlrs[cntlr->busId] = cntlr;
+    return HDF_SUCCESS;
+}
+
+void I2cCntlrRemove(struct I2cCntlr *cntlr)
+{
+    if ((cntlr != NULL) && (cntlr->busId >= 0) && (cntlr->busId < I2C_BUS_MAX) &&
+        (g_i2cCntlrs[cntlr->busId] == cntlr)) {
+        g_i2cCntlrs[cntlr->busId] = NULL;
+    }
+}
+
+struct I2cCntlr *I2cCntlrGet(int16_t number)
+{
+    return ((number >= 0) && (number < I2C_BUS_MAX)) ? g_i2cCntlrs[number] : NULL;
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <string.h>
+#include "hpm_soc.h"
+#include "hpm_i2c_drv.h"
+#include "soc.h"
+#include "hpm_test_i2c.h"
+
+#define I2C_REG_CFG 0x10U
+#define I2C_REG_INTEN 0x14U
+#define I2C_REG_STATUS 0x18U
+#define I2C_REG_ADDR 0x1CU
+#define I2C_REG_DATA 0x20U
+#define I2C_REG_CTRL 0x24U
+#define I2C_REG_CMD 0x28U
+#define I2C_REG_SETUP 0x2CU
+#define I2C_REG_TPM 0x30U
+#define I2C_REG_SIZE 0x34U
+/* 4 byte fifo */
+#define I2C_CFG_FIFO_4 1U
+#define I2C_STATUS_W1C (I2C_STATUS_CMPL_MASK | I2C_STATUS_BYTERECV_MASK | I2C_STATUS_BYTETRANS_MASK | \
+                        I2C_STATUS_START_MASK | I2C_STATUS_STOP_MASK | I2C_STATUS_ARBLOSE_MASK | \
+                        I2C_STATUS_ADDRHIT_MASK)
+#define I2C_PHASES (I2C_CTRL_PHASE_START_MASK | I2C_CTRL_PHASE_ADDR_MASK | I2C_CTRL_PHASE_DATA_MASK | \
+                    I2C_CTRL_PHASE_STOP_MASK)
+#define I2C_BYTE_BITS 9U
+
+uint32_t HpmTestI2cSclHz(const struct HpmTestI2c *s)
+{
+    uint64_t tpclkPs = 1000000000000ULL / s->clkHz;
+    uint64_t tpm = I2C_TPM_TPM_GET(s->tpm) + 1U;
+    uint64_t highPs = 2U * tpclkPs + (2U + I2C_SETUP_T_SP_GET(s->setup) + I2C_SETUP_T_SCLHI_GET(s->setup)) *
+                      tpclkPs * tpm;
+    uint64_t lowPs = highPs * (I2C_SETUP_T_SCLRADIO_GET(s->setup) + 1U);
+
+    return (uint32_t)(1000000000000ULL / (highPs + lowPs));
+}
+
+static uint64_t I2cModelBitsNs(const struct HpmTestI2c *s, uint32_t bits)
+{
+    return (uint64_t)bits * s->bitNs;
+}
+
+static void I2cModelSchedule(struct HpmTestI2c *s, enum HpmTestI2cPhase phase, uint64_t ns)
+{
+    s->phase = phase;
+    s->eventBusy = true;
+    s->eventNs = HpmTestNowNs() + ns;
+}
+
+/* The transaction is over, with or without the bus */
+static void I2cModelEnd(struct HpmTestI2c *s, bool complete)
+{
+    s->phase = HPM_TEST_I2C_IDLE;
+    s->eventBusy = false;
+    if (complete) {
+        s->status |= I2C_STATUS_CMPL_MASK;
+    }
+}
+
+/* Shift out or in the next data byte once the fifo allows it */
+static void I2cModelDataKick(struct HpmTestI2c *s)
+{
+    if ((s->phase != HPM_TEST_I2C_DATA) || s->eventBusy) {
+        return;
+    }
+    if (s->read) {
+        if (s->fifoCount == HPM_TEST_I2C_FIFO) {
+            /* scl is stretched until the fifo is read */
+            return;
+        }
+    } else {
+        if (s->fifoCount == 0) {
+            return;
+        }
+        s->byteOut = s->fifo[s->fifoHead];
+        s->fifoHead = (s->fifoHead + 1U) % HPM_TEST_I2C_FIFO;
+        s->fifoCount--;
+    }
+    I2cModelSchedule(s, HPM_TEST_I2C_DATA, I2cModelBitsNs(s, I2C_BYTE_BITS));
+}
+
+/* Move on to the first enabled phase after <done> */
+static void I2cModelNextPhase(struct HpmTestI2c *s, enum HpmTestI2cPhase done)
+{
+    if ((done < HPM_TEST_I2C_ADDR) && (s->phases & I2C_CTRL_PHASE_ADDR_MASK)) {
+        /* a 10 bit address takes two address bytes */
+        uint32_t bytes = (s->setup & I2C_SETUP_ADDRESSING_MASK) ? 2U : 1U;
+        I2cModelSchedule(s, HPM_TEST_I2C_ADDR, I2cModelBitsNs(s, bytes * I2C_BYTE_BITS));
+        return;
+    }
+    if ((done < HPM_TEST_I2C_DATA) && (s->phases & I2C_CTRL_PHASE_DATA_MASK) && (s->dataLeft != 0)) {
+        s->phase = HPM_TEST_I2C_DATA;
+        s->eventBusy = false;
+        I2cModelDataKick(s);
+        return;
+    }
+    if ((done < HPM_TEST_I2C_STOP) && (s->phases & I2C_CTRL_PHASE_STOP_MASK)) {
+        I2cModelSchedule(s, HPM_TEST_I2C_STOP, I2cModelBitsNs(s, 1U) / 2U);
+        return;
+    }
+    I2cModelEnd(s, true);
+}
+
+static void I2cModelIssue(struct HpmTestI2c *s)
+{
+    s->phases = s->ctrl & I2C_PHASES;
+    if ((s->phase != HPM_TEST_I2C_IDLE) || (s->phases == 0)) {
+        return;
+    }
+    s->read = I2C_CTRL_DIR_GET(s->ctrl) == I2C_DIR_MASTER_READ;
+    s->bitNs = 1000000000ULL / HpmTestI2cSclHz(s);
+    s->transactions++;
+    if (s->phases & I2C_CTRL_PHASE_START_MASK) {
+        I2cModelSchedule(s, HPM_TEST_I2C_START, I2cModelBitsNs(s, 1U) / 2U);
+    } else {
+        I2cModelNextPhase(s, HPM_TEST_I2C_START);
+    }
+}
+
+/* Another master took the bus at this byte */
+static bool I2cModelArbLost(struct HpmTestI2c *s)
+{
+    s->bytes++;
+    if ((s->arbLoseAtByte == 0) || (s->bytes != s->arbLoseAtByte)) {
+        return false;
+    }
+    s->status |= I2C_STATUS_ARBLOSE_MASK;
+    s->busHeld = false;
+    I2cModelEnd(s, false);
+    return true;
+}
+
+static bool I2cModelAck(struct HpmTestI2c *s, bool ack)
+{
+    if (ack) {
+        s->status |= I2C_STATUS_ACK_MASK;
+    } else {
+        s->status &= ~I2C_STATUS_ACK_MASK;
+    }
+    return ack;
+}
+
+static void I2cModelRunPhase(struct HpmTestI2c *s)
+{
+    bool tenBit = (s->setup & I2C_SETUP_ADDRESSING_MASK) != 0;
+    uint16_t addr = I2C_ADDR_ADDR_GET(s->addr) & (tenBit ? 0x3FFU : 0x7FU);
+    bool ack;
+
+    switch (s->phase) {
+    case HPM_TEST_I2C_START:
+        s->status |= I2C_STATUS_START_MASK;
+        s->starts++;
+        s->repeatedStarts += s->busHeld ? 1U : 0U;
+        s->busHeld = true;
+        I2cModelNextPhase(s, HPM_TEST_I2C_START);
+        break;
+    case HPM_TEST_I2C_ADDR:
+        if (I2cModelArbLost(s)) {
+            break;
+        }
+        s->addrPhases++;
+        ack = (s->bus.address != NULL) && s->bus.address(s->bus.ctx, addr, tenBit, s->read);
+        if (!I2cModelAck(s, ack)) {
+            /* no data after an address nack, the STOP phase still runs */
+            I2cModelNextPhase(s, HPM_TEST_I2C_DATA);
+            break;
+        }
+        s->status |= I2C_STATUS_ADDRHIT_MASK;
+        I2cModelNextPhase(s, HPM_TEST_I2C_ADDR);
+        break;
+    case HPM_TEST_I2C_DATA:
+        if (I2cModelArbLost(s)) {
+            break;
+        }
+        s->dataLeft--;
+        if (s->read) {
+            /* the master acks every byte but the last */
+            s->fifo[(s->fifoHead + s->fifoCount) % HPM_TEST_I2C_FIFO] =
+                (s->bus.read != NULL) ? s->bus.read(s->bus.ctx) : 0xFFU;
+            s->fifoCount++;
+            s->status |= I2C_STATUS_BYTERECV_MASK;
+            I2cModelAck(s, s->dataLeft != 0);
+        } else {
+            ack = (s->bus.write != NULL) && s->bus.write(s->bus.ctx, s->byteOut);
+            s->status |= I2C_STATUS_BYTETRANS_MASK;
+            if (!I2cModelAck(s, ack)) {
+                /* the transaction ends at a data nack, DATACNT tells how far it got */
+                I2cModelNextPhase(s, HPM_TEST_I2C_DATA);
+                break;
+            }
+        }
+        if (s->dataLeft == 0) {
+            I2cModelNextPhase(s, HPM_TEST_I2C_DATA);
+        } else {
+            I2cModelDataKick(s);
+        }
+        break;
+    case HPM_TEST_I2C_STOP:
+        s->status |= I2C_STATUS_STOP_MASK;
+        s->stops++;
+        s->busHeld = false;
+        if (s->bus.stop != NULL) {
+            s->bus.stop(s->bus.ctx);
+        }
+        I2cModelEnd(s, true);
+        break;
+    default:
+        s->eventBusy = false;
+        break;
+    }
+}
+
+static uint32_t I2cModelStatus(const struct HpmTestI2c *s)
+{
+    uint32_t status = s->status;
+
+    status |= s->busHeld ? I2C_STATUS_BUSBUSY_MASK : 0;
+    status |= (s->fifoCount == 0) ? I2C_STATUS_FIFOEMPTY_MASK : 0;
+    status |= (s->fifoCount == HPM_TEST_I2C_FIFO) ? I2C_STATUS_FIFOFULL_MASK : 0;
+    /* half empty for a transmitter, half full for a receiver */
+    if (s->read ? (s->fifoCount >= HPM_TEST_I2C_FIFO / 2U) : (s->fifoCount <= HPM_TEST_I2C_FIFO / 2U)) {
+        status |= I2C_STATUS_FIFOHALF_MASK;
+    }
+    return status;
+}
+
+static uint32_t I2cModelCtrl(const struct HpmTestI2c *s)
+{
+    /* DATACNT counts down as the bytes go over the bus */
+    return (s->ctrl & ~I2C_CTRL_DATACNT_MASK) | I2C_CTRL_DATACNT_SET(I2C_DATACNT_MAP(s->dataLeft));
+}
+
+static bool I2cModelIrqPending(void *ctx)
+{
+    const struct HpmTestI2c *s = (const struct HpmTestI2c *)ctx;
+
+    /* INTEN and STATUS share the bit positions */
+    return (I2cModelStatus(s) & s->inten & (I2C_STATUS_W1C | I2C_STATUS_FIFOHALF_MASK | I2C_STATUS_FIFOFULL_MASK |
+                                            I2C_STATUS_FIFOEMPTY_MASK)) != 0;
+}
+
+static uint32_t I2cModelRead(void *ctx, uint32_t offset)
+{
+    const struct HpmTestI2c *s = (const struct HpmTestI2c *)ctx;
+
+    switch (offset) {
+    case I2C_REG_CFG:
+        return I2C_CFG_FIFO_4;
+    case I2C_REG_INTEN:
+        return s->inten;
+    case I2C_REG_STATUS:
+        return I2cModelStatus(s);
+    case I2C_REG_ADDR:
+        return s->addr;
+    case I2C_REG_DATA:
+        return (s->fifoCount != 0) ? s->fifo[s->fifoHead] : 0;
+    case I2C_REG_CTRL:
+        return I2cModelCtrl(s);
+    case I2C_REG_CMD:
+        return (s->phase != HPM_TEST_I2C_IDLE) ? 1U : 0U;
+    case I2C_REG_SETUP:
+        return s->setup;
+    case I2C_REG_TPM:
+        return s->tpm;
+    default:
+        return 0;
+    }
+}
+
+static void I2cModelReadDone(void *ctx, uint32_t offset)
+{
+    struct HpmTestI2c *s = (struct HpmTestI2c *)ctx;
+
+    if ((offset == I2C_REG_DATA) && (s->fifoCount != 0)) {
+        s->fifoHead = (s->fifoHead + 1U) % HPM_TEST_I2C_FIFO;
+        s->fifoCount--;
+        I2cModelDataKick(s);
+    }
+}
+
+static void I2cModelReset(struct HpmTestI2c *s)
+{
+    s->phase = HPM_TEST_I2C_IDLE;
+    s->eventBusy = false;
+    s->status = 0;
+    s->inten = 0;
+    s->fifoCount = 0;
+    s->busHeld = false;
+    s->resets++;
+}
+
+static void I2cModelWrite(void *ctx, uint32_t offset, uint32_t value)
+{
+    struct HpmTestI2c *s = (struct HpmTestI2c *)ctx;
+
+    switch (offset) {
+    case I2C_REG_INTEN:
+        s->inten = value;
+        break;
+    case I2C_REG_STATUS:
+        s->status &= ~(value & I2C_STATUS_W1C);
+        break;
+    case I2C_REG_ADDR:
+        s->addr = value;
+        break;
+    case I2C_REG_DATA:
+        if (s->fifoCount < HPM_TEST_I2C_FIFO) {
+            s->fifo[(s->fifoHead + s->fifoCount) % HPM_TEST_I2C_FIFO] = (uint8_t)value;
+            s->fifoCount++;
+            I2cModelDataKick(s);
+        }
+        break;
+    case I2C_REG_CTRL:
+        if (s->phase == HPM_TEST_I2C_IDLE) {
+            uint32_t cnt = I2C_CTRL_DATACNT_GET(value);
+            s->ctrl = value;
+            s->dataLeft = (cnt == 0) ? I2C_SOC_TRANSFER_COUNT_MAX : cnt;
+        }
+        break;
+    case I2C_REG_CMD:
+        value = I2C_CMD_CMD_GET(value);
+        if (value == I2C_CMD_CMD_GET(I2C_CMD_ISSUE_DATA_TRANSMISSION)) {
+            I2cModelIssue(s);
+        } else if (value == I2C_CMD_CMD_GET(I2C_CMD_CLEAR_FIFO)) {
+            s->fifoCount = 0;
+        } else if (value == I2C_CMD_CMD_GET(I2C_CMD_RESET)) {
+            I2cModelReset(s);
+        }
+        break;
+    case I2C_REG_SETUP:
+        s->setup = value;
+        break;
+    case I2C_REG_TPM:
+        s->tpm = value;
+        break;
+    default:
+        break;
+    }
+}
+
+static const struct HpmTestMmioOps g_i2cOps = {
+    .read = I2cModelRead,
+    .readDone = I2cModelReadDone,
+    .write = I2cModelWrite,
+};
+
+static uint64_t I2cModelNext(void *ctx)
+{
+    const struct HpmTestI2c *s = (const struct HpmTestI2c *)ctx;
+
+    return (s->eventBusy && !s->stalled) ? s->eventNs : UINT64_MAX;
+}
+
+static void I2cModelRun(void *ctx)
+{
+    struct HpmTestI2c *s = (struct HpmTestI2c *)ctx;
+
+    if (!s->eventBusy || (s->eventNs > HpmTestNowNs())) {
+        return;
+    }
+    s->eventBusy = false;
+    I2cModelRunPhase(s);
+}
+
+void HpmTestI2cInit(struct HpmTestI2c *s, uint32_t base, uint32_t plicIrq, uint32_t clkHz)
+{
+    memset(s, 0, sizeof(*s));
+    s->base = base;
+    s->losIrq = HPM2LITEOS_IRQ(plicIrq);
+    s->clkHz = clkHz;
+    s->model.name = "i2c";
+    s->model.next = I2cModelNext;
+    s->model.run = I2cModelRun;
+    s->model.ctx = s;
+    HpmTestModelAdd(&s->model);
+    HpmTestMmioMap(base, I2C_REG_SIZE, &g_i2cOps, s);
+    HpmTestIrqSource(s->losIrq, I2cModelIrqPending, s);
+}
+
+void HpmTestI2cDeinit(struct HpmTestI2c *s)
+{
+    HpmTestModelRemove(&s->model);
+    HpmTestMmioUnmap(s->base);
+    HpmTestIrqSource(s->losIrq, NULL, NULL);
+}
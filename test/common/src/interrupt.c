@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hpm_interrupt.h"
+#include "los_interrupt.h"
+
+/*
+ * mstatus.MIE as seen by the SDK: disable returns the bit when it was set, so
+ * restore only reopens the lock it took.
+ */
+
+void enable_global_irq(uint32_t mask)
+{
+    (void)mask;
+    (void)LOS_IntUnLock();
+}
+
+uint32_t disable_global_irq(uint32_t mask)
+{
+    (void)LOS_IntLock();
+    return mask;
+}
+
+void restore_global_irq(uint32_t mask)
+{
+    if (mask != 0) {
+        LOS_IntRestore(0);
+    }
+}
+
+void enable_irq_from_intc(void)
+{
+}
+
+void disable_irq_from_intc(void)
+{
+}
+
+void enable_mchtmr_irq(void)
+{
+}
+
+void disable_mchtmr_irq(void)
+{
+}
+
+void intc_m_enable_swi(void)
+{
+}
+
+void intc_m_disable_swi(void)
+{
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hpm_l1c_drv.h"
+
+static bool g_cacheEnabled = true;
+static struct HpmTestCacheStats g_cacheStats;
+
+static void CacheCheckRange(uint32_t address, uint32_t size)
+{
+    if ((address % HPM_L1C_CACHELINE_SIZE) || (size % HPM_L1C_CACHELINE_SIZE)) {
+        g_cacheStats.misaligned++;
+    }
+}
+
+bool l1c_dc_is_enabled(void)
+{
+    return g_cacheEnabled;
+}
+
+bool l1c_ic_is_enabled(void)
+{
+    return g_cacheEnabled;
+}
+
+void l1c_dc_invalidate(uint32_t address, uint32_t size)
+{
+    CacheCheckRange(address, size);
+    g_cacheStats.invalidate++;
+}
+
+void l1c_dc_writeback(uint32_t address, uint32_t size)
+{
+    CacheCheckRange(address, size);
+    g_cacheStats.writeback++;
+}
+
+void l1c_dc_flush(uint32_t address, uint32_t size)
+{
+    CacheCheckRange(address, size);
+    g_cacheStats.flush++;
+}
+
+void l1c_dc_invalidate_all(void)
+{
+    g_cacheStats.invalidate++;
+}
+
+void l1c_dc_writeback_all(void)
+{
+    g_cacheStats.writeback++;
+}
+
+void l1c_dc_flush_all(void)
+{
+    g_cacheStats.flush++;
+}
+
+void HpmTestCacheEnable(bool enable)
+{
+    g_cacheEnabled = enable;
+}
+
+void HpmTestCacheStats(struct HpmTestCacheStats *stats)
+{
+    *stats = g_cacheStats;
+}
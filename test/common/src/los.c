@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "los_interrupt.h"
+#include "hpm_test_priv.h"
+
+/* Deliveries in one go beyond this are an interrupt nobody acknowledges */
+#define HWI_STORM_MAX 100000
+
+struct HwiEntry {
+    HWI_PROC_FUNC handler;
+    VOID *arg;
+    bool created;
+    bool enabled;
+    bool (*pending)(void *ctx);
+    void *ctx;
+    uint32_t count;
+};
+
+static struct HwiEntry g_hwis[OS_HWI_MAX_NUM];
+static pthread_mutex_t g_intMutex;
+static __thread uint32_t g_lockDepth;
+static __thread bool g_inIrq;
+static uint32_t g_hwiCreateFail;
+static uint64_t g_lockStartNs;
+static uint64_t g_lockMaxNs;
+static uint64_t g_lockTotalNs;
+static uint32_t g_lockCount;
+
+__attribute__((constructor)) static void HpmTestIntInit(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&g_intMutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+UINT32 LOS_IntLock(VOID)
+{
+    pthread_mutex_lock(&g_intMutex);
+    if (g_lockDepth++ == 0) {
+        g_lockStartNs = HpmTestHostNs();
+    }
+    return g_lockDepth - 1;
+}
+
+static VOID HpmTestIntUnlockOne(VOID)
+{
+    if (g_lockDepth == 0) {
+        return;
+    }
+    if (--g_lockDepth == 0) {
+        uint64_t ns = HpmTestHostNs() - g_lockStartNs;
+        g_lockTotalNs += ns;
+        g_lockMaxNs = (ns > g_lockMaxNs) ? ns : g_lockMaxNs;
+        g_lockCount++;
+    }
+    pthread_mutex_unlock(&g_intMutex);
+}
+
+VOID LOS_IntRestore(UINT32 intSave)
+{
+    (void)intSave;
+    HpmTestIntUnlockOne();
+    HpmTestIrqDeliver();
+}
+
+/* Isrs run with the lock held, as they run with mstatus.MIE clear on the target */
+UINT32 LOS_IntLocked(VOID)
+{
+    return g_lockDepth != 0;
+}
+
+UINT32 LOS_IntUnLock(VOID)
+{
+    while (g_lockDepth != 0) {
+        HpmTestIntUnlockOne();
+    }
+    HpmTestIrqDeliver();
+    return 0;
+}
+
+UINT32 LOS_HwiCreate(HWI_HANDLE_T hwiNum, HWI_PRIOR_T hwiPrio, HWI_MODE_T hwiMode, HWI_PROC_FUNC hwiHandler,
+                     HwiIrqParam *irqParam)
+{
+    (void)hwiPrio;
+    (void)hwiMode;
+
+    if ((hwiNum >= OS_HWI_MAX_NUM) || (hwiHandler == NULL) || g_hwis[hwiNum].created) {
+        return LOS_NOK;
+    }
+    if (g_hwiCreateFail != 0) {
+        g_hwiCreateFail--;
+        return LOS_NOK;
+    }
+
+    g_hwis[hwiNum].handler = hwiHandler;
+    g_hwis[hwiNum].arg = (irqParam != NULL) ? irqParam->pDevId : NULL;
+    g_hwis[hwiNum].created = true;
+    g_hwis[hwiNum].enabled = false;
+    return LOS_OK;
+}
+
+UINT32 LOS_HwiDelete(HWI_HANDLE_T hwiNum, HwiIrqParam *irqParam)
+{
+    (void)irqParam;
+
+    if (hwiNum >= OS_HWI_MAX_NUM) {
+        return LOS_NOK;
+    }
+    g_hwis[hwiNum].handler = NULL;
+    g_hwis[hwiNum].created = false;
+    g_hwis[hwiNum].enabled = false;
+    return LOS_OK;
+}
+
+UINT32 LOS_HwiEnable(HWI_HANDLE_T hwiNum)
+{
+    if (hwiNum >= OS_HWI_MAX_NUM) {
+        return LOS_NOK;
+    }
+    g_hwis[hwiNum].enabled = true;
+    HpmTestIrqDeliver();
+    return LOS_OK;
+}
+
+UINT32 LOS_HwiDisable(HWI_HANDLE_T hwiNum)
+{
+    if (hwiNum >= OS_HWI_MAX_NUM) {
+        return LOS_NOK;
+    }
+    g_hwis[hwiNum].enabled = false;
+    return LOS_OK;
+}
+
+static void HpmTestIrqRun(struct HwiEntry *hwi)
+{
+    pthread_mutex_lock(&g_intMutex);
+    g_lockDepth++;
+    g_inIrq = true;
+    hwi->count++;
+    hwi->handler(hwi->arg);
+    g_inIrq = false;
+    g_lockDepth--;
+    pthread_mutex_unlock(&g_intMutex);
+}
+
+void HpmTestIrqSource(uint32_t losIrq, bool (*pending)(void *ctx), void *ctx)
+{
+    if (losIrq < OS_HWI_MAX_NUM) {
+        g_hwis[losIrq].pending = pending;
+        g_hwis[losIrq].ctx = ctx;
+    }
+}
+
+void HpmTestIrqDeliver(void)
+{
+    uint32_t storm = 0;
+    uint32_t i = 0;
+
+    if (g_inIrq || (g_lockDepth != 0)) {
+        return;
+    }
+
+    /* lowest number first, rescan after every handler as it may have raised others */
+    while (i < OS_HWI_MAX_NUM) {
+        struct HwiEntry *hwi = &g_hwis[i];
+        if (hwi->created && hwi->enabled && (hwi->pending != NULL) && hwi->pending(hwi->ctx)) {
+            if (++storm > HWI_STORM_MAX) {
+                fprintf(stderr, "irq %u stays pending after its handler ran\n", i);
+                abort();
+            }
+            HpmTestIrqRun(hwi);
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+}
+
+bool HpmTestInIrq(void)
+{
+    return g_inIrq;
+}
+
+bool HpmTestIrqRaise(uint32_t losIrq)
+{
+    if ((losIrq >= OS_HWI_MAX_NUM) || !g_hwis[losIrq].created) {
+        return false;
+    }
+    HpmTestIrqRun(&g_hwis[losIrq]);
+    return true;
+}
+
+bool HpmTestIrqInstalled(uint32_t losIrq)
+{
+    return (losIrq < OS_HWI_MAX_NUM) && g_hwis[losIrq].created && g_hwis[losIrq].enabled;
+}
+
+uint32_t HpmTestIrqCount(uint32_t losIrq)
+{
+    return (losIrq < OS_HWI_MAX_NUM) ? g_hwis[losIrq].count : 0;
+}
+
+void HpmTestHwiCreateFail(uint32_t count)
+{
+    g_hwiCreateFail = count;
+}
+
+void HpmTestIntLockStats(uint64_t *maxNs, uint64_t *totalNs, uint32_t *count)
+{
+    *maxNs = g_lockMaxNs;
+    *totalNs = g_lockTotalNs;
+    *count = g_lockCount;
+}
+
+void HpmTestIntLockStatsReset(void)
+{
+    g_lockMaxNs = 0;
+    g_lockTotalNs = 0;
+    g_lockCount = 0;
+}
@@ -0,0 +1,679 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * LiteOS-M tasks, semaphores, mutexes, queues and exception hooks, and the
+ * board console. Tasks run one at a time, handing the cpu back and forth with
+ * the test through g_taskRunning, so the code under test sees a single core.
+ * A tick is a millisecond of HpmTestNowNs(); timed waits only expire while the
+ * test runs the clock, see HpmTestTaskRunUntilDone().
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "los_debug.h"
+#include "los_interrupt.h"
+#include "los_mux.h"
+#include "los_queue.h"
+#include "los_sem.h"
+#include "los_task.h"
+#include "los_tick.h"
+#include "uart.h"
+#include "hpm_test.h"
+
+#define TASK_MAX 16
+#define TASK_NONE (-1)
+/* the ehci host driver takes one per pipe */
+#define SEM_MAX 128
+#define SEM_COUNT_MAX 0xFFFEU
+#define MUX_MAX 8
+#define QUEUE_MAX 8
+#define QUEUE_MSG_MAX 16
+#define QUEUE_LEN_MAX 64
+#define EXC_HOOK_MAX 4
+#define CONSOLE_SIZE 65536
+#define NS_PER_TICK (1000000000ULL / LOSCFG_BASE_CORE_TICK_PER_SECOND)
+#define MAIN_WAIT_MAX_NS 10000000000ULL
+
+struct HostTask {
+    pthread_t thread;
+    TSK_ENTRY_FUNC entry;
+    UINTPTR arg;
+    /* the task waits until waitReady(waitObj) holds or the clock reaches waitUntilNs */
+    bool (*waitReady)(UINT32 obj);
+    UINT32 waitObj;
+    uint64_t waitUntilNs;
+    /* task to hand the cpu back to once a deleted task has left */
+    int deleter;
+    bool used;
+    bool started;
+    bool deleted;
+};
+
+struct HostLosSem {
+    bool used;
+    uint32_t count;
+    uint32_t maxCount;
+};
+
+struct HostLosMux {
+    bool used;
+    int owner;
+    uint32_t depth;
+};
+
+struct HostLosQueue {
+    bool used;
+    uint16_t len;
+    uint16_t msgSize;
+    uint16_t head;
+    uint16_t count;
+    uint8_t msgs[QUEUE_LEN_MAX][QUEUE_MSG_MAX];
+};
+
+static pthread_mutex_t g_taskLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_taskCond = PTHREAD_COND_INITIALIZER;
+static struct HostTask g_tasks[TASK_MAX];
+static int g_taskRunning = TASK_NONE;
+static __thread int g_taskSelf = TASK_NONE;
+static struct HostLosSem g_sems[SEM_MAX];
+static struct HostLosMux g_muxes[MUX_MAX];
+static struct HostLosQueue g_queues[QUEUE_MAX];
+static ExcHookFn g_excHooks[EXC_TYPE_END][EXC_HOOK_MAX];
+static char g_console[CONSOLE_SIZE];
+static uint32_t g_consoleLen;
+static uint32_t g_consoleLocked;
+
+/* Called with g_taskLock held by a task that was deleted, never returns */
+static void HostTaskExit(struct HostTask *task)
+{
+    task->used = false;
+    g_taskRunning = task->deleter;
+    pthread_cond_broadcast(&g_taskCond);
+    pthread_mutex_unlock(&g_taskLock);
+    pthread_exit(NULL);
+}
+
+/* Called with g_taskLock held, returns once <self> owns the cpu again */
+static void HostTaskSwitch(int to, int self)
+{
+    g_taskRunning = to;
+    pthread_cond_broadcast(&g_taskCond);
+    while (g_taskRunning != self) {
+        pthread_cond_wait(&g_taskCond, &g_taskLock);
+    }
+    if ((self != TASK_NONE) && g_tasks[self].deleted) {
+        HostTaskExit(&g_tasks[self]);
+    }
+}
+
+static void *HostTaskThread(void *arg)
+{
+    struct HostTask *task = arg;
+
+    g_taskSelf = (int)(task - g_tasks);
+    pthread_mutex_lock(&g_taskLock);
+    while (g_taskRunning != g_taskSelf) {
+        pthread_cond_wait(&g_taskCond, &g_taskLock);
+    }
+    if (task->deleted) {
+        HostTaskExit(task);
+    }
+    pthread_mutex_unlock(&g_taskLock);
+
+    (void)task->entry(task->arg);
+
+    /* a task that returns is gone, as if it deleted itself */
+    pthread_mutex_lock(&g_taskLock);
+    task->deleter = TASK_NONE;
+    HostTaskExit(task);
+    return NULL;
+}
+
+UINT32 LOS_TaskCreate(UINT32 *taskID, TSK_INIT_PARAM_S *taskInitParam)
+{
+    struct HostTask *task = NULL;
+    UINT32 i;
+
+    if ((taskID == NULL) || (taskInitParam == NULL) || (taskInitParam->pfnTaskEntry == NULL)) {
+        return LOS_NOK;
+    }
+    pthread_mutex_lock(&g_taskLock);
+    for (i = 0; i < TASK_MAX; i++) {
+        if (!g_tasks[i].used) {
+            task = &g_tasks[i];
+            break;
+        }
+    }
+    if (task == NULL) {
+        pthread_mutex_unlock(&g_taskLock);
+        return LOS_NOK;
+    }
+    memset(task, 0, sizeof(*task));
+    task->entry = taskInitParam->pfnTaskEntry;
+    task->arg = taskInitParam->uwArg;
+    task->waitUntilNs = UINT64_MAX;
+    task->used = true;
+    if (pthread_create(&task->thread, NULL, HostTaskThread, task) != 0) {
+        task->used = false;
+        pthread_mutex_unlock(&g_taskLock);
+        return LOS_NOK;
+    }
+    pthread_detach(task->thread);
+    pthread_mutex_unlock(&g_taskLock);
+    *taskID = i;
+    return LOS_OK;
+}
+
+UINT32 LOS_TaskDelete(UINT32 taskID)
+{
+    struct HostTask *task;
+
+    if (taskID >= TASK_MAX) {
+        return LOS_ERRNO_TSK_ID_INVALID;
+    }
+    pthread_mutex_lock(&g_taskLock);
+    task = &g_tasks[taskID];
+    if (!task->used || task->deleted) {
+        pthread_mutex_unlock(&g_taskLock);
+        return LOS_ERRNO_TSK_ID_INVALID;
+    }
+    /* the task leaves from its own thread, then hands the cpu back */
+    task->deleted = true;
+    task->deleter = g_taskSelf;
+    if ((int)taskID == g_taskSelf) {
+        task->deleter = TASK_NONE;
+        HostTaskExit(task);
+    }
+    HostTaskSwitch((int)taskID, g_taskSelf);
+    pthread_mutex_unlock(&g_taskLock);
+    return LOS_OK;
+}
+
+UINT32 LOS_CurTaskIDGet(VOID)
+{
+    /* the test itself runs as the task past the last slot */
+    return (g_taskSelf == TASK_NONE) ? TASK_MAX : (UINT32)g_taskSelf;
+}
+
+UINT32 LOS_MS2Tick(UINT32 millisec)
+{
+    return (UINT32)(((UINT64)millisec * LOSCFG_BASE_CORE_TICK_PER_SECOND + 999U) / 1000U);
+}
+
+UINT64 LOS_TickCountGet(VOID)
+{
+    return HpmTestNowNs() / NS_PER_TICK;
+}
+
+/* Called with g_taskLock held */
+static bool HostTaskReady(const struct HostTask *task)
+{
+    if (!task->started) {
+        return true;
+    }
+    if ((task->waitReady != NULL) && task->waitReady(task->waitObj)) {
+        return true;
+    }
+    return HpmTestNowNs() >= task->waitUntilNs;
+}
+
+void HpmTestTaskRun(void)
+{
+    pthread_mutex_lock(&g_taskLock);
+    for (;;) {
+        uint32_t i;
+        for (i = 0; i < TASK_MAX; i++) {
+            if (g_tasks[i].used && HostTaskReady(&g_tasks[i])) {
+                break;
+            }
+        }
+        if (i == TASK_MAX) {
+            break;
+        }
+        g_tasks[i].started = true;
+        HostTaskSwitch((int)i, TASK_NONE);
+    }
+    pthread_mutex_unlock(&g_taskLock);
+}
+
+uint32_t HpmTestTaskCount(void)
+{
+    uint32_t count = 0;
+
+    pthread_mutex_lock(&g_taskLock);
+    for (uint32_t i = 0; i < TASK_MAX; i++) {
+        count += g_tasks[i].used ? 1U : 0U;
+    }
+    pthread_mutex_unlock(&g_taskLock);
+    return count;
+}
+
+struct HostWaitArg {
+    bool (*done)(void *arg);
+    void *arg;
+};
+
+/* Stops the clock once a task can run or the wait is over */
+static bool HostTaskReadyOrDone(void *arg)
+{
+    const struct HostWaitArg *wait = arg;
+    bool ready = false;
+
+    pthread_mutex_lock(&g_taskLock);
+    for (uint32_t i = 0; i < TASK_MAX; i++) {
+        if (g_tasks[i].used && HostTaskReady(&g_tasks[i])) {
+            ready = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_taskLock);
+    return ready || wait->done(wait->arg);
+}
+
+bool HpmTestTaskRunUntilDone(uint64_t untilNs, bool (*done)(void *arg), void *arg)
+{
+    struct HostWaitArg wait = { .done = done, .arg = arg };
+
+    for (;;) {
+        uint64_t nextNs = untilNs;
+
+        HpmTestTaskRun();
+        if (done(arg)) {
+            return true;
+        }
+        if (!HpmTestIsVirtualTime() || (HpmTestNowNs() >= untilNs)) {
+            return false;
+        }
+        pthread_mutex_lock(&g_taskLock);
+        for (uint32_t i = 0; i < TASK_MAX; i++) {
+            if (g_tasks[i].used && (g_tasks[i].waitUntilNs < nextNs)) {
+                nextNs = g_tasks[i].waitUntilNs;
+            }
+        }
+        pthread_mutex_unlock(&g_taskLock);
+        (void)HpmTestRunUntilDone(nextNs, HostTaskReadyOrDone, &wait);
+    }
+}
+
+struct HostWaitObj {
+    bool (*ready)(UINT32 obj);
+    UINT32 obj;
+};
+
+static bool HostWaitObjReady(void *arg)
+{
+    const struct HostWaitObj *wait = arg;
+
+    return wait->ready(wait->obj);
+}
+
+/*
+ * Called with g_taskLock held, waits until ready(obj) holds or <ticks> pass.
+ * A task hands the cpu to the test meanwhile. The test runs the tasks and, in
+ * virtual time, the clock; it gives up a wait forever after MAIN_WAIT_MAX_NS
+ * as deadlocked. Without virtual time it cannot wait for anything but the tasks.
+ */
+static bool HostWait(bool (*ready)(UINT32 obj), UINT32 obj, UINT32 ticks)
+{
+    uint64_t untilNs = UINT64_MAX;
+    bool ret;
+
+    if (ready(obj) || (ticks == LOS_NO_WAIT)) {
+        return ready(obj);
+    }
+    if (ticks != LOS_WAIT_FOREVER) {
+        untilNs = HpmTestNowNs() + (uint64_t)ticks * NS_PER_TICK;
+    }
+    if (g_taskSelf != TASK_NONE) {
+        struct HostTask *task = &g_tasks[g_taskSelf];
+        task->waitReady = ready;
+        task->waitObj = obj;
+        task->waitUntilNs = untilNs;
+        HostTaskSwitch(TASK_NONE, g_taskSelf);
+        task->waitReady = NULL;
+        task->waitUntilNs = UINT64_MAX;
+        return ready(obj);
+    } else {
+        struct HostWaitObj wait = { .ready = ready, .obj = obj };
+        if (untilNs == UINT64_MAX) {
+            untilNs = HpmTestNowNs() + MAIN_WAIT_MAX_NS;
+        }
+        pthread_mutex_unlock(&g_taskLock);
+        ret = HpmTestTaskRunUntilDone(untilNs, HostWaitObjReady, &wait);
+        pthread_mutex_lock(&g_taskLock);
+        return ret || ready(obj);
+    }
+}
+
+static bool HostNever(UINT32 obj)
+{
+    (void)obj;
+    return false;
+}
+
+UINT32 LOS_TaskDelay(UINT32 tick)
+{
+    if (tick == 0) {
+        return LOS_OK;
+    }
+    pthread_mutex_lock(&g_taskLock);
+    (void)HostWait(HostNever, 0, tick);
+    pthread_mutex_unlock(&g_taskLock);
+    return LOS_OK;
+}
+
+static UINT32 HostSemCreate(UINT16 count, UINT32 maxCount, UINT32 *semHandle)
+{
+    if ((semHandle == NULL) || (count > maxCount)) {
+        return LOS_NOK;
+    }
+    for (UINT32 i = 0; i < SEM_MAX; i++) {
+        if (!g_sems[i].used) {
+            g_sems[i].used = true;
+            g_sems[i].count = count;
+            g_sems[i].maxCount = maxCount;
+            *semHandle = i;
+            return LOS_OK;
+        }
+    }
+    return LOS_NOK;
+}
+
+UINT32 LOS_SemCreate(UINT16 count, UINT32 *semHandle)
+{
+    return HostSemCreate(count, SEM_COUNT_MAX, semHandle);
+}
+
+UINT32 LOS_BinarySemCreate(UINT16 count, UINT32 *semHandle)
+{
+    return HostSemCreate(count, 1, semHandle);
+}
+
+UINT32 LOS_SemDelete(UINT32 semHandle)
+{
+    if ((semHandle >= SEM_MAX) || !g_sems[semHandle].used) {
+        return LOS_NOK;
+    }
+    g_sems[semHandle].used = false;
+    return LOS_OK;
+}
+
+UINT32 LOS_SemPost(UINT32 semHandle)
+{
+    UINT32 ret = LOS_OK;
+
+    if ((semHandle >= SEM_MAX) || !g_sems[semHandle].used) {
+        return LOS_NOK;
+    }
+    pthread_mutex_lock(&g_taskLock);
+    if (g_sems[semHandle].count == g_sems[semHandle].maxCount) {
+        ret = LOS_ERRNO_SEM_OVERFLOW;
+    } else {
+        g_sems[semHandle].count++;
+    }
+    pthread_mutex_unlock(&g_taskLock);
+    return ret;
+}
+
+static bool HostSemReady(UINT32 semHandle)
+{
+    return g_sems[semHandle].count != 0;
+}
+
+UINT32 LOS_SemPend(UINT32 semHandle, UINT32 timeout)
+{
+    UINT32 ret = LOS_OK;
+
+    if ((semHandle >= SEM_MAX) || !g_sems[semHandle].used) {
+        return LOS_NOK;
+    }
+    pthread_mutex_lock(&g_taskLock);
+    if (HostWait(HostSemReady, semHandle, timeout)) {
+        g_sems[semHandle].count--;
+    } else {
+        ret = (timeout == LOS_NO_WAIT) ? LOS_ERRNO_SEM_UNAVAILABLE : LOS_ERRNO_SEM_TIMEOUT;
+    }
+    pthread_mutex_unlock(&g_taskLock);
+    return ret;
+}
+
+UINT32 LOS_MuxCreate(UINT32 *muxHandle)
+{
+    if (muxHandle == NULL) {
+        return LOS_NOK;
+    }
+    for (UINT32 i = 0; i < MUX_MAX; i++) {
+        if (!g_muxes[i].used) {
+            g_muxes[i].used = true;
+            g_muxes[i].depth = 0;
+            *muxHandle = i;
+            return LOS_OK;
+        }
+    }
+    return LOS_NOK;
+}
+
+UINT32 LOS_MuxDelete(UINT32 muxHandle)
+{
+    if ((muxHandle >= MUX_MAX) || !g_muxes[muxHandle].used || (g_muxes[muxHandle].depth != 0)) {
+        return LOS_NOK;
+    }
+    g_muxes[muxHandle].used = false;
+    return LOS_OK;
+}
+
+static bool HostMuxReady(UINT32 muxHandle)
+{
+    return g_muxes[muxHandle].depth == 0;
+}
+
+UINT32 LOS_MuxPend(UINT32 muxHandle, UINT32 timeout)
+{
+    struct HostLosMux *mux;
+    UINT32 ret = LOS_OK;
+
+    if ((muxHandle >= MUX_MAX) || !g_muxes[muxHandle].used) {
+        return LOS_NOK;
+    }
+    mux = &g_muxes[muxHandle];
+    pthread_mutex_lock(&g_taskLock);
+    if ((mux->depth != 0) && (mux->owner == g_taskSelf)) {
+        mux->depth++;
+    } else if (HostWait(HostMuxReady, muxHandle, timeout)) {
+        mux->owner = g_taskSelf;
+        mux->depth = 1;
+    } else {
+        ret = (timeout == LOS_NO_WAIT) ? LOS_ERRNO_MUX_UNAVAILABLE : LOS_ERRNO_MUX_TIMEOUT;
+    }
+    pthread_mutex_unlock(&g_taskLock);
+    return ret;
+}
+
+UINT32 LOS_MuxPost(UINT32 muxHandle)
+{
+    struct HostLosMux *mux;
+    UINT32 ret = LOS_OK;
+
+    if ((muxHandle >= MUX_MAX) || !g_muxes[muxHandle].used) {
+        return LOS_NOK;
+    }
+    mux = &g_muxes[muxHandle];
+    pthread_mutex_lock(&g_taskLock);
+    if ((mux->depth == 0) || (mux->owner != g_taskSelf)) {
+        ret = LOS_NOK;
+    } else {
+        mux->depth--;
+    }
+    pthread_mutex_unlock(&g_taskLock);
+    return ret;
+}
+
+UINT32 LOS_QueueCreate(const CHAR *queueName, UINT16 len, UINT32 *queueID, UINT32 flags, UINT16 maxMsgSize)
+{
+    (void)queueName;
+    (void)flags;
+    if ((queueID == NULL) || (len == 0) || (len > QUEUE_LEN_MAX) || (maxMsgSize == 0) ||
+        (maxMsgSize > QUEUE_MSG_MAX)) {
+        return LOS_NOK;
+    }
+    for (UINT32 i = 0; i < QUEUE_MAX; i++) {
+        if (!g_queues[i].used) {
+            memset(&g_queues[i], 0, sizeof(g_queues[i]));
+            g_queues[i].used = true;
+            g_queues[i].len = len;
+            g_queues[i].msgSize = maxMsgSize;
+            *queueID = i;
+            return LOS_OK;
+        }
+    }
+    return LOS_NOK;
+}
+
+UINT32 LOS_QueueDelete(UINT32 queueID)
+{
+    if ((queueID >= QUEUE_MAX) || !g_queues[queueID].used) {
+        return LOS_NOK;
+    }
+    g_queues[queueID].used = false;
+    return LOS_OK;
+}
+
+static bool HostQueueWritable(UINT32 queueID)
+{
+    return g_queues[queueID].count < g_queues[queueID].len;
+}
+
+static bool HostQueueReadable(UINT32 queueID)
+{
+    return g_queues[queueID].count != 0;
+}
+
+UINT32 LOS_QueueWriteCopy(UINT32 queueID, VOID *bufferAddr, UINT32 bufferSize, UINT32 timeout)
+{
+    struct HostLosQueue *queue;
+    UINT32 ret = LOS_OK;
+
+    if ((queueID >= QUEUE_MAX) || !g_queues[queueID].used || (bufferAddr == NULL) ||
+        (bufferSize > g_queues[queueID].msgSize)) {
+        return LOS_NOK;
+    }
+    queue = &g_queues[queueID];
+    pthread_mutex_lock(&g_taskLock);
+    if (HostWait(HostQueueWritable, queueID, timeout)) {
+        memcpy(queue->msgs[(queue->head + queue->count) % queue->len], bufferAddr, bufferSize);
+        queue->count++;
+    } else {
+        ret = (timeout == LOS_NO_WAIT) ? LOS_ERRNO_QUEUE_ISFULL : LOS_ERRNO_QUEUE_TIMEOUT;
+    }
+    pthread_mutex_unlock(&g_taskLock);
+    return ret;
+}
+
+UINT32 LOS_QueueReadCopy(UINT32 queueID, VOID *bufferAddr, UINT32 *bufferSize, UINT32 timeout)
+{
+    struct HostLosQueue *queue;
+    UINT32 ret = LOS_OK;
+
+    if ((queueID >= QUEUE_MAX) || !g_queues[queueID].used || (bufferAddr == NULL) || (bufferSize == NULL) ||
+        (*bufferSize < g_queues[queueID].msgSize)) {
+        return LOS_NOK;
+    }
+    queue = &g_queues[queueID];
+    pthread_mutex_lock(&g_taskLock);
+    if (HostWait(HostQueueReadable, queueID, timeout)) {
+        memcpy(bufferAddr, queue->msgs[queue->head], queue->msgSize);
+        *bufferSize = queue->msgSize;
+        queue->head = (uint16_t)((queue->head + 1U) % queue->len);
+        queue->count--;
+    } else {
+        ret = (timeout == LOS_NO_WAIT) ? LOS_ERRNO_QUEUE_ISEMPTY : LOS_ERRNO_QUEUE_TIMEOUT;
+    }
+    pthread_mutex_unlock(&g_taskLock);
+    return ret;
+}
+
+UINT32 LOS_RegExcHook(EXC_TYPE excType, ExcHookFn excHookFn)
+{
+    if ((excType >= EXC_TYPE_END) || (excHookFn == NULL)) {
+        return LOS_NOK;
+    }
+    for (uint32_t i = 0; i < EXC_HOOK_MAX; i++) {
+        if (g_excHooks[excType][i] == NULL) {
+            g_excHooks[excType][i] = excHookFn;
+            return LOS_OK;
+        }
+    }
+    return LOS_NOK;
+}
+
+UINT32 LOS_UnRegExcHook(EXC_TYPE excType, ExcHookFn excHookFn)
+{
+    if (excType >= EXC_TYPE_END) {
+        return LOS_NOK;
+    }
+    for (uint32_t i = 0; i < EXC_HOOK_MAX; i++) {
+        if (g_excHooks[excType][i] == excHookFn) {
+            g_excHooks[excType][i] = NULL;
+            return LOS_OK;
+        }
+    }
+    return LOS_NOK;
+}
+
+VOID OsDoExcHook(EXC_TYPE excType)
+{
+    if (excType >= EXC_TYPE_END) {
+        return;
+    }
+    for (uint32_t i = 0; i < EXC_HOOK_MAX; i++) {
+        if (g_excHooks[excType][i] != NULL) {
+            g_excHooks[excType][i](excType);
+        }
+    }
+}
+
+int UartPutc(int c, void *file)
+{
+    (void)file;
+    if (g_consoleLen < CONSOLE_SIZE - 1) {
+        g_console[g_consoleLen++] = (char)c;
+        g_console[g_consoleLen] = '\0';
+    }
+    if (LOS_IntLocked()) {
+        g_consoleLocked++;
+    }
+    return c;
+}
+
+const char *HpmTestConsole(void)
+{
+    return g_console;
+}
+
+void HpmTestConsoleReset(void)
+{
+    g_consoleLen = 0;
+    g_consoleLocked = 0;
+    g_console[0] = '\0';
+}
+
+uint32_t HpmTestConsoleLocked(void)
+{
+    return g_consoleLocked;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "hpm_soc.h"
+#include "hpm_clock_drv.h"
+#include "hpm_csr_drv.h"
+#include "hpm_test_gpio.h"
+
+#define MCHTMR_REG_MTIME_LO 0x0U
+#define MCHTMR_REG_MTIME_HI 0x4U
+#define MCHTMR_REG_SIZE 0x10U
+
+static uint32_t g_mchtmrHz;
+
+uint64_t HpmTestMchtmrTicks(void)
+{
+    uint64_t ns = HpmTestNowNs();
+
+    return (ns / 1000000000ULL) * g_mchtmrHz + (ns % 1000000000ULL) * g_mchtmrHz / 1000000000ULL;
+}
+
+static uint32_t MchtmrModelRead(void *ctx, uint32_t offset)
+{
+    (void)ctx;
+    switch (offset) {
+    case MCHTMR_REG_MTIME_LO:
+        return (uint32_t)HpmTestMchtmrTicks();
+    case MCHTMR_REG_MTIME_HI:
+        return (uint32_t)(HpmTestMchtmrTicks() >> 32);
+    default:
+        return 0;
+    }
+}
+
+static void MchtmrModelWrite(void *ctx, uint32_t offset, uint32_t value)
+{
+    (void)ctx;
+    (void)offset;
+    (void)value;
+}
+
+static const struct HpmTestMmioOps g_mchtmrOps = {
+    .read = MchtmrModelRead,
+    .write = MchtmrModelWrite,
+};
+
+void HpmTestMchtmrInit(uint32_t hz)
+{
+    g_mchtmrHz = hz;
+    hpm_core_clock = hz;
+    HpmTestMmioMap(HPM_MCHTMR_BASE, MCHTMR_REG_SIZE, &g_mchtmrOps, NULL);
+}
+
+void HpmTestMchtmrDeinit(void)
+{
+    HpmTestMmioUnmap(HPM_MCHTMR_BASE);
+}
+
+/* The only clock the drivers under test ask for is the machine timer */
+uint32_t clock_get_frequency(clock_name_t clock_name)
+{
+    (void)clock_name;
+    return g_mchtmrHz;
+}
+
+/* The core cycle counter runs at the machine timer rate, so cycle deltas follow virtual time */
+uint32_t hpm_core_clock;
+
+uint64_t hpm_csr_get_core_cycle(void)
+{
+    return HpmTestMchtmrTicks();
+}
+
+void clock_cpu_delay_us(uint32_t us)
+{
+    HpmTestCpuNs((uint64_t)us * 1000ULL);
+}
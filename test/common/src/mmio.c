@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include "hpm_test_priv.h"
+
+/*
+ * A cpu access to a modelled register page faults. The handler fills the word
+ * with the model's value, opens the page and single steps the access, the trap
+ * after it hands a written value to the model and closes the page again.
+ */
+
+#define MMIO_PAGE_SIZE 0x1000UL
+#define MMIO_REGION_MAX 64
+#define MMIO_EFLAGS_TF 0x100UL
+#define MMIO_PF_WRITE 0x2UL
+
+struct MmioWindow {
+    uintptr_t base;
+    size_t size;
+};
+
+struct MmioRegion {
+    uint32_t base;
+    uint32_t size;
+    const struct HpmTestMmioOps *ops;
+    void *ctx;
+};
+
+struct MmioAccess {
+    uintptr_t word;
+    struct MmioRegion *region;
+    bool write;
+};
+
+static const struct MmioWindow g_windows[] = {
+    { 0xE4000000UL, 0x02800000UL }, /* plic, mchtmr, plicsw */
+    { 0xF0000000UL, 0x03100000UL }, /* peripherals */
+};
+
+static struct MmioRegion g_regions[MMIO_REGION_MAX];
+static struct MmioAccess g_access;
+static uint32_t g_costNs;
+static uint64_t g_accesses;
+
+static bool MmioInWindow(uintptr_t addr)
+{
+    for (uint32_t i = 0; i < sizeof(g_windows) / sizeof(g_windows[0]); i++) {
+        if ((addr >= g_windows[i].base) && (addr < g_windows[i].base + g_windows[i].size)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static struct MmioRegion *MmioFind(uintptr_t addr)
+{
+    for (uint32_t i = 0; i < MMIO_REGION_MAX; i++) {
+        struct MmioRegion *r = &g_regions[i];
+        if ((r->ops != NULL) && (addr >= r->base) && (addr < (uintptr_t)r->base + r->size)) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+static bool MmioPageModelled(uintptr_t page)
+{
+    for (uint32_t i = 0; i < MMIO_REGION_MAX; i++) {
+        struct MmioRegion *r = &g_regions[i];
+        if ((r->ops != NULL) && (page < (uintptr_t)r->base + r->size) && (page + MMIO_PAGE_SIZE > r->base)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void MmioProtect(uintptr_t page)
+{
+    int prot = MmioPageModelled(page) ? PROT_NONE : (PROT_READ | PROT_WRITE);
+
+    (void)mprotect((void *)page, MMIO_PAGE_SIZE, prot);
+}
+
+static void MmioFault(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    (void)sig;
+
+    if (!MmioInWindow(addr) || (g_access.word != 0)) {
+        /* a real fault, let it happen again with the default action */
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    g_access.word = addr & ~3UL;
+    g_access.region = MmioFind(addr);
+    g_access.write = (uc->uc_mcontext.gregs[REG_ERR] & MMIO_PF_WRITE) != 0;
+    g_accesses++;
+    (void)mprotect((void *)(addr & ~(MMIO_PAGE_SIZE - 1)), MMIO_PAGE_SIZE, PROT_READ | PROT_WRITE);
+
+    if (g_access.region != NULL) {
+        if ((g_costNs != 0) && HpmTestIsVirtualTime()) {
+            HpmTestAdvance(g_costNs);
+        }
+        struct MmioRegion *r = g_access.region;
+        uint32_t offset = (uint32_t)(g_access.word - r->base);
+        /* a write may be a read-modify-write, so it sees the current value too */
+        *(volatile uint32_t *)g_access.word = r->ops->read(r->ctx, offset);
+        if ((offset + 8U <= r->size) && (((g_access.word + 4U) & (MMIO_PAGE_SIZE - 1)) != 0)) {
+            /* the upper half of a 64 bit register read in one load */
+            *(volatile uint32_t *)(g_access.word + 4U) = r->ops->read(r->ctx, offset + 4U);
+        }
+    }
+    uc->uc_mcontext.gregs[REG_EFL] |= MMIO_EFLAGS_TF;
+}
+
+static void MmioStep(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    struct MmioRegion *r = g_access.region;
+    uintptr_t word = g_access.word;
+    (void)sig;
+    (void)info;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~MMIO_EFLAGS_TF;
+    if (word == 0) {
+        return;
+    }
+
+    g_access.word = 0;
+    if (r != NULL) {
+        uint32_t offset = (uint32_t)(word - r->base);
+        if (g_access.write) {
+            r->ops->write(r->ctx, offset, *(volatile uint32_t *)word);
+        } else if (r->ops->readDone != NULL) {
+            r->ops->readDone(r->ctx, offset);
+        }
+    }
+    MmioProtect(word & ~(MMIO_PAGE_SIZE - 1));
+}
+
+void HpmTestMmioInit(void)
+{
+    struct sigaction sa;
+
+    for (uint32_t i = 0; i < sizeof(g_windows) / sizeof(g_windows[0]); i++) {
+        void *p = mmap((void *)g_windows[i].base, g_windows[i].size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (p != (void *)g_windows[i].base) {
+            fprintf(stderr, "cannot map the register window at 0x%lx\n", (unsigned long)g_windows[i].base);
+            abort();
+        }
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = MmioFault;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = MmioStep;
+    sigaction(SIGTRAP, &sa, NULL);
+}
+
+void HpmTestMmioMap(uint32_t base, uint32_t size, const struct HpmTestMmioOps *ops, void *ctx)
+{
+    for (uint32_t i = 0; i < MMIO_REGION_MAX; i++) {
+        if (g_regions[i].ops == NULL) {
+            g_regions[i].base = base;
+            g_regions[i].size = size;
+            g_regions[i].ctx = ctx;
+            g_regions[i].ops = ops;
+            for (uintptr_t page = base & ~(MMIO_PAGE_SIZE - 1); page < (uintptr_t)base + size;
+                 page += MMIO_PAGE_SIZE) {
+                MmioProtect(page);
+            }
+            return;
+        }
+    }
+    fprintf(stderr, "too many register models\n");
+    abort();
+}
+
+void HpmTestMmioUnmap(uint32_t base)
+{
+    for (uint32_t i = 0; i < MMIO_REGION_MAX; i++) {
+        struct MmioRegion *r = &g_regions[i];
+        if ((r->ops != NULL) && (r->base == base)) {
+            r->ops = NULL;
+            for (uintptr_t page = base & ~(MMIO_PAGE_SIZE - 1); page < (uintptr_t)base + r->size;
+                 page += MMIO_PAGE_SIZE) {
+                MmioProtect(page);
+            }
+            return;
+        }
+    }
+}
+
+void HpmTestMmioCostNs(uint32_t ns)
+{
+    g_costNs = ns;
+}
+
+uint64_t HpmTestMmioAccesses(void)
+{
+    return g_accesses;
+}
+
+uint32_t HpmTestBusRead(uint32_t addr, uint32_t width)
+{
+    struct MmioRegion *r = MmioFind(addr);
+    uint32_t value;
+
+    if (r != NULL) {
+        uint32_t offset = (addr - r->base) & ~3U;
+        value = r->ops->read(r->ctx, offset) >> ((addr & 3U) * 8U);
+        if (r->ops->readDone != NULL) {
+            r->ops->readDone(r->ctx, offset);
+        }
+    } else if (width == 1) {
+        value = *(volatile uint8_t *)(uintptr_t)addr;
+    } else if (width == 2) {
+        value = *(volatile uint16_t *)(uintptr_t)addr;
+    } else {
+        value = *(volatile uint32_t *)(uintptr_t)addr;
+    }
+
+    if (width == 1) {
+        value &= 0xFFU;
+    } else if (width == 2) {
+        value &= 0xFFFFU;
+    }
+    return value;
+}
+
+void HpmTestBusWrite(uint32_t addr, uint32_t value, uint32_t width)
+{
+    struct MmioRegion *r = MmioFind(addr);
+
+    if ((r != NULL) && (r->ops->busWrite != NULL)) {
+        r->ops->busWrite(r->ctx, (addr - r->base) & ~3U, value << ((addr & 3U) * 8U), width);
+    } else if (r != NULL) {
+        r->ops->write(r->ctx, (addr - r->base) & ~3U, value << ((addr & 3U) * 8U));
+    } else if (width == 1) {
+        *(volatile uint8_t *)(uintptr_t)addr = (uint8_t)value;
+    } else if (width == 2) {
+        *(volatile uint16_t *)(uintptr_t)addr = (uint16_t)value;
+    } else {
+        *(volatile uint32_t *)(uintptr_t)addr = value;
+    }
+}
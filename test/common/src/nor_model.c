@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hpm_test_nor.h"
+
+static uint64_t NorNow(void)
+{
+    return HpmTestIsVirtualTime() ? HpmTestNowNs() : HpmTestHostNs();
+}
+
+void HpmTestNorInit(struct HpmTestNor *nor, uint32_t size, uint32_t sectorSize, uint32_t pageSize,
+                    uint64_t eraseNs, uint64_t pageNs)
+{
+    (void)memset(nor, 0, sizeof(*nor));
+    nor->mem = malloc(size);
+    nor->sectorErases = calloc(size / sectorSize, sizeof(uint32_t));
+    if ((nor->mem == NULL) || (nor->sectorErases == NULL)) {
+        abort();
+    }
+    (void)memset(nor->mem, 0xFF, size);
+    nor->size = size;
+    nor->sectorSize = sectorSize;
+    nor->pageSize = pageSize;
+    nor->eraseNs = eraseNs;
+    nor->pageNs = pageNs;
+}
+
+void HpmTestNorDeinit(struct HpmTestNor *nor)
+{
+    free(nor->mem);
+    free(nor->sectorErases);
+    nor->mem = NULL;
+    nor->sectorErases = NULL;
+}
+
+bool HpmTestNorBusy(struct HpmTestNor *nor)
+{
+    return NorNow() < nor->busyUntilNs;
+}
+
+void HpmTestNorWait(struct HpmTestNor *nor)
+{
+    uint64_t now = NorNow();
+
+    if (now >= nor->busyUntilNs) {
+        return;
+    }
+    if (HpmTestIsVirtualTime()) {
+        HpmTestRunUntil(nor->busyUntilNs);
+    } else {
+        struct timespec ts = {
+            .tv_sec = (time_t)((nor->busyUntilNs - now) / 1000000000ULL),
+            .tv_nsec = (long)((nor->busyUntilNs - now) % 1000000000ULL),
+        };
+        (void)nanosleep(&ts, NULL);
+    }
+}
+
+static bool NorUsable(struct HpmTestNor *nor, uint32_t addr, uint32_t len)
+{
+    return !nor->powerOff && (addr < nor->size) && (len <= nor->size - addr) && !HpmTestNorBusy(nor);
+}
+
+/* Counts an erase or program, true when power goes away in the middle of it */
+static bool NorCut(struct HpmTestNor *nor)
+{
+    if ((nor->cutAfter == 0) || (--nor->cutAfter != 0)) {
+        return false;
+    }
+    nor->powerOff = true;
+    return true;
+}
+
+static void NorBusy(struct HpmTestNor *nor, uint64_t ns)
+{
+    nor->busyUntilNs = NorNow() + ns;
+    nor->busyNs += ns;
+}
+
+int32_t HpmTestNorRead(struct HpmTestNor *nor, uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    if (!NorUsable(nor, addr, len)) {
+        return -1;
+    }
+    nor->reads++;
+    (void)memcpy(buf, &nor->mem[addr], len);
+    return 0;
+}
+
+int32_t HpmTestNorErase(struct HpmTestNor *nor, uint32_t addr)
+{
+    uint32_t len = nor->sectorSize;
+
+    if (!NorUsable(nor, addr, len) || ((addr % nor->sectorSize) != 0)) {
+        return -1;
+    }
+    if (NorCut(nor)) {
+        /* a torn erase leaves the start erased and the rest as it was */
+        len /= 2;
+    }
+    nor->erases++;
+    nor->sectorErases[addr / nor->sectorSize]++;
+    (void)memset(&nor->mem[addr], 0xFF, len);
+    NorBusy(nor, nor->eraseNs);
+    return 0;
+}
+
+int32_t HpmTestNorProgram(struct HpmTestNor *nor, uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    if (!NorUsable(nor, addr, len) || ((addr % nor->pageSize) + len > nor->pageSize)) {
+        return -1;
+    }
+    if (NorCut(nor)) {
+        len = (nor->cutKeep == UINT32_MAX) ? (len / 2) : ((nor->cutKeep < len) ? nor->cutKeep : len);
+    }
+    nor->programs++;
+    for (uint32_t i = 0; i < len; i++) {
+        nor->mem[addr + i] &= buf[i];
+    }
+    NorBusy(nor, nor->pageNs);
+    return 0;
+}
+
+void HpmTestNorCutAfter(struct HpmTestNor *nor, uint32_t ops)
+{
+    nor->cutAfter = ops;
+    nor->cutKeep = UINT32_MAX;
+}
+
+void HpmTestNorCutAfterKeep(struct HpmTestNor *nor, uint32_t ops, uint32_t keep)
+{
+    nor->cutAfter = ops;
+    nor->cutKeep = keep;
+}
+
+void HpmTestNorPowerOn(struct HpmTestNor *nor)
+{
+    nor->powerOff = false;
+    nor->cutAfter = 0;
+    nor->busyUntilNs = 0;
+}
+
+void HpmTestNorStatsReset(struct HpmTestNor *nor)
+{
+    nor->reads = 0;
+    nor->erases = 0;
+    nor->programs = 0;
+    nor->busyNs = 0;
+    (void)memset(nor->sectorErases, 0, (nor->size / nor->sectorSize) * sizeof(uint32_t));
+}
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "los_memory.h"
+#include "osal_mem.h"
+#include "osal_mutex.h"
+#include "osal_sem.h"
+#include "osal_time.h"
+#include "hpm_test.h"
+
+#define NS_PER_MS 1000000ULL
+#define NS_PER_US 1000ULL
+
+struct HostSem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t count;
+};
+
+struct HostMemHead {
+    void *raw;
+    size_t size;
+};
+
+static uint32_t g_memInUse;
+
+int32_t OsalSemInit(struct OsalSem *sem, uint32_t value)
+{
+    struct HostSem *s = calloc(1, sizeof(*s));
+
+    if ((sem == NULL) || (s == NULL)) {
+        free(s);
+        return HDF_ERR_INVALID_PARAM;
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->count = value;
+    sem->realSem = s;
+    return HDF_SUCCESS;
+}
+
+static bool HostSemReady(void *arg)
+{
+    return ((struct HostSem *)arg)->count != 0;
+}
+
+int32_t OsalSemWait(struct OsalSem *sem, uint32_t ms)
+{
+    struct HostSem *s = (sem != NULL) ? sem->realSem : NULL;
+    int32_t ret = HDF_SUCCESS;
+
+    if (s == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+
+    if (HpmTestIsVirtualTime()) {
+        uint64_t until = (ms == OSAL_WAIT_FOREVER) ? UINT64_MAX : HpmTestNowNs() + ms * NS_PER_MS;
+        if (!HpmTestRunUntilDone(until, HostSemReady, s)) {
+            return HDF_ERR_TIMEOUT;
+        }
+        s->count--;
+        return HDF_SUCCESS;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    if (ms == OSAL_WAIT_FOREVER) {
+        while (s->count == 0) {
+            pthread_cond_wait(&s->cond, &s->lock);
+        }
+    } else {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += ms / 1000;
+        ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        while ((s->count == 0) && (ret == HDF_SUCCESS)) {
+            if (pthread_cond_timedwait(&s->cond, &s->lock, &ts) == ETIMEDOUT) {
+                ret = HDF_ERR_TIMEOUT;
+            }
+        }
+    }
+    if (s->count != 0) {
+        s->count--;
+        ret = HDF_SUCCESS;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return ret;
+}
+
+int32_t OsalSemPost(struct OsalSem *sem)
+{
+    struct HostSem *s = (sem != NULL) ? sem->realSem : NULL;
+
+    if (s == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&s->lock);
+    s->count++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return HDF_SUCCESS;
+}
+
+int32_t OsalSemDestroy(struct OsalSem *sem)
+{
+    struct HostSem *s = (sem != NULL) ? sem->realSem : NULL;
+
+    if (s == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s);
+    sem->realSem = NULL;
+    return HDF_SUCCESS;
+}
+
+/* LOS mutexes are recursive */
+int32_t OsalMutexInit(struct OsalMutex *mutex)
+{
+    pthread_mutex_t *m = malloc(sizeof(*m));
+    pthread_mutexattr_t attr;
+
+    if ((mutex == NULL) || (m == NULL)) {
+        free(m);
+        return HDF_ERR_INVALID_PARAM;
+    }
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(m, &attr);
+    pthread_mutexattr_destroy(&attr);
+    mutex->realMutex = m;
+    return HDF_SUCCESS;
+}
+
+int32_t OsalMutexDestroy(struct OsalMutex *mutex)
+{
+    if ((mutex == NULL) || (mutex->realMutex == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    pthread_mutex_destroy(mutex->realMutex);
+    free(mutex->realMutex);
+    mutex->realMutex = NULL;
+    return HDF_SUCCESS;
+}
+
+int32_t OsalMutexLock(struct OsalMutex *mutex)
+{
+    if ((mutex == NULL) || (mutex->realMutex == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(mutex->realMutex);
+    return HDF_SUCCESS;
+}
+
+int32_t OsalMutexTimedLock(struct OsalMutex *mutex, uint32_t ms)
+{
+    (void)ms;
+    return OsalMutexLock(mutex);
+}
+
+int32_t OsalMutexUnlock(struct OsalMutex *mutex)
+{
+    if ((mutex == NULL) || (mutex->realMutex == NULL)) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    pthread_mutex_unlock(mutex->realMutex);
+    return HDF_SUCCESS;
+}
+
+void *OsalMemAllocAlign(size_t alignment, size_t size)
+{
+    size_t align = (alignment < sizeof(struct HostMemHead)) ? sizeof(struct HostMemHead) : alignment;
+    uint8_t *raw = malloc(size + align + sizeof(struct HostMemHead));
+    uintptr_t p;
+    struct HostMemHead *head;
+
+    if ((raw == NULL) || (size == 0)) {
+        free(raw);
+        return NULL;
+    }
+    p = ((uintptr_t)raw + sizeof(struct HostMemHead) + align - 1) & ~(uintptr_t)(align - 1);
+    head = (struct HostMemHead *)p - 1;
+    head->raw = raw;
+    head->size = size;
+    g_memInUse += size;
+    return (void *)p;
+}
+
+void *OsalMemAlloc(size_t size)
+{
+    return OsalMemAllocAlign(sizeof(struct HostMemHead), size);
+}
+
+void *OsalMemCalloc(size_t size)
+{
+    void *p = OsalMemAlloc(size);
+
+    if (p != NULL) {
+        memset(p, 0, size);
+    }
+    return p;
+}
+
+void OsalMemFree(void *mem)
+{
+    struct HostMemHead *head;
+
+    if (mem == NULL) {
+        return;
+    }
+    head = (struct HostMemHead *)mem - 1;
+    g_memInUse -= head->size;
+    free(head->raw);
+}
+
+/* The LiteOS-M system heap shares the accounting, there is a single pool */
+VOID *LOS_MemAlloc(VOID *pool, UINT32 size)
+{
+    (void)pool;
+    return OsalMemAlloc(size);
+}
+
+UINT32 LOS_MemFree(VOID *pool, VOID *ptr)
+{
+    (void)pool;
+    if (ptr == NULL) {
+        return LOS_NOK;
+    }
+    OsalMemFree(ptr);
+    return LOS_OK;
+}
+
+uint32_t HpmTestMemInUse(void)
+{
+    return g_memInUse;
+}
+
+uint64_t OsalGetSysTimeMs(void)
+{
+    return HpmTestNowNs() / NS_PER_MS;
+}
+
+int32_t OsalGetTime(OsalTimespec *time)
+{
+    uint64_t ns = HpmTestNowNs();
+
+    if (time == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    time->sec = ns / 1000000000ULL;
+    time->usec = (ns % 1000000000ULL) / NS_PER_US;
+    return HDF_SUCCESS;
+}
+
+static void HostSleepNs(uint64_t ns)
+{
+    if (HpmTestIsVirtualTime()) {
+        HpmTestRunUntil(HpmTestNowNs() + ns);
+    } else {
+        struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+void OsalSleep(uint32_t sec)
+{
+    HostSleepNs(sec * 1000ULL * NS_PER_MS);
+}
+
+void OsalMSleep(uint32_t ms)
+{
+    HostSleepNs(ms * NS_PER_MS);
+}
+
+void OsalUSleep(uint32_t us)
+{
+    HostSleepNs(us * NS_PER_US);
+}
+
+void OsalUDelay(uint32_t us)
+{
+    HostSleepNs(us * NS_PER_US);
+}
+
+void OsalMDelay(uint32_t ms)
+{
+    HostSleepNs(ms * NS_PER_MS);
+}
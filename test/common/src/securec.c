@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "securec.h"
+
+errno_t memcpy_s(void *dest, size_t destMax, const void *src, size_t count)
+{
+    if ((dest == NULL) || (src == NULL)) {
+        return EINVAL;
+    }
+    if (count > destMax) {
+        memset(dest, 0, destMax);
+        return ERANGE;
+    }
+    memcpy(dest, src, count);
+    return EOK;
+}
+
+errno_t memmove_s(void *dest, size_t destMax, const void *src, size_t count)
+{
+    if ((dest == NULL) || (src == NULL)) {
+        return EINVAL;
+    }
+    if (count > destMax) {
+        memset(dest, 0, destMax);
+        return ERANGE;
+    }
+    memmove(dest, src, count);
+    return EOK;
+}
+
+errno_t memset_s(void *dest, size_t destMax, int c, size_t count)
+{
+    if (dest == NULL) {
+        return EINVAL;
+    }
+    if (count > destMax) {
+        memset(dest, c, destMax);
+        return ERANGE_AND_RESET;
+    }
+    memset(dest, c, count);
+    return EOK;
+}
+
+errno_t strncpy_s(char *strDest, size_t destMax, const char *strSrc, size_t count)
+{
+    size_t len;
+
+    if ((strDest == NULL) || (strSrc == NULL) || (destMax == 0)) {
+        return EINVAL;
+    }
+    len = strnlen(strSrc, count);
+    if (len >= destMax) {
+        strDest[0] = '\0';
+        return ERANGE;
+    }
+    memcpy(strDest, strSrc, len);
+    strDest[len] = '\0';
+    return EOK;
+}
+
+errno_t strcpy_s(char *strDest, size_t destMax, const char *strSrc)
+{
+    return strncpy_s(strDest, destMax, strSrc, (strSrc != NULL) ? strlen(strSrc) : 0);
+}
+
+errno_t strcat_s(char *strDest, size_t destMax, const char *strSrc)
+{
+    size_t len;
+
+    if ((strDest == NULL) || (strSrc == NULL)) {
+        return EINVAL;
+    }
+    len = strnlen(strDest, destMax);
+    if (len == destMax) {
+        return EINVAL;
+    }
+    return strcpy_s(strDest + len, destMax - len, strSrc);
+}
+
+int vsnprintf_s(char *strDest, size_t destMax, size_t count, const char *format, va_list argList)
+{
+    int ret;
+    size_t max = (count < destMax) ? count + 1 : destMax;
+
+    if ((strDest == NULL) || (destMax == 0) || (format == NULL)) {
+        return -1;
+    }
+    ret = vsnprintf(strDest, max, format, argList);
+    return ((ret < 0) || ((size_t)ret >= max)) ? -1 : ret;
+}
+
+int snprintf_s(char *strDest, size_t destMax, size_t count, const char *format, ...)
+{
+    va_list ap;
+    int ret;
+
+    va_start(ap, format);
+    ret = vsnprintf_s(strDest, destMax, count, format, ap);
+    va_end(ap);
+    return ret;
+}
+
+int sprintf_s(char *strDest, size_t destMax, const char *format, ...)
+{
+    va_list ap;
+    int ret;
+
+    va_start(ap, format);
+    ret = vsnprintf_s(strDest, destMax, destMax - 1, format, ap);
+    va_end(ap);
+    return ret;
+}
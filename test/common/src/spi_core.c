@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include "spi_core.h"
+
+struct SpiCntlr *SpiCntlrCreate(struct HdfDeviceObject *device)
+{
+    struct SpiCntlr *cntlr;
+
+    if (device == NULL) {
+        return NULL;
+    }
+    cntlr = calloc(1, sizeof(*cntlr));
+    if (cntlr == NULL) {
+        return NULL;
+    }
+    cntlr->device = device;
+    device->service = &cntlr->service;
+    return cntlr;
+}
+
+void SpiCntlrDestroy(struct SpiCntlr *cntlr)
+{
+    if (cntlr == NULL) {
+        return;
+    }
+    if (cntlr->device != NULL) {
+        cntlr->device->service = NULL;
+    }
+    free(cntlr);
+}
@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include "hpm_soc.h"
+#include "hpm_spi_drv.h"
+#include "soc.h"
+#include "hpm_test_dma.h"
+#include "hpm_test_spi.h"
+
+#define SPI_REG_TRANSFMT 0x10U
+#define SPI_REG_DIRECTIO 0x14U
+#define SPI_REG_TRANSCTRL 0x20U
+#define SPI_REG_CMD 0x24U
+#define SPI_REG_ADDR 0x28U
+#define SPI_REG_DATA 0x2CU
+#define SPI_REG_CTRL 0x30U
+#define SPI_REG_STATUS 0x34U
+#define SPI_REG_INTREN 0x38U
+#define SPI_REG_INTRST 0x3CU
+#define SPI_REG_TIMING 0x40U
+#define SPI_REG_CONFIG 0x7CU
+#define SPI_REG_SIZE 0x80U
+/* 4 entry fifos */
+#define SPI_CONFIG_FIFO_4 1U
+
+uint32_t HpmTestSpiSclkHz(const struct HpmTestSpi *s)
+{
+    uint32_t div = SPI_TIMING_SCLK_DIV_GET(s->timing);
+
+    return (div == 0xFFU) ? s->clkHz : s->clkHz / ((div + 1U) * 2U);
+}
+
+static uint32_t SpiModelUnitBits(const struct HpmTestSpi *s)
+{
+    return SPI_TRANSFMT_DATALEN_GET(s->transfmt) + 1U;
+}
+
+static uint32_t SpiModelUnitMask(const struct HpmTestSpi *s)
+{
+    uint32_t bits = SpiModelUnitBits(s);
+
+    return (bits >= 32U) ? 0xFFFFFFFFU : ((1U << bits) - 1U);
+}
+
+/* clocks of one data unit on the data lanes */
+static uint32_t SpiModelDataClocks(const struct HpmTestSpi *s)
+{
+    uint32_t fmt = SPI_TRANSCTRL_DUALQUAD_GET(s->transctrl);
+    uint32_t lanes = (fmt == spi_quad_io_mode) ? 4U : ((fmt == spi_dual_io_mode) ? 2U : 1U);
+
+    return (SpiModelUnitBits(s) + lanes - 1U) / lanes;
+}
+
+static bool SpiModelMerge(const struct HpmTestSpi *s)
+{
+    return (s->transfmt & SPI_TRANSFMT_DATAMERGE_MASK) != 0;
+}
+
+static bool SpiModelCsLow(const struct HpmTestSpi *s)
+{
+    if ((s->directio & SPI_DIRECTIO_DIRECTIOEN_MASK) && (s->directio & SPI_DIRECTIO_CS_OE_MASK)) {
+        return (s->directio & SPI_DIRECTIO_CS_O_MASK) == 0;
+    }
+    return s->active;
+}
+
+static void SpiModelCsChanged(struct HpmTestSpi *s, bool wasLow)
+{
+    bool low = SpiModelCsLow(s);
+
+    if (low && !wasLow) {
+        s->csAsserts++;
+    }
+    if ((low != wasLow) && (s->cs != NULL)) {
+        s->cs(s->exchangeCtx, low);
+    }
+}
+
+static void SpiModelEnd(struct HpmTestSpi *s)
+{
+    bool wasLow = SpiModelCsLow(s);
+
+    s->active = false;
+    s->intrst |= SPI_INTRST_ENDINT_MASK;
+    s->busyNs += HpmTestNowNs() - s->activeSinceNs;
+    SpiModelCsChanged(s, wasLow);
+}
+
+static void SpiModelUnitStart(struct HpmTestSpi *s, uint32_t clocks)
+{
+    s->unitBusy = true;
+    s->unitDoneNs = HpmTestNowNs() + ((uint64_t)clocks * 1000000000ULL + HpmTestSpiSclkHz(s) - 1U) /
+                    HpmTestSpiSclkHz(s);
+}
+
+static void SpiModelPre(struct HpmTestSpi *s, uint8_t unit, uint32_t clocks, bool valid)
+{
+    uint32_t i = s->preHead + s->preCount;
+
+    if (i < sizeof(s->preUnit)) {
+        s->preUnit[i] = unit;
+        s->preClocks[i] = (uint8_t)clocks;
+        s->preValid[i] = valid;
+        s->preCount++;
+    }
+}
+
+/* Start the next data unit once the fifos allow it */
+static void SpiModelKick(struct HpmTestSpi *s)
+{
+    uint32_t mode = SPI_TRANSCTRL_TRANSMODE_GET(s->transctrl);
+    bool write;
+    bool read;
+
+    if (!s->active || s->unitBusy || s->stalled) {
+        return;
+    }
+    if (s->preCount != 0) {
+        s->unitMosi = s->preUnit[s->preHead];
+        s->unitMosiValid = s->preValid[s->preHead];
+        s->unitRead = false;
+        SpiModelUnitStart(s, s->preClocks[s->preHead]);
+        s->preHead++;
+        s->preCount--;
+        return;
+    }
+
+    if (mode == spi_trans_write_read_together) {
+        write = read = (s->wrLeft != 0);
+    } else if ((mode == spi_trans_write_only) || (mode == spi_trans_dummy_write)) {
+        write = (s->wrLeft != 0);
+        read = false;
+    } else if ((mode == spi_trans_read_only) || (mode == spi_trans_dummy_read)) {
+        write = false;
+        read = (s->rdLeft != 0);
+    } else {
+        /* other phase orders are not used by the drivers under test */
+        write = (s->wrLeft != 0);
+        read = !write && (s->rdLeft != 0);
+    }
+
+    if (!write && !read) {
+        SpiModelEnd(s);
+        return;
+    }
+    if ((write && (s->txCount == 0)) || (read && (s->rxCount == HPM_TEST_SPI_FIFO))) {
+        /* sclk pauses for the fifos */
+        return;
+    }
+
+    s->unitMosiValid = write;
+    s->unitMosi = 0xFFFFFFFFU;
+    if (write) {
+        s->unitMosi = s->txFifo[s->txHead];
+        s->wrLeft--;
+        if (SpiModelMerge(s)) {
+            s->unitMosi = (s->unitMosi >> (s->txSub * 8U)) & 0xFFU;
+            s->txSub++;
+        }
+        if (!SpiModelMerge(s) || (s->txSub == 4U) || (s->wrLeft == 0)) {
+            s->txHead = (s->txHead + 1U) % HPM_TEST_SPI_FIFO;
+            s->txCount--;
+            s->txSub = 0;
+        }
+    }
+    s->unitRead = read;
+    if (read && (mode != spi_trans_write_read_together)) {
+        s->rdLeft--;
+    }
+    SpiModelUnitStart(s, SpiModelDataClocks(s));
+}
+
+static void SpiModelStart(struct HpmTestSpi *s, uint32_t cmd)
+{
+    uint32_t mode = SPI_TRANSCTRL_TRANSMODE_GET(s->transctrl);
+    uint32_t addrClocks = SPI_TRANSCTRL_ADDRFMT_GET(s->transctrl) ? SpiModelDataClocks(s) : 8U;
+    bool wasLow = SpiModelCsLow(s);
+    uint32_t i;
+
+    s->wrLeft = SPI_TRANSCTRL_WRTRANCNT_GET(s->transctrl) + 1U;
+    s->rdLeft = SPI_TRANSCTRL_RDTRANCNT_GET(s->transctrl) + 1U;
+    if ((mode == spi_trans_read_only) || (mode == spi_trans_dummy_read)) {
+        s->wrLeft = 0;
+    } else if ((mode == spi_trans_write_only) || (mode == spi_trans_dummy_write)) {
+        s->rdLeft = 0;
+    } else if (mode == spi_trans_no_data) {
+        s->wrLeft = 0;
+        s->rdLeft = 0;
+    }
+    s->txSub = 0;
+    s->rxSub = 0;
+    s->rxWord = 0;
+    s->preHead = 0;
+    s->preCount = 0;
+    if (s->transctrl & SPI_TRANSCTRL_CMDEN_MASK) {
+        SpiModelPre(s, (uint8_t)cmd, 8U, true);
+    }
+    if (s->transctrl & SPI_TRANSCTRL_ADDREN_MASK) {
+        for (i = SPI_TRANSFMT_ADDRLEN_GET(s->transfmt) + 1U; i > 0; i--) {
+            SpiModelPre(s, (uint8_t)(s->addr >> ((i - 1U) * 8U)), addrClocks, true);
+        }
+    }
+    if ((mode == spi_trans_dummy_read) || (mode == spi_trans_dummy_write)) {
+        for (i = 0; i <= SPI_TRANSCTRL_DUMMYCNT_GET(s->transctrl); i++) {
+            SpiModelPre(s, 0xFFU, SpiModelDataClocks(s), false);
+        }
+    }
+    s->active = true;
+    s->activeSinceNs = HpmTestNowNs();
+    s->transactions++;
+    SpiModelCsChanged(s, wasLow);
+    SpiModelKick(s);
+}
+
+static bool SpiModelIrqPending(void *ctx)
+{
+    const struct HpmTestSpi *s = (const struct HpmTestSpi *)ctx;
+
+    return (s->intrst & s->intren) != 0;
+}
+
+static bool SpiModelDmaRxRequest(void *ctx)
+{
+    const struct HpmTestSpi *s = (const struct HpmTestSpi *)ctx;
+
+    if (s->rxDmaStuck && !s->active) {
+        return false;
+    }
+    return (s->ctrl & SPI_CTRL_RXDMAEN_MASK) && (s->rxCount > SPI_CTRL_RXTHRES_GET(s->ctrl)) &&
+           (s->rxCount != 0);
+}
+
+static bool SpiModelDmaTxRequest(void *ctx)
+{
+    const struct HpmTestSpi *s = (const struct HpmTestSpi *)ctx;
+
+    return (s->ctrl & SPI_CTRL_TXDMAEN_MASK) && (s->txCount <= SPI_CTRL_TXTHRES_GET(s->ctrl)) &&
+           (s->txCount < HPM_TEST_SPI_FIFO);
+}
+
+static uint32_t SpiModelStatus(const struct HpmTestSpi *s)
+{
+    uint32_t status = 0;
+
+    status |= s->active ? SPI_STATUS_SPIACTIVE_MASK : 0;
+    status |= ((s->rxCount << SPI_STATUS_RXNUM_5_0_SHIFT) & SPI_STATUS_RXNUM_5_0_MASK);
+    status |= (s->rxCount == 0) ? SPI_STATUS_RXEMPTY_MASK : 0;
+    status |= (s->rxCount == HPM_TEST_SPI_FIFO) ? SPI_STATUS_RXFULL_MASK : 0;
+    status |= ((s->txCount << SPI_STATUS_TXNUM_5_0_SHIFT) & SPI_STATUS_TXNUM_5_0_MASK);
+    status |= (s->txCount == 0) ? SPI_STATUS_TXEMPTY_MASK : 0;
+    status |= (s->txCount == HPM_TEST_SPI_FIFO) ? SPI_STATUS_TXFULL_MASK : 0;
+    return status;
+}
+
+static uint32_t SpiModelRead(void *ctx, uint32_t offset)
+{
+    const struct HpmTestSpi *s = (const struct HpmTestSpi *)ctx;
+
+    switch (offset) {
+    case SPI_REG_TRANSFMT:
+        return s->transfmt;
+    case SPI_REG_DIRECTIO:
+        return s->directio;
+    case SPI_REG_TRANSCTRL:
+        return s->transctrl;
+    case SPI_REG_ADDR:
+        return s->addr;
+    case SPI_REG_DATA:
+        return (s->rxCount != 0) ? s->rxFifo[s->rxHead] : 0;
+    case SPI_REG_CTRL:
+        return s->ctrl;
+    case SPI_REG_STATUS:
+        return SpiModelStatus(s);
+    case SPI_REG_INTREN:
+        return s->intren;
+    case SPI_REG_INTRST:
+        return s->intrst;
+    case SPI_REG_TIMING:
+        return s->timing;
+    case SPI_REG_CONFIG:
+        return (SPI_CONFIG_FIFO_4 << SPI_CONFIG_TXFIFOSIZE_SHIFT) | (SPI_CONFIG_FIFO_4 << SPI_CONFIG_RXFIFOSIZE_SHIFT);
+    default:
+        return 0;
+    }
+}
+
+static void SpiModelReadDone(void *ctx, uint32_t offset)
+{
+    struct HpmTestSpi *s = (struct HpmTestSpi *)ctx;
+
+    if ((offset == SPI_REG_DATA) && (s->rxCount != 0)) {
+        s->rxHead = (s->rxHead + 1U) % HPM_TEST_SPI_FIFO;
+        s->rxCount--;
+        SpiModelKick(s);
+    }
+}
+
+static void SpiModelWrite(void *ctx, uint32_t offset, uint32_t value)
+{
+    struct HpmTestSpi *s = (struct HpmTestSpi *)ctx;
+
+    switch (offset) {
+    case SPI_REG_TRANSFMT:
+        s->transfmt = value;
+        break;
+    case SPI_REG_DIRECTIO: {
+        bool wasLow = SpiModelCsLow(s);
+        s->directio = value;
+        SpiModelCsChanged(s, wasLow);
+        break;
+    }
+    case SPI_REG_TRANSCTRL:
+        s->transctrl = value;
+        break;
+    case SPI_REG_ADDR:
+        s->addr = value;
+        break;
+    case SPI_REG_CMD:
+        SpiModelStart(s, value);
+        break;
+    case SPI_REG_DATA:
+        if (s->txCount < HPM_TEST_SPI_FIFO) {
+            s->txFifo[(s->txHead + s->txCount) % HPM_TEST_SPI_FIFO] = value;
+            s->txCount++;
+            SpiModelKick(s);
+        }
+        break;
+    case SPI_REG_CTRL:
+        if (value & SPI_CTRL_TXFIFORST_MASK) {
+            s->txCount = 0;
+        }
+        if (value & SPI_CTRL_RXFIFORST_MASK) {
+            s->rxCount = 0;
+        }
+        if ((value & SPI_CTRL_SPIRST_MASK) && s->active) {
+            bool wasLow = SpiModelCsLow(s);
+            s->active = false;
+            s->unitBusy = false;
+            SpiModelCsChanged(s, wasLow);
+        }
+        s->ctrl = value & ~(SPI_CTRL_TXFIFORST_MASK | SPI_CTRL_RXFIFORST_MASK | SPI_CTRL_SPIRST_MASK);
+        break;
+    case SPI_REG_INTREN:
+        s->intren = value;
+        break;
+    case SPI_REG_INTRST:
+        s->intrst &= ~value;
+        break;
+    case SPI_REG_TIMING:
+        s->timing = value;
+        break;
+    default:
+        break;
+    }
+}
+
+static const struct HpmTestMmioOps g_spiOps = {
+    .read = SpiModelRead,
+    .readDone = SpiModelReadDone,
+    .write = SpiModelWrite,
+};
+
+static uint64_t SpiModelNext(void *ctx)
+{
+    const struct HpmTestSpi *s = (const struct HpmTestSpi *)ctx;
+
+    return (s->unitBusy && !s->stalled) ? s->unitDoneNs : UINT64_MAX;
+}
+
+static void SpiModelRun(void *ctx)
+{
+    struct HpmTestSpi *s = (struct HpmTestSpi *)ctx;
+    uint32_t mask = SpiModelUnitMask(s);
+    uint32_t miso = 0xFFFFFFFFU;
+
+    if (!s->unitBusy || (s->unitDoneNs > HpmTestNowNs())) {
+        return;
+    }
+    if (s->exchange != NULL) {
+        miso = s->exchange(s->exchangeCtx, s->unitMosi & mask, s->unitMosiValid);
+    }
+    if (s->unitRead && SpiModelMerge(s)) {
+        s->rxWord |= (miso & 0xFFU) << (s->rxSub * 8U);
+        s->rxSub++;
+        if ((s->rxSub == 4U) || (s->rdLeft == 0)) {
+            s->rxFifo[(s->rxHead + s->rxCount) % HPM_TEST_SPI_FIFO] = s->rxWord;
+            s->rxCount++;
+            s->rxSub = 0;
+            s->rxWord = 0;
+        }
+    } else if (s->unitRead) {
+        s->rxFifo[(s->rxHead + s->rxCount) % HPM_TEST_SPI_FIFO] = miso & mask;
+        s->rxCount++;
+    }
+    s->units++;
+    s->unitBusy = false;
+    SpiModelKick(s);
+}
+
+void HpmTestSpiInit(struct HpmTestSpi *s, uint32_t base, uint32_t plicIrq, uint32_t clkHz, uint8_t dmaRx,
+                    uint8_t dmaTx)
+{
+    memset(s, 0, sizeof(*s));
+    s->base = base;
+    s->losIrq = HPM2LITEOS_IRQ(plicIrq);
+    s->clkHz = clkHz;
+    s->dmaRx = dmaRx;
+    s->dmaTx = dmaTx;
+    s->timing = SPI_TIMING_SCLK_DIV_SET(0x3U);
+    s->transfmt = SPI_TRANSFMT_DATALEN_SET(7U);
+    s->model.name = "spi";
+    s->model.next = SpiModelNext;
+    s->model.run = SpiModelRun;
+    s->model.ctx = s;
+    HpmTestModelAdd(&s->model);
+    HpmTestMmioMap(base, SPI_REG_SIZE, &g_spiOps, s);
+    HpmTestIrqSource(s->losIrq, SpiModelIrqPending, s);
+    HpmTestDmaRequest(dmaRx, SpiModelDmaRxRequest, s);
+    HpmTestDmaRequest(dmaTx, SpiModelDmaTxRequest, s);
+}
+
+void HpmTestSpiDeinit(struct HpmTestSpi *s)
+{
+    HpmTestModelRemove(&s->model);
+    HpmTestMmioUnmap(s->base);
+    HpmTestIrqSource(s->losIrq, NULL, NULL);
+    HpmTestDmaRequest(s->dmaRx, NULL, NULL);
+    HpmTestDmaRequest(s->dmaTx, NULL, NULL);
+}
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "hpm_test_spi_nor.h"
+
+#define SPI_NOR_SR1_WIP 0x01U
+#define SPI_NOR_SR1_WEL 0x02U
+#define SPI_NOR_SR2_SUS 0x80U
+#define SPI_NOR_SFDP_SIZE 256U
+
+/*
+ * SFDP: header, one parameter header and a 16 word JESD216B basic table at
+ * 0x80. 128 Mbit, 4K/32K/64K erase, 256 byte pages, 1-1-2 0x3B, 1-2-2 0xBB,
+ * 1-1-4 0x6B (8 dummy clocks), 1-4-4 0xEB (2 mode + 4 dummy clocks), no QE
+ * bit, suspend 0x75 and resume 0x7A.
+ */
+static const uint32_t g_sfdpWords[] = {
+    [0x00 / 4] = 0x50444653U, 0xFF000106U,
+    [0x08 / 4] = 0x10010600U, 0xFF000080U,
+    [0x80 / 4] = 0xFFF120E5U, 0x07FFFFFFU, 0x6B08EB44U, 0xBB423B08U,
+    0xFFFFFFEEU, 0xFF00FFFFU, 0xFF00FFFFU, 0x520F200CU,
+    0x0000D810U, 0x00000000U, 0x00000080U, 0x00000000U,
+    0x757A7A75U, 0x00000000U, 0x00000000U, 0x00000000U,
+};
+
+static uint8_t SpiNorSfdp(uint32_t addr)
+{
+    if (addr >= sizeof(g_sfdpWords)) {
+        return 0xFFU;
+    }
+    return (uint8_t)(g_sfdpWords[addr / 4U] >> ((addr % 4U) * 8U));
+}
+
+static bool SpiNorIsRead(uint8_t op)
+{
+    return (op == 0x03U) || (op == 0x0BU) || (op == 0x3BU) || (op == 0x6BU) || (op == 0xBBU) || (op == 0xEBU);
+}
+
+static bool SpiNorIsProgram(uint8_t op)
+{
+    return (op == 0x02U) || (op == 0x32U);
+}
+
+static bool SpiNorIsErase(uint8_t op)
+{
+    return (op == 0x20U) || (op == 0x52U) || (op == 0xD8U) || (op == 0xC7U) || (op == 0x60U);
+}
+
+static bool SpiNorKnown(uint8_t op)
+{
+    return SpiNorIsRead(op) || SpiNorIsProgram(op) || SpiNorIsErase(op) || (op == 0x5AU) || (op == 0x9FU) ||
+           (op == 0x05U) || (op == 0x35U) || (op == 0x06U) || (op == 0x04U) || (op == 0x75U) || (op == 0x7AU);
+}
+
+static bool SpiNorWorking(const struct HpmTestSpiNor *nor)
+{
+    return (nor->state == HPM_TEST_SPI_NOR_PROGRAM) || (nor->state == HPM_TEST_SPI_NOR_ERASE) ||
+           (nor->state == HPM_TEST_SPI_NOR_SUSPENDING);
+}
+
+/* dummy units the controller sends in the data phase format, see the SFDP clocks */
+static uint32_t SpiNorDummyUnits(uint8_t op)
+{
+    switch (op) {
+    case 0x0BU:
+    case 0x5AU:
+    case 0xBBU:
+        return 1U;
+    case 0x3BU:
+        return 2U;
+    case 0xEBU:
+        return 3U;
+    case 0x6BU:
+        return 4U;
+    default:
+        return 0U;
+    }
+}
+
+static void SpiNorCommand(struct HpmTestSpiNor *nor, uint8_t op)
+{
+    nor->op = op;
+    nor->addr = 0;
+    nor->addrUnits = (SpiNorIsRead(op) || SpiNorIsProgram(op) || (op == 0x5AU) ||
+                      (SpiNorIsErase(op) && (op != 0xC7U) && (op != 0x60U))) ? 3U : 0U;
+    nor->dummyUnits = SpiNorDummyUnits(op);
+    nor->ignore = false;
+    nor->commands++;
+    if (SpiNorIsProgram(op)) {
+        (void)memset(nor->page, 0xFF, sizeof(nor->page));
+        nor->pageLen = 0;
+    }
+
+    if (!SpiNorKnown(op)) {
+        nor->ignore = true;
+    } else if (SpiNorWorking(nor)) {
+        nor->ignore = (op != 0x05U) && (op != 0x35U) && (op != 0x75U);
+    } else if (nor->state == HPM_TEST_SPI_NOR_SUSPENDED) {
+        nor->ignore = SpiNorIsProgram(op) || SpiNorIsErase(op);
+    }
+    if (nor->ignore) {
+        nor->protocolErrors++;
+    }
+}
+
+static uint32_t SpiNorData(struct HpmTestSpiNor *nor, uint32_t mosi, bool mosiValid)
+{
+    uint32_t addr = nor->addr % nor->size;
+    uint8_t status = 0;
+
+    if (SpiNorIsRead(nor->op)) {
+        if ((nor->state == HPM_TEST_SPI_NOR_SUSPENDED) && (addr >= nor->opAddr) &&
+            (addr < nor->opAddr + nor->opLen)) {
+            nor->badReads++;
+        }
+        nor->addr++;
+        nor->readBytes++;
+        return nor->mem[addr];
+    }
+    switch (nor->op) {
+    case 0x5AU:
+        return SpiNorSfdp(nor->addr++);
+    case 0x9FU:
+        return (nor->units == 2U) ? 0xEFU : ((nor->units == 3U) ? 0x40U : 0x18U);
+    case 0x05U:
+        status |= SpiNorWorking(nor) ? SPI_NOR_SR1_WIP : 0U;
+        status |= nor->wel ? SPI_NOR_SR1_WEL : 0U;
+        return status;
+    case 0x35U:
+        return (nor->state == HPM_TEST_SPI_NOR_SUSPENDED) ? SPI_NOR_SR2_SUS : 0U;
+    case 0x02U:
+    case 0x32U:
+        if (mosiValid) {
+            nor->page[(nor->addr + nor->pageLen) % HPM_TEST_SPI_NOR_PAGE] = (uint8_t)mosi;
+            nor->pageLen++;
+        }
+        return 0xFFU;
+    default:
+        return 0xFFU;
+    }
+}
+
+static uint32_t SpiNorExchange(void *ctx, uint32_t mosi, bool mosiValid)
+{
+    struct HpmTestSpiNor *nor = (struct HpmTestSpiNor *)ctx;
+    uint32_t unit;
+
+    if (!nor->selected) {
+        nor->protocolErrors++;
+        return 0xFFU;
+    }
+    unit = nor->units++;
+    if (unit == 0) {
+        SpiNorCommand(nor, (uint8_t)mosi);
+        return 0xFFU;
+    }
+    if (nor->ignore) {
+        return 0xFFU;
+    }
+    if (unit <= nor->addrUnits) {
+        nor->addr = (nor->addr << 8) | (mosi & 0xFFU);
+        return 0xFFU;
+    }
+    if (unit <= nor->addrUnits + nor->dummyUnits) {
+        return 0xFFU;
+    }
+    return SpiNorData(nor, mosi, mosiValid);
+}
+
+static bool SpiNorStart(struct HpmTestSpiNor *nor, enum HpmTestSpiNorState state, uint32_t addr, uint32_t len,
+                        uint64_t ns)
+{
+    if (!nor->wel || (nor->units <= nor->addrUnits)) {
+        nor->protocolErrors++;
+        return false;
+    }
+    nor->wel = false;
+    nor->state = state;
+    nor->opAddr = addr;
+    nor->opLen = len;
+    nor->doneNs = HpmTestNowNs() + ns;
+    return true;
+}
+
+static void SpiNorErase(struct HpmTestSpiNor *nor, uint32_t len, uint64_t ns)
+{
+    uint32_t addr = nor->addr % nor->size;
+
+    if (SpiNorStart(nor, HPM_TEST_SPI_NOR_ERASE, addr - addr % len, len, ns)) {
+        nor->erases++;
+    }
+}
+
+/* cs high: the command in the shift register takes effect */
+static void SpiNorExecute(struct HpmTestSpiNor *nor)
+{
+    uint32_t addr = nor->addr % nor->size;
+
+    if (SpiNorIsProgram(nor->op)) {
+        if (nor->pageLen > HPM_TEST_SPI_NOR_PAGE) {
+            nor->protocolErrors++;
+        }
+        if (SpiNorStart(nor, HPM_TEST_SPI_NOR_PROGRAM, addr - addr % HPM_TEST_SPI_NOR_PAGE, HPM_TEST_SPI_NOR_PAGE,
+                        nor->pageNs)) {
+            nor->programs++;
+        }
+    } else if (nor->op == 0x20U) {
+        SpiNorErase(nor, 0x1000U, nor->sectorNs);
+    } else if (nor->op == 0x52U) {
+        SpiNorErase(nor, 0x8000U, nor->blockNs);
+    } else if (nor->op == 0xD8U) {
+        SpiNorErase(nor, 0x10000U, nor->blockNs);
+    } else if ((nor->op == 0xC7U) || (nor->op == 0x60U)) {
+        nor->addr = 0;
+        SpiNorErase(nor, nor->size, nor->blockNs * (nor->size / 0x10000U));
+    } else if (nor->op == 0x06U) {
+        nor->wel = true;
+    } else if (nor->op == 0x04U) {
+        nor->wel = false;
+    } else if ((nor->op == 0x75U) && SpiNorWorking(nor) && (nor->state != HPM_TEST_SPI_NOR_SUSPENDING)) {
+        nor->suspendedState = nor->state;
+        nor->remainNs = nor->doneNs - HpmTestNowNs();
+        nor->state = HPM_TEST_SPI_NOR_SUSPENDING;
+        nor->doneNs = HpmTestNowNs() + nor->suspendNs;
+        nor->suspends++;
+    } else if (nor->op == 0x7AU) {
+        if (nor->state != HPM_TEST_SPI_NOR_SUSPENDED) {
+            nor->protocolErrors++;
+            return;
+        }
+        nor->state = nor->suspendedState;
+        nor->doneNs = HpmTestNowNs() + nor->remainNs;
+    }
+}
+
+void HpmTestSpiNorSelect(struct HpmTestSpiNor *nor, bool low)
+{
+    if (low == nor->selected) {
+        return;
+    }
+    nor->selected = low;
+    if (low) {
+        nor->units = 0;
+    } else if ((nor->units != 0) && !nor->ignore) {
+        SpiNorExecute(nor);
+    }
+}
+
+static void SpiNorCs(void *ctx, bool low)
+{
+    HpmTestSpiNorSelect((struct HpmTestSpiNor *)ctx, low);
+}
+
+static uint64_t SpiNorNext(void *ctx)
+{
+    const struct HpmTestSpiNor *nor = (const struct HpmTestSpiNor *)ctx;
+
+    return SpiNorWorking(nor) ? nor->doneNs : UINT64_MAX;
+}
+
+static void SpiNorRun(void *ctx)
+{
+    struct HpmTestSpiNor *nor = (struct HpmTestSpiNor *)ctx;
+    uint32_t i;
+
+    if (!SpiNorWorking(nor) || (nor->doneNs > HpmTestNowNs())) {
+        return;
+    }
+    if (nor->state == HPM_TEST_SPI_NOR_SUSPENDING) {
+        nor->state = HPM_TEST_SPI_NOR_SUSPENDED;
+        return;
+    }
+    if (nor->state == HPM_TEST_SPI_NOR_PROGRAM) {
+        for (i = 0; i < HPM_TEST_SPI_NOR_PAGE; i++) {
+            nor->mem[nor->opAddr + i] &= nor->page[i];
+        }
+    } else {
+        (void)memset(nor->mem + nor->opAddr, 0xFF, nor->opLen);
+    }
+    nor->state = HPM_TEST_SPI_NOR_IDLE;
+}
+
+void HpmTestSpiNorInit(struct HpmTestSpiNor *nor, uint32_t size, uint64_t pageNs, uint64_t sectorNs,
+                       uint64_t blockNs, uint64_t suspendNs)
+{
+    (void)memset(nor, 0, sizeof(*nor));
+    nor->mem = malloc(size);
+    if (nor->mem == NULL) {
+        abort();
+    }
+    (void)memset(nor->mem, 0xFF, size);
+    nor->size = size;
+    nor->pageNs = pageNs;
+    nor->sectorNs = sectorNs;
+    nor->blockNs = blockNs;
+    nor->suspendNs = suspendNs;
+    nor->model.name = "spi nor";
+    nor->model.next = SpiNorNext;
+    nor->model.run = SpiNorRun;
+    nor->model.ctx = nor;
+    HpmTestModelAdd(&nor->model);
+}
+
+void HpmTestSpiNorDeinit(struct HpmTestSpiNor *nor)
+{
+    HpmTestModelRemove(&nor->model);
+    free(nor->mem);
+    nor->mem = NULL;
+}
+
+void HpmTestSpiNorAttach(struct HpmTestSpiNor *nor, struct HpmTestSpi *spi, bool hwCs)
+{
+    spi->exchange = SpiNorExchange;
+    spi->exchangeCtx = nor;
+    spi->cs = hwCs ? SpiNorCs : NULL;
+}
+
+bool HpmTestSpiNorBusy(const struct HpmTestSpiNor *nor)
+{
+    return SpiNorWorking(nor);
+}
+
+void HpmTestSpiNorStatsReset(struct HpmTestSpiNor *nor)
+{
+    nor->protocolErrors = 0;
+    nor->badReads = 0;
+    nor->commands = 0;
+    nor->programs = 0;
+    nor->erases = 0;
+    nor->suspends = 0;
+    nor->readBytes = 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include "uart_core.h"
+
+struct UartHost *UartHostCreate(struct HdfDeviceObject *device)
+{
+    struct UartHost *host;
+
+    if (device == NULL) {
+        return NULL;
+    }
+    host = calloc(1, sizeof(*host));
+    if (host == NULL) {
+        return NULL;
+    }
+    host->device = device;
+    device->service = &host->service;
+    return host;
+}
+
+void UartHostDestroy(struct UartHost *host)
+{
+    if (host == NULL) {
+        return;
+    }
+    if (host->device != NULL) {
+        host->device->service = NULL;
+    }
+    free(host);
+}
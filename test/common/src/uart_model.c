@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hpm_soc.h"
+#include "hpm_uart_drv.h"
+#include "soc.h"
+#include "hpm_test_dma.h"
+#include "hpm_test_uart.h"
+
+#define UART_REG_CFG 0x10U
+#define UART_REG_OSCR 0x14U
+#define UART_REG_RBR 0x20U
+#define UART_REG_IER 0x24U
+#define UART_REG_IIR 0x28U
+#define UART_REG_LCR 0x2CU
+#define UART_REG_MCR 0x30U
+#define UART_REG_LSR 0x34U
+#define UART_REG_GPR 0x3CU
+#define UART_REG_SIZE 0x40U
+#define UART_IIR_NONE 0x1U
+#define UART_OSC_DEFAULT 32U
+#define UART_TIMEOUT_CHARS 4U
+
+static bool UartModelDlab(const struct HpmTestUart *u)
+{
+    return (u->lcr & UART_LCR_DLAB_MASK) != 0;
+}
+
+uint64_t HpmTestUartCharNs(const struct HpmTestUart *u)
+{
+    uint32_t osc = UART_OSCR_OSC_GET(u->oscr);
+    uint32_t div = (u->dlm << 8) | u->dll;
+    uint32_t bits = 1 + 5 + UART_LCR_WLS_GET(u->lcr) + 1;
+
+    osc = (osc == 0) ? UART_OSC_DEFAULT : osc;
+    div = (div == 0) ? 1 : div;
+    bits += (u->lcr & UART_LCR_PEN_MASK) ? 1 : 0;
+    bits += (u->lcr & UART_LCR_STB_MASK) ? 1 : 0;
+    return (uint64_t)bits * osc * div * 1000000000ULL / u->clkHz;
+}
+
+static uint32_t UartModelRxTrigger(const struct HpmTestUart *u)
+{
+    static const uint32_t level[] = { 1, 5, 9, 13 };
+
+    return level[UART_FCR_RFIFOT_GET(u->fcr)];
+}
+
+static uint32_t UartModelIir(const struct HpmTestUart *u)
+{
+    if ((u->ier & UART_IER_ELSI_MASK) && u->overrun) {
+        return uart_intr_id_rx_line_stat;
+    }
+    if ((u->ier & UART_IER_ERBI_MASK) && (u->rxCount >= UartModelRxTrigger(u))) {
+        return uart_intr_id_rx_data_avail;
+    }
+    if ((u->ier & UART_IER_ERBI_MASK) && u->rxTimeout && (u->rxCount != 0)) {
+        return uart_intr_id_rx_timeout;
+    }
+    if ((u->ier & UART_IER_ETHEI_MASK) && (u->txCount == 0)) {
+        return uart_intr_id_tx_slot_avail;
+    }
+    return UART_IIR_NONE;
+}
+
+static bool UartModelIrqPending(void *ctx)
+{
+    return UartModelIir((const struct HpmTestUart *)ctx) != UART_IIR_NONE;
+}
+
+static bool UartModelDmaRxRequest(void *ctx)
+{
+    const struct HpmTestUart *u = (const struct HpmTestUart *)ctx;
+
+    return (u->fcr & UART_FCR_DMAE_MASK) && (u->rxCount >= UartModelRxTrigger(u));
+}
+
+static bool UartModelDmaTxRequest(void *ctx)
+{
+    const struct HpmTestUart *u = (const struct HpmTestUart *)ctx;
+
+    return (u->fcr & UART_FCR_DMAE_MASK) && (u->txCount < HPM_TEST_UART_FIFO);
+}
+
+static void UartModelTxStart(struct HpmTestUart *u)
+{
+    if (u->txShifting || (u->txCount == 0)) {
+        return;
+    }
+    u->txShift = u->txFifo[u->txHead];
+    u->txHead = (u->txHead + 1) % HPM_TEST_UART_FIFO;
+    u->txCount--;
+    u->txShifting = true;
+    u->txDoneNs = HpmTestNowNs() + HpmTestUartCharNs(u);
+}
+
+static void UartModelRxPop(struct HpmTestUart *u)
+{
+    if (u->rxCount != 0) {
+        u->rxHead = (u->rxHead + 1) % HPM_TEST_UART_FIFO;
+        u->rxCount--;
+    }
+    u->rxTimeout = false;
+    u->rxActivityNs = HpmTestNowNs();
+}
+
+static uint32_t UartModelLsr(const struct HpmTestUart *u)
+{
+    uint32_t lsr = 0;
+
+    lsr |= (u->rxCount != 0) ? UART_LSR_DR_MASK : 0;
+    lsr |= u->overrun ? UART_LSR_OE_MASK : 0;
+    lsr |= (u->txCount == 0) ? UART_LSR_THRE_MASK : 0;
+    lsr |= ((u->txCount == 0) && !u->txShifting) ? UART_LSR_TEMT_MASK : 0;
+    return lsr;
+}
+
+static uint32_t UartModelRead(void *ctx, uint32_t offset)
+{
+    const struct HpmTestUart *u = (const struct HpmTestUart *)ctx;
+
+    switch (offset) {
+    case UART_REG_OSCR:
+        return u->oscr;
+    case UART_REG_RBR:
+        if (UartModelDlab(u)) {
+            return u->dll;
+        }
+        return (u->rxCount != 0) ? u->rxFifo[u->rxHead] : 0;
+    case UART_REG_IER:
+        return UartModelDlab(u) ? u->dlm : u->ier;
+    case UART_REG_IIR:
+        return UartModelIir(u) | UART_IIR_FIFOED_MASK;
+    case UART_REG_LCR:
+        return u->lcr;
+    case UART_REG_MCR:
+        return u->mcr;
+    case UART_REG_LSR:
+        return UartModelLsr(u);
+    case UART_REG_GPR:
+        return u->gpr;
+    default:
+        return 0;
+    }
+}
+
+static void UartModelReadDone(void *ctx, uint32_t offset)
+{
+    struct HpmTestUart *u = (struct HpmTestUart *)ctx;
+
+    if ((offset == UART_REG_RBR) && !UartModelDlab(u)) {
+        UartModelRxPop(u);
+    } else if (offset == UART_REG_LSR) {
+        u->overrun = false;
+    }
+}
+
+static void UartModelWrite(void *ctx, uint32_t offset, uint32_t value)
+{
+    struct HpmTestUart *u = (struct HpmTestUart *)ctx;
+
+    switch (offset) {
+    case UART_REG_OSCR:
+        u->oscr = value;
+        break;
+    case UART_REG_RBR:
+        if (UartModelDlab(u)) {
+            u->dll = value & 0xFFU;
+        } else if (u->txCount < HPM_TEST_UART_FIFO) {
+            u->txFifo[(u->txHead + u->txCount) % HPM_TEST_UART_FIFO] = (uint8_t)value;
+            u->txCount++;
+            UartModelTxStart(u);
+        }
+        break;
+    case UART_REG_IER:
+        if (UartModelDlab(u)) {
+            u->dlm = value & 0xFFU;
+        } else {
+            u->ier = value;
+        }
+        break;
+    case UART_REG_IIR:
+        if (value & UART_FCR_RFIFORST_MASK) {
+            u->rxCount = 0;
+            u->rxTimeout = false;
+        }
+        if (value & UART_FCR_TFIFORST_MASK) {
+            u->txCount = 0;
+        }
+        u->fcr = value & ~(UART_FCR_RFIFORST_MASK | UART_FCR_TFIFORST_MASK);
+        break;
+    case UART_REG_LCR:
+        u->lcr = value;
+        break;
+    case UART_REG_MCR:
+        u->mcr = value;
+        break;
+    case UART_REG_GPR:
+        u->gpr = value;
+        break;
+    default:
+        break;
+    }
+}
+
+static const struct HpmTestMmioOps g_uartOps = {
+    .read = UartModelRead,
+    .readDone = UartModelReadDone,
+    .write = UartModelWrite,
+};
+
+static uint64_t UartModelNext(void *ctx)
+{
+    const struct HpmTestUart *u = (const struct HpmTestUart *)ctx;
+    uint64_t next = UINT64_MAX;
+
+    if (u->rxLineCount != 0) {
+        next = u->rxLine[u->rxLineHead].ns;
+    }
+    if (u->txShifting && (u->txDoneNs < next)) {
+        next = u->txDoneNs;
+    }
+    if ((u->rxCount != 0) && !u->rxTimeout) {
+        uint64_t t = u->rxActivityNs + UART_TIMEOUT_CHARS * HpmTestUartCharNs(u);
+        next = (t < next) ? t : next;
+    }
+    return next;
+}
+
+static void UartModelRun(void *ctx)
+{
+    struct HpmTestUart *u = (struct HpmTestUart *)ctx;
+    uint64_t now = HpmTestNowNs();
+
+    while ((u->rxLineCount != 0) && (u->rxLine[u->rxLineHead].ns <= now)) {
+        uint8_t c = u->rxLine[u->rxLineHead].data;
+        u->rxLineHead = (u->rxLineHead + 1) % u->rxLineSize;
+        u->rxLineCount--;
+        if (u->rxCount < HPM_TEST_UART_FIFO) {
+            u->rxFifo[(u->rxHead + u->rxCount) % HPM_TEST_UART_FIFO] = c;
+            u->rxCount++;
+        } else {
+            u->overrun = true;
+            u->rxLost++;
+        }
+        u->rxTimeout = false;
+        u->rxActivityNs = now;
+    }
+
+    if (u->txShifting && (u->txDoneNs <= now)) {
+        if (u->txCaptured < u->txCaptureSize) {
+            u->txCapture[u->txCaptured] = u->txShift;
+        }
+        u->txCaptured++;
+        u->txLastNs = now;
+        u->txShifting = false;
+        UartModelTxStart(u);
+    }
+
+    if ((u->rxCount != 0) && !u->rxTimeout &&
+        (u->rxActivityNs + UART_TIMEOUT_CHARS * HpmTestUartCharNs(u) <= now)) {
+        u->rxTimeout = true;
+    }
+}
+
+void HpmTestUartInit(struct HpmTestUart *u, uint32_t base, uint32_t plicIrq, uint32_t clkHz, uint8_t dmaRx,
+                     uint8_t dmaTx, uint32_t rxLineSize)
+{
+    memset(u, 0, sizeof(*u));
+    u->base = base;
+    u->losIrq = HPM2LITEOS_IRQ(plicIrq);
+    u->clkHz = clkHz;
+    u->dmaRx = dmaRx;
+    u->dmaTx = dmaTx;
+    u->lcr = UART_LCR_WLS_SET(word_length_8_bits);
+    u->rxLine = calloc(rxLineSize, sizeof(*u->rxLine));
+    u->rxLineSize = rxLineSize;
+    u->model.name = "uart";
+    u->model.next = UartModelNext;
+    u->model.run = UartModelRun;
+    u->model.ctx = u;
+    HpmTestModelAdd(&u->model);
+    HpmTestMmioMap(base, UART_REG_SIZE, &g_uartOps, u);
+    HpmTestIrqSource(u->losIrq, UartModelIrqPending, u);
+    HpmTestDmaRequest(dmaRx, UartModelDmaRxRequest, u);
+    HpmTestDmaRequest(dmaTx, UartModelDmaTxRequest, u);
+}
+
+void HpmTestUartDeinit(struct HpmTestUart *u)
+{
+    HpmTestModelRemove(&u->model);
+    HpmTestMmioUnmap(u->base);
+    HpmTestIrqSource(u->losIrq, NULL, NULL);
+    HpmTestDmaRequest(u->dmaRx, NULL, NULL);
+    HpmTestDmaRequest(u->dmaTx, NULL, NULL);
+    free(u->rxLine);
+    u->rxLine = NULL;
+}
+
+uint32_t HpmTestUartRxSend(struct HpmTestUart *u, const uint8_t *data, uint32_t len, uint64_t startNs)
+{
+    uint64_t charNs = HpmTestUartCharNs(u);
+    uint64_t t = (startNs > u->rxLastNs) ? startNs : u->rxLastNs;
+    uint32_t i;
+
+    for (i = 0; (i < len) && (u->rxLineCount < u->rxLineSize); i++) {
+        struct HpmTestUartLineByte *b = &u->rxLine[(u->rxLineHead + u->rxLineCount) % u->rxLineSize];
+        t += charNs;
+        b->ns = t;
+        b->data = data[i];
+        u->rxLineCount++;
+    }
+    u->rxLastNs = t;
+    return i;
+}
+
+uint64_t HpmTestUartRxEndNs(const struct HpmTestUart *u)
+{
+    return u->rxLastNs;
+}
+
+void HpmTestUartTxCapture(struct HpmTestUart *u, uint8_t *buf, uint32_t size)
+{
+    u->txCapture = buf;
+    u->txCaptureSize = size;
+    u->txCaptured = 0;
+}
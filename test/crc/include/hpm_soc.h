@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * HPM6750 has no CRC block. The hardware backend test puts the peripheral at
+ * the HPM6280 address, which is free on HPM6750, and runs it on the CRC model.
+ */
+
+#ifndef HPM_TEST_CRC_SOC_H
+#define HPM_TEST_CRC_SOC_H
+
+#include_next "hpm_soc.h"
+#include "hpm_crc_regs.h"
+
+#define HPM_CRC_BASE (0xF00B8000UL)
+#define HPM_CRC ((CRC_Type *) HPM_CRC_BASE)
+
+#endif
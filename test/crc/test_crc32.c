@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * sdk/hpm_sdk/utils/hpm_crc32.c: every backend against a bitwise reference on
+ * random buffers, offsets and crc32_update split points, with its throughput.
+ * The CRC peripheral backend runs on the CRC and DMA models, including a
+ * stalled DMA transfer that has to fall back to software.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "hpm_crc32.h"
+#include "hpm_test.h"
+#if defined(HPM_CRC32_USE_HW)
+#include "hpm_soc.h"
+#include "hpm_dma_mgr.h"
+#include "hpm_test_crc.h"
+#include "hpm_test_dma.h"
+#endif
+
+#define TEST_BUF_SIZE (16U * 1024U)
+#define TEST_BENCH_SIZE (1024U * 1024U)
+#define TEST_LEN_MAX 4000U
+#define TEST_NS_PER_US 1000ULL
+#define TEST_MMIO_NS 40U
+
+static uint8_t g_buf[TEST_BENCH_SIZE + 16];
+static uint32_t g_seed = 0x0C4C3210U;
+
+static uint32_t TestCrcRef(const uint8_t *buf, uint32_t len)
+{
+    uint32_t crc = 0xFFFFFFFFU;
+
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320U) : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+static void TestCrcRandom(uint32_t rounds)
+{
+    uint32_t bad = 0;
+
+    HPM_TEST_CHECK_EQ(crc32((const uint8_t *)"123456789", 9), 0xCBF43926U);
+    HPM_TEST_CHECK_EQ(crc32(g_buf, 0), 0);
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        uint32_t off = HpmTestRand(&g_seed) % 16;
+        uint32_t len = HpmTestRand(&g_seed) % TEST_LEN_MAX;
+        uint32_t split = (len != 0) ? (HpmTestRand(&g_seed) % len) : 0;
+        uint32_t ref = TestCrcRef(&g_buf[off], len);
+
+        bad += (crc32(&g_buf[off], len) != ref) ? 1 : 0;
+        bad += (crc32_update(crc32(&g_buf[off], split), &g_buf[off + split], len - split) != ref) ? 1 : 0;
+    }
+    HPM_TEST_CHECK_EQ(bad, 0);
+
+    /* a long buffer in many pieces */
+    uint32_t crc = 0;
+    for (uint32_t off = 0; off < TEST_BUF_SIZE;) {
+        uint32_t len = 1 + HpmTestRand(&g_seed) % 1500;
+        len = (len < TEST_BUF_SIZE - off) ? len : (TEST_BUF_SIZE - off);
+        crc = crc32_update(crc, &g_buf[off], len);
+        off += len;
+    }
+    HPM_TEST_CHECK_EQ(crc, TestCrcRef(g_buf, TEST_BUF_SIZE));
+}
+
+#if defined(HPM_CRC32_USE_HW)
+static struct HpmTestCrc g_crc;
+
+/* The peripheral takes the buffers, and a dma transfer that stalls is given up on */
+static void TestCrcHw(void)
+{
+    uint32_t ref = TestCrcRef(g_buf, TEST_BUF_SIZE);
+    uint32_t dmaBytes;
+    uint64_t t0;
+
+    g_crc.chn[0].dmaBytes = 0;
+    HPM_TEST_CHECK_EQ(crc32(g_buf, TEST_BUF_SIZE), ref);
+    HPM_TEST_CHECK_EQ(g_crc.chn[0].dmaBytes, TEST_BUF_SIZE);
+
+    /* short buffers stay on the cpu */
+    g_crc.chn[0].dmaBytes = 0;
+    g_crc.chn[0].cpuBytes = 0;
+    HPM_TEST_CHECK_EQ(crc32(g_buf, 100), TestCrcRef(g_buf, 100));
+    HPM_TEST_CHECK_EQ(g_crc.chn[0].dmaBytes + g_crc.chn[0].cpuBytes, 0);
+
+    /* one burst per second, far behind the status polls */
+    HpmTestDmaTiming(1000000000U, 2500);
+    t0 = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(crc32(&g_buf[1], TEST_BUF_SIZE - 1), TestCrcRef(&g_buf[1], TEST_BUF_SIZE - 1));
+    printf("stalled dma transfer of %u bytes given up after %llu us\n", TEST_BUF_SIZE,
+           (unsigned long long)((HpmTestNowNs() - t0) / TEST_NS_PER_US));
+    HPM_TEST_CHECK(HpmTestNowNs() - t0 < 1000000000ULL);
+
+    /* the aborted channel does not write DATA any more */
+    dmaBytes = g_crc.chn[0].dmaBytes;
+    HpmTestRunUntil(HpmTestNowNs() + 5000000000ULL);
+    HPM_TEST_CHECK_EQ(g_crc.chn[0].dmaBytes, dmaBytes);
+
+    HpmTestDmaTiming(20, 2500);
+    g_crc.chn[0].dmaBytes = 0;
+    HPM_TEST_CHECK_EQ(crc32(g_buf, TEST_BUF_SIZE), ref);
+    HPM_TEST_CHECK_EQ(g_crc.chn[0].dmaBytes, TEST_BUF_SIZE);
+}
+#else
+static void TestCrcBench(void)
+{
+    uint32_t rounds = HpmTestFull() ? 64U : 8U;
+    uint32_t crc = 0;
+    uint64_t t0 = HpmTestHostNs();
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        crc = crc32_update(crc, g_buf, TEST_BENCH_SIZE);
+    }
+    uint64_t ns = HpmTestHostNs() - t0;
+    printf("crc32 slice-%d: %llu MB/s over %u MiB\n", HPM_CRC32_SLICE,
+           (unsigned long long)((uint64_t)rounds * TEST_BENCH_SIZE * 1000ULL / (ns ? ns : 1)), rounds);
+    HPM_TEST_CHECK(crc != 0);
+}
+#endif
+
+int main(void)
+{
+    for (uint32_t i = 0; i < sizeof(g_buf); i++) {
+        g_buf[i] = (uint8_t)HpmTestRand(&g_seed);
+    }
+
+#if defined(HPM_CRC32_USE_HW)
+    HpmTestVirtualTime(true);
+    HpmTestMmioCostNs(TEST_MMIO_NS);
+    HpmTestDmaModelInit();
+    HpmTestCrcModelInit(&g_crc, HPM_CRC_BASE);
+    dma_mgr_init();
+
+    TestCrcRandom(HpmTestFull() ? 2000U : 50U);
+    TestCrcHw();
+
+    HpmTestCrcModelDeinit(&g_crc);
+    HpmTestDmaModelDeinit();
+#else
+    TestCrcRandom(HpmTestFull() ? 200000U : 20000U);
+    TestCrcBench();
+#endif
+    return HpmTestResult();
+}
@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * sdk/hpm_sdk/components/dma_mgr/hpm_dma_mgr.c on the DMA model: the isr
+ * serves the channels whose interrupt is enabled and leaves the status of
+ * polled channels alone, over random mixes of completed, aborted and masked
+ * channels, and what an interrupt costs with one and with every channel done.
+ * The descriptor pool, the chains dma_mgr_config_linked_list builds, and a
+ * ring streaming on the interrupt with consumers that keep up, that drain in
+ * bursts and that fall behind.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "hpm_soc.h"
+#include "hpm_dma_mgr.h"
+#include "soc.h"
+#include "los_interrupt.h"
+#include "hpm_test.h"
+#include "hpm_test_dma.h"
+
+#define TEST_MMIO_NS 40U
+#define TEST_CHN_NUM DMA_SOC_CHANNEL_NUM
+#define TEST_COPY_SIZE 64U
+#define TEST_ABORT_SIZE 4096U
+#define TEST_WAIT_NS 100000ULL
+#define TEST_COST_ROUNDS 200U
+#define TEST_SG_COUNT 3U
+#define TEST_RING_CHUNK 256U
+#define TEST_RING_COUNT 8U
+
+enum TestOp {
+    TEST_OP_NONE,
+    TEST_OP_TC,
+    TEST_OP_ABORT,
+};
+
+static dma_resource_t g_res[TEST_CHN_NUM];
+static uint32_t g_tcHits;
+static uint32_t g_abortHits;
+static uint32_t g_order[2U * TEST_CHN_NUM];
+static uint32_t g_orderCount;
+static uint8_t g_src[TEST_CHN_NUM][TEST_ABORT_SIZE];
+static uint8_t g_dst[TEST_CHN_NUM][TEST_ABORT_SIZE];
+static uint32_t g_seed = 0xD3A11511U;
+static uint8_t g_ringBuf[TEST_RING_COUNT * TEST_RING_CHUNK] __attribute__((aligned(8)));
+static uint32_t g_ringSrc[TEST_RING_CHUNK / sizeof(uint32_t)];
+static dma_mgr_ring_t g_ring;
+
+static void TestTcCallback(DMA_Type *base, uint32_t channel, void *userData)
+{
+    (void)base;
+    (void)userData;
+    g_tcHits |= 1UL << channel;
+    g_order[g_orderCount++ % (2U * TEST_CHN_NUM)] = channel;
+}
+
+static void TestAbortCallback(DMA_Type *base, uint32_t channel, void *userData)
+{
+    (void)base;
+    (void)userData;
+    g_abortHits |= 1UL << channel;
+    g_order[g_orderCount++ % (2U * TEST_CHN_NUM)] = channel;
+}
+
+static void TestStart(uint32_t ch, uint32_t size, uint32_t interruptMask)
+{
+    dma_mgr_chn_conf_t config;
+
+    dma_mgr_get_default_chn_config(&config);
+    config.src_addr = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)g_src[ch]);
+    config.dst_addr = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)g_dst[ch]);
+    config.size_in_byte = size;
+    config.interrupt_mask = interruptMask;
+    HPM_TEST_CHECK_EQ(dma_mgr_setup_channel(&g_res[ch], &config), status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_enable_channel(&g_res[ch]), status_success);
+}
+
+static void TestWaitIdle(void)
+{
+    uint64_t deadline = HpmTestNowNs() + 100U * TEST_WAIT_NS;
+
+    while (((HPM_HDMA->CHEN & 0xFFU) != 0U) && (HpmTestNowNs() < deadline)) {
+        HpmTestRunUntil(HpmTestNowNs() + TEST_WAIT_NS);
+    }
+    HPM_TEST_CHECK_EQ(HPM_HDMA->CHEN & 0xFFU, 0);
+}
+
+/* A polled transfer completes next to an interrupt driven one: the isr of the latter must not eat its status */
+static void TestPolledChannel(void)
+{
+    uint32_t status = 0;
+
+    memset(g_src[0], 0xA5, TEST_COPY_SIZE);
+    memset(g_dst[0], 0, TEST_COPY_SIZE);
+    g_tcHits = 0;
+    TestStart(0, TEST_COPY_SIZE, DMA_MGR_INTERRUPT_MASK_ALL);
+    TestStart(1, TEST_COPY_SIZE, DMA_MGR_INTERRUPT_MASK_ALL & ~DMA_MGR_INTERRUPT_MASK_TC);
+    TestWaitIdle();
+    dma_mgr_isr_handler(HPM_HDMA, 0);
+    HPM_TEST_CHECK_EQ(g_tcHits, 1UL << 1);
+    HPM_TEST_CHECK_EQ(dma_mgr_check_chn_transfer_status(&g_res[0], &status), status_success);
+    HPM_TEST_CHECK_EQ(status, DMA_MGR_CHANNEL_STATUS_TC);
+    HPM_TEST_CHECK_EQ(memcmp(g_src[0], g_dst[0], TEST_COPY_SIZE), 0);
+    HPM_TEST_CHECK_EQ(dma_mgr_check_chn_transfer_status(&g_res[1], &status), status_success);
+    HPM_TEST_CHECK_EQ(status, DMA_MGR_CHANNEL_STATUS_ONGOING);
+}
+
+static void TestRandom(uint32_t rounds)
+{
+    uint32_t badHits = 0;
+    uint32_t badStatus = 0;
+    uint32_t badOrder = 0;
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        uint32_t tcSet = 0;
+        uint32_t abortSet = 0;
+        uint32_t tcMasked = 0;
+        uint32_t abortMasked = 0;
+        uint32_t expect;
+
+        g_tcHits = 0;
+        g_abortHits = 0;
+        g_orderCount = 0;
+        for (uint32_t ch = 0; ch < TEST_CHN_NUM; ch++) {
+            uint32_t rnd = HpmTestRand(&g_seed);
+            uint32_t mask = DMA_MGR_INTERRUPT_MASK_ERROR;
+            mask |= (rnd & 0x10U) ? DMA_MGR_INTERRUPT_MASK_TC : 0U;
+            mask |= (rnd & 0x20U) ? DMA_MGR_INTERRUPT_MASK_ABORT : 0U;
+            tcMasked |= (rnd & 0x10U) ? (1UL << ch) : 0U;
+            abortMasked |= (rnd & 0x20U) ? (1UL << ch) : 0U;
+            switch (rnd % 3U) {
+            case TEST_OP_TC:
+                TestStart(ch, TEST_COPY_SIZE, mask);
+                tcSet |= 1UL << ch;
+                break;
+            case TEST_OP_ABORT:
+                TestStart(ch, TEST_ABORT_SIZE, mask);
+                HPM_TEST_CHECK_EQ(dma_mgr_abort_chn_transfer(&g_res[ch]), status_success);
+                abortSet |= 1UL << ch;
+                break;
+            default:
+                break;
+            }
+        }
+        TestWaitIdle();
+        dma_mgr_isr_handler(HPM_HDMA, 0);
+
+        badHits += (g_tcHits != (tcSet & ~tcMasked)) ? 1U : 0U;
+        badHits += (g_abortHits != (abortSet & ~abortMasked)) ? 1U : 0U;
+        for (uint32_t i = 1; i < g_orderCount; i++) {
+            badOrder += (g_order[i] < g_order[i - 1U]) ? 1U : 0U;
+        }
+        expect = ((tcSet & tcMasked) << DMA_STATUS_TC_SHIFT) | ((abortSet & abortMasked) << DMA_STATUS_ABORT_SHIFT);
+        badStatus += (HPM_HDMA->INTSTATUS != expect) ? 1U : 0U;
+        HPM_HDMA->INTSTATUS = expect;
+    }
+    printf("%u rounds: %u wrong callback sets, %u out of order, %u with wrong status left\n", rounds, badHits,
+           badOrder, badStatus);
+    HPM_TEST_CHECK_EQ(badHits, 0);
+    HPM_TEST_CHECK_EQ(badOrder, 0);
+    HPM_TEST_CHECK_EQ(badStatus, 0);
+}
+
+/* The isr before the status bitmap: every channel's mask and status, whether it is done or not */
+static void TestScanIsr(DMA_Type *ptr)
+{
+    for (uint8_t ch = 0; ch < TEST_CHN_NUM; ch++) {
+        uint32_t mask = dma_check_channel_interrupt_mask(ptr, ch);
+        uint32_t status = dma_check_transfer_status(ptr, ch);
+        if (((mask & DMA_MGR_INTERRUPT_MASK_TC) == 0) && ((status & DMA_CHANNEL_STATUS_TC) != 0)) {
+            TestTcCallback(ptr, ch, NULL);
+        }
+    }
+}
+
+/* Register accesses and virtual time of one interrupt taking <active> completions, with the isr or the scan */
+static void TestIsrRun(uint32_t active, bool scan, uint64_t *mmio, uint64_t *ns)
+{
+    *mmio = 0;
+    *ns = 0;
+    for (uint32_t r = 0; r < TEST_COST_ROUNDS; r++) {
+        g_tcHits = 0;
+        g_orderCount = 0;
+        for (uint32_t ch = 0; ch < active; ch++) {
+            TestStart(ch, TEST_COPY_SIZE, DMA_MGR_INTERRUPT_MASK_ALL & ~DMA_MGR_INTERRUPT_MASK_TC);
+        }
+        TestWaitIdle();
+
+        uint64_t accesses = HpmTestMmioAccesses();
+        uint64_t start = HpmTestNowNs();
+        if (scan) {
+            TestScanIsr(HPM_HDMA);
+        } else {
+            dma_mgr_isr_handler(HPM_HDMA, 0);
+        }
+        *ns += HpmTestNowNs() - start;
+        *mmio += HpmTestMmioAccesses() - accesses;
+        HPM_TEST_CHECK_EQ(g_tcHits, (1UL << active) - 1U);
+    }
+    *mmio /= TEST_COST_ROUNDS;
+    *ns /= TEST_COST_ROUNDS;
+}
+
+/*
+ * Cost of one interrupt with 1 and with all channels of the controller done.
+ * HPM6750 has 8 channels per DMA, so that is the most there can be.
+ */
+static void TestIsrCost(void)
+{
+    static const uint32_t counts[] = { 1U, TEST_CHN_NUM };
+    uint64_t mmio;
+    uint64_t ns;
+    uint64_t scanMmio;
+    uint64_t scanNs;
+
+    printf("isr cost, %u channels, %u ns per register access, %u interrupts each\n", TEST_CHN_NUM, TEST_MMIO_NS,
+           TEST_COST_ROUNDS);
+    printf("  done  isr accesses  isr ns   scan accesses  scan ns\n");
+    for (uint32_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        TestIsrRun(counts[i], false, &mmio, &ns);
+        TestIsrRun(counts[i], true, &scanMmio, &scanNs);
+        printf("  %4u  %12llu  %6llu   %13llu  %7llu\n", counts[i], (unsigned long long)mmio, (unsigned long long)ns,
+               (unsigned long long)scanMmio, (unsigned long long)scanNs);
+        /* one status read and one clear, then one control read per channel that is done */
+        HPM_TEST_CHECK_EQ(mmio, 2U + counts[i]);
+        HPM_TEST_CHECK(mmio < scanMmio);
+    }
+}
+
+/* Runs of descriptors come from one pool, first fit, and go back to it */
+static void TestDescriptorPool(void)
+{
+    dma_mgr_linked_descriptor_t *all[DMA_MGR_DESCRIPTOR_POOL_SIZE];
+    dma_mgr_linked_descriptor_t *runs[4];
+    dma_mgr_linked_descriptor_t *hole;
+
+    for (uint32_t i = 0; i < DMA_MGR_DESCRIPTOR_POOL_SIZE; i++) {
+        all[i] = dma_mgr_alloc_linked_descriptors(1);
+        HPM_TEST_CHECK(all[i] != NULL);
+        HPM_TEST_CHECK_EQ((uint32_t)(uintptr_t)all[i] % 8U, 0);
+        HPM_TEST_CHECK((i == 0) || (all[i] == all[i - 1U] + 1));
+    }
+    HPM_TEST_CHECK(dma_mgr_alloc_linked_descriptors(1) == NULL);
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors(all[5], 1), status_success);
+    HPM_TEST_CHECK(dma_mgr_alloc_linked_descriptors(1) == all[5]);
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors(all[0], DMA_MGR_DESCRIPTOR_POOL_SIZE), status_success);
+
+    /* four runs of a quarter, free the second: a quarter fits in the hole, a quarter and one does not */
+    for (uint32_t i = 0; i < 4U; i++) {
+        runs[i] = dma_mgr_alloc_linked_descriptors(DMA_MGR_DESCRIPTOR_POOL_SIZE / 4U);
+        HPM_TEST_CHECK(runs[i] == all[i * DMA_MGR_DESCRIPTOR_POOL_SIZE / 4U]);
+    }
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors(runs[1], DMA_MGR_DESCRIPTOR_POOL_SIZE / 4U), status_success);
+    HPM_TEST_CHECK(dma_mgr_alloc_linked_descriptors(DMA_MGR_DESCRIPTOR_POOL_SIZE / 4U + 1U) == NULL);
+    hole = dma_mgr_alloc_linked_descriptors(DMA_MGR_DESCRIPTOR_POOL_SIZE / 4U);
+    HPM_TEST_CHECK(hole == runs[1]);
+
+    HPM_TEST_CHECK(dma_mgr_alloc_linked_descriptors(0) == NULL);
+    HPM_TEST_CHECK(dma_mgr_alloc_linked_descriptors(DMA_MGR_DESCRIPTOR_POOL_SIZE + 1U) == NULL);
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors(all[0] - 1, 1), status_invalid_argument);
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors(all[DMA_MGR_DESCRIPTOR_POOL_SIZE - 1U], 2),
+                      status_invalid_argument);
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors(all[0], 0), status_invalid_argument);
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors(all[0], DMA_MGR_DESCRIPTOR_POOL_SIZE), status_success);
+}
+
+static uint32_t TestSysAddr(const void *ptr)
+{
+    return core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)(uintptr_t)ptr);
+}
+
+/* Entry <i> of the list as dma_mgr_config_linked_list wrote it, pointing at <next> */
+static void TestCheckEntry(const dma_mgr_linked_descriptor_t *desc, const dma_mgr_sg_entry_t *entry,
+                           const void *next, bool tc)
+{
+    const dma_linked_descriptor_t *d = (const dma_linked_descriptor_t *)desc;
+
+    HPM_TEST_CHECK_EQ(d->src_addr, entry->src_addr);
+    HPM_TEST_CHECK_EQ(d->dst_addr, entry->dst_addr);
+    HPM_TEST_CHECK_EQ(d->trans_size, entry->size_in_byte);
+    HPM_TEST_CHECK_EQ(d->linked_ptr, (next != NULL) ? TestSysAddr(next) : 0U);
+    HPM_TEST_CHECK_EQ((d->ctrl & DMA_CHCTRL_CTRL_INTTCMASK_MASK) == 0U, tc);
+}
+
+/*
+ * A linear list moves every entry and interrupts once at its end, a circular
+ * one links back to entry 0 and interrupts after every entry
+ */
+static void TestLinkedList(void)
+{
+    static const uint32_t sizes[TEST_SG_COUNT] = { 64, 200, 36 };
+    dma_mgr_sg_entry_t list[TEST_SG_COUNT];
+    dma_mgr_linked_descriptor_t *desc = dma_mgr_alloc_linked_descriptors(TEST_SG_COUNT);
+    dma_mgr_chn_conf_t config;
+    uint32_t status = 0;
+
+    for (uint32_t i = 0; i < TEST_SG_COUNT; i++) {
+        for (uint32_t k = 0; k < sizes[i]; k++) {
+            g_src[i][k] = (uint8_t)HpmTestRand(&g_seed);
+        }
+        (void)memset(g_dst[i], 0, TEST_ABORT_SIZE);
+        /* gather from three buffers into one */
+        list[i].src_addr = TestSysAddr(g_src[i]);
+        list[i].dst_addr = TestSysAddr(&g_dst[0][(i == 0) ? 0 : ((i == 1) ? sizes[0] : sizes[0] + sizes[1])]);
+        list[i].size_in_byte = sizes[i];
+    }
+
+    dma_mgr_get_default_chn_config(&config);
+    config.interrupt_mask = DMA_MGR_INTERRUPT_MASK_ALL & ~DMA_MGR_INTERRUPT_MASK_TC;
+    HPM_TEST_CHECK_EQ(dma_mgr_config_linked_list(&g_res[0], &config, list, TEST_SG_COUNT, desc, false),
+                      status_success);
+    HPM_TEST_CHECK_EQ(config.src_addr, list[0].src_addr);
+    HPM_TEST_CHECK_EQ(config.dst_addr, list[0].dst_addr);
+    HPM_TEST_CHECK_EQ(config.size_in_byte, list[0].size_in_byte);
+    HPM_TEST_CHECK_EQ(config.linked_ptr, TestSysAddr(&desc[1]));
+    HPM_TEST_CHECK_EQ(config.interrupt_mask & DMA_MGR_INTERRUPT_MASK_TC, DMA_MGR_INTERRUPT_MASK_TC);
+    TestCheckEntry(&desc[1], &list[1], &desc[2], false);
+    TestCheckEntry(&desc[2], &list[2], NULL, true);
+
+    g_tcHits = 0;
+    g_orderCount = 0;
+    HPM_TEST_CHECK_EQ(dma_mgr_setup_channel(&g_res[0], &config), status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_enable_channel(&g_res[0]), status_success);
+    TestWaitIdle();
+    dma_mgr_isr_handler(HPM_HDMA, 0);
+    HPM_TEST_CHECK_EQ(g_tcHits, 1);
+    HPM_TEST_CHECK_EQ(g_orderCount, 1);
+    HPM_TEST_CHECK_EQ(memcmp(&g_dst[0][0], g_src[0], sizes[0]), 0);
+    HPM_TEST_CHECK_EQ(memcmp(&g_dst[0][sizes[0]], g_src[1], sizes[1]), 0);
+    HPM_TEST_CHECK_EQ(memcmp(&g_dst[0][sizes[0] + sizes[1]], g_src[2], sizes[2]), 0);
+    HPM_TEST_CHECK_EQ(g_dst[0][sizes[0] + sizes[1] + sizes[2]], 0);
+    HPM_TEST_CHECK_EQ(dma_mgr_check_chn_transfer_status(&g_res[0], &status), status_success);
+    HPM_TEST_CHECK_EQ(status, DMA_MGR_CHANNEL_STATUS_ONGOING);
+
+    dma_mgr_get_default_chn_config(&config);
+    config.interrupt_mask = DMA_MGR_INTERRUPT_MASK_ALL & ~DMA_MGR_INTERRUPT_MASK_TC;
+    HPM_TEST_CHECK_EQ(dma_mgr_config_linked_list(&g_res[0], &config, list, TEST_SG_COUNT, desc, true),
+                      status_success);
+    HPM_TEST_CHECK_EQ(config.linked_ptr, TestSysAddr(&desc[1]));
+    TestCheckEntry(&desc[0], &list[0], &desc[1], true);
+    TestCheckEntry(&desc[1], &list[1], &desc[2], true);
+    TestCheckEntry(&desc[2], &list[2], &desc[0], true);
+
+    HPM_TEST_CHECK_EQ(dma_mgr_config_linked_list(&g_res[0], &config, list, 0, desc, false), status_invalid_argument);
+    HPM_TEST_CHECK_EQ(dma_mgr_config_linked_list(&g_res[0], &config, list, TEST_SG_COUNT, NULL, false),
+                      status_invalid_argument);
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors(desc, TEST_SG_COUNT), status_success);
+}
+
+static VOID TestHdmaIsr(VOID *arg)
+{
+    (void)arg;
+    dma_mgr_isr_handler(HPM_HDMA, 0);
+}
+
+/* The chunk ready callback stamps each chunk with its sequence number, as a driver would parse it */
+static void TestRingReady(dma_mgr_ring_t *ring, uint8_t *chunk, void *userData)
+{
+    uint32_t seq = ring->produced - 1U;
+
+    (void)userData;
+    (void)memcpy(chunk, &seq, sizeof(seq));
+}
+
+/*
+ * Stream <chunks> chunks through the ring, the consumer runs every <every>
+ * chunk times and takes up to <burst> chunks. A chunk counts as delivered
+ * when acquire and release both succeed, its stamp must then be the sequence
+ * number the consumer expects.
+ */
+static void TestRingRun(const char *name, uint64_t chunkNs, uint32_t every, uint32_t burst, uint32_t chunks,
+                        bool overrunExpected)
+{
+    uint32_t delivered = 0;
+    uint32_t overruns = 0;
+    uint32_t corrupt = 0;
+    uint32_t irqs = HpmTestIrqCount(HPM2LITEOS_IRQ(IRQn_HDMA));
+    uint64_t mmio = HpmTestMmioAccesses();
+    uint32_t overrunCount = g_ring.overrun_count;
+    uint64_t bytes;
+    uint32_t tc;
+    uint64_t start;
+
+    HpmTestDmaStats(0, &bytes, &tc);
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_start(&g_ring), status_success);
+    while (g_ring.produced < chunks) {
+        HpmTestRunUntil(HpmTestNowNs() + every * chunkNs);
+        for (uint32_t k = 0; k < burst; k++) {
+            uint8_t *chunk = NULL;
+            uint32_t seq = g_ring.consumed;
+            uint32_t stamp;
+            hpm_stat_t ret = dma_mgr_ring_acquire(&g_ring, &chunk);
+            if (ret == status_dma_mgr_ring_empty) {
+                break;
+            }
+            if (ret == status_dma_mgr_ring_overrun) {
+                overruns++;
+                continue;
+            }
+            HPM_TEST_CHECK(chunk == &g_ringBuf[(seq % TEST_RING_COUNT) * TEST_RING_CHUNK]);
+            (void)memcpy(&stamp, chunk, sizeof(stamp));
+            ret = dma_mgr_ring_release(&g_ring);
+            if (ret == status_dma_mgr_ring_overrun) {
+                overruns++;
+                continue;
+            }
+            delivered++;
+            corrupt += (stamp != seq) ? 1U : 0U;
+        }
+    }
+    uint64_t ns = HpmTestNowNs() - start;
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_stop(&g_ring), status_success);
+    irqs = HpmTestIrqCount(HPM2LITEOS_IRQ(IRQn_HDMA)) - irqs;
+    mmio = HpmTestMmioAccesses() - mmio;
+    uint32_t tcBefore = tc;
+    HpmTestDmaStats(0, &bytes, &tc);
+
+    printf("  %-24s %7u %9u %8u %7u %8.1f %8.2f %8.1f\n", name, g_ring.produced, delivered, overruns, corrupt,
+           (double)delivered * TEST_RING_CHUNK * 1000.0 / (double)ns, (double)irqs / g_ring.produced,
+           (double)mmio / g_ring.produced);
+    HPM_TEST_CHECK_EQ(corrupt, 0);
+    HPM_TEST_CHECK_EQ(overruns, g_ring.overrun_count - overrunCount);
+    /* one interrupt per chunk, none merged */
+    HPM_TEST_CHECK_EQ(tc - tcBefore, g_ring.produced);
+    if (overrunExpected) {
+        HPM_TEST_CHECK(overruns > 0);
+        HPM_TEST_CHECK(delivered > 0);
+    } else {
+        HPM_TEST_CHECK_EQ(overruns, 0);
+        HPM_TEST_CHECK(delivered + TEST_RING_COUNT >= g_ring.produced);
+    }
+}
+
+/* A word wide memory stream on the ring, with consumers that keep up, drain in bursts and fall behind */
+static void TestRing(uint32_t chunks)
+{
+    dma_mgr_ring_config_t config;
+    uint8_t *chunk;
+    uint64_t start;
+    uint64_t chunkNs;
+
+    (void)memset(&config, 0, sizeof(config));
+    dma_mgr_get_default_chn_config(&config.chn_config);
+    config.chn_config.src_addr = TestSysAddr(g_ringSrc);
+    config.chn_config.src_width = DMA_MGR_TRANSFER_WIDTH_WORD;
+    config.chn_config.dst_width = DMA_MGR_TRANSFER_WIDTH_WORD;
+    config.chn_config.src_burst_size = DMA_MGR_NUM_TRANSFER_PER_BURST_16T;
+    config.chn_config.interrupt_mask = DMA_MGR_INTERRUPT_MASK_HALF_TC;
+    config.buf_is_dst = true;
+    config.buf = g_ringBuf;
+    config.chunk_size = TEST_RING_CHUNK;
+    config.chunk_count = TEST_RING_COUNT;
+    config.callback = TestRingReady;
+    (void)memset(g_ringSrc, 0xEE, sizeof(g_ringSrc));
+
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_init(&g_ring, &g_res[0], &config), status_success);
+    HPM_TEST_CHECK(dma_mgr_alloc_linked_descriptors(DMA_MGR_DESCRIPTOR_POOL_SIZE - TEST_RING_COUNT + 1U) == NULL);
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_acquire(&g_ring, &chunk), status_dma_mgr_ring_empty);
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_release(&g_ring), status_dma_mgr_ring_empty);
+    HPM_TEST_CHECK_EQ(LOS_HwiCreate(HPM2LITEOS_IRQ(IRQn_HDMA), 1, 0, (HWI_PROC_FUNC)TestHdmaIsr, NULL), LOS_OK);
+    HPM_TEST_CHECK_EQ(LOS_HwiEnable(HPM2LITEOS_IRQ(IRQn_HDMA)), LOS_OK);
+
+    /* the chunk period on the model */
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_start(&g_ring), status_success);
+    HpmTestRunUntil(start + 1000000ULL);
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_stop(&g_ring), status_success);
+    HPM_TEST_CHECK(g_ring.produced > 0);
+    chunkNs = 1000000ULL / g_ring.produced;
+
+    printf("ring, %u chunks of %u bytes, %llu ns per chunk, %u ns per register access\n", TEST_RING_COUNT,
+           TEST_RING_CHUNK, (unsigned long long)chunkNs, TEST_MMIO_NS);
+    printf("  %-24s %7s %9s %8s %7s %8s %8s %8s\n", "consumer", "chunks", "delivered", "overruns", "corrupt",
+           "MB/s", "irq/chk", "regs/chk");
+    TestRingRun("every chunk", chunkNs, 1, 1, chunks, false);
+    TestRingRun("4 every 3 chunks", chunkNs, 3, 4, chunks, false);
+    TestRingRun("every 7 chunks", chunkNs, 7, TEST_RING_COUNT, chunks, false);
+    TestRingRun("1 every 2 chunks", chunkNs, 2, 1, chunks, true);
+    TestRingRun("every 20 chunks", chunkNs, 20, TEST_RING_COUNT, chunks, true);
+
+    HPM_TEST_CHECK_EQ(LOS_HwiDelete(HPM2LITEOS_IRQ(IRQn_HDMA), NULL), LOS_OK);
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_deinit(&g_ring), status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_ring_deinit(&g_ring), status_invalid_argument);
+    chunk = (uint8_t *)dma_mgr_alloc_linked_descriptors(DMA_MGR_DESCRIPTOR_POOL_SIZE);
+    HPM_TEST_CHECK(chunk != NULL);
+    HPM_TEST_CHECK_EQ(dma_mgr_free_linked_descriptors((dma_mgr_linked_descriptor_t *)chunk,
+                                                      DMA_MGR_DESCRIPTOR_POOL_SIZE), status_success);
+}
+
+int main(void)
+{
+    HpmTestVirtualTime(true);
+    HpmTestMmioCostNs(TEST_MMIO_NS);
+    HpmTestDmaModelInit();
+    dma_mgr_init();
+    for (uint32_t ch = 0; ch < TEST_CHN_NUM; ch++) {
+        dma_mgr_resource_hint_t hint = { .instance = 0, .instance_only = true, .high_priority = true };
+        HPM_TEST_CHECK_EQ(dma_mgr_request_resource_with_hint(&g_res[ch], &hint), status_success);
+        HPM_TEST_CHECK_EQ(g_res[ch].channel, ch);
+        HPM_TEST_CHECK_EQ(dma_mgr_install_chn_tc_callback(&g_res[ch], TestTcCallback, NULL), status_success);
+        HPM_TEST_CHECK_EQ(dma_mgr_install_chn_abort_callback(&g_res[ch], TestAbortCallback, NULL), status_success);
+    }
+
+    TestPolledChannel();
+    TestRandom(HpmTestFull() ? 20000U : 1000U);
+    TestIsrCost();
+    TestDescriptorPool();
+    TestLinkedList();
+    TestRing(HpmTestFull() ? 400000U : 20000U);
+
+    HpmTestDmaModelDeinit();
+    return HpmTestResult();
+}
@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * sdk/hpm_sdk/components/dma_mgr/hpm_dma_mgr_memcpy.c on the DMA model: the
+ * threshold routing, cache hook order, transfer widths, memset bounds,
+ * queueing on the reserved channels and resubmission from the completion
+ * callback. Then dma_mgr_memcpy_calibrate from 64 bytes to 1 MB against a
+ * modelled CPU copy: memcpy and memset into the scratch buffer are wrapped and
+ * charge a call cost plus a cost per byte to the virtual clock.
+ * The futures are static, the DMA reads the memset pattern from them and the
+ * host stack is above the 32 bit range.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "hpm_soc.h"
+#include "hpm_dma_mgr_memcpy.h"
+#include "soc.h"
+#include "los_interrupt.h"
+#include "hpm_test.h"
+#include "hpm_test_dma.h"
+#include "hpm_test_gpio.h"
+
+#define TEST_MMIO_NS 40U
+#define TEST_CORE_HZ 816000000U
+#define TEST_CPU_CALL_NS 60U
+#define TEST_BUF_SIZE (1024U * 1024U)
+#define TEST_COPY_SIZE 4096U
+#define TEST_QUEUE_NUM 5U
+#define TEST_CHAIN_NUM 16U
+#define TEST_HOOK_MAX 8U
+#define TEST_BENCH_MAX 16U
+#define TEST_CPU_MODELS 4U
+
+struct TestHookCall {
+    char op;
+    const void *addr;
+    uint32_t size;
+};
+
+static uint8_t g_src[TEST_BUF_SIZE] __attribute__((aligned(8)));
+static uint8_t g_dst[TEST_BUF_SIZE] __attribute__((aligned(8)));
+static uint32_t g_cpuPsPerByte = 1250;
+static uint32_t g_seed = 0x3E3C0F1EU;
+static struct TestHookCall g_hooks[TEST_HOOK_MAX];
+static uint32_t g_hookCount;
+static bool g_hookRecord;
+static uint64_t g_doneNs[TEST_QUEUE_NUM];
+static uint32_t g_chainLeft;
+
+void *__real_memcpy(void *dst, const void *src, size_t size);
+void *__real_memset(void *dst, int value, size_t size);
+
+/* The CPU copy model, only copies into the scratch buffer are charged */
+static void TestCpuCharge(const void *dst, size_t size)
+{
+    if (((const uint8_t *)dst >= g_dst) && ((const uint8_t *)dst < g_dst + TEST_BUF_SIZE)) {
+        HpmTestCpuNs(TEST_CPU_CALL_NS + ((uint64_t)size * g_cpuPsPerByte + 999U) / 1000U);
+    }
+}
+
+void *__wrap_memcpy(void *dst, const void *src, size_t size)
+{
+    TestCpuCharge(dst, size);
+    return __real_memcpy(dst, src, size);
+}
+
+void *__wrap_memset(void *dst, int value, size_t size)
+{
+    TestCpuCharge(dst, size);
+    return __real_memset(dst, value, size);
+}
+
+static void TestRecord(char op, const void *addr, uint32_t size)
+{
+    if (g_hookRecord && (g_hookCount < TEST_HOOK_MAX)) {
+        g_hooks[g_hookCount].op = op;
+        g_hooks[g_hookCount].addr = addr;
+        g_hooks[g_hookCount].size = size;
+        g_hookCount++;
+    }
+}
+
+static void TestWriteback(const void *addr, uint32_t size)
+{
+    TestRecord('w', addr, size);
+}
+
+static void TestInvalidate(const void *addr, uint32_t size)
+{
+    TestRecord('i', addr, size);
+}
+
+static const dma_mgr_memcpy_cache_ops_t g_cacheOps = {
+    .writeback = TestWriteback,
+    .invalidate = TestInvalidate,
+};
+
+static VOID TestDmaIsr(VOID *arg)
+{
+    dma_mgr_isr_handler((DMA_Type *)arg, 0);
+}
+
+static void TestFill(uint8_t *buf, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)HpmTestRand(&g_seed);
+    }
+}
+
+static uint64_t TestDmaBytes(void)
+{
+    uint64_t hdma;
+    uint64_t xdma;
+    uint32_t tc;
+
+    HpmTestDmaStats(0, &hdma, &tc);
+    HpmTestDmaStats(1, &xdma, &tc);
+    return hdma + xdma;
+}
+
+/* Source width of the channel whose source address ended at <srcEnd>, the channels count it up */
+static uint32_t TestLastWidth(const void *srcEnd)
+{
+    uint32_t addr = core_local_mem_to_sys_address(HPM_CORE0, (uint32_t)(uintptr_t)srcEnd);
+
+    for (uint32_t ch = 0; ch < DMA_SOC_CHANNEL_NUM; ch++) {
+        if (HPM_HDMA->CHCTRL[ch].SRCADDR == addr) {
+            return DMA_CHCTRL_CTRL_SRCWIDTH_GET(HPM_HDMA->CHCTRL[ch].CTRL);
+        }
+        if (HPM_XDMA->CHCTRL[ch].SRCADDR == addr) {
+            return DMA_CHCTRL_CTRL_SRCWIDTH_GET(HPM_XDMA->CHCTRL[ch].CTRL);
+        }
+    }
+    return UINT32_MAX;
+}
+
+/* Below the threshold, and before init, the copy is done in the calling context */
+static void TestRouting(void)
+{
+    static dma_mgr_memcpy_future_t future;
+    uint64_t bytes = TestDmaBytes();
+
+    TestFill(g_src, TEST_COPY_SIZE);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&future, g_dst, g_src, TEST_COPY_SIZE, NULL, NULL), status_success);
+    HPM_TEST_CHECK_EQ(future.status, status_success);
+    HPM_TEST_CHECK_EQ(memcmp(g_dst, g_src, TEST_COPY_SIZE), 0);
+    HPM_TEST_CHECK_EQ(TestDmaBytes(), bytes);
+
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_init(&g_cacheOps), status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_get_threshold(), DMA_MGR_MEMCPY_THRESHOLD_DEFAULT);
+    dma_mgr_memcpy_set_threshold(256);
+    TestFill(g_src, TEST_COPY_SIZE);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&future, g_dst, g_src, 255, NULL, NULL), status_success);
+    HPM_TEST_CHECK_EQ(future.status, status_success);
+    HPM_TEST_CHECK_EQ(TestDmaBytes(), bytes);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&future, g_dst, g_src, 256, NULL, NULL), status_success);
+    HPM_TEST_CHECK_EQ(future.status, status_dma_mgr_memcpy_pending);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_wait(&future), status_success);
+    HPM_TEST_CHECK_EQ(TestDmaBytes(), bytes + 256U);
+    HPM_TEST_CHECK_EQ(memcmp(g_dst, g_src, 256), 0);
+
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(NULL, g_dst, g_src, 256, NULL, NULL), status_invalid_argument);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&future, g_dst, NULL, 256, NULL, NULL), status_invalid_argument);
+    HPM_TEST_CHECK_EQ(dma_mgr_memset_async(&future, NULL, 0, 256, NULL, NULL), status_invalid_argument);
+}
+
+/* Sources and dst are written back before the transfer, dst is invalidated after it */
+static void TestCacheHooks(void)
+{
+    static dma_mgr_memcpy_future_t future;
+
+    dma_mgr_memcpy_set_threshold(0);
+    g_hookCount = 0;
+    g_hookRecord = true;
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&future, g_dst, g_src, 512, NULL, NULL), status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_wait(&future), status_success);
+    HPM_TEST_CHECK_EQ(g_hookCount, 3);
+    HPM_TEST_CHECK(g_hooks[0].op == 'w' && g_hooks[0].addr == g_src && g_hooks[0].size == 512U);
+    HPM_TEST_CHECK(g_hooks[1].op == 'w' && g_hooks[1].addr == g_dst && g_hooks[1].size == 512U);
+    HPM_TEST_CHECK(g_hooks[2].op == 'i' && g_hooks[2].addr == g_dst && g_hooks[2].size == 512U);
+
+    g_hookCount = 0;
+    HPM_TEST_CHECK_EQ(dma_mgr_memset_async(&future, g_dst, 0x5A, 512, NULL, NULL), status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_wait(&future), status_success);
+    HPM_TEST_CHECK_EQ(g_hookCount, 3);
+    HPM_TEST_CHECK(g_hooks[0].op == 'w' && g_hooks[0].addr == &future.pattern && g_hooks[0].size == 4U);
+    HPM_TEST_CHECK(g_hooks[1].op == 'w' && g_hooks[1].addr == g_dst);
+    HPM_TEST_CHECK(g_hooks[2].op == 'i' && g_hooks[2].addr == g_dst);
+
+    /* the CPU path leaves the cache alone */
+    g_hookCount = 0;
+    dma_mgr_memcpy_set_threshold(1024);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&future, g_dst, g_src, 512, NULL, NULL), status_success);
+    HPM_TEST_CHECK_EQ(g_hookCount, 0);
+    g_hookRecord = false;
+}
+
+/* The widest width both addresses and the size are aligned to, HDMA moves words at most */
+static void TestWidths(void)
+{
+    static const struct {
+        uint32_t offset;
+        uint32_t size;
+        uint32_t width;
+    } cases[] = {
+        { 0, 1024, DMA_MGR_TRANSFER_WIDTH_WORD },
+        { 4, 1020, DMA_MGR_TRANSFER_WIDTH_WORD },
+        { 2, 1022, DMA_MGR_TRANSFER_WIDTH_HALF_WORD },
+        { 0, 1022, DMA_MGR_TRANSFER_WIDTH_HALF_WORD },
+        { 1, 1021, DMA_MGR_TRANSFER_WIDTH_BYTE },
+        { 0, 1023, DMA_MGR_TRANSFER_WIDTH_BYTE },
+    };
+    static dma_mgr_memcpy_future_t future;
+
+    dma_mgr_memcpy_set_threshold(0);
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        TestFill(g_src, 2048);
+        (void)memset(g_dst, 0xA5, 2048);
+        HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&future, &g_dst[cases[i].offset], &g_src[cases[i].offset],
+                                               cases[i].size, NULL, NULL), status_success);
+        HPM_TEST_CHECK_EQ(dma_mgr_memcpy_wait(&future), status_success);
+        HPM_TEST_CHECK_EQ(TestLastWidth(&g_src[cases[i].offset + cases[i].size]), cases[i].width);
+        HPM_TEST_CHECK_EQ(memcmp(&g_dst[cases[i].offset], &g_src[cases[i].offset], cases[i].size), 0);
+        HPM_TEST_CHECK(cases[i].offset == 0 || g_dst[cases[i].offset - 1U] == 0xA5);
+        HPM_TEST_CHECK_EQ(g_dst[cases[i].offset + cases[i].size], 0xA5);
+    }
+}
+
+/* An odd sized fill at an odd address stops at its bounds */
+static void TestMemset(void)
+{
+    static dma_mgr_memcpy_future_t future;
+    bool ok = true;
+
+    dma_mgr_memcpy_set_threshold(0);
+    (void)memset(g_dst, 0xA5, 2048);
+    HPM_TEST_CHECK_EQ(dma_mgr_memset_async(&future, &g_dst[3], 0x3C, 1001, NULL, NULL), status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_wait(&future), status_success);
+    for (uint32_t i = 0; i < 2048U; i++) {
+        ok = ok && (g_dst[i] == (((i >= 3U) && (i < 1004U)) ? 0x3C : 0xA5));
+    }
+    HPM_TEST_CHECK(ok);
+
+    HPM_TEST_CHECK_EQ(dma_mgr_memset_async(&future, &g_dst[4], 0x00, 1000, NULL, NULL), status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_wait(&future), status_success);
+    HPM_TEST_CHECK_EQ(TestLastWidth(&future.pattern), DMA_MGR_TRANSFER_WIDTH_WORD);
+    HPM_TEST_CHECK_EQ(g_dst[3], 0x3C);
+    HPM_TEST_CHECK_EQ(g_dst[4], 0x00);
+    HPM_TEST_CHECK_EQ(g_dst[1003], 0x00);
+    HPM_TEST_CHECK_EQ(g_dst[1004], 0xA5);
+}
+
+static void TestQueueDone(dma_mgr_memcpy_future_t *future, void *userData)
+{
+    (void)future;
+    g_doneNs[(uintptr_t)userData] = HpmTestNowNs();
+}
+
+/* More requests than channels queue, and complete in rounds of DMA_MGR_MEMCPY_CHANNEL_NUM */
+static void TestQueue(void)
+{
+    static dma_mgr_memcpy_future_t futures[TEST_QUEUE_NUM];
+    uint64_t start;
+    uint64_t single;
+
+    dma_mgr_memcpy_set_threshold(0);
+    TestFill(g_src, TEST_QUEUE_NUM * TEST_COPY_SIZE);
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&futures[0], g_dst, g_src, TEST_COPY_SIZE, TestQueueDone, (void *)0),
+                      status_success);
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_wait(&futures[0]), status_success);
+    single = g_doneNs[0] - start;
+
+    start = HpmTestNowNs();
+    for (uintptr_t i = 0; i < TEST_QUEUE_NUM; i++) {
+        HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&futures[i], &g_dst[i * TEST_COPY_SIZE], &g_src[i * TEST_COPY_SIZE],
+                                               TEST_COPY_SIZE, TestQueueDone, (void *)i), status_success);
+    }
+    for (uint32_t i = 0; i < TEST_QUEUE_NUM; i++) {
+        HPM_TEST_CHECK_EQ(dma_mgr_memcpy_wait(&futures[i]), status_success);
+        HPM_TEST_CHECK((i == 0) || (g_doneNs[i] >= g_doneNs[i - 1U]));
+    }
+    HPM_TEST_CHECK_EQ(memcmp(g_dst, g_src, TEST_QUEUE_NUM * TEST_COPY_SIZE), 0);
+    /* the model runs the channels side by side, each round takes one copy time */
+    uint32_t rounds = (TEST_QUEUE_NUM + DMA_MGR_MEMCPY_CHANNEL_NUM - 1U) / DMA_MGR_MEMCPY_CHANNEL_NUM;
+    printf("queue: %u copies of %u bytes on %u channels in %llu ns, one copy %llu ns\n", TEST_QUEUE_NUM,
+           TEST_COPY_SIZE, DMA_MGR_MEMCPY_CHANNEL_NUM, (unsigned long long)(g_doneNs[TEST_QUEUE_NUM - 1U] - start),
+           (unsigned long long)single);
+    HPM_TEST_CHECK(g_doneNs[TEST_QUEUE_NUM - 1U] - start > (uint64_t)(rounds - 1U) * single);
+    HPM_TEST_CHECK(g_doneNs[TEST_QUEUE_NUM - 1U] - start <= (uint64_t)rounds * single + single / 4U);
+    HPM_TEST_CHECK(g_doneNs[DMA_MGR_MEMCPY_CHANNEL_NUM - 1U] - start <= single + single / 4U);
+}
+
+/* Each completion submits the next piece with the same future */
+static void TestChainDone(dma_mgr_memcpy_future_t *future, void *userData)
+{
+    uint32_t index;
+
+    (void)userData;
+    if (g_chainLeft == 0U) {
+        return;
+    }
+    index = TEST_CHAIN_NUM - g_chainLeft;
+    g_chainLeft--;
+    (void)dma_mgr_memcpy_async(future, &g_dst[index * TEST_COPY_SIZE], &g_src[index * TEST_COPY_SIZE], TEST_COPY_SIZE,
+                               TestChainDone, NULL);
+}
+
+static void TestResubmit(void)
+{
+    static dma_mgr_memcpy_future_t future;
+
+    dma_mgr_memcpy_set_threshold(0);
+    TestFill(g_src, TEST_CHAIN_NUM * TEST_COPY_SIZE);
+    (void)memset(g_dst, 0, TEST_CHAIN_NUM * TEST_COPY_SIZE);
+    g_chainLeft = TEST_CHAIN_NUM - 1U;
+    HPM_TEST_CHECK_EQ(dma_mgr_memcpy_async(&future, g_dst, g_src, TEST_COPY_SIZE, TestChainDone, NULL), status_success);
+    while ((g_chainLeft != 0U) || !dma_mgr_memcpy_is_done(&future)) {
+        WFI();
+    }
+    HPM_TEST_CHECK_EQ(future.status, status_success);
+    HPM_TEST_CHECK_EQ(memcmp(g_dst, g_src, TEST_CHAIN_NUM * TEST_COPY_SIZE), 0);
+}
+
+static double TestMBps(uint32_t size, uint32_t cycles)
+{
+    return (double)size * TEST_CORE_HZ / 1e6 / (double)cycles;
+}
+
+/* Calibrate from 64 bytes to 1 MB, the crossover moves with the CPU copy rate */
+static void TestCalibrate(void)
+{
+    static const uint32_t cpuPsPerByte[TEST_CPU_MODELS] = { 1250, 2500, 5000, 10000 };
+    static dma_mgr_memcpy_bench_t bench[TEST_CPU_MODELS][TEST_BENCH_MAX];
+    uint32_t threshold[TEST_CPU_MODELS];
+    uint32_t count = 0;
+
+    TestFill(g_src, TEST_BUF_SIZE);
+    for (uint32_t m = 0; m < TEST_CPU_MODELS; m++) {
+        g_cpuPsPerByte = cpuPsPerByte[m];
+        dma_mgr_memcpy_set_threshold(DMA_MGR_MEMCPY_THRESHOLD_DEFAULT);
+        threshold[m] = dma_mgr_memcpy_calibrate(g_dst, g_src, TEST_BUF_SIZE, bench[m], TEST_BENCH_MAX);
+        HPM_TEST_CHECK_EQ(memcmp(g_dst, g_src, TEST_BUF_SIZE), 0);
+        HPM_TEST_CHECK_EQ(dma_mgr_memcpy_get_threshold(), threshold[m]);
+
+        uint32_t crossover = 0;
+        for (count = 0; (count < TEST_BENCH_MAX) && (bench[m][count].size != 0U); count++) {
+            HPM_TEST_CHECK_EQ(bench[m][count].size, 64U << count);
+            if ((crossover == 0U) && (bench[m][count].dma_cycles <= bench[m][count].cpu_cycles)) {
+                crossover = bench[m][count].size;
+            }
+        }
+        HPM_TEST_CHECK_EQ(bench[m][count - 1U].size, TEST_BUF_SIZE);
+        HPM_TEST_CHECK_EQ(threshold[m], (crossover != 0U) ? crossover : DMA_MGR_MEMCPY_THRESHOLD_DEFAULT);
+    }
+    /* at 1 and 2 bytes per 2.5 ns the CPU always wins, slower CPU copies hand over to the DMA */
+    HPM_TEST_CHECK_EQ(threshold[0], DMA_MGR_MEMCPY_THRESHOLD_DEFAULT);
+    HPM_TEST_CHECK_EQ(threshold[1], DMA_MGR_MEMCPY_THRESHOLD_DEFAULT);
+    HPM_TEST_CHECK(threshold[2] > threshold[3]);
+
+    printf("calibrate, dma 2.5 ns per byte, %u ns per register access, cpu copy %u ns per call\n", TEST_MMIO_NS,
+           TEST_CPU_CALL_NS);
+    printf("  %8s %9s", "size", "dma MB/s");
+    for (uint32_t m = 0; m < TEST_CPU_MODELS; m++) {
+        printf("   cpu %5.2f ns/B", cpuPsPerByte[m] / 1000.0);
+    }
+    printf("\n");
+    for (uint32_t i = 0; i < count; i++) {
+        printf("  %8u %9.1f", bench[0][i].size, TestMBps(bench[0][i].size, bench[0][i].dma_cycles));
+        for (uint32_t m = 0; m < TEST_CPU_MODELS; m++) {
+            printf(" %16.1f", TestMBps(bench[m][i].size, bench[m][i].cpu_cycles));
+        }
+        printf("\n");
+    }
+    printf("  %8s %9s", "threshold", "");
+    for (uint32_t m = 0; m < TEST_CPU_MODELS; m++) {
+        printf(" %16u", threshold[m]);
+    }
+    printf("\n");
+}
+
+int main(void)
+{
+    HwiIrqParam hdmaParam = { .pDevId = HPM_HDMA };
+    HwiIrqParam xdmaParam = { .pDevId = HPM_XDMA };
+
+    HpmTestVirtualTime(true);
+    HpmTestMmioCostNs(TEST_MMIO_NS);
+    HpmTestMchtmrInit(TEST_CORE_HZ);
+    HpmTestDmaModelInit();
+    dma_mgr_init();
+    HPM_TEST_CHECK_EQ(LOS_HwiCreate(HPM2LITEOS_IRQ(IRQn_HDMA), 1, 0, (HWI_PROC_FUNC)TestDmaIsr, &hdmaParam),
+                      LOS_OK);
+    HPM_TEST_CHECK_EQ(LOS_HwiCreate(HPM2LITEOS_IRQ(IRQn_XDMA), 1, 0, (HWI_PROC_FUNC)TestDmaIsr, &xdmaParam),
+                      LOS_OK);
+    HPM_TEST_CHECK_EQ(LOS_HwiEnable(HPM2LITEOS_IRQ(IRQn_HDMA)), LOS_OK);
+    HPM_TEST_CHECK_EQ(LOS_HwiEnable(HPM2LITEOS_IRQ(IRQn_XDMA)), LOS_OK);
+
+    TestRouting();
+    TestCacheHooks();
+    TestWidths();
+    TestMemset();
+    TestQueue();
+    TestResubmit();
+    TestCalibrate();
+
+    (void)LOS_HwiDelete(HPM2LITEOS_IRQ(IRQn_HDMA), NULL);
+    (void)LOS_HwiDelete(HPM2LITEOS_IRQ(IRQn_XDMA), NULL);
+    HpmTestDmaModelDeinit();
+    return HpmTestResult();
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* The eeprom emulation only carries the port config around, the tests pass flash callbacks */
+
+#ifndef HPM_NOR_FLASH_H
+#define HPM_NOR_FLASH_H
+
+#include <stdint.h>
+#include "hpm_common.h"
+
+typedef struct {
+    uint32_t base_addr;
+    uint32_t sector_size;
+} nor_flash_config_t;
+
+#endif
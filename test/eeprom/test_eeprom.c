@@ -0,0 +1,882 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * sdk/hpm_sdk/components/eeprom_emulation on the NOR flash model: the cost of
+ * a lookup from 10 to 1000 variables, ids that all hash to the same slot, the
+ * variable limit, instances with their own index storage, random writes
+ * across many sector roll overs checked against a shadow copy after every
+ * reboot, sector headers torn at each of their fields, the sequence number
+ * running over 2^32, a version change, a power cut at every flash operation
+ * of a run of writes with compaction and of a batch write, what a batch
+ * saves in program operations, and the write latency and wear spread on a
+ * flash with real erase and program times.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "eeprom_emulation.h"
+#include "hpm_test.h"
+#include "hpm_test_nor.h"
+
+#define TEST_BASE 0x80080000U
+#define TEST_SECTOR 4096U
+#define TEST_PAGE 256U
+#define TEST_SECTOR_CNT 8U
+#define TEST_AREA (TEST_SECTOR * TEST_SECTOR_CNT)
+#define TEST_VERSION 0x4553U
+#define TEST_VAR_CNT 24U
+#define TEST_VAR_MAX 48U
+#define TEST_STEP_WRITES 24U
+#define TEST_LOOKUP_MAX 1000U
+#define TEST_LOOKUP_ROUNDS 20U
+#define TEST_COLLIDE_VARS 32U
+#define TEST_COLLIDE_IDS 24U
+#define TEST_LIMIT_VARS 16U
+#define TEST_WEAR_VARS 20U
+#define TEST_WEAR_MIN 4U
+#define TEST_WEAR_MAX 64U
+#define TEST_ERASE_NS 45000000ULL
+#define TEST_PAGE_NS 600000ULL
+#define TEST_BATCH_CNT 8U
+#define TEST_TORN_STEP 7U
+
+struct TestVars {
+    bool has[TEST_VAR_CNT];
+    uint16_t len[TEST_VAR_CNT];
+    uint8_t data[TEST_VAR_CNT][TEST_VAR_MAX];
+};
+
+struct TestWrite {
+    uint32_t var;
+    uint16_t len;
+    uint8_t data[TEST_VAR_MAX];
+};
+
+static struct HpmTestNor g_nor;
+static uint32_t g_table[E2P_TABLE_SIZE(TEST_LOOKUP_MAX) / sizeof(uint32_t) + 1];
+static uint32_t g_table2[E2P_TABLE_SIZE(TEST_LIMIT_VARS) / sizeof(uint32_t) + 1];
+static e2p_t g_e2p;
+static e2p_t g_e2p2;
+static struct TestVars g_vars;
+static uint8_t g_snapshot[TEST_AREA];
+static uint32_t g_seed = 0x0E2B5EEDU;
+
+/* Like the ROM api every call returns once the chip is idle again */
+static uint32_t TestFlashRead(uint8_t *buf, uint32_t addr, uint32_t size)
+{
+    return (uint32_t)HpmTestNorRead(&g_nor, addr - TEST_BASE, buf, size);
+}
+
+/* The ROM api splits programs at page boundaries the same way */
+static uint32_t TestFlashWrite(uint8_t *buf, uint32_t addr, uint32_t size)
+{
+    addr -= TEST_BASE;
+    while (size > 0) {
+        uint32_t len = TEST_PAGE - (addr % TEST_PAGE);
+        len = (len < size) ? len : size;
+        if (HpmTestNorProgram(&g_nor, addr, buf, len) != 0) {
+            return E2P_ERROR;
+        }
+        HpmTestNorWait(&g_nor);
+        addr += len;
+        buf += len;
+        size -= len;
+    }
+    return E2P_STATUS_OK;
+}
+
+static void TestFlashErase(uint32_t addr, uint32_t size)
+{
+    for (uint32_t off = 0; off < size; off += TEST_SECTOR) {
+        (void)HpmTestNorErase(&g_nor, addr - TEST_BASE + off);
+        HpmTestNorWait(&g_nor);
+    }
+}
+
+/* A fresh instance on <sectorCnt> sectors from area <area> over whatever the flash holds, as after a reset */
+static hpm_stat_t TestBootAs(e2p_t *e2p, uint32_t area, uint32_t sectorCnt, uint32_t version, void *table,
+                             uint32_t maxVarCnt)
+{
+    (void)memset(e2p, 0, sizeof(*e2p));
+    e2p->config.start_addr = TEST_BASE + area * TEST_AREA;
+    e2p->config.sector_cnt = sectorCnt;
+    e2p->config.erase_size = TEST_SECTOR;
+    e2p->config.version = version;
+    e2p->config.flash_read = TestFlashRead;
+    e2p->config.flash_write = TestFlashWrite;
+    e2p->config.flash_erase = TestFlashErase;
+    e2p->config.table = table;
+    e2p->config.max_var_cnt = maxVarCnt;
+    return e2p_config(e2p);
+}
+
+static hpm_stat_t TestBoot(uint32_t version)
+{
+    return TestBootAs(&g_e2p, 0, TEST_SECTOR_CNT, version, g_table, TEST_VAR_CNT);
+}
+
+static hpm_stat_t TestBootVars(uint32_t maxVarCnt)
+{
+    return TestBootAs(&g_e2p, 0, TEST_SECTOR_CNT, TEST_VERSION, g_table, maxVarCnt);
+}
+
+static void TestErase(void)
+{
+    HpmTestNorPowerOn(&g_nor);
+    (void)memset(g_nor.mem, 0xFF, g_nor.size);
+}
+
+static uint32_t TestVarId(uint32_t var)
+{
+    return 0x56410000U + var;
+}
+
+static void TestRandomWrite(uint32_t *seed, struct TestWrite *w)
+{
+    w->var = HpmTestRand(seed) % TEST_VAR_CNT;
+    w->len = (uint16_t)(1 + HpmTestRand(seed) % TEST_VAR_MAX);
+    for (uint32_t i = 0; i < w->len; i++) {
+        w->data[i] = (uint8_t)HpmTestRand(seed);
+    }
+}
+
+static void TestApply(struct TestVars *vars, const struct TestWrite *w)
+{
+    vars->has[w->var] = true;
+    vars->len[w->var] = w->len;
+    (void)memcpy(vars->data[w->var], w->data, w->len);
+}
+
+/* Write and keep the free sectors topped up as an idle loop would */
+static hpm_stat_t TestWrite(const struct TestWrite *w)
+{
+    hpm_stat_t ret = e2p_write(&g_e2p, TestVarId(w->var), w->len, (uint8_t *)w->data);
+
+    if (ret == E2P_STATUS_OK) {
+        ret = e2p_idle(&g_e2p);
+    }
+    return ret;
+}
+
+/* What the instance returns for every variable is exactly <vars>, nothing past the length is written */
+static bool TestMatches(const struct TestVars *vars)
+{
+    uint8_t buf[TEST_VAR_MAX + 1];
+
+    for (uint32_t var = 0; var < TEST_VAR_CNT; var++) {
+        (void)memset(buf, 0xA5, sizeof(buf));
+        hpm_stat_t ret = e2p_read(&g_e2p, TestVarId(var), TEST_VAR_MAX, buf);
+        if (!vars->has[var]) {
+            if (ret != E2P_ERROR_BAD_ID) {
+                return false;
+            }
+            continue;
+        }
+        if ((ret != E2P_STATUS_OK) || (memcmp(buf, vars->data[var], vars->len[var]) != 0) ||
+            ((vars->len[var] < TEST_VAR_MAX) && (buf[vars->len[var]] != 0xA5))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestFormat(void)
+{
+    TestErase();
+    (void)memset(&g_vars, 0, sizeof(g_vars));
+    HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+}
+
+static void TestHdr(uint32_t sector, e2p_sector_hdr *hdr)
+{
+    (void)memcpy(hdr, &g_nor.mem[sector * TEST_SECTOR], sizeof(*hdr));
+}
+
+/* The index hash of eeprom_emulation.c, to find where an id starts probing */
+static uint32_t TestHash(uint32_t blockId)
+{
+    uint32_t h = blockId * 0x9E3779B1U;
+
+    return h ^ (h >> 16);
+}
+
+/* Slots looked at to find <blockId>, or to learn it is not there */
+static uint32_t TestProbes(const e2p_t *e2p, uint32_t blockId)
+{
+    uint32_t pos = TestHash(blockId) & e2p->slot_mask;
+    uint32_t probes = 1;
+
+    while ((e2p->slot[pos] != 0) && (e2p->table[e2p->slot[pos] - 1].block_id != blockId)) {
+        pos = (pos + 1) & e2p->slot_mask;
+        probes++;
+    }
+    return probes;
+}
+
+static bool TestReadVar(e2p_t *e2p, uint32_t blockId, uint32_t value)
+{
+    uint32_t data = ~value;
+
+    return (e2p_read(e2p, blockId, sizeof(data), (uint8_t *)&data) == E2P_STATUS_OK) && (data == value);
+}
+
+/* 1000 variables of 4 bytes take more than the live data one area holds */
+static hpm_stat_t TestBootLookup(uint32_t maxVarCnt)
+{
+    return TestBootAs(&g_e2p, 0, 2 * TEST_SECTOR_CNT, TEST_VERSION, g_table, maxVarCnt);
+}
+
+/*
+ * Read and miss cost with 10 to 1000 variables. The probes are counted on the
+ * index, the time is host time per e2p_read and includes the flash read and
+ * crc of a hit.
+ */
+static void TestEepromLookup(void)
+{
+    static const uint32_t counts[] = { 10, 100, 1000 };
+
+    printf("lookup, %u rounds over every variable, host ns per e2p_read\n", TEST_LOOKUP_ROUNDS);
+    printf("   vars  slots  hit probes avg/max  miss probes avg/max  hit ns  miss ns\n");
+    for (uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint32_t n = counts[c];
+        uint32_t hitSum = 0;
+        uint32_t hitMax = 0;
+        uint32_t missSum = 0;
+        uint32_t missMax = 0;
+        bool ok = true;
+
+        TestErase();
+        HPM_TEST_CHECK_EQ(TestBootLookup(n), E2P_STATUS_OK);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t value = i * 7;
+            ok = ok && HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, TestVarId(i), sizeof(value), (uint8_t *)&value),
+                                         E2P_STATUS_OK);
+        }
+        HPM_TEST_CHECK_EQ(g_e2p.var_cnt, n);
+        /* the index built at boot finds the same variables */
+        HPM_TEST_CHECK_EQ(TestBootLookup(n), E2P_STATUS_OK);
+        HPM_TEST_CHECK_EQ(g_e2p.var_cnt, n);
+
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t hit = TestProbes(&g_e2p, TestVarId(i));
+            uint32_t miss = TestProbes(&g_e2p, TestVarId(n + i));
+            hitSum += hit;
+            missSum += miss;
+            hitMax = (hit > hitMax) ? hit : hitMax;
+            missMax = (miss > missMax) ? miss : missMax;
+        }
+
+        uint64_t start = HpmTestHostNs();
+        for (uint32_t r = 0; r < TEST_LOOKUP_ROUNDS; r++) {
+            for (uint32_t i = 0; i < n; i++) {
+                ok = ok && HPM_TEST_CHECK(TestReadVar(&g_e2p, TestVarId(i), i * 7));
+            }
+        }
+        uint64_t hitNs = (HpmTestHostNs() - start) / (TEST_LOOKUP_ROUNDS * n);
+        uint8_t byte;
+        start = HpmTestHostNs();
+        for (uint32_t r = 0; r < TEST_LOOKUP_ROUNDS; r++) {
+            for (uint32_t i = 0; i < n; i++) {
+                ok = ok && HPM_TEST_CHECK_EQ(e2p_read(&g_e2p, TestVarId(n + i), 1, &byte), E2P_ERROR_BAD_ID);
+            }
+        }
+        uint64_t missNs = (HpmTestHostNs() - start) / (TEST_LOOKUP_ROUNDS * n);
+
+        printf("  %5u  %5u        %5.2f/%-3u           %5.2f/%-3u  %6llu  %7llu\n", n, g_e2p.slot_mask + 1,
+               (double)hitSum / n, hitMax, (double)missSum / n, missMax, (unsigned long long)hitNs,
+               (unsigned long long)missNs);
+        /* load factor at most 1/2: linear probing averages 1.5 probes on a hit, 2.5 on a miss */
+        HPM_TEST_CHECK(hitSum <= 2 * n);
+        HPM_TEST_CHECK(missSum <= 4 * n);
+    }
+}
+
+/*
+ * Ids that all start probing at the last slot, so the chain wraps to slot 0:
+ * each one is still found, updated and told apart from a missing one.
+ */
+static void TestEepromCollisions(void)
+{
+    uint32_t ids[TEST_COLLIDE_IDS + 1];
+    uint32_t found = 0;
+    uint32_t maxProbes = 0;
+
+    TestErase();
+    HPM_TEST_CHECK_EQ(TestBootVars(TEST_COLLIDE_VARS), E2P_STATUS_OK);
+    for (uint32_t id = 0x434F0000U; found < TEST_COLLIDE_IDS + 1; id++) {
+        if ((TestHash(id) & g_e2p.slot_mask) == g_e2p.slot_mask) {
+            ids[found++] = id;
+        }
+    }
+
+    for (uint32_t i = 0; i < TEST_COLLIDE_IDS; i++) {
+        HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, ids[i], sizeof(i), (uint8_t *)&i), E2P_STATUS_OK);
+    }
+    for (uint32_t i = 0; i < TEST_COLLIDE_IDS; i++) {
+        uint32_t probes = TestProbes(&g_e2p, ids[i]);
+        maxProbes = (probes > maxProbes) ? probes : maxProbes;
+        HPM_TEST_CHECK(TestReadVar(&g_e2p, ids[i], i));
+    }
+    HPM_TEST_CHECK_EQ(maxProbes, TEST_COLLIDE_IDS);
+    HPM_TEST_CHECK_EQ(TestProbes(&g_e2p, ids[TEST_COLLIDE_IDS]), TEST_COLLIDE_IDS + 1);
+    uint8_t byte;
+    HPM_TEST_CHECK_EQ(e2p_read(&g_e2p, ids[TEST_COLLIDE_IDS], 1, &byte), E2P_ERROR_BAD_ID);
+
+    /* updates land on the existing entries, down the chain and after a reboot */
+    for (uint32_t i = 0; i < TEST_COLLIDE_IDS; i += 2) {
+        uint32_t value = i + 100;
+        HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, ids[i], sizeof(value), (uint8_t *)&value), E2P_STATUS_OK);
+    }
+    HPM_TEST_CHECK_EQ(g_e2p.var_cnt, TEST_COLLIDE_IDS);
+    HPM_TEST_CHECK_EQ(e2p_flush(&g_e2p, E2P_FLUSH_BEGIN), E2P_STATUS_OK);
+    HPM_TEST_CHECK_EQ(TestBootVars(TEST_COLLIDE_VARS), E2P_STATUS_OK);
+    HPM_TEST_CHECK_EQ(g_e2p.var_cnt, TEST_COLLIDE_IDS);
+    for (uint32_t i = 0; i < TEST_COLLIDE_IDS; i++) {
+        HPM_TEST_CHECK(TestReadVar(&g_e2p, ids[i], ((i % 2) == 0) ? i + 100 : i));
+    }
+    printf("collisions, %u ids on the last of %u slots, longest probe %u\n", TEST_COLLIDE_IDS,
+           g_e2p.slot_mask + 1, maxProbes);
+}
+
+/* A full index refuses new variables, keeps taking updates and still boots */
+static void TestEepromVarLimit(void)
+{
+    uint32_t value = 0x1234;
+
+    TestErase();
+    HPM_TEST_CHECK_EQ(TestBootVars(TEST_LIMIT_VARS), E2P_STATUS_OK);
+    for (uint32_t i = 0; i < TEST_LIMIT_VARS; i++) {
+        HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, TestVarId(i), sizeof(i), (uint8_t *)&i), E2P_STATUS_OK);
+    }
+    HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, TestVarId(TEST_LIMIT_VARS), sizeof(value), (uint8_t *)&value),
+                      E2P_ERROR_MUL_VAR);
+    HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, TestVarId(3), sizeof(value), (uint8_t *)&value), E2P_STATUS_OK);
+    HPM_TEST_CHECK(TestReadVar(&g_e2p, TestVarId(3), value));
+
+    HPM_TEST_CHECK_EQ(TestBootVars(TEST_LIMIT_VARS), E2P_STATUS_OK);
+    HPM_TEST_CHECK_EQ(g_e2p.var_cnt, TEST_LIMIT_VARS);
+    HPM_TEST_CHECK(TestReadVar(&g_e2p, TestVarId(3), value));
+    HPM_TEST_CHECK_EQ(e2p_read(&g_e2p, TestVarId(TEST_LIMIT_VARS), sizeof(value), (uint8_t *)&value),
+                      E2P_ERROR_BAD_ID);
+
+    /* the same flash with a smaller index cannot hold the variables */
+    HPM_TEST_CHECK_EQ(TestBootVars(TEST_LIMIT_VARS - 1), E2P_ERROR_MUL_VAR);
+}
+
+/* Two instances with their own tables keep the same ids apart */
+static void TestEepromOwnTables(void)
+{
+    TestErase();
+    HPM_TEST_CHECK_EQ(TestBootAs(&g_e2p, 0, TEST_SECTOR_CNT, TEST_VERSION, g_table, 40), E2P_STATUS_OK);
+    HPM_TEST_CHECK_EQ(TestBootAs(&g_e2p2, 1, TEST_SECTOR_CNT, TEST_VERSION, g_table2, TEST_LIMIT_VARS), E2P_STATUS_OK);
+    for (uint32_t i = 0; i < TEST_LIMIT_VARS; i++) {
+        uint32_t other = i + 1000;
+        HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, TestVarId(i), sizeof(i), (uint8_t *)&i), E2P_STATUS_OK);
+        HPM_TEST_CHECK_EQ(e2p_write(&g_e2p2, TestVarId(i), sizeof(other), (uint8_t *)&other), E2P_STATUS_OK);
+    }
+    HPM_TEST_CHECK_EQ(TestBootAs(&g_e2p2, 1, TEST_SECTOR_CNT, TEST_VERSION, g_table2, TEST_LIMIT_VARS), E2P_STATUS_OK);
+    for (uint32_t i = 0; i < TEST_LIMIT_VARS; i++) {
+        HPM_TEST_CHECK(TestReadVar(&g_e2p, TestVarId(i), i));
+        HPM_TEST_CHECK(TestReadVar(&g_e2p2, TestVarId(i), i + 1000));
+    }
+    HPM_TEST_CHECK(g_e2p.table == (e2p_block *)g_table);
+    HPM_TEST_CHECK(g_e2p2.table == (e2p_block *)g_table2);
+}
+
+/* The internal table belongs to the first instance configured without one */
+static void TestEepromDefaultTable(void)
+{
+    static e2p_t owner;
+    static e2p_t other;
+
+    TestErase();
+    HPM_TEST_CHECK_EQ(TestBootAs(&owner, 0, TEST_SECTOR_CNT, TEST_VERSION, NULL, E2P_MAX_VAR_CNT + 1), E2P_ERROR_INIT_ERR);
+    HPM_TEST_CHECK_EQ(TestBootAs(&owner, 0, TEST_SECTOR_CNT, TEST_VERSION, NULL, 0), E2P_STATUS_OK);
+    HPM_TEST_CHECK_EQ(owner.var_max, E2P_MAX_VAR_CNT);
+    HPM_TEST_CHECK_EQ(TestBootAs(&other, 1, TEST_SECTOR_CNT, TEST_VERSION, NULL, 0), E2P_ERROR_INIT_ERR);
+    /* the owner can configure again, the other instance gets going with its own table */
+    HPM_TEST_CHECK_EQ(TestBootAs(&owner, 0, TEST_SECTOR_CNT, TEST_VERSION, NULL, 0), E2P_STATUS_OK);
+    HPM_TEST_CHECK_EQ(TestBootAs(&other, 1, TEST_SECTOR_CNT, TEST_VERSION, g_table2, TEST_LIMIT_VARS), E2P_STATUS_OK);
+
+    uint32_t value = 77;
+    HPM_TEST_CHECK_EQ(e2p_write(&owner, TestVarId(0), sizeof(value), (uint8_t *)&value), E2P_STATUS_OK);
+    HPM_TEST_CHECK(TestReadVar(&owner, TestVarId(0), value));
+    HPM_TEST_CHECK_EQ(e2p_read(&other, TestVarId(0), sizeof(value), (uint8_t *)&value), E2P_ERROR_BAD_ID);
+}
+
+/* Random writes with a reboot now and then, the ring goes round several times */
+static void TestEepromRandom(void)
+{
+    struct TestWrite w;
+    uint32_t writes = HpmTestFull() ? 20000U : 2000U;
+    bool ok = true;
+
+    TestFormat();
+    for (uint32_t i = 0; (i < writes) && ok; i++) {
+        TestRandomWrite(&g_seed, &w);
+        ok = HPM_TEST_CHECK_EQ(TestWrite(&w), E2P_STATUS_OK);
+        TestApply(&g_vars, &w);
+        if ((i % 97) == 0) {
+            ok = ok && HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+            ok = ok && HPM_TEST_CHECK(TestMatches(&g_vars));
+        }
+    }
+    HPM_TEST_CHECK(TestMatches(&g_vars));
+    HPM_TEST_CHECK(g_nor.erases > 2 * TEST_SECTOR_CNT);
+    HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+    HPM_TEST_CHECK(TestMatches(&g_vars));
+}
+
+/* Fill part of a sector, then reboot until the data and the ring are intact again */
+static void TestEepromFill(void)
+{
+    struct TestWrite w;
+
+    TestFormat();
+    for (uint32_t i = 0; i < 3 * TEST_VAR_CNT; i++) {
+        TestRandomWrite(&g_seed, &w);
+        HPM_TEST_CHECK_EQ(TestWrite(&w), E2P_STATUS_OK);
+        TestApply(&g_vars, &w);
+    }
+}
+
+/*
+ * A free sector whose header got only part of the way, each one must be
+ * recycled on the next boot without touching the data or the ring
+ */
+static void TestEepromTornHeader(void)
+{
+    static const struct {
+        const char *name;
+        e2p_sector_hdr hdr;
+    } torn[] = {
+        { "magic only", { E2P_MAGIC_ID, E2P_EARSED_ID, E2P_EARSED_ID, E2P_EARSED_ID, E2P_EARSED_ID } },
+        { "blank erase count", { E2P_MAGIC_ID, TEST_VERSION, E2P_EARSED_ID, E2P_EARSED_ID, E2P_EARSED_ID } },
+        { "other version, blank erase count", { E2P_MAGIC_ID, TEST_VERSION + 1, E2P_EARSED_ID, E2P_EARSED_ID, E2P_EARSED_ID } },
+        { "no magic", { E2P_EARSED_ID, TEST_VERSION, 7, E2P_EARSED_ID, E2P_EARSED_ID } },
+        { "half of the magic", { 0xFFFF4D43U, TEST_VERSION, 7, E2P_EARSED_ID, E2P_EARSED_ID } },
+        { "seq without check", { E2P_MAGIC_ID, TEST_VERSION, 7, 0x00000002U, E2P_EARSED_ID } },
+        { "half of the seq", { E2P_MAGIC_ID, TEST_VERSION, 7, 0xFFFF0002U, E2P_EARSED_ID } },
+        { "half of the check", { E2P_MAGIC_ID, TEST_VERSION, 7, 0x00010002U, 0xFFFFFFFDU } },
+    };
+    e2p_sector_hdr hdr;
+
+    for (uint32_t t = 0; t < sizeof(torn) / sizeof(torn[0]); t++) {
+        TestEepromFill();
+        uint32_t seq = g_e2p.seq;
+        uint32_t sector = (g_e2p.active + 1) % TEST_SECTOR_CNT;
+        /* the torn seqs are those the next sector would get */
+        HPM_TEST_CHECK_EQ(seq, 1);
+
+        (void)memset(&g_nor.mem[sector * TEST_SECTOR], 0xFF, TEST_SECTOR);
+        (void)memcpy(&g_nor.mem[sector * TEST_SECTOR], &torn[t].hdr, sizeof(torn[t].hdr));
+
+        printf("torn header, %s\n", torn[t].name);
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        HPM_TEST_CHECK(TestMatches(&g_vars));
+        HPM_TEST_CHECK_EQ(g_e2p.seq, seq);
+        TestHdr(sector, &hdr);
+        HPM_TEST_CHECK_EQ(hdr.magic, E2P_MAGIC_ID);
+        HPM_TEST_CHECK_EQ(hdr.version, TEST_VERSION);
+        HPM_TEST_CHECK_EQ(hdr.seq, E2P_EARSED_ID);
+        HPM_TEST_CHECK(hdr.erase_cnt != E2P_EARSED_ID);
+        if (torn[t].hdr.erase_cnt != E2P_EARSED_ID) {
+            HPM_TEST_CHECK_EQ(hdr.erase_cnt, torn[t].hdr.erase_cnt + 1);
+        }
+
+        /* the ring carries on through the recycled sector */
+        for (uint32_t i = 0; i < 4 * TEST_VAR_CNT; i++) {
+            struct TestWrite w;
+            TestRandomWrite(&g_seed, &w);
+            HPM_TEST_CHECK_EQ(TestWrite(&w), E2P_STATUS_OK);
+            TestApply(&g_vars, &w);
+        }
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        HPM_TEST_CHECK(TestMatches(&g_vars));
+    }
+}
+
+/*
+ * Move seq ahead as if the ring had gone round for years: the next sector
+ * opened takes <seq> + 1, then writes go on for <opens> sector openings
+ */
+static bool TestSeqJump(uint32_t seq, uint32_t opens)
+{
+    struct TestWrite w;
+    bool ok = true;
+
+    g_e2p.seq = seq;
+    while (ok && ((g_e2p.seq == seq) || (g_e2p.seq - seq < opens))) {
+        TestRandomWrite(&g_seed, &w);
+        ok = HPM_TEST_CHECK_EQ(TestWrite(&w), E2P_STATUS_OK);
+        TestApply(&g_vars, &w);
+    }
+    return ok;
+}
+
+/* Seq runs over 2^32 with the ring live across the wrap */
+static void TestEepromSeqWrap(void)
+{
+    struct TestWrite w;
+    e2p_sector_hdr hdr;
+    bool ok;
+
+    /* in steps of less than 2^31 so the ring always spans a valid window */
+    TestFormat();
+    ok = TestSeqJump(0x55555555U, TEST_SECTOR_CNT) && TestSeqJump(0xAAAAAAAAU, TEST_SECTOR_CNT) &&
+         TestSeqJump(E2P_EARSED_ID - TEST_SECTOR_CNT, 1);
+    for (uint32_t i = 0; (i < 1200) && ok; i++) {
+        TestRandomWrite(&g_seed, &w);
+        ok = HPM_TEST_CHECK_EQ(TestWrite(&w), E2P_STATUS_OK);
+        TestApply(&g_vars, &w);
+        for (uint32_t s = 0; s < TEST_SECTOR_CNT; s++) {
+            TestHdr(s, &hdr);
+            ok = ok && HPM_TEST_CHECK((hdr.seq != E2P_EARSED_ID) || (hdr.seq_check == E2P_EARSED_ID));
+            ok = ok && HPM_TEST_CHECK(hdr.seq != 0);
+        }
+        if ((i % 31) == 0) {
+            ok = ok && HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+            ok = ok && HPM_TEST_CHECK(TestMatches(&g_vars));
+        }
+    }
+    HPM_TEST_CHECK(g_e2p.seq < 4 * TEST_SECTOR_CNT);
+    HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+    HPM_TEST_CHECK(TestMatches(&g_vars));
+}
+
+/* A new layout version formats the area and keeps the erase counts */
+static void TestEepromVersion(void)
+{
+    uint32_t cnt[TEST_SECTOR_CNT];
+
+    TestEepromFill();
+    for (uint32_t s = 0; s < TEST_SECTOR_CNT; s++) {
+        cnt[s] = e2p_get_erase_count(&g_e2p, s);
+    }
+    HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION + 1), E2P_STATUS_OK);
+    (void)memset(&g_vars, 0, sizeof(g_vars));
+    HPM_TEST_CHECK(TestMatches(&g_vars));
+    for (uint32_t s = 0; s < TEST_SECTOR_CNT; s++) {
+        HPM_TEST_CHECK_EQ(e2p_get_erase_count(&g_e2p, s), cnt[s] + 1);
+    }
+}
+
+/*
+ * Cut the power at each erase and program of a run of writes that rolls
+ * over into a new sector and compacts an old one. After the reboot the
+ * variables are those of a prefix of the run, and the instance takes writes.
+ */
+static void TestEepromPowerCut(void)
+{
+    struct TestWrite run[TEST_STEP_WRITES];
+    struct TestVars before;
+    struct TestVars expect;
+    uint32_t ops;
+    uint32_t matched[TEST_STEP_WRITES + 1] = { 0 };
+
+    TestFormat();
+    /* go round the ring once and stop close to a roll over, the run then opens a sector and compacts one */
+    for (uint32_t i = 0; (i < 40 * TEST_VAR_CNT) || (g_e2p.remain_size > 8 * TEST_VAR_MAX); i++) {
+        struct TestWrite w;
+        TestRandomWrite(&g_seed, &w);
+        HPM_TEST_CHECK_EQ(TestWrite(&w), E2P_STATUS_OK);
+        TestApply(&g_vars, &w);
+    }
+    for (uint32_t i = 0; i < TEST_STEP_WRITES; i++) {
+        TestRandomWrite(&g_seed, &run[i]);
+    }
+    (void)memcpy(g_snapshot, g_nor.mem, sizeof(g_snapshot));
+    before = g_vars;
+
+    HpmTestNorStatsReset(&g_nor);
+    HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+    for (uint32_t i = 0; i < TEST_STEP_WRITES; i++) {
+        HPM_TEST_CHECK_EQ(TestWrite(&run[i]), E2P_STATUS_OK);
+    }
+    ops = g_nor.erases + g_nor.programs;
+    HPM_TEST_CHECK(g_nor.erases > 0);
+
+    for (uint32_t cut = 1; cut <= ops; cut++) {
+        (void)memcpy(g_nor.mem, g_snapshot, sizeof(g_snapshot));
+        HpmTestNorPowerOn(&g_nor);
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        HpmTestNorCutAfter(&g_nor, cut);
+        for (uint32_t i = 0; (i < TEST_STEP_WRITES) && !g_nor.powerOff; i++) {
+            (void)TestWrite(&run[i]);
+        }
+        HPM_TEST_CHECK(g_nor.powerOff);
+        HpmTestNorPowerOn(&g_nor);
+
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        expect = before;
+        uint32_t k = 0;
+        while (!TestMatches(&expect) && (k < TEST_STEP_WRITES)) {
+            TestApply(&expect, &run[k++]);
+        }
+        if (!HPM_TEST_CHECK(TestMatches(&expect))) {
+            printf("power cut at flash operation %u of %u\n", cut, ops);
+            continue;
+        }
+        matched[k]++;
+
+        for (uint32_t var = 0; var < TEST_VAR_CNT; var++) {
+            struct TestWrite w = { .var = var, .len = (uint16_t)(1 + var) };
+            (void)memset(w.data, (int)(cut + var), w.len);
+            HPM_TEST_CHECK_EQ(TestWrite(&w), E2P_STATUS_OK);
+            TestApply(&expect, &w);
+        }
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        HPM_TEST_CHECK(TestMatches(&expect));
+    }
+
+    printf("power cut at each of %u flash operations of %u writes, writes kept:", ops, TEST_STEP_WRITES);
+    for (uint32_t k = 0; k <= TEST_STEP_WRITES; k++) {
+        if (matched[k] != 0) {
+            printf(" %u x%u", k, matched[k]);
+        }
+    }
+    printf("\n");
+}
+
+/*
+ * Random writes of 20 variables of 4 to 64 bytes on a flash with a 45 ms
+ * sector erase and a 600 us page program: the longest e2p_write on the
+ * virtual clock, without and with e2p_idle between the writes, and the
+ * spread of the erase counts e2p_get_erase_count reports.
+ */
+static void TestEepromWear(void)
+{
+    static const char *modes[] = { "e2p_write only", "e2p_idle after each write" };
+    uint32_t writes = HpmTestFull() ? 200000U : 20000U;
+    uint8_t data[TEST_WEAR_MAX];
+
+    printf("wear, %u random writes of %u variables of %u..%u bytes on %u sectors, erase %llu ms, program %llu us\n",
+           writes, TEST_WEAR_VARS, TEST_WEAR_MIN, TEST_WEAR_MAX, TEST_SECTOR_CNT, TEST_ERASE_NS / 1000000,
+           TEST_PAGE_NS / 1000);
+    for (uint32_t idle = 0; idle < 2; idle++) {
+        uint32_t seed = 0x5EA55EA5U;
+        uint64_t worst = 0;
+        uint32_t minCnt = E2P_EARSED_ID;
+        uint32_t maxCnt = 0;
+        bool ok = true;
+
+        TestErase();
+        HpmTestVirtualTime(true);
+        g_nor.eraseNs = TEST_ERASE_NS;
+        g_nor.pageNs = TEST_PAGE_NS;
+        HPM_TEST_CHECK_EQ(TestBootVars(TEST_WEAR_VARS), E2P_STATUS_OK);
+        for (uint32_t i = 0; (i < writes) && ok; i++) {
+            uint32_t var = HpmTestRand(&seed) % TEST_WEAR_VARS;
+            uint16_t len = (uint16_t)(TEST_WEAR_MIN + HpmTestRand(&seed) % (TEST_WEAR_MAX - TEST_WEAR_MIN + 1));
+            for (uint32_t k = 0; k < len; k++) {
+                data[k] = (uint8_t)HpmTestRand(&seed);
+            }
+
+            uint64_t start = HpmTestNowNs();
+            ok = HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, TestVarId(var), len, data), E2P_STATUS_OK);
+            uint64_t took = HpmTestNowNs() - start;
+            worst = (took > worst) ? took : worst;
+            if (idle != 0) {
+                ok = ok && HPM_TEST_CHECK_EQ(e2p_idle(&g_e2p), E2P_STATUS_OK);
+            }
+        }
+        for (uint32_t sector = 0; sector < TEST_SECTOR_CNT; sector++) {
+            uint32_t cnt = e2p_get_erase_count(&g_e2p, sector);
+            minCnt = (cnt < minCnt) ? cnt : minCnt;
+            maxCnt = (cnt > maxCnt) ? cnt : maxCnt;
+        }
+        g_nor.eraseNs = 0;
+        g_nor.pageNs = 0;
+        HpmTestVirtualTime(false);
+
+        printf("  %-26s worst e2p_write %8.3f ms, erase counts %u..%u\n", modes[idle], (double)worst / 1000000,
+               minCnt, maxCnt);
+        /* every sector takes its turn in the ring */
+        HPM_TEST_CHECK(maxCnt - minCnt <= 1);
+        HPM_TEST_CHECK(minCnt > writes / 1000);
+        /* a write waits for at most one compaction step, none when the idle hook keeps up */
+        HPM_TEST_CHECK(worst < ((idle != 0) ? TEST_ERASE_NS : 2 * TEST_ERASE_NS));
+    }
+}
+
+static void TestBatchItems(struct TestWrite *w, e2p_batch_item *items)
+{
+    for (uint32_t i = 0; i < TEST_BATCH_CNT; i++) {
+        /* distinct variables, a batch giving one twice keeps the last */
+        w[i].var = (w[0].var + i) % TEST_VAR_CNT;
+        items[i].block_id = TestVarId(w[i].var);
+        items[i].length = w[i].len;
+        items[i].data = w[i].data;
+    }
+}
+
+/*
+ * Cut the power at each erase and program of e2p_write_batch, in the active
+ * sector or rolling over into the next one, with the torn program getting
+ * every TEST_TORN_STEP-th length through. After the reboot either none or
+ * all of the batch is seen, also once the next record lands behind the torn
+ * batch, and the instance takes batches again.
+ */
+static void TestEepromBatchPowerCut(bool rollOver)
+{
+    struct TestWrite w[TEST_BATCH_CNT];
+    e2p_batch_item items[TEST_BATCH_CNT];
+    struct TestVars before;
+    struct TestVars after;
+    struct TestWrite single;
+    uint32_t need = 0;
+    uint32_t ops;
+    uint32_t cases = 0;
+    uint32_t none = 0;
+    uint32_t all = 0;
+
+    for (uint32_t i = 0; i < TEST_BATCH_CNT; i++) {
+        TestRandomWrite(&g_seed, &w[i]);
+        need += w[i].len + sizeof(e2p_block);
+    }
+    TestBatchItems(w, items);
+    TestRandomWrite(&g_seed, &single);
+
+    TestFormat();
+    for (uint32_t i = 0; (i < 40 * TEST_VAR_CNT) || (rollOver ? (g_e2p.remain_size >= need) :
+                                                      (g_e2p.remain_size < TEST_SECTOR / 2)); i++) {
+        struct TestWrite r;
+        TestRandomWrite(&g_seed, &r);
+        HPM_TEST_CHECK_EQ(TestWrite(&r), E2P_STATUS_OK);
+        TestApply(&g_vars, &r);
+    }
+    (void)memcpy(g_snapshot, g_nor.mem, sizeof(g_snapshot));
+    before = g_vars;
+    after = g_vars;
+    for (uint32_t i = 0; i < TEST_BATCH_CNT; i++) {
+        TestApply(&after, &w[i]);
+    }
+
+    HpmTestNorStatsReset(&g_nor);
+    HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+    HPM_TEST_CHECK_EQ(e2p_write_batch(&g_e2p, items, TEST_BATCH_CNT), E2P_STATUS_OK);
+    HPM_TEST_CHECK(TestMatches(&after));
+    ops = g_nor.erases + g_nor.programs;
+
+    for (uint32_t n = 0; n < ops * (TEST_PAGE / TEST_TORN_STEP + 2); n++) {
+        uint32_t cut = 1 + n % ops;
+        uint32_t keep = (n / ops) * TEST_TORN_STEP;
+        struct TestVars expect;
+
+        (void)memcpy(g_nor.mem, g_snapshot, sizeof(g_snapshot));
+        HpmTestNorPowerOn(&g_nor);
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        HpmTestNorCutAfterKeep(&g_nor, cut, keep);
+        (void)e2p_write_batch(&g_e2p, items, TEST_BATCH_CNT);
+        HPM_TEST_CHECK(g_nor.powerOff);
+        HpmTestNorPowerOn(&g_nor);
+        cases++;
+
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        if (TestMatches(&before)) {
+            expect = before;
+            none++;
+        } else if (TestMatches(&after)) {
+            expect = after;
+            all++;
+        } else {
+            HPM_TEST_CHECK(!"batch seen in part");
+            printf("power cut at flash operation %u of %u, %u bytes through\n", cut, ops, keep);
+            continue;
+        }
+
+        /* a record behind the torn batch must not commit its pending records */
+        HPM_TEST_CHECK_EQ(TestWrite(&single), E2P_STATUS_OK);
+        TestApply(&expect, &single);
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        HPM_TEST_CHECK(TestMatches(&expect));
+
+        HPM_TEST_CHECK_EQ(e2p_write_batch(&g_e2p, items, TEST_BATCH_CNT), E2P_STATUS_OK);
+        for (uint32_t i = 0; i < TEST_BATCH_CNT; i++) {
+            TestApply(&expect, &w[i]);
+        }
+        HPM_TEST_CHECK_EQ(TestBoot(TEST_VERSION), E2P_STATUS_OK);
+        HPM_TEST_CHECK(TestMatches(&expect));
+    }
+
+    printf("batch of %u, %u bytes, %s: %u flash operations, %u cuts, none kept %u, all kept %u\n",
+           TEST_BATCH_CNT, need, rollOver ? "rolling over" : "in the active sector", ops, cases, none, all);
+    HPM_TEST_CHECK_EQ(none + all, cases);
+    /* only the commit record programmed in full keeps the batch */
+    HPM_TEST_CHECK(all > 0);
+}
+
+/* Program operations of a batch against the same variables written one by one, and the read cache */
+static void TestEepromBatchCost(void)
+{
+    struct TestWrite w[TEST_BATCH_CNT];
+    e2p_batch_item items[TEST_BATCH_CNT];
+    uint8_t buf[TEST_VAR_MAX];
+    uint32_t batch;
+    uint32_t single;
+
+    for (uint32_t i = 0; i < TEST_BATCH_CNT; i++) {
+        TestRandomWrite(&g_seed, &w[i]);
+        w[i].len = 4;
+    }
+    TestBatchItems(w, items);
+
+    TestFormat();
+    HpmTestNorStatsReset(&g_nor);
+    HPM_TEST_CHECK_EQ(e2p_write_batch(&g_e2p, items, TEST_BATCH_CNT), E2P_STATUS_OK);
+    batch = g_nor.programs;
+
+    TestFormat();
+    HpmTestNorStatsReset(&g_nor);
+    for (uint32_t i = 0; i < TEST_BATCH_CNT; i++) {
+        HPM_TEST_CHECK_EQ(e2p_write(&g_e2p, items[i].block_id, items[i].length, items[i].data), E2P_STATUS_OK);
+    }
+    single = g_nor.programs;
+    printf("%u variables of 4 bytes: batch %u programs, one by one %u programs\n", TEST_BATCH_CNT, batch, single);
+    HPM_TEST_CHECK(batch < single);
+
+    /* the last values written are served from the cache, an older one from flash */
+    HpmTestNorStatsReset(&g_nor);
+    HPM_TEST_CHECK_EQ(e2p_read(&g_e2p, items[TEST_BATCH_CNT - 1].block_id, sizeof(buf), buf), E2P_STATUS_OK);
+    HPM_TEST_CHECK_EQ(g_nor.reads, 0);
+    HPM_TEST_CHECK_EQ(e2p_read(&g_e2p, items[0].block_id, sizeof(buf), buf), E2P_STATUS_OK);
+    HPM_TEST_CHECK(g_nor.reads > 0);
+    HPM_TEST_CHECK(memcmp(buf, w[0].data, w[0].len) == 0);
+}
+
+int main(void)
+{
+    HpmTestNorInit(&g_nor, 2 * TEST_AREA, TEST_SECTOR, TEST_PAGE, 0, 0);
+
+    TestEepromLookup();
+    TestEepromCollisions();
+    TestEepromVarLimit();
+    TestEepromOwnTables();
+    TestEepromDefaultTable();
+    TestEepromRandom();
+    TestEepromTornHeader();
+    TestEepromSeqWrap();
+    TestEepromVersion();
+    TestEepromPowerCut();
+    TestEepromBatchPowerCut(false);
+    TestEepromBatchPowerCut(true);
+    TestEepromBatchCost();
+    TestEepromWear();
+
+    HpmTestNorDeinit(&g_nor);
+    return HpmTestResult();
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* eeprom_emulation configuration for the host tests, errors only on the console */
+
+#ifndef USER_CONFIG_H
+#define USER_CONFIG_H
+
+#define E2P_DEBUG_LEVEL        (3)
+
+/* swallow the info lines but keep their arguments used */
+#define E2P_DEBUG_INFO
+#define e2p_info(...)          e2p_test_quiet(__VA_ARGS__)
+static inline void e2p_test_quiet(const char *fmt, ...)
+{
+    (void)fmt;
+}
+
+#define EEPROM_MAX_VAR_CNT     (100)
+#define EEPROM_GC_FREE_SECTORS (3)
+#define EEPROM_BATCH_MAX       (8)
+#define EEPROM_CACHE_CNT       (4)
+
+#endif
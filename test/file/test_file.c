@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * hpm6700/hals/utils/file/src/hal_file.c on the file system model: the fd
+ * table, path handling, the write-back cache against a shadow copy of every
+ * file, error paths, and the file system calls per HalFileWrite.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "utils_file.h"
+#include "hal_file.h"
+#include "hpm_test.h"
+#include "hpm_test_fs.h"
+
+#ifndef HAL_FILE_CACHE_NUM
+#define HAL_FILE_CACHE_NUM 2
+#endif
+#define TEST_BLOCK 4096U
+#define TEST_FDS 32
+#define TEST_FILE_MAX 65536U
+#define TEST_RW (O_RDWR_FS | O_CREAT_FS | O_TRUNC_FS)
+
+static uint8_t g_shadow[TEST_FILE_MAX];
+static uint8_t g_buf[TEST_FILE_MAX];
+static uint32_t g_seed = 0xF11E5EEDU;
+
+#if HAL_FILE_CACHE_NUM > 0
+static uint32_t TestFsWrites(void)
+{
+    struct HpmTestFsStats stats;
+
+    HpmTestFsStats(&stats);
+    return stats.writes;
+}
+#endif
+
+static void TestFileRoundTrip(void)
+{
+    const char text[] = "hello littlefs";
+    char buf[sizeof(text) + 1] = { 0 };
+    unsigned int size = 0xDEADBEEFU;
+    int fd = HalFileOpen("round", TEST_RW, 0);
+
+    HPM_TEST_CHECK(fd > 0);
+    HPM_TEST_CHECK_EQ(HalFileWrite(fd, text, 5), 5);
+    HPM_TEST_CHECK_EQ(HalFileWrite(fd, text + 5, sizeof(text) - 5), sizeof(text) - 5);
+    HPM_TEST_CHECK_EQ(HalFileSeek(fd, 0, SEEK_SET_FS), 0);
+    HPM_TEST_CHECK_EQ(HalFileRead(fd, buf, sizeof(buf)), sizeof(text));
+    HPM_TEST_CHECK_EQ(memcmp(buf, text, sizeof(text)), 0);
+    HPM_TEST_CHECK_EQ(HalFileSeek(fd, 0, SEEK_END_FS), sizeof(text));
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+
+    HPM_TEST_CHECK_EQ(HalFileStat("round", &size), 0);
+    HPM_TEST_CHECK_EQ(size, sizeof(text));
+
+    /* append, and a read only open sees all of it */
+    fd = HalFileOpen("round", O_WRONLY_FS | O_APPEND_FS, 0);
+    HPM_TEST_CHECK_EQ(HalFileWrite(fd, "!", 1), 1);
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    fd = HalFileOpen("round", O_RDONLY_FS, 0);
+    HPM_TEST_CHECK_EQ(HalFileRead(fd, buf, sizeof(buf)), sizeof(buf));
+    HPM_TEST_CHECK_EQ(buf[sizeof(text)], '!');
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+
+    HPM_TEST_CHECK_EQ(HalFileDelete("round"), 0);
+    size = 0xDEADBEEFU;
+    HPM_TEST_CHECK_EQ(HalFileStat("round", &size), -1);
+    HPM_TEST_CHECK_EQ(size, 0xDEADBEEFU);
+    HPM_TEST_CHECK_EQ(HalFileDelete("round"), -1);
+    HPM_TEST_CHECK_EQ(HpmTestFsOpenFiles(), 0);
+}
+
+static void TestFilePaths(void)
+{
+    char path[64];
+    unsigned int size;
+    int fd;
+
+    /* MAX_PATH_LEN is 40 with the terminator */
+    (void)memset(path, 'p', sizeof(path));
+    path[39] = '\0';
+    fd = HalFileOpen(path, TEST_RW, 0);
+    HPM_TEST_CHECK(fd > 0);
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    HPM_TEST_CHECK_EQ(HalFileStat(path, &size), 0);
+    HPM_TEST_CHECK_EQ(HalFileDelete(path), 0);
+
+    path[39] = 'p';
+    path[40] = '\0';
+    HPM_TEST_CHECK_EQ(HalFileOpen(path, TEST_RW, 0), -1);
+    HPM_TEST_CHECK_EQ(HalFileStat(path, &size), -1);
+    HPM_TEST_CHECK_EQ(HalFileDelete(path), -1);
+
+    HPM_TEST_CHECK_EQ(HalFileOpen("missing", O_RDONLY_FS, 0), -1);
+    HPM_TEST_CHECK_EQ(HalFileOpen("missing", O_RDWR_FS, 0), -1);
+    fd = HalFileOpen("excl", TEST_RW | O_EXCL_FS, 0);
+    HPM_TEST_CHECK(fd > 0);
+    HPM_TEST_CHECK_EQ(HalFileOpen("excl", TEST_RW | O_EXCL_FS, 0), -1);
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    HPM_TEST_CHECK_EQ(HalFileDelete("excl"), 0);
+    HPM_TEST_CHECK_EQ(HpmTestFsOpenFiles(), 0);
+}
+
+static void TestFileFds(void)
+{
+    int fds[TEST_FDS + 1];
+    char path[16];
+    char c = 0;
+
+    /* failed opens above must not have leaked slots */
+    for (int i = 0; i < TEST_FDS; i++) {
+        (void)snprintf(path, sizeof(path), "fd%d", i);
+        fds[i] = HalFileOpen(path, TEST_RW, 0);
+        HPM_TEST_CHECK(fds[i] > 0 && fds[i] <= TEST_FDS);
+        for (int j = 0; j < i; j++) {
+            HPM_TEST_CHECK(fds[j] != fds[i]);
+        }
+    }
+    HPM_TEST_CHECK_EQ(HalFileOpen("fdmore", TEST_RW, 0), -1);
+
+    /* released slots are handed out again, last closed first */
+    HPM_TEST_CHECK_EQ(HalFileClose(fds[5]), 0);
+    HPM_TEST_CHECK_EQ(HalFileClose(fds[17]), 0);
+    HPM_TEST_CHECK_EQ(HalFileRead(fds[5], &c, 1), -1);
+    HPM_TEST_CHECK_EQ(HalFileWrite(fds[5], &c, 1), -1);
+    HPM_TEST_CHECK_EQ(HalFileSeek(fds[5], 0, SEEK_SET_FS), -1);
+    HPM_TEST_CHECK_EQ(HalFileClose(fds[5]), -1);
+    fds[TEST_FDS] = HalFileOpen("fd17", TEST_RW, 0);
+    HPM_TEST_CHECK_EQ(fds[TEST_FDS], fds[17]);
+    fds[TEST_FDS] = HalFileOpen("fd5", TEST_RW, 0);
+    HPM_TEST_CHECK_EQ(fds[TEST_FDS], fds[5]);
+
+    for (int i = 0; i < TEST_FDS; i++) {
+        HPM_TEST_CHECK_EQ(HalFileClose(fds[i]), 0);
+        (void)snprintf(path, sizeof(path), "fd%d", i);
+        HPM_TEST_CHECK_EQ(HalFileDelete(path), 0);
+    }
+
+    HPM_TEST_CHECK_EQ(HalFileRead(0, &c, 1), -1);
+    HPM_TEST_CHECK_EQ(HalFileRead(-1, &c, 1), -1);
+    HPM_TEST_CHECK_EQ(HalFileWrite(TEST_FDS + 1, &c, 1), -1);
+    HPM_TEST_CHECK_EQ(HalFileClose(TEST_FDS + 1), -1);
+    HPM_TEST_CHECK_EQ(HpmTestFsOpenFiles(), 0);
+}
+
+/* Random writes, reads and seeks on up to three files, checked against a shadow of the first */
+static void TestFileShadow(void)
+{
+    uint32_t rounds = HpmTestFull() ? 20000 : 2000;
+    uint32_t size = 0;
+    uint32_t pos = 0;
+    unsigned int statSize = 0;
+    int fd = HalFileOpen("shadow", TEST_RW, 0);
+    int other[2] = { HalFileOpen("other0", TEST_RW, 0), HalFileOpen("other1", TEST_RW, 0) };
+
+    HPM_TEST_CHECK(fd > 0 && other[0] > 0 && other[1] > 0);
+    for (uint32_t i = 0; i < rounds; i++) {
+        uint32_t op = HpmTestRand(&g_seed) % 16;
+        uint32_t len = HpmTestRand(&g_seed) % ((op == 0) ? (2 * TEST_BLOCK) : 300);
+
+        if (op < 10) {
+            /* mostly small writes, now and then one past a block */
+            if (pos + len > TEST_FILE_MAX) {
+                len = TEST_FILE_MAX - pos;
+            }
+            for (uint32_t k = 0; k < len; k++) {
+                g_buf[k] = (uint8_t)HpmTestRand(&g_seed);
+            }
+            if (!HPM_TEST_CHECK_EQ(HalFileWrite(fd, (char *)g_buf, len), len)) {
+                break;
+            }
+            (void)memcpy(&g_shadow[pos], g_buf, len);
+            pos += len;
+            size = (pos > size) ? pos : size;
+        } else if (op < 12) {
+            len = (len > size - pos) ? (size - pos) : len;
+            if (!HPM_TEST_CHECK_EQ(HalFileRead(fd, (char *)g_buf, len), len) ||
+                !HPM_TEST_CHECK_EQ(memcmp(g_buf, &g_shadow[pos], len), 0)) {
+                break;
+            }
+            pos += len;
+        } else if (op < 14) {
+            pos = (size != 0) ? (HpmTestRand(&g_seed) % (size + 1)) : 0;
+            if (!HPM_TEST_CHECK_EQ(HalFileSeek(fd, pos, SEEK_SET_FS), pos)) {
+                break;
+            }
+        } else {
+            /* the other files compete for the cache pool */
+            HPM_TEST_CHECK_EQ(HalFileWrite(other[op & 1], (char *)g_buf, len), len);
+        }
+    }
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    HPM_TEST_CHECK_EQ(HalFileClose(other[0]), 0);
+    HPM_TEST_CHECK_EQ(HalFileClose(other[1]), 0);
+
+    HPM_TEST_CHECK_EQ(HalFileStat("shadow", &statSize), 0);
+    HPM_TEST_CHECK_EQ(statSize, size);
+    fd = HalFileOpen("shadow", O_RDONLY_FS, 0);
+    HPM_TEST_CHECK_EQ(HalFileRead(fd, (char *)g_buf, TEST_FILE_MAX), size);
+    HPM_TEST_CHECK_EQ(memcmp(g_buf, g_shadow, size), 0);
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    HPM_TEST_CHECK_EQ(HalFileDelete("shadow"), 0);
+    HPM_TEST_CHECK_EQ(HalFileDelete("other0"), 0);
+    HPM_TEST_CHECK_EQ(HalFileDelete("other1"), 0);
+}
+
+static void TestFileCache(void)
+{
+#if HAL_FILE_CACHE_NUM > 0
+    char chunk[1000];
+    int fds[HAL_FILE_CACHE_NUM + 1];
+    char path[16];
+    uint32_t writes;
+    int fd;
+
+    (void)memset(chunk, 'c', sizeof(chunk));
+
+    /* small writes stay in RAM until the block fills or the fd is used otherwise */
+    fd = HalFileOpen("cache", TEST_RW, 0);
+    HpmTestFsStatsReset();
+    for (int i = 0; i < 40; i++) {
+        HPM_TEST_CHECK_EQ(HalFileWrite(fd, chunk, 100), 100);
+    }
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 0);
+    HPM_TEST_CHECK_EQ(HalFileWrite(fd, chunk, 96), 96);
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 1);
+    HPM_TEST_CHECK_EQ(HalFileWrite(fd, chunk, 10), 10);
+    HPM_TEST_CHECK_EQ(HalFileSeek(fd, 0, SEEK_CUR_FS), TEST_BLOCK + 10);
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 2);
+
+    /* a stream of writes that do not divide the block is still written a block at a time */
+    HpmTestFsStatsReset();
+    for (int i = 0; i < 41; i++) {
+        HPM_TEST_CHECK_EQ(HalFileWrite(fd, chunk, sizeof(chunk)), sizeof(chunk));
+    }
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    writes = TestFsWrites();
+    HPM_TEST_CHECK(writes <= (41 * sizeof(chunk) + TEST_BLOCK - 1) / TEST_BLOCK + 1);
+
+    /* more writers than buffers, the rest write through */
+    for (int i = 0; i <= HAL_FILE_CACHE_NUM; i++) {
+        (void)snprintf(path, sizeof(path), "pool%d", i);
+        fds[i] = HalFileOpen(path, TEST_RW, 0);
+    }
+    HpmTestFsStatsReset();
+    for (int i = 0; i <= HAL_FILE_CACHE_NUM; i++) {
+        HPM_TEST_CHECK_EQ(HalFileWrite(fds[i], chunk, 10), 10);
+    }
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 1);
+    /* closing a cached fd hands its buffer on */
+    HPM_TEST_CHECK_EQ(HalFileClose(fds[0]), 0);
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 2);
+    HPM_TEST_CHECK_EQ(HalFileWrite(fds[HAL_FILE_CACHE_NUM], chunk, 10), 10);
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 2);
+    for (int i = 1; i <= HAL_FILE_CACHE_NUM; i++) {
+        HPM_TEST_CHECK_EQ(HalFileClose(fds[i]), 0);
+    }
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 2 + HAL_FILE_CACHE_NUM);
+    for (int i = 0; i <= HAL_FILE_CACHE_NUM; i++) {
+        (void)snprintf(path, sizeof(path), "pool%d", i);
+        HPM_TEST_CHECK_EQ(HalFileDelete(path), 0);
+    }
+    HPM_TEST_CHECK_EQ(HalFileDelete("cache"), 0);
+#endif
+}
+
+/* Stat counts what the open fds of that file still buffer, and leaves other files' buffers alone */
+static void TestFileStatCached(void)
+{
+#if HAL_FILE_CACHE_NUM > 1
+    char chunk[100];
+    unsigned int size = 0;
+    int fd;
+    int other;
+
+    (void)memset(chunk, 's', sizeof(chunk));
+    fd = HalFileOpen("statc", TEST_RW, 0);
+    other = HalFileOpen("statd", TEST_RW, 0);
+    HpmTestFsStatsReset();
+    HPM_TEST_CHECK_EQ(HalFileWrite(fd, chunk, sizeof(chunk)), sizeof(chunk));
+    HPM_TEST_CHECK_EQ(HalFileWrite(other, chunk, sizeof(chunk)), sizeof(chunk));
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 0);
+
+    HPM_TEST_CHECK_EQ(HalFileStat("statc", &size), 0);
+    HPM_TEST_CHECK_EQ(size, sizeof(chunk));
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 1);
+
+    /* the fd keeps working, appending after the flushed data */
+    HPM_TEST_CHECK_EQ(HalFileWrite(fd, chunk, sizeof(chunk)), sizeof(chunk));
+    HPM_TEST_CHECK_EQ(HalFileStat("statc", &size), 0);
+    HPM_TEST_CHECK_EQ(size, 2 * sizeof(chunk));
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 2);
+
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    HPM_TEST_CHECK_EQ(HalFileClose(other), 0);
+    HPM_TEST_CHECK_EQ(TestFsWrites(), 3);
+    HPM_TEST_CHECK_EQ(HalFileDelete("statc"), 0);
+    HPM_TEST_CHECK_EQ(HalFileDelete("statd"), 0);
+#endif
+}
+
+static void TestFileErrors(void)
+{
+    char c = 'e';
+    int fd;
+    int again;
+
+    /* a write the file system refuses, buffered or not, is reported and the fd still closes */
+    fd = HalFileOpen("err", TEST_RW, 0);
+    HpmTestFsFailWrite(0);
+    if (HalFileWrite(fd, &c, 1) == 1) {
+        HPM_TEST_CHECK_EQ(HalFileClose(fd), -1);
+    } else {
+        HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    }
+    HPM_TEST_CHECK_EQ(HalFileRead(fd, &c, 1), -1);
+    HPM_TEST_CHECK_EQ(HpmTestFsOpenFiles(), 0);
+
+    /* the slot of a failed close is not lost */
+    fd = HalFileOpen("err", TEST_RW, 0);
+    HpmTestFsFailClose();
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), -1);
+    HPM_TEST_CHECK_EQ(HalFileRead(fd, &c, 1), -1);
+    again = HalFileOpen("err", TEST_RW, 0);
+    HPM_TEST_CHECK_EQ(again, fd);
+    HPM_TEST_CHECK_EQ(HalFileClose(again), 0);
+
+    /* what is still buffered is written out before a seek and read */
+    fd = HalFileOpen("err", TEST_RW, 0);
+    HPM_TEST_CHECK_EQ(HalFileWrite(fd, "abc", 3), 3);
+    HPM_TEST_CHECK_EQ(HalFileSeek(fd, 0, SEEK_SET_FS), 0);
+    HPM_TEST_CHECK_EQ(HalFileRead(fd, &c, 1), 1);
+    HPM_TEST_CHECK_EQ(c, 'a');
+    HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+    HPM_TEST_CHECK_EQ(HalFileDelete("err"), 0);
+    HPM_TEST_CHECK_EQ(HpmTestFsOpenFiles(), 0);
+}
+
+static void TestFileBench(void)
+{
+    static const uint32_t sizes[] = { 16, 100, 1000, 5000 };
+    uint32_t calls = HpmTestFull() ? 2000 : 200;
+    struct HpmTestFsStats stats;
+
+    printf("file bench, %u HalFileWrite calls each, cache %d x %u bytes\n", calls, HAL_FILE_CACHE_NUM, TEST_BLOCK);
+    printf("%8s %10s %10s %12s\n", "bytes", "fs writes", "per call", "host ns/call");
+    for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int fd = HalFileOpen("bench", TEST_RW, 0);
+        uint64_t t0;
+        uint64_t ns;
+
+        HpmTestFsStatsReset();
+        t0 = HpmTestHostNs();
+        for (uint32_t i = 0; i < calls; i++) {
+            HPM_TEST_CHECK_EQ(HalFileWrite(fd, (char *)g_buf, sizes[s]), sizes[s]);
+        }
+        HPM_TEST_CHECK_EQ(HalFileClose(fd), 0);
+        ns = HpmTestHostNs() - t0;
+        HpmTestFsStats(&stats);
+        printf("%8u %10u %10.3f %12llu\n", sizes[s], stats.writes, (double)stats.writes / calls,
+               (unsigned long long)(ns / calls));
+        HPM_TEST_CHECK_EQ(stats.writeBytes, (uint64_t)calls * sizes[s]);
+        HPM_TEST_CHECK_EQ(HalFileDelete("bench"), 0);
+    }
+}
+
+int main(void)
+{
+    HpmTestFsInit("/data");
+
+    TestFileRoundTrip();
+    TestFilePaths();
+    TestFileFds();
+    TestFileShadow();
+    TestFileCache();
+    TestFileStatCached();
+    TestFileErrors();
+    TestFileBench();
+
+    HpmTestFsDeinit();
+    return HpmTestResult();
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * drivers/platform/gpio.c against the gpio and machine timer models: set bit
+ * dispatch, edges latched while the isr runs, level interrupts, init and
+ * release, debounce, the edge timestamp rings, and the isr cost with 1 and 32
+ * pending pins.
+ */
+
+#include <string.h>
+#include "hdf_device_desc.h"
+#include "gpio_core.h"
+#include "gpio_ext.h"
+#include "hpm_soc.h"
+#include "hpm_gpio_drv.h"
+#include "soc.h"
+#include "hpm_test.h"
+#include "hpm_test_gpio.h"
+
+#define TEST_PORT GPIO_DI_GPIOA
+#define TEST_PINS 32U
+#define TEST_MCHTMR_HZ 24000000U
+#define TEST_US 1000ULL
+#define TEST_MMIO_NS 20
+
+extern struct HdfDriverEntry g_gpioDriverEntry;
+
+static struct HpmTestGpio g_gpio;
+static struct HdfDeviceObject *g_device;
+static uint32_t g_hits[TEST_PINS];
+static uint32_t g_seed = 0x5EED1234U;
+static uint32_t g_lateEdgePin;
+static uint32_t g_losIrq;
+
+static int32_t TestIrq(uint16_t gpio, void *data)
+{
+    (void)data;
+    g_hits[gpio]++;
+    return HDF_SUCCESS;
+}
+
+/* The handler of a level interrupt masks it, as a threaded handler would */
+static int32_t TestLevelIrq(uint16_t gpio, void *data)
+{
+    (void)data;
+    g_hits[gpio]++;
+    GpioDisableIrq(gpio);
+    return HDF_SUCCESS;
+}
+
+static bool TestOpen(uint32_t debounceUs, uint32_t ringSize)
+{
+    const struct HpmTestProp props[] = {
+        { "base", HPM_GPIO0_BASE, NULL },
+        { "name", 0, "PA" },
+        { "port_num", TEST_PORT, NULL },
+        { "irq_num", IRQn_GPIO0_A, NULL },
+        { "count", TEST_PINS, NULL },
+        { "debounce_us", debounceUs, NULL },
+        { "edge_ring_size", ringSize, NULL },
+        { NULL, 0, NULL },
+    };
+
+    g_device = HpmTestDeviceCreate(props);
+    if (!HPM_TEST_CHECK_EQ(g_gpioDriverEntry.Bind(g_device), HDF_SUCCESS) ||
+        !HPM_TEST_CHECK_EQ(g_gpioDriverEntry.Init(g_device), HDF_SUCCESS)) {
+        HpmTestDeviceDestroy(g_device);
+        return false;
+    }
+    for (uint16_t pin = 0; pin < TEST_PINS; pin++) {
+        HpmTestGpioSetInput(&g_gpio, TEST_PORT, pin, false);
+        GpioSetDir(pin, GPIO_DIR_IN);
+        GpioSetIrq(pin, GPIO_IRQ_TRIGGER_RISING, TestIrq, NULL);
+        GpioEnableIrq(pin);
+    }
+    memset(g_hits, 0, sizeof(g_hits));
+    return true;
+}
+
+static void TestClose(void)
+{
+    for (uint16_t pin = 0; pin < TEST_PINS; pin++) {
+        GpioDisableIrq(pin);
+        GpioUnsetIrq(pin, NULL);
+    }
+    g_gpioDriverEntry.Release(g_device);
+    HpmTestDeviceDestroy(g_device);
+}
+
+static void TestRunUs(uint64_t us)
+{
+    HpmTestRunUntil(HpmTestNowNs() + us * TEST_US);
+}
+
+static void TestPulse(uint32_t pin)
+{
+    HpmTestGpioSetInput(&g_gpio, TEST_PORT, pin, true);
+    HpmTestGpioSetInput(&g_gpio, TEST_PORT, pin, false);
+}
+
+static uint32_t TestHits(void)
+{
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < TEST_PINS; i++) {
+        n += g_hits[i];
+    }
+    return n;
+}
+
+/* An edge that lands between the isr's flag read and its W1C */
+static void TestLateEdge(void *ctx, uint32_t port)
+{
+    (void)ctx;
+    if ((port == TEST_PORT) && (g_lateEdgePin < TEST_PINS)) {
+        TestPulse(g_lateEdgePin);
+        g_lateEdgePin = TEST_PINS;
+    }
+}
+
+/* A failed irq install fails Init and leaves the port free for the next attempt */
+static void TestGpioInitFail(void)
+{
+    const struct HpmTestProp props[] = {
+        { "base", HPM_GPIO0_BASE, NULL },
+        { "name", 0, "PA" },
+        { "port_num", TEST_PORT, NULL },
+        { "irq_num", IRQn_GPIO0_A, NULL },
+        { "count", TEST_PINS, NULL },
+        { NULL, 0, NULL },
+    };
+    struct HdfDeviceObject *device = HpmTestDeviceCreate(props);
+    uint32_t mem = HpmTestMemInUse();
+
+    HpmTestHwiCreateFail(1);
+    HPM_TEST_CHECK(g_gpioDriverEntry.Init(device) != HDF_SUCCESS);
+    HPM_TEST_CHECK_EQ(HpmTestMemInUse(), mem);
+    HPM_TEST_CHECK(GpioSetDir(0, GPIO_DIR_IN) != HDF_SUCCESS);
+    HpmTestDeviceDestroy(device);
+
+    if (TestOpen(0, 0)) {
+        TestPulse(0);
+        TestRunUs(10);
+        HPM_TEST_CHECK_EQ(g_hits[0], 1);
+        TestClose();
+    }
+}
+
+/* The 16 bit ring indices cannot track a 65536 entry ring: refused at parse time */
+static void TestGpioRingSizeLimit(void)
+{
+    const struct HpmTestProp props[] = {
+        { "base", HPM_GPIO0_BASE, NULL },
+        { "name", 0, "PA" },
+        { "port_num", TEST_PORT, NULL },
+        { "irq_num", IRQn_GPIO0_A, NULL },
+        { "edge_ring_size", 65536, NULL },
+        { "count", TEST_PINS, NULL },
+        { NULL, 0, NULL },
+    };
+    struct HdfDeviceObject *device = HpmTestDeviceCreate(props);
+    uint32_t mem = HpmTestMemInUse();
+
+    HPM_TEST_CHECK_EQ(g_gpioDriverEntry.Init(device), HDF_ERR_INVALID_PARAM);
+    HPM_TEST_CHECK_EQ(HpmTestMemInUse(), mem);
+    HpmTestDeviceDestroy(device);
+}
+
+/* One isr per batch of edges, one callback per set pin, nothing for the others */
+static void TestGpioDispatch(void)
+{
+    if (!TestOpen(0, 0)) {
+        return;
+    }
+    for (uint32_t round = 0; round < 64; round++) {
+        uint32_t set = HpmTestRand(&g_seed) | (1U << (round % TEST_PINS));
+        uint32_t irqs = HpmTestIrqCount(g_losIrq);
+        bool ok = true;
+
+        memset(g_hits, 0, sizeof(g_hits));
+        for (uint32_t pin = 0; pin < TEST_PINS; pin++) {
+            if (set & (1U << pin)) {
+                TestPulse(pin);
+            }
+        }
+        TestRunUs(10);
+        for (uint32_t pin = 0; pin < TEST_PINS; pin++) {
+            ok = ok && HPM_TEST_CHECK_EQ(g_hits[pin], (set >> pin) & 1U);
+        }
+        HPM_TEST_CHECK_EQ(HpmTestIrqCount(g_losIrq) - irqs, 1);
+        HPM_TEST_CHECK_EQ(g_gpio.port[TEST_PORT].flags, 0);
+        if (!ok) {
+            break;
+        }
+    }
+
+    /* falling edges are not enabled */
+    memset(g_hits, 0, sizeof(g_hits));
+    HpmTestGpioSetInput(&g_gpio, TEST_PORT, 7, true);
+    TestRunUs(10);
+    HpmTestGpioSetInput(&g_gpio, TEST_PORT, 7, false);
+    TestRunUs(10);
+    HPM_TEST_CHECK_EQ(TestHits(), 1);
+
+    /* the isr acks only the flags it read, a later edge gets its own callback */
+    memset(g_hits, 0, sizeof(g_hits));
+    g_lateEdgePin = 31;
+    g_gpio.flagRead = TestLateEdge;
+    TestPulse(2);
+    TestRunUs(10);
+    g_gpio.flagRead = NULL;
+    HPM_TEST_CHECK_EQ(g_hits[2], 1);
+    HPM_TEST_CHECK_EQ(g_hits[31], 1);
+
+    /* a level interrupt keeps its flag set until the handler masks it */
+    memset(g_hits, 0, sizeof(g_hits));
+    GpioSetIrq(5, GPIO_IRQ_TRIGGER_HIGH, TestLevelIrq, NULL);
+    GpioEnableIrq(5);
+    HpmTestGpioSetInput(&g_gpio, TEST_PORT, 5, true);
+    TestRunUs(100);
+    HPM_TEST_CHECK_EQ(g_hits[5], 1);
+    HpmTestGpioSetInput(&g_gpio, TEST_PORT, 5, false);
+    TestClose();
+}
+
+/* Edges inside the window after an accepted edge are dropped, the first edge after boot is not */
+static void TestGpioDebounce(void)
+{
+    struct HpmGpioEdgeStats stats;
+
+    /* machine timer back at 0, as right after reset */
+    HpmTestVirtualTime(true);
+    if (!TestOpen(100, 0)) {
+        return;
+    }
+    TestRunUs(5);
+    TestPulse(4);
+    TestRunUs(30);
+    TestPulse(4);
+    TestRunUs(120);
+    TestPulse(4);
+    TestRunUs(10);
+    HPM_TEST_CHECK_EQ(g_hits[4], 2);
+    HPM_TEST_CHECK_EQ(HpmGpioGetEdgeStats(4, &stats), HDF_SUCCESS);
+    HPM_TEST_CHECK_EQ(stats.bounced, 1);
+
+    /* pins debounce independently */
+    TestPulse(6);
+    TestRunUs(10);
+    HPM_TEST_CHECK_EQ(g_hits[6], 1);
+    TestClose();
+}
+
+/* One callback per batch, the handler side drains the timestamps */
+static void TestGpioEdgeRing(void)
+{
+    struct HpmGpioEdgeStats stats;
+    uint32_t ts[16];
+    int32_t n;
+
+    if (!TestOpen(0, 8)) {
+        return;
+    }
+    TestRunUs(10);
+    for (uint32_t i = 0; i < 5; i++) {
+        TestPulse(3);
+        TestRunUs(10);
+    }
+    HPM_TEST_CHECK_EQ(g_hits[3], 1);
+    n = HpmGpioReadEdges(3, ts, 16);
+    HPM_TEST_CHECK_EQ(n, 5);
+    for (int32_t i = 1; i < n; i++) {
+        HPM_TEST_CHECK_EQ(ts[i] - ts[i - 1], 10 * (TEST_MCHTMR_HZ / 1000000));
+    }
+    HPM_TEST_CHECK(HpmTestMchtmrTicks() - ts[n - 1] <= 10 * (TEST_MCHTMR_HZ / 1000000));
+
+    /* drained, the next edge reports again */
+    TestPulse(3);
+    TestRunUs(10);
+    HPM_TEST_CHECK_EQ(g_hits[3], 2);
+
+    /* a full ring counts the overflow */
+    for (uint32_t i = 0; i < 20; i++) {
+        TestPulse(3);
+        TestRunUs(10);
+    }
+    HPM_TEST_CHECK_EQ(HpmGpioGetEdgeStats(3, &stats), HDF_SUCCESS);
+    HPM_TEST_CHECK_EQ(stats.pending, 8);
+    HPM_TEST_CHECK_EQ(stats.dropped, 13);
+    HPM_TEST_CHECK_EQ(HpmGpioReadEdges(3, ts, 4), 4);
+    HPM_TEST_CHECK_EQ(HpmGpioReadEdges(3, ts, 16), 4);
+    HPM_TEST_CHECK_EQ(g_hits[3], 2);
+    TestClose();
+
+    /* no ring configured */
+    if (!TestOpen(0, 0)) {
+        return;
+    }
+    HPM_TEST_CHECK_EQ(HpmGpioReadEdges(3, ts, 16), HDF_ERR_NOT_SUPPORT);
+    HPM_TEST_CHECK_EQ(HpmGpioGetEdgeStats(3, &stats), HDF_ERR_NOT_SUPPORT);
+    TestClose();
+}
+
+/* The isr this driver replaced: one flag check and clear per pin */
+static void TestScanIsr(void)
+{
+    GPIO_Type *base = (GPIO_Type *)HPM_GPIO0_BASE;
+
+    for (uint32_t local = 0; local < TEST_PINS; local++) {
+        if (gpio_check_clear_interrupt_flag(base, TEST_PORT, local)) {
+            TestIrq((uint16_t)local, NULL);
+        }
+    }
+}
+
+static void TestBenchRow(const char *name, uint32_t pending, bool scan)
+{
+    uint64_t regs;
+    uint64_t start;
+
+    memset(g_hits, 0, sizeof(g_hits));
+    for (uint32_t pin = 0; pin < TEST_PINS; pin++) {
+        if (pending & (1U << pin)) {
+            TestPulse(pin);
+        }
+    }
+    regs = HpmTestMmioAccesses();
+    start = HpmTestNowNs();
+    if (scan) {
+        TestScanIsr();
+    } else {
+        HPM_TEST_CHECK(HpmTestIrqRaise(g_losIrq));
+    }
+    printf("%-8s %4u %8llu %8.0f\n", name, (unsigned)__builtin_popcount(pending),
+           (unsigned long long)(HpmTestMmioAccesses() - regs), (double)(HpmTestNowNs() - start));
+    HPM_TEST_CHECK_EQ(TestHits(), __builtin_popcount(pending));
+    HPM_TEST_CHECK_EQ(g_gpio.port[TEST_PORT].flags, 0);
+
+    /* empty rings, so every pin reports again in the next row */
+    for (uint16_t pin = 0; pin < TEST_PINS; pin++) {
+        uint32_t ts[16];
+        (void)HpmGpioReadEdges(pin, ts, 16);
+    }
+}
+
+/*
+ * Isr cost with 1 and 32 pending pins: register accesses and their time at
+ * TEST_MMIO_NS each. The code between the accesses is not timed.
+ */
+static void TestGpioBench(void)
+{
+    printf("%-8s %4s %8s %8s\n", "isr", "pins", "regs", "ns");
+    if (TestOpen(0, 0)) {
+        TestBenchRow("scan", 1U << 17, true);
+        TestBenchRow("scan", 0xFFFFFFFFU, true);
+        TestBenchRow("bitmap", 1U << 17, false);
+        TestBenchRow("bitmap", 0xFFFFFFFFU, false);
+        TestClose();
+    }
+    if (TestOpen(0, 16)) {
+        TestBenchRow("ring", 1U << 17, false);
+        TestBenchRow("ring", 0xFFFFFFFFU, false);
+        TestClose();
+    }
+}
+
+int main(void)
+{
+    HpmTestVirtualTime(true);
+    HpmTestMmioCostNs(TEST_MMIO_NS);
+    HpmTestMchtmrInit(TEST_MCHTMR_HZ);
+    HpmTestGpioInit(&g_gpio, HPM_GPIO0_BASE);
+    HpmTestGpioPortIrq(&g_gpio, TEST_PORT, IRQn_GPIO0_A);
+    g_losIrq = HPM2LITEOS_IRQ(IRQn_GPIO0_A);
+
+    TestGpioDispatch();
+    TestGpioInitFail();
+    TestGpioRingSizeLimit();
+    TestGpioDebounce();
+    TestGpioEdgeRing();
+    TestGpioBench();
+
+    HpmTestGpioDeinit(&g_gpio);
+    HpmTestMchtmrDeinit();
+    return HpmTestResult();
+}
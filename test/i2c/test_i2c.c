@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * drivers/platform/i2c.c against the i2c model, polled and interrupt driven:
+ * repeated start batches, segments over DATACNT, the STOP/NO_START/IGNORE_NO_ACK
+ * flags, nacks, arbitration loss, the timeout reset, 10 bit addressing, the bus
+ * speed property and the cpu cost per transfer.
+ */
+
+#include <string.h>
+#include "hdf_device_desc.h"
+#include "i2c_core.h"
+#include "hpm_soc.h"
+#include "soc.h"
+#include "hpm_test.h"
+#include "hpm_test_i2c.h"
+
+#define TEST_I2C_ID 0
+#define TEST_I2C_CLK 24000000U
+#define TEST_EEPROM_ADDR 0x50U
+#define TEST_EEPROM_SIZE 2048U
+#define TEST_TEN_BIT_ADDR 0x2A5U
+#define TEST_MS 1000000ULL
+#define TEST_MMIO_NS 20
+#define TEST_POLL_MMIO_NS 500
+
+extern struct HdfDriverEntry g_i2cDriverEntry;
+
+/* 24C16 style eeprom with a 16 bit address pointer, and a 10 bit addressed sink */
+struct TestDevice {
+    uint8_t mem[TEST_EEPROM_SIZE];
+    uint16_t ptr;
+    uint32_t wrIdx;
+    /* nack the data byte with this 1 based index after the address, 0 never */
+    uint32_t nackAt;
+    bool tenBitSelected;
+    uint32_t tenBitBytes;
+};
+
+static struct HpmTestI2c g_i2c;
+static struct TestDevice g_dev;
+static struct HdfDeviceObject *g_device;
+static struct I2cCntlr *g_cntlr;
+static uint32_t g_seed = 0x13579BDU;
+
+static bool TestDevAddress(void *ctx, uint16_t addr, bool tenBit, bool read)
+{
+    struct TestDevice *d = (struct TestDevice *)ctx;
+
+    (void)read;
+    d->wrIdx = 0;
+    d->tenBitSelected = tenBit && (addr == TEST_TEN_BIT_ADDR);
+    return d->tenBitSelected || (!tenBit && (addr == TEST_EEPROM_ADDR));
+}
+
+static bool TestDevWrite(void *ctx, uint8_t data)
+{
+    struct TestDevice *d = (struct TestDevice *)ctx;
+
+    if (d->tenBitSelected) {
+        d->tenBitBytes++;
+        return true;
+    }
+    d->wrIdx++;
+    if (d->wrIdx == d->nackAt) {
+        return false;
+    }
+    if (d->wrIdx == 1) {
+        d->ptr = (uint16_t)(data << 8);
+    } else if (d->wrIdx == 2) {
+        d->ptr |= data;
+    } else {
+        d->mem[d->ptr++ % TEST_EEPROM_SIZE] = data;
+    }
+    return true;
+}
+
+static uint8_t TestDevRead(void *ctx)
+{
+    struct TestDevice *d = (struct TestDevice *)ctx;
+
+    return d->mem[d->ptr++ % TEST_EEPROM_SIZE];
+}
+
+static void TestFill(uint8_t *buf, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)HpmTestRand(&g_seed);
+    }
+}
+
+static bool TestOpen(uint32_t irq, uint32_t busSpeed)
+{
+    const struct HpmTestProp props[] = {
+        { "id", TEST_I2C_ID, NULL },
+        { "base", HPM_I2C0_BASE, NULL },
+        { "clk_freq", TEST_I2C_CLK, NULL },
+        { "irq_num", irq, NULL },
+        { "bus_speed", busSpeed, NULL },
+        { NULL, 0, NULL },
+    };
+
+    g_device = HpmTestDeviceCreate(props);
+    if (!HPM_TEST_CHECK_EQ(g_i2cDriverEntry.Bind(g_device), HDF_SUCCESS) ||
+        !HPM_TEST_CHECK_EQ(g_i2cDriverEntry.Init(g_device), HDF_SUCCESS)) {
+        HpmTestDeviceDestroy(g_device);
+        return false;
+    }
+    g_cntlr = I2cCntlrGet(TEST_I2C_ID);
+    return HPM_TEST_CHECK(g_cntlr != NULL);
+}
+
+static void TestClose(void)
+{
+    g_i2cDriverEntry.Release(g_device);
+    HpmTestDeviceDestroy(g_device);
+    HPM_TEST_CHECK(I2cCntlrGet(TEST_I2C_ID) == NULL);
+    g_cntlr = NULL;
+}
+
+static int32_t TestTransfer(struct I2cMsg *msgs, int16_t count)
+{
+    return g_cntlr->ops->transfer(g_cntlr, msgs, count);
+}
+
+/* Random read: pointer write, repeated start, read; every length around the 256 byte segments */
+static void TestI2cRandomRead(void)
+{
+    static const uint16_t lens[] = { 1, 6, 255, 256, 257, 600, 1024 };
+    static uint8_t rbuf[1024 + 1];
+    uint8_t ptr[2];
+    struct I2cMsg msgs[2] = {
+        { .addr = TEST_EEPROM_ADDR, .buf = ptr, .len = sizeof(ptr), .flags = 0 },
+        { .addr = TEST_EEPROM_ADDR, .buf = rbuf, .flags = I2C_FLAG_READ },
+    };
+
+    TestFill(g_dev.mem, sizeof(g_dev.mem));
+    for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        uint16_t at = (uint16_t)(HpmTestRand(&g_seed) % TEST_EEPROM_SIZE);
+        uint32_t starts = g_i2c.starts;
+        uint32_t repeated = g_i2c.repeatedStarts;
+        uint32_t stops = g_i2c.stops;
+        uint32_t transactions = g_i2c.transactions;
+
+        ptr[0] = (uint8_t)(at >> 8);
+        ptr[1] = (uint8_t)at;
+        msgs[1].len = lens[i];
+        memset(rbuf, 0, sizeof(rbuf));
+        HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), 2);
+        for (uint32_t k = 0; k < lens[i]; k++) {
+            if (!HPM_TEST_CHECK_EQ(rbuf[k], g_dev.mem[(at + k) % TEST_EEPROM_SIZE])) {
+                break;
+            }
+        }
+        HPM_TEST_CHECK_EQ(rbuf[lens[i]], 0);
+        HPM_TEST_CHECK_EQ(g_i2c.starts - starts, 2);
+        HPM_TEST_CHECK_EQ(g_i2c.repeatedStarts - repeated, 1);
+        HPM_TEST_CHECK_EQ(g_i2c.stops - stops, 1);
+        HPM_TEST_CHECK_EQ(g_i2c.transactions - transactions, 1 + (lens[i] + 255) / 256);
+    }
+}
+
+/* One message over several segments: one START and one address, data lands in order */
+static void TestI2cPageWrite(void)
+{
+    static const uint16_t lens[] = { 1, 254, 256, 600 };
+    static uint8_t wbuf[2 + 600];
+    struct I2cMsg msg = { .addr = TEST_EEPROM_ADDR, .buf = wbuf, .flags = 0 };
+
+    for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        uint16_t at = 0x100;
+        uint32_t addrPhases = g_i2c.addrPhases;
+        uint32_t transactions = g_i2c.transactions;
+
+        TestFill(wbuf, sizeof(wbuf));
+        wbuf[0] = (uint8_t)(at >> 8);
+        wbuf[1] = (uint8_t)at;
+        msg.len = 2 + lens[i];
+        HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), 1);
+        HPM_TEST_CHECK_EQ(memcmp(&g_dev.mem[at], &wbuf[2], lens[i]), 0);
+        HPM_TEST_CHECK_EQ(g_i2c.addrPhases - addrPhases, 1);
+        HPM_TEST_CHECK_EQ(g_i2c.transactions - transactions, (msg.len + 255) / 256);
+        HPM_TEST_CHECK(!g_i2c.busHeld);
+    }
+}
+
+/* NO_START continues the previous write, STOP ends the transaction in the middle of a batch */
+static void TestI2cFlags(void)
+{
+    uint8_t ptr[2] = { 0x02, 0x00 };
+    uint8_t data[20];
+    uint8_t rbuf[20];
+    struct I2cMsg msgs[2] = {
+        { .addr = TEST_EEPROM_ADDR, .buf = ptr, .len = sizeof(ptr), .flags = 0 },
+        { .addr = TEST_EEPROM_ADDR, .buf = data, .len = sizeof(data), .flags = I2C_FLAG_NO_START },
+    };
+    uint32_t addrPhases = g_i2c.addrPhases;
+    uint32_t stops = g_i2c.stops;
+
+    TestFill(data, sizeof(data));
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), 2);
+    HPM_TEST_CHECK_EQ(g_i2c.addrPhases - addrPhases, 1);
+    HPM_TEST_CHECK_EQ(memcmp(&g_dev.mem[0x200], data, sizeof(data)), 0);
+
+    msgs[0].flags = I2C_FLAG_STOP;
+    msgs[1].buf = rbuf;
+    msgs[1].len = sizeof(rbuf);
+    msgs[1].flags = I2C_FLAG_READ;
+    stops = g_i2c.stops;
+    uint32_t repeated = g_i2c.repeatedStarts;
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), 2);
+    HPM_TEST_CHECK_EQ(memcmp(rbuf, data, sizeof(data)), 0);
+    HPM_TEST_CHECK_EQ(g_i2c.stops - stops, 2);
+    HPM_TEST_CHECK_EQ(g_i2c.repeatedStarts - repeated, 0);
+}
+
+/* Address and data nacks fail the batch and release the bus, unless the message ignores them */
+static void TestI2cNack(void)
+{
+    uint8_t wbuf[12] = { 0x03, 0x00 };
+    uint8_t rbuf[4];
+    struct I2cMsg msgs[2] = {
+        { .addr = TEST_EEPROM_ADDR, .buf = wbuf, .len = sizeof(wbuf), .flags = 0 },
+        { .addr = TEST_EEPROM_ADDR + 1, .buf = rbuf, .len = sizeof(rbuf), .flags = I2C_FLAG_READ },
+    };
+
+    /* nobody at the address of the second message */
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), HDF_ERR_IO);
+    HPM_TEST_CHECK(!g_i2c.busHeld);
+
+    /* nack in the middle and at the last byte */
+    g_dev.nackAt = 5;
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 1), HDF_ERR_IO);
+    HPM_TEST_CHECK(!g_i2c.busHeld);
+    g_dev.nackAt = sizeof(wbuf);
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 1), HDF_ERR_IO);
+    HPM_TEST_CHECK(!g_i2c.busHeld);
+
+    /* an ignored nack ends the message, the batch goes on */
+    g_dev.nackAt = 5;
+    msgs[0].flags = I2C_FLAG_IGNORE_NO_ACK;
+    msgs[1].addr = TEST_EEPROM_ADDR;
+    memset(rbuf, 0, sizeof(rbuf));
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), 2);
+    HPM_TEST_CHECK_EQ(rbuf[0], g_dev.mem[0x302]);
+    HPM_TEST_CHECK(!g_i2c.busHeld);
+    g_dev.nackAt = 0;
+
+    msgs[0].flags = 0;
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), 2);
+    HPM_TEST_CHECK_EQ(memcmp(&g_dev.mem[0x300], &wbuf[2], sizeof(wbuf) - 2), 0);
+}
+
+/* Lost arbitration fails the batch without a STOP from us, the next transfer works */
+static void TestI2cArbitration(void)
+{
+    uint8_t ptr[2] = { 0, 0 };
+    uint8_t rbuf[16];
+    struct I2cMsg msgs[2] = {
+        { .addr = TEST_EEPROM_ADDR, .buf = ptr, .len = sizeof(ptr), .flags = 0 },
+        { .addr = TEST_EEPROM_ADDR, .buf = rbuf, .len = sizeof(rbuf), .flags = I2C_FLAG_READ },
+    };
+    uint32_t stops = g_i2c.stops;
+
+    g_i2c.arbLoseAtByte = (uint32_t)g_i2c.bytes + 5;
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), HDF_ERR_IO);
+    HPM_TEST_CHECK_EQ(g_i2c.stops - stops, 0);
+    g_i2c.arbLoseAtByte = 0;
+
+    HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), 2);
+    HPM_TEST_CHECK_EQ(memcmp(rbuf, g_dev.mem, sizeof(rbuf)), 0);
+}
+
+/* A stuck bus times out after HPM_I2C_XFER_TIMEOUT_MS and the controller is reset */
+static void TestI2cTimeout(void)
+{
+    uint8_t rbuf[16];
+    struct I2cMsg msg = { .addr = TEST_EEPROM_ADDR, .buf = rbuf, .len = sizeof(rbuf), .flags = I2C_FLAG_READ };
+    uint32_t resets = g_i2c.resets;
+    uint64_t start;
+
+    /* the polled path spins for the whole second, coarser register timing keeps that short on the host */
+    HpmTestMmioCostNs(10000);
+    g_i2c.stalled = true;
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), HDF_ERR_TIMEOUT);
+    HpmTestMmioCostNs(TEST_POLL_MMIO_NS);
+    HPM_TEST_CHECK(HpmTestNowNs() - start >= 1000 * TEST_MS);
+    HPM_TEST_CHECK(HpmTestNowNs() - start < 1100 * TEST_MS);
+    HPM_TEST_CHECK(g_i2c.resets > resets);
+    g_i2c.stalled = false;
+
+    HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), 1);
+}
+
+/* A 10 bit message must not leave the controller in 10 bit mode */
+static void TestI2cTenBit(void)
+{
+    uint8_t wbuf[3] = { 1, 2, 3 };
+    uint8_t rbuf[4];
+    struct I2cMsg msg = { .addr = TEST_TEN_BIT_ADDR, .buf = wbuf, .len = sizeof(wbuf), .flags = I2C_FLAG_ADDR_10BIT };
+    uint32_t bytes = g_dev.tenBitBytes;
+
+    HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), 1);
+    HPM_TEST_CHECK_EQ(g_dev.tenBitBytes - bytes, sizeof(wbuf));
+
+    msg.addr = TEST_EEPROM_ADDR;
+    msg.buf = rbuf;
+    msg.len = sizeof(rbuf);
+    msg.flags = I2C_FLAG_READ;
+    HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), 1);
+}
+
+static void TestI2cAll(uint32_t irq)
+{
+    if (!TestOpen(irq, 1000000)) {
+        return;
+    }
+    /* fewer polling rounds per byte on the host, the bench below runs at TEST_MMIO_NS */
+    HpmTestMmioCostNs(TEST_POLL_MMIO_NS);
+    TestI2cRandomRead();
+    TestI2cPageWrite();
+    TestI2cFlags();
+    TestI2cNack();
+    TestI2cArbitration();
+    TestI2cTimeout();
+    TestI2cTenBit();
+    HpmTestMmioCostNs(TEST_MMIO_NS);
+    TestClose();
+}
+
+/* The bus_speed property picks the mode, scl never runs above it (1 % for the timing rounding) */
+static void TestI2cSpeed(void)
+{
+    static const uint32_t speeds[] = { 100000, 400000, 1000000 };
+
+    for (uint32_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        if (!TestOpen(IRQn_I2C0, speeds[i])) {
+            return;
+        }
+        HPM_TEST_CHECK(HpmTestI2cSclHz(&g_i2c) <= speeds[i] / 100 * 101);
+        HPM_TEST_CHECK(HpmTestI2cSclHz(&g_i2c) > speeds[i] * 8 / 10);
+        TestClose();
+    }
+}
+
+/*
+ * Cpu cost per transfer, polled against interrupt driven: register accesses
+ * and interrupts for a sensor register read (1 byte out, 6 in) and a 256 byte
+ * block read. The polled path spins on STATUS for the whole wire time.
+ */
+static void TestI2cBench(void)
+{
+    static const uint16_t lens[] = { 6, 256 };
+    static const uint32_t irqs[] = { 0, IRQn_I2C0 };
+    static uint8_t rbuf[256];
+    uint8_t reg = 0;
+    struct I2cMsg msgs[2] = {
+        { .addr = TEST_EEPROM_ADDR, .buf = &reg, .len = 1, .flags = 0 },
+        { .addr = TEST_EEPROM_ADDR, .buf = rbuf, .flags = I2C_FLAG_READ },
+    };
+    uint32_t losIrq = HPM2LITEOS_IRQ(IRQn_I2C0);
+
+    printf("%6s %6s %10s %10s %8s\n", "mode", "bytes", "us", "regs", "irqs");
+    for (uint32_t m = 0; m < sizeof(irqs) / sizeof(irqs[0]); m++) {
+        if (!TestOpen(irqs[m], 400000)) {
+            return;
+        }
+        for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+            uint64_t regs = HpmTestMmioAccesses();
+            uint32_t irqCount = HpmTestIrqCount(losIrq);
+            uint64_t start = HpmTestNowNs();
+
+            msgs[1].len = lens[i];
+            HPM_TEST_CHECK_EQ(TestTransfer(msgs, 2), 2);
+            printf("%6s %6u %10.1f %10llu %8u\n", (irqs[m] != 0) ? "irq" : "poll", lens[i],
+                   (HpmTestNowNs() - start) / 1000.0, (unsigned long long)(HpmTestMmioAccesses() - regs),
+                   HpmTestIrqCount(losIrq) - irqCount);
+        }
+        TestClose();
+    }
+}
+
+int main(void)
+{
+    HpmTestVirtualTime(true);
+    HpmTestMmioCostNs(TEST_MMIO_NS);
+    HpmTestI2cInit(&g_i2c, HPM_I2C0_BASE, IRQn_I2C0, TEST_I2C_CLK);
+    g_i2c.bus.address = TestDevAddress;
+    g_i2c.bus.write = TestDevWrite;
+    g_i2c.bus.read = TestDevRead;
+    g_i2c.bus.ctx = &g_dev;
+
+    TestI2cAll(0);
+    TestI2cAll(IRQn_I2C0);
+    TestI2cSpeed();
+    TestI2cBench();
+
+    HpmTestI2cDeinit(&g_i2c);
+    return HpmTestResult();
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * hpm6700/liteos_m/dprintf.c with the log task on the host task stand-in:
+ * early synchronous output, lines queued from tasks and isrs, the full ring,
+ * synchronous output with interrupts locked or after an exception, and the
+ * producer cost per line.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "los_debug.h"
+#include "los_interrupt.h"
+#include "hpm_soc.h"
+#include "soc.h"
+#include "hpm_test.h"
+
+#define TEST_LINES 64
+#define TEST_LINE_LEN 100
+
+int __wrap_printf(char const *fmt, ...);
+int HiLogWriteInternal(const char *buffer, size_t bufLen);
+UINT32 DprintfTaskInit(VOID);
+
+static uint32_t g_losIrq;
+static const char *g_isrLine;
+
+static void TestIsr(void *arg)
+{
+    (void)arg;
+    (void)__wrap_printf("%s", g_isrLine);
+}
+
+static void TestIsrPrintf(const char *line)
+{
+    g_isrLine = line;
+    HPM_TEST_CHECK(HpmTestIrqRaise(g_losIrq));
+}
+
+static void TestLogEarly(void)
+{
+    HpmTestConsoleReset();
+    (void)__wrap_printf("boot %d\n", 1);
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "boot 1\n"), 0);
+
+    HPM_TEST_CHECK_EQ(DprintfTaskInit(), LOS_OK);
+    HpmTestTaskRun();
+}
+
+static void TestLogQueued(void)
+{
+    uint64_t maxNs;
+    uint64_t totalNs;
+    uint32_t count;
+    const char hilog[] = "hilog";
+
+    HpmTestConsoleReset();
+    HpmTestIntLockStatsReset();
+    (void)__wrap_printf("task %s\n", "line");
+    (void)HiLogWriteInternal(hilog, sizeof(hilog));
+    HpmTestIntLockStats(&maxNs, &totalNs, &count);
+    HPM_TEST_CHECK_EQ(count, 0);
+    HPM_TEST_CHECK_EQ(strlen(HpmTestConsole()), 0);
+
+    TestIsrPrintf("isr line\n");
+    HPM_TEST_CHECK_EQ(strlen(HpmTestConsole()), 0);
+
+    HpmTestTaskRun();
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "task line\nhilog\nisr line\n"), 0);
+    HPM_TEST_CHECK_EQ(HpmTestConsoleLocked(), 0);
+}
+
+static void TestLogFull(void)
+{
+    char line[TEST_LINE_LEN + 1];
+    const char *note;
+    uint32_t printed = 0;
+    uint32_t dropped = 0;
+
+    (void)memset(line, 'x', sizeof(line));
+    line[TEST_LINE_LEN - 1] = '\n';
+    line[TEST_LINE_LEN] = '\0';
+
+    HpmTestConsoleReset();
+    for (uint32_t i = 0; i < TEST_LINES; i++) {
+        (void)__wrap_printf("%s", line);
+    }
+    HpmTestTaskRun();
+
+    for (const char *p = HpmTestConsole(); (p = strstr(p, line)) != NULL; p += TEST_LINE_LEN) {
+        printed++;
+    }
+    note = strstr(HpmTestConsole(), "[log] ");
+    HPM_TEST_CHECK(note != NULL);
+    if (note != NULL) {
+        HPM_TEST_CHECK_EQ(sscanf(note, "[log] %u lines dropped", &dropped), 1);
+    }
+    HPM_TEST_CHECK(dropped != 0);
+    HPM_TEST_CHECK_EQ(printed + dropped, TEST_LINES);
+
+    /* the ring is usable again */
+    HpmTestConsoleReset();
+    (void)__wrap_printf("after\n");
+    HpmTestTaskRun();
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "after\n"), 0);
+}
+
+/* A task spinning with interrupts locked never lets the log task run */
+static void TestLogIntLocked(void)
+{
+    UINT32 intSave;
+
+    HpmTestConsoleReset();
+    (void)__wrap_printf("queued\n");
+    intSave = LOS_IntLock();
+    (void)__wrap_printf("locked\n");
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "queued\nlocked\n"), 0);
+    LOS_IntRestore(intSave);
+
+    /* nothing is printed twice, and the log task carries on */
+    HpmTestTaskRun();
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "queued\nlocked\n"), 0);
+    (void)__wrap_printf("unlocked\n");
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "queued\nlocked\n"), 0);
+    HpmTestTaskRun();
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "queued\nlocked\nunlocked\n"), 0);
+}
+
+/* After an exception the log task is gone, everything goes out at once */
+static void TestLogException(void)
+{
+    HpmTestConsoleReset();
+    TestIsrPrintf("before\n");
+    OsDoExcHook(EXC_INTERRUPT);
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "before\n"), 0);
+
+    TestIsrPrintf("exc isr\n");
+    (void)__wrap_printf("exc task\n");
+    HPM_TEST_CHECK_EQ(strcmp(HpmTestConsole(), "before\nexc isr\nexc task\n"), 0);
+}
+
+/*
+ * Producer cost of a 64 byte line in host time, and the interrupt lock it
+ * takes, queued against written out with interrupts locked.
+ */
+static void TestLogBench(void)
+{
+    const uint32_t lines = 32;
+    uint64_t maxNs;
+    uint64_t totalNs;
+    uint32_t count;
+    uint64_t start;
+    uint64_t queuedNs;
+    uint64_t syncNs;
+    UINT32 intSave;
+
+    HpmTestConsoleReset();
+    HpmTestIntLockStatsReset();
+    start = HpmTestHostNs();
+    for (uint32_t i = 0; i < lines; i++) {
+        (void)__wrap_printf("%-56s %6u\n", "bench line", (unsigned)i);
+    }
+    queuedNs = HpmTestHostNs() - start;
+    HpmTestIntLockStats(&maxNs, &totalNs, &count);
+    HPM_TEST_CHECK_EQ(count, 0);
+    HpmTestTaskRun();
+    HPM_TEST_CHECK_EQ(strlen(HpmTestConsole()), lines * 64);
+
+    HpmTestConsoleReset();
+    start = HpmTestHostNs();
+    for (uint32_t i = 0; i < lines; i++) {
+        intSave = LOS_IntLock();
+        (void)__wrap_printf("%-56s %6u\n", "bench line", (unsigned)i);
+        LOS_IntRestore(intSave);
+    }
+    syncNs = HpmTestHostNs() - start;
+    HPM_TEST_CHECK_EQ(strlen(HpmTestConsole()), lines * 64);
+    printf("64 byte line: queued %.0f ns, no int lock; synchronous %.0f ns under int lock (host time)\n",
+           (double)queuedNs / lines, (double)syncNs / lines);
+}
+
+int main(void)
+{
+    HwiIrqParam param = { 0 };
+
+    g_losIrq = HPM2LITEOS_IRQ(IRQn_UART0);
+    HPM_TEST_CHECK_EQ(LOS_HwiCreate(g_losIrq, 0, 0, TestIsr, &param), LOS_OK);
+    HPM_TEST_CHECK_EQ(LOS_HwiEnable(g_losIrq), LOS_OK);
+
+    TestLogEarly();
+    TestLogQueued();
+    TestLogFull();
+    TestLogIntLocked();
+    TestLogBench();
+    TestLogException();
+
+    return HpmTestResult();
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * sdk/hpm_sdk/middleware/hpm_mcl_v2/core/control/hpm_mcl_math.c: the sine
+ * table, the fused sincos, the polynomial atan2 and the Q31 kernels against
+ * double precision libm over several turns, with their cost next to the
+ * float libm calls the control loops used before.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "hpm_mcl_common.h"
+#include "hpm_mcl_math.h"
+#include "hpm_test.h"
+
+#define TEST_PI 3.14159265358979323846
+#define TEST_TURN_Q31 4294967296.0
+#define TEST_POINTS 200001U
+#define TEST_SIN_MAX_ERR 3e-5
+#define TEST_ATAN2_MAX_ERR 2e-5
+#define TEST_BENCH_SIZE 4096U
+
+static float g_x[TEST_BENCH_SIZE];
+static float g_y[TEST_BENCH_SIZE];
+static int32_t g_xq[TEST_BENCH_SIZE];
+static int32_t g_yq[TEST_BENCH_SIZE];
+
+static double TestAngleDiff(double a, double b)
+{
+    double d = fabs(a - b);
+
+    d = fmod(d, 2.0 * TEST_PI);
+    return (d > TEST_PI) ? (2.0 * TEST_PI - d) : d;
+}
+
+/* Angles from -8 to +8 turns, the table index wraps */
+static void TestFloat(void)
+{
+    double errSin = 0;
+    double errCos = 0;
+    double errAtan2 = 0;
+    uint32_t mismatch = 0;
+
+    for (uint32_t i = 0; i < TEST_POINTS; i++) {
+        float x = -50.0f + 100.0f * (float)i / (float)(TEST_POINTS - 1U);
+        float y = sinf(x * 1.3f) * 3.0f;
+        float z = cosf(x * 0.7f) * 2.0f;
+        float s;
+        float c;
+
+        hpm_mcl_math_sincos(x, &s, &c);
+        errSin = fmax(errSin, fabs(s - sin(x)));
+        errCos = fmax(errCos, fabs(c - cos(x)));
+        mismatch += ((hpm_mcl_math_sin(x) != s) || (hpm_mcl_math_cos(x) != c)) ? 1U : 0U;
+        errAtan2 = fmax(errAtan2, TestAngleDiff(hpm_mcl_math_atan2(y, z), atan2(y, z)));
+    }
+    printf("float: max error sin %.2e cos %.2e atan2 %.2e rad\n", errSin, errCos, errAtan2);
+    HPM_TEST_CHECK(errSin < TEST_SIN_MAX_ERR);
+    HPM_TEST_CHECK(errCos < TEST_SIN_MAX_ERR);
+    HPM_TEST_CHECK(errAtan2 < TEST_ATAN2_MAX_ERR);
+    HPM_TEST_CHECK_EQ(mismatch, 0);
+
+    /* the axes and the quadrant boundaries */
+    HPM_TEST_CHECK(fabs(hpm_mcl_math_atan2(0.0f, 1.0f)) < TEST_ATAN2_MAX_ERR);
+    HPM_TEST_CHECK(TestAngleDiff(hpm_mcl_math_atan2(0.0f, -1.0f), TEST_PI) < TEST_ATAN2_MAX_ERR);
+    HPM_TEST_CHECK(fabs(hpm_mcl_math_atan2(1.0f, 0.0f) - TEST_PI / 2.0) < TEST_ATAN2_MAX_ERR);
+    HPM_TEST_CHECK(fabs(hpm_mcl_math_atan2(-1.0f, 0.0f) + TEST_PI / 2.0) < TEST_ATAN2_MAX_ERR);
+    HPM_TEST_CHECK(fabs(hpm_mcl_math_atan2(1.0f, 1.0f) - TEST_PI / 4.0) < TEST_ATAN2_MAX_ERR);
+}
+
+static double TestQ31Angle(mcl_q31_angle_t angle)
+{
+    return (double)angle * (2.0 * TEST_PI / TEST_TURN_Q31);
+}
+
+static void TestQ31(void)
+{
+    double errSincos = 0;
+    double errAtan2 = 0;
+    double errPark = 0;
+    int32_t alpha;
+    int32_t beta;
+    int32_t s;
+    int32_t c;
+
+    for (uint32_t i = 0; i < TEST_POINTS; i++) {
+        mcl_q31_angle_t angle = (mcl_q31_angle_t)((uint64_t)i * 21474836ULL + 12345U);
+        double a = TestQ31Angle(angle);
+        float y = sinf((float)i * 1e-4f * 1.3f) * 0.9f;
+        float x = cosf((float)i * 1e-4f * 0.7f) * 0.6f;
+        int32_t d;
+        int32_t q;
+        int32_t alpha2;
+        int32_t beta2;
+
+        hpm_mcl_math_sincos_q31(angle, &s, &c);
+        errSincos = fmax(errSincos, fabs(MCL_Q31_TO_FLOAT(s) - sin(a)));
+        errSincos = fmax(errSincos, fabs(MCL_Q31_TO_FLOAT(c) - cos(a)));
+        errAtan2 = fmax(errAtan2, TestAngleDiff(TestQ31Angle(hpm_mcl_math_atan2_q31(MCL_FLOAT_TO_Q31(y),
+                                                                                 MCL_FLOAT_TO_Q31(x))),
+                                                 atan2(MCL_FLOAT_TO_Q31(y), MCL_FLOAT_TO_Q31(x))));
+
+        /* park then inverse park at the same angle returns the stationary frame, scaled by sin^2 + cos^2 */
+        alpha = MCL_FLOAT_TO_Q31(x);
+        beta = MCL_FLOAT_TO_Q31(y * 0.5f);
+        hpm_mcl_math_park_q31(alpha, beta, s, c, &d, &q);
+        hpm_mcl_math_inv_park_q31(d, q, s, c, &alpha2, &beta2);
+        errPark = fmax(errPark, fabs(MCL_Q31_TO_FLOAT(alpha2 - alpha)));
+        errPark = fmax(errPark, fabs(MCL_Q31_TO_FLOAT(beta2 - beta)));
+    }
+    printf("q31: max error sincos %.2e atan2 %.2e rad, park round trip %.2e\n", errSincos, errAtan2, errPark);
+    HPM_TEST_CHECK(errSincos < TEST_SIN_MAX_ERR);
+    HPM_TEST_CHECK(errAtan2 < TEST_ATAN2_MAX_ERR);
+    HPM_TEST_CHECK(errPark < 2.0 * TEST_SIN_MAX_ERR);
+
+    /* clarke: alpha = ia, beta = (ia + 2 ib) / sqrt(3), saturated */
+    hpm_mcl_math_clarke_q31(MCL_FLOAT_TO_Q31(0.5f), MCL_FLOAT_TO_Q31(-0.25f), &alpha, &beta);
+    HPM_TEST_CHECK(fabs(MCL_Q31_TO_FLOAT(alpha) - 0.5) < 1e-6);
+    HPM_TEST_CHECK(fabs(MCL_Q31_TO_FLOAT(beta) - 0.0) < 1e-6);
+    hpm_mcl_math_clarke_q31(MCL_Q31_ONE, MCL_Q31_ONE, &alpha, &beta);
+    HPM_TEST_CHECK_EQ(beta, MCL_Q31_ONE);
+    hpm_mcl_math_clarke_q31(-MCL_Q31_ONE, -MCL_Q31_ONE, &alpha, &beta);
+    HPM_TEST_CHECK_EQ(beta, -MCL_Q31_ONE);
+
+    /* a quarter turn and the degenerate atan2 arguments */
+    hpm_mcl_math_sincos_q31(0x40000000U, &s, &c);
+    HPM_TEST_CHECK(MCL_Q31_TO_FLOAT(s) > 0.99999f);
+    HPM_TEST_CHECK(fabs(MCL_Q31_TO_FLOAT(c)) < 1e-6);
+    HPM_TEST_CHECK(TestAngleDiff(TestQ31Angle(hpm_mcl_math_atan2_q31(0, -MCL_Q31_ONE)), TEST_PI) < TEST_ATAN2_MAX_ERR);
+    HPM_TEST_CHECK(TestAngleDiff(TestQ31Angle(hpm_mcl_math_atan2_q31(INT32_MIN, 0)), 1.5 * TEST_PI) <
+                   TEST_ATAN2_MAX_ERR);
+}
+
+#define TEST_BENCH(name, expr)                                                       \
+    do {                                                                             \
+        uint64_t t0 = HpmTestHostNs();                                               \
+        for (uint32_t r = 0; r < rounds; r++) {                                      \
+            for (uint32_t i = 0; i < TEST_BENCH_SIZE; i++) {                         \
+                expr;                                                                \
+            }                                                                        \
+        }                                                                            \
+        printf("%-16s %.1f ns\n", name,                                              \
+               (double)(HpmTestHostNs() - t0) / ((double)rounds * TEST_BENCH_SIZE)); \
+    } while (0)
+
+static void TestBench(void)
+{
+    uint32_t rounds = HpmTestFull() ? 2000U : 200U;
+    volatile float sink = 0;
+    volatile int32_t sinkQ31 = 0;
+    float s;
+    float c;
+    int32_t sq;
+    int32_t cq;
+
+    for (uint32_t i = 0; i < TEST_BENCH_SIZE; i++) {
+        g_x[i] = (float)((i * 7919U) % 62831U) * 1e-4f - 3.14f;
+        g_y[i] = (float)((i * 104729U) % 20000U) * 1e-4f - 1.0f;
+        g_xq[i] = MCL_FLOAT_TO_Q31(g_x[i] / 4.0f);
+        g_yq[i] = MCL_FLOAT_TO_Q31(g_y[i]);
+    }
+    TEST_BENCH("libm sinf+cosf", sink += sinf(g_x[i]) + cosf(g_x[i]));
+    TEST_BENCH("table sin+cos", sink += hpm_mcl_math_sin(g_x[i]) + hpm_mcl_math_cos(g_x[i]));
+    TEST_BENCH("table sincos", hpm_mcl_math_sincos(g_x[i], &s, &c); sink += s + c);
+    TEST_BENCH("libm atan2f", sink += atan2f(g_y[i], g_x[i]));
+    TEST_BENCH("poly atan2", sink += hpm_mcl_math_atan2(g_y[i], g_x[i]));
+    TEST_BENCH("q31 sincos", hpm_mcl_math_sincos_q31((r * TEST_BENCH_SIZE + i) * 2654435761U, &sq, &cq);
+               sinkQ31 += sq + cq);
+    TEST_BENCH("q31 atan2", sinkQ31 += (int32_t)hpm_mcl_math_atan2_q31(g_yq[i], g_xq[i]));
+    HPM_TEST_CHECK(sink == sink);
+}
+
+int main(void)
+{
+    hpm_mcl_math_init();
+    TestFloat();
+    TestQ31();
+    TestBench();
+    return HpmTestResult();
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Stand-in for the board header the serial nor spi host includes */
+
+#ifndef HPM_TEST_BOARD_H
+#define HPM_TEST_BOARD_H
+
+#include "hpm_soc.h"
+
+#define BOARD_RUNNING_CORE HPM_CORE0
+
+#endif
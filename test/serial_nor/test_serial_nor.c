@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * sdk/hpm_sdk/components/serial_nor on the SPI and DMA models with a SPI NOR
+ * part on the bus: SFDP probing, program and read back, and the job queue
+ * against the blocking calls: how long an urgent read waits while the log
+ * partition is erased and programmed, and that erases still finish under a
+ * stream of urgent reads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "hpm_soc.h"
+#include "hpm_spi_drv.h"
+#include "hpm_l1c_drv.h"
+#include "hpm_serial_nor.h"
+#include "hpm_serial_nor_queue.h"
+#include "hpm_test.h"
+#include "hpm_test_dma.h"
+#include "hpm_test_gpio.h"
+#include "hpm_test_spi_nor.h"
+
+#define TEST_SPI_CLK 80000000U
+#define TEST_MCHTMR_HZ 24000000U
+#define TEST_MMIO_NS 40U
+#define TEST_RX_CH 0U
+#define TEST_TX_CH 1U
+#define TEST_NOR_SIZE (16U * 1024U * 1024U)
+#define TEST_PAGE_NS 700000ULL
+#define TEST_SECTOR_NS 45000000ULL
+#define TEST_BLOCK_NS 400000000ULL
+#define TEST_SUSPEND_NS 20000ULL
+/* a wait in a busy loop of the blocking calls, see hpm_spi_nor_udelay() */
+#define TEST_BUSY_POLL_NS 1000000ULL
+/* application image read by the urgent reads, then the log partition */
+#define TEST_APP_SIZE 0x100000U
+#define TEST_LOG_BASE 0x800000U
+#define TEST_LOG_LEN 4096U
+#define TEST_READ_LEN 200U
+#define TEST_READ_SLOTS 8U
+#define TEST_POLL_NS 250000ULL
+#define TEST_READ_EVERY_NS 5000000ULL
+#define TEST_DENSE_POLL_NS 50000ULL
+#define TEST_DENSE_READ_EVERY_NS 60000ULL
+#define TEST_DENSE_READ_LEN 32U
+
+struct TestRead {
+    hpm_serial_nor_job_t job;
+    bool busy;
+    uint64_t arrivalNs;
+    uint8_t buf[TEST_READ_LEN] __attribute__((aligned(HPM_L1C_CACHELINE_SIZE)));
+};
+
+struct TestLatency {
+    uint64_t maxNs;
+    uint64_t sumNs;
+    uint32_t count;
+    uint32_t errors;
+};
+
+static struct HpmTestSpi g_spi;
+static struct HpmTestSpiNor g_nor;
+static hpm_serial_nor_t g_flash;
+static hpm_serial_nor_info_t g_info;
+static hpm_serial_nor_queue_t g_queue;
+static struct TestRead g_reads[TEST_READ_SLOTS];
+static struct TestLatency g_latency;
+static uint32_t g_logDone;
+static uint8_t g_logBuf[TEST_LOG_LEN];
+static uint8_t g_buf[0x10000] __attribute__((aligned(HPM_L1C_CACHELINE_SIZE)));
+
+static uint8_t TestPattern(uint32_t addr)
+{
+    return (uint8_t)((addr * 2654435761U) >> 24);
+}
+
+static void TestSetCs(uint32_t pin, uint8_t state)
+{
+    (void)pin;
+    HpmTestSpiNorSelect(&g_nor, state == 0);
+}
+
+static void TestSetFrequency(void *host, uint32_t freq)
+{
+    spi_timing_config_t timing = { 0 };
+
+    (void)host;
+    timing.master_config.clk_src_freq_in_hz = TEST_SPI_CLK;
+    timing.master_config.sclk_freq_in_hz = freq;
+    (void)spi_master_timing_init(HPM_SPI1, &timing);
+}
+
+/*
+ * The blocking calls poll the status register every 1 us, and a poll is a few
+ * us of register accesses here. While the part is busy a wait is charged as
+ * TEST_BUSY_POLL_NS instead: far fewer traps, and the blocking calls come out
+ * that much longer at most.
+ */
+void hpm_spi_nor_udelay(uint32_t us)
+{
+    HpmTestCpuNs(HpmTestSpiNorBusy(&g_nor) ? TEST_BUSY_POLL_NS : (uint64_t)us * 1000ULL);
+}
+
+static hpm_stat_t TestFlashInit(uint32_t flags)
+{
+    hpm_nor_host_param_t *param = &g_flash.host.host_param.param;
+
+    (void)memset(&g_flash, 0, sizeof(g_flash));
+    g_flash.host.host_param.flags = SERIAL_NOR_HOST_SUPPORT_SPI_INTERFACE | flags;
+    param->host_base = HPM_SPI1;
+    param->set_cs = TestSetCs;
+    param->set_frequency = TestSetFrequency;
+    param->frequency = TEST_SPI_CLK;
+    param->transfer_max_size = SPI_SOC_TRANSFER_COUNT_MAX;
+    param->dma_control.dma_base = HPM_HDMA;
+    param->dma_control.dmamux_base = HPM_DMAMUX;
+    param->dma_control.rx_dma_ch = TEST_RX_CH;
+    param->dma_control.tx_dma_ch = TEST_TX_CH;
+    param->dma_control.rx_dma_req = HPM_DMA_SRC_SPI1_RX;
+    param->dma_control.tx_dma_req = HPM_DMA_SRC_SPI1_TX;
+    HpmTestSpiNorAttach(&g_nor, &g_spi, (flags & SERIAL_NOR_HOST_CS_CONTROL_AUTO) != 0);
+    return hpm_serial_nor_init(&g_flash, &g_info);
+}
+
+static void TestInit(void)
+{
+    HPM_TEST_CHECK_EQ(TestFlashInit(SERIAL_NOR_HOST_SUPPORT_QUAD_IO_MODE | SERIAL_NOR_HOST_SUPPORT_DMA),
+                      status_success);
+    HPM_TEST_CHECK_EQ(g_info.size_in_kbytes, TEST_NOR_SIZE / 1024U);
+    HPM_TEST_CHECK_EQ(g_info.page_size, HPM_TEST_SPI_NOR_PAGE);
+    HPM_TEST_CHECK_EQ(g_info.sector_size_kbytes, 4);
+    HPM_TEST_CHECK_EQ(g_info.block_size_kbytes, 64);
+    HPM_TEST_CHECK_EQ(g_info.suspend_cmd, 0x75);
+    HPM_TEST_CHECK_EQ(g_info.resume_cmd, 0x7A);
+    HPM_TEST_CHECK_EQ(g_flash.nor_read_para.read_cmd, 0xEB);
+    HPM_TEST_CHECK_EQ(g_flash.nor_read_para.data_dummy_count, 3);
+    HPM_TEST_CHECK_EQ(HpmTestSpiSclkHz(&g_spi), TEST_SPI_CLK);
+    HPM_TEST_CHECK_EQ(g_nor.protocolErrors, 0);
+}
+
+static void TestProgramRead(void)
+{
+    uint32_t addr = TEST_LOG_BASE + 100U;
+    uint32_t len = 3000U;
+    uint32_t i;
+    bool same = true;
+
+    for (i = 0; i < len; i++) {
+        g_logBuf[i] = TestPattern(i + 7U);
+    }
+    HpmTestSpiNorStatsReset(&g_nor);
+    HPM_TEST_CHECK_EQ(hpm_serial_nor_erase_blocking(&g_flash, TEST_LOG_BASE, 0x10000U), status_success);
+    HPM_TEST_CHECK_EQ(hpm_serial_nor_program_blocking(&g_flash, g_logBuf, len, addr), status_success);
+    HPM_TEST_CHECK_EQ(g_nor.erases, 1);
+    HPM_TEST_CHECK_EQ(g_nor.programs, 13);
+
+    (void)memset(g_buf, 0, sizeof(g_buf));
+    HPM_TEST_CHECK_EQ(hpm_serial_nor_read(&g_flash, g_buf, 0x10000U, TEST_LOG_BASE), status_success);
+    for (i = 0; i < 0x10000U; i++) {
+        uint8_t expect = ((i >= 100U) && (i < 100U + len)) ? TestPattern(i - 100U + 7U) : 0xFFU;
+        same = same && (g_buf[i] == expect) && (g_nor.mem[TEST_LOG_BASE + i] == expect);
+    }
+    HPM_TEST_CHECK(same);
+    HPM_TEST_CHECK_EQ(g_nor.protocolErrors, 0);
+}
+
+static void TestLatencyAdd(uint64_t arrivalNs)
+{
+    uint64_t ns = HpmTestNowNs() - arrivalNs;
+
+    g_latency.maxNs = (ns > g_latency.maxNs) ? ns : g_latency.maxNs;
+    g_latency.sumNs += ns;
+    g_latency.count++;
+}
+
+static void TestReadDone(hpm_serial_nor_job_t *job, hpm_stat_t status)
+{
+    struct TestRead *read = (struct TestRead *)job;
+    uint32_t i;
+
+    TestLatencyAdd(read->arrivalNs);
+    for (i = 0; i < job->len; i++) {
+        if (read->buf[i] != TestPattern(job->addr + i)) {
+            break;
+        }
+    }
+    g_latency.errors += ((status != status_success) || (i != job->len)) ? 1U : 0U;
+    read->busy = false;
+}
+
+static void TestLogDone(hpm_serial_nor_job_t *job, hpm_stat_t status)
+{
+    (void)job;
+    g_latency.errors += (status != status_success) ? 1U : 0U;
+    g_logDone++;
+}
+
+static uint32_t TestReadAddr(uint32_t *seed, uint32_t len)
+{
+    return HpmTestRand(seed) % (TEST_APP_SIZE - len);
+}
+
+static void TestLogExpect(bool *ok)
+{
+    uint32_t i;
+
+    for (i = 0; i < 0x20000U; i++) {
+        uint8_t expect = ((i >= 100U) && (i < 100U + TEST_LOG_LEN)) ? 0x5AU : 0xFFU;
+        *ok = *ok && (g_nor.mem[TEST_LOG_BASE + i] == expect);
+    }
+}
+
+/*
+ * Runs <jobs> through the queue while urgent reads of the application image
+ * arrive every <everyNs> and a timer polls the queue every <pollNs>.
+ */
+static void TestQueueRun(hpm_serial_nor_job_t *jobs, uint32_t count, uint64_t pollNs, uint64_t everyNs,
+                         uint32_t readLen, uint64_t limitNs)
+{
+    uint64_t start = HpmTestNowNs();
+    uint64_t nextRead = start;
+    uint32_t seed = 0x5EEDU;
+    uint32_t slot = 0;
+    uint32_t i;
+
+    (void)memset(&g_latency, 0, sizeof(g_latency));
+    (void)memset(g_reads, 0, sizeof(g_reads));
+    g_logDone = 0;
+    HPM_TEST_CHECK_EQ(hpm_serial_nor_queue_init(&g_queue, &g_flash), status_success);
+    for (i = 0; i < count; i++) {
+        HPM_TEST_CHECK_EQ(hpm_serial_nor_queue_submit(&g_queue, &jobs[i]), status_success);
+    }
+
+    while (!hpm_serial_nor_queue_is_idle(&g_queue) || (g_logDone < count)) {
+        while ((nextRead <= HpmTestNowNs()) && !g_reads[slot].busy) {
+            struct TestRead *read = &g_reads[slot];
+            read->busy = true;
+            read->arrivalNs = nextRead;
+            read->job = (hpm_serial_nor_job_t) { .type = serial_nor_job_read, .urgent = true,
+                                                 .addr = TestReadAddr(&seed, readLen), .len = readLen,
+                                                 .buf = read->buf, .cb = TestReadDone };
+            HPM_TEST_CHECK_EQ(hpm_serial_nor_queue_submit(&g_queue, &read->job), status_success);
+            slot = (slot + 1U) % TEST_READ_SLOTS;
+            nextRead += everyNs;
+        }
+        (void)hpm_serial_nor_queue_poll(&g_queue);
+        if (HpmTestNowNs() - start > limitNs) {
+            break;
+        }
+        HpmTestRunUntil(HpmTestNowNs() + pollNs);
+    }
+    HPM_TEST_CHECK_EQ(g_logDone, count);
+    HPM_TEST_CHECK(HpmTestNowNs() - start <= limitNs);
+}
+
+/* The same work through the blocking calls, reads arriving meanwhile are served when a call returns */
+static void TestBlockingRun(uint64_t everyNs)
+{
+    static uint8_t buf[TEST_READ_LEN] __attribute__((aligned(HPM_L1C_CACHELINE_SIZE)));
+    uint64_t nextRead = HpmTestNowNs();
+    uint32_t seed = 0x5EEDU;
+    uint32_t step;
+    hpm_stat_t stat;
+
+    (void)memset(g_logBuf, 0x5A, sizeof(g_logBuf));
+    (void)memset(&g_latency, 0, sizeof(g_latency));
+    for (step = 0; step < 3U; step++) {
+        if (step == 0) {
+            stat = hpm_serial_nor_erase_blocking(&g_flash, TEST_LOG_BASE, 0x20000U);
+        } else if (step == 1) {
+            stat = hpm_serial_nor_program_blocking(&g_flash, g_logBuf, TEST_LOG_LEN, TEST_LOG_BASE + 100U);
+        } else {
+            stat = hpm_serial_nor_erase_blocking(&g_flash, TEST_LOG_BASE + 0x10000U + 10U, 5000U);
+        }
+        g_latency.errors += (stat != status_success) ? 1U : 0U;
+        while (nextRead <= HpmTestNowNs()) {
+            uint32_t addr = TestReadAddr(&seed, TEST_READ_LEN);
+            g_latency.errors += (hpm_serial_nor_read(&g_flash, buf, TEST_READ_LEN, addr) != status_success) ? 1U : 0U;
+            g_latency.errors += (buf[0] != TestPattern(addr)) ? 1U : 0U;
+            TestLatencyAdd(nextRead);
+            nextRead += everyNs;
+        }
+    }
+}
+
+static void TestLatencyPrint(const char *name)
+{
+    printf("%s: %u urgent reads, latency avg %.1f us max %.1f us, %u suspends, %u bad reads\n", name,
+           g_latency.count, (g_latency.count != 0) ? g_latency.sumNs / 1000.0 / g_latency.count : 0.0,
+           g_latency.maxNs / 1000.0, g_nor.suspends, g_nor.badReads);
+}
+
+/*
+ * The log partition work: two blocks, a 4K record at an odd offset and two
+ * sectors, first through the blocking calls and then through the queue.
+ */
+static void TestQueue(void)
+{
+    hpm_serial_nor_job_t log[3] = {
+        { .type = serial_nor_job_erase, .addr = TEST_LOG_BASE, .len = 0x20000U, .cb = TestLogDone },
+        { .type = serial_nor_job_program, .addr = TEST_LOG_BASE + 100U, .len = TEST_LOG_LEN, .buf = g_logBuf,
+          .cb = TestLogDone },
+        { .type = serial_nor_job_erase, .addr = TEST_LOG_BASE + 0x10000U + 10U, .len = 5000U, .cb = TestLogDone },
+    };
+    hpm_serial_nor_job_t sector = { .type = serial_nor_job_erase, .addr = TEST_LOG_BASE, .len = 4096U,
+                                    .cb = TestLogDone };
+    uint64_t blockingMaxNs;
+    uint64_t start;
+    bool ok = true;
+    uint32_t i;
+
+    for (i = 0; i < TEST_APP_SIZE; i++) {
+        g_nor.mem[i] = TestPattern(i);
+    }
+
+    HpmTestSpiNorStatsReset(&g_nor);
+    TestBlockingRun(TEST_READ_EVERY_NS);
+    TestLatencyPrint("blocking");
+    blockingMaxNs = g_latency.maxNs;
+    HPM_TEST_CHECK_EQ(g_latency.errors, 0);
+    HPM_TEST_CHECK(blockingMaxNs >= 2U * TEST_BLOCK_NS);
+    TestLogExpect(&ok);
+    HPM_TEST_CHECK(ok);
+
+    /* an urgent read waits for the next poll and at most one page program */
+    HpmTestSpiNorStatsReset(&g_nor);
+    TestQueueRun(log, 3U, TEST_POLL_NS, TEST_READ_EVERY_NS, TEST_READ_LEN, 2U * TEST_BLOCK_NS + 200000000ULL);
+    TestLatencyPrint("queue");
+    HPM_TEST_CHECK_EQ(g_latency.errors, 0);
+    HPM_TEST_CHECK(g_latency.count > 150U);
+    HPM_TEST_CHECK(g_latency.maxNs < TEST_POLL_NS + TEST_PAGE_NS + 200000ULL);
+    HPM_TEST_CHECK(g_nor.suspends > 0);
+    HPM_TEST_CHECK_EQ(g_nor.badReads, 0);
+    HPM_TEST_CHECK_EQ(g_nor.protocolErrors, 0);
+    TestLogExpect(&ok);
+    HPM_TEST_CHECK(ok);
+
+    /* reads faster than the resume to suspend time: a sector erase still gets most of the time */
+    HpmTestSpiNorStatsReset(&g_nor);
+    start = HpmTestNowNs();
+    TestQueueRun(&sector, 1U, TEST_DENSE_POLL_NS, TEST_DENSE_READ_EVERY_NS, TEST_DENSE_READ_LEN,
+                 3U * TEST_SECTOR_NS);
+    printf("dense reads: sector erase done in %.1f ms\n", (HpmTestNowNs() - start) / 1e6);
+    TestLatencyPrint("queue, dense");
+    HPM_TEST_CHECK_EQ(g_latency.errors, 0);
+    HPM_TEST_CHECK(g_latency.count > 500U);
+    HPM_TEST_CHECK_EQ(g_nor.badReads, 0);
+    HPM_TEST_CHECK_EQ(g_nor.protocolErrors, 0);
+    for (i = 0; i < 4096U; i++) {
+        ok = ok && (g_nor.mem[TEST_LOG_BASE + i] == 0xFFU);
+    }
+    HPM_TEST_CHECK(ok);
+}
+
+/*
+ * Reads whose length is not a multiple of four, around the chunk size: the
+ * DMA moves whole words, nothing past the length may be written.
+ */
+static void TestReadTail(uint32_t flags, const char *name)
+{
+    static const uint32_t lens[] = { 1U, 2U, 3U, 5U, 6U, 7U, 510U, 511U, 513U, 514U, 515U, 1023U, 1537U };
+    uint32_t n;
+    uint32_t i;
+    uint32_t bad = 0;
+    uint32_t overrun = 0;
+
+    HPM_TEST_CHECK_EQ(TestFlashInit(flags), status_success);
+    for (n = 0; n < sizeof(lens) / sizeof(lens[0]); n++) {
+        uint32_t addr = 1000U + 3U * n;
+        (void)memset(g_buf, 0xCC, lens[n] + HPM_L1C_CACHELINE_SIZE);
+        HPM_TEST_CHECK_EQ(hpm_serial_nor_read(&g_flash, g_buf, lens[n], addr), status_success);
+        for (i = 0; i < lens[n]; i++) {
+            bad += (g_buf[i] != TestPattern(addr + i)) ? 1U : 0U;
+        }
+        for (; i < lens[n] + HPM_L1C_CACHELINE_SIZE; i++) {
+            overrun += (g_buf[i] != 0xCCU) ? 1U : 0U;
+        }
+    }
+    printf("%s: %u bytes wrong, %u bytes written past the length\n", name, bad, overrun);
+    HPM_TEST_CHECK_EQ(bad, 0);
+    HPM_TEST_CHECK_EQ(overrun, 0);
+    HPM_TEST_CHECK_EQ(g_nor.protocolErrors, 0);
+}
+
+/* Reads of the application image, cs held for the whole read against a command per transfer_max_size chunk */
+static void TestReadBench(uint32_t flags, const char *name)
+{
+    uint64_t start;
+    uint32_t i;
+    bool same = true;
+
+    HPM_TEST_CHECK_EQ(TestFlashInit(flags), status_success);
+    (void)memset(g_buf, 0, sizeof(g_buf));
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(hpm_serial_nor_read(&g_flash, g_buf, sizeof(g_buf), 0), status_success);
+    printf("%s: %u byte read in %.1f us, %.1f MB/s (wire limit %.1f MB/s)\n", name, (uint32_t)sizeof(g_buf),
+           (HpmTestNowNs() - start) / 1000.0, sizeof(g_buf) * 1000.0 / (HpmTestNowNs() - start),
+           TEST_SPI_CLK / 2 / 1e6);
+    for (i = 0; i < sizeof(g_buf); i++) {
+        same = same && (g_buf[i] == TestPattern(i));
+    }
+    HPM_TEST_CHECK(same);
+}
+
+int main(void)
+{
+    HpmTestVirtualTime(true);
+    HpmTestMmioCostNs(TEST_MMIO_NS);
+    HpmTestDmaModelInit();
+    HpmTestMchtmrInit(TEST_MCHTMR_HZ);
+    HpmTestSpiInit(&g_spi, HPM_SPI1_BASE, IRQn_SPI1, TEST_SPI_CLK, HPM_DMA_SRC_SPI1_RX, HPM_DMA_SRC_SPI1_TX);
+    HpmTestSpiNorInit(&g_nor, TEST_NOR_SIZE, TEST_PAGE_NS, TEST_SECTOR_NS, TEST_BLOCK_NS, TEST_SUSPEND_NS);
+
+    TestInit();
+    TestProgramRead();
+    TestQueue();
+    TestReadTail(SERIAL_NOR_HOST_SUPPORT_QUAD_IO_MODE | SERIAL_NOR_HOST_SUPPORT_DMA, "gpio cs, dma");
+    TestReadTail(SERIAL_NOR_HOST_SUPPORT_QUAD_IO_MODE | SERIAL_NOR_HOST_SUPPORT_DMA | SERIAL_NOR_HOST_CS_CONTROL_AUTO,
+                 "spi cs, dma");
+    TestReadTail(SERIAL_NOR_HOST_SUPPORT_QUAD_IO_MODE, "gpio cs, cpu");
+    TestReadBench(SERIAL_NOR_HOST_SUPPORT_QUAD_IO_MODE | SERIAL_NOR_HOST_SUPPORT_DMA, "gpio cs, dma");
+    TestReadBench(SERIAL_NOR_HOST_SUPPORT_QUAD_IO_MODE | SERIAL_NOR_HOST_SUPPORT_DMA | SERIAL_NOR_HOST_CS_CONTROL_AUTO,
+                  "spi cs, dma");
+
+    HpmTestSpiNorDeinit(&g_nor);
+    HpmTestSpiDeinit(&g_spi);
+    HpmTestMchtmrDeinit();
+    HpmTestDmaModelDeinit();
+    return HpmTestResult();
+}
@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * drivers/platform/spi.c against the spi and dma models: data integrity per
+ * transfer mode and alignment, the cs rules without direct io, the completion
+ * deadline, an rx dma that never drains, and the cost per transfer size.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "hdf_device_desc.h"
+#include "spi_core.h"
+#include "spi_ext.h"
+#include "hpm_soc.h"
+#include "hpm_soc_feature.h"
+#include "hpm_dmamux_src.h"
+#include "soc.h"
+#include "hpm_test.h"
+#include "hpm_test_dma.h"
+#include "hpm_test_spi.h"
+
+#define TEST_SPI_ID 0
+#define TEST_SPI_CLK 80000000U
+#define TEST_MS 1000000ULL
+/* one spi transaction, the longest message cs can be held across without direct io */
+#define TEST_SEG SPI_SOC_TRANSFER_COUNT_MAX
+#define TEST_MSG_MAX 128
+
+extern struct HdfDriverEntry g_spiDriverEntry;
+
+static struct HpmTestSpi g_spi;
+static struct HdfDeviceObject *g_device;
+static struct SpiCntlr *g_cntlr;
+static uint32_t g_seed = 0x2468ACEU;
+static uint8_t g_devCounter;
+
+static const struct HpmTestProp g_props[] = {
+    { "id", TEST_SPI_ID, NULL },
+    { "base", HPM_SPI0_BASE, NULL },
+    { "irq_num", IRQn_SPI0, NULL },
+    { "clk_freq", TEST_SPI_CLK, NULL },
+    { "dma_rx_src", HPM_DMA_SRC_SPI0_RX, NULL },
+    { "dma_tx_src", HPM_DMA_SRC_SPI0_TX, NULL },
+    { NULL, 0, NULL },
+};
+
+/* The device answers a written byte with its complement, a read with a running counter */
+static uint32_t TestDeviceExchange(void *ctx, uint32_t mosi, bool mosiValid)
+{
+    (void)ctx;
+    return mosiValid ? (~mosi & 0xFFU) : g_devCounter++;
+}
+
+static void TestFill(uint8_t *buf, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)HpmTestRand(&g_seed);
+    }
+}
+
+static void TestSetSpeed(uint32_t speedHz)
+{
+    struct SpiCfg cfg = { .maxSpeedHz = speedHz, .mode = 0, .transferMode = SPI_DMA_TRANSFER, .bitsPerWord = 8 };
+
+    g_cntlr->method->SetCfg(g_cntlr, &cfg);
+}
+
+static int32_t TestTransfer(struct SpiMsg *msg, uint32_t count)
+{
+    return g_cntlr->method->Transfer(g_cntlr, msg, count);
+}
+
+/* Cut <len> bytes into messages of one transaction each, returns the message count */
+static uint32_t TestSplit(struct SpiMsg *msg, uint8_t *wbuf, uint8_t *rbuf, uint32_t len, uint32_t speed)
+{
+    uint32_t count = 0;
+
+    for (uint32_t off = 0; (off < len) && (count < TEST_MSG_MAX); off += TEST_SEG) {
+        msg[count].wbuf = (wbuf != NULL) ? &wbuf[off] : NULL;
+        msg[count].rbuf = (rbuf != NULL) ? &rbuf[off] : NULL;
+        msg[count].len = (len - off > TEST_SEG) ? TEST_SEG : (len - off);
+        msg[count].speed = speed;
+        msg[count].keepCs = 0;
+        count++;
+    }
+    return count;
+}
+
+/* Every length across the polled/dma threshold up to one transaction, every mode, odd rx buffers */
+static void TestSpiData(void)
+{
+    static const uint32_t lens[] = { 1, 31, 32, 100, TEST_SEG - 1, TEST_SEG };
+    static uint8_t wbuf[2048];
+    static uint8_t rbuf[2048 + 64] __attribute__((aligned(64)));
+
+    TestSetSpeed(20000000);
+    for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        for (uint32_t off = 0; off < 64; off += 61) {
+            uint32_t len = lens[i];
+            uint8_t *r = &rbuf[off];
+            struct SpiMsg msg = { 0 };
+
+            TestFill(wbuf, len);
+            memset(rbuf, 0, sizeof(rbuf));
+            msg.wbuf = wbuf;
+            msg.rbuf = r;
+            msg.len = len;
+            HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), 0);
+            for (uint32_t k = 0; k < len; k++) {
+                if (!HPM_TEST_CHECK_EQ(r[k], (uint8_t)~wbuf[k])) {
+                    break;
+                }
+            }
+            HPM_TEST_CHECK_EQ(r[len], 0);
+
+            uint8_t start = g_devCounter;
+            msg.wbuf = NULL;
+            HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), 0);
+            for (uint32_t k = 0; k < len; k++) {
+                if (!HPM_TEST_CHECK_EQ(r[k], (uint8_t)(start + k))) {
+                    break;
+                }
+            }
+
+            uint64_t units = g_spi.units;
+            msg.wbuf = wbuf;
+            msg.rbuf = NULL;
+            HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), 0);
+            HPM_TEST_CHECK_EQ(g_spi.units - units, len);
+        }
+    }
+}
+
+static void TestRefusedDone(uint32_t busNum, int32_t status, void *arg)
+{
+    (void)busNum;
+    (void)arg;
+    HPM_TEST_CHECK_EQ(status, HDF_ERR_NOT_SUPPORT);
+}
+
+/*
+ * Messages of one array run each at its own clock. Without direct io the
+ * controller drives cs per transaction: keepCs and messages longer than one
+ * transaction are refused, the rest gets one cs assertion per message.
+ */
+static void TestSpiMessageArray(void)
+{
+    static uint8_t wbuf[3][TEST_SEG + 1];
+    static uint8_t rbuf[3][TEST_SEG + 1];
+    struct SpiMsg msg[3] = { 0 };
+    uint32_t cs;
+
+    for (uint32_t i = 0; i < 3; i++) {
+        TestFill(wbuf[i], sizeof(wbuf[i]));
+        msg[i].wbuf = wbuf[i];
+        msg[i].rbuf = rbuf[i];
+        msg[i].len = (i == 2) ? TEST_SEG : 200 * (i + 1);
+        msg[i].speed = (i == 2) ? 10000000 : 0;
+    }
+#if !defined(SPI_SOC_SUPPORT_DIRECTIO) || (SPI_SOC_SUPPORT_DIRECTIO == 0)
+    cs = g_spi.csAsserts;
+    msg[0].keepCs = 1;
+    HPM_TEST_CHECK_EQ(TestTransfer(msg, 3), HDF_ERR_NOT_SUPPORT);
+    msg[0].keepCs = 0;
+    msg[2].len = TEST_SEG + 1;
+    HPM_TEST_CHECK_EQ(TestTransfer(msg, 3), HDF_ERR_NOT_SUPPORT);
+    HPM_TEST_CHECK_EQ(HpmSpiTransferAsync(TEST_SPI_ID, msg, 3, TestRefusedDone, NULL), HDF_ERR_NOT_SUPPORT);
+    msg[2].len = TEST_SEG;
+    HPM_TEST_CHECK_EQ(g_spi.csAsserts - cs, 0);
+#endif
+
+    cs = g_spi.csAsserts;
+    HPM_TEST_CHECK_EQ(TestTransfer(msg, 3), 0);
+    for (uint32_t i = 0; i < 3; i++) {
+        for (uint32_t k = 0; k < msg[i].len; k++) {
+            if (!HPM_TEST_CHECK_EQ(rbuf[i][k], (uint8_t)~wbuf[i][k])) {
+                break;
+            }
+        }
+    }
+    HPM_TEST_CHECK_EQ(g_spi.csAsserts - cs, 3);
+    HPM_TEST_CHECK_EQ(HpmTestSpiSclkHz(&g_spi), 10000000);
+    TestSetSpeed(20000000);
+}
+
+/*
+ * The completion deadline follows the wire time: 64 KiB at 400 kHz takes 1.3 s
+ * and must complete, a stalled bus must time out close to the wire time.
+ */
+static void TestSpiTimeout(void)
+{
+    static uint8_t wbuf[65536];
+    static struct SpiMsg msg[TEST_MSG_MAX];
+    uint32_t count;
+    uint64_t start;
+
+    TestFill(wbuf, sizeof(wbuf));
+    count = TestSplit(msg, wbuf, NULL, sizeof(wbuf), 400000);
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(TestTransfer(msg, count), 0);
+    HPM_TEST_CHECK(HpmTestNowNs() - start > 1300 * TEST_MS);
+
+    /* 4 KiB at 10 MHz: 3.3 ms on the wire */
+    count = TestSplit(msg, wbuf, NULL, 4096, 10000000);
+    g_spi.stalled = true;
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(TestTransfer(msg, count), -1);
+    HPM_TEST_CHECK(HpmTestNowNs() - start >= 20 * TEST_MS);
+    HPM_TEST_CHECK(HpmTestNowNs() - start < 40 * TEST_MS);
+    g_spi.stalled = false;
+
+    HPM_TEST_CHECK_EQ(TestTransfer(msg, count), 0);
+    TestSetSpeed(20000000);
+}
+
+/*
+ * The end interrupt with rx dma still holding data must not complete the
+ * transfer with stale data: it waits for the rx tc and times out.
+ */
+static void TestSpiRxDrain(void)
+{
+    static uint8_t wbuf[64];
+    static uint8_t rbuf[64] __attribute__((aligned(64)));
+    struct SpiMsg msg = { .wbuf = wbuf, .rbuf = rbuf, .len = sizeof(wbuf) };
+
+    uint64_t start;
+
+    TestFill(wbuf, sizeof(wbuf));
+    g_spi.rxDmaStuck = true;
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), -1);
+    HPM_TEST_CHECK(HpmTestNowNs() - start >= 20 * TEST_MS);
+    g_spi.rxDmaStuck = false;
+
+    HPM_TEST_CHECK_EQ(TestTransfer(&msg, 1), 0);
+    HPM_TEST_CHECK_EQ(rbuf[63], (uint8_t)~wbuf[63]);
+}
+
+struct TestAsync {
+    struct SpiMsg msg[TEST_MSG_MAX];
+    uint32_t count;
+    uint32_t left;
+    int32_t status;
+};
+
+static void TestAsyncDone(uint32_t busNum, int32_t status, void *arg)
+{
+    struct TestAsync *a = (struct TestAsync *)arg;
+
+    a->status = (status != 0) ? status : a->status;
+    if ((--a->left != 0) && (HpmSpiTransferAsync(busNum, a->msg, a->count, TestAsyncDone, a) != 0)) {
+        a->status = -1;
+        a->left = 0;
+    }
+}
+
+static bool TestAsyncIdle(void *arg)
+{
+    return ((struct TestAsync *)arg)->left == 0;
+}
+
+/* Spi end and dma interrupts taken so far */
+static uint32_t TestIrqs(void)
+{
+    return HpmTestIrqCount(HPM2LITEOS_IRQ(IRQn_SPI0)) + HpmTestIrqCount(HPM2LITEOS_IRQ(IRQn_HDMA)) +
+           HpmTestIrqCount(HPM2LITEOS_IRQ(IRQn_XDMA));
+}
+
+/*
+ * Cost per transfer size: time from the call to the return against the wire
+ * time, register accesses and interrupts. Code between register accesses is
+ * free in virtual time, so this is the controller and dma overhead alone.
+ * Sizes above one transaction go as an array of one transaction per message.
+ */
+static void TestSpiBench(void)
+{
+    static const uint32_t lens[] = { 16, 64, 256, 1024, 4096, 65536 };
+    static const uint32_t speeds[] = { 20000000, 40000000 };
+    static uint8_t wbuf[65536];
+    static uint8_t rbuf[65536] __attribute__((aligned(64)));
+    static struct SpiMsg msg[TEST_MSG_MAX];
+    static struct TestAsync a;
+
+    printf("%9s %6s %10s %8s %10s %8s\n", "sclk", "bytes", "us", "bus %", "regs", "irqs");
+    for (uint32_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+        TestSetSpeed(speeds[s]);
+        for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+            uint32_t count = TestSplit(msg, wbuf, rbuf, lens[i], 0);
+            uint64_t wireNs = (uint64_t)lens[i] * 8U * 1000000000ULL / speeds[s];
+            uint64_t regs = HpmTestMmioAccesses();
+            uint32_t irqs = TestIrqs();
+            uint64_t start = HpmTestNowNs();
+
+            HPM_TEST_CHECK_EQ(TestTransfer(msg, count), 0);
+            uint64_t ns = HpmTestNowNs() - start;
+            printf("%9u %6u %10.1f %8.1f %10llu %8u\n", speeds[s], lens[i], ns / 1000.0, 100.0 * wireNs / ns,
+                   (unsigned long long)(HpmTestMmioAccesses() - regs), TestIrqs() - irqs);
+        }
+    }
+
+    /* back to back async 4 KiB transfers, requeued from the completion callback */
+    a.count = TestSplit(a.msg, wbuf, rbuf, 4096, 0);
+    a.left = 16;
+    a.status = 0;
+    uint64_t start = HpmTestNowNs();
+    uint64_t busy = g_spi.busyNs;
+
+    HPM_TEST_CHECK_EQ(HpmSpiTransferAsync(TEST_SPI_ID, a.msg, a.count, TestAsyncDone, &a), 0);
+    HPM_TEST_CHECK(HpmTestRunUntilDone(HpmTestNowNs() + 1000 * TEST_MS, TestAsyncIdle, &a));
+    HPM_TEST_CHECK_EQ(a.status, 0);
+    printf("async 16 x 4096 at %u Hz: controller busy %.1f %% of %.1f us\n", speeds[1],
+           100.0 * (g_spi.busyNs - busy) / (HpmTestNowNs() - start), (HpmTestNowNs() - start) / 1000.0);
+}
+
+int main(void)
+{
+    HpmTestVirtualTime(true);
+    HpmTestMmioCostNs(10);
+    HpmTestDmaModelInit();
+    HpmTestSpiInit(&g_spi, HPM_SPI0_BASE, IRQn_SPI0, TEST_SPI_CLK, HPM_DMA_SRC_SPI0_RX, HPM_DMA_SRC_SPI0_TX);
+    g_spi.exchange = TestDeviceExchange;
+
+    g_device = HpmTestDeviceCreate(g_props);
+    if (!HPM_TEST_CHECK_EQ(g_spiDriverEntry.Bind(g_device), HDF_SUCCESS) ||
+        !HPM_TEST_CHECK_EQ(g_spiDriverEntry.Init(g_device), HDF_SUCCESS)) {
+        return HpmTestResult();
+    }
+    g_cntlr = SpiCntlrFromDevice(g_device);
+    g_cntlr->method->Open(g_cntlr);
+
+    TestSpiData();
+    TestSpiMessageArray();
+    TestSpiTimeout();
+    TestSpiRxDrain();
+    TestSpiBench();
+
+    g_cntlr->method->Close(g_cntlr);
+    g_spiDriverEntry.Release(g_device);
+    HpmTestDeviceDestroy(g_device);
+    HpmTestSpiDeinit(&g_spi);
+    HpmTestDmaModelDeinit();
+    return HpmTestResult();
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 HPMicro.
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Round trip of hpm6700/liteos_m/tools/hpm_trace_decode.py.
+
+Records are written the way HpmTraceWrite() in trace_log.h does into a ring
+dump, next to a minimal ELF32 holding the format strings, and decoded again:
+a ring that has not wrapped, one that has, and a head index that wrapped at
+2^32.
+
+    test_trace_decode.py <directory of hpm_trace_decode.py>
+"""
+
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+
+TRACE_MAGIC = 0x48545243
+TRACE_TAG = 0xA5000000
+TRACE_HDR_WORDS = 3
+RODATA_ADDR = 0x80010000
+FMT_ADDR = 0x80020000
+SHT_PROGBITS = 1
+SHT_STRTAB = 3
+SHF_ALLOC = 0x2
+
+decoder = None
+
+
+class Image:
+    """Format strings in hpm_trace_fmt and other strings in .rodata, as the linker lays them out."""
+
+    def __init__(self):
+        self.fmt = bytearray()
+        self.rodata = bytearray()
+
+    def _add(self, blob, base, text):
+        addr = base + len(blob)
+        blob += text.encode() + b"\0"
+        while len(blob) % 4:
+            blob += b"\0"
+        return addr
+
+    def fmt_string(self, text):
+        return self._add(self.fmt, FMT_ADDR, text)
+
+    def string(self, text):
+        return self._add(self.rodata, RODATA_ADDR, text)
+
+    def elf(self):
+        shstrtab = b"\0.rodata\0hpm_trace_fmt\0.shstrtab\0"
+        names = {n: shstrtab.index(n.encode() + b"\0") for n in (".rodata", "hpm_trace_fmt", ".shstrtab")}
+        body = bytes(self.rodata) + bytes(self.fmt) + shstrtab
+        rodata_off = 52
+        fmt_off = rodata_off + len(self.rodata)
+        str_off = fmt_off + len(self.fmt)
+        shoff = (str_off + len(shstrtab) + 3) & ~3
+        body += b"\0" * (shoff - 52 - len(body))
+
+        ident = b"\x7fELF\x01\x01\x01" + b"\0" * 9
+        hdr = ident + struct.pack("<HHIIIIIHHHHHH", 2, 0xF3, 1, 0, 0, shoff, 0, 52, 0, 0, 40, 4, 3)
+        sections = [
+            (0, 0, 0, 0, 0, 0),
+            (names[".rodata"], SHT_PROGBITS, SHF_ALLOC, RODATA_ADDR, rodata_off, len(self.rodata)),
+            (names["hpm_trace_fmt"], SHT_PROGBITS, SHF_ALLOC, FMT_ADDR, fmt_off, len(self.fmt)),
+            (names[".shstrtab"], SHT_STRTAB, 0, 0, str_off, len(shstrtab)),
+        ]
+        shdrs = b"".join(struct.pack("<IIIIIIIIII", *sec, 0, 0, 4, 0) for sec in sections)
+        return hdr + body + shdrs
+
+
+class Ring:
+    """g_hpmTrace, written like HpmTraceWrite()."""
+
+    def __init__(self, words, head=0, ts_freq=24000000):
+        self.words = words
+        self.head = head
+        self.ts_freq = ts_freq
+        self.buf = [0] * words
+
+    def write(self, fmt_addr, ts, args):
+        mask = self.words - 1
+        pos = self.head
+        self.head = (self.head + TRACE_HDR_WORDS + len(args)) & 0xFFFFFFFF
+        self.buf[(pos + 1) & mask] = fmt_addr
+        self.buf[(pos + 2) & mask] = ts & 0xFFFFFFFF
+        for i, arg in enumerate(args):
+            self.buf[(pos + TRACE_HDR_WORDS + i) & mask] = arg & 0xFFFFFFFF
+        self.buf[pos & mask] = TRACE_TAG | (len(args) << 16) | ((ts >> 32) & 0xFFFF)
+
+    def dump(self):
+        return struct.pack("<IIII%uI" % self.words, TRACE_MAGIC, self.words, self.ts_freq, self.head, *self.buf)
+
+
+class TraceDecodeTest(unittest.TestCase):
+    def setUp(self):
+        self.image = Image()
+        self.tick = self.image.fmt_string("tick %u\n")
+        self.xfer = self.image.fmt_string("xfer %s len %d rc %d at %p\n")
+        self.seq = self.image.fmt_string("seq %08x\n")
+        self.name = self.image.string("spi0")
+
+    def decode(self, ring):
+        path = None
+        try:
+            with tempfile.NamedTemporaryFile(suffix=".elf", delete=False) as f:
+                f.write(self.image.elf())
+                path = f.name
+            return list(decoder.decode(decoder.Elf32(path), ring.dump()))
+        finally:
+            if path is not None:
+                os.unlink(path)
+
+    def fill(self, ring, count, ts=0):
+        """Write <count> numbered records, return the texts and timestamps written."""
+        sent = []
+        for i in range(count):
+            ring.write(self.seq, ts + i, [i])
+            sent.append((ts + i, "seq %08x\n" % i))
+        return sent
+
+    def test_formats(self):
+        ring = Ring(64)
+        ring.write(self.tick, 5, [42])
+        ring.write(self.xfer, (0x1234 << 32) | 7, [self.name, 256, -5, 0x20001000])
+        ring.write(self.xfer, 8, [0x1, 0, 0, 0])
+        got = [(ts, text) for ts, text, _ in self.decode(ring)]
+        self.assertEqual(got, [
+            (5, "tick 42\n"),
+            ((0x1234 << 32) | 7, "xfer spi0 len 256 rc -5 at 0x20001000\n"),
+            (8, "xfer <0x00000001> len 0 rc 0 at 0x00000000\n"),
+        ])
+
+    def test_not_wrapped(self):
+        ring = Ring(64)
+        sent = self.fill(ring, 10)
+        self.assertEqual([(ts, text) for ts, text, _ in self.decode(ring)], sent)
+
+    def test_wrapped(self):
+        ring = Ring(64)
+        sent = self.fill(ring, 100)
+        got = [(ts, text) for ts, text, _ in self.decode(ring)]
+        # every complete record left in the ring, oldest first, only the oldest may be cut
+        self.assertGreaterEqual(len(got), 64 // 4 - 1)
+        self.assertEqual(got, sent[-len(got):])
+
+    def test_head_wrapped_at_2_32(self):
+        ring = Ring(64, head=0x100000000 - 4 * 20)
+        sent = self.fill(ring, 30)
+        self.assertLess(ring.head, ring.words)
+        got = [(ts, text) for ts, text, _ in self.decode(ring)]
+        self.assertGreaterEqual(len(got), 64 // 4 - 1)
+        self.assertEqual(got, sent[-len(got):])
+
+    def test_cli(self):
+        ring = Ring(64, ts_freq=1000)
+        ring.write(self.tick, 1500, [1])
+        with tempfile.TemporaryDirectory() as tmp:
+            elf = os.path.join(tmp, "image.elf")
+            dump = os.path.join(tmp, "trace.bin")
+            with open(elf, "wb") as f:
+                f.write(self.image.elf())
+            with open(dump, "wb") as f:
+                f.write(ring.dump())
+            out = subprocess.run([sys.executable, os.path.join(sys.argv[1], "hpm_trace_decode.py"), elf, dump],
+                                 check=True, capture_output=True, text=True).stdout
+        self.assertEqual(out, "[1.500000] tick 1\n")
+
+
+if __name__ == "__main__":
+    sys.dont_write_bytecode = True
+    sys.path.insert(0, sys.argv[1])
+    import hpm_trace_decode as decoder
+    unittest.main(argv=sys.argv[:1])
@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * drivers/platform/uart.c against the uart and dma models: dma port init
+ * retry, rx dma lap accounting, rx dma buffer sizing, rx ring overflow, blocking
+ * read completion on idle gaps and deadlines, tx dma bus errors, and per mode
+ * throughput and cpu cost.
+ */
+
+#include <string.h>
+#include "hdf_device_desc.h"
+#include "uart_core.h"
+#include "uart_ext.h"
+#include "hpm_soc.h"
+#include "hpm_dmamux_src.h"
+#include "soc.h"
+#include "los_interrupt.h"
+#include "hpm_test.h"
+#include "hpm_test_dma.h"
+#include "hpm_test_uart.h"
+
+#define TEST_UART_ID 3
+#define TEST_UART_CLK 80000000U
+#define TEST_MS 1000000ULL
+/* cpu clock the register access time is converted to cycles at */
+#define TEST_CPU_MHZ 816U
+#define TEST_RX_BUF_SIZE 16384U
+
+extern struct HdfDriverEntry g_uartDriverEntry;
+
+static struct HpmTestUart g_uart;
+static uint32_t g_seed = 0x1234567U;
+
+static const struct HpmTestProp g_propsDma[] = {
+    { "id", TEST_UART_ID, NULL },
+    { "base", HPM_UART3_BASE, NULL },
+    { "irq_num", IRQn_UART3, NULL },
+    { "clk_freq", TEST_UART_CLK, NULL },
+    { "rx_buf_size", TEST_RX_BUF_SIZE, NULL },
+    { "tx_buf_size", 1024, NULL },
+    { "dma_rx_src", HPM_DMA_SRC_UART3_RX, NULL },
+    { "dma_tx_src", HPM_DMA_SRC_UART3_TX, NULL },
+    { NULL, 0, NULL },
+};
+
+struct TestPort {
+    struct HdfDeviceObject *device;
+    struct UartHost *host;
+};
+
+static bool TestPortOpen(struct TestPort *port, uint32_t baud)
+{
+    port->device = HpmTestDeviceCreate(g_propsDma);
+    if (!HPM_TEST_CHECK_EQ(g_uartDriverEntry.Bind(port->device), HDF_SUCCESS) ||
+        !HPM_TEST_CHECK_EQ(g_uartDriverEntry.Init(port->device), HDF_SUCCESS)) {
+        return false;
+    }
+    port->host = UartHostFromDevice(port->device);
+    port->host->method->Init(port->host);
+    port->host->method->SetBaud(port->host, baud);
+    return true;
+}
+
+static void TestPortClose(struct TestPort *port)
+{
+    port->host->method->Deinit(port->host);
+    LOS_HwiDelete(HPM2LITEOS_IRQ(IRQn_UART3), NULL);
+    g_uartDriverEntry.Release(port->device);
+    HpmTestDeviceDestroy(port->device);
+}
+
+static void TestFill(uint8_t *buf, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)HpmTestRand(&g_seed);
+    }
+}
+
+/* Far end sends <len> bytes, the driver sits behind an int lock until they are all on the line */
+static void TestSendLocked(const uint8_t *data, uint32_t len)
+{
+    uint32_t save = LOS_IntLock();
+
+    HpmTestUartRxSend(&g_uart, data, len, HpmTestNowNs());
+    HpmTestRunUntil(HpmTestUartRxEndNs(&g_uart) + HpmTestUartCharNs(&g_uart));
+    LOS_IntRestore(save);
+}
+
+static void TestSend(const uint8_t *data, uint32_t len)
+{
+    HpmTestUartRxSend(&g_uart, data, len, HpmTestNowNs());
+    HpmTestRunUntil(HpmTestUartRxEndNs(&g_uart) + 8 * HpmTestUartCharNs(&g_uart));
+}
+
+static uint32_t TestRxLost(void)
+{
+    struct HpmUartRxStats stats;
+
+    HpmUartGetRxStats(TEST_UART_ID, &stats);
+    return stats.swOverflow;
+}
+
+/*
+ * A failed dma irq install must not be latched: the port falls back to irq rx,
+ * and the next driver instance installs the dma irqs.
+ */
+static void TestDmaPortInitRetry(void)
+{
+    struct TestPort port;
+    uint8_t tx[48];
+    uint8_t rx[64];
+
+    HpmTestHwiCreateFail(1);
+    if (!TestPortOpen(&port, 115200)) {
+        return;
+    }
+    HPM_TEST_CHECK(!HpmTestIrqInstalled(HPM2LITEOS_IRQ(IRQn_HDMA)));
+    port.host->method->SetTransMode(port.host, UART_MODE_DMA_RX_EN);
+    port.host->method->SetTransMode(port.host, UART_MODE_RD_NONBLOCK);
+
+    TestFill(tx, sizeof(tx));
+    TestSend(tx, sizeof(tx));
+    HPM_TEST_CHECK_EQ(port.host->method->Read(port.host, rx, sizeof(rx)), sizeof(tx));
+    HPM_TEST_CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+    TestPortClose(&port);
+
+    if (!TestPortOpen(&port, 115200)) {
+        return;
+    }
+    HPM_TEST_CHECK(HpmTestIrqInstalled(HPM2LITEOS_IRQ(IRQn_HDMA)));
+    HPM_TEST_CHECK(HpmTestIrqInstalled(HPM2LITEOS_IRQ(IRQn_XDMA)));
+    TestPortClose(&port);
+}
+
+/*
+ * The rx dma ring wraps while the harvest is held off. A full lap leaves the
+ * write position where the reader is, which used to read as "no data", or as
+ * lapped once the wraps were counted: one full buffer must be delivered, more
+ * must be counted in swOverflow, and the data after a lap must come through.
+ */
+static void TestRxDmaLap(uint32_t extra)
+{
+    struct TestPort port;
+    static uint8_t tx[4096];
+    static uint8_t rx[4096];
+    /* 115200 baud: 329 bytes per 20 ms, a 512 byte dma ring */
+    const uint32_t ring = 512;
+    uint32_t lost;
+
+    if (!TestPortOpen(&port, 115200)) {
+        return;
+    }
+    port.host->method->SetTransMode(port.host, UART_MODE_DMA_RX_EN);
+    port.host->method->SetTransMode(port.host, UART_MODE_RD_NONBLOCK);
+    HpmUartClearRxStats(TEST_UART_ID);
+
+    TestFill(tx, ring + extra);
+    TestSendLocked(tx, ring + extra);
+    lost = TestRxLost();
+    if (extra == 0) {
+        HPM_TEST_CHECK_EQ(port.host->method->Read(port.host, rx, sizeof(rx)), ring);
+        HPM_TEST_CHECK(memcmp(tx, rx, ring) == 0);
+        HPM_TEST_CHECK_EQ(lost, 0);
+    } else {
+        HPM_TEST_CHECK_EQ(port.host->method->Read(port.host, rx, sizeof(rx)) + lost, ring + extra);
+        HPM_TEST_CHECK(lost > ring);
+    }
+
+    TestFill(tx, 100);
+    TestSend(tx, 100);
+    HPM_TEST_CHECK_EQ(port.host->method->Read(port.host, rx, sizeof(rx)), 100);
+    HPM_TEST_CHECK(memcmp(tx, rx, 100) == 0);
+    HPM_TEST_CHECK_EQ(TestRxLost(), lost);
+    TestPortClose(&port);
+}
+
+/* The rx dma ring covers a 10 ms int lock at 3 Mbaud, at 115200 a 60 ms lock is counted as lost */
+static void TestRxDmaBufSize(void)
+{
+    struct TestPort port;
+    static uint8_t tx[TEST_RX_BUF_SIZE];
+    static uint8_t rx[TEST_RX_BUF_SIZE];
+    uint32_t len;
+
+    if (!TestPortOpen(&port, 3000000)) {
+        return;
+    }
+    port.host->method->SetTransMode(port.host, UART_MODE_DMA_RX_EN);
+    port.host->method->SetTransMode(port.host, UART_MODE_RD_NONBLOCK);
+    HpmUartClearRxStats(TEST_UART_ID);
+
+    len = (uint32_t)(10 * TEST_MS / HpmTestUartCharNs(&g_uart));
+    TestFill(tx, len);
+    TestSendLocked(tx, len);
+    HPM_TEST_CHECK_EQ(port.host->method->Read(port.host, rx, sizeof(rx)), len);
+    HPM_TEST_CHECK(memcmp(tx, rx, len) == 0);
+    HPM_TEST_CHECK_EQ(TestRxLost(), 0);
+
+    port.host->method->SetBaud(port.host, 115200);
+    HpmUartClearRxStats(TEST_UART_ID);
+    len = (uint32_t)(60 * TEST_MS / HpmTestUartCharNs(&g_uart));
+    TestFill(tx, len);
+    TestSendLocked(tx, len);
+    HPM_TEST_CHECK(TestRxLost() != 0);
+    HPM_TEST_CHECK_EQ(port.host->method->Read(port.host, rx, sizeof(rx)) + TestRxLost(), len);
+    TestPortClose(&port);
+}
+
+/* With nobody reading, a full rx ring keeps its oldest data and counts the newest bytes as lost */
+static void TestRxOverflow(void)
+{
+    struct TestPort port;
+    static uint8_t tx[TEST_RX_BUF_SIZE + 500];
+    static uint8_t rx[TEST_RX_BUF_SIZE + 500];
+    struct HpmUartRxStats stats;
+
+    if (!TestPortOpen(&port, 921600)) {
+        return;
+    }
+    port.host->method->SetTransMode(port.host, UART_MODE_RD_NONBLOCK);
+    HpmUartClearRxStats(TEST_UART_ID);
+
+    TestFill(tx, sizeof(tx));
+    TestSend(tx, sizeof(tx));
+    HpmUartGetRxStats(TEST_UART_ID, &stats);
+    HPM_TEST_CHECK_EQ(stats.rxBytes, TEST_RX_BUF_SIZE);
+    HPM_TEST_CHECK_EQ(stats.swOverflow, 500);
+    HPM_TEST_CHECK_EQ(stats.hwOverrun, 0);
+    HPM_TEST_CHECK_EQ(port.host->method->Read(port.host, rx, sizeof(rx)), TEST_RX_BUF_SIZE);
+    HPM_TEST_CHECK(memcmp(tx, rx, TEST_RX_BUF_SIZE) == 0);
+    TestPortClose(&port);
+}
+
+/*
+ * Bursts with gaps, through the rx isr or the rx dma: a blocking read for more than a burst
+ * returns the burst once the line went idle, and a read over a continuous
+ * stream returns the partial count at its deadline. The latency from the last
+ * stop bit of a frame to the return of Read() is printed per frame.
+ */
+static void TestReadGaps(const char *name, enum UartTransMode rxMode)
+{
+    struct TestPort port;
+    static uint8_t tx[1024];
+    static uint8_t rx[1024];
+    const uint32_t frames = 5;
+    const uint32_t frameLen = 40;
+    uint64_t start;
+    uint64_t frameEnd;
+    uint64_t latency;
+    int32_t got;
+
+    if (!TestPortOpen(&port, 115200)) {
+        return;
+    }
+    port.host->method->SetTransMode(port.host, rxMode);
+    port.host->method->SetTransMode(port.host, UART_MODE_RD_BLOCK);
+    HpmUartSetReadTimeout(TEST_UART_ID, 50, 2);
+
+    start = HpmTestNowNs();
+    TestFill(tx, frames * frameLen);
+    for (uint32_t i = 0; i < frames; i++) {
+        HpmTestUartRxSend(&g_uart, &tx[i * frameLen], frameLen, start + (i + 1) * 10 * TEST_MS);
+    }
+    for (uint32_t i = 0; i < frames; i++) {
+        frameEnd = start + (i + 1) * 10 * TEST_MS + frameLen * HpmTestUartCharNs(&g_uart);
+        got = port.host->method->Read(port.host, rx, sizeof(rx));
+        latency = HpmTestNowNs() - frameEnd;
+        HPM_TEST_CHECK_EQ(got, frameLen);
+        HPM_TEST_CHECK(memcmp(&tx[i * frameLen], rx, frameLen) == 0);
+        HPM_TEST_CHECK(latency <= 3 * TEST_MS);
+        printf("%-8s frame %u, %u bytes: read returned %.3f ms after the last byte\n", name, (unsigned)i,
+               (unsigned)got, (double)latency / TEST_MS);
+    }
+
+    /* the stream outlasts the deadline: what arrived until then is returned */
+    HpmUartSetReadTimeout(TEST_UART_ID, 20, 2);
+    TestFill(tx, sizeof(tx));
+    start = HpmTestNowNs();
+    HpmTestUartRxSend(&g_uart, tx, sizeof(tx), start);
+    got = port.host->method->Read(port.host, rx, sizeof(rx));
+    latency = HpmTestNowNs() - start;
+    HPM_TEST_CHECK(got > 0);
+    HPM_TEST_CHECK(got < (int32_t)sizeof(tx));
+    HPM_TEST_CHECK(memcmp(tx, rx, got) == 0);
+    HPM_TEST_CHECK((latency >= 20 * TEST_MS) && (latency <= 22 * TEST_MS));
+    printf("%-8s deadline 20 ms: read returned %d of %u bytes after %.3f ms\n", name, (int)got,
+           (unsigned)sizeof(tx), (double)latency / TEST_MS);
+    HpmTestRunUntil(HpmTestUartRxEndNs(&g_uart) + 8 * HpmTestUartCharNs(&g_uart));
+    TestPortClose(&port);
+}
+
+/* A bus error stops the tx dma channel mid block: the rest must still go out, once and in order */
+static void TestTxDmaError(void)
+{
+    struct TestPort port;
+    static uint8_t tx[2048];
+    static uint8_t line[2048];
+    uint32_t errors = HpmTestDmaErrors(0) + HpmTestDmaErrors(1);
+
+    if (!TestPortOpen(&port, 921600)) {
+        return;
+    }
+    port.host->method->SetTransMode(port.host, UART_MODE_DMA_TX_EN);
+    HpmTestUartTxCapture(&g_uart, line, sizeof(line));
+    TestFill(tx, sizeof(tx));
+
+    HpmTestDmaFailAfter(HPM_DMA_SRC_UART3_TX, 300);
+    HPM_TEST_CHECK_EQ(port.host->method->Write(port.host, tx, sizeof(tx)), sizeof(tx));
+    HpmTestRunUntil(HpmTestNowNs() + 2 * sizeof(tx) * HpmTestUartCharNs(&g_uart));
+
+    HPM_TEST_CHECK_EQ(HpmTestDmaErrors(0) + HpmTestDmaErrors(1) - errors, 1);
+    HPM_TEST_CHECK_EQ(g_uart.txCaptured, sizeof(tx));
+    HPM_TEST_CHECK(memcmp(tx, line, sizeof(line)) == 0);
+    HpmTestUartTxCapture(&g_uart, NULL, 0);
+    TestPortClose(&port);
+}
+
+/*
+ * Loopback of one block per mode, the caller writes and reads every 32 characters: data
+ * must match. Throughput is taken from the virtual clock, the cpu cost is the
+ * virtual time charged for register accesses, in cycles at TEST_CPU_MHZ.
+ */
+static void TestModeCost(const char *name, enum UartTransMode rxMode, enum UartTransMode txMode)
+{
+    struct TestPort port;
+    static uint8_t tx[8192];
+    static uint8_t rx[8192];
+    static uint8_t line[8192];
+    const uint32_t costNs = 10;
+    uint32_t sent = 0;
+    uint32_t got = 0;
+    uint64_t start;
+    uint64_t deadline;
+    uint64_t regs;
+    double secs;
+
+    if (!TestPortOpen(&port, 921600)) {
+        return;
+    }
+    port.host->method->SetTransMode(port.host, rxMode);
+    port.host->method->SetTransMode(port.host, txMode);
+    port.host->method->SetTransMode(port.host, UART_MODE_RD_NONBLOCK);
+    HpmTestUartTxCapture(&g_uart, line, sizeof(line));
+    TestFill(tx, sizeof(tx));
+
+    regs = HpmTestMmioAccesses();
+    start = HpmTestNowNs();
+    deadline = start + 4 * sizeof(tx) * HpmTestUartCharNs(&g_uart);
+    HpmTestUartRxSend(&g_uart, tx, sizeof(tx), start);
+    while (((got < sizeof(rx)) || (g_uart.txCaptured < sizeof(tx))) && (HpmTestNowNs() < deadline)) {
+        if (sent < sizeof(tx)) {
+            HPM_TEST_CHECK_EQ(port.host->method->Write(port.host, &tx[sent], 32), 32);
+            sent += 32;
+        }
+        got += port.host->method->Read(port.host, &rx[got], sizeof(rx) - got);
+        HpmTestRunUntil(HpmTestNowNs() + 32 * HpmTestUartCharNs(&g_uart));
+    }
+    secs = (double)(HpmTestNowNs() - start) / 1e9;
+    regs = HpmTestMmioAccesses() - regs;
+
+    HPM_TEST_CHECK_EQ(got, sizeof(rx));
+    HPM_TEST_CHECK(memcmp(tx, rx, sizeof(rx)) == 0);
+    HPM_TEST_CHECK_EQ(g_uart.txCaptured, sizeof(tx));
+    HPM_TEST_CHECK(memcmp(tx, line, sizeof(line)) == 0);
+    printf("%-8s 921600 baud, %u bytes each way: %.0f bytes/s each way, %.1f cpu cycles/byte\n", name,
+           (unsigned)sizeof(tx), sizeof(tx) / secs,
+           (double)regs * costNs * TEST_CPU_MHZ / 1000 / (2 * sizeof(tx)));
+    HpmTestUartTxCapture(&g_uart, NULL, 0);
+    TestPortClose(&port);
+}
+
+int main(void)
+{
+    HpmTestVirtualTime(true);
+    HpmTestMmioCostNs(10);
+    HpmTestDmaModelInit();
+    HpmTestUartInit(&g_uart, HPM_UART3_BASE, IRQn_UART3, TEST_UART_CLK, HPM_DMA_SRC_UART3_RX,
+                    HPM_DMA_SRC_UART3_TX, 65536);
+
+    /* first, the dma port init state is static */
+    TestDmaPortInitRetry();
+    TestRxDmaLap(0);
+    TestRxDmaLap(200);
+    TestRxDmaBufSize();
+    TestRxOverflow();
+    TestReadGaps("irq", UART_MODE_DMA_RX_DIS);
+    TestReadGaps("dma", UART_MODE_DMA_RX_EN);
+    TestTxDmaError();
+    TestModeCost("irq", UART_MODE_DMA_RX_DIS, UART_MODE_DMA_TX_DIS);
+    TestModeCost("dma", UART_MODE_DMA_RX_EN, UART_MODE_DMA_TX_EN);
+
+    HpmTestUartDeinit(&g_uart);
+    HpmTestDmaModelDeinit();
+    return HpmTestResult();
+}
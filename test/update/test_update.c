@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * hpm6700/hals/update/hal_hota_board.c on the NOR flash model: streaming an
+ * image into the inactive slot with read back while it is in flight, the boot
+ * record as the bootloader reads it, rollback, flash errors, a power cut at
+ * every flash operation of the slot switch, and how much of the flash time
+ * the double buffering hides behind the download.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "hal_hota_board.h"
+#include "hota_flash.h"
+#include "mbedtls/sha256.h"
+#include "hpm_test.h"
+#include "hpm_test_nor.h"
+
+#define TEST_SECTOR 4096U
+#define TEST_PAGE 256U
+#define TEST_FLASH_SIZE (HOTA_BOOT_RECORD_ADDR + 2 * TEST_SECTOR)
+#define TEST_ERASE_NS 200000ULL
+#define TEST_PAGE_NS 10000ULL
+#define TEST_IMAGE_MAX (256U * 1024U)
+#define TEST_BENCH_ERASE_NS 30000000ULL
+#define TEST_BENCH_PAGE_NS 600000ULL
+#define TEST_BENCH_CHUNK 1024U
+#define TEST_NS_PER_MS 1000000ULL
+
+static struct HpmTestNor g_nor;
+static uint8_t g_image[TEST_IMAGE_MAX];
+static uint8_t g_back[TEST_IMAGE_MAX];
+static uint8_t g_snapshot[TEST_FLASH_SIZE];
+static uint32_t g_seed = 0x07A5EED1U;
+
+static int32_t TestFlashRead(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    return HpmTestNorRead(&g_nor, addr, buf, len);
+}
+
+static int32_t TestFlashErase(uint32_t addr)
+{
+    return HpmTestNorErase(&g_nor, addr);
+}
+
+static int32_t TestFlashProgram(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    return HpmTestNorProgram(&g_nor, addr, buf, len);
+}
+
+static bool TestFlashBusy(void)
+{
+    return HpmTestNorBusy(&g_nor);
+}
+
+int32_t HotaFlashPortInit(struct HotaFlashOps *ops)
+{
+    ops->sectorSize = g_nor.sectorSize;
+    ops->pageSize = g_nor.pageSize;
+    ops->read = TestFlashRead;
+    ops->erase = TestFlashErase;
+    ops->program = TestFlashProgram;
+    ops->busy = TestFlashBusy;
+    return 0;
+}
+
+static uint32_t TestCrc32(const uint8_t *buf, uint32_t len)
+{
+    uint32_t crc = 0xFFFFFFFFU;
+
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320U) : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+/* What the bootloader does: the valid copy with the highest seq, false on blank flash */
+static bool TestBootRecord(struct HotaBootRecord *out)
+{
+    bool found = false;
+
+    for (uint32_t i = 0; i < 2; i++) {
+        struct HotaBootRecord r;
+        (void)memcpy(&r, &g_nor.mem[HOTA_BOOT_RECORD_ADDR + i * TEST_SECTOR], sizeof(r));
+        if ((r.magic != HOTA_BOOT_RECORD_MAGIC) || (r.active >= HOTA_SLOT_NUM) ||
+            (r.crc != TestCrc32((const uint8_t *)&r, offsetof(struct HotaBootRecord, crc)))) {
+            continue;
+        }
+        if (!found || ((int32_t)(r.seq - out->seq) > 0)) {
+            *out = r;
+            found = true;
+        }
+    }
+    return found;
+}
+
+static uint32_t TestSlotAddr(uint32_t slot)
+{
+    return (slot == 0) ? HOTA_SLOT_A_ADDR : HOTA_SLOT_B_ADDR;
+}
+
+/* The image the record points the bootloader at is intact */
+static bool TestBootImageValid(const struct HotaBootRecord *r)
+{
+    uint8_t sha[HOTA_SHA256_LEN];
+    const uint8_t *img = &g_nor.mem[TestSlotAddr(r->active)];
+
+    (void)mbedtls_sha256(img, r->imgSize[r->active], sha, 0);
+    return (r->imgSize[r->active] <= HOTA_SLOT_SIZE) &&
+           (TestCrc32(img, r->imgSize[r->active]) == r->imgCrc[r->active]) &&
+           (memcmp(sha, r->imgSha256[r->active], sizeof(sha)) == 0);
+}
+
+static void TestImage(uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        g_image[i] = (uint8_t)HpmTestRand(&g_seed);
+    }
+}
+
+/* Stream <len> bytes of g_image in random chunks, reading back now and then */
+static bool TestStream(uint32_t len, bool readBack)
+{
+    uint32_t off = 0;
+
+    while (off < len) {
+        uint32_t n = 1 + HpmTestRand(&g_seed) % 3000;
+        n = (n > len - off) ? (len - off) : n;
+        if (!HPM_TEST_CHECK_EQ(HotaHalWrite(0, &g_image[off], off, n), OHOS_SUCCESS)) {
+            return false;
+        }
+        off += n;
+        if (readBack && ((HpmTestRand(&g_seed) % 8) == 0)) {
+            /* spans flash, the buffer being filled, or both */
+            uint32_t from = HpmTestRand(&g_seed) % off;
+            uint32_t cnt = 1 + HpmTestRand(&g_seed) % (off - from);
+            (void)memset(g_back, 0, cnt);
+            if (!HPM_TEST_CHECK_EQ(HotaHalRead(0, from, cnt, g_back), OHOS_SUCCESS) ||
+                !HPM_TEST_CHECK_EQ(memcmp(g_back, &g_image[from], cnt), 0)) {
+                return false;
+            }
+            /* nothing past what was written */
+            HPM_TEST_CHECK_EQ(HotaHalRead(0, off - 1, 2, g_back), OHOS_FAILURE);
+        }
+    }
+    return true;
+}
+
+static void TestUpdateStream(void)
+{
+    struct HotaBootRecord r;
+    unsigned int index = 9;
+    uint32_t len = 100 * 1024 + 123;
+
+    HPM_TEST_CHECK(!TestBootRecord(&r));
+    HPM_TEST_CHECK_EQ(HotaHalInit(), OHOS_SUCCESS);
+    HPM_TEST_CHECK_EQ(HotaHalInit(), OHOS_FAILURE);
+    HPM_TEST_CHECK_EQ(HotaHalGetUpdateIndex(&index), OHOS_SUCCESS);
+    HPM_TEST_CHECK_EQ(index, 1);
+    HPM_TEST_CHECK_EQ(HotaHalSetBootSettings(), OHOS_FAILURE);
+
+    TestImage(len);
+    HPM_TEST_CHECK(TestStream(len, true));
+    HPM_TEST_CHECK_EQ(HotaHalSetBootSettings(), OHOS_SUCCESS);
+    HPM_TEST_CHECK_EQ(memcmp(&g_nor.mem[HOTA_SLOT_B_ADDR], g_image, len), 0);
+    HPM_TEST_CHECK(TestBootRecord(&r));
+    HPM_TEST_CHECK_EQ(r.active, 1);
+    HPM_TEST_CHECK_EQ(r.previous, 0);
+    HPM_TEST_CHECK_EQ(r.trial, 1);
+    HPM_TEST_CHECK_EQ(r.imgSize[1], len);
+    HPM_TEST_CHECK(TestBootImageValid(&r));
+    HPM_TEST_CHECK_EQ(HotaHalDeInit(), OHOS_SUCCESS);
+    HPM_TEST_CHECK_EQ(HotaHalDeInit(), OHOS_FAILURE);
+
+    /* the next update goes to the other slot, a sector multiple this time */
+    HPM_TEST_CHECK_EQ(HotaHalInit(), OHOS_SUCCESS);
+    HPM_TEST_CHECK_EQ(HotaHalGetUpdateIndex(&index), OHOS_SUCCESS);
+    HPM_TEST_CHECK_EQ(index, 0);
+    len = 16 * TEST_SECTOR;
+    TestImage(len);
+    HPM_TEST_CHECK(TestStream(len, true));
+    HPM_TEST_CHECK_EQ(HotaHalSetBootSettings(), OHOS_SUCCESS);
+    HPM_TEST_CHECK(TestBootRecord(&r));
+    HPM_TEST_CHECK_EQ(r.active, 0);
+    HPM_TEST_CHECK_EQ(r.previous, 1);
+    HPM_TEST_CHECK(TestBootImageValid(&r));
+
+    /* rollback switches back and clears the trial */
+    HPM_TEST_CHECK_EQ(HotaHalRollback(), OHOS_SUCCESS);
+    HPM_TEST_CHECK(TestBootRecord(&r));
+    HPM_TEST_CHECK_EQ(r.active, 1);
+    HPM_TEST_CHECK_EQ(r.previous, 0);
+    HPM_TEST_CHECK_EQ(r.trial, 0);
+    HPM_TEST_CHECK(TestBootImageValid(&r));
+    HPM_TEST_CHECK_EQ(HotaHalDeInit(), OHOS_SUCCESS);
+}
+
+static void TestUpdateSession(void)
+{
+    struct HotaBootRecord before;
+    struct HotaBootRecord r;
+    uint32_t len = 8 * TEST_SECTOR;
+
+    HPM_TEST_CHECK(TestBootRecord(&before));
+    HPM_TEST_CHECK_EQ(HotaHalInit(), OHOS_SUCCESS);
+    TestImage(len);
+
+    /* ranges that wrap around 4 GiB, while the first sector is still in RAM */
+    HPM_TEST_CHECK_EQ(HotaHalWrite(0, g_image, 0, 100), OHOS_SUCCESS);
+    HPM_TEST_CHECK_EQ(HotaHalRead(0, 0xFFFFFFFFU, 2, g_back), OHOS_FAILURE);
+    HPM_TEST_CHECK_EQ(HotaHalRead(0, 1, 0xFFFFFFFFU, g_back), OHOS_FAILURE);
+    HPM_TEST_CHECK_EQ(HotaHalWrite(0, g_image, 0xFFFFFFFFU, 2), OHOS_FAILURE);
+
+    /* out of order is refused, offset 0 starts over */
+    HPM_TEST_CHECK_EQ(HotaHalWrite(0, g_image, 0, 5000), OHOS_SUCCESS);
+    HPM_TEST_CHECK_EQ(HotaHalWrite(0, g_image, 6000, 10), OHOS_FAILURE);
+    HPM_TEST_CHECK_EQ(HotaHalWrite(0, g_image, HOTA_SLOT_SIZE - 4, 8), OHOS_FAILURE);
+    HPM_TEST_CHECK(TestStream(len, false));
+
+    /* a bit that did not make it to flash fails the verify, the record stays */
+    HPM_TEST_CHECK_EQ(HotaHalRead(0, 0, 1, g_back), OHOS_SUCCESS);
+    g_nor.mem[TestSlotAddr(before.active ^ 1) + 100] ^= 0x10;
+    HPM_TEST_CHECK_EQ(HotaHalSetBootSettings(), OHOS_FAILURE);
+    HPM_TEST_CHECK(TestBootRecord(&r));
+    HPM_TEST_CHECK_EQ(r.seq, before.seq);
+    HPM_TEST_CHECK_EQ(HotaHalDeInit(), OHOS_SUCCESS);
+
+    /* a flash that stops working fails the download */
+    HPM_TEST_CHECK_EQ(HotaHalInit(), OHOS_SUCCESS);
+    HpmTestNorCutAfter(&g_nor, 20);
+    {
+        uint32_t off = 0;
+        int ret = OHOS_SUCCESS;
+        while ((off < len) && (ret == OHOS_SUCCESS)) {
+            ret = HotaHalWrite(0, &g_image[off], off, TEST_SECTOR);
+            off += TEST_SECTOR;
+        }
+        if (ret == OHOS_SUCCESS) {
+            ret = HotaHalSetBootSettings();
+        }
+        HPM_TEST_CHECK_EQ(ret, OHOS_FAILURE);
+    }
+    HpmTestNorPowerOn(&g_nor);
+    (void)HotaHalDeInit();
+    HPM_TEST_CHECK(TestBootRecord(&r));
+    HPM_TEST_CHECK_EQ(r.seq, before.seq);
+}
+
+/*
+ * Power goes away at each erase and program of HotaHalSetBootSettings in
+ * turn. After the reboot the bootloader must find either the old record or
+ * the new one, and whichever it finds must point at an intact image.
+ */
+static void TestUpdatePowerCut(void)
+{
+    struct HotaBootRecord before;
+    struct HotaBootRecord r;
+    uint32_t len = 5 * TEST_SECTOR + 700;
+    uint32_t oldCount = 0;
+    uint32_t newCount = 0;
+    uint32_t cut;
+
+    HPM_TEST_CHECK(TestBootRecord(&before));
+    (void)memcpy(g_snapshot, g_nor.mem, TEST_FLASH_SIZE);
+    TestImage(len);
+
+    for (cut = 1; cut < 1000; cut++) {
+        int ret;
+
+        (void)memcpy(g_nor.mem, g_snapshot, TEST_FLASH_SIZE);
+        HPM_TEST_CHECK_EQ(HotaHalInit(), OHOS_SUCCESS);
+        HPM_TEST_CHECK(TestStream(len, false));
+        HPM_TEST_CHECK_EQ(HotaHalRead(0, 0, 1, g_back), OHOS_SUCCESS);
+        HpmTestNorCutAfter(&g_nor, cut);
+        ret = HotaHalSetBootSettings();
+        bool cutHit = g_nor.powerOff;
+        HpmTestNorPowerOn(&g_nor);
+        (void)HotaHalDeInit();
+
+        if (!HPM_TEST_CHECK(TestBootRecord(&r)) || !HPM_TEST_CHECK(TestBootImageValid(&r))) {
+            printf("power cut at flash op %u\n", cut);
+            break;
+        }
+        if (r.seq == before.seq) {
+            HPM_TEST_CHECK_EQ(r.active, before.active);
+            oldCount++;
+        } else {
+            HPM_TEST_CHECK_EQ(r.seq, before.seq + 1);
+            HPM_TEST_CHECK_EQ(r.active, before.active ^ 1);
+            newCount++;
+        }
+        if (!cutHit) {
+            HPM_TEST_CHECK_EQ(ret, OHOS_SUCCESS);
+            break;
+        }
+    }
+    printf("power cut: %u flash ops in the slot switch, old record kept %u times, new one %u times\n",
+           cut - 1, oldCount, newCount);
+    HPM_TEST_CHECK(oldCount != 0);
+    HPM_TEST_CHECK_EQ(newCount, 1);
+}
+
+/* The download runs at a fixed rate, the flash works in the background */
+static void TestUpdateBench(void)
+{
+    uint32_t len = (HpmTestFull() ? 256U : 64U) * 1024U;
+    uint64_t chunkNs = (TEST_BENCH_ERASE_NS + (TEST_SECTOR / TEST_PAGE) * TEST_BENCH_PAGE_NS) /
+                       (TEST_SECTOR / TEST_BENCH_CHUNK);
+    uint64_t netNs = 0;
+    uint64_t writeNs = 0;
+    uint64_t t0;
+    uint64_t total;
+
+    HpmTestNorDeinit(&g_nor);
+    HpmTestNorInit(&g_nor, TEST_FLASH_SIZE, TEST_SECTOR, TEST_PAGE, TEST_BENCH_ERASE_NS, TEST_BENCH_PAGE_NS);
+    TestImage(len);
+
+    HPM_TEST_CHECK_EQ(HotaHalInit(), OHOS_SUCCESS);
+    t0 = HpmTestHostNs();
+    for (uint32_t off = 0; off < len; off += TEST_BENCH_CHUNK) {
+        uint64_t t = HpmTestHostNs();
+        usleep(chunkNs / 1000);
+        netNs += HpmTestHostNs() - t;
+        t = HpmTestHostNs();
+        HPM_TEST_CHECK_EQ(HotaHalWrite(0, &g_image[off], off, TEST_BENCH_CHUNK), OHOS_SUCCESS);
+        writeNs += HpmTestHostNs() - t;
+    }
+    HPM_TEST_CHECK_EQ(HotaHalSetBootSettings(), OHOS_SUCCESS);
+    total = HpmTestHostNs() - t0;
+    HPM_TEST_CHECK_EQ(HotaHalDeInit(), OHOS_SUCCESS);
+
+    printf("update bench, %u KB image, %u byte chunks, sector erase %llu ms, page program %llu us\n",
+           len / 1024, TEST_BENCH_CHUNK, TEST_BENCH_ERASE_NS / TEST_NS_PER_MS, TEST_BENCH_PAGE_NS / 1000);
+    printf("  download %llu ms, flash busy %llu ms, caller blocked in HotaHalWrite %llu ms\n",
+           (unsigned long long)(netNs / TEST_NS_PER_MS), (unsigned long long)(g_nor.busyNs / TEST_NS_PER_MS),
+           (unsigned long long)(writeNs / TEST_NS_PER_MS));
+    printf("  total %llu ms, download then flash would take %llu ms\n",
+           (unsigned long long)(total / TEST_NS_PER_MS),
+           (unsigned long long)((netNs + g_nor.busyNs) / TEST_NS_PER_MS));
+}
+
+int main(void)
+{
+    HpmTestNorInit(&g_nor, TEST_FLASH_SIZE, TEST_SECTOR, TEST_PAGE, TEST_ERASE_NS, TEST_PAGE_NS);
+
+    TestUpdateStream();
+    TestUpdateSession();
+    TestUpdatePowerCut();
+    TestUpdateBench();
+
+    HpmTestNorDeinit(&g_nor);
+    return HpmTestResult();
+}
@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <string.h>
+#include "hpm_soc.h"
+#include "soc.h"
+#include "los_interrupt.h"
+#include "usb_hc_ehci.h"
+#include "hpm_test_ehci.h"
+
+#define EHCI_MODEL_HCOR ((struct ehci_hcor *)g_hpmTestEhciHcor)
+#define EHCI_MODEL_LINK_MASK (~0x1FU)
+#define EHCI_MODEL_LINK_TYPE(link) (((link) >> 1) & 3U)
+#define EHCI_MODEL_LINK_ITD 0U
+#define EHCI_MODEL_LINK_QH 1U
+#define EHCI_MODEL_LINK_SITD 2U
+#define EHCI_MODEL_PAGE 0x1000U
+/* longest async ring and periodic chain the model follows */
+#define EHCI_MODEL_QH_MAX 256U
+#define EHCI_MODEL_PACKET_MAX (1024U * 3U)
+/* page pointers of an iTD and a siTD */
+#define EHCI_MODEL_ITD_PAGES 7U
+#define EHCI_MODEL_SITD_PAGES 2U
+/* full speed bytes a TT moves per micro-frame */
+#define EHCI_MODEL_SPLIT_BYTES 188U
+/* an isochronous buffer past the page pointers */
+#define EHCI_MODEL_ISO_OVERRUN (-3)
+/* per transaction bus overhead charged to the async budget */
+#define EHCI_MODEL_PACKET_OVERHEAD 32U
+#define EHCI_MODEL_STS_IRQS (EHCI_USBSTS_INT | EHCI_USBSTS_ERR | EHCI_USBSTS_PCD | EHCI_USBSTS_FLR | \
+                             EHCI_USBSTS_FATAL | EHCI_USBSTS_IAA)
+
+/* A qh taken off the async ring, kept until a doorbell rung after the unlink is acknowledged */
+struct EhciModelUnlinked {
+    struct ehci_qh *qh;
+    struct ehci_qh copy;
+    bool rung;
+};
+
+struct EhciModel {
+    HpmTestEhciPacket packet;
+    void *ctx;
+    uint32_t losIrq;
+    uint64_t nextNs;
+    uint32_t doorbellLatency;
+    /* micro-frames left of the doorbell in flight, 0 when none is */
+    uint32_t doorbellLeft;
+    /* micro-frames left without the periodic schedule */
+    uint32_t periodicSkip;
+    struct ehci_qh *ring[EHCI_MODEL_QH_MAX];
+    uint32_t ringNum;
+    struct EhciModelUnlinked unlinked[EHCI_MODEL_QH_MAX];
+    uint32_t unlinkedNum;
+    uint8_t buf[EHCI_MODEL_PACKET_MAX];
+    struct HpmTestEhciStats stats;
+    struct HpmTestModel model;
+};
+
+uint32_t g_hpmTestEhciHcor[32] __attribute__((aligned(32)));
+
+_Static_assert(sizeof(struct ehci_hcor) == sizeof(g_hpmTestEhciHcor), "hcor layout");
+
+static struct EhciModel g_ehci;
+
+void USBH_IRQHandler(void);
+
+static void *EhciModelPtr(uint32_t link)
+{
+    return (void *)(uintptr_t)(link & EHCI_MODEL_LINK_MASK);
+}
+
+/* Load the next active qTD into the overlay, false when the qh has nothing to run */
+static bool EhciModelFetch(struct ehci_qh *qh)
+{
+    struct ehci_qtd *qtd;
+    uint32_t toggle = qh->overlay.token & QTD_TOKEN_TOGGLE;
+
+    if ((qh->overlay.token & QTD_TOKEN_STATUS_ACTIVE) != 0) {
+        return true;
+    }
+    if (((qh->overlay.token & QTD_TOKEN_STATUS_HALTED) != 0) || ((qh->overlay.next_qtd & QTD_LIST_END) != 0)) {
+        return false;
+    }
+    qtd = EhciModelPtr(qh->overlay.next_qtd);
+    if ((qtd->token & QTD_TOKEN_STATUS_ACTIVE) == 0) {
+        return false;
+    }
+    qh->curr_qtd = qh->overlay.next_qtd & EHCI_MODEL_LINK_MASK;
+    qh->overlay = *qtd;
+    if ((qh->epchar & QH_EPCHAR_DTC) == 0) {
+        qh->overlay.token = (qh->overlay.token & ~QTD_TOKEN_TOGGLE) | toggle;
+    }
+    return true;
+}
+
+/* Buffer address <pos> bytes past the current offset of the overlay */
+static uint8_t *EhciModelAddr(const struct ehci_qtd *ov, uint32_t pos)
+{
+    uint32_t page = (ov->token & QTD_TOKEN_CPAGE_MASK) >> QTD_TOKEN_CPAGE_SHIFT;
+    uint32_t offset = (ov->bpl[0] & (EHCI_MODEL_PAGE - 1U)) + pos;
+
+    page += offset / EHCI_MODEL_PAGE;
+    offset %= EHCI_MODEL_PAGE;
+    return (uint8_t *)(uintptr_t)((ov->bpl[page] & ~(EHCI_MODEL_PAGE - 1U)) + offset);
+}
+
+static void EhciModelCopy(const struct ehci_qtd *ov, uint8_t *buf, uint32_t len, bool toQtd)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t *p = EhciModelAddr(ov, i);
+        if (toQtd) {
+            *p = buf[i];
+        } else {
+            buf[i] = *p;
+        }
+    }
+}
+
+static void EhciModelAdvance(struct ehci_qtd *ov, uint32_t len)
+{
+    uint32_t page = (ov->token & QTD_TOKEN_CPAGE_MASK) >> QTD_TOKEN_CPAGE_SHIFT;
+    uint32_t offset = (ov->bpl[0] & (EHCI_MODEL_PAGE - 1U)) + len;
+
+    page += offset / EHCI_MODEL_PAGE;
+    offset %= EHCI_MODEL_PAGE;
+    ov->token = (ov->token & ~QTD_TOKEN_CPAGE_MASK) | (page << QTD_TOKEN_CPAGE_SHIFT);
+    ov->bpl[0] = (ov->bpl[0] & ~(EHCI_MODEL_PAGE - 1U)) | offset;
+}
+
+/* The overlay qTD is over: its token goes back to the qTD, as the controller writes it back */
+static void EhciModelRetire(struct ehci_qh *qh)
+{
+    struct ehci_qtd *qtd = EhciModelPtr(qh->curr_qtd);
+
+    qtd->token = qh->overlay.token;
+    if ((qh->overlay.token & QTD_TOKEN_IOC) != 0) {
+        EHCI_MODEL_HCOR->usbsts |= EHCI_USBSTS_INT;
+    }
+}
+
+/* One transaction of <qh>, false when it did not run (idle, halted or NAKed) */
+static bool EhciModelTransact(struct ehci_qh *qh, uint32_t *bytes)
+{
+    struct ehci_qtd *ov = &qh->overlay;
+    uint32_t nbytes;
+    uint32_t mps = (qh->epchar & QH_EPCHAR_MAXPKT_MASK) >> QH_EPCHAR_MAXPKT_SHIFT;
+    uint32_t pid;
+    uint32_t len;
+    uint8_t ep;
+    int ret;
+
+    if (!EhciModelFetch(qh)) {
+        return false;
+    }
+    nbytes = (ov->token & QTD_TOKEN_NBYTES_MASK) >> QTD_TOKEN_NBYTES_SHIFT;
+    pid = (ov->token & QTD_TOKEN_PID_MASK) >> QTD_TOKEN_PID_SHIFT;
+    len = (nbytes < mps) ? nbytes : mps;
+    len = (len < EHCI_MODEL_PACKET_MAX) ? len : EHCI_MODEL_PACKET_MAX;
+    ep = (uint8_t)((qh->epchar & QH_EPCHAR_ENDPT_MASK) >> QH_EPCHAR_ENDPT_SHIFT);
+    if (pid == HPM_TEST_EHCI_PID_IN) {
+        ep |= 0x80U;
+    } else {
+        EhciModelCopy(ov, g_ehci.buf, len, false);
+    }
+
+    ret = g_ehci.packet(g_ehci.ctx, (uint8_t)((qh->epchar & QH_EPCHAR_DEVADDR_MASK) >> QH_EPCHAR_DEVADDR_SHIFT),
+                        ep, (uint8_t)pid, g_ehci.buf, len);
+    *bytes += EHCI_MODEL_PACKET_OVERHEAD;
+    if (ret == HPM_TEST_EHCI_NAK) {
+        return false;
+    }
+    if (ret == HPM_TEST_EHCI_STALL) {
+        ov->token = (ov->token & ~QTD_TOKEN_STATUS_ACTIVE) | QTD_TOKEN_STATUS_HALTED;
+        EhciModelRetire(qh);
+        EHCI_MODEL_HCOR->usbsts |= EHCI_USBSTS_ERR;
+        return false;
+    }
+    if (pid != HPM_TEST_EHCI_PID_IN) {
+        ret = (int)len;
+    } else if ((uint32_t)ret > len) {
+        ret = (int)len;
+    }
+    if (pid == HPM_TEST_EHCI_PID_IN) {
+        EhciModelCopy(ov, g_ehci.buf, (uint32_t)ret, true);
+    }
+    EhciModelAdvance(ov, (uint32_t)ret);
+    nbytes -= (uint32_t)ret;
+    ov->token = (ov->token & ~QTD_TOKEN_NBYTES_MASK) | (nbytes << QTD_TOKEN_NBYTES_SHIFT);
+    ov->token ^= QTD_TOKEN_TOGGLE;
+    *bytes += (uint32_t)ret;
+
+    /* a short packet ends the qTD as well, the driver never sets an alternate next */
+    if ((nbytes == 0) || ((uint32_t)ret < mps)) {
+        ov->token &= ~QTD_TOKEN_STATUS_ACTIVE;
+        EhciModelRetire(qh);
+    }
+    return true;
+}
+
+/* Isochronous buffer at <offset> of page <page>, NULL past the last page pointer */
+static uint8_t *EhciModelIsoAddr(const uint32_t *bpl, uint32_t pages, uint32_t page, uint32_t offset)
+{
+    page += offset / EHCI_MODEL_PAGE;
+    offset %= EHCI_MODEL_PAGE;
+    if (page >= pages) {
+        return NULL;
+    }
+    return (uint8_t *)(uintptr_t)((bpl[page] & ~(EHCI_MODEL_PAGE - 1U)) + offset);
+}
+
+static bool EhciModelIsoCopy(const uint32_t *bpl, uint32_t pages, uint32_t page, uint32_t offset, uint8_t *buf,
+                             uint32_t len, bool toMem)
+{
+    if ((len != 0) && (EhciModelIsoAddr(bpl, pages, page, offset + len - 1U) == NULL)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t *p = EhciModelIsoAddr(bpl, pages, page, offset + i);
+        if (toMem) {
+            *p = buf[i];
+        } else {
+            buf[i] = *p;
+        }
+    }
+    return true;
+}
+
+/*
+ * One isochronous transaction against the device, the bytes moved or
+ * EHCI_MODEL_ISO_OVERRUN. A device that NAKs or stalls moves nothing and
+ * gets HPM_TEST_EHCI_NAK, which the caller reports as a transaction error.
+ */
+static int EhciModelIsoTransact(const uint32_t *bpl, uint32_t pages, uint32_t page, uint32_t offset, uint8_t devAddr,
+                                uint8_t ep, uint32_t len, uint32_t *bytes)
+{
+    bool in = (ep & 0x80U) != 0;
+    int ret;
+
+    if ((len > EHCI_MODEL_PACKET_MAX) || (!in && !EhciModelIsoCopy(bpl, pages, page, offset, g_ehci.buf, len, false))) {
+        return EHCI_MODEL_ISO_OVERRUN;
+    }
+    ret = g_ehci.packet(g_ehci.ctx, devAddr, ep, in ? HPM_TEST_EHCI_PID_IN : HPM_TEST_EHCI_PID_OUT, g_ehci.buf, len);
+    *bytes += EHCI_MODEL_PACKET_OVERHEAD;
+    g_ehci.stats.isoPackets++;
+    if (ret < 0) {
+        return HPM_TEST_EHCI_NAK;
+    }
+    if (!in || ((uint32_t)ret > len)) {
+        ret = (int)len;
+    }
+    if (in && !EhciModelIsoCopy(bpl, pages, page, offset, g_ehci.buf, (uint32_t)ret, true)) {
+        return EHCI_MODEL_ISO_OVERRUN;
+    }
+    *bytes += (uint32_t)ret;
+    return ret;
+}
+
+/* The transaction of an iTD in <uframe>, its length field is written back with the bytes moved */
+static void EhciModelItd(struct ehci_itd *itd, uint32_t uframe, uint32_t *bytes)
+{
+    uint32_t tscl = itd->tscl[uframe];
+    uint32_t len = (tscl & ITD_TSCL_LENGTH_MASK) >> ITD_TSCL_LENGTH_SHIFT;
+    uint32_t mps = (itd->bpl[1] & ITD_BUFPTR1_MAXPKT_MASK) >> ITD_BUFPTR1_MAXPKT_SHIFT;
+    uint32_t mult = (itd->bpl[2] & ITD_BUFPTR2_MULTI_MASK) >> ITD_BUFPTR2_MULTI_SHIFT;
+    uint8_t ep = (uint8_t)((itd->bpl[0] & ITD_BUFPTR0_ENDPT_MASK) >> ITD_BUFPTR0_ENDPT_SHIFT);
+    int ret = EHCI_MODEL_ISO_OVERRUN;
+
+    if ((tscl & ITD_TSCL_STATUS_ACTIVE) == 0) {
+        return;
+    }
+    if ((itd->bpl[1] & ITD_BUFPTR1_DIRIN) != 0) {
+        ep |= 0x80U;
+    }
+    if ((mult != 0) && (len <= mps * mult)) {
+        ret = EhciModelIsoTransact(itd->bpl, EHCI_MODEL_ITD_PAGES, (tscl & ITD_TSCL_PG_MASK) >> ITD_TSCL_PG_SHIFT,
+                                   tscl & ITD_TSCL_XOFFS_MASK,
+                                   (uint8_t)((itd->bpl[0] & ITD_BUFPTR0_DEVADDR_MASK) >> ITD_BUFPTR0_DEVADDR_SHIFT),
+                                   ep, len, bytes);
+    }
+    tscl &= ~(ITD_TSCL_STATUS_ACTIVE | ITD_TSCL_LENGTH_MASK);
+    if (ret == HPM_TEST_EHCI_NAK) {
+        tscl |= ITD_TSCL_STATUS_XACTERR;
+    } else if (ret < 0) {
+        tscl |= ITD_TSCL_STATUS_DBERROR;
+    } else {
+        tscl |= (uint32_t)ret << ITD_TSCL_LENGTH_SHIFT;
+    }
+    itd->tscl[uframe] = tscl;
+    if ((tscl & ITD_TSCL_IOC) != 0) {
+        EHCI_MODEL_HCOR->usbsts |= EHCI_USBSTS_INT;
+    }
+}
+
+/*
+ * A siTD runs whole in its first start split micro-frame, the TT is not
+ * modelled. The masks must still fit the payload: an IN needs one start split
+ * and a complete split per 188 bytes, an OUT a start split per 188 bytes and
+ * the matching transaction count, or the siTD ends with a transaction error.
+ */
+static void EhciModelSitd(struct ehci_sitd *sitd, uint32_t uframe, uint32_t *bytes)
+{
+    uint32_t smask = (sitd->mfsc & SITD_MFSC_SMASK_MASK) >> SITD_MFSC_SMASK_SHIFT;
+    uint32_t cmask = (sitd->mfsc & SITD_MFSC_CMASK_MASK) >> SITD_MFSC_CMASK_SHIFT;
+    uint32_t tsc = sitd->tsc;
+    uint32_t len = (tsc & SITD_TSC_NBYTES_MASK) >> SITD_TSC_NBYTES_SHIFT;
+    uint32_t splits = (len + EHCI_MODEL_SPLIT_BYTES - 1U) / EHCI_MODEL_SPLIT_BYTES;
+    uint8_t ep = (uint8_t)((sitd->epchar & SITD_EPCHAR_ENDPT_MASK) >> SITD_EPCHAR_ENDPT_SHIFT);
+    bool fits;
+    int ret = HPM_TEST_EHCI_NAK;
+
+    if (((tsc & SITD_TSC_STATUS_ACTIVE) == 0) || ((smask & ((2U << uframe) - 1U)) != (1U << uframe))) {
+        return;
+    }
+    splits = (splits != 0) ? splits : 1U;
+    if ((sitd->epchar & SITD_EPCHAR_DIRIN) != 0) {
+        ep |= 0x80U;
+        fits = (smask == (1U << uframe)) && ((uint32_t)__builtin_popcount(cmask) >= splits);
+    } else {
+        fits = ((uint32_t)__builtin_popcount(smask) == splits) &&
+               (((sitd->bpl[1] & SITD_BUFPTR1_TCOUNT_MASK) >> SITD_BUFPTR1_TCOUNT_SHIFT) == splits);
+    }
+    if (fits) {
+        ret = EhciModelIsoTransact(sitd->bpl, EHCI_MODEL_SITD_PAGES, 0, sitd->bpl[0] & (EHCI_MODEL_PAGE - 1U),
+                                   (uint8_t)((sitd->epchar & SITD_EPCHAR_DEVADDR_MASK) >> SITD_EPCHAR_DEVADDR_SHIFT),
+                                   ep, len, bytes);
+    }
+    tsc &= ~(SITD_TSC_STATUS_ACTIVE | SITD_TSC_NBYTES_MASK);
+    if (ret == HPM_TEST_EHCI_NAK) {
+        tsc |= SITD_TSC_STATUS_XACTERR;
+    } else if (ret < 0) {
+        tsc |= SITD_TSC_STATUS_DBERROR;
+    } else {
+        /* what is left to transfer */
+        tsc |= (len - (uint32_t)ret) << SITD_TSC_NBYTES_SHIFT;
+    }
+    sitd->tsc = tsc;
+    if ((tsc & SITD_TSC_IOC) != 0) {
+        EHCI_MODEL_HCOR->usbsts |= EHCI_USBSTS_INT;
+    }
+}
+
+/* Frame list entry: the iTDs and siTDs of the micro-frame, then the interrupt qhs of their s-mask */
+static uint32_t EhciModelPeriodic(uint32_t frindex)
+{
+    uint32_t *framelist = EhciModelPtr(EHCI_MODEL_HCOR->periodiclistbase);
+    uint32_t entries = 1024U >> ((EHCI_MODEL_HCOR->usbcmd & EHCI_USBCMD_FLSIZE_MASK) >> EHCI_USBCMD_FLSIZE_SHIFT);
+    uint32_t uframe = frindex & 7U;
+    uint32_t link = framelist[(frindex >> 3) & (entries - 1U)];
+    uint32_t bytes = 0;
+
+    for (uint32_t n = 0; ((link & QH_HLP_END) == 0) && (n < EHCI_MODEL_QH_MAX); n++) {
+        if (EHCI_MODEL_LINK_TYPE(link) == EHCI_MODEL_LINK_QH) {
+            struct ehci_qh *qh = EhciModelPtr(link);
+            uint32_t mult = (qh->epcap & QH_EPCAPS_MULT_MASK) >> QH_EPCAPS_MULT_SHIFT;
+
+            /* split transactions of full and low speed qhs take place in their start micro-frame */
+            if ((qh->epcap & QH_EPCAPS_SSMASK(1U << uframe)) != 0) {
+                for (uint32_t i = 0; (i < ((mult != 0) ? mult : 1U)) && EhciModelTransact(qh, &bytes); i++) {
+                }
+            }
+            link = qh->hlp;
+        } else if (EHCI_MODEL_LINK_TYPE(link) == EHCI_MODEL_LINK_ITD) {
+            struct ehci_itd *itd = EhciModelPtr(link);
+
+            EhciModelItd(itd, uframe, &bytes);
+            link = itd->nlp;
+        } else if (EHCI_MODEL_LINK_TYPE(link) == EHCI_MODEL_LINK_SITD) {
+            struct ehci_sitd *sitd = EhciModelPtr(link);
+
+            EhciModelSitd(sitd, uframe, &bytes);
+            link = sitd->nlp;
+        } else {
+            /* an FSTN starts with the next link */
+            link = *(uint32_t *)EhciModelPtr(link);
+        }
+    }
+    return bytes;
+}
+
+static void EhciModelRingRead(struct ehci_qh **ring, uint32_t *num)
+{
+    struct ehci_qh *head = EhciModelPtr(EHCI_MODEL_HCOR->asynclistaddr);
+    struct ehci_qh *qh = head;
+
+    *num = 0;
+    if (head == NULL) {
+        return;
+    }
+    do {
+        ring[(*num)++] = qh;
+        if ((qh->hlp & QH_HLP_END) != 0) {
+            break;
+        }
+        qh = EhciModelPtr(qh->hlp);
+    } while ((qh != head) && (*num < EHCI_MODEL_QH_MAX));
+}
+
+/* qhs that left the ring since the last micro-frame start waiting for a doorbell */
+static void EhciModelRingDiff(void)
+{
+    struct ehci_qh *ring[EHCI_MODEL_QH_MAX];
+    uint32_t num;
+
+    EhciModelRingRead(ring, &num);
+    for (uint32_t i = 0; i < g_ehci.ringNum; i++) {
+        bool found = false;
+        for (uint32_t j = 0; (j < num) && !found; j++) {
+            found = (ring[j] == g_ehci.ring[i]);
+        }
+        if (!found && (g_ehci.unlinkedNum < EHCI_MODEL_QH_MAX)) {
+            struct EhciModelUnlinked *u = &g_ehci.unlinked[g_ehci.unlinkedNum++];
+            u->qh = g_ehci.ring[i];
+            u->copy = *u->qh;
+            u->rung = false;
+        }
+    }
+    memcpy(g_ehci.ring, ring, num * sizeof(ring[0]));
+    g_ehci.ringNum = num;
+}
+
+static void EhciModelDoorbell(void)
+{
+    uint32_t kept = 0;
+
+    if ((g_ehci.doorbellLeft == 0) && ((EHCI_MODEL_HCOR->usbcmd & EHCI_USBCMD_IAAD) != 0)) {
+        for (uint32_t i = 0; i < g_ehci.unlinkedNum; i++) {
+            g_ehci.unlinked[i].rung = true;
+        }
+        g_ehci.doorbellLeft = (g_ehci.doorbellLatency != 0) ? g_ehci.doorbellLatency : 1U;
+    }
+    if ((g_ehci.doorbellLeft != 0) && (--g_ehci.doorbellLeft == 0)) {
+        EHCI_MODEL_HCOR->usbcmd &= ~EHCI_USBCMD_IAAD;
+        EHCI_MODEL_HCOR->usbsts |= EHCI_USBSTS_IAA;
+        g_ehci.stats.doorbells++;
+        for (uint32_t i = 0; i < g_ehci.unlinkedNum; i++) {
+            if (!g_ehci.unlinked[i].rung) {
+                g_ehci.unlinked[kept++] = g_ehci.unlinked[i];
+            }
+        }
+        g_ehci.unlinkedNum = kept;
+        kept = 0;
+    }
+
+    /* the driver must leave an unlinked qh alone until then */
+    for (uint32_t i = 0; i < g_ehci.unlinkedNum; i++) {
+        struct EhciModelUnlinked *u = &g_ehci.unlinked[i];
+        if (memcmp(u->qh, &u->copy, sizeof(u->copy)) != 0) {
+            g_ehci.stats.qhReused++;
+        } else {
+            g_ehci.unlinked[kept++] = *u;
+        }
+    }
+    g_ehci.unlinkedNum = kept;
+}
+
+static void EhciModelAsync(uint32_t budget)
+{
+    uint32_t bytes = 0;
+    bool progress = true;
+
+    /* one transaction per qh and round, as the controller walks the ring */
+    while (progress && (bytes < budget)) {
+        progress = false;
+        for (uint32_t i = 0; (i < g_ehci.ringNum) && (bytes < budget); i++) {
+            if (EhciModelTransact(g_ehci.ring[i], &bytes)) {
+                progress = true;
+            }
+        }
+    }
+    g_ehci.stats.asyncBytes += bytes;
+}
+
+static void EhciModelUframe(void)
+{
+    struct ehci_hcor *hcor = EHCI_MODEL_HCOR;
+    uint32_t bytes = 0;
+
+    if ((hcor->usbcmd & EHCI_USBCMD_HCRESET) != 0) {
+        hcor->usbcmd = 0;
+        hcor->usbsts = EHCI_USBSTS_HALTED;
+        hcor->usbintr = 0;
+        hcor->frindex = 0;
+        g_ehci.doorbellLeft = 0;
+        g_ehci.ringNum = 0;
+        g_ehci.unlinkedNum = 0;
+        return;
+    }
+    if ((hcor->usbcmd & EHCI_USBCMD_RUN) == 0) {
+        hcor->usbsts |= EHCI_USBSTS_HALTED;
+        return;
+    }
+    hcor->usbsts &= ~EHCI_USBSTS_HALTED;
+    g_ehci.stats.uframes++;
+
+    EhciModelRingDiff();
+    EhciModelDoorbell();
+    if (g_ehci.periodicSkip != 0) {
+        g_ehci.periodicSkip--;
+    } else if ((hcor->usbcmd & EHCI_USBCMD_PSEN) != 0) {
+        bytes = EhciModelPeriodic(hcor->frindex);
+    }
+    if (((hcor->usbcmd & EHCI_USBCMD_ASEN) != 0) && (bytes < HPM_TEST_EHCI_ASYNC_BYTES)) {
+        EhciModelAsync(HPM_TEST_EHCI_ASYNC_BYTES - bytes);
+    }
+    hcor->frindex = (hcor->frindex + 1U) & EHCI_FRINDEX_MASK;
+}
+
+static uint64_t EhciModelNext(void *ctx)
+{
+    (void)ctx;
+    return g_ehci.nextNs;
+}
+
+static void EhciModelRun(void *ctx)
+{
+    (void)ctx;
+    while (g_ehci.nextNs <= HpmTestNowNs()) {
+        EhciModelUframe();
+        g_ehci.nextNs += HPM_TEST_EHCI_UFRAME_NS;
+    }
+}
+
+static bool EhciModelIrqPending(void *ctx)
+{
+    (void)ctx;
+    return (EHCI_MODEL_HCOR->usbsts & EHCI_MODEL_HCOR->usbintr & EHCI_MODEL_STS_IRQS) != 0;
+}
+
+/* The handler writes back the bits it read, they are cleared here as write one to clear */
+static void EhciModelIsr(void *arg)
+{
+    uint32_t usbsts = EHCI_MODEL_HCOR->usbsts;
+    uint32_t ack = usbsts & EHCI_MODEL_HCOR->usbintr;
+    uint64_t start = HpmTestHostNs();
+
+    (void)arg;
+    USBH_IRQHandler();
+    g_ehci.stats.isrHostNs += HpmTestHostNs() - start;
+    g_ehci.stats.irqs++;
+    EHCI_MODEL_HCOR->usbsts = (usbsts | EHCI_MODEL_HCOR->usbsts) & ~ack;
+}
+
+void HpmTestEhciModelInit(HpmTestEhciPacket packet, void *ctx)
+{
+    memset(&g_ehci, 0, sizeof(g_ehci));
+    memset(g_hpmTestEhciHcor, 0, sizeof(g_hpmTestEhciHcor));
+    g_ehci.packet = packet;
+    g_ehci.ctx = ctx;
+    g_ehci.doorbellLatency = 1;
+    g_ehci.losIrq = HPM2LITEOS_IRQ(IRQn_USB0);
+    g_ehci.nextNs = HpmTestNowNs() + HPM_TEST_EHCI_UFRAME_NS;
+    EHCI_MODEL_HCOR->usbsts = EHCI_USBSTS_HALTED;
+    EHCI_MODEL_HCOR->portsc[0] = EHCI_PORTSC_CCS | EHCI_PORTSC_PE | EHCI_PORTSC_PP;
+
+    g_ehci.model.name = "ehci";
+    g_ehci.model.next = EhciModelNext;
+    g_ehci.model.run = EhciModelRun;
+    g_ehci.model.ctx = &g_ehci;
+    HpmTestModelAdd(&g_ehci.model);
+    HpmTestIrqSource(g_ehci.losIrq, EhciModelIrqPending, &g_ehci);
+    LOS_HwiCreate(g_ehci.losIrq, 0, 0, EhciModelIsr, NULL);
+    LOS_HwiEnable(g_ehci.losIrq);
+}
+
+void HpmTestEhciModelDeinit(void)
+{
+    LOS_HwiDisable(g_ehci.losIrq);
+    LOS_HwiDelete(g_ehci.losIrq, NULL);
+    HpmTestIrqSource(g_ehci.losIrq, NULL, NULL);
+    HpmTestModelRemove(&g_ehci.model);
+}
+
+void HpmTestEhciDoorbellLatency(uint32_t uframes)
+{
+    g_ehci.doorbellLatency = uframes;
+}
+
+void HpmTestEhciSkipUframes(uint32_t uframes)
+{
+    g_ehci.periodicSkip = uframes;
+}
+
+void HpmTestEhciStats(struct HpmTestEhciStats *stats)
+{
+    *stats = g_ehci.stats;
+}
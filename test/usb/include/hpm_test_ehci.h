@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * EHCI host controller model for the cherryusb ehci port. The operational
+ * registers are plain memory (g_hpmTestEhciHcor, handed to the driver as
+ * CONFIG_USB_EHCI_HCOR_BASE), so the register accesses cost nothing and the
+ * host time of the driver can be measured.
+ *
+ * Every micro-frame (125 us of virtual time) the model walks the frame list
+ * entry of the current frame, then the async ring, and runs the qTDs of the
+ * queue heads against a device callback, one transaction at a time. The async
+ * schedule moves at most HPM_TEST_EHCI_ASYNC_BYTES per micro-frame. USBSTS is
+ * write one to clear on the target: the interrupt wrapper clears the bits the
+ * driver's handler acknowledged once it returns.
+ *
+ * Async advance doorbell: the interrupt comes at the HpmTestEhciDoorbellLatency()th
+ * micro-frame start after the driver sets USBCMD.IAAD. A qh unlinked from the async
+ * ring may only be reused by the driver after a doorbell rung later than the
+ * unlink was acknowledged; the model keeps a copy of every unlinked qh and
+ * counts the ones changed before that in qhReused.
+ *
+ * Isochronous: an iTD runs the transaction of the current micro-frame, a siTD
+ * its whole payload in the first start split micro-frame, both through the
+ * same device callback. HpmTestEhciSkipUframes() stops the periodic schedule
+ * for a while, the descriptors of those frames are left active as when the
+ * controller misses them.
+ */
+
+#ifndef HPM_TEST_EHCI_H
+#define HPM_TEST_EHCI_H
+
+#include "hpm_test.h"
+
+#define HPM_TEST_EHCI_UFRAME_NS 125000U
+#define HPM_TEST_EHCI_ASYNC_BYTES 6656U
+
+#define HPM_TEST_EHCI_PID_OUT 0U
+#define HPM_TEST_EHCI_PID_IN 1U
+#define HPM_TEST_EHCI_PID_SETUP 2U
+
+/* Device answers besides a byte count */
+#define HPM_TEST_EHCI_NAK (-1)
+#define HPM_TEST_EHCI_STALL (-2)
+
+/*
+ * One transaction with endpoint <ep> (number, | 0x80 for IN) of device
+ * <devAddr>: an OUT or SETUP hands the <len> bytes in <buf> to the device, an
+ * IN asks for up to <len> bytes into <buf>. Returns the bytes moved, fewer
+ * than the max packet size ends the qTD, or NAK / STALL. An isochronous
+ * transaction hands the whole micro-frame payload, up to 3 packets, at once.
+ */
+typedef int (*HpmTestEhciPacket)(void *ctx, uint8_t devAddr, uint8_t ep, uint8_t pid, uint8_t *buf, uint32_t len);
+
+struct HpmTestEhciStats {
+    uint64_t uframes;
+    uint64_t asyncBytes;
+    uint32_t irqs;
+    uint32_t doorbells;
+    uint32_t qhReused;
+    uint64_t isoPackets;
+    /* host time spent in USBH_IRQHandler */
+    uint64_t isrHostNs;
+};
+
+/* Operational registers, 32 words as struct ehci_hcor */
+extern uint32_t g_hpmTestEhciHcor[32];
+
+/* Connects a high speed device to root port 1 and installs the interrupt */
+void HpmTestEhciModelInit(HpmTestEhciPacket packet, void *ctx);
+void HpmTestEhciModelDeinit(void);
+
+void HpmTestEhciDoorbellLatency(uint32_t uframes);
+
+/* The next <uframes> micro-frames run neither iTDs, siTDs nor interrupt qhs */
+void HpmTestEhciSkipUframes(uint32_t uframes);
+
+void HpmTestEhciStats(struct HpmTestEhciStats *stats);
+
+#endif
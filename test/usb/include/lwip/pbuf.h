@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/* Host stand-in for the lwIP pbuf api the usb ethernet classes use, see test_usb_eth.c */
+
+#ifndef LWIP_PBUF_H
+#define LWIP_PBUF_H
+
+#include <stdint.h>
+
+#define LWIP_SUPPORT_CUSTOM_PBUF 1
+
+#define PBUF_FLAG_IS_CUSTOM 0x02U
+
+typedef enum {
+    PBUF_RAW
+} pbuf_layer;
+
+typedef enum {
+    PBUF_POOL,
+    PBUF_REF
+} pbuf_type;
+
+/* A single buffer, chains are not used by the classes */
+struct pbuf {
+    struct pbuf *next;
+    void *payload;
+    uint16_t tot_len;
+    uint16_t len;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t ref;
+};
+
+typedef void (*pbuf_free_custom_fn)(struct pbuf *p);
+
+struct pbuf_custom {
+    struct pbuf pbuf;
+    pbuf_free_custom_fn custom_free_function;
+};
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, uint16_t length, pbuf_type type);
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, uint16_t length, pbuf_type type, struct pbuf_custom *p,
+                                 void *payload_mem, uint16_t payload_mem_len);
+uint8_t pbuf_free(struct pbuf *p);
+int pbuf_take(struct pbuf *buf, const void *dataptr, uint16_t len);
+uint16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, uint16_t len, uint16_t offset);
+
+#endif
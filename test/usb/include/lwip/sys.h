@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/* Host stand-in for lwIP sys_arch protection: the LiteOS-M port locks interrupts */
+
+#ifndef LWIP_SYS_H
+#define LWIP_SYS_H
+
+#include "los_interrupt.h"
+
+#define SYS_ARCH_DECL_PROTECT(lev) UINT32 lev
+#define SYS_ARCH_PROTECT(lev) ((lev) = LOS_IntLock())
+#define SYS_ARCH_UNPROTECT(lev) LOS_IntRestore(lev)
+
+#endif
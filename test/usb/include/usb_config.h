@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/* CherryUSB configuration of the usb host tests */
+
+#ifndef CHERRYUSB_CONFIG_H
+#define CHERRYUSB_CONFIG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define CHERRYUSB_VERSION 0x001002
+
+/* ================ USB common Configuration ================ */
+
+#define CONFIG_USB_PRINTF(...) printf(__VA_ARGS__)
+
+#define usb_malloc(size) malloc(size)
+#define usb_free(ptr)    free(ptr)
+
+#ifndef CONFIG_USB_DBG_LEVEL
+#define CONFIG_USB_DBG_LEVEL USB_DBG_ERROR
+#endif
+
+#ifndef CONFIG_USB_ALIGN_SIZE
+#define CONFIG_USB_ALIGN_SIZE 4
+#endif
+
+/* there is no noncacheable region on the host */
+#define USB_NOCACHE_RAM_SECTION
+
+/* ================= USB Device Stack Configuration ================ */
+
+#define CONFIG_USBDEV_REQUEST_BUFFER_LEN 256
+
+/* the storage access size the msc measurements are quoted for */
+#ifndef CONFIG_USBDEV_MSC_BLOCK_SIZE
+#define CONFIG_USBDEV_MSC_BLOCK_SIZE 4096
+#endif
+
+#ifndef CONFIG_USBDEV_MSC_BUFFER_NUM
+#define CONFIG_USBDEV_MSC_BUFFER_NUM 2
+#endif
+
+#define CONFIG_USBDEV_MSC_MANUFACTURER_STRING "HPMicro"
+#define CONFIG_USBDEV_MSC_PRODUCT_STRING "host test"
+#define CONFIG_USBDEV_MSC_VERSION_STRING "0.01"
+
+/* CONFIG_USBDEV_MSC_THREAD comes from the build, the msc test runs with and without it */
+
+#define CONFIG_USBDEV_MSC_PRIO 4
+#define CONFIG_USBDEV_MSC_STACKSIZE 2048
+
+#define CONFIG_USBDEV_RNDIS_RESP_BUFFER_SIZE 156
+#define CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE 1536
+#define CONFIG_USBDEV_RNDIS_VENDOR_ID 0x0000ffff
+#define CONFIG_USBDEV_RNDIS_VENDOR_DESC "HPMicro"
+
+/* ================ USB HOST Stack Configuration ================== */
+
+#define CONFIG_USBHOST_MAX_RHPORTS          1
+#define CONFIG_USBHOST_MAX_EXTHUBS          1
+#define CONFIG_USBHOST_MAX_EHPORTS          4
+#define CONFIG_USBHOST_MAX_INTERFACES       6
+#define CONFIG_USBHOST_MAX_INTF_ALTSETTINGS 1
+#define CONFIG_USBHOST_MAX_ENDPOINTS        4
+
+#define CONFIG_USBHOST_DEV_NAMELEN 16
+
+#define CONFIG_USBHOST_PSC_PRIO 4
+#define CONFIG_USBHOST_PSC_STACKSIZE 2048
+
+#define CONFIG_USBHOST_REQUEST_BUFFER_LEN 512
+#define CONFIG_USBHOST_CONTROL_TRANSFER_TIMEOUT 500
+
+/* 264 qTDs, so an urb can take up to 4 MiB */
+#define CONFIG_USBHOST_PIPE_NUM 88
+
+/* ================ EHCI Configuration ================ */
+
+/* the operational registers of the ehci model, see hpm_test_ehci.h */
+extern uint32_t g_hpmTestEhciHcor[32];
+
+#define CONFIG_USB_EHCI_HCCR_BASE 0
+#define CONFIG_USB_EHCI_HCOR_BASE ((uintptr_t)g_hpmTestEhciHcor)
+#define CONFIG_USB_EHCI_FRAME_LIST_SIZE 1024
+
+/* rings of three urbs on four isochronous streams */
+#define CONFIG_USB_EHCI_ITD_NUM 48
+
+#endif
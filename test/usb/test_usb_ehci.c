@@ -0,0 +1,614 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * cherryusb ehci host port on the ehci controller model, on the LiteOS-M osal
+ * port. Bulk, control and interrupt transfers against a device model, the
+ * async advance doorbell ordering of the completed qhs, timeouts and pool
+ * exhaustion, and no qh or qTD left out of the free lists afterwards. Prints
+ * the host cost of submitting and completing a bulk urb per qTD count.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "usb_ehci_priv.h"
+#include "hpm_test_ehci.h"
+
+#define TEST_DEV_ADDR 2U
+#define TEST_EP_CTRL 0x00U
+#define TEST_EP_BULK_IN 0x81U
+#define TEST_EP_BULK_OUT 0x02U
+#define TEST_EP_INT_IN 0x83U
+#define TEST_EP_NAK_IN 0x84U
+#define TEST_EP_STALL_IN 0x85U
+#define TEST_EP_BULK2_IN 0x86U
+#define TEST_BULK_MPS 512U
+#define TEST_INT_LEN 8U
+#define TEST_QTD_BYTES 0x4000U
+#define TEST_BUF_SIZE (CONFIG_USB_EHCI_QTD_NUM * TEST_QTD_BYTES)
+#define TEST_TIMEOUT_MS 1000U
+#define NS_PER_MS 1000000ULL
+#define TEST_BENCH_REPS_MAX 201U
+
+/* Device endpoints: IN sends the pattern from <pos> on, OUT checks what it gets against it */
+struct TestEp {
+    uint32_t pos;
+    /* bytes an IN endpoint sends before a short packet */
+    uint32_t inLeft;
+    uint32_t bad;
+};
+
+struct TestDevice {
+    struct TestEp in[16];
+    struct TestEp out[16];
+    struct usb_setup_packet setup;
+    uint32_t setups;
+    uint32_t statuses;
+    uint8_t ctrlOut[64];
+    uint32_t ctrlOutLen;
+    uint64_t intReadyNs;
+};
+
+static struct TestDevice g_dev;
+static struct usbh_hub g_roothub;
+static struct usbh_hubport g_hport;
+static uint8_t g_buf[TEST_BUF_SIZE] __attribute__((aligned(4096)));
+static uint8_t g_buf2[TEST_BUF_SIZE] __attribute__((aligned(4096)));
+/* the controller takes 32 bit buffer addresses, the host stack is out of reach */
+static struct usb_setup_packet g_setup;
+
+/* roothub hooks of usbh_core.c, there is no enumeration here */
+void usbh_roothub_thread_wakeup(uint8_t port)
+{
+    (void)port;
+}
+
+uint8_t usbh_get_port_speed(const uint8_t port)
+{
+    (void)port;
+    return USB_SPEED_HIGH;
+}
+
+static uint8_t TestPattern(uint32_t pos)
+{
+    return (uint8_t)(pos * 131U + (pos >> 9));
+}
+
+static void TestFill(uint8_t *buf, uint32_t pos, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = TestPattern(pos + i);
+    }
+}
+
+static uint32_t TestMismatch(const uint8_t *buf, uint32_t pos, uint32_t len)
+{
+    uint32_t bad = 0;
+
+    for (uint32_t i = 0; i < len; i++) {
+        bad += (buf[i] != TestPattern(pos + i)) ? 1U : 0U;
+    }
+    return bad;
+}
+
+static int TestControlPacket(uint8_t ep, uint8_t pid, uint8_t *buf, uint32_t len)
+{
+    bool devToHost = (g_dev.setup.bmRequestType & USB_REQUEST_DIR_MASK) == USB_REQUEST_DIR_IN;
+    uint32_t left;
+
+    if (pid == HPM_TEST_EHCI_PID_SETUP) {
+        memcpy(&g_dev.setup, buf, sizeof(g_dev.setup));
+        g_dev.setups++;
+        g_dev.in[0].pos = 0;
+        g_dev.ctrlOutLen = 0;
+        return (int)len;
+    }
+    /* the status stage goes the other way */
+    if (((ep & 0x80U) != 0) != devToHost) {
+        g_dev.statuses++;
+        return 0;
+    }
+    if (devToHost) {
+        left = g_dev.setup.wLength - g_dev.in[0].pos;
+        len = (len < left) ? len : left;
+        TestFill(buf, g_dev.in[0].pos, len);
+        g_dev.in[0].pos += len;
+        return (int)len;
+    }
+    len = (len < (sizeof(g_dev.ctrlOut) - g_dev.ctrlOutLen)) ? len : (sizeof(g_dev.ctrlOut) - g_dev.ctrlOutLen);
+    memcpy(&g_dev.ctrlOut[g_dev.ctrlOutLen], buf, len);
+    g_dev.ctrlOutLen += len;
+    return (int)len;
+}
+
+static int TestPacket(void *ctx, uint8_t devAddr, uint8_t ep, uint8_t pid, uint8_t *buf, uint32_t len)
+{
+    struct TestEp *e;
+
+    (void)ctx;
+    if (devAddr != TEST_DEV_ADDR) {
+        return HPM_TEST_EHCI_NAK;
+    }
+    if ((ep & 0x7FU) == TEST_EP_CTRL) {
+        return TestControlPacket(ep, pid, buf, len);
+    }
+    if ((ep == TEST_EP_NAK_IN) || ((ep == TEST_EP_INT_IN) && (HpmTestNowNs() < g_dev.intReadyNs))) {
+        return HPM_TEST_EHCI_NAK;
+    }
+    if (ep == TEST_EP_STALL_IN) {
+        return HPM_TEST_EHCI_STALL;
+    }
+    if ((ep & 0x80U) != 0) {
+        e = &g_dev.in[ep & 0xFU];
+        len = (len < e->inLeft) ? len : e->inLeft;
+        e->inLeft -= len;
+        TestFill(buf, e->pos, len);
+    } else {
+        e = &g_dev.out[ep & 0xFU];
+        e->bad += TestMismatch(buf, e->pos, len);
+    }
+    e->pos += len;
+    return (int)len;
+}
+
+static uint32_t TestQtdFree(void)
+{
+    return usb_slist_len(&g_ehci_hcd.qtd_free);
+}
+
+static uint32_t TestQhFree(void)
+{
+    return usb_slist_len(&g_ehci_hcd.qh_free);
+}
+
+/* Every qh and qTD back on the free lists, and the count agrees */
+static void TestPoolsFull(const char *when)
+{
+    bool full = (TestQhFree() == CONFIG_USB_EHCI_QH_NUM) && (TestQtdFree() == CONFIG_USB_EHCI_QTD_NUM) &&
+                (g_ehci_hcd.qtd_free_num == CONFIG_USB_EHCI_QTD_NUM);
+
+    if (!full) {
+        printf("%s: %u qh and %u (%u) qtd free\n", when, TestQhFree(), TestQtdFree(), g_ehci_hcd.qtd_free_num);
+    }
+    HPM_TEST_CHECK(full);
+    HPM_TEST_CHECK(usb_slist_isempty(&g_ehci_hcd.qh_iaad_pending));
+    HPM_TEST_CHECK(usb_slist_isempty(&g_ehci_hcd.qh_iaad_ringing));
+}
+
+static usbh_pipe_t TestPipe(uint8_t epAddr, uint8_t epType, uint16_t mps, uint8_t interval)
+{
+    struct usbh_endpoint_cfg cfg = { 0 };
+    usbh_pipe_t pipe = NULL;
+
+    cfg.hport = &g_hport;
+    cfg.ep_addr = epAddr;
+    cfg.ep_type = epType;
+    cfg.ep_mps = mps;
+    cfg.ep_interval = interval;
+    HPM_TEST_CHECK_EQ(usbh_pipe_alloc(&pipe, &cfg), 0);
+    return pipe;
+}
+
+static int TestBulk(usbh_pipe_t pipe, uint8_t *buf, uint32_t len, uint32_t *actual)
+{
+    struct usbh_urb urb;
+    int ret;
+
+    memset(&urb, 0, sizeof(urb));
+    usbh_bulk_urb_fill(&urb, pipe, buf, len, TEST_TIMEOUT_MS, NULL, NULL);
+    ret = usbh_submit_urb(&urb);
+    *actual = urb.actual_length;
+    return ret;
+}
+
+static void TestInit(void)
+{
+    HpmTestEhciModelInit(TestPacket, &g_dev);
+    HPM_TEST_CHECK_EQ(usb_hc_init(), 0);
+    HPM_TEST_CHECK((EHCI_HCOR->usbsts & EHCI_USBSTS_HALTED) == 0);
+    TestPoolsFull("init");
+
+    g_roothub.is_roothub = true;
+    g_roothub.hub_addr = 1;
+    g_hport.connected = true;
+    g_hport.port = 1;
+    g_hport.dev_addr = TEST_DEV_ADDR;
+    g_hport.speed = USB_SPEED_HIGH;
+    g_hport.parent = &g_roothub;
+    for (uint32_t i = 0; i < 16; i++) {
+        g_dev.in[i].inLeft = UINT32_MAX;
+    }
+}
+
+/* Lengths around the packet and qTD sizes, buffers off the page boundary */
+static void TestBulkLengths(void)
+{
+    static const uint32_t lens[] = { 0, 1, 511, 512, 513, 4096, 16383, 16384, 16385, 100000, 1U << 20 };
+    usbh_pipe_t in = TestPipe(TEST_EP_BULK_IN, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    usbh_pipe_t out = TestPipe(TEST_EP_BULK_OUT, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    uint32_t actual;
+    uint32_t bad = 0;
+
+    for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        uint8_t *buf = &g_buf[(i * 5U) % 64U];
+        uint32_t pos = g_dev.in[TEST_EP_BULK_IN & 0xFU].pos;
+
+        memset(buf, 0, lens[i] + 1U);
+        HPM_TEST_CHECK_EQ(TestBulk(in, buf, lens[i], &actual), 0);
+        HPM_TEST_CHECK_EQ(actual, lens[i]);
+        bad += TestMismatch(buf, pos, lens[i]);
+        HPM_TEST_CHECK_EQ(buf[lens[i]], 0);
+
+        TestFill(buf, g_dev.out[TEST_EP_BULK_OUT].pos, lens[i]);
+        HPM_TEST_CHECK_EQ(TestBulk(out, buf, lens[i], &actual), 0);
+        HPM_TEST_CHECK_EQ(actual, lens[i]);
+        TestPoolsFull("bulk");
+    }
+    HPM_TEST_CHECK_EQ(bad, 0);
+    HPM_TEST_CHECK_EQ(g_dev.out[TEST_EP_BULK_OUT].bad, 0);
+
+    /* a short packet ends the urb early */
+    g_dev.in[TEST_EP_BULK_IN & 0xFU].inLeft = 1000;
+    HPM_TEST_CHECK_EQ(TestBulk(in, g_buf, 3U * TEST_QTD_BYTES, &actual), 0);
+    HPM_TEST_CHECK_EQ(actual, 1000);
+    g_dev.in[TEST_EP_BULK_IN & 0xFU].inLeft = UINT32_MAX;
+    TestPoolsFull("short");
+
+    usbh_pipe_free(in);
+    usbh_pipe_free(out);
+    printf("bulk: %u lengths in and out, short packet ok\n", (uint32_t)(sizeof(lens) / sizeof(lens[0])));
+}
+
+static void TestControl(void)
+{
+    usbh_pipe_t ep0 = TestPipe(TEST_EP_CTRL, USB_ENDPOINT_TYPE_CONTROL, 64, 0);
+    struct usb_setup_packet *setup = &g_setup;
+    struct usbh_urb urb;
+    static uint8_t data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    uint32_t setups = g_dev.setups;
+    uint32_t statuses = g_dev.statuses;
+
+    /* IN data stage over several packets */
+    setup->bmRequestType = USB_REQUEST_DIR_IN | USB_REQUEST_STANDARD | USB_REQUEST_RECIPIENT_DEVICE;
+    setup->bRequest = USB_REQUEST_GET_DESCRIPTOR;
+    setup->wValue = USB_DESCRIPTOR_TYPE_CONFIGURATION << 8;
+    setup->wLength = 200;
+    memset(&urb, 0, sizeof(urb));
+    memset(g_buf, 0, 256);
+    usbh_control_urb_fill(&urb, ep0, setup, g_buf, setup->wLength, TEST_TIMEOUT_MS, NULL, NULL);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), 0);
+    HPM_TEST_CHECK_EQ(TestMismatch(g_buf, 0, 200), 0);
+    HPM_TEST_CHECK_EQ(g_dev.setup.bRequest, USB_REQUEST_GET_DESCRIPTOR);
+    HPM_TEST_CHECK_EQ(g_dev.setup.wLength, 200);
+
+    /* OUT data stage */
+    setup->bmRequestType = USB_REQUEST_DIR_OUT | USB_REQUEST_CLASS | USB_REQUEST_RECIPIENT_INTERFACE;
+    setup->bRequest = 0x20;
+    setup->wValue = 0;
+    setup->wLength = sizeof(data);
+    usbh_control_urb_fill(&urb, ep0, setup, data, sizeof(data), TEST_TIMEOUT_MS, NULL, NULL);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), 0);
+    HPM_TEST_CHECK_EQ(g_dev.ctrlOutLen, sizeof(data));
+    HPM_TEST_CHECK(memcmp(g_dev.ctrlOut, data, sizeof(data)) == 0);
+
+    /* no data stage */
+    setup->bmRequestType = USB_REQUEST_DIR_OUT | USB_REQUEST_STANDARD | USB_REQUEST_RECIPIENT_DEVICE;
+    setup->bRequest = USB_REQUEST_SET_CONFIGURATION;
+    setup->wValue = 1;
+    setup->wLength = 0;
+    usbh_control_urb_fill(&urb, ep0, setup, NULL, 0, TEST_TIMEOUT_MS, NULL, NULL);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), 0);
+    HPM_TEST_CHECK_EQ(g_dev.setup.bRequest, USB_REQUEST_SET_CONFIGURATION);
+
+    HPM_TEST_CHECK_EQ(g_dev.setups - setups, 3);
+    HPM_TEST_CHECK_EQ(g_dev.statuses - statuses, 3);
+    TestPoolsFull("control");
+    usbh_pipe_free(ep0);
+    printf("control: in, out and no data stage ok\n");
+}
+
+/* Polled once per frame, NAKed until the device has data */
+static void TestInterrupt(void)
+{
+    usbh_pipe_t pipe = TestPipe(TEST_EP_INT_IN, USB_ENDPOINT_TYPE_INTERRUPT, 64, 4);
+    uint32_t actual = 0;
+    struct usbh_urb urb;
+    uint64_t done;
+
+    g_dev.intReadyNs = HpmTestNowNs() + 5U * NS_PER_MS;
+    memset(&urb, 0, sizeof(urb));
+    usbh_int_urb_fill(&urb, pipe, g_buf, TEST_INT_LEN, TEST_TIMEOUT_MS, NULL, NULL);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), 0);
+    done = HpmTestNowNs();
+    actual = urb.actual_length;
+    HPM_TEST_CHECK_EQ(actual, TEST_INT_LEN);
+    HPM_TEST_CHECK(done >= g_dev.intReadyNs);
+    HPM_TEST_CHECK(done <= g_dev.intReadyNs + NS_PER_MS + HPM_TEST_EHCI_UFRAME_NS);
+    TestPoolsFull("interrupt");
+    usbh_pipe_free(pipe);
+    printf("interrupt: data %.3f ms after the device had it\n", (double)(done - g_dev.intReadyNs) / NS_PER_MS);
+}
+
+static void TestErrors(void)
+{
+    usbh_pipe_t nak = TestPipe(TEST_EP_NAK_IN, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    usbh_pipe_t stall = TestPipe(TEST_EP_STALL_IN, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    struct usbh_urb urb;
+    uint64_t start = HpmTestNowNs();
+
+    memset(&urb, 0, sizeof(urb));
+    usbh_bulk_urb_fill(&urb, nak, g_buf, 3U * TEST_QTD_BYTES, 10, NULL, NULL);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), -ETIMEDOUT);
+    HPM_TEST_CHECK(HpmTestNowNs() - start >= 10U * NS_PER_MS);
+    /* the killed urb gave back its qh and qTDs, the pipe takes the next one */
+    TestPoolsFull("timeout");
+    HPM_TEST_CHECK(((struct ehci_pipe *)nak)->urb == NULL);
+
+    usbh_bulk_urb_fill(&urb, stall, g_buf, TEST_BULK_MPS, TEST_TIMEOUT_MS, NULL, NULL);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), -EPERM);
+    TestPoolsFull("stall");
+
+    usbh_pipe_free(nak);
+    usbh_pipe_free(stall);
+    printf("errors: timeout and stall ok\n");
+}
+
+/* Submits failing on empty pools give everything back and leave the pipe usable */
+static void TestNoMem(void)
+{
+    usbh_pipe_t hold = TestPipe(TEST_EP_NAK_IN, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    usbh_pipe_t bulk = TestPipe(TEST_EP_BULK_IN, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    usbh_pipe_t ep0 = TestPipe(TEST_EP_CTRL, USB_ENDPOINT_TYPE_CONTROL, 64, 0);
+    struct usb_setup_packet *setup = &g_setup;
+    struct usbh_urb holdUrb;
+    struct usbh_urb urb;
+    uint32_t actual;
+
+    /* all but two qTDs stay queued on a NAKing endpoint */
+    memset(&holdUrb, 0, sizeof(holdUrb));
+    usbh_bulk_urb_fill(&holdUrb, hold, g_buf2, (CONFIG_USB_EHCI_QTD_NUM - 2U) * TEST_QTD_BYTES, 0, NULL, NULL);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&holdUrb), 0);
+    HPM_TEST_CHECK_EQ(g_ehci_hcd.qtd_free_num, 2);
+
+    memset(setup, 0, sizeof(*setup));
+    HPM_TEST_CHECK_EQ(TestBulk(bulk, g_buf, 3U * TEST_QTD_BYTES, &actual), -ENOMEM);
+    setup->bmRequestType = USB_REQUEST_DIR_IN | USB_REQUEST_STANDARD | USB_REQUEST_RECIPIENT_DEVICE;
+    setup->bRequest = USB_REQUEST_GET_DESCRIPTOR;
+    setup->wLength = 18;
+    memset(&urb, 0, sizeof(urb));
+    usbh_control_urb_fill(&urb, ep0, setup, g_buf, setup->wLength, TEST_TIMEOUT_MS, NULL, NULL);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), -ENOMEM);
+    HPM_TEST_CHECK_EQ(g_ehci_hcd.qtd_free_num, 2);
+    HPM_TEST_CHECK_EQ(TestQtdFree(), 2);
+    HPM_TEST_CHECK_EQ(TestQhFree(), CONFIG_USB_EHCI_QH_NUM - 1U);
+
+    /* two qTDs are enough for 32 KiB */
+    HPM_TEST_CHECK_EQ(TestBulk(bulk, g_buf, 2U * TEST_QTD_BYTES, &actual), 0);
+    HPM_TEST_CHECK_EQ(actual, 2U * TEST_QTD_BYTES);
+
+    HPM_TEST_CHECK_EQ(usbh_kill_urb(&holdUrb), 0);
+    TestPoolsFull("no memory");
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), 0);
+    TestPoolsFull("no memory");
+    usbh_pipe_free(hold);
+    usbh_pipe_free(bulk);
+    usbh_pipe_free(ep0);
+    printf("no memory: pools drained, nothing leaked\n");
+}
+
+/* Streams resubmitting from their completion */
+struct TestStream {
+    usbh_pipe_t pipe;
+    struct usbh_urb urb;
+    uint8_t *buf;
+    bool in;
+    bool stop;
+    uint32_t pos;
+    uint32_t seed;
+    uint32_t urbs;
+    uint32_t bad;
+};
+
+static void TestStreamComplete(void *arg, int nbytes);
+
+static void TestStreamSubmit(struct TestStream *s)
+{
+    uint32_t len = 1U + HpmTestRand(&s->seed) % (3U * TEST_QTD_BYTES / 2U);
+
+    if (!s->in) {
+        TestFill(s->buf, s->pos, len);
+    }
+    usbh_bulk_urb_fill(&s->urb, s->pipe, s->buf, len, 0, TestStreamComplete, s);
+    HPM_TEST_CHECK_EQ(usbh_submit_urb(&s->urb), 0);
+}
+
+static void TestStreamComplete(void *arg, int nbytes)
+{
+    struct TestStream *s = arg;
+
+    if (nbytes < 0) {
+        s->bad++;
+        return;
+    }
+    if (s->in) {
+        s->bad += TestMismatch(s->buf, s->pos, (uint32_t)nbytes);
+    }
+    s->pos += (uint32_t)nbytes;
+    s->urbs++;
+    if (!s->stop) {
+        TestStreamSubmit(s);
+    }
+}
+
+static bool TestStreamsIdle(void *arg)
+{
+    struct TestStream *s = arg;
+
+    return (((struct ehci_pipe *)s[0].pipe)->urb == NULL) && (((struct ehci_pipe *)s[1].pipe)->urb == NULL) &&
+           (((struct ehci_pipe *)s[2].pipe)->urb == NULL);
+}
+
+/*
+ * Completions land while a doorbell is in flight: their qhs must wait for the
+ * next doorbell, the model sees any qh reused before that.
+ */
+static void TestDoorbell(void)
+{
+    struct TestStream s[3];
+    struct HpmTestEhciStats before;
+    struct HpmTestEhciStats after;
+    uint32_t urbs = 0;
+    uint32_t bad = 0;
+
+    memset(s, 0, sizeof(s));
+    s[0].pipe = TestPipe(TEST_EP_BULK_IN, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    s[0].in = true;
+    s[0].pos = g_dev.in[TEST_EP_BULK_IN & 0xFU].pos;
+    s[1].pipe = TestPipe(TEST_EP_BULK_OUT, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    s[1].pos = g_dev.out[TEST_EP_BULK_OUT].pos;
+    s[2].pipe = TestPipe(TEST_EP_BULK2_IN, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    s[2].in = true;
+    s[2].pos = g_dev.in[TEST_EP_BULK2_IN & 0xFU].pos;
+    for (uint32_t i = 0; i < 3; i++) {
+        s[i].buf = (i == 1) ? g_buf2 : &g_buf[i * 4U * TEST_QTD_BYTES];
+        s[i].seed = i + 1U;
+    }
+
+    HpmTestEhciDoorbellLatency(3);
+    HpmTestEhciStats(&before);
+    for (uint32_t i = 0; i < 3; i++) {
+        TestStreamSubmit(&s[i]);
+    }
+    HpmTestRunUntil(HpmTestNowNs() + (HpmTestFull() ? 10000U : 500U) * NS_PER_MS);
+    for (uint32_t i = 0; i < 3; i++) {
+        s[i].stop = true;
+    }
+    HPM_TEST_CHECK(HpmTestRunUntilDone(HpmTestNowNs() + 100U * NS_PER_MS, TestStreamsIdle, s));
+    HpmTestEhciStats(&after);
+    HpmTestEhciDoorbellLatency(1);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        urbs += s[i].urbs;
+        bad += s[i].bad;
+        usbh_pipe_free(s[i].pipe);
+    }
+    printf("doorbell: %u urbs, %u doorbells, %u qhs reused early, %.1f MB/s\n", urbs,
+           after.doorbells - before.doorbells, after.qhReused - before.qhReused,
+           (double)(after.asyncBytes - before.asyncBytes) / ((after.uframes - before.uframes) * 125e-6) / 1e6);
+    HPM_TEST_CHECK_EQ(bad, 0);
+    HPM_TEST_CHECK_EQ(g_dev.out[TEST_EP_BULK_OUT].bad, 0);
+    HPM_TEST_CHECK_EQ(after.qhReused - before.qhReused, 0);
+    HPM_TEST_CHECK(urbs > 100U);
+    /* one doorbell covers the qhs of several completions */
+    HPM_TEST_CHECK(after.doorbells - before.doorbells < urbs);
+    TestPoolsFull("doorbell");
+}
+
+static bool TestUrbDone(void *arg)
+{
+    return *(volatile bool *)arg;
+}
+
+static void TestUrbComplete(void *arg, int nbytes)
+{
+    (void)nbytes;
+    *(bool *)arg = true;
+}
+
+static int TestCompareNs(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t TestMedianNs(uint64_t *ns, uint32_t num)
+{
+    qsort(ns, num, sizeof(ns[0]), TestCompareNs);
+    return ns[num / 2U];
+}
+
+/*
+ * Host time of submitting a bulk urb and handling its interrupts, medians over
+ * the runs, the model is not counted. Every qh and qTD allocation takes an
+ * osal critical section, its cost on the host shim is printed for scale.
+ */
+static void TestBench(void)
+{
+    static const uint32_t qtds[] = { 1, 8, 32, 64, 128, 256 };
+    static uint64_t submitNs[TEST_BENCH_REPS_MAX];
+    static uint64_t isrNs[TEST_BENCH_REPS_MAX];
+    static uint64_t totalNs[TEST_BENCH_REPS_MAX];
+    usbh_pipe_t pipe = TestPipe(TEST_EP_BULK_IN, USB_ENDPOINT_TYPE_BULK, TEST_BULK_MPS, 0);
+    uint32_t reps = HpmTestFull() ? TEST_BENCH_REPS_MAX : 21U;
+    uint64_t start;
+    size_t flags;
+
+    start = HpmTestHostNs();
+    for (uint32_t i = 0; i < 1000U; i++) {
+        flags = usb_osal_enter_critical_section();
+        usb_osal_leave_critical_section(flags);
+    }
+    printf("bench: host ns per bulk urb, submit + interrupts, critical section %u ns\n",
+           (uint32_t)((HpmTestHostNs() - start) / 1000U));
+    printf("  qtds/urb  submit     isr   total\n");
+    for (uint32_t i = 0; i < sizeof(qtds) / sizeof(qtds[0]); i++) {
+        struct usbh_urb urb;
+        volatile bool done;
+
+        for (uint32_t r = 0; r < reps; r++) {
+            struct HpmTestEhciStats before;
+            struct HpmTestEhciStats after;
+
+            done = false;
+            memset(&urb, 0, sizeof(urb));
+            usbh_bulk_urb_fill(&urb, pipe, g_buf, qtds[i] * TEST_QTD_BYTES, 0, TestUrbComplete, (void *)&done);
+            HpmTestEhciStats(&before);
+            start = HpmTestHostNs();
+            HPM_TEST_CHECK_EQ(usbh_submit_urb(&urb), 0);
+            submitNs[r] = HpmTestHostNs() - start;
+            HPM_TEST_CHECK(HpmTestRunUntilDone(HpmTestNowNs() + 1000U * NS_PER_MS, TestUrbDone, (void *)&done));
+            HpmTestEhciStats(&after);
+            HPM_TEST_CHECK_EQ(urb.actual_length, qtds[i] * TEST_QTD_BYTES);
+            isrNs[r] = after.isrHostNs - before.isrHostNs;
+            totalNs[r] = submitNs[r] + isrNs[r];
+        }
+        printf("  %8u %7u %7u %7u\n", qtds[i], (uint32_t)TestMedianNs(submitNs, reps),
+               (uint32_t)TestMedianNs(isrNs, reps), (uint32_t)TestMedianNs(totalNs, reps));
+    }
+    usbh_pipe_free(pipe);
+    TestPoolsFull("bench");
+}
+
+int main(void)
+{
+    HpmTestVirtualTime(true);
+
+    TestInit();
+    TestBulkLengths();
+    TestControl();
+    TestInterrupt();
+    TestErrors();
+    TestNoMem();
+    TestDoorbell();
+    TestBench();
+    TestPoolsFull("end");
+
+    HpmTestEhciModelDeinit();
+    return HpmTestResult();
+}
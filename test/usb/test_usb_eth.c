@@ -0,0 +1,709 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+/*
+ * usbd_rndis and usbd_cdc_ecm looped back over a high speed bulk pipe model.
+ * The same program is built for both classes (TEST_USB_RNDIS); a host stand-in
+ * sends tagged ethernet frames on the out endpoint and takes them off the in
+ * endpoint, the device network loop echoes, sinks or sources them through the
+ * lwIP api of the class. The network loop pays for the stack and for every
+ * byte the class copies, so lending rx buffers and aggregating transfers show
+ * in the frame rate. It checks the data, that no frame is lost where the
+ * class can flow control, and that every pbuf comes back. Virtual time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "los_interrupt.h"
+#include "hpm_soc.h"
+#include "soc.h"
+#include "usbd_core.h"
+#include "lwip/pbuf.h"
+#if defined(TEST_USB_RNDIS)
+#include "usbd_rndis.h"
+#include "rndis_protocol.h"
+#else
+#include "usbd_cdc_ecm.h"
+#endif
+#include "hpm_test.h"
+
+#define TEST_OUT_EP 0x01
+#define TEST_IN_EP 0x81
+#define TEST_INT_EP 0x82
+#define TEST_MPS 512U
+/* high speed bulk, about 50 MB/s */
+#define TEST_BUS_TRANSFER_NS 2000U
+#define TEST_BUS_BYTE_NS 20U
+/* work of the usb interrupt besides the class driver */
+#define TEST_ISR_NS 1500U
+/* lwIP per frame, and copies in non cacheable memory */
+#define TEST_STACK_NS 6000U
+#define TEST_COPY_BYTE_NS 4U
+/* the network loop is charged in slices, so interrupts preempt it */
+#define TEST_CPU_SLICE_NS 1000U
+#define TEST_HOST_OUT_MAX 16384U
+#define TEST_TAGS 65536U
+#define TEST_HOLD_MAX 64U
+#define NS_PER_MS 1000000ULL
+#define NS_PER_S 1000000000ULL
+
+#if defined(TEST_USB_RNDIS)
+#define TEST_CLASS "rndis"
+#define TEST_ETH_RX usbd_rndis_eth_rx
+#define TEST_ETH_TX usbd_rndis_eth_tx
+#else
+#define TEST_CLASS "ecm"
+#define TEST_ETH_RX usbd_cdc_ecm_eth_rx
+#define TEST_ETH_TX usbd_cdc_ecm_eth_tx
+#endif
+
+enum TestApp {
+    TEST_APP_ECHO,
+    TEST_APP_SINK,
+    TEST_APP_SOURCE,
+};
+
+static const char *const g_appNames[] = { "echo", "sink", "source" };
+
+/* How the host driver uses the pipe: packets it packs in an out transfer, largest in transfer it reads */
+struct TestHostConfig {
+    const char *name;
+    uint32_t outPackets;
+    uint32_t inMax;
+};
+
+struct TestEp {
+    struct usbd_endpoint *ep;
+    bool armed;
+    const uint8_t *writeBuf;
+    uint8_t *readBuf;
+    uint32_t len;
+    /* completion the interrupt has not handled yet */
+    bool done;
+    uint32_t doneLen;
+};
+
+/* One transfer on the bus at a time, round robin between the directions */
+struct TestUsb {
+    struct TestEp in;
+    struct TestEp out;
+    struct TestEp *active;
+    struct TestEp *last;
+    uint32_t activeLen;
+    uint64_t doneNs;
+};
+
+struct TestHost {
+    const struct TestHostConfig *config;
+    uint32_t frameLen;
+    bool sending;
+    /* the frames coming in are echoes of the ones sent */
+    bool echo;
+    /* the out transfer ended on a packet boundary, a zlp closes it */
+    bool zlp;
+    /* the next out transfer carries a packet message with a bad DataOffset */
+    bool badOffset;
+    uint8_t out[TEST_HOST_OUT_MAX];
+    uint8_t tag;
+    /* tags of the frames sent, the echoes come back in order or not at all */
+    uint8_t tags[TEST_TAGS];
+    uint32_t tagIn;
+    uint32_t tagOut;
+    uint32_t frames;
+    uint32_t rxFrames;
+    uint64_t rxBytes;
+    uint32_t mismatches;
+    uint32_t bad;
+};
+
+static struct TestUsb g_usb;
+static struct TestHost g_host;
+static uint32_t g_losIrq;
+static bool g_rxSignaled;
+static uint32_t g_copied;
+static uint32_t g_pbufs;
+static uint32_t g_devFrames;
+static uint32_t g_devBad;
+static uint32_t g_drops;
+static struct pbuf *g_held[TEST_HOLD_MAX];
+static uint32_t g_heldNext;
+static uint64_t g_runNs;
+static struct usbd_interface g_intf;
+
+/* lwIP pbufs, the classes use single buffers only */
+struct pbuf *pbuf_alloc(pbuf_layer layer, uint16_t length, pbuf_type type)
+{
+    struct pbuf *p = malloc(sizeof(struct pbuf) + length);
+
+    (void)layer;
+    if (p == NULL) {
+        return NULL;
+    }
+    memset(p, 0, sizeof(*p));
+    p->payload = p + 1;
+    p->tot_len = length;
+    p->len = length;
+    p->type = (uint8_t)type;
+    p->ref = 1;
+    g_pbufs++;
+    return p;
+}
+
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, uint16_t length, pbuf_type type, struct pbuf_custom *p,
+                                 void *payload_mem, uint16_t payload_mem_len)
+{
+    (void)l;
+    HPM_TEST_CHECK(length <= payload_mem_len);
+    memset(&p->pbuf, 0, sizeof(p->pbuf));
+    p->pbuf.payload = payload_mem;
+    p->pbuf.tot_len = length;
+    p->pbuf.len = length;
+    p->pbuf.type = (uint8_t)type;
+    p->pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+    p->pbuf.ref = 1;
+    g_pbufs++;
+    return &p->pbuf;
+}
+
+uint8_t pbuf_free(struct pbuf *p)
+{
+    g_pbufs--;
+    if ((p->flags & PBUF_FLAG_IS_CUSTOM) != 0) {
+        ((struct pbuf_custom *)p)->custom_free_function(p);
+    } else {
+        free(p);
+    }
+    return 1;
+}
+
+/* The frame copies of the classes, they run with interrupts enabled */
+int pbuf_take(struct pbuf *buf, const void *dataptr, uint16_t len)
+{
+    HPM_TEST_CHECK(!LOS_IntLocked());
+    HPM_TEST_CHECK(len <= buf->tot_len);
+    memcpy(buf->payload, dataptr, len);
+    g_copied += len;
+    return 0;
+}
+
+uint16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, uint16_t len, uint16_t offset)
+{
+    HPM_TEST_CHECK(!LOS_IntLocked());
+    HPM_TEST_CHECK(offset + len <= p->tot_len);
+    memcpy(dataptr, (const uint8_t *)p->payload + offset, len);
+    g_copied += len;
+    return len;
+}
+
+#if defined(TEST_USB_RNDIS)
+void usbd_rndis_data_recv_done(void)
+#else
+void usbd_cdc_ecm_data_recv_done(void)
+#endif
+{
+    g_rxSignaled = true;
+}
+
+/* Device controller driver, the class driver arms the endpoints through it */
+void usbd_add_endpoint(struct usbd_endpoint *ep)
+{
+    if (ep->ep_addr == TEST_OUT_EP) {
+        g_usb.out.ep = ep;
+    } else if (ep->ep_addr == TEST_IN_EP) {
+        g_usb.in.ep = ep;
+    }
+}
+
+int usbd_ep_start_write(const uint8_t ep, const uint8_t *data, uint32_t data_len)
+{
+    /* notifications on the interrupt endpoint are not modelled */
+    if (ep == TEST_INT_EP) {
+        return 0;
+    }
+    HPM_TEST_CHECK_EQ(ep, TEST_IN_EP);
+    HPM_TEST_CHECK(!g_usb.in.armed);
+    g_usb.in.armed = true;
+    g_usb.in.writeBuf = data;
+    g_usb.in.len = data_len;
+    return 0;
+}
+
+int usbd_ep_start_read(const uint8_t ep, uint8_t *data, uint32_t data_len)
+{
+    HPM_TEST_CHECK_EQ(ep, TEST_OUT_EP);
+    HPM_TEST_CHECK(!g_usb.out.armed);
+    g_usb.out.armed = true;
+    g_usb.out.readBuf = data;
+    g_usb.out.len = data_len;
+    return 0;
+}
+
+static void TestHostFrame(uint8_t *buf)
+{
+    g_host.tags[g_host.tagIn++ % TEST_TAGS] = g_host.tag;
+    memset(buf, g_host.tag++, g_host.frameLen);
+    g_host.frames++;
+}
+
+/* Builds the next out transfer in g_host.out, returns its length */
+static uint32_t TestHostOut(void)
+{
+    uint32_t len = 0;
+
+    if (g_host.zlp) {
+        g_host.zlp = false;
+        return 0;
+    }
+#if defined(TEST_USB_RNDIS)
+    uint32_t msgLen = sizeof(rndis_data_packet_t) + g_host.frameLen;
+    rndis_data_packet_t *prev = NULL;
+
+    for (uint32_t i = 0; i < g_host.config->outPackets; i++) {
+        rndis_data_packet_t *hdr;
+        /* messages start on 4 byte boundaries, the padding belongs to the one before, the last is not padded */
+        if ((prev != NULL) && (((len + 3U) & ~3U) + msgLen <= g_usb.out.len)) {
+            prev->MessageLength += ((len + 3U) & ~3U) - len;
+            len = (len + 3U) & ~3U;
+        } else if (prev != NULL) {
+            break;
+        }
+        hdr = (rndis_data_packet_t *)&g_host.out[len];
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->MessageType = REMOTE_NDIS_PACKET_MSG;
+        hdr->MessageLength = msgLen;
+        hdr->DataOffset = sizeof(rndis_data_packet_t) - sizeof(rndis_generic_msg_t);
+        hdr->DataLength = g_host.frameLen;
+        if (g_host.badOffset) {
+            /* points far beyond the message, the device must drop the transfer and not read there */
+            g_host.badOffset = false;
+            hdr->DataOffset = 0xFFFFFFF8U;
+            len += msgLen;
+            break;
+        }
+        TestHostFrame(&g_host.out[len + sizeof(rndis_data_packet_t)]);
+        len += msgLen;
+        prev = hdr;
+    }
+#else
+    TestHostFrame(g_host.out);
+    len = g_host.frameLen;
+#endif
+    HPM_TEST_CHECK(len <= g_usb.out.len);
+    g_host.zlp = (len % TEST_MPS) == 0;
+    return len;
+}
+
+static void TestHostFrameIn(const uint8_t *data, uint32_t len)
+{
+    g_host.rxFrames++;
+    g_host.rxBytes += len;
+    if ((len != g_host.frameLen) || (data[0] != data[len - 1])) {
+        g_host.bad++;
+        return;
+    }
+    if (g_host.echo) {
+        /* skip the frames the device dropped */
+        while ((g_host.tagOut != g_host.tagIn) && (g_host.tags[g_host.tagOut % TEST_TAGS] != data[0])) {
+            g_host.tagOut++;
+        }
+        if (g_host.tagOut == g_host.tagIn) {
+            g_host.mismatches++;
+            return;
+        }
+        g_host.tagOut++;
+    }
+}
+
+static void TestHostIn(const uint8_t *data, uint32_t len)
+{
+    if (len == 0) {
+        return;
+    }
+#if defined(TEST_USB_RNDIS)
+    uint32_t offset = 0;
+
+    if (len > g_host.config->inMax) {
+        g_host.bad++;
+        return;
+    }
+    while (offset + sizeof(rndis_data_packet_t) <= len) {
+        const rndis_data_packet_t *hdr = (const rndis_data_packet_t *)&data[offset];
+        if ((hdr->MessageType != REMOTE_NDIS_PACKET_MSG) || (hdr->MessageLength > len - offset) ||
+            (hdr->DataOffset + sizeof(rndis_generic_msg_t) + hdr->DataLength > hdr->MessageLength)) {
+            g_host.bad++;
+            return;
+        }
+        TestHostFrameIn(&data[offset + sizeof(rndis_generic_msg_t) + hdr->DataOffset], hdr->DataLength);
+        offset += hdr->MessageLength;
+    }
+#else
+    TestHostFrameIn(data, len);
+#endif
+}
+
+static bool TestOutReady(const struct TestUsb *usb)
+{
+    return usb->out.armed && (g_host.sending || g_host.zlp);
+}
+
+static uint64_t TestUsbNext(void *ctx)
+{
+    struct TestUsb *usb = ctx;
+
+    if (usb->active != NULL) {
+        return usb->doneNs;
+    }
+    if (usb->in.armed || TestOutReady(usb)) {
+        return HpmTestNowNs();
+    }
+    return UINT64_MAX;
+}
+
+static void TestUsbComplete(struct TestUsb *usb)
+{
+    struct TestEp *ep = usb->active;
+
+    if (ep == &usb->in) {
+        TestHostIn(ep->writeBuf, usb->activeLen);
+    } else {
+        memcpy(ep->readBuf, g_host.out, usb->activeLen);
+    }
+    ep->armed = false;
+    ep->done = true;
+    ep->doneLen = usb->activeLen;
+    usb->last = ep;
+    usb->active = NULL;
+}
+
+static void TestUsbRun(void *ctx)
+{
+    struct TestUsb *usb = ctx;
+    bool out = TestOutReady(usb);
+
+    if (usb->active != NULL) {
+        TestUsbComplete(usb);
+        return;
+    }
+    if (out && usb->in.armed) {
+        out = (usb->last == &usb->in);
+    }
+    if (out) {
+        usb->active = &usb->out;
+        usb->activeLen = TestHostOut();
+    } else {
+        usb->active = &usb->in;
+        usb->activeLen = usb->in.len;
+    }
+    usb->doneNs = HpmTestNowNs() + TEST_BUS_TRANSFER_NS + (uint64_t)usb->activeLen * TEST_BUS_BYTE_NS;
+}
+
+static struct HpmTestModel g_usbModel = {
+    .name = "usb",
+    .next = TestUsbNext,
+    .run = TestUsbRun,
+    .ctx = &g_usb,
+};
+
+static bool TestUsbIrqPending(void *ctx)
+{
+    struct TestUsb *usb = ctx;
+
+    return usb->in.done || usb->out.done;
+}
+
+static void TestUsbIsr(void *arg)
+{
+    (void)arg;
+    HpmTestCpuNs(TEST_ISR_NS);
+    if (g_usb.out.done) {
+        g_usb.out.done = false;
+        g_usb.out.ep->ep_cb(TEST_OUT_EP, g_usb.out.doneLen);
+    }
+    if (g_usb.in.done) {
+        g_usb.in.done = false;
+        g_usb.in.ep->ep_cb(TEST_IN_EP, g_usb.in.doneLen);
+    }
+}
+
+static bool TestRxSignaled(void *arg)
+{
+    (void)arg;
+    return g_rxSignaled;
+}
+
+/* Nothing on the bus or waiting for the interrupt, and the host has closed its last transfer */
+static bool TestBusIdle(void *arg)
+{
+    (void)arg;
+    return (g_usb.active == NULL) && !g_usb.in.armed && !g_usb.in.done && !g_usb.out.done && !g_host.zlp;
+}
+
+/* Charges the stack and the copies of one frame to the network loop */
+static void TestNetCharge(void)
+{
+    uint64_t ns = TEST_STACK_NS + (uint64_t)g_copied * TEST_COPY_BYTE_NS;
+
+    g_copied = 0;
+    while (ns > 0) {
+        uint64_t slice = (ns < TEST_CPU_SLICE_NS) ? ns : TEST_CPU_SLICE_NS;
+        HpmTestCpuNs(slice);
+        ns -= slice;
+        HpmTestIrqDeliver();
+    }
+}
+
+static void TestNetInput(struct pbuf *p, bool echo, uint32_t hold)
+{
+    const uint8_t *data = p->payload;
+
+    g_devFrames++;
+    if ((p->tot_len != g_host.frameLen) || (data[0] != data[p->tot_len - 1])) {
+        g_devBad++;
+    }
+    if (echo && (TEST_ETH_TX(p) != 0)) {
+        g_drops++;
+    }
+    if (hold == 0) {
+        (void)pbuf_free(p);
+        return;
+    }
+    /* the stack keeps the last frames, as a tcp out of order queue */
+    if (g_held[g_heldNext] != NULL) {
+        (void)pbuf_free(g_held[g_heldNext]);
+    }
+    g_held[g_heldNext] = p;
+    g_heldNext = (g_heldNext + 1) % hold;
+}
+
+/* Bus reset and SET_CONFIGURATION, the transfers armed before are gone */
+static void TestUsbReset(void)
+{
+    HPM_TEST_CHECK(TestBusIdle(NULL));
+    g_usb.in.armed = false;
+    g_usb.out.armed = false;
+    g_usb.last = NULL;
+    g_intf.notify_handler(USBD_EVENT_RESET, NULL);
+    g_intf.notify_handler(USBD_EVENT_CONFIGURED, NULL);
+}
+
+/* Runs <app> with <frameLen> byte frames for g_runNs, the network loop keeps the last <hold> frames */
+static void TestRun(enum TestApp app, uint32_t frameLen, uint32_t hold)
+{
+    struct pbuf *src = pbuf_alloc(PBUF_RAW, (uint16_t)frameLen, PBUF_POOL);
+    uint64_t end = HpmTestNowNs() + g_runNs;
+    uint32_t frames;
+    uint64_t bytes;
+    struct pbuf *p;
+    double seconds = (double)g_runNs / NS_PER_S;
+
+    memset(src->payload, 0x5a, frameLen);
+    g_host.frameLen = frameLen;
+    g_host.sending = (app != TEST_APP_SOURCE);
+    g_host.echo = (app == TEST_APP_ECHO);
+    g_host.zlp = false;
+    g_host.tagIn = 0;
+    g_host.tagOut = 0;
+    g_host.frames = 0;
+    g_host.rxFrames = 0;
+    g_host.rxBytes = 0;
+    g_host.mismatches = 0;
+    g_host.bad = 0;
+    g_rxSignaled = false;
+    g_devFrames = 0;
+    g_devBad = 0;
+    g_drops = 0;
+    g_heldNext = 0;
+    TestUsbReset();
+
+    while (HpmTestNowNs() < end) {
+        if (app == TEST_APP_SOURCE) {
+            if (TEST_ETH_TX(src) != 0) {
+                g_drops++;
+            }
+            TestNetCharge();
+            continue;
+        }
+        if (!g_rxSignaled && !HpmTestRunUntilDone(end, TestRxSignaled, NULL)) {
+            break;
+        }
+        g_rxSignaled = false;
+        while ((HpmTestNowNs() < end) && ((p = TEST_ETH_RX()) != NULL)) {
+            TestNetInput(p, app == TEST_APP_ECHO, hold);
+            TestNetCharge();
+        }
+    }
+    frames = (app == TEST_APP_SINK) ? g_devFrames : g_host.rxFrames;
+    bytes = (app == TEST_APP_SINK) ? (uint64_t)g_devFrames * frameLen : g_host.rxBytes;
+
+    /* the host stops sending, what is on the way still arrives */
+    g_host.sending = false;
+    HPM_TEST_CHECK(HpmTestRunUntilDone(HpmTestNowNs() + 100 * NS_PER_MS, TestBusIdle, NULL));
+    while ((p = TEST_ETH_RX()) != NULL) {
+        TestNetInput(p, false, 0);
+    }
+    for (uint32_t i = 0; i < TEST_HOLD_MAX; i++) {
+        if (g_held[i] != NULL) {
+            (void)pbuf_free(g_held[i]);
+            g_held[i] = NULL;
+        }
+    }
+    (void)pbuf_free(src);
+
+    printf("%s %-11s %-6s %4u B%s: %7.0f frames/s %5.1f MB/s, %6.0f drops/s\n", TEST_CLASS, g_host.config->name,
+           g_appNames[app], frameLen, (hold != 0) ? " hold" : "     ", frames / seconds, bytes / seconds / 1e6,
+           g_drops / seconds);
+    HPM_TEST_CHECK(frames > 0);
+    HPM_TEST_CHECK_EQ(g_host.bad, 0);
+    HPM_TEST_CHECK_EQ(g_host.mismatches, 0);
+    HPM_TEST_CHECK_EQ(g_devBad, 0);
+    HPM_TEST_CHECK_EQ(g_pbufs, 0);
+    if (app != TEST_APP_SOURCE) {
+        /* the out endpoint waits for a free buffer, every frame the host sent arrives */
+        HPM_TEST_CHECK_EQ(g_devFrames, g_host.frames);
+    }
+}
+
+#if defined(TEST_USB_RNDIS)
+static struct TestHostConfig g_hostConfigs[] = {
+    /* one packet per out transfer, in transfers of up to 2 KiB */
+    { "linux", 1U, 2048U },
+    /* packs as many packets as the device allows both ways */
+    { "aggregating", 4U, 16384U },
+};
+
+static uint8_t g_rndisMsg[64];
+
+/* SEND_ENCAPSULATED_COMMAND with <msg>, then GET_ENCAPSULATED_RESPONSE */
+static const uint8_t *TestRndisCommand(void *msg, uint32_t len)
+{
+    struct usb_setup_packet setup = { 0 };
+    uint8_t *data = msg;
+    uint32_t dataLen = 0;
+
+    setup.bRequest = CDC_REQUEST_SEND_ENCAPSULATED_COMMAND;
+    setup.wLength = (uint16_t)len;
+    HPM_TEST_CHECK_EQ(g_intf.class_interface_handler(&setup, &data, &dataLen), 0);
+    setup.bRequest = CDC_REQUEST_GET_ENCAPSULATED_RESPONSE;
+    setup.wLength = 0;
+    HPM_TEST_CHECK_EQ(g_intf.class_interface_handler(&setup, &data, &dataLen), 0);
+    HPM_TEST_CHECK_EQ(dataLen, ((const rndis_generic_msg_t *)data)->MessageLength);
+    return data;
+}
+
+static void TestRndisInit(struct TestHostConfig *config)
+{
+    rndis_initialize_msg_t *msg = (rndis_initialize_msg_t *)g_rndisMsg;
+    const rndis_initialize_cmplt_t *resp;
+
+    memset(g_rndisMsg, 0, sizeof(g_rndisMsg));
+    msg->MessageType = REMOTE_NDIS_INITIALIZE_MSG;
+    msg->MessageLength = sizeof(*msg);
+    msg->RequestId = 1;
+    msg->MaxTransferSize = config->inMax;
+    resp = (const rndis_initialize_cmplt_t *)TestRndisCommand(msg, sizeof(*msg));
+    HPM_TEST_CHECK_EQ(resp->MessageType, REMOTE_NDIS_INITIALIZE_CMPLT);
+    HPM_TEST_CHECK_EQ(resp->Status, RNDIS_STATUS_SUCCESS);
+    if (config->outPackets > resp->MaxPacketsPerTransfer) {
+        config->outPackets = resp->MaxPacketsPerTransfer;
+    }
+    HPM_TEST_CHECK(resp->MaxTransferSize <= TEST_HOST_OUT_MAX);
+}
+
+static uint32_t TestRndisRxErrors(void)
+{
+    rndis_query_msg_t *msg = (rndis_query_msg_t *)g_rndisMsg;
+    const rndis_query_cmplt_t *resp;
+    uint32_t value;
+
+    memset(g_rndisMsg, 0, sizeof(g_rndisMsg));
+    msg->MessageType = REMOTE_NDIS_QUERY_MSG;
+    msg->MessageLength = sizeof(*msg);
+    msg->RequestId = 2;
+    msg->Oid = OID_GEN_RCV_ERROR;
+    resp = (const rndis_query_cmplt_t *)TestRndisCommand(msg, sizeof(*msg));
+    HPM_TEST_CHECK_EQ(resp->MessageType, REMOTE_NDIS_QUERY_CMPLT);
+    HPM_TEST_CHECK_EQ(resp->InformationBufferLength, sizeof(value));
+    memcpy(&value, (const uint8_t *)resp + sizeof(*resp), sizeof(value));
+    return value;
+}
+
+/* A packet message whose DataOffset points beyond it is counted as a receive error, the rest flows on */
+static void TestRndisBadOffset(void)
+{
+    uint32_t errors = TestRndisRxErrors();
+
+    g_host.config = &g_hostConfigs[0];
+    g_host.badOffset = true;
+    TestRun(TEST_APP_SINK, 64U, 0);
+    HPM_TEST_CHECK_EQ(TestRndisRxErrors(), errors + 1);
+}
+#else
+static struct TestHostConfig g_hostConfigs[] = {
+    { "host", 1U, 1514U },
+};
+#endif
+
+static void TestInit(void)
+{
+    HwiIrqParam param = { 0 };
+#if defined(TEST_USB_RNDIS)
+    uint8_t mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+    HPM_TEST_CHECK(usbd_rndis_init_intf(&g_intf, TEST_OUT_EP, TEST_IN_EP, TEST_INT_EP, mac) != NULL);
+#else
+    HPM_TEST_CHECK(usbd_cdc_ecm_init_intf(&g_intf, TEST_INT_EP, TEST_OUT_EP, TEST_IN_EP) != NULL);
+#endif
+    HPM_TEST_CHECK(g_usb.out.ep != NULL);
+    HPM_TEST_CHECK(g_usb.in.ep != NULL);
+
+    HpmTestModelAdd(&g_usbModel);
+    g_losIrq = HPM2LITEOS_IRQ(IRQn_USB0);
+    HpmTestIrqSource(g_losIrq, TestUsbIrqPending, &g_usb);
+    HPM_TEST_CHECK_EQ(LOS_HwiCreate(g_losIrq, 0, 0, TestUsbIsr, &param), LOS_OK);
+    HPM_TEST_CHECK_EQ(LOS_HwiEnable(g_losIrq), LOS_OK);
+}
+
+int main(void)
+{
+    static const uint32_t frameLens[] = { 64U, 512U, 1514U };
+
+    HpmTestVirtualTime(true);
+    g_runNs = (HpmTestFull() ? 200U : 50U) * NS_PER_MS;
+
+    TestInit();
+    for (uint32_t c = 0; c < sizeof(g_hostConfigs) / sizeof(g_hostConfigs[0]); c++) {
+#if defined(TEST_USB_RNDIS)
+        TestRndisInit(&g_hostConfigs[c]);
+#endif
+        g_host.config = &g_hostConfigs[c];
+        for (uint32_t i = 0; i < sizeof(frameLens) / sizeof(frameLens[0]); i++) {
+            TestRun(TEST_APP_ECHO, frameLens[i], 0);
+            TestRun(TEST_APP_SOURCE, frameLens[i], 0);
+            TestRun(TEST_APP_SINK, frameLens[i], 0);
+        }
+        /* pbufs held by the stack run the class out of rx buffers to lend */
+        TestRun(TEST_APP_SINK, 64U, 40U);
+        TestRun(TEST_APP_SINK, 1514U, 40U);
+    }
+#if defined(TEST_USB_RNDIS)
+    TestRndisBadOffset();
+#endif
+
+    return HpmTestResult();
+}
@@ -0,0 +1,509 @@
+/*
+ * Copyright (c) 2022 HPMicro
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * usbd_msc streaming READ10/WRITE10 over a bulk endpoint model, on the
+ * LiteOS-M osal port. The same program is built for several buffer rings
+ * (CONFIG_USBDEV_MSC_BUFFER_NUM x CONFIG_USBDEV_MSC_BLOCK_SIZE), with the
+ * storage access in the usb interrupt and in the msc thread
+ * (CONFIG_USBDEV_MSC_THREAD); it checks the osal api, the data of random
+ * commands, and reports throughput and the time spent in the usb interrupt.
+ * Everything runs in virtual time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "los_interrupt.h"
+#include "hpm_soc.h"
+#include "soc.h"
+#include "usbd_core.h"
+#include "usbd_msc.h"
+#include "usb_scsi.h"
+#include "usb_osal.h"
+#include "hpm_test.h"
+
+#define TEST_OUT_EP 0x01
+#define TEST_IN_EP 0x81
+#define TEST_SECTOR_SIZE 512U
+#define TEST_SECTORS 8192U
+#define TEST_CMD_SECTORS 128U
+#define TEST_CMD_MAX (sizeof(struct CBW) + TEST_CMD_SECTORS * TEST_SECTOR_SIZE)
+/* work of the usb interrupt besides the class driver */
+#define TEST_ISR_NS 1000U
+/* the storage access is charged in slices, so interrupts preempt the msc thread */
+#define TEST_STORAGE_SLICE_NS 10000U
+#define NS_PER_MS 1000000ULL
+#define NS_PER_S 1000000000ULL
+#define TEST_STREAM_BYTES (32U << 20)
+
+/* endpoint and event callbacks of usbd_msc.c, the device core calls them on the target */
+void mass_storage_bulk_out(uint8_t ep, uint32_t nbytes);
+void mass_storage_bulk_in(uint8_t ep, uint32_t nbytes);
+void msc_storage_notify_handler(uint8_t event, void *arg);
+
+struct TestTiming {
+    uint32_t storageLatencyNs;
+    uint32_t storageBytesPerS;
+    uint32_t busBytesPerS;
+    uint32_t busTransferNs;
+};
+
+/* SD card class storage behind a high speed bulk pipe */
+static const struct TestTiming g_streamTiming = { 150000U, 25000000U, 45000000U, 2000U };
+/* Fast storage, keeps the endpoint and the storage racing in the random run */
+static const struct TestTiming g_randomTiming = { 2000U, 1000000000U, 1000000000U, 100U };
+
+struct TestEp {
+    bool armed;
+    const uint8_t *writeBuf;
+    uint8_t *readBuf;
+    uint32_t len;
+    /* completion the interrupt has not handled yet */
+    bool done;
+    uint32_t doneLen;
+};
+
+/* One transfer on the bus at a time, the host always has the next one ready */
+struct TestUsb {
+    const struct TestTiming *timing;
+    struct TestEp in;
+    struct TestEp out;
+    struct TestEp *active;
+    uint32_t activeLen;
+    uint64_t doneNs;
+    /* host side of the current command */
+    uint8_t hostOut[TEST_CMD_MAX];
+    uint32_t hostOutLen;
+    uint32_t hostOutPos;
+    uint8_t hostIn[TEST_CMD_SECTORS * TEST_SECTOR_SIZE];
+    uint32_t hostInLen;
+    bool csw;
+    uint8_t cswStatus;
+    /* usb interrupt */
+    uint64_t isrNs;
+    uint64_t isrMaxNs;
+    uint32_t isrCount;
+    uint32_t stalls;
+};
+
+static struct TestUsb g_usb;
+static uint32_t g_losIrq;
+static uint8_t g_disk[TEST_SECTORS * TEST_SECTOR_SIZE];
+static uint8_t g_expect[TEST_SECTORS * TEST_SECTOR_SIZE];
+
+static void TestStorageAccess(uint32_t len)
+{
+    uint64_t ns = g_usb.timing->storageLatencyNs + (uint64_t)len * NS_PER_S / g_usb.timing->storageBytesPerS;
+
+    while (ns > 0) {
+        uint64_t slice = (ns < TEST_STORAGE_SLICE_NS) ? ns : TEST_STORAGE_SLICE_NS;
+        HpmTestCpuNs(slice);
+        ns -= slice;
+        HpmTestIrqDeliver();
+    }
+}
+
+void usbd_msc_get_cap(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    (void)lun;
+    *block_num = TEST_SECTORS;
+    *block_size = TEST_SECTOR_SIZE;
+}
+
+int usbd_msc_sector_read(uint32_t sector, uint8_t *buffer, uint32_t length)
+{
+    TestStorageAccess(length);
+    memcpy(buffer, &g_disk[sector * TEST_SECTOR_SIZE], length);
+    return 0;
+}
+
+int usbd_msc_sector_write(uint32_t sector, uint8_t *buffer, uint32_t length)
+{
+    TestStorageAccess(length);
+    memcpy(&g_disk[sector * TEST_SECTOR_SIZE], buffer, length);
+    return 0;
+}
+
+/* Device controller driver, the class driver arms the endpoints through it */
+void usbd_add_endpoint(struct usbd_endpoint *ep)
+{
+    (void)ep;
+}
+
+int usbd_ep_set_stall(const uint8_t ep)
+{
+    (void)ep;
+    g_usb.stalls++;
+    return 0;
+}
+
+int usbd_ep_start_write(const uint8_t ep, const uint8_t *data, uint32_t data_len)
+{
+    HPM_TEST_CHECK_EQ(ep, TEST_IN_EP);
+    HPM_TEST_CHECK(!g_usb.in.armed);
+    g_usb.in.armed = true;
+    g_usb.in.writeBuf = data;
+    g_usb.in.len = data_len;
+    return 0;
+}
+
+int usbd_ep_start_read(const uint8_t ep, uint8_t *data, uint32_t data_len)
+{
+    HPM_TEST_CHECK_EQ(ep, TEST_OUT_EP);
+    HPM_TEST_CHECK(!g_usb.out.armed);
+    g_usb.out.armed = true;
+    g_usb.out.readBuf = data;
+    g_usb.out.len = data_len;
+    return 0;
+}
+
+static uint64_t TestUsbNext(void *ctx)
+{
+    struct TestUsb *usb = ctx;
+
+    if (usb->active != NULL) {
+        return usb->doneNs;
+    }
+    if (usb->in.armed || (usb->out.armed && (usb->hostOutPos < usb->hostOutLen))) {
+        return HpmTestNowNs();
+    }
+    return UINT64_MAX;
+}
+
+static void TestUsbComplete(struct TestUsb *usb)
+{
+    struct TestEp *ep = usb->active;
+    uint32_t len = usb->activeLen;
+
+    if (ep == &usb->in) {
+        const struct CSW *csw = (const struct CSW *)ep->writeBuf;
+        if ((len == sizeof(struct CSW)) && (csw->dSignature == MSC_CSW_Signature)) {
+            usb->csw = true;
+            usb->cswStatus = csw->bStatus;
+        } else if (usb->hostInLen + len <= sizeof(usb->hostIn)) {
+            memcpy(&usb->hostIn[usb->hostInLen], ep->writeBuf, len);
+            usb->hostInLen += len;
+        }
+    } else {
+        memcpy(ep->readBuf, &usb->hostOut[usb->hostOutPos], len);
+        usb->hostOutPos += len;
+    }
+    ep->armed = false;
+    ep->done = true;
+    ep->doneLen = len;
+    usb->active = NULL;
+}
+
+static void TestUsbRun(void *ctx)
+{
+    struct TestUsb *usb = ctx;
+
+    if (usb->active != NULL) {
+        TestUsbComplete(usb);
+        return;
+    }
+    if (usb->in.armed) {
+        usb->active = &usb->in;
+        usb->activeLen = usb->in.len;
+    } else {
+        usb->active = &usb->out;
+        usb->activeLen = usb->out.len;
+        if (usb->activeLen > usb->hostOutLen - usb->hostOutPos) {
+            usb->activeLen = usb->hostOutLen - usb->hostOutPos;
+        }
+    }
+    usb->doneNs = HpmTestNowNs() + usb->timing->busTransferNs +
+                  (uint64_t)usb->activeLen * NS_PER_S / usb->timing->busBytesPerS;
+}
+
+static struct HpmTestModel g_usbModel = {
+    .name = "usb",
+    .next = TestUsbNext,
+    .run = TestUsbRun,
+    .ctx = &g_usb,
+};
+
+static bool TestUsbIrqPending(void *ctx)
+{
+    struct TestUsb *usb = ctx;
+
+    return usb->in.done || usb->out.done;
+}
+
+static void TestUsbIsr(void *arg)
+{
+    uint64_t start = HpmTestNowNs();
+    uint64_t ns;
+
+    (void)arg;
+    HpmTestCpuNs(TEST_ISR_NS);
+    if (g_usb.out.done) {
+        g_usb.out.done = false;
+        mass_storage_bulk_out(TEST_OUT_EP, g_usb.out.doneLen);
+    }
+    if (g_usb.in.done) {
+        g_usb.in.done = false;
+        mass_storage_bulk_in(TEST_IN_EP, g_usb.in.doneLen);
+    }
+    ns = HpmTestNowNs() - start;
+    g_usb.isrNs += ns;
+    g_usb.isrCount++;
+    if (ns > g_usb.isrMaxNs) {
+        g_usb.isrMaxNs = ns;
+    }
+}
+
+/* The command is over once the device took the csw off the bus and armed the next cbw */
+static bool TestCmdDone(void *arg)
+{
+    (void)arg;
+    return g_usb.csw && !g_usb.in.done;
+}
+
+/* Runs READ10/WRITE10 of <count> sectors at <lba> and checks the data */
+static bool TestCmd(bool write, uint32_t lba, uint16_t count, uint32_t seed)
+{
+    struct CBW cbw = { 0 };
+    uint32_t len = count * TEST_SECTOR_SIZE;
+    uint8_t *expect = &g_expect[lba * TEST_SECTOR_SIZE];
+
+    cbw.dSignature = MSC_CBW_Signature;
+    cbw.dTag = seed;
+    cbw.dDataLength = len;
+    cbw.bmFlags = write ? 0x00 : 0x80;
+    cbw.bCBLength = 10;
+    cbw.CB[0] = write ? SCSI_CMD_WRITE10 : SCSI_CMD_READ10;
+    cbw.CB[2] = (uint8_t)(lba >> 24);
+    cbw.CB[3] = (uint8_t)(lba >> 16);
+    cbw.CB[4] = (uint8_t)(lba >> 8);
+    cbw.CB[5] = (uint8_t)lba;
+    cbw.CB[7] = (uint8_t)(count >> 8);
+    cbw.CB[8] = (uint8_t)count;
+
+    memcpy(g_usb.hostOut, &cbw, sizeof(cbw));
+    g_usb.hostOutLen = sizeof(cbw);
+    g_usb.hostOutPos = 0;
+    g_usb.hostInLen = 0;
+    g_usb.csw = false;
+    if (write) {
+        for (uint32_t i = 0; i < len; i++) {
+            expect[i] = (uint8_t)HpmTestRand(&seed);
+        }
+        memcpy(&g_usb.hostOut[sizeof(cbw)], expect, len);
+        g_usb.hostOutLen += len;
+    }
+
+    if (!HpmTestTaskRunUntilDone(HpmTestNowNs() + 10 * NS_PER_S, TestCmdDone, NULL) || (g_usb.cswStatus != 0)) {
+        return false;
+    }
+    if (write) {
+        return memcmp(&g_disk[lba * TEST_SECTOR_SIZE], expect, len) == 0;
+    }
+    return (g_usb.hostInLen == len) && (memcmp(g_usb.hostIn, expect, len) == 0);
+}
+
+static uint32_t g_selfDeleted;
+static usb_osal_sem_t g_sem;
+
+static void TestSelfDeleteThread(void *arg)
+{
+    g_selfDeleted += (uint32_t)(uintptr_t)arg;
+    usb_osal_thread_delete(NULL);
+    g_selfDeleted = 0;
+}
+
+static void TestGiveThread(void *arg)
+{
+    (void)arg;
+    usb_osal_msleep(20);
+    (void)usb_osal_sem_give(g_sem);
+}
+
+static void TestTakeThread(void *arg)
+{
+    (void)arg;
+    (void)usb_osal_sem_take(g_sem, USB_OSAL_WAITING_FOREVER);
+    g_selfDeleted = 0;
+}
+
+static void TestOsal(void)
+{
+    usb_osal_thread_t thread;
+    usb_osal_mutex_t mutex;
+    usb_osal_mq_t mq;
+    uintptr_t msg = 0;
+    uint64_t start;
+    size_t flags;
+
+    /* threads that delete themselves leave neither a task nor memory behind */
+    for (uint32_t round = 0; round < 5; round++) {
+        for (uint32_t i = 0; i < 10; i++) {
+            HPM_TEST_CHECK(usb_osal_thread_create("self", 256, 40, TestSelfDeleteThread, (void *)1) != NULL);
+        }
+        usb_osal_msleep(10);
+    }
+    HPM_TEST_CHECK_EQ(g_selfDeleted, 50);
+    HPM_TEST_CHECK_EQ(HpmTestTaskCount(), 0);
+    HPM_TEST_CHECK_EQ(HpmTestMemInUse(), 0);
+
+    g_sem = usb_osal_sem_create(0);
+    HPM_TEST_CHECK(g_sem != NULL);
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(usb_osal_sem_take(g_sem, 30), -ETIMEDOUT);
+    HPM_TEST_CHECK_EQ(HpmTestNowNs() - start, 30 * NS_PER_MS);
+
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK(usb_osal_thread_create("give", 2048, 4, TestGiveThread, NULL) != NULL);
+    HPM_TEST_CHECK_EQ(usb_osal_sem_take(g_sem, USB_OSAL_WAITING_FOREVER), 0);
+    HPM_TEST_CHECK_EQ(HpmTestNowNs() - start, 20 * NS_PER_MS);
+    HPM_TEST_CHECK_EQ(HpmTestTaskCount(), 0);
+
+    /* binary, a second give overflows */
+    HPM_TEST_CHECK_EQ(usb_osal_sem_give(g_sem), 0);
+    HPM_TEST_CHECK_EQ(usb_osal_sem_give(g_sem), -ETIMEDOUT);
+    HPM_TEST_CHECK_EQ(usb_osal_sem_take(g_sem, 0), 0);
+    HPM_TEST_CHECK_EQ(usb_osal_sem_take(g_sem, 0), -ETIMEDOUT);
+
+    /* a blocked thread deleted by another one never runs again */
+    thread = usb_osal_thread_create("take", 2048, 4, TestTakeThread, NULL);
+    HPM_TEST_CHECK(thread != NULL);
+    g_selfDeleted = 1;
+    HpmTestTaskRun();
+    HPM_TEST_CHECK_EQ(HpmTestTaskCount(), 1);
+    usb_osal_thread_delete(thread);
+    HPM_TEST_CHECK_EQ(HpmTestTaskCount(), 0);
+    HPM_TEST_CHECK_EQ(usb_osal_sem_give(g_sem), 0);
+    HpmTestTaskRun();
+    HPM_TEST_CHECK_EQ(g_selfDeleted, 1);
+    usb_osal_sem_delete(g_sem);
+
+    mq = usb_osal_mq_create(2);
+    HPM_TEST_CHECK(mq != NULL);
+    HPM_TEST_CHECK_EQ(usb_osal_mq_send(mq, 11), 0);
+    HPM_TEST_CHECK_EQ(usb_osal_mq_send(mq, 22), 0);
+    HPM_TEST_CHECK_EQ(usb_osal_mq_send(mq, 33), -ETIMEDOUT);
+    HPM_TEST_CHECK_EQ(usb_osal_mq_recv(mq, &msg, 0), 0);
+    HPM_TEST_CHECK_EQ(msg, 11);
+    HPM_TEST_CHECK_EQ(usb_osal_mq_recv(mq, &msg, 10), 0);
+    HPM_TEST_CHECK_EQ(msg, 22);
+    start = HpmTestNowNs();
+    HPM_TEST_CHECK_EQ(usb_osal_mq_recv(mq, &msg, 10), -ETIMEDOUT);
+    HPM_TEST_CHECK_EQ(HpmTestNowNs() - start, 10 * NS_PER_MS);
+
+    mutex = usb_osal_mutex_create();
+    HPM_TEST_CHECK(mutex != NULL);
+    HPM_TEST_CHECK_EQ(usb_osal_mutex_take(mutex), 0);
+    HPM_TEST_CHECK_EQ(usb_osal_mutex_give(mutex), 0);
+    usb_osal_mutex_delete(mutex);
+
+    flags = usb_osal_enter_critical_section();
+    HPM_TEST_CHECK(LOS_IntLocked());
+    usb_osal_leave_critical_section(flags);
+    HPM_TEST_CHECK(!LOS_IntLocked());
+}
+
+static void TestInit(void)
+{
+    static struct usbd_interface intf;
+    HwiIrqParam param = { 0 };
+    uint32_t seed = 1;
+
+    for (uint32_t i = 0; i < sizeof(g_disk); i++) {
+        g_disk[i] = (uint8_t)HpmTestRand(&seed);
+    }
+    memcpy(g_expect, g_disk, sizeof(g_disk));
+
+    g_usb.timing = &g_randomTiming;
+    HpmTestModelAdd(&g_usbModel);
+    g_losIrq = HPM2LITEOS_IRQ(IRQn_USB0);
+    HpmTestIrqSource(g_losIrq, TestUsbIrqPending, &g_usb);
+    HPM_TEST_CHECK_EQ(LOS_HwiCreate(g_losIrq, 0, 0, TestUsbIsr, &param), LOS_OK);
+    HPM_TEST_CHECK_EQ(LOS_HwiEnable(g_losIrq), LOS_OK);
+
+    HPM_TEST_CHECK(usbd_msc_init_intf(&intf, TEST_OUT_EP, TEST_IN_EP) != NULL);
+    msc_storage_notify_handler(USBD_EVENT_CONFIGURED, NULL);
+}
+
+/* Random lengths and directions keep the buffer ring at every fill level */
+static void TestRandom(uint32_t commands)
+{
+    uint32_t seed = 7;
+    uint32_t bad = 0;
+
+    g_usb.timing = &g_randomTiming;
+    for (uint32_t i = 0; i < commands; i++) {
+        uint16_t count = (uint16_t)(1 + HpmTestRand(&seed) % TEST_CMD_SECTORS);
+        uint32_t lba = HpmTestRand(&seed) % (TEST_SECTORS - count);
+        bool write = (HpmTestRand(&seed) & 1U) != 0;
+        if (!TestCmd(write, lba, count, seed)) {
+            bad++;
+        }
+    }
+    printf("random: %u of %u commands failed, %u stalls\n", bad, commands, g_usb.stalls);
+    HPM_TEST_CHECK_EQ(bad, 0);
+    HPM_TEST_CHECK_EQ(g_usb.stalls, 0);
+}
+
+/* Sequential 64 KiB commands over <bytes>, as a host copying a large file */
+static void TestStream(bool write, uint32_t bytes)
+{
+    uint32_t cmdBytes = TEST_CMD_SECTORS * TEST_SECTOR_SIZE;
+    uint32_t bad = 0;
+    uint64_t start;
+    double seconds;
+    double mbytes = (double)bytes / (1024.0 * 1024.0);
+
+    g_usb.timing = &g_streamTiming;
+    g_usb.isrNs = 0;
+    g_usb.isrMaxNs = 0;
+    g_usb.isrCount = 0;
+    start = HpmTestNowNs();
+    for (uint32_t done = 0; done < bytes; done += cmdBytes) {
+        uint32_t lba = (done / TEST_SECTOR_SIZE) % TEST_SECTORS;
+        if (!TestCmd(write, lba, TEST_CMD_SECTORS, done)) {
+            bad++;
+        }
+    }
+    seconds = (double)(HpmTestNowNs() - start) / NS_PER_S;
+    printf("%u x %u B %s %s: %.1f MB/s, isr %.1f%% of the time, %.2f ms per MB, max %.1f us (%u isrs)\n",
+           CONFIG_USBDEV_MSC_BUFFER_NUM, CONFIG_USBDEV_MSC_BLOCK_SIZE,
+#if defined(CONFIG_USBDEV_MSC_THREAD)
+           "msc thread",
+#else
+           "in interrupt",
+#endif
+           write ? "write" : "read ", (double)bytes / seconds / 1e6, 100.0 * g_usb.isrNs / NS_PER_S / seconds,
+           g_usb.isrNs / 1e6 / mbytes, g_usb.isrMaxNs / 1e3, g_usb.isrCount);
+    HPM_TEST_CHECK_EQ(bad, 0);
+#if defined(CONFIG_USBDEV_MSC_THREAD)
+    /* the interrupt only moves buffers, the storage access is left to the thread */
+    HPM_TEST_CHECK(g_usb.isrMaxNs < 50000U);
+#endif
+}
+
+int main(void)
+{
+    HpmTestVirtualTime(true);
+
+    TestOsal();
+    TestInit();
+    TestRandom(HpmTestFull() ? 5000U : 500U);
+    TestStream(false, TEST_STREAM_BYTES);
+    TestStream(true, TEST_STREAM_BYTES);
+
+    return HpmTestResult();
+}